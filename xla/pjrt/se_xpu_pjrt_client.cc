@@ -16,6 +16,7 @@ limitations under the License.
 #include "xla/pjrt/se_xpu_pjrt_client.h"
 
 #include <map>
+#include <memory>
 #include <optional>
 #include <set>
 #include <string>
@@ -24,15 +25,44 @@ limitations under the License.
 
 #include "absl/base/attributes.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/functional/any_invocable.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "tsl/framework/allocator.h"
+#include "tsl/platform/casts.h"
+#include "tsl/platform/fingerprint.h"
+#include "tsl/platform/host_info.h"
+#include "tsl/platform/random.h"
+#include "tsl/util/env_var.h"
 #include "xla/client/client_library.h"
+#include "xla/layout.h"
+#include "xla/layout_util.h"
+#include "xla/pjrt/distributed/protocol.pb.h"
+#include "xla/pjrt/distributed/topology_util.h"
 #include "xla/pjrt/pjrt_stream_executor_client.h"
+#include "xla/pjrt/xpu_async_host_to_device_transfer_manager.h"
+#include "xla/primitive_util.h"
+#include "xla/service/global_device_id.h"
+#include "xla/service/gpu/ccl_ops.h"
+#include "xla/service/gpu/gemm_autotune_database.h"
+#include "xla/service/gpu/gpu_executable.h"
 #include "xla/service/gpu/gpu_executable_run_options.h"
+#include "xla/service/gpu/nccl_clique_key.h"
 #include "xla/service/platform_util.h"
+#include "xla/shape_util.h"
 #include "xla/statusor.h"
 #include "xla/stream_executor/device_memory.h"
+#include "xla/stream_executor/gpu/gpu_stream.h"
 #include "xla/stream_executor/integrations/device_host_allocator.h"
 #include "xla/stream_executor/integrations/device_mem_allocator.h"
 #include "xla/stream_executor/integrations/tf_allocator_adapter.h"
+#include "xla/stream_executor/sycl/sycl_gpu_runtime.h"
+#include "xla/stream_executor/sycl/sycl_module_loader.h"
+#include "xla/stream_executor/sycl/sycl_stream_ordered_allocator.h"
+#include "xla/util.h"
 
 namespace xla {
 namespace {
@@ -43,6 +73,36 @@ class StreamExecutorXpuClient : public xla::PjRtStreamExecutorClient {
 
   xla::StatusOr<xla::DeviceAssignment> GetDefaultDeviceAssignment(
       int num_replicas, int num_partitions) const override;
+
+  using xla::PjRtStreamExecutorClient::Compile;
+  xla::StatusOr<std::unique_ptr<PjRtLoadedExecutable>> Compile(
+      const XlaComputation& computation, CompileOptions options) override;
+
+  // Aliases immutable host buffers that live in USM host or shared memory
+  // instead of copying them to the device.
+  using xla::PjRtStreamExecutorClient::BufferFromHostBuffer;
+  xla::StatusOr<std::unique_ptr<PjRtBuffer>> BufferFromHostBuffer(
+      const void* data, PrimitiveType type, absl::Span<int64_t const> dims,
+      std::optional<absl::Span<int64_t const>> byte_strides,
+      HostBufferSemantics host_buffer_semantics,
+      absl::AnyInvocable<void() &&> on_done_with_host_buffer,
+      PjRtDevice* device, const Layout* device_layout) override;
+
+  // Uploads the buffers on streams of their own, see
+  // XpuAsyncHostToDeviceTransferManager.
+  using xla::PjRtStreamExecutorClient::CreateBuffersForAsyncHostToDevice;
+  xla::StatusOr<std::unique_ptr<AsyncHostToDeviceTransferManager>>
+  CreateBuffersForAsyncHostToDevice(absl::Span<const Shape> shapes,
+                                    PjRtDevice* device) override;
+
+ private:
+  // Returns the upload streams of `device`, created on its first upload.
+  xla::StatusOr<XpuUploadStreams*> GetUploadStreams(
+      PjRtStreamExecutorDevice* device);
+
+  absl::Mutex upload_streams_mu_;
+  absl::flat_hash_map<int, std::unique_ptr<XpuUploadStreams>> upload_streams_
+      ABSL_GUARDED_BY(upload_streams_mu_);
 };
 
 xla::StatusOr<xla::DeviceAssignment>
@@ -60,22 +120,231 @@ StreamExecutorXpuClient::GetDefaultDeviceAssignment(int num_replicas,
                                                               num_partitions);
 }
 
+// Compiles the SPIR-V modules of `executable` for the devices it runs on
+// ahead of the first execution, which would otherwise JIT them one by one on
+// first launch.
+void PrecompileXpuModules(PjRtLoadedExecutable* executable) {
+  static const bool enabled = [] {
+    bool enabled = true;
+    TF_CHECK_OK(tsl::ReadBoolFromEnvVar("XLA_SYCL_PRECOMPILE_MODULES", true,
+                                        &enabled));
+    return enabled;
+  }();
+  if (!enabled) return;
+
+  auto* se_executable =
+      tensorflow::down_cast<PjRtStreamExecutorLoadedExecutable*>(executable);
+  std::vector<absl::Span<const uint8_t>> modules;
+  for (const auto& local_executable : se_executable->executables()) {
+    auto* gpu_executable =
+        dynamic_cast<gpu::GpuExecutable*>(local_executable->executable());
+    if (gpu_executable != nullptr && !gpu_executable->binary().empty()) {
+      modules.push_back(gpu_executable->binary());
+    }
+  }
+  std::vector<int> device_ordinals;
+  for (PjRtDevice* device : se_executable->addressable_devices()) {
+    absl::StatusOr<LocalDeviceState*> local_device =
+        tensorflow::down_cast<PjRtStreamExecutorDevice*>(device)
+            ->GetLocalDeviceState();
+    if (local_device.ok()) {
+      device_ordinals.push_back((*local_device)->device_ordinal());
+    }
+  }
+  absl::Status status =
+      se::gpu::PrecompileSpirModules(device_ordinals, modules);
+  if (!status.ok()) {
+    // Not fatal, modules are compiled again when they are first launched.
+    LOG(WARNING) << "Failed to precompile SYCL modules: " << status;
+  }
+}
+
+xla::StatusOr<std::unique_ptr<PjRtLoadedExecutable>>
+StreamExecutorXpuClient::Compile(const XlaComputation& computation,
+                                 CompileOptions options) {
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<PjRtLoadedExecutable> executable,
+      PjRtStreamExecutorClient::Compile(computation, std::move(options)));
+  PrecompileXpuModules(executable.get());
+  return executable;
+}
+
+// Returns true if `data` can be used by `device` in place: it must be a USM
+// host or shared allocation of the device context with a dense major-to-minor
+// layout, and the caller must guarantee it stays immutable and alive.
+bool CanAliasHostBuffer(const void* data, PrimitiveType type,
+                        absl::Span<int64_t const> dims,
+                        std::optional<absl::Span<int64_t const>> byte_strides,
+                        PjRtClient::HostBufferSemantics host_buffer_semantics,
+                        const Layout* device_layout) {
+  static const bool enabled = [] {
+    bool enabled = true;
+    TF_CHECK_OK(tsl::ReadBoolFromEnvVar("XLA_XPU_ZERO_COPY_HOST_BUFFERS", true,
+                                        &enabled));
+    return enabled;
+  }();
+  if (!enabled || data == nullptr ||
+      host_buffer_semantics !=
+          PjRtClient::HostBufferSemantics::kImmutableZeroCopy ||
+      !primitive_util::IsArrayType(type) ||
+      primitive_util::IsSubByteNonPredType(type)) {
+    return false;
+  }
+  if (reinterpret_cast<uintptr_t>(data) % tsl::Allocator::kAllocatorAlignment) {
+    return false;
+  }
+  if (device_layout != nullptr &&
+      *device_layout != LayoutUtil::GetDefaultLayoutForRank(dims.size())) {
+    return false;
+  }
+  if (byte_strides.has_value()) {
+    int64_t stride = primitive_util::ByteWidth(type);
+    for (int i = dims.size() - 1; i >= 0; --i) {
+      if (dims[i] > 1 && (*byte_strides)[i] != stride) return false;
+      stride *= dims[i];
+    }
+  }
+
+  sycl::context* context;
+  SYCLGetContext(&context);
+  sycl::usm::alloc kind = sycl::get_pointer_type(data, *context);
+  return kind == sycl::usm::alloc::host || kind == sycl::usm::alloc::shared;
+}
+
+xla::StatusOr<std::unique_ptr<PjRtBuffer>>
+StreamExecutorXpuClient::BufferFromHostBuffer(
+    const void* data, PrimitiveType type, absl::Span<int64_t const> dims,
+    std::optional<absl::Span<int64_t const>> byte_strides,
+    HostBufferSemantics host_buffer_semantics,
+    absl::AnyInvocable<void() &&> on_done_with_host_buffer, PjRtDevice* device,
+    const Layout* device_layout) {
+  if (!CanAliasHostBuffer(data, type, dims, byte_strides,
+                          host_buffer_semantics, device_layout)) {
+    return PjRtStreamExecutorClient::BufferFromHostBuffer(
+        data, type, dims, byte_strides, host_buffer_semantics,
+        std::move(on_done_with_host_buffer), device, device_layout);
+  }
+
+  VLOG(2) << "Aliasing USM host buffer " << data << " on device "
+          << device->id();
+  // The view releases the host buffer once it is deleted and all its usage
+  // events completed.
+  auto on_done = std::make_shared<absl::AnyInvocable<void() &&>>(
+      std::move(on_done_with_host_buffer));
+  return CreateViewOfDeviceBuffer(
+      const_cast<void*>(data), ShapeUtil::MakeShape(type, dims), device,
+      [on_done]() {
+        if (*on_done) std::move(*on_done)();
+      });
+}
+
+xla::StatusOr<XpuUploadStreams*> StreamExecutorXpuClient::GetUploadStreams(
+    PjRtStreamExecutorDevice* device) {
+  TF_ASSIGN_OR_RETURN(LocalDeviceState * local_device,
+                      device->GetLocalDeviceState());
+  absl::MutexLock lock(&upload_streams_mu_);
+  std::unique_ptr<XpuUploadStreams>& upload_streams =
+      upload_streams_[local_device->device_ordinal()];
+  if (upload_streams == nullptr) {
+    TF_ASSIGN_OR_RETURN(upload_streams, XpuUploadStreams::Create(local_device));
+  }
+  return upload_streams.get();
+}
+
+xla::StatusOr<std::unique_ptr<PjRtClient::AsyncHostToDeviceTransferManager>>
+StreamExecutorXpuClient::CreateBuffersForAsyncHostToDevice(
+    absl::Span<const Shape> shapes, PjRtDevice* device) {
+  auto* se_device = tensorflow::down_cast<PjRtStreamExecutorDevice*>(device);
+  TF_ASSIGN_OR_RETURN(XpuUploadStreams * upload_streams,
+                      GetUploadStreams(se_device));
+  return XpuAsyncHostToDeviceTransferManager::Create(shapes, se_device, this,
+                                                     upload_streams);
+}
+
 // Builds a LocalDeviceState for each GPU present.
 StatusOr<std::map<int, std::unique_ptr<LocalDeviceState>>>
 BuildLocalDeviceStates(LocalClient* xla_client) {
   std::map<int, std::unique_ptr<LocalDeviceState>> addressable_devices;
   for (se::StreamExecutor* executor :
        xla_client->backend().stream_executors()) {
-    addressable_devices.emplace(
-        executor->device_ordinal(),
-        std::make_unique<LocalDeviceState>(
-            executor, xla_client, LocalDeviceState::kComputeSynchronized,
-            /*max_inflight_computations=*/32,
-            /*allow_event_reuse=*/true, /*use_callback_stream=*/true));
+    auto device_state = std::make_unique<LocalDeviceState>(
+        executor, xla_client, LocalDeviceState::kComputeSynchronized,
+        /*max_inflight_computations=*/32,
+        /*allow_event_reuse=*/true, /*use_callback_stream=*/true);
+    // The execute thread enqueues the transfers and launches of the device,
+    // keep it next to the device to avoid going through the other socket.
+    SYCLDeviceTopology topology;
+    if (SYCLGetDeviceTopology(executor->device_ordinal(), &topology) ==
+            SYCL_SUCCESS &&
+        topology.numa_node >= 0) {
+      device_state->execute_thread()->Schedule(
+          [ordinal = executor->device_ordinal(),
+           numa_node = topology.numa_node] {
+            if (SYCLBindThreadToNumaNode(numa_node)) {
+              VLOG(1) << "Bound the execute thread of device " << ordinal
+                      << " to NUMA node " << numa_node;
+            }
+          });
+    }
+    addressable_devices.emplace(executor->device_ordinal(),
+                                std::move(device_state));
   }
   return std::move(addressable_devices);
 }
 
+// Creates a stream ordered allocator for `device_state`, ordered on its compute
+// stream and limited to `memory_fraction` of the device memory.
+StatusOr<std::unique_ptr<tsl::Allocator>> CreateStreamOrderedAllocator(
+    LocalDeviceState* device_state, double memory_fraction) {
+  se::StreamExecutor* executor = device_state->executor();
+  int64_t free_memory;
+  int64_t total_memory;
+  if (!executor->DeviceMemoryUsage(&free_memory, &total_memory)) {
+    return Unavailable("Failed to query available memory from device %i",
+                       executor->device_ordinal());
+  }
+  sycl::device* device;
+  if (SYCLGetDevice(&device, executor->device_ordinal()) != SYCL_SUCCESS) {
+    return Internal("Failed to get SYCL device %i", executor->device_ordinal());
+  }
+  auto memory_limit = static_cast<int64_t>(total_memory * memory_fraction);
+  return std::make_unique<se::gpu::SYCLStreamOrderedAllocator>(
+      device, se::gpu::AsGpuStreamValue(device_state->compute_stream()),
+      memory_limit, absl::StrCat("XPU_", executor->device_ordinal(), "_async"));
+}
+
+// Adds an allocator of pinned USM host memory for the host memory space of
+// every device, in which XLA places the buffers it offloads.
+void AddHostMemorySpaceAllocators(
+    const std::map<int, std::unique_ptr<LocalDeviceState>>&
+        addressable_devices,
+    std::vector<se::MultiDeviceAdapter::AllocatorWithStream>*
+        allocators_and_streams) {
+  for (const auto& ordinal_and_device : addressable_devices) {
+    allocators_and_streams->emplace_back(
+        GetGpuHostAllocator(ordinal_and_device.second->executor()),
+        ordinal_and_device.second->compute_stream(),
+        /*memory_space=*/Layout::kHostMemorySpace);
+  }
+}
+
+// Returns whether a device spans several tiles in implicit scaling mode.
+bool HasMultiTileDevices(
+    const std::map<int, std::unique_ptr<LocalDeviceState>>&
+        addressable_devices) {
+  if (!IsImplicitScalingEnabled()) return false;
+  for (const auto& ordinal_and_device : addressable_devices) {
+    sycl::device* device;
+    SYCLComputeResources resources;
+    if (SYCLGetDevice(&device, ordinal_and_device.first) == SYCL_SUCCESS &&
+        SYCLGetComputeResources(*device, &resources) == SYCL_SUCCESS &&
+        resources.tile_count > 1) {
+      return true;
+    }
+  }
+  return false;
+}
+
 // Constructs a GPU device memory allocator to use, according to the allocator
 // configuration the client requested.
 StatusOr<std::unique_ptr<se::DeviceMemoryAllocator>>
@@ -83,11 +352,49 @@ GetStreamExecutorXpuDeviceAllocator(
     se::Platform* platform, const GpuAllocatorConfig& allocator_config,
     const std::map<int, std::unique_ptr<LocalDeviceState>>&
         addressable_devices) {
+  GpuAllocatorConfig::Kind kind = allocator_config.kind;
+  // Level-Zero splits every allocation of a root device spanning several
+  // tiles over the memory of its tiles, in the order it splits the work
+  // groups of a kernel, so a kernel mostly accesses the memory of its own
+  // tile. A buffer carved out of a BFC region lies wherever the region does,
+  // the stream ordered allocator allocates each buffer by itself. It gives up
+  // the preallocation of the BFC allocator, so it is opt-in.
+  if (kind == GpuAllocatorConfig::Kind::kDefault &&
+      HasMultiTileDevices(addressable_devices)) {
+    bool multi_tile_async = false;
+    TF_RETURN_IF_ERROR(tsl::ReadBoolFromEnvVar(
+        "XLA_XPU_MULTI_TILE_ASYNC_ALLOCATOR", false, &multi_tile_async));
+    if (multi_tile_async) {
+      LOG(INFO) << "Devices span several tiles and "
+                   "XLA_XPU_MULTI_TILE_ASYNC_ALLOCATOR is set, using the "
+                   "stream ordered allocator to place each buffer over them.";
+      kind = GpuAllocatorConfig::Kind::kCudaAsync;
+    } else {
+      LOG(INFO) << "Devices span several tiles, set "
+                   "XLA_XPU_MULTI_TILE_ASYNC_ALLOCATOR=1 or select the "
+                   "stream ordered allocator to place each buffer over them.";
+    }
+  }
   std::unique_ptr<se::DeviceMemoryAllocator> allocator;
-  switch (allocator_config.kind) {
+  switch (kind) {
     case GpuAllocatorConfig::Kind::kCudaAsync: {
-      LOG(ERROR) << "Async allocator is not supported; falling back to BFC.";
-      [[fallthrough]];
+      LOG(INFO) << "Using stream ordered allocator.";
+      std::vector<se::MultiDeviceAdapter::AllocatorWithStream>
+          allocators_and_streams;
+      for (const auto& ordinal_and_device : addressable_devices) {
+        TF_ASSIGN_OR_RETURN(
+            auto async_allocator,
+            CreateStreamOrderedAllocator(ordinal_and_device.second.get(),
+                                         allocator_config.memory_fraction));
+        allocators_and_streams.emplace_back(
+            std::move(async_allocator),
+            ordinal_and_device.second->compute_stream());
+      }
+      AddHostMemorySpaceAllocators(addressable_devices,
+                                   &allocators_and_streams);
+      allocator = std::make_unique<se::MultiDeviceAdapter>(
+          platform, std::move(allocators_and_streams));
+      break;
     }
 
     case GpuAllocatorConfig::Kind::kDefault:
@@ -107,6 +414,8 @@ GetStreamExecutorXpuDeviceAllocator(
             std::move(bfc_allocator),
             ordinal_and_device.second->compute_stream());
       }
+      AddHostMemorySpaceAllocators(addressable_devices,
+                                   &allocators_and_streams);
       allocator = std::make_unique<se::MultiDeviceAdapter>(
           platform, std::move(allocators_and_streams));
       break;
@@ -119,6 +428,202 @@ GetStreamExecutorXpuDeviceAllocator(
   return std::move(allocator);
 }
 
+inline const char* XpuName() {
+  static constexpr char kXpuName[] = "xpu";
+  return kXpuName;
+}
+
+inline PjRtPlatformId XpuId() {
+  static const PjRtPlatformId kXpuId = tsl::Fingerprint64(XpuName());
+  return kXpuId;
+}
+
+// Distributes clique ids to all nodes of a multi-node client. The node owning
+// the first device of a clique generates its id and publishes it through the
+// distributed key-value store, the other nodes read it from there. Ids of
+// cliques whose nodes all run on the same host are marked as host-local, the
+// collectives only support cliques spanning processes of a single host.
+class CclIdStore {
+ public:
+  CclIdStore(int node_id,
+             absl::flat_hash_map<GlobalDeviceId, int> device_to_node,
+             absl::flat_hash_map<int, std::string> node_to_host,
+             PjRtClient::KeyValueGetCallback kv_get,
+             PjRtClient::KeyValuePutCallback kv_put)
+      : node_id_(node_id),
+        device_to_node_(std::move(device_to_node)),
+        node_to_host_(std::move(node_to_host)),
+        kv_get_(std::move(kv_get)),
+        kv_put_(std::move(kv_put)) {}
+
+  StatusOr<gpu::NcclCliqueId> GetCliqueId(const gpu::NcclCliqueKey& key) {
+    std::string kv_key = absl::StrCat("xpu:ccl_clique_id:", key.ToString());
+    {
+      absl::MutexLock lock(&mu_);
+      auto it = cache_.find(kv_key);
+      if (it != cache_.end()) return it->second;
+    }
+
+    TF_RET_CHECK(!key.devices().empty());
+    auto it = device_to_node_.find(key.devices()[0]);
+    TF_RET_CHECK(it != device_to_node_.end());
+    std::string id_string;
+    if (it->second == node_id_) {
+      // Ids must differ between clients reusing the same devices, so they are
+      // derived from a random value rather than from the clique key.
+      id_string = absl::StrFormat("%snode%d:%016x:%016x",
+                                  IsHostLocal(key)
+                                      ? ccl::kHostLocalCliqueIdPrefix
+                                      : "",
+                                  node_id_, tsl::random::New64(),
+                                  tsl::Fingerprint64(key.ToString()));
+      id_string.resize(gpu::NcclCliqueId::kSize);
+      TF_RETURN_IF_ERROR(kv_put_(kv_key, id_string));
+    } else {
+      TF_ASSIGN_OR_RETURN(id_string, kv_get_(kv_key, absl::Minutes(10)));
+    }
+    TF_ASSIGN_OR_RETURN(gpu::NcclCliqueId id,
+                        gpu::NcclCliqueId::FromString(id_string));
+
+    absl::MutexLock lock(&mu_);
+    auto result = cache_.emplace(kv_key, id);
+    return result.first->second;
+  }
+
+ private:
+  bool IsHostLocal(const gpu::NcclCliqueKey& key) const {
+    const std::string& host = node_to_host_.at(node_id_);
+    for (GlobalDeviceId device : key.devices()) {
+      auto it = device_to_node_.find(device);
+      if (it == device_to_node_.end() ||
+          node_to_host_.at(it->second) != host) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  const int node_id_;
+  const absl::flat_hash_map<GlobalDeviceId, int> device_to_node_;
+  const absl::flat_hash_map<int, std::string> node_to_host_;
+  const PjRtClient::KeyValueGetCallback kv_get_;
+  const PjRtClient::KeyValuePutCallback kv_put_;
+
+  absl::Mutex mu_;
+  absl::flat_hash_map<std::string, gpu::NcclCliqueId> cache_
+      ABSL_GUARDED_BY(mu_);
+};
+
+// Exchanges the local topologies of all nodes through the key-value store and
+// builds the devices of the whole cluster. Global device ids are assigned by
+// ExchangeTopologies, ordered by node id and local device ordinal.
+Status BuildDistributedDevices(
+    std::map<int, std::unique_ptr<LocalDeviceState>> local_device_states,
+    int node_id, int num_nodes,
+    std::vector<std::unique_ptr<PjRtStreamExecutorDevice>>* devices,
+    gpu::GpuExecutableRunOptions* gpu_executable_run_options,
+    PjRtClient::KeyValueGetCallback kv_get,
+    PjRtClient::KeyValuePutCallback kv_put) {
+  LocalTopologyProto local_topology;
+  local_topology.set_node_id(node_id);
+  StatusOr<std::string> boot_id = GetBootIdString();
+  if (boot_id.ok()) {
+    local_topology.set_boot_id(*boot_id);
+  } else {
+    // Only used to tell nodes apart that share a host.
+    LOG(INFO) << "Failed to read the boot id: " << boot_id.status();
+  }
+  for (const auto& ordinal_and_device : local_device_states) {
+    const se::DeviceDescription& description =
+        ordinal_and_device.second->executor()->GetDeviceDescription();
+    DeviceProto* device_proto = local_topology.add_devices();
+    device_proto->set_local_device_ordinal(ordinal_and_device.first);
+    device_proto->set_name(description.name());
+    device_proto->set_vendor(description.device_vendor());
+  }
+
+  GlobalTopologyProto global_topology;
+  TF_RETURN_IF_ERROR(ExchangeTopologies(
+      XpuName(), node_id, num_nodes,
+      /*get_local_topology_timeout=*/absl::Minutes(2),
+      /*get_global_topology_timeout=*/absl::Minutes(5), kv_get, kv_put,
+      local_topology, &global_topology));
+
+  // Nodes are on the same host if both their host names and boot ids match,
+  // e.g. containers of the same machine share the boot id but not the shared
+  // memory the IPC rendezvous of the collectives goes through.
+  TF_RETURN_IF_ERROR(kv_put(absl::StrCat("xpu:hostname:", node_id),
+                            tsl::port::Hostname()));
+  absl::flat_hash_map<int, std::string> node_to_host;
+  for (const LocalTopologyProto& node : global_topology.nodes()) {
+    TF_ASSIGN_OR_RETURN(
+        std::string hostname,
+        kv_get(absl::StrCat("xpu:hostname:", node.node_id()),
+               absl::Minutes(2)));
+    node_to_host[node.node_id()] = absl::StrCat(hostname, "/", node.boot_id());
+  }
+
+  std::map<int, GlobalDeviceId> gpu_device_ids;
+  absl::flat_hash_map<GlobalDeviceId, int> device_to_node;
+  for (const LocalTopologyProto& node : global_topology.nodes()) {
+    for (const DeviceProto& device_proto : node.devices()) {
+      GlobalDeviceId global_device_id(device_proto.global_device_id());
+      device_to_node[global_device_id] = node.node_id();
+      std::unique_ptr<LocalDeviceState> local_device;
+      if (node.node_id() == node_id) {
+        auto it = local_device_states.find(device_proto.local_device_ordinal());
+        TF_RET_CHECK(it != local_device_states.end())
+            << device_proto.local_device_ordinal();
+        TF_RET_CHECK(it->second != nullptr);
+        local_device = std::move(it->second);
+        gpu_device_ids[device_proto.local_device_ordinal()] = global_device_id;
+      }
+      devices->push_back(std::make_unique<StreamExecutorXpuDevice>(
+          device_proto.global_device_id(), std::move(local_device),
+          device_proto.name(), device_proto.vendor(), node.node_id(),
+          device_proto.slice_index()));
+    }
+  }
+  for (const auto& ordinal_and_device : local_device_states) {
+    TF_RET_CHECK(ordinal_and_device.second == nullptr);
+  }
+  gpu_executable_run_options->set_gpu_global_device_ids(
+      std::move(gpu_device_ids));
+
+  auto id_store = std::make_shared<CclIdStore>(
+      node_id, std::move(device_to_node), std::move(node_to_host),
+      std::move(kv_get), std::move(kv_put));
+  gpu_executable_run_options->set_nccl_clique_id_callback(
+      [id_store](const gpu::NcclCliqueKey& key, const RunId&) {
+        return id_store->GetCliqueId(key);
+      });
+  return OkStatus();
+}
+
+// Lets the devices access the memory of the peers Level-Zero reports as
+// accessible, so copies between them run over Xe Link or the on-package link
+// of the tiles instead of through the host.
+void EnablePeerAccess(absl::Span<se::StreamExecutor* const> executors) {
+  for (int i = 0; i < executors.size(); ++i) {
+    for (int j = 0; j < executors.size(); ++j) {
+      if (i == j) continue;
+      se::StreamExecutor* from = executors[i];
+      se::StreamExecutor* to = executors[j];
+      if (!from->CanEnablePeerAccessTo(to)) {
+        VLOG(2) << "No peer access from XPU " << i << " to XPU " << j;
+        continue;
+      }
+      absl::Status status = from->EnablePeerAccessTo(to);
+      if (!status.ok()) {
+        LOG(WARNING) << "Unable to enable peer access from XPU " << i
+                     << " to XPU " << j << ": " << status;
+      } else {
+        VLOG(2) << "Enabled peer access from XPU " << i << " to XPU " << j;
+      }
+    }
+  }
+}
+
 std::vector<std::unique_ptr<PjRtStreamExecutorDevice>> BuildLocalDevices(
     std::map<int, std::unique_ptr<LocalDeviceState>> local_device_states,
     int node_id) {
@@ -134,16 +639,6 @@ std::vector<std::unique_ptr<PjRtStreamExecutorDevice>> BuildLocalDevices(
   return devices;
 }
 
-inline const char* XpuName() {
-  static constexpr char kXpuName[] = "xpu";
-  return kXpuName;
-}
-
-inline PjRtPlatformId XpuId() {
-  static const PjRtPlatformId kXpuId = tsl::Fingerprint64(XpuName());
-  return kXpuId;
-}
-
 }  // namespace
 
 StreamExecutorXpuDevice::StreamExecutorXpuDevice(
@@ -154,10 +649,24 @@ StreamExecutorXpuDevice::StreamExecutorXpuDevice(
                                std::move(device_kind), node_id),
       device_vendor_(std::move(device_vendor)),
       slice_index_(slice_index) {
-  description().SetAttributes({
+  absl::flat_hash_map<std::string, PjRtDeviceAttribute> attributes = {
       {"device_vendor", std::string("Intel")},
       {"slice_index", static_cast<int64_t>(slice_index)},
-  });
+  };
+  // Only the devices of this process know their topology.
+  SYCLDeviceTopology topology;
+  if (local_device_state() != nullptr &&
+      SYCLGetDeviceTopology(local_device_state()->device_ordinal(),
+                            &topology) == SYCL_SUCCESS) {
+    attributes["root_device_index"] =
+        static_cast<int64_t>(topology.root_device_index);
+    attributes["tile_index"] = static_cast<int64_t>(topology.tile_index);
+    attributes["numa_node"] = static_cast<int64_t>(topology.numa_node);
+    attributes["pci_address"] = topology.pci_address;
+    attributes["fabric_peers"] = std::vector<int64_t>(
+        topology.fabric_peers.begin(), topology.fabric_peers.end());
+  }
+  description().SetAttributes(std::move(attributes));
   description().SetToString(
       absl::StrFormat("IntelXpuDevice(id=%i, process_index=%i, slice_index=%i)",
                       id, process_index(), slice_index));
@@ -169,6 +678,30 @@ absl::string_view StreamExecutorXpuDevice::device_vendor() {
   return device_vendor_;
 }
 
+StatusOr<tsl::AllocatorStats> StreamExecutorXpuDevice::GetAllocatorStats()
+    const {
+  if (!IsAddressable()) {
+    return FailedPrecondition(
+        "GetAllocatorStats() is allowed only for addressable devices");
+  }
+  auto* allocator_adapter = dynamic_cast<se::MultiDeviceAdapter*>(
+      tensorflow::down_cast<PjRtStreamExecutorClient*>(client())->allocator());
+  if (allocator_adapter == nullptr) {
+    return Unimplemented(
+        "GetAllocatorStats() is only implemented with MultiDeviceAdapter "
+        "allocator");
+  }
+  TF_ASSIGN_OR_RETURN(
+      tsl::Allocator * allocator,
+      allocator_adapter->GetAllocator(local_device_state()->device_ordinal()));
+  std::optional<tsl::AllocatorStats> stats = allocator->GetStats();
+  if (!stats.has_value()) {
+    return Unimplemented("Allocator %s does not keep stats",
+                         allocator->Name());
+  }
+  return *stats;
+}
+
 StatusOr<std::unique_ptr<PjRtClient>> GetStreamExecutorXpuClient(
     bool asynchronous, const GpuAllocatorConfig& allocator_config, int node_id,
     int num_nodes, const std::optional<std::set<int>>& allowed_devices,
@@ -180,7 +713,10 @@ StatusOr<std::unique_ptr<PjRtClient>> GetStreamExecutorXpuClient(
                       GetGpuXlaClient(platform_name, allowed_devices));
   std::map<int, std::unique_ptr<LocalDeviceState>> local_device_states;
   TF_ASSIGN_OR_RETURN(local_device_states, BuildLocalDeviceStates(xla_client));
-  // EnablePeerAccess(xla_client->backend().stream_executors());
+  // Load the GEMM autotune database up front rather than during the first
+  // compilation.
+  gpu::GemmAutotuneDatabase::Get();
+  EnablePeerAccess(xla_client->backend().stream_executors());
   TF_ASSIGN_OR_RETURN(
       // SYCL: hardcode to static variable due to a bug for sycl alloc api.
       static std::unique_ptr<se::DeviceMemoryAllocator> allocator,
@@ -194,10 +730,9 @@ StatusOr<std::unique_ptr<PjRtClient>> GetStreamExecutorXpuClient(
   if (num_nodes > 1) {
     TF_RET_CHECK(kv_get != nullptr);
     TF_RET_CHECK(kv_put != nullptr);
-    // TF_RETURN_IF_ERROR(BuildDistributedDevices(
-    //     std::move(local_device_states), node_id, num_nodes, &devices,
-    //     gpu_run_options.get(), kv_get, kv_put));
-    return Unimplemented("BuildDistributedDevices not");
+    TF_RETURN_IF_ERROR(BuildDistributedDevices(
+        std::move(local_device_states), node_id, num_nodes, &devices,
+        gpu_run_options.get(), kv_get, kv_put));
   } else {
     devices = BuildLocalDevices(std::move(local_device_states), node_id);
   }
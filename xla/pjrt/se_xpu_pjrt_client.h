@@ -20,6 +20,7 @@ limitations under the License.
 #include <set>
 #include <string>
 
+#include "tsl/framework/allocator.h"
 #include "xla/pjrt/gpu/gpu_helpers.h"
 #include "xla/pjrt/pjrt_stream_executor_client.h"
 #include "xla/statusor.h"
@@ -42,6 +43,10 @@ class StreamExecutorXpuDevice : public PjRtStreamExecutorDevice {
   int slice_index() const;
   absl::string_view device_vendor();
 
+  // Stats of the device allocator of the client, which jax reports as
+  // Device.memory_stats().
+  StatusOr<tsl::AllocatorStats> GetAllocatorStats() const override;
+
  private:
   std::string device_vendor_;
   int slice_index_;
@@ -0,0 +1,330 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/pjrt/xpu_async_host_to_device_transfer_manager.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/statusor.h"
+#include "tsl/profiler/lib/traceme.h"
+#include "tsl/util/env_var.h"
+#include "xla/service/shaped_buffer.h"
+#include "xla/service/transfer_manager.h"
+#include "xla/stream_executor/device_memory.h"
+#include "xla/util.h"
+
+namespace xla {
+
+absl::StatusOr<std::unique_ptr<XpuUploadStreams>> XpuUploadStreams::Create(
+    LocalDeviceState* local_device) {
+  int64_t num_streams;
+  TF_RETURN_IF_ERROR(
+      tsl::ReadInt64FromEnvVar("XLA_XPU_H2D_STREAMS", 2, &num_streams));
+  if (num_streams < 1) {
+    return InvalidArgument("XLA_XPU_H2D_STREAMS must be positive, got %d",
+                           num_streams);
+  }
+  se::StreamExecutor* executor = local_device->executor();
+  auto upload_streams = absl::WrapUnique(new XpuUploadStreams());
+  for (int i = 0; i < num_streams; ++i) {
+    Upload upload;
+    // Streams without a priority share the default queue, the low priority
+    // gives the uploads a queue of their own that yields to the compute.
+    TF_ASSIGN_OR_RETURN(upload.stream,
+                        executor->CreateStream(se::StreamPriority::Lowest));
+    upload.thread = std::make_unique<WorkerThread>(
+        tsl::Env::Default(),
+        absl::StrCat("xpu_h2d_", executor->device_ordinal(), "_", i));
+    upload_streams->uploads_.push_back(std::move(upload));
+  }
+  return upload_streams;
+}
+
+XpuUploadStreams::~XpuUploadStreams() {
+  for (Upload& upload : uploads_) {
+    // Joins the thread once it has enqueued all its copies.
+    upload.thread.reset();
+    absl::Status status = upload.stream->BlockHostUntilDone();
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to wait for an upload stream: " << status;
+    }
+  }
+}
+
+void XpuUploadStreams::Schedule(int i, absl::AnyInvocable<void() &&> fn) {
+  auto* task = new absl::AnyInvocable<void() &&>(std::move(fn));
+  uploads_[i].thread->Schedule([task]() {
+    std::move(*task)();
+    delete task;
+  });
+}
+
+absl::StatusOr<std::unique_ptr<XpuAsyncHostToDeviceTransferManager>>
+XpuAsyncHostToDeviceTransferManager::Create(
+    absl::Span<const Shape> shapes, PjRtStreamExecutorDevice* device,
+    PjRtStreamExecutorClient* client, XpuUploadStreams* upload_streams) {
+  TF_ASSIGN_OR_RETURN(LocalDeviceState * local_device,
+                      device->GetLocalDeviceState());
+  TransferManager* transfer_manager =
+      client->client()->backend().transfer_manager();
+  std::vector<Buffer> buffers;
+  std::vector<size_t> buffer_sizes;
+  buffers.reserve(shapes.size());
+  buffer_sizes.reserve(shapes.size());
+  for (const Shape& shape : shapes) {
+    if (shape.IsTuple()) {
+      return Unimplemented("Async buffer transfer of tuples not implemented.");
+    }
+    Buffer buffer;
+    buffer.upload_stream = upload_streams->Next();
+    // The event blocks the consumers of the buffer until its last transfer.
+    buffer.definition_event =
+        std::make_shared<BufferSequencingEvent>(client->thread_pool());
+    TF_ASSIGN_OR_RETURN(Shape compact_shape,
+                        transfer_manager->ChooseCompactLayoutForShape(shape));
+    // The upload stream waits for the compute stream here, the memory may
+    // have been freed by computations still running on it.
+    TF_ASSIGN_OR_RETURN(
+        std::unique_ptr<PjRtStreamExecutorBuffer> pjrt_buffer,
+        AllocateDestinationBuffer(
+            compact_shape, device, local_device,
+            upload_streams->stream(buffer.upload_stream),
+            /*is_uninitialized_create=*/true, client,
+            buffer.definition_event));
+    // The hold only fetches the TrackedDeviceBuffer, which the manager keeps
+    // until the buffer is defined.
+    PjRtStreamExecutorBuffer::ScopedHold hold =
+        pjrt_buffer->GetBufferWithUsageHold();
+    CHECK(hold.ok());
+    buffer.device_buffer = hold.buffer();
+    const auto& device_memory = buffer.device_buffer->device_memory();
+    buffer_sizes.push_back(device_memory.empty() ? 0 : device_memory[0].size());
+    buffer.buffer = std::move(pjrt_buffer);
+    buffers.push_back(std::move(buffer));
+  }
+  return absl::WrapUnique(new XpuAsyncHostToDeviceTransferManager(
+      device, client, upload_streams, std::move(buffers),
+      std::move(buffer_sizes)));
+}
+
+XpuAsyncHostToDeviceTransferManager::XpuAsyncHostToDeviceTransferManager(
+    PjRtStreamExecutorDevice* device, PjRtStreamExecutorClient* client,
+    XpuUploadStreams* upload_streams, std::vector<Buffer> buffers,
+    std::vector<size_t> buffer_sizes)
+    : device_(device),
+      client_(client),
+      local_device_(device->local_device_state()),
+      upload_streams_(upload_streams),
+      buffer_sizes_(std::move(buffer_sizes)),
+      buffers_(std::move(buffers)) {}
+
+XpuAsyncHostToDeviceTransferManager::~XpuAsyncHostToDeviceTransferManager() {
+  absl::MutexLock lock(&mu_);
+  mu_.Await(absl::Condition(
+      +[](int* transfers_in_flight) { return *transfers_in_flight == 0; },
+      &transfers_in_flight_));
+}
+
+std::unique_ptr<PjRtBuffer> XpuAsyncHostToDeviceTransferManager::RetrieveBuffer(
+    int buffer_index) {
+  absl::MutexLock lock(&mu_);
+  DCHECK_LT(buffer_index, buffers_.size());
+  return std::move(buffers_[buffer_index].buffer);
+}
+
+absl::StatusOr<TrackedDeviceBuffer*>
+XpuAsyncHostToDeviceTransferManager::StartTransfer(int buffer_index,
+                                                   int64_t offset,
+                                                   int64_t size,
+                                                   bool is_last_transfer) {
+  absl::MutexLock lock(&mu_);
+  if (buffer_index < 0 || buffer_index >= buffers_.size()) {
+    return InvalidArgument("Invalid buffer index %d of %d buffers",
+                           buffer_index, buffers_.size());
+  }
+  Buffer& buffer = buffers_[buffer_index];
+  if (buffer.last_transfer_started) {
+    return InvalidArgument(
+        "Transfer requested for buffer index %d which has already been fully "
+        "transferred",
+        buffer_index);
+  }
+  if (buffer.device_buffer->device_memory().empty()) {
+    return InvalidArgument(
+        "Transfer requested for buffer index %d which has been donated. Async "
+        "transfer of donated buffers is not supported on XPU",
+        buffer_index);
+  }
+  const int64_t buffer_size = buffer.device_buffer->device_memory()[0].size();
+  if (offset < 0 || size < 0 || offset > buffer_size ||
+      size > buffer_size - offset) {
+    return InvalidArgument(
+        "Transfer of %d bytes at offset %d out of the %d bytes of buffer "
+        "index %d",
+        size, offset, buffer_size, buffer_index);
+  }
+  buffer.last_transfer_started = is_last_transfer;
+  ++transfers_in_flight_;
+  return buffer.device_buffer.get();
+}
+
+void XpuAsyncHostToDeviceTransferManager::EnqueueTransfer(
+    int buffer_index, bool is_last_transfer,
+    absl::AnyInvocable<absl::Status(se::Stream*) &&> copy,
+    absl::AnyInvocable<void() &&> on_done) {
+  int upload_stream;
+  {
+    absl::MutexLock lock(&mu_);
+    upload_stream = buffers_[buffer_index].upload_stream;
+  }
+  se::Stream* stream = upload_streams_->stream(upload_stream);
+  upload_streams_->Schedule(upload_stream, [this, buffer_index,
+                                            is_last_transfer, stream,
+                                            copy = std::move(copy),
+                                            on_done =
+                                                std::move(on_done)]() mutable {
+    absl::Status status = std::move(copy)(stream);
+    absl::StatusOr<EventPool::Handle> event =
+        status.ok()
+            ? local_device_->event_pool().AllocateEvent(stream->parent())
+            : absl::StatusOr<EventPool::Handle>(status);
+    if (!event.ok()) {
+      FinishTransfer(buffer_index, stream, is_last_transfer, std::move(event),
+                     std::move(on_done));
+      return;
+    }
+    local_device_->event_pool().ThenRecordEvent(stream, *event);
+    // Shared with the callback so that the transfer can still be finished if
+    // the callback can't be enqueued.
+    auto pending_on_done =
+        std::make_shared<absl::AnyInvocable<void() &&>>(std::move(on_done));
+    auto finish = [this, buffer_index, stream, is_last_transfer,
+                   event = std::move(event), pending_on_done]() mutable {
+      FinishTransfer(buffer_index, stream, is_last_transfer, std::move(event),
+                     std::move(*pending_on_done));
+    };
+    // The event completes with the copy, the callback only has to run after
+    // it on the stream.
+    status = stream->DoHostCallback(std::move(finish));
+    if (!status.ok()) {
+      FinishTransfer(buffer_index, stream, is_last_transfer, status,
+                     std::move(*pending_on_done));
+    }
+  });
+}
+
+void XpuAsyncHostToDeviceTransferManager::FinishTransfer(
+    int buffer_index, se::Stream* stream, bool is_last_transfer,
+    absl::StatusOr<EventPool::Handle> event,
+    absl::AnyInvocable<void() &&> on_done) {
+  {
+    absl::MutexLock lock(&mu_);
+    CHECK_GT(transfers_in_flight_, 0);
+    --transfers_in_flight_;
+    Buffer& buffer = buffers_[buffer_index];
+    if (!event.ok() && buffer.status.ok()) buffer.status = event.status();
+    if (is_last_transfer) {
+      // The consumers of the buffer hold it from now on.
+      buffer.device_buffer = nullptr;
+      if (buffer.status.ok()) {
+        buffer.definition_event->SetSequencingEvent(std::move(*event), stream);
+      } else {
+        buffer.definition_event->SetDefinedStatus(buffer.status);
+      }
+    }
+  }
+  // Called without the lock, `on_done` may start the next transfer.
+  std::move(on_done)();
+}
+
+absl::Status XpuAsyncHostToDeviceTransferManager::TransferLiteralToBuffer(
+    int buffer_index, const LiteralSlice& literal,
+    absl::AnyInvocable<void() &&> on_done) {
+  tsl::profiler::TraceMe traceme(
+      "XpuAsyncHostToDeviceTransferManager::TransferLiteralToBuffer");
+  TransferManager* transfer_manager =
+      client_->client()->backend().transfer_manager();
+  TF_ASSIGN_OR_RETURN(
+      Shape compact_shape,
+      transfer_manager->ChooseCompactLayoutForShape(literal.shape()));
+  TF_ASSIGN_OR_RETURN(TrackedDeviceBuffer * device_buffer,
+                      StartTransfer(buffer_index, /*offset=*/0, /*size=*/0,
+                                    /*is_last_transfer=*/true));
+  // Linearizing the literal may be slow, it is done on the upload thread.
+  auto copy = [transfer_manager, literal, device_buffer,
+               compact_shape](se::Stream* stream) {
+    ShapedBuffer shaped_buffer = device_buffer->AsShapedBuffer(compact_shape);
+    return transfer_manager->TransferLiteralToDeviceAsync(stream, literal,
+                                                          shaped_buffer);
+  };
+  EnqueueTransfer(buffer_index, /*is_last_transfer=*/true, std::move(copy),
+                  std::move(on_done));
+  return absl::OkStatus();
+}
+
+absl::Status XpuAsyncHostToDeviceTransferManager::TransferRawDataToBuffer(
+    int buffer_index, absl::string_view data,
+    absl::AnyInvocable<void() &&> on_done) {
+  return TransferRawDataToSubBuffer(buffer_index, data.data(), /*offset=*/0,
+                                    data.size(), /*is_last_transfer=*/true,
+                                    std::move(on_done));
+}
+
+absl::Status XpuAsyncHostToDeviceTransferManager::TransferRawDataToSubBuffer(
+    int buffer_index, const void* data, int64_t offset, int64_t transfer_size,
+    bool is_last_transfer, absl::AnyInvocable<void() &&> on_done) {
+  TF_ASSIGN_OR_RETURN(
+      TrackedDeviceBuffer * device_buffer,
+      StartTransfer(buffer_index, offset, transfer_size, is_last_transfer));
+  se::DeviceMemoryBase sub_buffer(
+      static_cast<char*>(device_buffer->device_memory()[0].opaque()) + offset,
+      transfer_size);
+  // Pageable data is copied to pinned staging buffers by the upload thread,
+  // the copies of the other streams go on meanwhile.
+  auto copy = [data, sub_buffer, transfer_size](se::Stream* stream) mutable {
+    if (transfer_size == 0) return absl::OkStatus();
+    stream->ThenMemcpy(&sub_buffer, data, transfer_size);
+    return stream->ok() ? absl::OkStatus()
+                        : Internal("Failed to enqueue an upload of %d bytes",
+                                   transfer_size);
+  };
+  EnqueueTransfer(buffer_index, is_last_transfer, std::move(copy),
+                  std::move(on_done));
+  return absl::OkStatus();
+}
+
+void XpuAsyncHostToDeviceTransferManager::SetBufferError(int buffer_index,
+                                                         absl::Status error) {
+  VLOG(1) << "SetBufferError sets the error of buffer " << buffer_index << ": "
+          << error;
+  absl::MutexLock lock(&mu_);
+  Buffer& buffer = buffers_[buffer_index];
+  if (buffer.last_transfer_started) {
+    LOG(ERROR) << "SetBufferError called for buffer index " << buffer_index
+               << " after its last transfer: " << error;
+    return;
+  }
+  buffer.last_transfer_started = true;
+  buffer.definition_event->SetDefinedStatus(std::move(error));
+}
+
+}  // namespace xla
@@ -0,0 +1,177 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_PJRT_XPU_ASYNC_HOST_TO_DEVICE_TRANSFER_MANAGER_H_
+#define XLA_PJRT_XPU_ASYNC_HOST_TO_DEVICE_TRANSFER_MANAGER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/functional/any_invocable.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "xla/literal.h"
+#include "xla/pjrt/event_pool.h"
+#include "xla/pjrt/local_device_state.h"
+#include "xla/pjrt/pjrt_client.h"
+#include "xla/pjrt/pjrt_stream_executor_client.h"
+#include "xla/pjrt/tracked_device_buffer.h"
+#include "xla/pjrt/worker_thread.h"
+#include "xla/shape.h"
+#include "xla/stream_executor/stream.h"
+
+namespace xla {
+
+// Streams of a device dedicated to the uploads of the async host to device
+// transfers, apart from the compute stream and from the host to device
+// stream of the LocalDeviceState, which share the default queue. Each stream
+// has a thread of its own enqueueing its copies: the copies of pageable host
+// memory are staged through the pinned buffers of the SYCL runtime by that
+// thread, so the uploads of different streams and devices overlap.
+//
+// XLA_XPU_H2D_STREAMS: number of upload streams per device, 2 by default.
+class XpuUploadStreams {
+ public:
+  static absl::StatusOr<std::unique_ptr<XpuUploadStreams>> Create(
+      LocalDeviceState* local_device);
+
+  ~XpuUploadStreams();
+
+  int size() const { return uploads_.size(); }
+  se::Stream* stream(int i) const { return uploads_[i].stream.get(); }
+
+  // Returns the stream of the next buffer, round-robin.
+  int Next() { return next_.fetch_add(1) % uploads_.size(); }
+
+  // Runs `fn` on the thread of stream `i`, after the functions scheduled
+  // before it.
+  void Schedule(int i, absl::AnyInvocable<void() &&> fn);
+
+ private:
+  struct Upload {
+    std::unique_ptr<se::Stream> stream;
+    std::unique_ptr<WorkerThread> thread;
+  };
+
+  XpuUploadStreams() = default;
+
+  std::vector<Upload> uploads_;
+  // Unsigned so that it wraps around instead of overflowing.
+  std::atomic<uint32_t> next_{0};
+};
+
+// Uploads the buffers of CreateBuffersForAsyncHostToDevice. Every buffer is
+// assigned one of the upload streams of the device and its transfers are
+// enqueued in order on that stream, the buffers of a manager are spread over
+// all the streams. A buffer is defined by an event recorded after its last
+// transfer, consumers on other streams wait for that event.
+class XpuAsyncHostToDeviceTransferManager
+    : public PjRtClient::AsyncHostToDeviceTransferManager {
+ public:
+  static absl::StatusOr<std::unique_ptr<XpuAsyncHostToDeviceTransferManager>>
+  Create(absl::Span<const Shape> shapes, PjRtStreamExecutorDevice* device,
+         PjRtStreamExecutorClient* client, XpuUploadStreams* upload_streams);
+
+  // Waits for the transfers in flight, whose callbacks refer to the manager.
+  ~XpuAsyncHostToDeviceTransferManager() override;
+
+  size_t buffer_count() const override { return buffer_sizes_.size(); }
+
+  size_t buffer_size(int buffer_index) const override {
+    return buffer_sizes_[buffer_index];
+  }
+
+  PjRtDevice* device() const override { return device_; }
+
+  std::unique_ptr<PjRtBuffer> RetrieveBuffer(int buffer_index) override;
+
+  absl::Status TransferLiteralToBuffer(
+      int buffer_index, const LiteralSlice& literal,
+      absl::AnyInvocable<void() &&> on_done) override;
+
+  absl::Status TransferRawDataToBuffer(
+      int buffer_index, absl::string_view data,
+      absl::AnyInvocable<void() &&> on_done) override;
+
+  absl::Status TransferRawDataToSubBuffer(
+      int buffer_index, const void* data, int64_t offset,
+      int64_t transfer_size, bool is_last_transfer,
+      absl::AnyInvocable<void() &&> on_done) override;
+
+  void SetBufferError(int buffer_index, absl::Status error) override;
+
+  void AddTransferMetadata(const TransferMetadata& metadata) override {}
+
+ private:
+  struct Buffer {
+    // Handed to the caller by RetrieveBuffer.
+    std::unique_ptr<PjRtBuffer> buffer;
+    // Kept until the last transfer completes, the definition event of the
+    // buffer keeps it alive for its consumers meanwhile.
+    std::shared_ptr<TrackedDeviceBuffer> device_buffer;
+    std::shared_ptr<BufferSequencingEvent> definition_event;
+    int upload_stream = 0;
+    bool last_transfer_started = false;
+    // First error of the transfers of the buffer, set as its definition.
+    absl::Status status;
+  };
+
+  XpuAsyncHostToDeviceTransferManager(PjRtStreamExecutorDevice* device,
+                                      PjRtStreamExecutorClient* client,
+                                      XpuUploadStreams* upload_streams,
+                                      std::vector<Buffer> buffers,
+                                      std::vector<size_t> buffer_sizes);
+
+  // Checks that `size` bytes at `offset` of buffer `buffer_index` can still
+  // be transferred and counts the transfer in flight.
+  absl::StatusOr<TrackedDeviceBuffer*> StartTransfer(int buffer_index,
+                                                      int64_t offset,
+                                                      int64_t size,
+                                                      bool is_last_transfer);
+
+  // Enqueues `copy` on the upload stream of buffer `buffer_index` followed by
+  // an event, and calls FinishTransfer once the event completes.
+  void EnqueueTransfer(int buffer_index, bool is_last_transfer,
+                       absl::AnyInvocable<absl::Status(se::Stream*) &&> copy,
+                       absl::AnyInvocable<void() &&> on_done);
+
+  // Records the completion of a transfer of buffer `buffer_index`, whose
+  // event is `event` on `stream`, and calls `on_done`. The last transfer of a
+  // buffer defines it.
+  void FinishTransfer(int buffer_index, se::Stream* stream,
+                      bool is_last_transfer,
+                      absl::StatusOr<EventPool::Handle> event,
+                      absl::AnyInvocable<void() &&> on_done);
+
+  PjRtStreamExecutorDevice* const device_;
+  PjRtStreamExecutorClient* const client_;
+  LocalDeviceState* const local_device_;
+  XpuUploadStreams* const upload_streams_;
+  const std::vector<size_t> buffer_sizes_;
+
+  absl::Mutex mu_;
+  std::vector<Buffer> buffers_ ABSL_GUARDED_BY(mu_);
+  int transfers_in_flight_ ABSL_GUARDED_BY(mu_) = 0;
+};
+
+}  // namespace xla
+
+#endif  // XLA_PJRT_XPU_ASYNC_HOST_TO_DEVICE_TRANSFER_MANAGER_H_
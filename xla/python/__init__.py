@@ -25,7 +25,10 @@ from jax_plugins.intel_extension_for_openxla.version import VersionClass
 
 logger = logging.getLogger(__name__)
 
+_c_api = None
+
 def initialize():
+  global _c_api
   path = Path(__file__).resolve().parent / "pjrt_plugin_xpu.so"
   xla_extension_version = VersionClass()
   logger.warning("INFO: Intel Extension for OpenXLA version: %s, commit: %s",
@@ -40,6 +43,8 @@ def initialize():
                      priority=500,
                      library_path=str(path))
   
+  _c_api = c_api
+
   try:
     import functools
     from .python import xpu_plugin_extension
@@ -51,3 +56,15 @@ def initialize():
     )
   except:
     raise RuntimeError("Fail to load xpu_plugin_extension.so.")
+
+
+def memory_stats(device_ordinal):
+  '''Returns the device memory the SYCL runtime allocated for a local device.
+
+  Unlike jax.Device.memory_stats(), which reports the XLA allocator, these are
+  the allocations of the allocator from the driver and the time spent in them.
+  '''
+  if _c_api is None:
+    raise RuntimeError("The xpu plugin is not initialized.")
+  from .python import xpu_plugin_extension
+  return xpu_plugin_extension.memory_stats(_c_api, device_ordinal)
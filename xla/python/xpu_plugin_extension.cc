@@ -13,27 +13,53 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <dlfcn.h>
+
 #include <string>
 #include <string_view>
 #include <utility>
 
 #include "pybind11/pybind11.h"
+#include "pybind11/pytypes.h"
 #include "xla/pjrt/c/pjrt_c_api.h"
 #include "xla/pjrt/c/pjrt_c_api_gpu_extension.h"
 #include "xla/pjrt/c/pjrt_c_api_helpers.h"
 #include "xla/python/status_casters.h"
 #include "xla/status.h"
+#include "xla/statusor.h"
+#include "xla/stream_executor/sycl/sycl_memory_stats.h"
 #include "xla/util.h"
 
 namespace py = pybind11;
 
 namespace xla {
 namespace {
+
+// Custom calls getting opaque buffer pointers and their backend config string.
+constexpr int kLegacyCustomCallApiVersion = 0;
+// Typed XLA FFI handlers, i.e. XLA_FFI_Handler functions, whose attributes
+// are decoded once at compile time, see xla/service/gpu/sycl_ffi.h.
+constexpr int kTypedFfiApiVersion = 1;
+
 Status RegisterCustomCallTarget(const PJRT_Api* c_api,
                                 const std::string& fn_name, py::capsule fn,
                                 int api_version) {
   static const char* const kName = "xla._CUSTOM_CALL_TARGET";
-  if (std::string_view(fn.name()) != kName) {
+  if (api_version != kLegacyCustomCallApiVersion &&
+      api_version != kTypedFfiApiVersion) {
+    return InvalidArgument(
+        "Unsupported custom call api_version %d for %s, expected %d for "
+        "legacy custom calls or %d for typed FFI handlers",
+        api_version, fn_name, kLegacyCustomCallApiVersion,
+        kTypedFfiApiVersion);
+  }
+  // FFI handlers may come in unnamed capsules, e.g. from
+  // jax.extend.ffi.pycapsule.
+  const char* capsule_name = fn.name();
+  const bool unnamed_ffi_handler =
+      api_version == kTypedFfiApiVersion && capsule_name == nullptr;
+  if (!unnamed_ffi_handler &&
+      (capsule_name == nullptr || std::string_view(capsule_name) != kName)) {
     return InvalidArgument(
         "Argument to RegisterCustomCallTargetRegistry was not a "
         "xla._CUSTOM_CALL_TARGET capsule.");
@@ -68,6 +94,46 @@ Status RegisterCustomCallTarget(const PJRT_Api* c_api,
   return OkStatus();
 }
 
+// The extension is a library of its own, the stats are read from the plugin
+// library the PJRT_Api belongs to.
+StatusOr<XpuGetDeviceMemoryStatsFn> GetDeviceMemoryStatsFn(
+    const PJRT_Api* c_api) {
+  Dl_info info;
+  if (dladdr(c_api, &info) == 0 || info.dli_fname == nullptr) {
+    return NotFound("Failed to find the library of the xpu PJRT c api");
+  }
+  // The plugin is already loaded, this only takes a reference to it, which is
+  // kept as long as the plugin.
+  void* plugin = dlopen(info.dli_fname, RTLD_LAZY | RTLD_NOLOAD);
+  if (plugin == nullptr) {
+    return NotFound("The xpu plugin %s is not loaded", info.dli_fname);
+  }
+  void* fn = dlsym(plugin, kXpuGetDeviceMemoryStatsSymbol);
+  if (fn == nullptr) {
+    return Unimplemented("The xpu plugin %s does not export %s",
+                         info.dli_fname, kXpuGetDeviceMemoryStatsSymbol);
+  }
+  return reinterpret_cast<XpuGetDeviceMemoryStatsFn>(fn);
+}
+
+StatusOr<py::dict> GetDeviceMemoryStats(const PJRT_Api* c_api,
+                                        int device_ordinal) {
+  TF_ASSIGN_OR_RETURN(XpuGetDeviceMemoryStatsFn get_stats,
+                      GetDeviceMemoryStatsFn(c_api));
+  SYCLMemoryStats stats;
+  if (get_stats(device_ordinal, &stats) != 0) {
+    return InvalidArgument("Invalid xpu device ordinal %d", device_ordinal);
+  }
+  py::dict result;
+  result["num_allocs"] = stats.num_allocs;
+  result["bytes_in_use"] = stats.bytes_in_use;
+  result["peak_bytes_in_use"] = stats.peak_bytes_in_use;
+  result["largest_alloc_size"] = stats.largest_alloc_size;
+  result["malloc_time_ns"] = stats.malloc_time_ns;
+  result["max_malloc_time_ns"] = stats.max_malloc_time_ns;
+  return result;
+}
+
 }  // namespace
 
 PYBIND11_MODULE(xpu_plugin_extension, m) {
@@ -79,6 +145,27 @@ PYBIND11_MODULE(xpu_plugin_extension, m) {
               api_version));
         },
         py::arg("c_api"), py::arg("fn_name"), py::arg("fn"),
-        py::arg("xla_platform_name"), py::arg("api_version") = 0);
+        py::arg("xla_platform_name"),
+        py::arg("api_version") = kLegacyCustomCallApiVersion);
+  // Registers a typed XLA FFI handler, the capsule holds its XLA_FFI_Handler.
+  m.def("register_ffi_target",
+        [](py::capsule c_api, const std::string& fn_name, py::capsule fn,
+           const std::string& xla_platform_name) {
+          xla::ThrowIfError(RegisterCustomCallTarget(
+              static_cast<const PJRT_Api*>(c_api), fn_name, std::move(fn),
+              kTypedFfiApiVersion));
+        },
+        py::arg("c_api"), py::arg("fn_name"), py::arg("fn"),
+        py::arg("xla_platform_name") = "SYCL");
+  // Device memory the SYCL runtime allocated for a local device, below the
+  // allocator whose stats jax reports as Device.memory_stats().
+  m.def("memory_stats",
+        [](py::capsule c_api, int device_ordinal) {
+          return xla::ValueOrThrow(GetDeviceMemoryStats(
+              static_cast<const PJRT_Api*>(c_api), device_ordinal));
+        },
+        py::arg("c_api"), py::arg("device_ordinal"));
+  m.attr("LEGACY_CUSTOM_CALL_API_VERSION") = kLegacyCustomCallApiVersion;
+  m.attr("TYPED_FFI_API_VERSION") = kTypedFfiApiVersion;
 }
 }  // namespace xla
@@ -0,0 +1,140 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/gpu/all_reduce_epilogue_fusion.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "xla/hlo/ir/hlo_casting_utils.h"
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instructions.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/service/collective_ops_utils.h"
+#include "xla/shape_util.h"
+#include "tsl/platform/errors.h"
+
+namespace xla {
+namespace gpu {
+
+namespace {
+
+bool IsFusibleAllReduce(const HloInstruction* instr) {
+  if (instr->opcode() != HloOpcode::kAllReduce ||
+      instr->operand_count() != 1 || instr->user_count() != 1 ||
+      instr->HasControlDependencies()) {
+    return false;
+  }
+  // The kernels add the addend to the elements in the order of the buffers.
+  const Shape& shape = instr->shape();
+  if (!shape.IsArray() || !shape.has_layout() || shape.rank() == 0 ||
+      !ShapeUtil::Equal(shape, instr->operand(0)->shape())) {
+    return false;
+  }
+  if (shape.element_type() != F32 && shape.element_type() != BF16) {
+    return false;
+  }
+  return MatchReductionComputation(instr->to_apply()) == ReductionKind::SUM;
+}
+
+// Returns the addend of the epilogue if `operand` of an addition to
+// `all_reduce` can be fused: either a residual of the same shape, or a vector
+// broadcast along the minor dimension of the all-reduce.
+HloInstruction* MatchAddend(const HloInstruction* all_reduce,
+                            HloInstruction* operand) {
+  const Shape& shape = all_reduce->shape();
+  if (ShapeUtil::Equal(operand->shape(), shape)) return operand;
+  if (operand->opcode() != HloOpcode::kBroadcast) return nullptr;
+  HloInstruction* bias = operand->mutable_operand(0);
+  int64_t minor_dim = shape.layout().minor_to_major(0);
+  if (bias->shape().rank() != 1 ||
+      bias->shape().element_type() != shape.element_type() ||
+      operand->dimensions() != std::vector<int64_t>{minor_dim}) {
+    return nullptr;
+  }
+  return bias;
+}
+
+StatusOr<bool> FuseAllReduceEpilogue(HloInstruction* add) {
+  if (add->opcode() != HloOpcode::kAdd || add->HasControlDependencies()) {
+    return false;
+  }
+  for (int64_t i = 0; i < 2; ++i) {
+    HloInstruction* all_reduce = add->mutable_operand(i);
+    if (!IsFusibleAllReduce(all_reduce) ||
+        !ShapeUtil::Equal(add->shape(), all_reduce->shape())) {
+      continue;
+    }
+    HloInstruction* addend =
+        MatchAddend(all_reduce, add->mutable_operand(1 - i));
+    if (addend == nullptr) continue;
+
+    HloComputation* computation = add->parent();
+    auto* fused = Cast<HloCustomCallInstruction>(
+        computation->AddInstruction(HloInstruction::CreateCustomCall(
+            add->shape(), {all_reduce->mutable_operand(0), addend},
+            all_reduce->to_apply(), kAllReduceEpilogueCallTarget)));
+    FrontendAttributes attributes = all_reduce->frontend_attributes();
+    auto& map = *attributes.mutable_map();
+    map[std::string(kAllReduceReplicaGroupsAttr)] =
+        ReplicaGroupsToString(all_reduce->replica_groups());
+    if (all_reduce->channel_id().has_value()) {
+      map[std::string(kAllReduceChannelIdAttr)] =
+          absl::StrCat(*all_reduce->channel_id());
+    }
+    map[std::string(kAllReduceUseGlobalDeviceIdsAttr)] =
+        Cast<HloAllReduceInstruction>(all_reduce)->use_global_device_ids()
+            ? "true"
+            : "false";
+    fused->set_frontend_attributes(attributes);
+    fused->set_custom_call_has_side_effect(all_reduce->HasSideEffect());
+    fused->set_metadata(all_reduce->metadata());
+    computation->parent()->SetAndUniquifyInstrName(fused, all_reduce->name());
+
+    // A side effecting all-reduce isn't removed with its last user.
+    TF_RETURN_IF_ERROR(add->ReplaceAllUsesWith(fused));
+    TF_RETURN_IF_ERROR(computation->RemoveInstruction(add));
+    TF_RETURN_IF_ERROR(computation->RemoveInstruction(all_reduce));
+    return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+bool IsCustomCallToAllReduceEpilogue(const HloInstruction& hlo) {
+  return hlo.opcode() == HloOpcode::kCustomCall &&
+         hlo.custom_call_target() == kAllReduceEpilogueCallTarget;
+}
+
+StatusOr<bool> AllReduceEpilogueFusion::Run(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  bool any_changed = false;
+  for (HloComputation* computation :
+       module->MakeNonfusionComputations(execution_threads)) {
+    for (HloInstruction* instr : computation->MakeInstructionPostOrder()) {
+      bool changed = false;
+      TF_ASSIGN_OR_RETURN(changed, FuseAllReduceEpilogue(instr));
+      any_changed |= changed;
+    }
+  }
+  return any_changed;
+}
+
+}  // namespace gpu
+}  // namespace xla
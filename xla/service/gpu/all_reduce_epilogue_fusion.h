@@ -0,0 +1,66 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_GPU_ALL_REDUCE_EPILOGUE_FUSION_H_
+#define XLA_SERVICE_GPU_ALL_REDUCE_EPILOGUE_FUSION_H_
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/string_view.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/hlo_pass_interface.h"
+
+namespace xla {
+namespace gpu {
+
+// Custom call of an all-reduce with a fused epilogue. Operand 0 is the input
+// of the all-reduce and operand 1 the addend of the epilogue, the reduction is
+// the called computation and the other parameters of the all-reduce are kept
+// in frontend attributes.
+inline constexpr absl::string_view kAllReduceEpilogueCallTarget =
+    "__xpu$AllReduceEpilogue";
+inline constexpr absl::string_view kAllReduceReplicaGroupsAttr =
+    "all_reduce_replica_groups";
+inline constexpr absl::string_view kAllReduceChannelIdAttr =
+    "all_reduce_channel_id";
+inline constexpr absl::string_view kAllReduceUseGlobalDeviceIdsAttr =
+    "all_reduce_use_global_device_ids";
+
+bool IsCustomCallToAllReduceEpilogue(const HloInstruction& hlo);
+
+// Fuses the addition of a residual, or of a bias broadcast along the minor
+// dimension, into the all-reduce producing the other operand:
+//
+//   add(all-reduce(x), y) -> custom-call(x, y)
+//
+// The all-reduce kernels add y while they store the result, which saves
+// writing the result of the all-reduce and reading it back. Only sum
+// all-reduces of a single F32 or BF16 array with no other users are fused.
+class AllReduceEpilogueFusion : public HloModulePass {
+ public:
+  AllReduceEpilogueFusion() = default;
+
+  absl::string_view name() const override {
+    return "all-reduce-epilogue-fusion";
+  }
+  StatusOr<bool> Run(
+      HloModule* module,
+      const absl::flat_hash_set<absl::string_view>& execution_threads) override;
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_GPU_ALL_REDUCE_EPILOGUE_FUSION_H_
@@ -26,6 +26,7 @@ limitations under the License.
 #include "xla/hlo/ir/hlo_instructions.h"
 #include "xla/service/collective_ops_utils.h"
 #include "xla/service/gpu/backend_configs.pb.h"
+#include "xla/service/gpu/ccl_api.h"
 #include "xla/service/gpu/nccl_api.h"
 #include "xla/service/gpu/ccl_collective_thunk.h"
 #include "xla/service/gpu/thunk.h"
@@ -141,6 +142,18 @@ absl::Status NcclAllGatherStartThunk::RunNcclCollective(
   return xla::gpu::RunAllGather(nccl_api(), device_buffers, stream, comm);
 }
 
+namespace {
+
+// Whether the input of `buffer` is the slice of `rank` of its output.
+bool IsInPlaceAllGather(const DeviceBufferPair& buffer, int rank) {
+  const char* output =
+      static_cast<const char*>(buffer.destination_buffer.opaque());
+  return buffer.source_buffer.opaque() ==
+         output + buffer.source_buffer.size() * rank;
+}
+
+}  // namespace
+
 absl::Status RunAllGather(NcclApi* nccl_api,
                           std::vector<DeviceBufferPair>& buffers,
                           se::Stream& stream, NcclApi::NcclCommHandle comm) {
@@ -148,8 +161,14 @@ absl::Status RunAllGather(NcclApi* nccl_api,
   VLOG(3) << "Performing all-gather from device ordinal: " << device_ordinal;
 
   auto ccl_api = dynamic_cast<CclApi*>(nccl_api);
+  int rank = CastCCLComm(comm)->rank;
   for (size_t i = 0; i < buffers.size(); ++i) {
     DeviceBufferPair& buffer = buffers[i];
+    // The kernels skip the copy of the local slice of an in-place all-gather,
+    // i.e. whose input is the slice of this rank of its output.
+    if (IsInPlaceAllGather(buffer, rank)) {
+      VLOG(3) << "All-gather " << i << " is in place";
+    }
     TF_RETURN_IF_ERROR(ccl_api->AllGather(
         buffer.source_buffer, buffer.destination_buffer, buffer.element_type,
         buffer.element_count, comm, &stream));
@@ -19,23 +19,29 @@ limitations under the License.
 
 #include <array>
 #include <cstdint>
+#include <memory>
 #include <optional>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
 #include "mlir/IR/Block.h"  // from @llvm-project
 #include "mlir/IR/Operation.h"  // from @llvm-project
 #include "xla/hlo/ir/hlo_instruction.h"
 #include "xla/hlo/ir/hlo_instructions.h"
 #include "xla/hlo/ir/hlo_opcode.h"
 #include "xla/service/collective_ops_utils.h"
+#include "xla/service/gpu/all_reduce_epilogue_fusion.h"
 #include "xla/service/gpu/backend_configs.pb.h"
 #include "xla/service/gpu/nccl_api.h"
 #include "xla/service/gpu/ccl_api.h"
 #include "xla/service/gpu/ccl_collective_thunk.h"
 #include "xla/service/gpu/thunk.h"
+#include "xla/service/hlo_parser.h"
+#include "xla/shape_util.h"
 #include "xla/status_macros.h"
 #include "xla/stream_executor/stream.h"
 #include "xla/translate/hlo_to_mhlo/hlo_utils.h"
@@ -53,7 +59,8 @@ using mlir::lmhlo_gpu::ReduceScatterStartOp;
 
 absl::Status RunAllReduce(NcclApi* nccl_api, ReductionKind reduction_kind,
                           std::vector<DeviceBufferPair>& buffers,
-                          se::Stream& stream, NcclApi::NcclCommHandle comm) {
+                          se::Stream& stream, NcclApi::NcclCommHandle comm,
+                          AllReduceWireFormat wire_format) {
   int device_ordinal = stream.parent()->device_ordinal();
 
   VLOG(3) << "Performing all-reduce from device ordinal: " << device_ordinal;
@@ -63,7 +70,8 @@ absl::Status RunAllReduce(NcclApi* nccl_api, ReductionKind reduction_kind,
     DeviceBufferPair& buffer = buffers[i];
     TF_RETURN_IF_ERROR(ccl_api->AllReduce(
         buffer.source_buffer, buffer.destination_buffer, buffer.element_type,
-        buffer.element_count, reduction_kind, comm, &stream));
+        buffer.element_count, reduction_kind, comm, &stream,
+        AllReduceEpilogue(), wire_format));
   }
 
   return absl::OkStatus();
@@ -71,6 +79,16 @@ absl::Status RunAllReduce(NcclApi* nccl_api, ReductionKind reduction_kind,
 
 namespace {
 
+AllReduceWireFormat GetAllReduceWireFormat(const HloInstruction* inst) {
+  const auto& attributes = inst->frontend_attributes().map();
+  auto it = attributes.find(std::string(kAllReduceWireFormatAttr));
+  if (it == attributes.end()) return AllReduceWireFormat::kNative;
+  if (it->second == "bf16") return AllReduceWireFormat::kBF16;
+  LOG(WARNING) << "Ignoring unknown all-reduce wire format " << it->second
+               << " of " << inst->name();
+  return AllReduceWireFormat::kNative;
+}
+
 // Generally, the reduction op should be the only operation in the block, except
 // the terminator. However, if the type is bf16, the `FloatNormalization`
 // pass will have converted the op to float32 and added type conversions.
@@ -157,6 +175,7 @@ NcclAllReduceConfig GetNcclAllReduceConfigInst(HloInstType* inst) {
   NcclAllReduceConfig config;
   config.config = GetNcclCollectiveConfig(inst, inst->use_global_device_ids());
   config.reduction_kind = *reduction_kind;
+  config.wire_format = GetAllReduceWireFormat(inst);
   return config;
 }
 
@@ -289,7 +308,8 @@ absl::Status NcclAllReduceStartThunk::RunNcclCollective(
       ConvertToDeviceBuffers(params, buffers_,
                              config_.config.operand_element_type));
   return ::xla::gpu::RunAllReduce(nccl_api(), config_.reduction_kind,
-                                  device_buffers, stream, comm);
+                                  device_buffers, stream, comm,
+                                  config_.wire_format);
 }
 
 NcclReduceScatterStartThunk::NcclReduceScatterStartThunk(
@@ -346,6 +366,108 @@ absl::Status NcclReduceScatterStartThunk::RunNcclCollective(
                                       device_buffers, stream, comm);
 }
 
+NcclAllReduceEpilogueThunk::NcclAllReduceEpilogueThunk(
+    ThunkInfo thunk_info, NcclApi* nccl_api, NcclAllReduceConfig config,
+    Buffer buffer, BufferAllocation::Slice addend, int64_t addend_count)
+    : NcclAllReduceReduceScatterThunkBase(Thunk::kNcclAllReduce, thunk_info,
+                                          nccl_api, std::move(config),
+                                          {std::move(buffer)},
+                                          /*is_sync=*/true),
+      addend_(addend),
+      addend_count_(addend_count) {}
+
+/*static*/ absl::StatusOr<std::unique_ptr<NcclAllReduceEpilogueThunk>>
+NcclAllReduceEpilogueThunk::Create(ThunkInfo thunk_info, NcclApi* nccl_api,
+                                   const HloCustomCallInstruction* inst,
+                                   BufferAllocation::Slice source,
+                                   BufferAllocation::Slice destination,
+                                   BufferAllocation::Slice addend) {
+  TF_RET_CHECK(IsCustomCallToAllReduceEpilogue(*inst));
+  TF_RET_CHECK(inst->operand_count() == 2);
+  std::optional<ReductionKind> reduction_kind =
+      MatchReductionComputation(inst->to_apply());
+  TF_RET_CHECK(reduction_kind.has_value());
+
+  const auto& attributes = inst->frontend_attributes().map();
+  auto replica_groups =
+      attributes.find(std::string(kAllReduceReplicaGroupsAttr));
+  auto use_global_device_ids =
+      attributes.find(std::string(kAllReduceUseGlobalDeviceIdsAttr));
+  TF_RET_CHECK(replica_groups != attributes.end());
+  TF_RET_CHECK(use_global_device_ids != attributes.end());
+  std::optional<int64_t> channel_id;
+  if (auto it = attributes.find(std::string(kAllReduceChannelIdAttr));
+      it != attributes.end()) {
+    int64_t id;
+    TF_RET_CHECK(absl::SimpleAtoi(it->second, &id));
+    channel_id = id;
+  }
+
+  NcclAllReduceConfig config;
+  config.reduction_kind = *reduction_kind;
+  config.wire_format = GetAllReduceWireFormat(inst);
+  config.config.operand_count = 1;
+  config.config.operand_element_type = {
+      inst->operand(0)->shape().element_type()};
+  TF_ASSIGN_OR_RETURN(config.config.replica_groups,
+                      ParseReplicaGroupsOnly(replica_groups->second));
+  if (channel_id.has_value()) {
+    config.config.collective_op_kind = RendezvousKey::kCrossModule;
+    config.config.op_id = *channel_id;
+  } else {
+    config.config.collective_op_kind = RendezvousKey::kCrossReplica;
+    config.config.op_id = static_cast<int64_t>(inst->GetModule()->unique_id());
+  }
+  TF_ASSIGN_OR_RETURN(
+      config.config.group_mode,
+      GetCollectiveOpGroupMode(channel_id.has_value(),
+                               use_global_device_ids->second == "true"));
+
+  Buffer buffer;
+  buffer.element_count = ShapeUtil::ElementsIn(inst->operand(0)->shape());
+  buffer.source_buffer = source;
+  buffer.destination_buffer = destination;
+  buffer.source_memory_space = 0;
+  buffer.destination_memory_space = 0;
+  return std::make_unique<NcclAllReduceEpilogueThunk>(
+      thunk_info, nccl_api, std::move(config), std::move(buffer), addend,
+      ShapeUtil::ElementsIn(inst->operand(1)->shape()));
+}
+
+absl::Status NcclAllReduceEpilogueThunk::RunNcclCollective(
+    const ExecuteParams& params, se::Stream& stream,
+    NcclApi::NcclCommHandle comm) {
+  TF_ASSIGN_OR_RETURN(
+      std::vector<DeviceBufferPair> device_buffers,
+      ConvertToDeviceBuffers(params, buffers_,
+                             config_.config.operand_element_type));
+  VLOG(3) << "Performing all-reduce with epilogue from device ordinal: "
+          << stream.parent()->device_ordinal();
+
+  se::DeviceMemoryBase addend =
+      params.buffer_allocations->GetDeviceAddress(addend_);
+  AllReduceEpilogue epilogue;
+  epilogue.addend = addend.opaque();
+  epilogue.addend_count = addend_count_;
+  DeviceBufferPair& buffer = device_buffers[0];
+  auto ccl_api = dynamic_cast<CclApi*>(nccl_api());
+  return ccl_api->AllReduce(buffer.source_buffer, buffer.destination_buffer,
+                            buffer.element_type, buffer.element_count,
+                            config_.reduction_kind, comm, &stream, epilogue,
+                            config_.wire_format);
+}
+
+namespace {
+
+// Whether the output of `buffer` is the slice of `rank` of its input.
+bool IsInPlaceReduceScatter(const DeviceBufferPair& buffer, int rank) {
+  const char* input = static_cast<const char*>(buffer.source_buffer.opaque());
+  return buffer.destination_buffer.opaque() ==
+         input + buffer.destination_buffer.size() * rank;
+}
+
+}  // namespace
+
 absl::Status RunReduceScatter(NcclApi* nccl_api, ReductionKind reduction_kind,
                               std::vector<DeviceBufferPair>& buffers,
                               se::Stream& stream,
@@ -355,8 +477,15 @@ absl::Status RunReduceScatter(NcclApi* nccl_api, ReductionKind reduction_kind,
           << device_ordinal;
 
   auto ccl_api = dynamic_cast<CclApi*>(nccl_api);
+  int rank = CastCCLComm(comm)->rank;
   for (size_t i = 0; i < buffers.size(); ++i) {
     DeviceBufferPair& buffer = buffers[i];
+    // The kernels read the inputs of all ranks in place and write the output
+    // once, so an output aliasing the slice of this rank of the input, as in
+    // place reduce-scatters do, needs no copy.
+    if (IsInPlaceReduceScatter(buffer, rank)) {
+      VLOG(3) << "Reduce-scatter " << i << " is in place";
+    }
     TF_RETURN_IF_ERROR(ccl_api->ReduceScatter(
         buffer.source_buffer, buffer.destination_buffer, buffer.element_type,
         buffer.element_count, reduction_kind, comm, &stream));
@@ -19,24 +19,35 @@ limitations under the License.
 #define XLA_SERVICE_GPU_CCL_ALL_REDUCE_THUNK_H_
 
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <vector>
 
 #include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
 #include "absl/types/span.h"
 #include "xla/hlo/ir/hlo_instructions.h"
 #include "xla/mlir_hlo/lhlo_gpu/IR/lhlo_gpu_ops.h"
+#include "xla/service/buffer_assignment.h"
 #include "xla/service/collective_ops_utils.h"
 #include "xla/service/gpu/nccl_api.h"
 #include "xla/service/gpu/ccl_collective_thunk.h"
+#include "xla/service/gpu/ccl_ops.h"
 #include "xla/stream_executor/stream.h"
 
 namespace xla {
 namespace gpu {
 
+// Frontend attribute of all-reduces selecting their wire format, "bf16" for
+// AllReduceWireFormat::kBF16.
+inline constexpr absl::string_view kAllReduceWireFormatAttr =
+    "_xla_sycl_allreduce_wire_format";
+
 struct NcclAllReduceConfig {
   NcclCollectiveConfig config;
   ReductionKind reduction_kind;
+  AllReduceWireFormat wire_format = AllReduceWireFormat::kNative;
 };
 
 // Thunk that performs a NCCL-based All-Reduce or Reduce-Scatter among CUDA
@@ -133,11 +144,42 @@ class NcclReduceScatterStartThunk : public NcclAllReduceReduceScatterThunkBase {
                                  NcclApi::NcclCommHandle comm) override;
 };
 
+// -----------------------------------------------------------------------------
+// AllReduce with a fused epilogue
+// -----------------------------------------------------------------------------
+
+// Thunk of the custom calls built by AllReduceEpilogueFusion: an all-reduce
+// that adds its addend to the result while it is stored. Runs synchronously on
+// the compute stream.
+class NcclAllReduceEpilogueThunk : public NcclAllReduceReduceScatterThunkBase {
+ public:
+  NcclAllReduceEpilogueThunk(ThunkInfo thunk_info, NcclApi* nccl_api,
+                             NcclAllReduceConfig config, Buffer buffer,
+                             BufferAllocation::Slice addend,
+                             int64_t addend_count);
+
+  static absl::StatusOr<std::unique_ptr<NcclAllReduceEpilogueThunk>> Create(
+      ThunkInfo thunk_info, NcclApi* nccl_api,
+      const HloCustomCallInstruction* inst, BufferAllocation::Slice source,
+      BufferAllocation::Slice destination, BufferAllocation::Slice addend);
+
+ protected:
+  absl::Status RunNcclCollective(const ExecuteParams& params,
+                                 se::Stream& stream,
+                                 NcclApi::NcclCommHandle comm) override;
+
+ private:
+  const BufferAllocation::Slice addend_;
+  const int64_t addend_count_;
+};
+
 // -----------------------------------------------------------------------------
 
-absl::Status RunAllReduce(NcclApi* nccl_api, ReductionKind reduction_kind,
-                          std::vector<DeviceBufferPair>& buffers,
-                          se::Stream& stream, NcclApi::NcclCommHandle comm);
+absl::Status RunAllReduce(
+    NcclApi* nccl_api, ReductionKind reduction_kind,
+    std::vector<DeviceBufferPair>& buffers, se::Stream& stream,
+    NcclApi::NcclCommHandle comm,
+    AllReduceWireFormat wire_format = AllReduceWireFormat::kNative);
 
 absl::Status RunReduceScatter(NcclApi* nccl_api, ReductionKind reduction_kind,
                               std::vector<DeviceBufferPair>& buffers,
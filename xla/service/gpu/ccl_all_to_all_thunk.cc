@@ -19,11 +19,15 @@ limitations under the License.
 
 #include <cstdint>
 #include <cstdlib>
+#include <memory>
 #include <optional>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/substitute.h"
 #include "mlir/IR/Value.h"  // from @llvm-project
 #include "tsl/platform/errors.h"
@@ -31,11 +35,14 @@ limitations under the License.
 #include "tsl/platform/statusor.h"
 #include "xla/hlo/ir/hlo_instruction.h"
 #include "xla/hlo/ir/hlo_instructions.h"
+#include "xla/hlo/ir/hlo_opcode.h"
 #include "xla/service/collective_ops_utils.h"
+#include "xla/service/gpu/buffer_allocations.h"
 #include "xla/service/gpu/ccl_api.h"
 #include "xla/service/gpu/ccl_collective_thunk.h"
 #include "xla/service/gpu/ir_emission_utils.h"
 #include "xla/service/gpu/nccl_api.h"
+#include "xla/service/hlo_parser.h"
 #include "xla/shape.h"
 #include "xla/shape_util.h"
 #include "xla/status_macros.h"
@@ -151,6 +158,122 @@ absl::Status NcclAllToAllStartThunk::RunNcclCollective(
                                device_buffers, stream, comm);
 }
 
+bool IsCustomCallToRaggedAllToAll(const HloInstruction& hlo) {
+  return hlo.opcode() == HloOpcode::kCustomCall &&
+         hlo.custom_call_target() == kRaggedAllToAllCallTarget;
+}
+
+NcclRaggedAllToAllThunk::NcclRaggedAllToAllThunk(
+    ThunkInfo thunk_info, NcclApi* nccl_api, NcclCollectiveConfig config,
+    Buffer buffer, int64_t input_rows, int64_t row_bytes,
+    PrimitiveType index_type, BufferAllocation::Slice input_offsets,
+    BufferAllocation::Slice send_sizes, BufferAllocation::Slice output_offsets)
+    : NcclCollectiveThunk(Thunk::kNcclAllToAll, thunk_info, nccl_api,
+                          /*is_sync=*/true),
+      config_(std::move(config)),
+      buffers_({std::move(buffer)}),
+      input_rows_(input_rows),
+      row_bytes_(row_bytes),
+      index_type_(index_type),
+      input_offsets_(input_offsets),
+      send_sizes_(send_sizes),
+      output_offsets_(output_offsets) {}
+
+/*static*/ absl::StatusOr<std::unique_ptr<NcclRaggedAllToAllThunk>>
+NcclRaggedAllToAllThunk::Create(ThunkInfo thunk_info, NcclApi* nccl_api,
+                                const HloCustomCallInstruction* inst,
+                                std::vector<BufferAllocation::Slice> operands,
+                                BufferAllocation::Slice result) {
+  TF_RET_CHECK(IsCustomCallToRaggedAllToAll(*inst));
+  TF_RET_CHECK(inst->operand_count() == 6 && operands.size() == 6);
+  const Shape& input_shape = inst->operand(0)->shape();
+  const Shape& output_shape = inst->operand(1)->shape();
+  TF_RET_CHECK(input_shape.rank() >= 1 &&
+               ShapeUtil::IsEffectivelyMostMajorDimension(input_shape, 0))
+      << "Rows of a ragged all-to-all must be the most major dimension.";
+  TF_RET_CHECK(ShapeUtil::Equal(output_shape, inst->shape()));
+  TF_RET_CHECK(ShapeUtil::SameElementType(input_shape, output_shape) &&
+               output_shape.rank() == input_shape.rank());
+  for (int64_t i = 1; i < input_shape.rank(); ++i) {
+    TF_RET_CHECK(input_shape.dimensions(i) == output_shape.dimensions(i));
+  }
+  // The output must be updated in place.
+  TF_RET_CHECK(inst->output_to_operand_aliasing().size() == 1 &&
+               inst->output_to_operand_aliasing()[0].second.first == 1);
+  PrimitiveType index_type = inst->operand(2)->shape().element_type();
+  TF_RET_CHECK(index_type == S32 || index_type == S64);
+  for (int64_t i = 2; i < 6; ++i) {
+    const Shape& shape = inst->operand(i)->shape();
+    TF_RET_CHECK(shape.rank() == 1 && shape.element_type() == index_type);
+  }
+
+  const auto& attributes = inst->frontend_attributes().map();
+  auto replica_groups =
+      attributes.find(std::string(kRaggedAllToAllReplicaGroupsAttr));
+  TF_RET_CHECK(replica_groups != attributes.end());
+  bool use_global_device_ids = false;
+  if (auto it = attributes.find(
+          std::string(kRaggedAllToAllUseGlobalDeviceIdsAttr));
+      it != attributes.end()) {
+    use_global_device_ids = it->second == "true";
+  }
+  std::optional<int64_t> channel_id;
+  if (auto it = attributes.find(std::string(kRaggedAllToAllChannelIdAttr));
+      it != attributes.end()) {
+    int64_t id;
+    TF_RET_CHECK(absl::SimpleAtoi(it->second, &id));
+    channel_id = id;
+  }
+
+  NcclCollectiveConfig config;
+  config.operand_count = 1;
+  config.operand_element_type = {input_shape.element_type()};
+  TF_ASSIGN_OR_RETURN(config.replica_groups,
+                      ParseReplicaGroupsOnly(replica_groups->second));
+  if (channel_id.has_value()) {
+    config.collective_op_kind = RendezvousKey::kCrossModule;
+    config.op_id = *channel_id;
+  } else {
+    config.collective_op_kind = RendezvousKey::kCrossReplica;
+    config.op_id = static_cast<int64_t>(inst->GetModule()->unique_id());
+  }
+  TF_ASSIGN_OR_RETURN(config.group_mode,
+                      GetCollectiveOpGroupMode(channel_id.has_value(),
+                                               use_global_device_ids));
+
+  Buffer buffer;
+  buffer.element_count = ShapeUtil::ElementsIn(input_shape);
+  buffer.source_buffer = operands[0];
+  buffer.destination_buffer = result;
+  buffer.source_memory_space = 0;
+  buffer.destination_memory_space = 0;
+  const int64_t input_rows = input_shape.dimensions(0);
+  const int64_t row_bytes =
+      input_rows == 0 ? 0 : ShapeUtil::ByteSizeOf(input_shape) / input_rows;
+  return std::make_unique<NcclRaggedAllToAllThunk>(
+      thunk_info, nccl_api, std::move(config), std::move(buffer), input_rows,
+      row_bytes, index_type, operands[2], operands[3], operands[4]);
+}
+
+absl::Status NcclRaggedAllToAllThunk::RunNcclCollective(
+    const ExecuteParams& params, se::Stream& stream,
+    NcclApi::NcclCommHandle comm) {
+  TF_ASSIGN_OR_RETURN(
+      std::vector<DeviceBufferPair> device_buffers,
+      ConvertToDeviceBuffers(params, buffers_, config_.operand_element_type));
+  VLOG(3) << "Performing ragged all-to-all from device ordinal: "
+          << stream.parent()->device_ordinal();
+
+  const BufferAllocations& allocations = *params.buffer_allocations;
+  DeviceBufferPair& buffer = device_buffers[0];
+  auto ccl_api = dynamic_cast<CclApi*>(nccl_api());
+  return ccl_api->RaggedAllToAll(
+      buffer.source_buffer, buffer.destination_buffer, input_rows_, row_bytes_,
+      index_type_, allocations.GetDeviceAddress(input_offsets_),
+      allocations.GetDeviceAddress(send_sizes_),
+      allocations.GetDeviceAddress(output_offsets_), comm, &stream);
+}
+
 absl::Status RunAllToAll(NcclApi* nccl_api, bool has_split_dimension,
                          std::vector<DeviceBufferPair>& buffers,
                          se::Stream& stream, NcclApi::NcclCommHandle comm) {
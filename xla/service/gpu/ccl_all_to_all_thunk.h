@@ -18,8 +18,13 @@ limitations under the License.
 #ifndef XLA_SERVICE_GPU_CCL_ALL_TO_ALL_THUNK_H_
 #define XLA_SERVICE_GPU_CCL_ALL_TO_ALL_THUNK_H_
 
+#include <memory>
 #include <vector>
 
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "xla/hlo/ir/hlo_instructions.h"
+#include "xla/service/buffer_assignment.h"
 #include "xla/service/collective_ops_utils.h"
 #include "xla/service/gpu/nccl_api.h"
 #include "xla/service/gpu/ccl_collective_thunk.h"
@@ -69,6 +74,59 @@ class NcclAllToAllStartThunk : public NcclCollectiveThunk {
   const std::vector<Buffer> buffers_;
 };
 
+// Custom call of an all-to-all of variable numbers of rows, whose operands are
+// the input, the output, and the input offsets, send sizes, output offsets and
+// receive sizes of this rank, with one entry per rank in rows of the input. The
+// output is aliased with the result, as rows no peer sends to keep their
+// values. The parameters of the all-to-all are kept in frontend attributes.
+inline constexpr absl::string_view kRaggedAllToAllCallTarget =
+    "__xpu$RaggedAllToAll";
+inline constexpr absl::string_view kRaggedAllToAllReplicaGroupsAttr =
+    "ragged_all_to_all_replica_groups";
+inline constexpr absl::string_view kRaggedAllToAllChannelIdAttr =
+    "ragged_all_to_all_channel_id";
+inline constexpr absl::string_view kRaggedAllToAllUseGlobalDeviceIdsAttr =
+    "ragged_all_to_all_use_global_device_ids";
+
+bool IsCustomCallToRaggedAllToAll(const HloInstruction& hlo);
+
+// Thunk of ragged all-to-all custom calls, e.g. the dispatch and combine of MoE
+// layers, whose number of tokens per expert changes every step. Only the rows
+// that are sent are copied, and the offsets and sizes are only read on the
+// device. Runs synchronously on the compute stream.
+class NcclRaggedAllToAllThunk : public NcclCollectiveThunk {
+ public:
+  NcclRaggedAllToAllThunk(ThunkInfo thunk_info, NcclApi* nccl_api,
+                          NcclCollectiveConfig config, Buffer buffer,
+                          int64_t input_rows, int64_t row_bytes,
+                          PrimitiveType index_type,
+                          BufferAllocation::Slice input_offsets,
+                          BufferAllocation::Slice send_sizes,
+                          BufferAllocation::Slice output_offsets);
+
+  static absl::StatusOr<std::unique_ptr<NcclRaggedAllToAllThunk>> Create(
+      ThunkInfo thunk_info, NcclApi* nccl_api,
+      const HloCustomCallInstruction* inst,
+      std::vector<BufferAllocation::Slice> operands,
+      BufferAllocation::Slice result);
+
+ protected:
+  const NcclCollectiveConfig& config() const override { return config_; }
+  absl::Status RunNcclCollective(const ExecuteParams& params,
+                                 se::Stream& stream,
+                                 NcclApi::NcclCommHandle comm) override;
+
+ private:
+  const NcclCollectiveConfig config_;
+  const std::vector<Buffer> buffers_;
+  const int64_t input_rows_;
+  const int64_t row_bytes_;
+  const PrimitiveType index_type_;
+  const BufferAllocation::Slice input_offsets_;
+  const BufferAllocation::Slice send_sizes_;
+  const BufferAllocation::Slice output_offsets_;
+};
+
 absl::Status RunAllToAll(NcclApi* nccl_api, bool has_split_dimension,
                          std::vector<DeviceBufferPair>& buffers,
                          se::Stream& stream, NcclApi::NcclCommHandle comm);
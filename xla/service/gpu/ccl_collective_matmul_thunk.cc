@@ -0,0 +1,225 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/gpu/ccl_collective_matmul_thunk.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include <xetla.hpp>
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/logging.h"
+#include "tsl/platform/statusor.h"
+#include "xla/primitive_util.h"
+#include "xla/service/collective_ops_utils.h"
+#include "xla/service/gpu/buffer_allocations.h"
+#include "xla/service/gpu/ccl_api.h"
+#include "xla/service/gpu/collective_matmul_rewriter.h"
+#include "xla/service/gpu/matrix_descriptor.h"
+#include "xla/service/gpu/xetla/gemm/gemm.h"
+#include "xla/service/hlo_parser.h"
+#include "xla/shape_util.h"
+#include "xla/status_macros.h"
+#include "xla/stream_executor/blas.h"
+#include "xla/stream_executor/gpu/gpu_stream.h"
+
+namespace xla {
+namespace gpu {
+
+namespace {
+
+MatrixDescriptor RowMajorMatrix(const void* data, int64_t rows, int64_t cols,
+                                int64_t element_bytes) {
+  return MatrixDescriptor{
+      se::DeviceMemoryBase(const_cast<void*>(data),
+                           rows * cols * element_bytes),
+      se::blas::Transpose::kNoTranspose, rows, cols,
+      /*batch_stride=*/0, /*leading_dim_stride=*/cols};
+}
+
+// Computes output = lhs x rhs + addend, without the addition if `addend` is
+// null, for the m x k block of the left matrix of a step.
+template <typename T>
+absl::Status RunStepGemm(se::gpu::GpuStreamHandle handle, int64_t m,
+                         int64_t n, int64_t k, const void* lhs_data,
+                         const void* rhs_data, void* output_data,
+                         const void* addend) {
+  using Kernel = ::gpu::xetla::XetlaGemmKernel<T>;
+  MatrixDescriptor lhs = RowMajorMatrix(lhs_data, m, k, sizeof(T));
+  MatrixDescriptor rhs = RowMajorMatrix(rhs_data, k, n, sizeof(T));
+  MatrixDescriptor output = RowMajorMatrix(output_data, m, n, sizeof(T));
+
+  Kernel kernel;
+  kernel.add_matrix_c(output).add_matrix_a(lhs).add_matrix_b(rhs);
+  if (addend != nullptr) {
+    kernel.add_epilogue(addend, Kernel::EpilogueType::RES_ADD);
+  }
+  kernel.build();
+  if (kernel.fallback() || !kernel.run(handle)) {
+    return absl::InternalError(absl::StrCat(
+        "Unsupported collective matmul step with M=", m, ", N=", n,
+        " and K=", k));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status RunStepGemm(PrimitiveType type, se::gpu::GpuStreamHandle handle,
+                         int64_t m, int64_t n, int64_t k, const void* lhs,
+                         const void* rhs, void* output, const void* addend) {
+  switch (type) {
+    case F16:
+      return RunStepGemm<sycl::half>(handle, m, n, k, lhs, rhs, output,
+                                     addend);
+    case BF16:
+      return RunStepGemm<::gpu::xetla::bf16>(handle, m, n, k, lhs, rhs,
+                                             output, addend);
+    default:
+      return absl::InternalError(
+          absl::StrCat("Unsupported collective matmul type ",
+                       primitive_util::LowercasePrimitiveTypeName(type)));
+  }
+}
+
+}  // namespace
+
+NcclCollectiveMatmulThunk::NcclCollectiveMatmulThunk(
+    Kind kind, ThunkInfo thunk_info, NcclApi* nccl_api,
+    NcclCollectiveConfig config, PrimitiveType type, int64_t m, int64_t n,
+    int64_t k, BufferAllocation::Slice lhs, BufferAllocation::Slice rhs,
+    BufferAllocation::Slice output, BufferAllocation::Slice workspace)
+    : NcclCollectiveThunk(kind, thunk_info, nccl_api, /*is_sync=*/true),
+      config_(std::move(config)),
+      type_(type),
+      m_(m),
+      n_(n),
+      k_(k),
+      lhs_(lhs),
+      rhs_(rhs),
+      output_(output),
+      workspace_(workspace) {}
+
+/*static*/ absl::StatusOr<std::unique_ptr<NcclCollectiveMatmulThunk>>
+NcclCollectiveMatmulThunk::Create(ThunkInfo thunk_info, NcclApi* nccl_api,
+                                  const HloCustomCallInstruction* inst,
+                                  BufferAllocation::Slice lhs,
+                                  BufferAllocation::Slice rhs,
+                                  BufferAllocation::Slice output,
+                                  BufferAllocation::Slice workspace) {
+  TF_RET_CHECK(IsCustomCallToCollectiveMatmul(*inst));
+  TF_RET_CHECK(inst->operand_count() == 2);
+  const bool reduce_scatter =
+      inst->custom_call_target() == kMatmulReduceScatterCallTarget;
+  const Shape& lhs_shape = inst->operand(0)->shape();
+  const Shape& rhs_shape = inst->operand(1)->shape();
+  const Shape& output_shape =
+      reduce_scatter ? inst->shape().tuple_shapes(0) : inst->shape();
+  TF_RET_CHECK(lhs_shape.rank() == 2 && rhs_shape.rank() == 2 &&
+               output_shape.rank() == 2);
+  const int64_t k = lhs_shape.dimensions(1);
+  const int64_t n = rhs_shape.dimensions(1);
+  TF_RET_CHECK(rhs_shape.dimensions(0) == k && output_shape.dimensions(1) == n);
+  // The rows of a step are the shard of a rank, or the block of the output of
+  // a rank.
+  const int64_t m = reduce_scatter ? output_shape.dimensions(0)
+                                   : lhs_shape.dimensions(0);
+
+  const auto& attributes = inst->frontend_attributes().map();
+  auto replica_groups =
+      attributes.find(std::string(kCollectiveMatmulReplicaGroupsAttr));
+  auto use_global_device_ids =
+      attributes.find(std::string(kCollectiveMatmulUseGlobalDeviceIdsAttr));
+  TF_RET_CHECK(replica_groups != attributes.end());
+  TF_RET_CHECK(use_global_device_ids != attributes.end());
+  std::optional<int64_t> channel_id;
+  if (auto it = attributes.find(std::string(kCollectiveMatmulChannelIdAttr));
+      it != attributes.end()) {
+    int64_t id;
+    TF_RET_CHECK(absl::SimpleAtoi(it->second, &id));
+    channel_id = id;
+  }
+
+  NcclCollectiveConfig config;
+  config.operand_count = 1;
+  config.operand_element_type = {output_shape.element_type()};
+  TF_ASSIGN_OR_RETURN(config.replica_groups,
+                      ParseReplicaGroupsOnly(replica_groups->second));
+  if (channel_id.has_value()) {
+    config.collective_op_kind = RendezvousKey::kCrossModule;
+    config.op_id = *channel_id;
+  } else {
+    config.collective_op_kind = RendezvousKey::kCrossReplica;
+    config.op_id = static_cast<int64_t>(inst->GetModule()->unique_id());
+  }
+  TF_ASSIGN_OR_RETURN(
+      config.group_mode,
+      GetCollectiveOpGroupMode(channel_id.has_value(),
+                               use_global_device_ids->second == "true"));
+
+  return std::make_unique<NcclCollectiveMatmulThunk>(
+      reduce_scatter ? Thunk::kNcclReduceScatter : Thunk::kNcclAllGather,
+      thunk_info, nccl_api, std::move(config), output_shape.element_type(),
+      m, n, k, lhs, rhs, output, workspace);
+}
+
+absl::Status NcclCollectiveMatmulThunk::RunNcclCollective(
+    const ExecuteParams& params, se::Stream& stream,
+    NcclApi::NcclCommHandle comm) {
+  const BufferAllocations& allocs = *params.buffer_allocations;
+  se::DeviceMemoryBase lhs = allocs.GetDeviceAddress(lhs_);
+  se::DeviceMemoryBase rhs = allocs.GetDeviceAddress(rhs_);
+  se::DeviceMemoryBase output = allocs.GetDeviceAddress(output_);
+  se::gpu::GpuStreamHandle handle = se::gpu::AsGpuStreamValue(&stream);
+  const int64_t nranks = CastCCLComm(comm)->nranks;
+  const int64_t element_bytes = primitive_util::ByteWidth(type_);
+  auto ccl_api = dynamic_cast<CclApi*>(nccl_api());
+
+  if (kind() == Thunk::kNcclAllGather) {
+    VLOG(3) << "Performing all-gather matmul from device ordinal: "
+            << stream.parent()->device_ordinal();
+    TF_RET_CHECK(nranks * m_ * n_ * element_bytes == output.size())
+        << "The rows of the output aren't a shard per rank.";
+    char* output_rows = static_cast<char*>(output.opaque());
+    return ccl_api->AllGatherMatmul(
+        lhs, comm, &stream, [&](int source, const void* shard) {
+          return RunStepGemm(type_, handle, m_, n_, k_, shard, rhs.opaque(),
+                             output_rows + source * m_ * n_ * element_bytes,
+                             /*addend=*/nullptr);
+        });
+  }
+
+  VLOG(3) << "Performing matmul reduce-scatter from device ordinal: "
+          << stream.parent()->device_ordinal();
+  TF_RET_CHECK(nranks * m_ * k_ * element_bytes == lhs.size())
+      << "The rows of the left matrix aren't a block per rank.";
+  se::DeviceMemoryBase workspace = allocs.GetDeviceAddress(workspace_);
+  const char* lhs_rows = static_cast<const char*>(lhs.opaque());
+  return ccl_api->MatmulReduceScatter(
+      output, workspace, comm, &stream,
+      [&](int block, const void* partial, void* block_output) {
+        return RunStepGemm(type_, handle, m_, n_, k_,
+                           lhs_rows + block * m_ * k_ * element_bytes,
+                           rhs.opaque(), block_output, partial);
+      });
+}
+
+}  // namespace gpu
+}  // namespace xla
@@ -0,0 +1,77 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_GPU_CCL_COLLECTIVE_MATMUL_THUNK_H_
+#define XLA_SERVICE_GPU_CCL_COLLECTIVE_MATMUL_THUNK_H_
+
+#include <cstdint>
+#include <memory>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "xla/hlo/ir/hlo_instructions.h"
+#include "xla/service/buffer_assignment.h"
+#include "xla/service/gpu/ccl_collective_thunk.h"
+#include "xla/service/gpu/nccl_api.h"
+#include "xla/xla_data.pb.h"
+
+namespace xla {
+namespace gpu {
+
+// Thunk of the custom calls built by CollectiveMatmulRewriter. The XeTLA GEMM
+// runs once per rank on a block of rows of the output: on the shard of the
+// left matrix of the rank for an all-gather matmul, or adding the partial
+// result of the left neighbor for a matmul reduce-scatter. Runs synchronously
+// on the compute stream.
+class NcclCollectiveMatmulThunk : public NcclCollectiveThunk {
+ public:
+  // `m` is the number of rows of the left matrix of a step, `workspace` is
+  // only used by matmul reduce-scatters.
+  NcclCollectiveMatmulThunk(Kind kind, ThunkInfo thunk_info, NcclApi* nccl_api,
+                            NcclCollectiveConfig config, PrimitiveType type,
+                            int64_t m, int64_t n, int64_t k,
+                            BufferAllocation::Slice lhs,
+                            BufferAllocation::Slice rhs,
+                            BufferAllocation::Slice output,
+                            BufferAllocation::Slice workspace);
+
+  static absl::StatusOr<std::unique_ptr<NcclCollectiveMatmulThunk>> Create(
+      ThunkInfo thunk_info, NcclApi* nccl_api,
+      const HloCustomCallInstruction* inst, BufferAllocation::Slice lhs,
+      BufferAllocation::Slice rhs, BufferAllocation::Slice output,
+      BufferAllocation::Slice workspace);
+
+ protected:
+  const NcclCollectiveConfig& config() const override { return config_; }
+  absl::Status RunNcclCollective(const ExecuteParams& params,
+                                 se::Stream& stream,
+                                 NcclApi::NcclCommHandle comm) override;
+
+ private:
+  const NcclCollectiveConfig config_;
+  const PrimitiveType type_;
+  const int64_t m_;
+  const int64_t n_;
+  const int64_t k_;
+  const BufferAllocation::Slice lhs_;
+  const BufferAllocation::Slice rhs_;
+  const BufferAllocation::Slice output_;
+  const BufferAllocation::Slice workspace_;
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_GPU_CCL_COLLECTIVE_MATMUL_THUNK_H_
@@ -61,10 +61,10 @@ limitations under the License.
 #include "tsl/platform/errors.h"
 #include "tsl/platform/statusor.h"
 
-#if GOOGLE_CUDA
+#if GOOGLE_CUDA || TENSORFLOW_USE_SYCL
 #include "xla/stream_executor/gpu/gpu_driver.h"
 #include "xla/stream_executor/gpu/gpu_types.h"
-#endif  // GOOGLE_CUDA
+#endif  // GOOGLE_CUDA || TENSORFLOW_USE_SYCL
 
 namespace xla {
 namespace gpu {
@@ -304,14 +304,14 @@ Status RegisterBufferOnce(NcclApi* nccl_api, int device_ordinal,
   // of which chunks we have registered.
   void* base_ptr;
   size_t base_size;
-#ifdef GOOGLE_CUDA
+#if GOOGLE_CUDA || TENSORFLOW_USE_SYCL
   TF_RETURN_IF_ERROR(se::gpu::GpuDriver::GetPointerAddressRange(
       reinterpret_cast<se::gpu::GpuDevicePtr>(buffer.opaque()),
       reinterpret_cast<se::gpu::GpuDevicePtr*>(&base_ptr), &base_size));
-#else   // GOOGLE_CUDA
+#else   // GOOGLE_CUDA || TENSORFLOW_USE_SYCL
   base_ptr = nullptr;
   base_size = 0;
-#endif  // GOOGLE_CUDA
+#endif  // GOOGLE_CUDA || TENSORFLOW_USE_SYCL
 
   absl::MutexLock lock(&all_registered.mu);
   if (!all_registered.records.contains({device_ordinal, comm, base_ptr})) {
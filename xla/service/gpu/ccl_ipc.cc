@@ -0,0 +1,271 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/gpu/ccl_ipc.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "tsl/platform/fingerprint.h"
+#include "tsl/platform/logging.h"
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+#ifndef SYS_pidfd_getfd
+#define SYS_pidfd_getfd 438
+#endif
+
+namespace xla {
+namespace gpu {
+
+struct IpcRendezvous::Slot {
+  // Last exchange whose payload is published in `payloads`.
+  std::atomic<uint64_t> published;
+  IpcPayload payloads[2];
+};
+
+namespace {
+
+absl::Status ErrnoError(absl::string_view what) {
+  return absl::InternalError(absl::StrCat(what, " failed: ", strerror(errno)));
+}
+
+// pidfd_getfd needs ptrace access to the peer, which Yama restricts to the
+// ancestors of a process with ptrace_scope=1, so sibling ranks started by a
+// launcher can't access each other. Ranks allow any process of their user to
+// access them instead.
+void AllowPeerFdAccess() {
+  static std::once_flag once;
+  std::call_once(once, [] {
+    // EINVAL without Yama, whose restrictions then don't apply.
+    if (prctl(PR_SET_PTRACER, PR_SET_PTRACER_ANY, 0, 0, 0) != 0 &&
+        errno != EINVAL) {
+      LOG(WARNING) << "Failed to allow the ranks of other processes to "
+                      "duplicate file descriptors of this one: "
+                   << strerror(errno);
+    }
+  });
+}
+
+// Level-Zero IPC handles carry a file descriptor of the exporting process,
+// which is duplicated into this process before opening the handle.
+absl::StatusOr<int> DuplicateFd(int32_t pid, int fd) {
+  int pidfd = syscall(SYS_pidfd_open, pid, 0);
+  if (pidfd < 0) return ErrnoError("pidfd_open");
+  int local_fd = syscall(SYS_pidfd_getfd, pidfd, fd, 0);
+  int error = errno;
+  close(pidfd);
+  if (local_fd < 0 && error == EPERM) {
+    return absl::PermissionDeniedError(absl::StrCat(
+        "Not allowed to duplicate a file descriptor of process ", pid,
+        ", collectives between processes need ptrace access to the other "
+        "ranks. Check /proc/sys/kernel/yama/ptrace_scope, or run all the "
+        "ranks of the host in one process"));
+  }
+  if (local_fd < 0) {
+    errno = error;
+    return ErrnoError("pidfd_getfd");
+  }
+  return local_fd;
+}
+
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<IpcRendezvous>> IpcRendezvous::Open(
+    const std::string& id, int nranks) {
+  // Before the exchanges publish any file descriptor of this process.
+  AllowPeerFdAccess();
+  // Communicator ids are too long for a segment name, and must map to the same
+  // name in all processes.
+  std::string name = absl::StrCat("/xla_sycl_ccl_",
+                                  absl::Hex(tsl::Fingerprint64(id)));
+  int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+  if (fd < 0) return ErrnoError("shm_open");
+  // Segments are zero filled, i.e. no slot is published yet.
+  size_t bytes = nranks * sizeof(Slot);
+  if (ftruncate(fd, bytes) != 0) {
+    absl::Status status = ErrnoError("ftruncate");
+    close(fd);
+    return status;
+  }
+  void* segment =
+      mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (segment == MAP_FAILED) return ErrnoError("mmap");
+  VLOG(1) << "Opened IPC rendezvous " << name << " for " << nranks
+          << " ranks";
+  return std::unique_ptr<IpcRendezvous>(
+      new IpcRendezvous(std::move(name), segment, bytes, nranks));
+}
+
+IpcRendezvous::~IpcRendezvous() { munmap(segment_, bytes_); }
+
+IpcRendezvous::Slot* IpcRendezvous::slot(int rank) {
+  return static_cast<Slot*>(segment_) + rank;
+}
+
+absl::StatusOr<std::vector<IpcPayload>> IpcRendezvous::Exchange(
+    int rank, uint64_t sequence, const IpcPayload& payload,
+    absl::Duration timeout) {
+  // A rank can only publish exchange e + 2 once all its peers published
+  // e + 1, i.e. finished reading exchange e.
+  IpcPayload& published = slot(rank)->payloads[sequence % 2];
+  published.num_buffers = payload.num_buffers;
+  std::copy_n(payload.buffers, payload.num_buffers, published.buffers);
+  slot(rank)->published.store(sequence, std::memory_order_release);
+
+  const absl::Time deadline = absl::Now() + timeout;
+  std::vector<IpcPayload> payloads(nranks_);
+  for (int i = 0; i < nranks_; ++i) {
+    Slot* peer = slot(i);
+    while (peer->published.load(std::memory_order_acquire) < sequence) {
+      if (absl::Now() > deadline) {
+        return absl::DeadlineExceededError(absl::StrCat(
+            "Rank ", i, " did not reach exchange ", sequence, " of ", name_,
+            " within ", absl::FormatDuration(timeout),
+            ", the ranks of a communicator spanning processes must all run "
+            "on this host"));
+      }
+      std::this_thread::yield();
+    }
+    const IpcPayload& peer_payload = peer->payloads[sequence % 2];
+    payloads[i].num_buffers = peer_payload.num_buffers;
+    std::copy_n(peer_payload.buffers, peer_payload.num_buffers,
+                payloads[i].buffers);
+  }
+  // All processes mapped the segment once all ranks published the first
+  // exchange, so the name can go.
+  if (sequence == 1 && rank == 0) shm_unlink(name_.c_str());
+  return payloads;
+}
+
+IpcBufferCache::~IpcBufferCache() {
+  for (auto& [base, exported] : exports_) SYCLPutIpcHandle(exported.handle);
+  for (auto& [key, mapping] : mappings_) SYCLCloseIpcHandle(mapping.ptr);
+  for (RetiredMapping& retired : retired_) {
+    retired.last_use.wait();
+    SYCLCloseIpcHandle(retired.ptr);
+  }
+}
+
+absl::StatusOr<IpcBuffer> IpcBufferCache::Export(const void* ptr) {
+  IpcBuffer buffer;
+  if (ptr == nullptr) return buffer;
+
+  void* base = nullptr;
+  size_t size = 0;
+  uint64_t alloc_id = 0;
+  if (SYCLGetPointerAddressRange(ptr, &base, &size) != SYCL_SUCCESS ||
+      SYCLGetAllocationId(base, &alloc_id) != SYCL_SUCCESS) {
+    return absl::InvalidArgumentError("Pointer is not device memory");
+  }
+  auto it = exports_.find(base);
+  if (it != exports_.end() &&
+      (it->second.size != size || it->second.alloc_id != alloc_id)) {
+    // The allocation was freed and another one reuses its address.
+    SYCLPutIpcHandle(it->second.handle);
+    exports_.erase(it);
+    it = exports_.end();
+  }
+  if (it == exports_.end()) {
+    IpcBuffer exported;
+    exported.pid = getpid();
+    exported.base = reinterpret_cast<uint64_t>(base);
+    exported.size = size;
+    exported.alloc_id = alloc_id;
+    if (SYCLGetIpcHandle(base, &exported.handle) != SYCL_SUCCESS) {
+      return absl::InternalError("Failed to get an IPC handle");
+    }
+    it = exports_.emplace(base, exported).first;
+  }
+  buffer = it->second;
+  buffer.offset = static_cast<const char*>(ptr) - static_cast<char*>(base);
+  return buffer;
+}
+
+void IpcBufferCache::CloseRetiredMappings() {
+  auto unused = std::partition(
+      retired_.begin(), retired_.end(), [](const RetiredMapping& retired) {
+        return !SYCLIsEventComplete(retired.last_use);
+      });
+  for (auto it = unused; it != retired_.end(); ++it) {
+    SYCLCloseIpcHandle(it->ptr);
+  }
+  retired_.erase(unused, retired_.end());
+}
+
+absl::StatusOr<void*> IpcBufferCache::Map(const IpcBuffer& buffer,
+                                          sycl::queue* stream) {
+  if (buffer.pid == 0) return nullptr;
+  if (buffer.pid == getpid()) {
+    return reinterpret_cast<char*>(buffer.base) + buffer.offset;
+  }
+  CloseRetiredMappings();
+
+  auto key = std::make_pair(buffer.pid, buffer.base);
+  auto it = mappings_.find(key);
+  if (it != mappings_.end() && (it->second.size != buffer.size ||
+                                it->second.alloc_id != buffer.alloc_id)) {
+    // The peer reused the address of an allocation it freed, collectives
+    // already submitted may still access the old mapping.
+    if (stream != nullptr) {
+      retired_.push_back(
+          {it->second.ptr, SYCLGetLastEventFromStream(stream)});
+    } else {
+      SYCLCtxSynchronize(&device_);
+      SYCLCloseIpcHandle(it->second.ptr);
+    }
+    mappings_.erase(it);
+    it = mappings_.end();
+  }
+  if (it == mappings_.end()) {
+    ze_ipc_mem_handle_t handle = buffer.handle;
+    int fd;
+    std::memcpy(&fd, handle.data, sizeof(fd));
+    absl::StatusOr<int> local_fd = DuplicateFd(buffer.pid, fd);
+    if (!local_fd.ok()) return local_fd.status();
+    std::memcpy(handle.data, &*local_fd, sizeof(int));
+
+    void* ptr = nullptr;
+    SYCLError_t res = SYCLOpenIpcHandle(&device_, handle, &ptr);
+    close(*local_fd);
+    if (res != SYCL_SUCCESS) {
+      return absl::InternalError(absl::StrCat(
+          "Failed to open the IPC handle of process ", buffer.pid));
+    }
+    it = mappings_.emplace(key, Mapping{buffer.size, buffer.alloc_id, ptr})
+             .first;
+  }
+  return static_cast<char*>(it->second.ptr) + buffer.offset;
+}
+
+}  // namespace gpu
+}  // namespace xla
@@ -0,0 +1,145 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_GPU_CCL_IPC_H_
+#define XLA_SERVICE_GPU_CCL_IPC_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "xla/stream_executor/sycl/sycl_gpu_runtime.h"
+
+namespace xla {
+namespace gpu {
+
+// Device memory of a rank, in a form that ranks of other processes can map:
+// the IPC handle of the allocation containing the memory and its offset in
+// the allocation.
+struct IpcBuffer {
+  // Process owning the allocation, 0 for a null pointer.
+  int32_t pid = 0;
+  // Address and size of the allocation in the owning process.
+  uint64_t base = 0;
+  uint64_t size = 0;
+  uint64_t offset = 0;
+  // Level-Zero id of the allocation, a freed allocation and the next one at
+  // the same address have different ids.
+  uint64_t alloc_id = 0;
+  ze_ipc_mem_handle_t handle;
+};
+
+constexpr int kMaxIpcBuffers = 64;
+
+// Device pointers a rank publishes in an exchange between processes.
+struct IpcPayload {
+  int32_t num_buffers = 0;
+  IpcBuffer buffers[kMaxIpcBuffers];
+};
+
+// Host rendezvous of the ranks of a communicator spanning several processes.
+// Ranks publish their payloads in per-rank slots of a POSIX shared memory
+// segment named after the communicator. Slots are double buffered like the
+// slots of the exchange within a process. Opening a rendezvous allows the
+// processes of the user to duplicate file descriptors of this process, see
+// IpcBufferCache::Map.
+class IpcRendezvous {
+ public:
+  static absl::StatusOr<std::unique_ptr<IpcRendezvous>> Open(
+      const std::string& id, int nranks);
+  ~IpcRendezvous();
+
+  IpcRendezvous(const IpcRendezvous&) = delete;
+  IpcRendezvous& operator=(const IpcRendezvous&) = delete;
+
+  // Publishes the payload of `rank` for exchange `sequence` and returns the
+  // payloads of all ranks, ordered by rank, once they published theirs.
+  // Returns DeadlineExceeded if a rank did not publish within `timeout`.
+  absl::StatusOr<std::vector<IpcPayload>> Exchange(int rank, uint64_t sequence,
+                                                   const IpcPayload& payload,
+                                                   absl::Duration timeout);
+
+ private:
+  struct Slot;
+
+  IpcRendezvous(std::string name, void* segment, size_t bytes, int nranks)
+      : name_(std::move(name)),
+        segment_(segment),
+        bytes_(bytes),
+        nranks_(nranks) {}
+
+  Slot* slot(int rank);
+
+  std::string name_;
+  void* segment_;
+  size_t bytes_;
+  int nranks_;
+};
+
+// Exports device memory of a rank to other processes and maps device memory
+// they exported. IPC handles of exported allocations and mappings of imported
+// ones are cached by address and checked against the id of the allocation, so
+// each allocation is exported and mapped once. The handle of an allocation
+// replaced at the same address is released, and its mapping closed once the
+// work submitted before the replacement completed. Not thread-safe, each rank
+// has its own cache.
+class IpcBufferCache {
+ public:
+  explicit IpcBufferCache(sycl::device device) : device_(device) {}
+  ~IpcBufferCache();
+
+  IpcBufferCache(const IpcBufferCache&) = delete;
+  IpcBufferCache& operator=(const IpcBufferCache&) = delete;
+
+  absl::StatusOr<IpcBuffer> Export(const void* ptr);
+
+  // Returns the address of `buffer` in this process, which requires the
+  // permission to duplicate file descriptors of the owning process, or
+  // PermissionDenied without it. Work submitted to `stream` so far may still
+  // use replaced mappings. Without a stream, replaced mappings are closed once
+  // all the work of the device completed.
+  absl::StatusOr<void*> Map(const IpcBuffer& buffer, sycl::queue* stream);
+
+ private:
+  struct Mapping {
+    uint64_t size;
+    uint64_t alloc_id;
+    void* ptr;
+  };
+  struct RetiredMapping {
+    void* ptr;
+    sycl::event last_use;
+  };
+
+  // Closes the retired mappings no work uses anymore.
+  void CloseRetiredMappings();
+
+  sycl::device device_;
+  absl::flat_hash_map<const void*, IpcBuffer> exports_;
+  // Keyed by owning process and base address.
+  absl::flat_hash_map<std::pair<int32_t, uint64_t>, Mapping> mappings_;
+  std::vector<RetiredMapping> retired_;
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_GPU_CCL_IPC_H_
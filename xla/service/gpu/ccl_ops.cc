@@ -16,13 +16,33 @@ limitations under the License.
 #include "xla/service/gpu/ccl_ops.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <optional>
 #include <string>
+#include <thread>  // NOLINT
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/mutex.h"
+#include "tsl/platform/statusor.h"
+#include "tsl/profiler/lib/traceme.h"
+#include "tsl/util/env_var.h"
+#include "xla/service/gpu/ccl_ipc.h"
 #include "xla/service/gpu/utils.h"
 #include "xla/stream_executor/gpu/gpu_driver.h"
 #include "xla/stream_executor/sycl/sycl_gpu_runtime.h"
+#include "xla/stream_executor/sycl/sycl_stream_local.h"
+#include "xla/stream_executor/sycl/sycl_tracer.h"
 
 // TODO: It crashes when using public Eigen::bfloat16, need investigation.
 #include <sycl/ext/oneapi/bfloat16.hpp>
@@ -40,12 +60,14 @@ constexpr size_t VecBytes = 8;
 namespace {
 struct Participant {
   Participant(se::gpu::GpuStreamHandle stream, const void* send, void* recv,
-              int rank)
-      : stream(stream), send(send), recv(recv), rank(rank) {}
+              int rank, const void* addend = nullptr)
+      : stream(stream), send(send), recv(recv), rank(rank), addend(addend) {}
   se::gpu::GpuStreamHandle stream;
   const void* send;
   void* recv;
   int rank;
+  // Addend of the all-reduce epilogue of the rank, if any.
+  const void* addend;
 };
 
 struct AlltoAllParticipant {
@@ -64,16 +86,97 @@ struct PermuteParticipant {
   int rank;
 };
 
-template <typename T>
-struct Collective {
-  Collective() : done(false), ready_to_launch(false) {}
-  tsl::mutex mu;
-  tsl::condition_variable cv;
-  bool ready_to_launch TF_GUARDED_BY(mu);
-  bool done TF_GUARDED_BY(mu);
-  std::vector<T> participants TF_GUARDED_BY(mu);
-  std::vector<sycl::event> begin_events TF_GUARDED_BY(mu);
-  std::vector<sycl::event> end_events TF_GUARDED_BY(mu);
+}  // namespace
+}  // namespace gpu
+}  // namespace xla
+
+namespace ccl {
+// Ranks of a communicator exchange their buffers through per-rank slots on the
+// host, and synchronize their streams through flags in device memory. Neither
+// the host nor the device waits for a peer's device work to complete, and no
+// lock is taken after the first collective of the communicator. Communicators
+// spanning several processes exchange IPC handles of the buffers and flags
+// instead, through slots in shared memory.
+struct comm_state {
+  struct comm_topology {
+    // Card of each rank, cards are numbered in order of their first rank.
+    std::vector<int> card;
+    // Index of each rank among the ranks of its card.
+    std::vector<int> local_rank;
+    int num_cards = 0;
+    // Number of ranks of each card, 0 if cards have different numbers.
+    int ranks_per_card = 0;
+  };
+
+  struct rank_state {
+    // Sequence number of the last collective started by the rank. Only
+    // accessed by the thread running the rank.
+    uint64_t generation = 0;
+    // Sequence number of the last collective permute started by the rank.
+    // Permutes only synchronize pairwise, so they do not advance `generation`,
+    // which one-shot all-reduces rely on to be in lockstep across all ranks.
+    uint64_t permutes = 0;
+    // Sequence number of the last exchange of participants, which not all
+    // collectives need. Only accessed by the thread running the rank.
+    uint64_t exchanges = 0;
+    // Device flags the peers signal into, indexed by phase and peer rank.
+    uint64_t* flags = nullptr;
+    std::optional<sycl::context> context;
+    // Last exchange whose participant is published in `slots`. Slots are
+    // double buffered: a rank can only publish exchange e + 2 once all its
+    // peers published e + 1, i.e. finished reading exchange e.
+    std::atomic<uint64_t> published{0};
+    std::shared_ptr<const void> slots[2];
+    // Computed by the rank at its first all-reduce.
+    std::optional<comm_topology> topology;
+    // Buffer the peers push the inputs of one-shot all-reduces into, and the
+    // scratch buffers of all ranks. Allocated at the first one-shot
+    // all-reduce.
+    void* scratch = nullptr;
+    std::vector<void*> peer_scratch;
+    // Buffer of compressed all-reduces, grown on demand.
+    void* wire = nullptr;
+    size_t wire_bytes = 0;
+    // Set for communicators spanning several processes: the IPC handles and
+    // mappings of the rank, and the flags of all ranks mapped by the rank.
+    std::unique_ptr<xla::gpu::IpcBufferCache> ipc_buffers;
+    std::vector<uint64_t*> peer_flags;
+  };
+
+  explicit comm_state(int nranks) : ranks(nranks) {}
+  ~comm_state() {
+    for (rank_state& rank : ranks) {
+      if (rank.flags != nullptr) sycl::free(rank.flags, *rank.context);
+      if (rank.scratch != nullptr) sycl::free(rank.scratch, *rank.context);
+      if (rank.wire != nullptr) sycl::free(rank.wire, *rank.context);
+    }
+  }
+
+  std::vector<rank_state> ranks;
+  // Rendezvous of the ranks of all processes, null if all ranks live in this
+  // process.
+  std::unique_ptr<xla::gpu::IpcRendezvous> ipc;
+};
+}  // namespace ccl
+
+namespace xla {
+namespace gpu {
+namespace {
+
+using CommState = ccl::comm_state;
+using CommTopology = CommState::comm_topology;
+
+// Phases of a collective, each has its own set of device flags.
+enum BarrierPhase {
+  kBegin = 0,
+  kEnd = 1,
+  kHierarchicalReduce = 2,
+  kHierarchicalGather = 3,
+  kRing = 4,
+  kOneShot = 5,
+  kPermuteBegin = 6,
+  kPermuteEnd = 7,
+  kNumBarrierPhases = 8
 };
 
 struct Manager {
@@ -83,166 +186,1015 @@ struct Manager {
   }
 
   tsl::mutex mu;
-  std::unordered_map<std::string, std::shared_ptr<Collective<Participant>>>
-      collectives TF_GUARDED_BY(mu);
-  std::unordered_map<std::string,
-                     std::shared_ptr<Collective<AlltoAllParticipant>>>
-      alltoall_collectives TF_GUARDED_BY(mu);
-  std::unordered_map<std::string,
-                     std::shared_ptr<Collective<PermuteParticipant>>>
-      permute_collectives TF_GUARDED_BY(mu);
+  std::unordered_map<std::string, std::weak_ptr<CommState>> comm_states
+      TF_GUARDED_BY(mu);
 };
 
-template <typename T, typename Func, bool PartialStore>
-struct AllReduceKernel;
+// Collective kernels are specialized for groups of up to 2, 4, 8 and 16 ranks,
+// which capture their per-rank values by value and unroll their loops over
+// ranks. Kernels for larger groups read them from a table in device memory.
+constexpr int kMaxStaticRanks = 16;
+constexpr int kDynamicRanks = 0;
 
-template <typename T, typename Func, typename AccT = T>
-void allreduce_dpcpp(se::gpu::GpuStreamHandle stream, size_t element_count,
-                     std::vector<Participant>& participants, int rank,
-                     int reduction_size) {
-  constexpr size_t VecSize = VecBytes / sizeof(T);
-  size_t vec_count = element_count / VecSize;
-  size_t vec_tail_element_count = element_count % VecSize;
-  size_t total_vec_count = vec_count + (vec_tail_element_count > 0 ? 1 : 0);
+template <typename T, int MaxRanks>
+struct RankArray {
+  T values[MaxRanks];
+  T operator[](int i) const { return values[i]; }
+};
 
-  // Each rank allreduces a sub slice of the tensors. Last rank
-  // also allreduce the tail vectors of the tensor.
-  size_t slice_vec_count = total_vec_count / reduction_size;
-  size_t tail_vec_count = total_vec_count % reduction_size;
-  size_t local_vec_count =
-      slice_vec_count + ((rank == (reduction_size - 1)) ? tail_vec_count : 0);
+template <typename T>
+struct RankArray<T, kDynamicRanks> {
+  const T* values;
+  T operator[](int i) const { return values[i]; }
+};
 
-  if (local_vec_count == 0) return;
+// Calls `f(i)` for each rank i in [begin, count) in a kernel specialized for
+// `MaxRanks` ranks.
+template <int MaxRanks, typename F>
+inline void for_each_rank(int begin, int count, F&& f) {
+  if constexpr (MaxRanks == kDynamicRanks) {
+    for (int i = begin; i < count; ++i) f(i);
+  } else {
+#pragma unroll
+    for (int i = begin; i < MaxRanks; ++i) {
+      if (i < count) f(i);
+    }
+  }
+}
+
+// Calls `f` with the specialization of collective kernels for `count` ranks,
+// as an std::integral_constant.
+template <typename F>
+void dispatch_ranks(int count, F&& f) {
+  if (count <= 2) {
+    f(std::integral_constant<int, 2>());
+  } else if (count <= 4) {
+    f(std::integral_constant<int, 4>());
+  } else if (count <= 8) {
+    f(std::integral_constant<int, 8>());
+  } else if (count <= kMaxStaticRanks) {
+    f(std::integral_constant<int, kMaxStaticRanks>());
+  } else {
+    f(std::integral_constant<int, kDynamicRanks>());
+  }
+}
+
+// Tables of the per-rank values of kernels for large groups. A table is
+// written to host memory and copied to the device on the stream of its kernel,
+// so tables are reused round robin once their copy completed.
+class RankTablePool {
+ public:
+  explicit RankTablePool(se::gpu::GpuStreamHandle stream) : stream_(stream) {}
+
+  ~RankTablePool() {
+    stream_->wait();
+    for (Table& table : tables_) {
+      if (table.device == nullptr) continue;
+      sycl::free(table.host, *stream_);
+      sycl::free(table.device, *stream_);
+    }
+  }
+
+  static RankTablePool& Get(se::gpu::GpuStreamHandle stream) {
+    static auto* pools = new se::gpu::SYCLStreamLocal<RankTablePool>();
+    return pools->Get(stream);
+  }
+
+  // Returns a copy of `bytes` of `values` in device memory, for the kernels
+  // submitted to the stream next.
+  const void* Upload(const void* values, size_t bytes) {
+    Table& table = tables_[next_];
+    next_ = (next_ + 1) % kNumTables;
+    if (table.copy.has_value()) table.copy->wait();
+    if (table.bytes < bytes) {
+      if (table.device != nullptr) {
+        // Kernels submitted before may still read the table.
+        stream_->wait();
+        sycl::free(table.host, *stream_);
+        sycl::free(table.device, *stream_);
+      }
+      table.host = sycl::malloc_host(bytes, *stream_);
+      table.device = sycl::malloc_device(bytes, *stream_);
+      table.bytes = bytes;
+    }
+    std::memcpy(table.host, values, bytes);
+    table.copy = stream_->memcpy(table.device, table.host, bytes);
+    return table.device;
+  }
+
+ private:
+  struct Table {
+    void* host = nullptr;
+    void* device = nullptr;
+    size_t bytes = 0;
+    std::optional<sycl::event> copy;
+  };
+  static constexpr int kNumTables = 8;
+
+  se::gpu::GpuStreamHandle stream_;
+  Table tables_[kNumTables];
+  int next_ = 0;
+};
+
+template <int MaxRanks, typename T>
+RankArray<T, MaxRanks> make_rank_array(se::gpu::GpuStreamHandle stream,
+                                       const std::vector<T>& values) {
+  RankArray<T, MaxRanks> array;
+  if constexpr (MaxRanks == kDynamicRanks) {
+    if (values.empty()) {
+      array.values = nullptr;
+      return array;
+    }
+    array.values = static_cast<const T*>(RankTablePool::Get(stream).Upload(
+        values.data(), values.size() * sizeof(T)));
+  } else {
+    std::copy(values.begin(), values.end(), array.values);
+  }
+  return array;
+}
+
+// Returns the state shared by all ranks of `comm`.
+absl::StatusOr<CommState*> GetSharedCommState(ncclComm_t comm) {
+  if (comm->state == nullptr) {
+    tsl::mutex_lock l(Manager::instance().mu);
+    std::shared_ptr<CommState> state =
+        Manager::instance().comm_states[comm->id].lock();
+    if (state == nullptr) {
+      state = std::make_shared<CommState>(comm->nranks);
+      if (comm->multi_process) {
+        TF_ASSIGN_OR_RETURN(state->ipc,
+                            IpcRendezvous::Open(comm->id, comm->nranks));
+      }
+      Manager::instance().comm_states[comm->id] = state;
+    }
+    comm->state = std::move(state);
+  }
+  return comm->state.get();
+}
+
+template <typename T>
+absl::StatusOr<std::vector<T>> exchange(CommState& state, int rank,
+                                        T participant,
+                                        se::gpu::GpuStreamHandle stream);
+
+// Returns the state shared by all ranks of `comm`, allocating the device flags
+// of this rank on first use.
+absl::StatusOr<CommState*> GetCommState(ncclComm_t comm,
+                                        se::gpu::GpuStreamHandle stream) {
+  TF_ASSIGN_OR_RETURN(CommState * state, GetSharedCommState(comm));
+  CommState::rank_state& self = state->ranks[comm->rank];
+  if (self.flags == nullptr) {
+    const size_t kNumFlags = kNumBarrierPhases * comm->nranks;
+    self.context = stream->get_context();
+    uint64_t* flags = sycl::malloc_device<uint64_t>(kNumFlags, *stream);
+    stream->memset(flags, 0, kNumFlags * sizeof(uint64_t)).wait();
+    if (state->ipc != nullptr) {
+      // Already created if the rank registered buffers.
+      if (self.ipc_buffers == nullptr) {
+        self.ipc_buffers =
+            std::make_unique<IpcBufferCache>(stream->get_device());
+      }
+      absl::StatusOr<std::vector<void*>> peer_flags =
+          exchange<void*>(*state, comm->rank, flags, stream);
+      if (!peer_flags.ok()) {
+        sycl::free(flags, *stream);
+        return peer_flags.status();
+      }
+      for (void* peer : *peer_flags) {
+        self.peer_flags.push_back(static_cast<uint64_t*>(peer));
+      }
+    }
+    // Published to the peers by the release in exchange().
+    self.flags = flags;
+  }
+  return state;
+}
+
+// Returns the device flags of `peer`, as seen by `rank`.
+uint64_t* GetPeerFlags(CommState& state, int rank, int peer) {
+  if (state.ipc == nullptr) return state.ranks[peer].flags;
+  return state.ranks[rank].peer_flags[peer];
+}
+
+// Calls `f` with a reference to each device pointer of a participant.
+template <typename F>
+void ForEachBuffer(Participant& participant, F&& f) {
+  f(participant.send);
+  f(participant.recv);
+  f(participant.addend);
+}
+
+template <typename F>
+void ForEachBuffer(AlltoAllParticipant& participant, F&& f) {
+  for (const void*& send : participant.send) f(send);
+  for (void*& recv : participant.recv) f(recv);
+}
+
+template <typename F>
+void ForEachBuffer(PermuteParticipant& participant, F&& f) {
+  f(participant.send);
+  f(participant.recv);
+}
+
+template <typename F>
+void ForEachBuffer(void*& buffer, F&& f) {
+  f(buffer);
+}
+
+// Time a rank waits for the ranks of other processes to reach an exchange.
+absl::Duration IpcExchangeTimeout() {
+  static const absl::Duration timeout = [] {
+    int64_t seconds;
+    TF_CHECK_OK(tsl::ReadInt64FromEnvVar("XLA_SYCL_CCL_IPC_TIMEOUT_SECONDS",
+                                         600, &seconds));
+    return absl::Seconds(seconds);
+  }();
+  return timeout;
+}
+
+// Exchange between processes: the device pointers of `participant` are
+// published as IPC buffers, and those of the peers are mapped by this rank.
+// All other fields of the participants of the peers are copied from
+// `participant`, the collectives only read them for this rank.
+template <typename T>
+absl::StatusOr<std::vector<T>> ipc_exchange(CommState& state, int rank,
+                                            T participant,
+                                            se::gpu::GpuStreamHandle stream) {
+  CommState::rank_state& self = state.ranks[rank];
+  IpcPayload payload;
+  absl::Status status;
+  ForEachBuffer(participant, [&](auto& ptr) {
+    if (!status.ok()) return;
+    if (payload.num_buffers == kMaxIpcBuffers) {
+      status = absl::ResourceExhaustedError(
+          "Too many buffers to exchange between processes");
+      return;
+    }
+    absl::StatusOr<IpcBuffer> buffer = self.ipc_buffers->Export(ptr);
+    if (!buffer.ok()) {
+      status = buffer.status();
+      return;
+    }
+    payload.buffers[payload.num_buffers++] = *buffer;
+  });
+  TF_RETURN_IF_ERROR(status);
+  TF_ASSIGN_OR_RETURN(std::vector<IpcPayload> payloads,
+                      state.ipc->Exchange(rank, ++self.exchanges, payload,
+                                          IpcExchangeTimeout()));
+
+  std::vector<T> participants(payloads.size(), participant);
+  for (int i = 0; i < payloads.size() && status.ok(); ++i) {
+    if (i == rank) continue;
+    int index = 0;
+    ForEachBuffer(participants[i], [&](auto& ptr) {
+      if (!status.ok()) return;
+      absl::StatusOr<void*> mapped =
+          self.ipc_buffers->Map(payloads[i].buffers[index++], stream);
+      if (!mapped.ok()) {
+        status = absl::Status(
+            mapped.status().code(),
+            absl::StrCat("Failed to map a buffer of rank ", i, ": ",
+                         mapped.status().message()));
+        return;
+      }
+      ptr = *mapped;
+    });
+  }
+  TF_RETURN_IF_ERROR(status);
+  return participants;
+}
+
+// Publishes `participant` as the participant of `rank` in the next exchange
+// and returns the participants of all ranks ordered by rank. Only waits for
+// the peers to reach the same exchange on the host.
+template <typename T>
+absl::StatusOr<std::vector<T>> exchange(CommState& state, int rank,
+                                        T participant,
+                                        se::gpu::GpuStreamHandle stream) {
+  tsl::profiler::TraceMe trace("CclExchangeWait");
+  if (state.ipc != nullptr) {
+    return ipc_exchange(state, rank, std::move(participant), stream);
+  }
+  CommState::rank_state& self = state.ranks[rank];
+  uint64_t sequence = ++self.exchanges;
+  self.slots[sequence % 2] =
+      std::make_shared<const T>(std::move(participant));
+  self.published.store(sequence, std::memory_order_release);
+
+  std::vector<T> participants;
+  participants.reserve(state.ranks.size());
+  for (CommState::rank_state& peer : state.ranks) {
+    while (peer.published.load(std::memory_order_acquire) < sequence) {
+      std::this_thread::yield();
+    }
+    participants.push_back(
+        *std::static_pointer_cast<const T>(peer.slots[sequence % 2]));
+  }
+  return participants;
+}
+
+template <int MaxRanks>
+struct DeviceSyncKernel;
+
+// Enqueues a synchronization of `stream` with the streams of `peers`: signals
+// `value` to all peers in `phase`, and orders the work submitted to `stream`
+// afterwards after all peers signaled at least `value` in `phase` on their own
+// streams. Values signaled in a phase must increase monotonically.
+void device_sync(se::gpu::GpuStreamHandle stream, CommState& state, int rank,
+                 const std::vector<int>& peers, uint64_t value,
+                 BarrierPhase phase) {
+  int nranks = state.ranks.size();
+  int num_peers = peers.size();
+  std::vector<uint64_t*> signal_flags;
+  for (int peer : peers) {
+    signal_flags.push_back(GetPeerFlags(state, rank, peer) + phase * nranks);
+  }
+  uint64_t* wait_flags = state.ranks[rank].flags + phase * nranks;
+
+  // The device time of the kernel is the time the stream waited for the
+  // slowest peer.
+  se::gpu::SyclActivityScope activity(
+      stream, se::gpu::SyclActivityKind::kCollectiveWait, "CclDeviceSync");
+  dispatch_ranks(num_peers, [&](auto max_ranks) {
+    constexpr int MaxRanks = decltype(max_ranks)::value;
+    RankArray<uint64_t*, MaxRanks> signal =
+        make_rank_array<MaxRanks>(stream, signal_flags);
+    RankArray<int, MaxRanks> peer_ranks =
+        make_rank_array<MaxRanks>(stream, peers);
+    stream->single_task<DeviceSyncKernel<MaxRanks>>([=]() {
+      using release_ref =
+          sycl::atomic_ref<uint64_t, sycl::memory_order::release,
+                           sycl::memory_scope::system,
+                           sycl::access::address_space::global_space>;
+      using acquire_ref =
+          sycl::atomic_ref<uint64_t, sycl::memory_order::acquire,
+                           sycl::memory_scope::system,
+                           sycl::access::address_space::global_space>;
+      for_each_rank<MaxRanks>(0, num_peers, [&](int i) {
+        release_ref(signal[i][rank]).store(value);
+      });
+      for_each_rank<MaxRanks>(0, num_peers, [&](int i) {
+        acquire_ref flag(wait_flags[peer_ranks[i]]);
+        while (flag.load() < value) {
+        }
+      });
+    });
+  });
+}
+
+// Enqueues a barrier between the streams of all ranks: work submitted to
+// `stream` after the barrier starts once all ranks reached the barrier of
+// `phase` in collective `generation` on their own streams.
+void device_barrier(se::gpu::GpuStreamHandle stream, CommState& state,
+                    int rank, uint64_t generation, BarrierPhase phase) {
+  std::vector<int> peers(state.ranks.size());
+  std::iota(peers.begin(), peers.end(), 0);
+  device_sync(stream, state, rank, peers, generation, phase);
+}
+
+// Starts a collective on `comm`: exchanges the participants of all ranks and
+// orders `stream` after the pending work of the peers, which guarantees that
+// their buffers are ready.
+template <typename T>
+absl::StatusOr<std::vector<T>> begin_collective(
+    ncclComm_t comm, se::gpu::GpuStreamHandle stream, T participant,
+    uint64_t* generation) {
+  TF_ASSIGN_OR_RETURN(CommState * state, GetCommState(comm, stream));
+  *generation = ++state->ranks[comm->rank].generation;
+  TF_ASSIGN_OR_RETURN(
+      std::vector<T> participants,
+      exchange(*state, comm->rank, std::move(participant), stream));
+  device_barrier(stream, *state, comm->rank, *generation, kBegin);
+  return participants;
+}
+
+// Ends a collective: work submitted to `stream` afterwards starts once all
+// ranks finished reading from and writing to the buffers of this rank.
+void end_collective(ncclComm_t comm, se::gpu::GpuStreamHandle stream,
+                    uint64_t generation) {
+  device_barrier(stream, *comm->state, comm->rank, generation, kEnd);
+}
+
+// Epilogue of a reduction whose outputs start at element `offset` of an
+// all-reduce, with one addend per output or none.
+template <typename T>
+struct ReduceEpilogue {
+  std::vector<const T*> addends;
+  size_t addend_count = 0;
+  size_t offset = 0;
+};
+
+// Adds the addends of an all-reduce epilogue to the vector of elements that
+// starts at element `index` of the all-reduce.
+template <typename AccT, uint32_t N, typename Func, typename T>
+inline void add_epilogue(AlignedVector<AccT, N, Func>& value, const T* addend,
+                         size_t addend_count, size_t index) {
+  for (uint32_t i = 0; i < N; ++i) {
+    value[i] += static_cast<AccT>(addend[(index + i) % addend_count]);
+  }
+}
+
+template <typename T, typename Func, typename AccT, bool PartialStore,
+          int MaxRanks>
+struct AllReduceKernel;
+
+template <typename T, typename Func, typename AccT, bool PartialStore,
+          int MaxRanks>
+void reduce_kernel(se::gpu::GpuStreamHandle stream, size_t element_count,
+                   const std::vector<const T*>& inputs,
+                   const std::vector<T*>& outputs,
+                   const ReduceEpilogue<T>& epilogue) {
+  constexpr size_t VecSize = VecBytes / sizeof(T);
+  using Vec = AlignedVector<T, VecSize>;
+  size_t vec_count = (element_count + VecSize - 1) / VecSize;
+  uint32_t vec_tail_element_count = element_count % VecSize;
 
   auto device = stream->get_device();
   int group_size =
       device.template get_info<sycl::info::device::max_work_group_size>();
 
   // set max_workitems = HW_workgroup_num * max_workgroup_size
-  int num_max_concurrent_workitem =
+  size_t num_max_concurrent_workitem =
       stream_executor::gpu::GpuDriver::GetMultiprocessorCount(&device).value() *
       group_size;
-  int num_workitem = local_vec_count <= num_max_concurrent_workitem
-                         ? local_vec_count
-                         : num_max_concurrent_workitem;
-  size_t num_vec_per_workitem = local_vec_count / num_workitem;
-  size_t num_tail_vec = local_vec_count % num_workitem;
+  size_t num_workitem = std::min(vec_count, num_max_concurrent_workitem);
+  size_t num_workgroup = (num_workitem + group_size - 1) / group_size;
+
+  int num_inputs = inputs.size();
+  int num_outputs = outputs.size();
+  int num_addends = epilogue.addends.size();
+  RankArray<const T*, MaxRanks> in_ptr =
+      make_rank_array<MaxRanks>(stream, inputs);
+  RankArray<T*, MaxRanks> out_ptr = make_rank_array<MaxRanks>(stream, outputs);
+  RankArray<const T*, MaxRanks> addend_ptr =
+      make_rank_array<MaxRanks>(stream, epilogue.addends);
+  size_t addend_count = epilogue.addend_count;
+  size_t addend_offset = epilogue.offset;
+
+  stream->submit([&](sycl::handler& cgh) {
+    cgh.parallel_for<AllReduceKernel<T, Func, AccT, PartialStore, MaxRanks>>(
+        sycl::nd_range<1>(sycl::range<1>(group_size * num_workgroup),
+                          sycl::range<1>(group_size)),
+        [=](sycl::nd_item<1> item) {
+          const size_t index = item.get_global_linear_id();
+          for (size_t n = index; n < vec_count; n += num_workitem) {
+            size_t offset = n * VecSize;
+            AlignedVector<AccT, VecSize, Func> result;
+            result.Load(*reinterpret_cast<const Vec*>(&(in_ptr[0][offset])));
+            for_each_rank<MaxRanks>(1, num_inputs, [&](int i) {
+              result.Accumulate(
+                  *reinterpret_cast<const Vec*>(&(in_ptr[i][offset])));
+            });
 
-  int num_workgroup = (num_workitem + group_size - 1) / group_size;
+            for_each_rank<MaxRanks>(0, num_outputs, [&](int i) {
+              AlignedVector<AccT, VecSize, Func> value = result;
+              if (i < num_addends) {
+                add_epilogue(value, addend_ptr[i], addend_count,
+                             addend_offset + offset);
+              }
+              Vec& output = *reinterpret_cast<Vec*>(&(out_ptr[i][offset]));
+              // The last vector may be partial and need partial block store.
+              if (PartialStore && n == vec_count - 1) {
+                value.PartialStore(output, vec_tail_element_count);
+              } else {
+                value.Store(output);
+              }
+            });
+          }
+        });
+  });
+}
 
-  if (reduction_size <= MAX_RANK_SIZE) {
-    stream->submit([&](sycl::handler& cgh) {
-      T* in_ptr[MAX_RANK_SIZE];
-      T* out_ptr[MAX_RANK_SIZE];
-
-      for (int i = 0; i < reduction_size; ++i) {
-        in_ptr[i] = static_cast<T*>(const_cast<void*>(participants[i].send)) +
-                    rank * slice_vec_count * VecSize;
-        out_ptr[i] = static_cast<T*>(participants[i].recv) +
-                     rank * slice_vec_count * VecSize;
+// Reduces `element_count` elements of all `inputs` and stores the result to
+// all `outputs`, adding the addends of `epilogue` if any. Inputs and outputs
+// must be aligned to VecBytes.
+template <typename T, typename Func, typename AccT = T>
+void reduce_dpcpp(se::gpu::GpuStreamHandle stream, size_t element_count,
+                  const std::vector<const T*>& inputs,
+                  const std::vector<T*>& outputs,
+                  const ReduceEpilogue<T>& epilogue = {}) {
+  constexpr size_t VecSize = VecBytes / sizeof(T);
+  if (element_count == 0) return;
+  int num_ranks = std::max(inputs.size(), outputs.size());
+  dispatch_ranks(num_ranks, [&](auto max_ranks) {
+    constexpr int MaxRanks = decltype(max_ranks)::value;
+    if (element_count % VecSize == 0) {
+      reduce_kernel<T, Func, AccT, false, MaxRanks>(
+          stream, element_count, inputs, outputs, epilogue);
+    } else {
+      reduce_kernel<T, Func, AccT, true, MaxRanks>(
+          stream, element_count, inputs, outputs, epilogue);
+    }
+  });
+}
+
+// Returns the [begin, end) range of elements of slice `index` when
+// `element_count` elements are split into `num_slices` slices of whole
+// vectors. The last slice also holds the remaining vectors and the tail.
+std::pair<size_t, size_t> vec_slice(size_t element_count, size_t vec_size,
+                                    int index, int num_slices) {
+  size_t total_vec_count = (element_count + vec_size - 1) / vec_size;
+  size_t slice_vec_count = total_vec_count / num_slices;
+  size_t begin = index * slice_vec_count * vec_size;
+  size_t end = element_count;
+  if (index != num_slices - 1) {
+    end = std::min(element_count, begin + slice_vec_count * vec_size);
+  }
+  return {std::min(begin, end), end};
+}
+
+// Placement of the ranks of a communicator on cards, the same on all ranks.
+const CommTopology& GetCommTopology(
+    ncclComm_t comm, const std::vector<Participant>& participants) {
+  CommState::rank_state& self = comm->state->ranks[comm->rank];
+  if (self.topology.has_value()) return *self.topology;
+
+  int nranks = participants.size();
+  CommTopology topology;
+  // Devices of other processes are unknown, each rank counts as a card.
+  if (comm->state->ipc != nullptr) {
+    topology.card.resize(nranks);
+    std::iota(topology.card.begin(), topology.card.end(), 0);
+    topology.local_rank.assign(nranks, 0);
+    topology.num_cards = nranks;
+    topology.ranks_per_card = 1;
+    self.topology = std::move(topology);
+    return *self.topology;
+  }
+
+  std::vector<sycl::device> devices;
+  for (const Participant& participant : participants) {
+    devices.push_back(participant.stream->get_device());
+  }
+
+  std::vector<int> card_size;
+  for (int i = 0; i < nranks; ++i) {
+    int card = -1;
+    for (int j = 0; j < i && card < 0; ++j) {
+      SYCLLinkClass_t link_class;
+      if (SYCLGetLinkClass(&devices[i], &devices[j], &link_class) !=
+          SYCL_SUCCESS) {
+        LOG(WARNING) << "Failed to get the link class between ranks " << i
+                     << " and " << j;
+        continue;
       }
+      VLOG(2) << "Link class between ranks " << i << " and " << j << ": "
+              << link_class;
+      if (link_class <= SYCL_LINK_SAME_CARD) card = topology.card[j];
+    }
+    if (card < 0) {
+      card = card_size.size();
+      card_size.push_back(0);
+    }
+    topology.card.push_back(card);
+    topology.local_rank.push_back(card_size[card]++);
+  }
+  topology.num_cards = card_size.size();
+  topology.ranks_per_card =
+      std::all_of(card_size.begin(), card_size.end(),
+                  [&](int size) { return size == card_size[0]; })
+          ? card_size[0]
+          : 0;
+  self.topology = std::move(topology);
+  return *self.topology;
+}
 
-      // Last rank may need to process the tail elements which can't form a
-      // full vector and need partial block store.
-      if (rank != (reduction_size - 1) || vec_tail_element_count == 0) {
-        cgh.parallel_for<AllReduceKernel<T, Func, false>>(
-            sycl::nd_range<1>(sycl::range<1>(group_size * num_workgroup),
-                              sycl::range<1>(group_size)),
-            [=](sycl::nd_item<1> item) {
-              const int index = item.get_global_linear_id();
-              if (index >= num_workitem) return;
-
-              for (size_t n = 0; n < num_vec_per_workitem; ++n) {
-                size_t offset = (num_workitem * n + index) * VecSize;
-                AlignedVector<AccT, VecSize, Func> result;
-                result.Load(*reinterpret_cast<AlignedVector<T, VecSize>*>(
-                    &(in_ptr[0][offset])));
-                for (int i = 1; i < reduction_size; ++i)
-                  result.Accumulate(
-                      *reinterpret_cast<AlignedVector<T, VecSize>*>(
-                          &(in_ptr[i][offset])));
-                for (int i = 0; i < reduction_size; ++i)
-                  result.Store(*reinterpret_cast<AlignedVector<T, VecSize>*>(
-                      &(out_ptr[i][offset])));
-              }
+enum class AllReduceAlgorithm { kFlat, kHierarchical, kRing };
 
-              if (index < num_tail_vec) {
-                size_t offset =
-                    (num_workitem * num_vec_per_workitem + index) * VecSize;
-                AlignedVector<AccT, VecSize, Func> result;
-                result.Load(*reinterpret_cast<AlignedVector<T, VecSize>*>(
-                    &(in_ptr[0][offset])));
-                for (int i = 1; i < reduction_size; ++i)
-                  result.Accumulate(
-                      *reinterpret_cast<AlignedVector<T, VecSize>*>(
-                          &(in_ptr[i][offset])));
-                for (int i = 0; i < reduction_size; ++i)
-                  result.Store(*reinterpret_cast<AlignedVector<T, VecSize>*>(
-                      &(out_ptr[i][offset])));
-              }
+int64_t ReadAllReduceThreshold(const char* env_var, int64_t default_bytes) {
+  int64_t bytes;
+  TF_CHECK_OK(tsl::ReadInt64FromEnvVar(env_var, default_bytes, &bytes));
+  return bytes;
+}
+
+// Selects the algorithm for an all-reduce of `bytes`. The flat kernel has the
+// lowest latency, but every rank reads from all peers at once. Larger messages
+// are reduced hierarchically on multi-card topologies, which pays two extra
+// barriers to keep the traffic between cards to one slice per tile, or with a
+// ring otherwise, which only uses the links between neighbors. A negative
+// threshold disables an algorithm.
+AllReduceAlgorithm select_allreduce_algorithm(const CommTopology& topology,
+                                              int nranks, size_t bytes) {
+  static const int64_t hierarchical_min_bytes = ReadAllReduceThreshold(
+      "XLA_SYCL_HIERARCHICAL_ALLREDUCE_MIN_BYTES", 256 * 1024);
+  static const int64_t ring_min_bytes = ReadAllReduceThreshold(
+      "XLA_SYCL_RING_ALLREDUCE_MIN_BYTES", 64 * 1024 * 1024);
+  auto above = [&](int64_t min_bytes) {
+    return min_bytes >= 0 && static_cast<int64_t>(bytes) >= min_bytes;
+  };
+  if (above(hierarchical_min_bytes) && topology.num_cards > 1 &&
+      topology.ranks_per_card > 1) {
+    return AllReduceAlgorithm::kHierarchical;
+  }
+  // Neighbors can't tell the direction of a signal apart with 2 ranks.
+  if (above(ring_min_bytes) && nranks > 2) return AllReduceAlgorithm::kRing;
+  return AllReduceAlgorithm::kFlat;
+}
+
+// Flat all-reduce: each rank reduces a slice of all inputs and stores it to
+// all outputs, with the epilogue of each output's rank.
+template <typename T, typename Func, typename AccT>
+void flat_allreduce_dpcpp(se::gpu::GpuStreamHandle stream, size_t element_count,
+                          std::vector<Participant>& participants, int rank,
+                          int reduction_size, size_t addend_count) {
+  constexpr size_t VecSize = VecBytes / sizeof(T);
+  auto [begin, end] = vec_slice(element_count, VecSize, rank, reduction_size);
+  std::vector<const T*> inputs;
+  std::vector<T*> outputs;
+  ReduceEpilogue<T> epilogue;
+  for (int i = 0; i < reduction_size; ++i) {
+    inputs.push_back(static_cast<const T*>(participants[i].send) + begin);
+    outputs.push_back(static_cast<T*>(participants[i].recv) + begin);
+    if (participants[i].addend != nullptr) {
+      epilogue.addends.push_back(static_cast<const T*>(participants[i].addend));
+    }
+  }
+  epilogue.addend_count = addend_count;
+  epilogue.offset = begin;
+  reduce_dpcpp<T, Func, AccT>(stream, end - begin, inputs, outputs, epilogue);
+}
+
+// Two-level all-reduce for ranks spread over several cards. With tile `t` of
+// card `c` running rank (c, t):
+//  1. reduce-scatter within each card: (c, t) reduces slice t of the inputs
+//     of card c into its output,
+//  2. all-reduce between cards: (c, t) reduces part c of slice t over the
+//     outputs of ranks (*, t) in place,
+//  3. all-gather within each card: (c, t) copies slice t of its output to the
+//     outputs of the other tiles of card c.
+// Only step 2 crosses the slower links between cards.
+template <typename T, typename Func, typename AccT>
+void hierarchical_allreduce_dpcpp(
+    se::gpu::GpuStreamHandle stream, size_t element_count,
+    std::vector<Participant>& participants, ncclComm_t comm,
+    const CommTopology& topology, uint64_t generation) {
+  constexpr size_t VecSize = VecBytes / sizeof(T);
+  int nranks = participants.size();
+  int card = topology.card[comm->rank];
+  int tile = topology.local_rank[comm->rank];
+  std::vector<int> card_ranks;
+  std::vector<int> tile_ranks;
+  for (int i = 0; i < nranks; ++i) {
+    if (topology.card[i] == card) card_ranks.push_back(i);
+    if (topology.local_rank[i] == tile) tile_ranks.push_back(i);
+  }
+  auto send = [&](int rank) {
+    return static_cast<const T*>(participants[rank].send);
+  };
+  auto recv = [&](int rank) {
+    return static_cast<T*>(participants[rank].recv);
+  };
+
+  auto [begin, end] =
+      vec_slice(element_count, VecSize, tile, topology.ranks_per_card);
+  std::vector<const T*> inputs;
+  for (int i : card_ranks) inputs.push_back(send(i) + begin);
+  reduce_dpcpp<T, Func, AccT>(stream, end - begin, inputs,
+                              {recv(comm->rank) + begin});
+  device_barrier(stream, *comm->state, comm->rank, generation,
+                 kHierarchicalReduce);
+
+  auto [part_begin, part_end] =
+      vec_slice(end - begin, VecSize, card, topology.num_cards);
+  inputs.clear();
+  std::vector<T*> outputs;
+  for (int i : tile_ranks) {
+    inputs.push_back(recv(i) + begin + part_begin);
+    outputs.push_back(recv(i) + begin + part_begin);
+  }
+  reduce_dpcpp<T, Func, AccT>(stream, part_end - part_begin, inputs, outputs);
+  device_barrier(stream, *comm->state, comm->rank, generation,
+                 kHierarchicalGather);
+
+  if (end == begin) return;
+  for (int i : card_ranks) {
+    if (i == comm->rank) continue;
+    stream->memcpy(recv(i) + begin, recv(comm->rank) + begin,
+                   (end - begin) * sizeof(T));
+  }
+}
+
+// Ring all-reduce, pipelined over chunks of
+// XLA_SYCL_RING_ALLREDUCE_CHUNK_BYTES. Each chunk is split in one segment per
+// rank, and the ring runs 2 * (n - 1) steps over it: at step t, rank r stores
+// segment r - t - 1 from the same segment of its left neighbor, either reduced
+// with its own input during the first n - 1 steps (reduce-scatter) or copied
+// (all-gather). Ranks only read from their left neighbor, and synchronize with
+// both neighbors between steps so that no rank gets more than one step ahead
+// of them.
+template <typename T, typename Func, typename AccT>
+void ring_allreduce_dpcpp(se::gpu::GpuStreamHandle stream,
+                          size_t element_count,
+                          std::vector<Participant>& participants,
+                          ncclComm_t comm, uint64_t generation) {
+  constexpr size_t VecSize = VecBytes / sizeof(T);
+  static const int64_t chunk_bytes = ReadAllReduceThreshold(
+      "XLA_SYCL_RING_ALLREDUCE_CHUNK_BYTES", 32 * 1024 * 1024);
+  size_t chunk_count =
+      std::max<size_t>(chunk_bytes / sizeof(T) / VecSize, 1) * VecSize;
+
+  int nranks = comm->nranks;
+  int rank = comm->rank;
+  int left = (rank + nranks - 1) % nranks;
+  int right = (rank + 1) % nranks;
+  const T* send = static_cast<const T*>(participants[rank].send);
+  T* recv = static_cast<T*>(participants[rank].recv);
+  const T* left_send = static_cast<const T*>(participants[left].send);
+  const T* left_recv = static_cast<const T*>(participants[left].recv);
+
+  // Steps of all chunks are numbered continuously within the collective.
+  uint64_t step = 0;
+  for (size_t chunk = 0; chunk < element_count; chunk += chunk_count) {
+    size_t count = std::min(chunk_count, element_count - chunk);
+    for (int t = 0; t < 2 * (nranks - 1); ++t, ++step) {
+      if (step > 0) {
+        device_sync(stream, *comm->state, rank, {left, right},
+                    (generation << 32) | step, kRing);
+      }
+      int segment = ((rank - t - 1) % nranks + nranks) % nranks;
+      auto [begin, end] = vec_slice(count, VecSize, segment, nranks);
+      size_t offset = chunk + begin;
+      if (t < nranks - 1) {
+        const T* partial = (t == 0 ? left_send : left_recv) + offset;
+        reduce_dpcpp<T, Func, AccT>(stream, end - begin,
+                                    {send + offset, partial}, {recv + offset});
+      } else if (end > begin) {
+        stream->memcpy(recv + offset, left_recv + offset,
+                       (end - begin) * sizeof(T));
+      }
+    }
+  }
+}
+
+// Largest all-reduce in bytes that runs one-shot, 0 disables one-shot
+// all-reduces.
+size_t OneShotAllReduceMaxBytes() {
+  static const size_t max_bytes = [] {
+    int64_t max_bytes = ReadAllReduceThreshold(
+        "XLA_SYCL_ONESHOT_ALLREDUCE_MAX_BYTES", 256 * 1024);
+    // Keeps the slots of the scratch buffers aligned to vectors.
+    return std::max<int64_t>(max_bytes, 0) / VecBytes * VecBytes;
+  }();
+  return max_bytes;
+}
+
+template <typename T, typename Func, typename AccT, bool PartialStore,
+          int MaxRanks>
+struct OneShotAllReduceKernel;
+
+// One-shot all-reduce for small messages, in a single work group kernel that
+// needs neither an exchange on the host nor barriers with the peers: each rank
+// pushes its input into its slot of the scratch buffers of all peers, signals
+// them, waits for their signals and reduces its own scratch buffer. Scratch
+// buffers are double buffered by generation: a rank can only push generation
+// g + 2 after all its peers signaled g + 1, i.e. finished reading g.
+template <typename T, typename Func, typename AccT, bool PartialStore,
+          int MaxRanks>
+absl::Status oneshot_allreduce_kernel(se::gpu::GpuStreamHandle stream,
+                                      size_t element_count,
+                                      const void* send_buffer,
+                                      void* recv_buffer, ncclComm_t comm,
+                                      const AllReduceEpilogue& epilogue) {
+  constexpr size_t VecSize = VecBytes / sizeof(T);
+  using Vec = AlignedVector<T, VecSize>;
+  size_t vec_count = (element_count + VecSize - 1) / VecSize;
+  uint32_t vec_tail_element_count = element_count % VecSize;
+
+  int nranks = comm->nranks;
+  int rank = comm->rank;
+  size_t slot_bytes = OneShotAllReduceMaxBytes();
+  TF_ASSIGN_OR_RETURN(CommState * comm_state, GetCommState(comm, stream));
+  CommState& state = *comm_state;
+  CommState::rank_state& self = state.ranks[rank];
+  if (self.scratch == nullptr) {
+    void* scratch = sycl::malloc_device(2 * nranks * slot_bytes, *stream);
+    absl::StatusOr<std::vector<void*>> peer_scratch =
+        exchange(state, rank, scratch, stream);
+    if (!peer_scratch.ok()) {
+      sycl::free(scratch, *stream);
+      return peer_scratch.status();
+    }
+    self.scratch = scratch;
+    self.peer_scratch = *std::move(peer_scratch);
+  }
+  uint64_t generation = ++self.generation;
+
+  size_t buffer_offset = (generation % 2) * nranks * slot_bytes;
+  std::vector<T*> push_slots;
+  std::vector<uint64_t*> signal_slots;
+  for (int i = 0; i < nranks; ++i) {
+    char* slot = static_cast<char*>(self.peer_scratch[i]) + buffer_offset +
+                 rank * slot_bytes;
+    push_slots.push_back(reinterpret_cast<T*>(slot));
+    signal_slots.push_back(GetPeerFlags(state, rank, i) + kOneShot * nranks +
+                           rank);
+  }
+  RankArray<T*, MaxRanks> push_ptr =
+      make_rank_array<MaxRanks>(stream, push_slots);
+  RankArray<uint64_t*, MaxRanks> signal_flags =
+      make_rank_array<MaxRanks>(stream, signal_slots);
+  T* gather_ptr =
+      reinterpret_cast<T*>(static_cast<char*>(self.scratch) + buffer_offset);
+  size_t slot_count = slot_bytes / sizeof(T);
+  uint64_t* wait_flags = self.flags + kOneShot * nranks;
+  T* in_ptr = static_cast<T*>(const_cast<void*>(send_buffer));
+  T* out_ptr = static_cast<T*>(recv_buffer);
+  const T* addend_ptr = static_cast<const T*>(epilogue.addend);
+  size_t addend_count = epilogue.addend_count;
+
+  auto device = stream->get_device();
+  size_t group_size =
+      device.template get_info<sycl::info::device::max_work_group_size>();
+
+  stream->submit([&](sycl::handler& cgh) {
+    cgh.parallel_for<
+        OneShotAllReduceKernel<T, Func, AccT, PartialStore, MaxRanks>>(
+        sycl::nd_range<1>(sycl::range<1>(group_size),
+                          sycl::range<1>(group_size)),
+        [=](sycl::nd_item<1> item) {
+          using release_ref =
+              sycl::atomic_ref<uint64_t, sycl::memory_order::release,
+                               sycl::memory_scope::system,
+                               sycl::access::address_space::global_space>;
+          using acquire_ref =
+              sycl::atomic_ref<uint64_t, sycl::memory_order::acquire,
+                               sycl::memory_scope::system,
+                               sycl::access::address_space::global_space>;
+          const size_t index = item.get_local_linear_id();
+          for (size_t n = index; n < vec_count; n += group_size) {
+            Vec value = *reinterpret_cast<Vec*>(&(in_ptr[n * VecSize]));
+            for_each_rank<MaxRanks>(0, nranks, [&](int i) {
+              *reinterpret_cast<Vec*>(&(push_ptr[i][n * VecSize])) = value;
             });
-      } else {
-        cgh.parallel_for<AllReduceKernel<T, Func, true>>(
-            sycl::nd_range<1>(sycl::range<1>(group_size * num_workgroup),
-                              sycl::range<1>(group_size)),
-            [=](sycl::nd_item<1> item) {
-              const int index = item.get_global_linear_id();
-              if (index >= num_workitem) return;
-
-              for (size_t n = 0; n < num_vec_per_workitem; ++n) {
-                size_t offset = (num_workitem * n + index) * VecSize;
-                AlignedVector<AccT, VecSize, Func> result;
-                result.Load(*reinterpret_cast<AlignedVector<T, VecSize>*>(
-                    &(in_ptr[0][offset])));
-                for (int i = 1; i < reduction_size; ++i)
-                  result.Accumulate(
-                      *reinterpret_cast<AlignedVector<T, VecSize>*>(
-                          &(in_ptr[i][offset])));
-
-                if (local_vec_count > num_workitem ||
-                    index != (num_workitem - 1)) {
-                  for (int i = 0; i < reduction_size; ++i)
-                    result.Store(*reinterpret_cast<AlignedVector<T, VecSize>*>(
-                        &(out_ptr[i][offset])));
-                } else {  // the last workitem may process a partial vector
-                  for (int i = 0; i < reduction_size; ++i)
-                    result.PartialStore(
-                        *reinterpret_cast<AlignedVector<T, VecSize>*>(
-                            &(out_ptr[i][offset])),
-                        vec_tail_element_count);
-                }
+          }
+          sycl::atomic_fence(sycl::memory_order::release,
+                             sycl::memory_scope::system);
+          sycl::group_barrier(item.get_group());
+
+          if (index == 0) {
+            for_each_rank<MaxRanks>(0, nranks, [&](int i) {
+              release_ref(*signal_flags[i]).store(generation);
+            });
+            for (int i = 0; i < nranks; ++i) {
+              acquire_ref flag(wait_flags[i]);
+              while (flag.load() < generation) {
               }
+            }
+          }
+          sycl::group_barrier(item.get_group());
+          sycl::atomic_fence(sycl::memory_order::acquire,
+                             sycl::memory_scope::system);
+
+          for (size_t n = index; n < vec_count; n += group_size) {
+            size_t offset = n * VecSize;
+            AlignedVector<AccT, VecSize, Func> result;
+            result.Load(*reinterpret_cast<Vec*>(&(gather_ptr[offset])));
+            for (int i = 1; i < nranks; ++i)
+              result.Accumulate(*reinterpret_cast<Vec*>(
+                  &(gather_ptr[i * slot_count + offset])));
+            if (addend_ptr != nullptr) {
+              add_epilogue(result, addend_ptr, addend_count, offset);
+            }
+            if (PartialStore && n == vec_count - 1) {
+              result.PartialStore(*reinterpret_cast<Vec*>(&(out_ptr[offset])),
+                                  vec_tail_element_count);
+            } else {
+              result.Store(*reinterpret_cast<Vec*>(&(out_ptr[offset])));
+            }
+          }
+        });
+  });
+  return absl::OkStatus();
+}
 
-              if (index < num_tail_vec) {
-                size_t offset =
-                    (num_workitem * num_vec_per_workitem + index) * VecSize;
-                AlignedVector<AccT, VecSize, Func> result;
-                result.Load(*reinterpret_cast<AlignedVector<T, VecSize>*>(
-                    &(in_ptr[0][offset])));
-                for (int i = 1; i < reduction_size; ++i)
-                  result.Accumulate(
-                      *reinterpret_cast<AlignedVector<T, VecSize>*>(
-                          &(in_ptr[i][offset])));
-
-                if (index != num_tail_vec - 1) {
-                  for (int i = 0; i < reduction_size; ++i)
-                    result.Store(*reinterpret_cast<AlignedVector<T, VecSize>*>(
-                        &(out_ptr[i][offset])));
-                } else {  // the last workitem may process a partial vector
-                  for (int i = 0; i < reduction_size; ++i)
-                    result.PartialStore(
-                        *reinterpret_cast<AlignedVector<T, VecSize>*>(
-                            &(out_ptr[i][offset])),
-                        vec_tail_element_count);
-                }
-              }
-            });
+template <typename SrcT, typename DstT>
+struct WireConvertKernel;
+
+// Converts `element_count` elements of `input` to the type of `output`,
+// adding the addend of `epilogue` if any.
+template <typename SrcT, typename DstT>
+void wire_convert_dpcpp(se::gpu::GpuStreamHandle stream, size_t element_count,
+                        const SrcT* input, DstT* output,
+                        const AllReduceEpilogue& epilogue = {}) {
+  if (element_count == 0) return;
+  const DstT* addend = static_cast<const DstT*>(epilogue.addend);
+  size_t addend_count = epilogue.addend_count;
+  stream->parallel_for<WireConvertKernel<SrcT, DstT>>(
+      sycl::range<1>(element_count), [=](sycl::id<1> id) {
+        size_t i = id[0];
+        DstT value = static_cast<DstT>(input[i]);
+        if (addend != nullptr) value += addend[i % addend_count];
+        output[i] = value;
+      });
+}
+
+// Returns the wire buffer of `rank`, with room for at least `bytes`.
+void* GetWireBuffer(CommState& state, int rank, size_t bytes,
+                    se::gpu::GpuStreamHandle stream) {
+  CommState::rank_state& self = state.ranks[rank];
+  if (self.wire_bytes < bytes) {
+    if (self.wire != nullptr) {
+      // Peers are done with the buffer once the stream passed the end of the
+      // last collective.
+      stream->wait();
+      sycl::free(self.wire, *self.context);
+    }
+    self.wire = sycl::malloc_device(bytes, *stream);
+    self.wire_bytes = bytes;
+  }
+  return self.wire;
+}
+
+// Sum all-reduce of F32 with the BF16 wire format, which halves the traffic
+// between ranks: each rank converts its input into its wire buffer, reduces a
+// slice of the wire buffers of all ranks in FP32 and stores it back to all of
+// them in place, and converts its wire buffer to its output once all ranks are
+// done. All ranks get the same result, rounded to BF16.
+template <typename Func>
+absl::Status compressed_allreduce_dpcpp(se::gpu::GpuStreamHandle stream,
+                                        size_t element_count,
+                                        const void* send_buffer,
+                                        void* recv_buffer, ncclComm_t comm,
+                                        const AllReduceEpilogue& epilogue) {
+  TF_ASSIGN_OR_RETURN(CommState * state, GetCommState(comm, stream));
+  bfloat16* wire = static_cast<bfloat16*>(GetWireBuffer(
+      *state, comm->rank, element_count * sizeof(bfloat16), stream));
+  wire_convert_dpcpp(stream, element_count,
+                     static_cast<const float*>(send_buffer), wire);
+
+  uint64_t generation;
+  TF_ASSIGN_OR_RETURN(
+      std::vector<Participant> participants,
+      begin_collective<Participant>(
+          comm, stream, {stream, wire, wire, comm->rank}, &generation));
+  flat_allreduce_dpcpp<bfloat16, Func, float>(stream, element_count,
+                                              participants, comm->rank,
+                                              comm->nranks, 0);
+  end_collective(comm, stream, generation);
+
+  wire_convert_dpcpp(stream, element_count, wire,
+                     static_cast<float*>(recv_buffer), epilogue);
+  return absl::OkStatus();
+}
+
+template <typename T, typename Func, typename AccT = T>
+absl::Status allreduce_dpcpp(se::gpu::GpuStreamHandle stream,
+                             size_t element_count, const void* send_buffer,
+                             void* recv_buffer, ncclComm_t comm,
+                             const AllReduceEpilogue& epilogue) {
+  if (element_count > 0 &&
+      element_count * sizeof(T) <= OneShotAllReduceMaxBytes()) {
+    constexpr size_t VecSize = VecBytes / sizeof(T);
+    absl::Status status;
+    dispatch_ranks(comm->nranks, [&](auto max_ranks) {
+      constexpr int MaxRanks = decltype(max_ranks)::value;
+      if (element_count % VecSize == 0) {
+        status = oneshot_allreduce_kernel<T, Func, AccT, false, MaxRanks>(
+            stream, element_count, send_buffer, recv_buffer, comm, epilogue);
+      } else {
+        status = oneshot_allreduce_kernel<T, Func, AccT, true, MaxRanks>(
+            stream, element_count, send_buffer, recv_buffer, comm, epilogue);
       }
     });
-  } else {
-    LOG(FATAL) << "Reduction size " << reduction_size
-               << " is not supported in AllReduce.";
+    return status;
+  }
+
+  uint64_t generation;
+  TF_ASSIGN_OR_RETURN(
+      std::vector<Participant> participants,
+      begin_collective<Participant>(
+          comm, stream,
+          {stream, send_buffer, recv_buffer, comm->rank, epilogue.addend},
+          &generation));
+  const CommTopology& topology = GetCommTopology(comm, participants);
+  AllReduceAlgorithm algorithm = select_allreduce_algorithm(
+      topology, comm->nranks, element_count * sizeof(T));
+  switch (algorithm) {
+    case AllReduceAlgorithm::kHierarchical:
+      hierarchical_allreduce_dpcpp<T, Func, AccT>(
+          stream, element_count, participants, comm, topology, generation);
+      break;
+    case AllReduceAlgorithm::kRing:
+      ring_allreduce_dpcpp<T, Func, AccT>(stream, element_count, participants,
+                                          comm, generation);
+      break;
+    case AllReduceAlgorithm::kFlat:
+      flat_allreduce_dpcpp<T, Func, AccT>(stream, element_count, participants,
+                                          comm->rank, comm->nranks,
+                                          epilogue.addend_count);
+      break;
   }
+  end_collective(comm, stream, generation);
+
+  // Other ranks still write to the output until the end of the collective, so
+  // the epilogue of the other algorithms is a separate pass after it.
+  if (epilogue.addend != nullptr && algorithm != AllReduceAlgorithm::kFlat) {
+    T* recv = static_cast<T*>(recv_buffer);
+    reduce_dpcpp<T, Func, AccT>(
+        stream, element_count, {recv}, {recv},
+        {{static_cast<const T*>(epilogue.addend)}, epilogue.addend_count, 0});
+  }
+  return absl::OkStatus();
 }
 
 template <typename T>
@@ -250,33 +1202,19 @@ struct AllGatherKernel;
 
 template <typename T>
 void allgather_dpcpp(se::gpu::GpuStreamHandle stream, int tensor_size,
-                     std::vector<Participant>& participants,
+                     std::vector<Participant>& participants, int rank,
                      int reduction_size) {
-  if (reduction_size <= MAX_RANK_SIZE) {
-    const T* in_ptr[MAX_RANK_SIZE];
-    T* out_ptr[MAX_RANK_SIZE];
-
-    for (int i = 0; i < reduction_size; ++i) {
-      in_ptr[i] = static_cast<const T*>(participants[i].send);
-      out_ptr[i] = static_cast<T*>(participants[i].recv);
-    }
-
-    for (int i = 0; i < reduction_size; ++i) {
-      stream->memcpy(out_ptr[0] + tensor_size * i, (const void*)in_ptr[i],
-                     tensor_size * sizeof(T));
-    }
-
-    for (int i = 1; i < reduction_size; ++i) {
-      stream->memcpy(out_ptr[i], (void*)out_ptr[0],
-                     reduction_size * tensor_size * sizeof(T));
-    }
-  } else {
-    LOG(FATAL) << "Reduction size " << reduction_size
-               << " is not supported in AllGather.";
+  // Each rank pushes its slice to the output of all ranks. The slice of an
+  // in-place all-gather already is the slice of the output of this rank, only
+  // the remote slices are copied.
+  for (int i = 0; i < reduction_size; ++i) {
+    T* slice = static_cast<T*>(participants[i].recv) + tensor_size * rank;
+    if (i == rank && slice == participants[rank].send) continue;
+    stream->memcpy(slice, participants[rank].send, tensor_size * sizeof(T));
   }
 }
 
-template <typename T>
+template <typename T, int MaxRanks>
 struct AllToAllKernel;
 
 template <typename T>
@@ -310,19 +1248,23 @@ void alltoall_dpcpp(se::gpu::GpuStreamHandle stream, size_t element_count,
   // Process: send vec -> rev vec
   // P0: (a0, a1) -> (a0, b0)
   // P1: (b0, b1) -> (a1, b1)
-  if (reduction_size <= MAX_RANK_SIZE) {
-    stream->submit([&](sycl::handler& cgh) {
-      T* send[MAX_RANK_SIZE];
-      T* recv[MAX_RANK_SIZE];
-
-      // Each rank sends its send_buffers to all other ranks.
-      for (int i = 0; i < reduction_size; ++i) {
-        send[i] =
-            const_cast<T*>(static_cast<const T*>(participants[rank].send[i]));
-        recv[i] = static_cast<T*>(participants[i].recv[rank]);
-      }
+  dispatch_ranks(reduction_size, [&](auto max_ranks) {
+    constexpr int MaxRanks = decltype(max_ranks)::value;
+    // Each rank sends its send_buffers to all other ranks.
+    std::vector<T*> send_slices;
+    std::vector<T*> recv_slices;
+    for (int i = 0; i < reduction_size; ++i) {
+      send_slices.push_back(
+          const_cast<T*>(static_cast<const T*>(participants[rank].send[i])));
+      recv_slices.push_back(static_cast<T*>(participants[i].recv[rank]));
+    }
+    RankArray<T*, MaxRanks> send =
+        make_rank_array<MaxRanks>(stream, send_slices);
+    RankArray<T*, MaxRanks> recv =
+        make_rank_array<MaxRanks>(stream, recv_slices);
 
-      cgh.parallel_for<AllToAllKernel<T>>(
+    stream->submit([&](sycl::handler& cgh) {
+      cgh.parallel_for<AllToAllKernel<T, MaxRanks>>(
           sycl::nd_range<1>(sycl::range<1>(group_size * num_workgroup),
                             sycl::range<1>(group_size)),
           [=](sycl::nd_item<1> item) {
@@ -378,13 +1320,10 @@ void alltoall_dpcpp(se::gpu::GpuStreamHandle stream, size_t element_count,
             }
           });
     });
-  } else {
-    LOG(FATAL) << "Reduction size " << reduction_size
-               << " is not supported in AllToAll.";
-  }
+  });
 }
 
-template <typename T>
+template <typename T, int MaxRanks>
 struct AllToAllSplitKernel;
 
 template <typename T>
@@ -418,22 +1357,26 @@ void alltoall_split_dpcpp(se::gpu::GpuStreamHandle stream, size_t element_count,
   // Process: send vec -> rev vec
   // P0: ([a0, a1, a2], [a3, a4, a5]) -> ([a0, a1, a2], [b0, b1, b2])
   // P1: ([b0, b1, b2], [b3, b4, b5]) -> ([a3, a4, a5], [b3, b4, b5])
-  if (reduction_size <= MAX_RANK_SIZE) {
-    stream->submit([&](sycl::handler& cgh) {
-      T* send[MAX_RANK_SIZE];
-      T* recv[MAX_RANK_SIZE];
-
-      // Buffer size is always 1 in split AllToAll.
-      // Each rank sends its send_buffers to all other ranks.
-      for (int i = 0; i < reduction_size; ++i) {
-        send[i] =
-            const_cast<T*>(static_cast<const T*>(participants[rank].send[0])) +
-            i * slice_element_count;
-        recv[i] = static_cast<T*>(participants[i].recv[0]) +
-                  rank * slice_element_count;
-      }
+  dispatch_ranks(reduction_size, [&](auto max_ranks) {
+    constexpr int MaxRanks = decltype(max_ranks)::value;
+    // Buffer size is always 1 in split AllToAll.
+    // Each rank sends its send_buffers to all other ranks.
+    std::vector<T*> send_slices;
+    std::vector<T*> recv_slices;
+    for (int i = 0; i < reduction_size; ++i) {
+      send_slices.push_back(
+          const_cast<T*>(static_cast<const T*>(participants[rank].send[0])) +
+          i * slice_element_count);
+      recv_slices.push_back(static_cast<T*>(participants[i].recv[0]) +
+                            rank * slice_element_count);
+    }
+    RankArray<T*, MaxRanks> send =
+        make_rank_array<MaxRanks>(stream, send_slices);
+    RankArray<T*, MaxRanks> recv =
+        make_rank_array<MaxRanks>(stream, recv_slices);
 
-      cgh.parallel_for<AllToAllSplitKernel<T>>(
+    stream->submit([&](sycl::handler& cgh) {
+      cgh.parallel_for<AllToAllSplitKernel<T, MaxRanks>>(
           sycl::nd_range<1>(sycl::range<1>(group_size * num_workgroup),
                             sycl::range<1>(group_size)),
           [=](sycl::nd_item<1> item) {
@@ -489,18 +1432,71 @@ void alltoall_split_dpcpp(se::gpu::GpuStreamHandle stream, size_t element_count,
             }
           });
     });
-  } else {
-    LOG(FATAL) << "Reduction size " << reduction_size
-               << " is not supported in AllToAll.";
-  }
+  });
+}
+
+template <typename T, typename IndexT, int MaxRanks>
+struct RaggedAllToAllKernel;
+
+// Pushes the rows this rank sends to each peer into the output of the peer, in
+// units of T. The offsets and sizes are read from device memory, so the number
+// of rows is unknown when the kernel is submitted: the work-items stride over
+// the rows of all peers and only copy the rows that are sent.
+template <typename T, typename IndexT>
+void ragged_alltoall_dpcpp(se::gpu::GpuStreamHandle stream, size_t input_rows,
+                           size_t row_size, const IndexT* input_offsets,
+                           const IndexT* send_sizes,
+                           const IndexT* output_offsets,
+                           std::vector<AlltoAllParticipant>& participants,
+                           int rank, int reduction_size) {
+  auto device = stream->get_device();
+  int group_size =
+      device.template get_info<sycl::info::device::max_work_group_size>();
+  // A rank sends at most all rows of its input.
+  size_t max_workitem = std::max<size_t>(input_rows * row_size, 1);
+  size_t num_max_concurrent_workitem =
+      stream_executor::gpu::GpuDriver::GetMultiprocessorCount(&device).value() *
+      group_size;
+  size_t num_workitem = std::min(max_workitem, num_max_concurrent_workitem);
+  int num_workgroup = (num_workitem + group_size - 1) / group_size;
+
+  dispatch_ranks(reduction_size, [&](auto max_ranks) {
+    constexpr int MaxRanks = decltype(max_ranks)::value;
+    std::vector<T*> recv_buffers;
+    for (int i = 0; i < reduction_size; ++i) {
+      recv_buffers.push_back(static_cast<T*>(participants[i].recv[0]));
+    }
+    RankArray<T*, MaxRanks> recv =
+        make_rank_array<MaxRanks>(stream, recv_buffers);
+    const T* send = static_cast<const T*>(participants[rank].send[0]);
+
+    stream->submit([&](sycl::handler& cgh) {
+      cgh.parallel_for<RaggedAllToAllKernel<T, IndexT, MaxRanks>>(
+          sycl::nd_range<1>(sycl::range<1>(group_size * num_workgroup),
+                            sycl::range<1>(group_size)),
+          [=](sycl::nd_item<1> item) {
+            const size_t index = item.get_global_linear_id();
+            const size_t stride = item.get_global_range(0);
+            for_each_rank<MaxRanks>(0, reduction_size, [&](int i) {
+              const T* src =
+                  send + static_cast<size_t>(input_offsets[i]) * row_size;
+              T* dst =
+                  recv[i] + static_cast<size_t>(output_offsets[i]) * row_size;
+              const size_t count =
+                  static_cast<size_t>(send_sizes[i]) * row_size;
+              for (size_t n = index; n < count; n += stride) dst[n] = src[n];
+            });
+          });
+    });
+  });
 }
 
-template <typename T, typename Func>
+template <typename T, typename Func, int MaxRanks>
 struct ReduceScatterKernel;
 
 template <typename T, typename Func, typename AccT = T>
 void reducescatter_dpcpp(se::gpu::GpuStreamHandle stream, int tensor_size,
-                         std::vector<Participant>& participants,
+                         std::vector<Participant>& participants, int rank,
                          int reduction_size) {
   auto group_size =
       (*stream)
@@ -509,36 +1505,35 @@ void reducescatter_dpcpp(se::gpu::GpuStreamHandle stream, int tensor_size,
   // tensor_size: output tensor size
   auto num_workgroup = (tensor_size + group_size - 1) / group_size;
 
-  if (reduction_size <= MAX_RANK_SIZE) {
-    stream->submit([&](sycl::handler& cgh) {
-      const T* in[MAX_RANK_SIZE];
-      T* out[MAX_RANK_SIZE];
-
-      for (int i = 0; i < reduction_size; ++i) {
-        in[i] = static_cast<const T*>(participants[i].send);
-        out[i] = static_cast<T*>(participants[i].recv);
-      }
+  dispatch_ranks(reduction_size, [&](auto max_ranks) {
+    constexpr int MaxRanks = decltype(max_ranks)::value;
+    // Each rank reduces its own slice of the inputs of all ranks. The output
+    // of an in-place reduce-scatter is the slice of the input of this rank,
+    // every element is then read by the work-item that writes it.
+    std::vector<const T*> in_slices;
+    for (int i = 0; i < reduction_size; ++i) {
+      in_slices.push_back(static_cast<const T*>(participants[i].send) +
+                          static_cast<size_t>(tensor_size) * rank);
+    }
+    RankArray<const T*, MaxRanks> in =
+        make_rank_array<MaxRanks>(stream, in_slices);
+    T* out = static_cast<T*>(participants[rank].recv);
 
-      cgh.parallel_for<ReduceScatterKernel<T, Func>>(
+    stream->submit([&](sycl::handler& cgh) {
+      cgh.parallel_for<ReduceScatterKernel<T, Func, MaxRanks>>(
           sycl::nd_range<1>(sycl::range<1>(group_size * num_workgroup),
                             sycl::range<1>(group_size)),
           [=](sycl::nd_item<1> item) {
             const int index = item.get_global_linear_id();
             if (index >= tensor_size) return;
-            for (int i = 0; i < reduction_size; ++i) {
-              out[i][index] = T(Func()(AccT(in[0][index + tensor_size * i]),
-                                       AccT(in[1][index + tensor_size * i])));
-              for (int j = 2; j < reduction_size; ++j) {
-                out[i][index] = T(Func()(AccT(out[i][index]),
-                                         AccT(in[j][index + tensor_size * i])));
-              }
-            }
+            AccT result = AccT(in[0][index]);
+            for_each_rank<MaxRanks>(1, reduction_size, [&](int j) {
+              result = Func()(result, AccT(in[j][index]));
+            });
+            out[index] = T(result);
           });
     });
-  } else {
-    LOG(FATAL) << "Reduction size " << reduction_size
-               << " is not supported in ReduceScatter.";
-  }
+  });
 }
 
 template <typename T, int size>
@@ -546,341 +1541,312 @@ struct CollectivePermuteKernel;
 
 template <typename T>
 void permute_dpcpp(se::gpu::GpuStreamHandle stream, int tensor_size,
-                   std::vector<PermuteParticipant>& participants,
+                   std::vector<PermuteParticipant>& participants, int rank,
                    int reduction_size) {
-  if (reduction_size <= MAX_RANK_SIZE) {
-    for (int i = 0; i < reduction_size; ++i)
-      if (participants[i].send_id)
-        stream->memcpy(participants[i].recv,
-                       (const void*)participants[*participants[i].send_id].send,
-                       tensor_size * sizeof(T));
-
-  } else {
-    LOG(FATAL) << "Reduction size " << reduction_size
-               << " is not supported in Permute.";
-  }
+  // Each rank pulls from its source.
+  if (participants[rank].send_id)
+    stream->memcpy(participants[rank].recv,
+                   (const void*)participants[*participants[rank].send_id].send,
+                   tensor_size * sizeof(T));
 }
 
-template <class T>
-void stream_wait_streamlist(se::gpu::GpuStreamHandle stream,
-                            const std::vector<T>& p) {
-  std::vector<sycl::event> event_list;
-  for (int i = 1; i < p.size(); i++) {
-    sycl::event event = SYCLGetEventFromStream(p[i].stream);
-    event_list.push_back(event);
-  }
-  SYCLStreamDependOnEvents(stream, event_list);
-}
-
-template <class T>
-void streamlist_wait_stream(se::gpu::GpuStreamHandle stream,
-                            const std::vector<T>& p) {
-  sycl::event event = SYCLGetEventFromStream(stream);
-
-  const std::vector<sycl::event> event_list{event};
-  for (int i = 1; i < p.size(); i++) {
-    SYCLStreamDependOnEvents(p[i].stream, event_list);
-  }
-}
 }  // namespace
 
-void sycl_allreduce(const void* send_buffer, void* recv_buffer,
-                    size_t element_count, PrimitiveType dtype,
-                    ReductionKind reduction_kind,
-                    se::gpu::GpuStreamHandle gpu_stream, ncclComm_t comm) {
-  gpu_stream
-      ->wait();  // TODO(intel):remove this wait once barrier bug is fixed.
-  std::shared_ptr<Collective<Participant>> collective;
-  {
-    tsl::mutex_lock l(Manager::instance().mu);
-    if (Manager::instance().collectives.find(comm->id) ==
-        Manager::instance().collectives.end()) {
-      collective = std::make_shared<Collective<Participant>>();
-      collective->participants.push_back(
-          {gpu_stream, send_buffer, recv_buffer, comm->rank});
-      collective->begin_events.push_back(SYCLGetEventFromStream(gpu_stream));
-      Manager::instance().collectives[comm->id] = collective;
-    } else {
-      collective = Manager::instance().collectives[comm->id];
-      tsl::mutex_lock lock(collective->mu);
-      collective->participants.push_back(
-          {gpu_stream, send_buffer, recv_buffer, comm->rank});
-      collective->begin_events.push_back(SYCLGetEventFromStream(gpu_stream));
-
-      if (collective->participants.size() == comm->nranks) {
-        Manager::instance().collectives.erase(comm->id);
-        auto& p = collective->participants;
-        std::sort(p.begin(), p.end(),
-                  [](const Participant& a, const Participant& b) -> bool {
-                    return a.rank < b.rank;
-                  });
-        collective->ready_to_launch = true;
-        collective->cv.notify_all();
-      }
-    }
+absl::StatusOr<void*> sycl_register_buffer(ncclComm_t comm,
+                                           const void* buffer) {
+  void* base = nullptr;
+  size_t size = 0;
+  if (SYCLGetPointerAddressRange(buffer, &base, &size) != SYCL_SUCCESS) {
+    return absl::InvalidArgumentError(
+        "Registered buffers must be allocated as collective memory");
   }
-
-  {
-    tsl::mutex_lock lock(collective->mu);
-    if (!collective->ready_to_launch) {
-      collective->cv.wait(lock);
-    }
+  TF_ASSIGN_OR_RETURN(CommState * state, GetSharedCommState(comm));
+  // Ranks of this process share the address space, there is nothing to map.
+  if (state->ipc == nullptr) return base;
+
+  CommState::rank_state& self = state->ranks[comm->rank];
+  if (self.ipc_buffers == nullptr) {
+    sycl::context* context;
+    SYCLGetContext(&context);
+    self.ipc_buffers = std::make_unique<IpcBufferCache>(
+        sycl::get_pointer_device(base, *context));
+  }
+  // Maps the registered buffers of the peers into the cache of this rank,
+  // where the collectives on them find their mappings. There is no stream to
+  // order the release of replaced mappings after, the cache waits for the
+  // device instead.
+  absl::StatusOr<std::vector<void*>> peers =
+      ipc_exchange<void*>(*state, comm->rank, base, /*stream=*/nullptr);
+  if (!peers.ok()) {
+    return absl::Status(
+        peers.status().code(),
+        absl::StrCat("Failed to register a buffer with the ranks of other "
+                     "processes: ",
+                     peers.status().message()));
   }
+  return base;
+}
 
-  auto& p = collective->participants;
-  // TODO(intel):uncomment this barrier once barrier bug is fixed.
-  // SYCLStreamDependOnEvents(gpu_stream, collective->begin_events);
+absl::Status sycl_deregister_buffer(ncclComm_t comm, void* base) {
+  return absl::OkStatus();
+}
 
+absl::Status sycl_allreduce(const void* send_buffer, void* recv_buffer,
+                            size_t element_count, PrimitiveType dtype,
+                            ReductionKind reduction_kind,
+                            se::gpu::GpuStreamHandle gpu_stream,
+                            ncclComm_t comm, const AllReduceEpilogue& epilogue,
+                            AllReduceWireFormat wire_format) {
+  // Small all-reduces are latency bound and keep running one-shot.
+  if (wire_format == AllReduceWireFormat::kBF16 && dtype == F32 &&
+      reduction_kind == ReductionKind::SUM &&
+      element_count * sizeof(float) > OneShotAllReduceMaxBytes()) {
+    return compressed_allreduce_dpcpp<sycl::plus<float>>(
+        gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
+  }
   if (reduction_kind == ReductionKind::SUM) {
     if (dtype == PRED)
-      allreduce_dpcpp<bool, sycl::plus<bool>>(gpu_stream, element_count, p,
-                                              comm->rank, comm->nranks);
+      return allreduce_dpcpp<bool, sycl::plus<bool>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == F32 || dtype == C64)
-      allreduce_dpcpp<float, sycl::plus<float>>(gpu_stream, element_count, p,
-                                                comm->rank, comm->nranks);
+      return allreduce_dpcpp<float, sycl::plus<float>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == F64 || dtype == C128)
-      allreduce_dpcpp<double, sycl::plus<double>>(gpu_stream, element_count, p,
-                                                  comm->rank, comm->nranks);
+      return allreduce_dpcpp<double, sycl::plus<double>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == S32)
-      allreduce_dpcpp<int32_t, sycl::plus<int32_t>>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<int32_t, sycl::plus<int32_t>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == S64)
-      allreduce_dpcpp<int64_t, sycl::plus<int64_t>>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<int64_t, sycl::plus<int64_t>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == U32)
-      allreduce_dpcpp<uint32_t, sycl::plus<uint32_t>>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<uint32_t, sycl::plus<uint32_t>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == U64)
-      allreduce_dpcpp<uint64_t, sycl::plus<uint64_t>>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<uint64_t, sycl::plus<uint64_t>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == BF16)
-      allreduce_dpcpp<bfloat16, sycl::plus<float>, float>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<bfloat16, sycl::plus<float>, float>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else
-      LOG(FATAL) << "PrimitiveType "
-                 << primitive_util::LowercasePrimitiveTypeName(dtype)
-                 << " is not supported in AllReduce.";
+      return absl::UnimplementedError(absl::StrCat(
+          "PrimitiveType ", primitive_util::LowercasePrimitiveTypeName(dtype),
+          " is not supported in AllReduce."));
   } else if (reduction_kind == ReductionKind::PRODUCT) {
     if (dtype == PRED)
-      allreduce_dpcpp<bool, sycl::multiplies<bool>>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<bool, sycl::multiplies<bool>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == F32 || dtype == C64)
-      allreduce_dpcpp<float, sycl::multiplies<float>>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<float, sycl::multiplies<float>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == F64 || dtype == C128)
-      allreduce_dpcpp<double, sycl::multiplies<double>>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<double, sycl::multiplies<double>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == S32)
-      allreduce_dpcpp<int32_t, sycl::multiplies<int32_t>>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<int32_t, sycl::multiplies<int32_t>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == S64)
-      allreduce_dpcpp<int64_t, sycl::multiplies<int64_t>>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<int64_t, sycl::multiplies<int64_t>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == U32)
-      allreduce_dpcpp<uint32_t, sycl::multiplies<uint32_t>>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<uint32_t, sycl::multiplies<uint32_t>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == U64)
-      allreduce_dpcpp<uint64_t, sycl::multiplies<uint64_t>>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<uint64_t, sycl::multiplies<uint64_t>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == BF16)
-      allreduce_dpcpp<bfloat16, sycl::multiplies<float>, float>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<bfloat16, sycl::multiplies<float>, float>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else
-      LOG(FATAL) << "PrimitiveType "
-                 << primitive_util::LowercasePrimitiveTypeName(dtype)
-                 << " is not supported in AllReduce.";
+      return absl::UnimplementedError(absl::StrCat(
+          "PrimitiveType ", primitive_util::LowercasePrimitiveTypeName(dtype),
+          " is not supported in AllReduce."));
   } else if (reduction_kind == ReductionKind::MIN) {
     if (dtype == PRED)
-      allreduce_dpcpp<bool, sycl::minimum<bool>>(gpu_stream, element_count, p,
-                                                 comm->rank, comm->nranks);
+      return allreduce_dpcpp<bool, sycl::minimum<bool>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == F32)
-      allreduce_dpcpp<float, sycl::minimum<float>>(gpu_stream, element_count, p,
-                                                   comm->rank, comm->nranks);
+      return allreduce_dpcpp<float, sycl::minimum<float>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == F64)
-      allreduce_dpcpp<double, sycl::minimum<double>>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<double, sycl::minimum<double>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == S32)
-      allreduce_dpcpp<int32_t, sycl::minimum<int32_t>>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<int32_t, sycl::minimum<int32_t>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == S64)
-      allreduce_dpcpp<int64_t, sycl::minimum<int64_t>>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<int64_t, sycl::minimum<int64_t>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == U32)
-      allreduce_dpcpp<uint32_t, sycl::minimum<uint32_t>>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<uint32_t, sycl::minimum<uint32_t>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == U64)
-      allreduce_dpcpp<uint64_t, sycl::minimum<uint64_t>>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<uint64_t, sycl::minimum<uint64_t>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == BF16)
-      allreduce_dpcpp<bfloat16, sycl::minimum<float>, float>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<bfloat16, sycl::minimum<float>, float>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else
-      LOG(FATAL) << "PrimitiveType "
-                 << primitive_util::LowercasePrimitiveTypeName(dtype)
-                 << " is not supported in AllReduce.";
+      return absl::UnimplementedError(absl::StrCat(
+          "PrimitiveType ", primitive_util::LowercasePrimitiveTypeName(dtype),
+          " is not supported in AllReduce."));
   } else if (reduction_kind == ReductionKind::MAX) {
     if (dtype == PRED)
-      allreduce_dpcpp<bool, sycl::maximum<bool>>(gpu_stream, element_count, p,
-                                                 comm->rank, comm->nranks);
+      return allreduce_dpcpp<bool, sycl::maximum<bool>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == F32)
-      allreduce_dpcpp<float, sycl::maximum<float>>(gpu_stream, element_count, p,
-                                                   comm->rank, comm->nranks);
+      return allreduce_dpcpp<float, sycl::maximum<float>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == F64)
-      allreduce_dpcpp<double, sycl::maximum<double>>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<double, sycl::maximum<double>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == S32)
-      allreduce_dpcpp<int32_t, sycl::maximum<int32_t>>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<int32_t, sycl::maximum<int32_t>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == S64)
-      allreduce_dpcpp<int64_t, sycl::maximum<int64_t>>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<int64_t, sycl::maximum<int64_t>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == U32)
-      allreduce_dpcpp<uint32_t, sycl::maximum<uint32_t>>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<uint32_t, sycl::maximum<uint32_t>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == U64)
-      allreduce_dpcpp<uint64_t, sycl::maximum<uint64_t>>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<uint64_t, sycl::maximum<uint64_t>>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else if (dtype == BF16)
-      allreduce_dpcpp<bfloat16, sycl::maximum<float>, float>(
-          gpu_stream, element_count, p, comm->rank, comm->nranks);
+      return allreduce_dpcpp<bfloat16, sycl::maximum<float>, float>(
+          gpu_stream, element_count, send_buffer, recv_buffer, comm, epilogue);
     else
-      LOG(FATAL) << "PrimitiveType "
-                 << primitive_util::LowercasePrimitiveTypeName(dtype)
-                 << " is not supported in AllReduce.";
+      return absl::UnimplementedError(absl::StrCat(
+          "PrimitiveType ", primitive_util::LowercasePrimitiveTypeName(dtype),
+          " is not supported in AllReduce."));
   } else {
-    LOG(FATAL) << "ReductionKind " << static_cast<int>(reduction_kind)
-               << " is not supported in AllReduce.";
-  }
-
-  gpu_stream
-      ->wait();  // TODO(intel):remove this wait once barrier bug is fixed.
-  {
-    tsl::mutex_lock lock(collective->mu);
-    collective->end_events.push_back(SYCLGetEventFromStream(gpu_stream));
-    if (collective->end_events.size() == comm->nranks) {
-      collective->done = true;
-      collective->cv.notify_all();
-    }
-
-    if (!collective->done) {
-      collective->cv.wait(lock);
-    }
+    return absl::UnimplementedError(absl::StrCat(
+        "ReductionKind ", static_cast<int>(reduction_kind),
+        " is not supported in AllReduce."));
   }
-  // TODO(intel):uncomment this barrier once barrier bug is fixed.
-  // SYCLStreamDependOnEvents(gpu_stream, collective->end_events);
 }
 
-void sycl_allgather(const void* send_buffer, void* recv_buffer,
-                    size_t element_count, PrimitiveType dtype,
-                    se::gpu::GpuStreamHandle gpu_stream, ncclComm_t comm) {
-  std::shared_ptr<Collective<Participant>> collective;
-  bool rank_to_launch_kernel = false;
-  {
-    tsl::mutex_lock l(Manager::instance().mu);
-    if (Manager::instance().collectives.find(comm->id) ==
-        Manager::instance().collectives.end()) {
-      collective = std::make_shared<Collective<Participant>>();
-      collective->participants.push_back(
-          {gpu_stream, send_buffer, recv_buffer, comm->rank});
-      Manager::instance().collectives[comm->id] = collective;
-    } else {
-      collective = Manager::instance().collectives[comm->id];
-      tsl::mutex_lock lock(collective->mu);
-      collective->participants.push_back(
-          {gpu_stream, send_buffer, recv_buffer, comm->rank});
-      if (collective->participants.size() == comm->nranks) {
-        Manager::instance().collectives.erase(comm->id);
-        rank_to_launch_kernel = true;
-      }
-    }
-  }
+absl::Status sycl_allgather(const void* send_buffer, void* recv_buffer,
+                            size_t element_count, PrimitiveType dtype,
+                            se::gpu::GpuStreamHandle gpu_stream,
+                            ncclComm_t comm) {
+  uint64_t generation;
+  TF_ASSIGN_OR_RETURN(
+      std::vector<Participant> p,
+      begin_collective<Participant>(
+          comm, gpu_stream, {gpu_stream, send_buffer, recv_buffer, comm->rank},
+          &generation));
 
-  {
-    tsl::mutex_lock lock(collective->mu);
-    if (!rank_to_launch_kernel) {
-      if (!collective->done) collective->cv.wait(lock);
-    } else {
-      auto p = collective->participants;
-      std::sort(p.begin(), p.end(),
-                [](const Participant& a, const Participant& b) -> bool {
-                  return a.rank < b.rank;
-                });
-
-      se::gpu::GpuStreamHandle stream = p[0].stream;
-      stream_wait_streamlist(stream, p);
-
-      if (dtype == PRED)
-        allgather_dpcpp<bool>(stream, element_count, p, comm->nranks);
-      else if (dtype == F32 || dtype == C64)
-        allgather_dpcpp<float>(stream, element_count, p, comm->nranks);
-      else if (dtype == F64 || dtype == C128)
-        allgather_dpcpp<double>(stream, element_count, p, comm->nranks);
-      else if (dtype == S32)
-        allgather_dpcpp<int32_t>(stream, element_count, p, comm->nranks);
-      else if (dtype == S64)
-        allgather_dpcpp<int64_t>(stream, element_count, p, comm->nranks);
-      else if (dtype == BF16)
-        allgather_dpcpp<bfloat16>(stream, element_count, p, comm->nranks);
-      else if (dtype == U32)
-        allgather_dpcpp<uint32_t>(stream, element_count, p, comm->nranks);
-      else if (dtype == U64)
-        allgather_dpcpp<uint64_t>(stream, element_count, p, comm->nranks);
-      else
-        LOG(FATAL) << "PrimitiveType "
-                   << primitive_util::LowercasePrimitiveTypeName(dtype)
-                   << " is not supported in AllGather.";
-
-      streamlist_wait_stream(stream, p);
-      collective->done = true;
-      collective->cv.notify_all();
-    }
-  }
+  if (dtype == PRED)
+    allgather_dpcpp<bool>(gpu_stream, element_count, p, comm->rank,
+                          comm->nranks);
+  else if (dtype == F32 || dtype == C64)
+    allgather_dpcpp<float>(gpu_stream, element_count, p, comm->rank,
+                           comm->nranks);
+  else if (dtype == F64 || dtype == C128)
+    allgather_dpcpp<double>(gpu_stream, element_count, p, comm->rank,
+                            comm->nranks);
+  else if (dtype == S32)
+    allgather_dpcpp<int32_t>(gpu_stream, element_count, p, comm->rank,
+                             comm->nranks);
+  else if (dtype == S64)
+    allgather_dpcpp<int64_t>(gpu_stream, element_count, p, comm->rank,
+                             comm->nranks);
+  else if (dtype == BF16)
+    allgather_dpcpp<bfloat16>(gpu_stream, element_count, p, comm->rank,
+                              comm->nranks);
+  else if (dtype == U32)
+    allgather_dpcpp<uint32_t>(gpu_stream, element_count, p, comm->rank,
+                              comm->nranks);
+  else if (dtype == U64)
+    allgather_dpcpp<uint64_t>(gpu_stream, element_count, p, comm->rank,
+                              comm->nranks);
+  else
+    return absl::UnimplementedError(absl::StrCat(
+        "PrimitiveType ", primitive_util::LowercasePrimitiveTypeName(dtype),
+        " is not supported in AllGather."));
+
+  end_collective(comm, gpu_stream, generation);
+  return absl::OkStatus();
 }
 
-void sycl_alltoall(std::vector<const void*> send_buffers,
-                   std::vector<void*> recv_buffers, size_t element_count,
-                   PrimitiveType dtype, se::gpu::GpuStreamHandle gpu_stream,
-                   ncclComm_t comm) {
-  gpu_stream
-      ->wait();  // TODO(intel):remove this wait once barrier bug is fixed.
-  std::shared_ptr<Collective<AlltoAllParticipant>> collective;
-  {
-    tsl::mutex_lock l(Manager::instance().mu);
-    if (Manager::instance().alltoall_collectives.find(comm->id) ==
-        Manager::instance().alltoall_collectives.end()) {
-      collective = std::make_shared<Collective<AlltoAllParticipant>>();
-      collective->participants.push_back(
-          {gpu_stream, send_buffers, recv_buffers, comm->rank});
-      collective->begin_events.push_back(SYCLGetEventFromStream(gpu_stream));
-      Manager::instance().alltoall_collectives[comm->id] = collective;
-    } else {
-      collective = Manager::instance().alltoall_collectives[comm->id];
-      tsl::mutex_lock lock(collective->mu);
-      collective->participants.push_back(
-          {gpu_stream, send_buffers, recv_buffers, comm->rank});
-      collective->begin_events.push_back(SYCLGetEventFromStream(gpu_stream));
-      if (collective->participants.size() == comm->nranks) {
-        Manager::instance().alltoall_collectives.erase(comm->id);
-        auto& p = collective->participants;
-        std::sort(p.begin(), p.end(),
-                  [](const AlltoAllParticipant& a, const AlltoAllParticipant& b)
-                      -> bool { return a.rank < b.rank; });
-        collective->ready_to_launch = true;
-        collective->cv.notify_all();
-      }
-    }
+absl::Status sycl_allgather_matmul(const void* shard,
+                                   se::gpu::GpuStreamHandle gpu_stream,
+                                   ncclComm_t comm, AllGatherMatmulStep step) {
+  uint64_t generation;
+  TF_ASSIGN_OR_RETURN(
+      std::vector<Participant> p,
+      begin_collective<Participant>(
+          comm, gpu_stream, {gpu_stream, shard, nullptr, comm->rank},
+          &generation));
+
+  // Rank r starts with its own shard and reads the shard of rank r + t at step
+  // t, so that no two ranks read from the same peer at once.
+  absl::Status status;
+  for (int t = 0; t < comm->nranks && status.ok(); ++t) {
+    int source = (comm->rank + t) % comm->nranks;
+    status = step(source, p[source].send);
   }
+  // The peers must not overwrite their shards before all ranks read them, also
+  // when a step failed.
+  end_collective(comm, gpu_stream, generation);
+  return status;
+}
 
-  {
-    tsl::mutex_lock lock(collective->mu);
-    if (!collective->ready_to_launch) {
-      collective->cv.wait(lock);
+absl::Status sycl_matmul_reduce_scatter(void* output, void* workspace,
+                                        size_t block_bytes,
+                                        se::gpu::GpuStreamHandle gpu_stream,
+                                        ncclComm_t comm,
+                                        MatmulReduceScatterStep step) {
+  TF_ASSIGN_OR_RETURN(CommState * comm_state, GetCommState(comm, gpu_stream));
+  CommState& state = *comm_state;
+  int nranks = comm->nranks;
+  int rank = comm->rank;
+  uint64_t generation = ++state.ranks[rank].generation;
+  TF_ASSIGN_OR_RETURN(
+      std::vector<Participant> p,
+      exchange<Participant>(state, rank, {gpu_stream, nullptr, workspace, rank},
+                            gpu_stream));
+
+  // Ring over the blocks of the output, as the reduce-scatter steps of the
+  // ring all-reduce: at step t, rank r computes block r - t - 1 and adds the
+  // partial result its left neighbor computed for the same block at step t - 1.
+  // The last step computes the block of the rank into its output. Partial
+  // results alternate between the two halves of the workspace, since the right
+  // neighbor reads the one of step t while step t + 1 runs.
+  int left = (rank + nranks - 1) % nranks;
+  int right = (rank + 1) % nranks;
+  char* self = static_cast<char*>(workspace);
+  const char* left_workspace = static_cast<const char*>(p[left].recv);
+  absl::Status status;
+  for (int t = 0; t < nranks && status.ok(); ++t) {
+    if (t > 0) {
+      device_sync(gpu_stream, state, rank, {left, right},
+                  (generation << 32) | t, kRing);
     }
+    int block = ((rank - t - 1) % nranks + nranks) % nranks;
+    const void* partial =
+        t == 0 ? nullptr : left_workspace + ((t - 1) % 2) * block_bytes;
+    void* out = t == nranks - 1 ? output : self + (t % 2) * block_bytes;
+    status = step(block, partial, out);
   }
+  // The left neighbor reads the workspace of this rank until its last step.
+  end_collective(comm, gpu_stream, generation);
+  return status;
+}
 
-  auto& p = collective->participants;
-  // TODO(intel):uncomment this barrier once barrier bug is fixed.
-  // SYCLStreamDependOnEvents(gpu_stream, collective->begin_events);
+absl::Status sycl_alltoall(std::vector<const void*> send_buffers,
+                           std::vector<void*> recv_buffers,
+                           size_t element_count, PrimitiveType dtype,
+                           se::gpu::GpuStreamHandle gpu_stream,
+                           ncclComm_t comm) {
+  uint64_t generation;
+  TF_ASSIGN_OR_RETURN(
+      std::vector<AlltoAllParticipant> p,
+      begin_collective<AlltoAllParticipant>(
+          comm, gpu_stream,
+          {gpu_stream, send_buffers, recv_buffers, comm->rank}, &generation));
 
   if (dtype == PRED)
     alltoall_dpcpp<bool>(gpu_stream, element_count, p, comm->rank,
@@ -922,72 +1888,24 @@ void sycl_alltoall(std::vector<const void*> send_buffers,
     alltoall_dpcpp<uint64_t>(gpu_stream, element_count, p, comm->rank,
                              comm->nranks);
   else
-    LOG(FATAL) << "PrimitiveType "
-               << primitive_util::LowercasePrimitiveTypeName(dtype)
-               << " is not supported in AllToAll.";
-  gpu_stream
-      ->wait();  // TODO(intel):remove this wait once barrier bug is fixed.
-  {
-    tsl::mutex_lock lock(collective->mu);
-    collective->end_events.push_back(SYCLGetEventFromStream(gpu_stream));
-    if (collective->end_events.size() == comm->nranks) {
-      collective->done = true;
-      collective->cv.notify_all();
-    }
-
-    if (!collective->done) {
-      collective->cv.wait(lock);
-    }
-  }
-  // TODO(intel):uncomment this barrier once barrier bug is fixed.
-  // SYCLStreamDependOnEvents(gpu_stream, collective->end_events);
+    return absl::UnimplementedError(absl::StrCat(
+        "PrimitiveType ", primitive_util::LowercasePrimitiveTypeName(dtype),
+        " is not supported in AllToAll."));
+  end_collective(comm, gpu_stream, generation);
+  return absl::OkStatus();
 }
 
-void sycl_alltoall_split(std::vector<const void*> send_buffers,
-                         std::vector<void*> recv_buffers, size_t element_count,
-                         PrimitiveType dtype,
-                         se::gpu::GpuStreamHandle gpu_stream, ncclComm_t comm) {
-  gpu_stream
-      ->wait();  // TODO(intel):remove this wait once barrier bug is fixed.
-  std::shared_ptr<Collective<AlltoAllParticipant>> collective;
-  {
-    tsl::mutex_lock l(Manager::instance().mu);
-    if (Manager::instance().alltoall_collectives.find(comm->id) ==
-        Manager::instance().alltoall_collectives.end()) {
-      collective = std::make_shared<Collective<AlltoAllParticipant>>();
-      collective->participants.push_back(
-          {gpu_stream, send_buffers, recv_buffers, comm->rank});
-      collective->begin_events.push_back(SYCLGetEventFromStream(gpu_stream));
-      Manager::instance().alltoall_collectives[comm->id] = collective;
-    } else {
-      collective = Manager::instance().alltoall_collectives[comm->id];
-      tsl::mutex_lock lock(collective->mu);
-      collective->participants.push_back(
-          {gpu_stream, send_buffers, recv_buffers, comm->rank});
-      collective->begin_events.push_back(SYCLGetEventFromStream(gpu_stream));
-
-      if (collective->participants.size() == comm->nranks) {
-        Manager::instance().alltoall_collectives.erase(comm->id);
-        auto& p = collective->participants;
-        std::sort(p.begin(), p.end(),
-                  [](const AlltoAllParticipant& a, const AlltoAllParticipant& b)
-                      -> bool { return a.rank < b.rank; });
-        collective->ready_to_launch = true;
-        collective->cv.notify_all();
-      }
-    }
-  }
-
-  {
-    tsl::mutex_lock lock(collective->mu);
-    if (!collective->ready_to_launch) {
-      collective->cv.wait(lock);
-    }
-  }
-
-  auto& p = collective->participants;
-  // TODO(intel):uncomment this barrier once barrier bug is fixed.
-  // SYCLStreamDependOnEvents(gpu_stream, collective->begin_events);
+absl::Status sycl_alltoall_split(std::vector<const void*> send_buffers,
+                                 std::vector<void*> recv_buffers,
+                                 size_t element_count, PrimitiveType dtype,
+                                 se::gpu::GpuStreamHandle gpu_stream,
+                                 ncclComm_t comm) {
+  uint64_t generation;
+  TF_ASSIGN_OR_RETURN(
+      std::vector<AlltoAllParticipant> p,
+      begin_collective<AlltoAllParticipant>(
+          comm, gpu_stream,
+          {gpu_stream, send_buffers, recv_buffers, comm->rank}, &generation));
 
   if (dtype == PRED)
     alltoall_split_dpcpp<bool>(gpu_stream, element_count, p, comm->rank,
@@ -1029,265 +1947,267 @@ void sycl_alltoall_split(std::vector<const void*> send_buffers,
     alltoall_split_dpcpp<uint64_t>(gpu_stream, element_count, p, comm->rank,
                                    comm->nranks);
   else
-    LOG(FATAL) << "PrimitiveType "
-               << primitive_util::LowercasePrimitiveTypeName(dtype)
-               << " is not supported in AllToAll.";
-
-  gpu_stream
-      ->wait();  // TODO(intel):remove this wait once barrier bug is fixed.
-  {
-    tsl::mutex_lock lock(collective->mu);
-    collective->end_events.push_back(SYCLGetEventFromStream(gpu_stream));
-    if (collective->end_events.size() == comm->nranks) {
-      collective->done = true;
-      collective->cv.notify_all();
-    }
-
-    if (!collective->done) {
-      collective->cv.wait(lock);
-    }
-  }
-  // TODO(intel):uncomment this barrier once barrier bug is fixed.
-  // SYCLStreamDependOnEvents(gpu_stream, collective->end_events);
+    return absl::UnimplementedError(absl::StrCat(
+        "PrimitiveType ", primitive_util::LowercasePrimitiveTypeName(dtype),
+        " is not supported in AllToAll."));
+  end_collective(comm, gpu_stream, generation);
+  return absl::OkStatus();
 }
 
-void sycl_reduce_scatter(const void* send_buffer, void* recv_buffer,
-                         size_t element_count, PrimitiveType dtype,
-                         ReductionKind reduction_kind,
-                         se::gpu::GpuStreamHandle gpu_stream, ncclComm_t comm) {
-  std::shared_ptr<Collective<Participant>> collective;
-  bool rank_to_launch_kernel = false;
-  {
-    tsl::mutex_lock l(Manager::instance().mu);
-    if (Manager::instance().collectives.find(comm->id) ==
-        Manager::instance().collectives.end()) {
-      collective = std::make_shared<Collective<Participant>>();
-      collective->participants.push_back(
-          {gpu_stream, send_buffer, recv_buffer, comm->rank});
-      Manager::instance().collectives[comm->id] = collective;
-    } else {
-      collective = Manager::instance().collectives[comm->id];
-      tsl::mutex_lock lock(collective->mu);
-      collective->participants.push_back(
-          {gpu_stream, send_buffer, recv_buffer, comm->rank});
-      if (collective->participants.size() == comm->nranks) {
-        Manager::instance().collectives.erase(comm->id);
-        rank_to_launch_kernel = true;
-      }
-    }
+absl::Status sycl_ragged_alltoall(const void* input, void* output,
+                                  size_t input_rows, size_t row_bytes,
+                                  PrimitiveType index_type,
+                                  const void* input_offsets,
+                                  const void* send_sizes,
+                                  const void* output_offsets,
+                                  se::gpu::GpuStreamHandle gpu_stream,
+                                  ncclComm_t comm) {
+  if (index_type != S32 && index_type != S64) {
+    return absl::UnimplementedError(
+        absl::StrCat("PrimitiveType ",
+                     primitive_util::LowercasePrimitiveTypeName(index_type),
+                     " is not supported as offsets of RaggedAllToAll."));
   }
+  uint64_t generation;
+  TF_ASSIGN_OR_RETURN(
+      std::vector<AlltoAllParticipant> p,
+      begin_collective<AlltoAllParticipant>(
+          comm, gpu_stream, {gpu_stream, {input}, {output}, comm->rank},
+          &generation));
+
+  // Rows are copied in the widest unit that divides them, the elements
+  // themselves are never interpreted.
+  auto run = [&](auto unit, auto index) {
+    using T = decltype(unit);
+    using IndexT = decltype(index);
+    ragged_alltoall_dpcpp<T, IndexT>(
+        gpu_stream, input_rows, row_bytes / sizeof(T),
+        static_cast<const IndexT*>(input_offsets),
+        static_cast<const IndexT*>(send_sizes),
+        static_cast<const IndexT*>(output_offsets), p, comm->rank,
+        comm->nranks);
+  };
+  auto run_with_index = [&](auto unit) {
+    if (index_type == S32)
+      run(unit, int32_t());
+    else
+      run(unit, int64_t());
+  };
+  if (row_bytes % sizeof(uint64_t) == 0)
+    run_with_index(uint64_t());
+  else if (row_bytes % sizeof(uint32_t) == 0)
+    run_with_index(uint32_t());
+  else if (row_bytes % sizeof(uint16_t) == 0)
+    run_with_index(uint16_t());
+  else
+    run_with_index(uint8_t());
+  end_collective(comm, gpu_stream, generation);
+  return absl::OkStatus();
+}
 
-  {
-    tsl::mutex_lock lock(collective->mu);
-    if (!rank_to_launch_kernel) {
-      if (!collective->done) collective->cv.wait(lock);
-    } else {
-      auto p = collective->participants;
-      std::sort(p.begin(), p.end(),
-                [](const Participant& a, const Participant& b) -> bool {
-                  return a.rank < b.rank;
-                });
-
-      se::gpu::GpuStreamHandle stream = p[0].stream;
-      stream_wait_streamlist(stream, p);
-
-      if (reduction_kind == ReductionKind::SUM) {
-        if (dtype == PRED)
-          reducescatter_dpcpp<bool, sycl::plus<bool>>(stream, element_count, p,
-                                                      comm->nranks);
-        else if (dtype == F32 || dtype == C64)
-          reducescatter_dpcpp<float, sycl::plus<float>>(stream, element_count,
-                                                        p, comm->nranks);
-        else if (dtype == F64 || dtype == C128)
-          reducescatter_dpcpp<double, sycl::plus<double>>(stream, element_count,
-                                                          p, comm->nranks);
-        else if (dtype == S32)
-          reducescatter_dpcpp<int32_t, sycl::plus<int32_t>>(
-              stream, element_count, p, comm->nranks);
-        else if (dtype == S64)
-          reducescatter_dpcpp<int64_t, sycl::plus<int64_t>>(
-              stream, element_count, p, comm->nranks);
-        else if (dtype == U32)
-          reducescatter_dpcpp<uint32_t, sycl::plus<uint32_t>>(
-              stream, element_count, p, comm->nranks);
-        else if (dtype == U64)
-          reducescatter_dpcpp<uint64_t, sycl::plus<uint64_t>>(
-              stream, element_count, p, comm->nranks);
-        else if (dtype == BF16)
-          reducescatter_dpcpp<bfloat16, sycl::plus<float>, float>(
-              stream, element_count, p, comm->nranks);
-        else
-          LOG(FATAL) << "PrimitiveType "
-                     << primitive_util::LowercasePrimitiveTypeName(dtype)
-                     << " is not supported in ReduceScatter.";
-      } else if (reduction_kind == ReductionKind::PRODUCT) {
-        if (dtype == PRED)
-          reducescatter_dpcpp<bool, sycl::multiplies<bool>>(
-              stream, element_count, p, comm->nranks);
-        else if (dtype == F32 || dtype == C64)
-          reducescatter_dpcpp<float, sycl::multiplies<float>>(
-              stream, element_count, p, comm->nranks);
-        else if (dtype == F64 || dtype == C128)
-          reducescatter_dpcpp<double, sycl::multiplies<double>>(
-              stream, element_count, p, comm->nranks);
-        else if (dtype == S32)
-          reducescatter_dpcpp<int32_t, sycl::multiplies<int32_t>>(
-              stream, element_count, p, comm->nranks);
-        else if (dtype == S64)
-          reducescatter_dpcpp<int64_t, sycl::multiplies<int64_t>>(
-              stream, element_count, p, comm->nranks);
-        else if (dtype == U32)
-          reducescatter_dpcpp<uint32_t, sycl::multiplies<uint32_t>>(
-              stream, element_count, p, comm->nranks);
-        else if (dtype == U64)
-          reducescatter_dpcpp<uint64_t, sycl::multiplies<uint64_t>>(
-              stream, element_count, p, comm->nranks);
-        else if (dtype == BF16)
-          reducescatter_dpcpp<bfloat16, sycl::multiplies<float>, float>(
-              stream, element_count, p, comm->nranks);
-        else
-          LOG(FATAL) << "PrimitiveType "
-                     << primitive_util::LowercasePrimitiveTypeName(dtype)
-                     << " is not supported in ReduceScatter.";
-      } else if (reduction_kind == ReductionKind::MIN) {
-        if (dtype == PRED)
-          reducescatter_dpcpp<bool, sycl::minimum<bool>>(stream, element_count,
-                                                         p, comm->nranks);
-        else if (dtype == F32 || dtype == C64)
-          reducescatter_dpcpp<float, sycl::minimum<float>>(
-              stream, element_count, p, comm->nranks);
-        else if (dtype == F64 || dtype == C128)
-          reducescatter_dpcpp<double, sycl::minimum<double>>(
-              stream, element_count, p, comm->nranks);
-        else if (dtype == S32)
-          reducescatter_dpcpp<int32_t, sycl::minimum<int32_t>>(
-              stream, element_count, p, comm->nranks);
-        else if (dtype == S64)
-          reducescatter_dpcpp<int64_t, sycl::minimum<int64_t>>(
-              stream, element_count, p, comm->nranks);
-        else if (dtype == BF16)
-          reducescatter_dpcpp<bfloat16, sycl::minimum<float>, float>(
-              stream, element_count, p, comm->nranks);
-        else if (dtype == U32)
-          reducescatter_dpcpp<uint32_t, sycl::minimum<uint32_t>>(
-              stream, element_count, p, comm->nranks);
-        else if (dtype == U64)
-          reducescatter_dpcpp<uint64_t, sycl::minimum<uint64_t>>(
-              stream, element_count, p, comm->nranks);
-        else
-          LOG(FATAL) << "PrimitiveType "
-                     << primitive_util::LowercasePrimitiveTypeName(dtype)
-                     << " is not supported in ReduceScatter.";
-      } else if (reduction_kind == ReductionKind::MAX) {
-        if (dtype == PRED)
-          reducescatter_dpcpp<bool, sycl::maximum<bool>>(stream, element_count,
-                                                         p, comm->nranks);
-        else if (dtype == F32 || dtype == C64)
-          reducescatter_dpcpp<float, sycl::maximum<float>>(
-              stream, element_count, p, comm->nranks);
-        else if (dtype == F64 || dtype == C128)
-          reducescatter_dpcpp<double, sycl::maximum<double>>(
-              stream, element_count, p, comm->nranks);
-        else if (dtype == S32)
-          reducescatter_dpcpp<int32_t, sycl::maximum<int32_t>>(
-              stream, element_count, p, comm->nranks);
-        else if (dtype == S64)
-          reducescatter_dpcpp<int64_t, sycl::maximum<int64_t>>(
-              stream, element_count, p, comm->nranks);
-        else if (dtype == BF16)
-          reducescatter_dpcpp<bfloat16, sycl::maximum<float>, float>(
-              stream, element_count, p, comm->nranks);
-        else if (dtype == U32)
-          reducescatter_dpcpp<uint32_t, sycl::maximum<uint32_t>>(
-              stream, element_count, p, comm->nranks);
-        else if (dtype == U64)
-          reducescatter_dpcpp<uint64_t, sycl::maximum<uint64_t>>(
-              stream, element_count, p, comm->nranks);
-        else
-          LOG(FATAL) << "PrimitiveType "
-                     << primitive_util::LowercasePrimitiveTypeName(dtype)
-                     << " is not supported in ReduceScatter.";
-      } else {
-        LOG(FATAL) << "ReductionKind " << static_cast<int>(reduction_kind)
-                   << " is not supported in ReduceScatter.";
-      }
+absl::Status sycl_reduce_scatter(const void* send_buffer, void* recv_buffer,
+                                 size_t element_count, PrimitiveType dtype,
+                                 ReductionKind reduction_kind,
+                                 se::gpu::GpuStreamHandle gpu_stream,
+                                 ncclComm_t comm) {
+  uint64_t generation;
+  TF_ASSIGN_OR_RETURN(
+      std::vector<Participant> p,
+      begin_collective<Participant>(
+          comm, gpu_stream, {gpu_stream, send_buffer, recv_buffer, comm->rank},
+          &generation));
 
-      streamlist_wait_stream(stream, p);
-      collective->done = true;
-      collective->cv.notify_all();
-    }
+  if (reduction_kind == ReductionKind::SUM) {
+    if (dtype == PRED)
+      reducescatter_dpcpp<bool, sycl::plus<bool>>(gpu_stream, element_count, p,
+                                                  comm->rank, comm->nranks);
+    else if (dtype == F32 || dtype == C64)
+      reducescatter_dpcpp<float, sycl::plus<float>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == F64 || dtype == C128)
+      reducescatter_dpcpp<double, sycl::plus<double>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == S32)
+      reducescatter_dpcpp<int32_t, sycl::plus<int32_t>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == S64)
+      reducescatter_dpcpp<int64_t, sycl::plus<int64_t>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == U32)
+      reducescatter_dpcpp<uint32_t, sycl::plus<uint32_t>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == U64)
+      reducescatter_dpcpp<uint64_t, sycl::plus<uint64_t>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == BF16)
+      reducescatter_dpcpp<bfloat16, sycl::plus<float>, float>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else
+      return absl::UnimplementedError(absl::StrCat(
+          "PrimitiveType ", primitive_util::LowercasePrimitiveTypeName(dtype),
+          " is not supported in ReduceScatter."));
+  } else if (reduction_kind == ReductionKind::PRODUCT) {
+    if (dtype == PRED)
+      reducescatter_dpcpp<bool, sycl::multiplies<bool>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == F32 || dtype == C64)
+      reducescatter_dpcpp<float, sycl::multiplies<float>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == F64 || dtype == C128)
+      reducescatter_dpcpp<double, sycl::multiplies<double>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == S32)
+      reducescatter_dpcpp<int32_t, sycl::multiplies<int32_t>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == S64)
+      reducescatter_dpcpp<int64_t, sycl::multiplies<int64_t>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == U32)
+      reducescatter_dpcpp<uint32_t, sycl::multiplies<uint32_t>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == U64)
+      reducescatter_dpcpp<uint64_t, sycl::multiplies<uint64_t>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == BF16)
+      reducescatter_dpcpp<bfloat16, sycl::multiplies<float>, float>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else
+      return absl::UnimplementedError(absl::StrCat(
+          "PrimitiveType ", primitive_util::LowercasePrimitiveTypeName(dtype),
+          " is not supported in ReduceScatter."));
+  } else if (reduction_kind == ReductionKind::MIN) {
+    if (dtype == PRED)
+      reducescatter_dpcpp<bool, sycl::minimum<bool>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == F32 || dtype == C64)
+      reducescatter_dpcpp<float, sycl::minimum<float>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == F64 || dtype == C128)
+      reducescatter_dpcpp<double, sycl::minimum<double>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == S32)
+      reducescatter_dpcpp<int32_t, sycl::minimum<int32_t>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == S64)
+      reducescatter_dpcpp<int64_t, sycl::minimum<int64_t>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == BF16)
+      reducescatter_dpcpp<bfloat16, sycl::minimum<float>, float>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == U32)
+      reducescatter_dpcpp<uint32_t, sycl::minimum<uint32_t>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == U64)
+      reducescatter_dpcpp<uint64_t, sycl::minimum<uint64_t>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else
+      return absl::UnimplementedError(absl::StrCat(
+          "PrimitiveType ", primitive_util::LowercasePrimitiveTypeName(dtype),
+          " is not supported in ReduceScatter."));
+  } else if (reduction_kind == ReductionKind::MAX) {
+    if (dtype == PRED)
+      reducescatter_dpcpp<bool, sycl::maximum<bool>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == F32 || dtype == C64)
+      reducescatter_dpcpp<float, sycl::maximum<float>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == F64 || dtype == C128)
+      reducescatter_dpcpp<double, sycl::maximum<double>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == S32)
+      reducescatter_dpcpp<int32_t, sycl::maximum<int32_t>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == S64)
+      reducescatter_dpcpp<int64_t, sycl::maximum<int64_t>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == BF16)
+      reducescatter_dpcpp<bfloat16, sycl::maximum<float>, float>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == U32)
+      reducescatter_dpcpp<uint32_t, sycl::maximum<uint32_t>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else if (dtype == U64)
+      reducescatter_dpcpp<uint64_t, sycl::maximum<uint64_t>>(
+          gpu_stream, element_count, p, comm->rank, comm->nranks);
+    else
+      return absl::UnimplementedError(absl::StrCat(
+          "PrimitiveType ", primitive_util::LowercasePrimitiveTypeName(dtype),
+          " is not supported in ReduceScatter."));
+  } else {
+    return absl::UnimplementedError(absl::StrCat(
+        "ReductionKind ", static_cast<int>(reduction_kind),
+        " is not supported in ReduceScatter."));
   }
+
+  end_collective(comm, gpu_stream, generation);
+  return absl::OkStatus();
 }
 
-void sycl_collective_permute(const void* send_buffer, void* recv_buffer,
-                             size_t element_count, PrimitiveType dtype,
-                             const std::optional<int64_t>& source_id,
-                             const std::optional<int64_t>& target_id,
-                             se::gpu::GpuStreamHandle gpu_stream,
-                             ncclComm_t comm) {
-  std::shared_ptr<Collective<PermuteParticipant>> collective;
-  bool rank_to_launch_kernel = false;
-  {
-    tsl::mutex_lock l(Manager::instance().mu);
-    if (Manager::instance().permute_collectives.find(comm->id) ==
-        Manager::instance().permute_collectives.end()) {
-      collective = std::make_shared<Collective<PermuteParticipant>>();
-      collective->participants.push_back({gpu_stream, send_buffer, recv_buffer,
-                                          source_id, target_id, comm->rank});
-      Manager::instance().permute_collectives[comm->id] = collective;
-    } else {
-      collective = Manager::instance().permute_collectives[comm->id];
-      tsl::mutex_lock lock(collective->mu);
-      collective->participants.push_back({gpu_stream, send_buffer, recv_buffer,
-                                          source_id, target_id, comm->rank});
-      if (collective->participants.size() == comm->nranks) {
-        Manager::instance().permute_collectives.erase(comm->id);
-        rank_to_launch_kernel = true;
-      }
-    }
+absl::Status sycl_collective_permute(const void* send_buffer,
+                                     void* recv_buffer, size_t element_count,
+                                     PrimitiveType dtype,
+                                     const std::optional<int64_t>& source_id,
+                                     const std::optional<int64_t>& target_id,
+                                     se::gpu::GpuStreamHandle gpu_stream,
+                                     ncclComm_t comm) {
+  // Only the source and the target of this rank access its buffers, so the
+  // streams of the ranks are synchronized pairwise instead of with a barrier
+  // of all ranks, which lets the stages of a pipeline run ahead of the stages
+  // they do not exchange with.
+  TF_ASSIGN_OR_RETURN(CommState * comm_state, GetCommState(comm, gpu_stream));
+  CommState& state = *comm_state;
+  uint64_t generation = ++state.ranks[comm->rank].permutes;
+  TF_ASSIGN_OR_RETURN(std::vector<PermuteParticipant> p,
+                      exchange<PermuteParticipant>(
+                          state, comm->rank,
+                          {gpu_stream, send_buffer, recv_buffer, source_id,
+                           target_id, comm->rank},
+                          gpu_stream));
+  std::vector<int> peers;
+  if (source_id) peers.push_back(static_cast<int>(*source_id));
+  if (target_id && target_id != source_id) {
+    peers.push_back(static_cast<int>(*target_id));
+  }
+  // The send buffer of the source is ready once the source signaled.
+  if (!peers.empty()) {
+    device_sync(gpu_stream, state, comm->rank, peers, generation,
+                kPermuteBegin);
   }
 
-  {
-    tsl::mutex_lock lock(collective->mu);
-    if (!rank_to_launch_kernel) {
-      if (!collective->done) collective->cv.wait(lock);
-    } else {
-      auto p = collective->participants;
-      std::sort(
-          p.begin(), p.end(),
-          [](const PermuteParticipant& a, const PermuteParticipant& b) -> bool {
-            return a.rank < b.rank;
-          });
-
-      se::gpu::GpuStreamHandle stream = p[0].stream;
-      stream_wait_streamlist(stream, p);
-
-      if (dtype == PRED)
-        permute_dpcpp<bool>(stream, element_count, p, comm->nranks);
-      else if (dtype == F32)
-        permute_dpcpp<float>(stream, element_count, p, comm->nranks);
-      else if (dtype == F64)
-        permute_dpcpp<double>(stream, element_count, p, comm->nranks);
-      else if (dtype == S32)
-        permute_dpcpp<int32_t>(stream, element_count, p, comm->nranks);
-      else if (dtype == S64)
-        permute_dpcpp<int64_t>(stream, element_count, p, comm->nranks);
-      else if (dtype == BF16)
-        permute_dpcpp<bfloat16>(stream, element_count, p, comm->nranks);
-      else if (dtype == U32)
-        permute_dpcpp<uint32_t>(stream, element_count, p, comm->nranks);
-      else if (dtype == U64)
-        permute_dpcpp<uint64_t>(stream, element_count, p, comm->nranks);
-      else
-        LOG(FATAL) << "PrimitiveType "
-                   << primitive_util::LowercasePrimitiveTypeName(dtype)
-                   << " is not supported in Permute.";
-
-      streamlist_wait_stream(stream, p);
-      collective->done = true;
-      collective->cv.notify_all();
-    }
+  if (dtype == PRED)
+    permute_dpcpp<bool>(gpu_stream, element_count, p, comm->rank, comm->nranks);
+  else if (dtype == F32)
+    permute_dpcpp<float>(gpu_stream, element_count, p, comm->rank,
+                         comm->nranks);
+  else if (dtype == F64)
+    permute_dpcpp<double>(gpu_stream, element_count, p, comm->rank,
+                          comm->nranks);
+  else if (dtype == S32)
+    permute_dpcpp<int32_t>(gpu_stream, element_count, p, comm->rank,
+                           comm->nranks);
+  else if (dtype == S64)
+    permute_dpcpp<int64_t>(gpu_stream, element_count, p, comm->rank,
+                           comm->nranks);
+  else if (dtype == BF16)
+    permute_dpcpp<bfloat16>(gpu_stream, element_count, p, comm->rank,
+                            comm->nranks);
+  else if (dtype == U32)
+    permute_dpcpp<uint32_t>(gpu_stream, element_count, p, comm->rank,
+                            comm->nranks);
+  else if (dtype == U64)
+    permute_dpcpp<uint64_t>(gpu_stream, element_count, p, comm->rank,
+                            comm->nranks);
+  else
+    return absl::UnimplementedError(absl::StrCat(
+        "PrimitiveType ", primitive_util::LowercasePrimitiveTypeName(dtype),
+        " is not supported in Permute."));
+
+  // The send buffer can be overwritten once the target read it.
+  if (!peers.empty()) {
+    device_sync(gpu_stream, state, comm->rank, peers, generation,
+                kPermuteEnd);
   }
+  return absl::OkStatus();
 }
 
 }  // namespace gpu
@@ -14,59 +14,155 @@ limitations under the License.
 ==============================================================================*/
 #ifndef XLA_SERVICE_GPU_CCL_OPS_H_
 #define XLA_SERVICE_GPU_CCL_OPS_H_
+#include <memory>
+#include <string>
 #include <vector>
 
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
 #include "xla/service/collective_ops_utils.h"
 #include "xla/stream_executor/gpu/gpu_types.h"
 
 namespace ccl {
+// Prefix of the ids of cliques whose ranks all run on the same host. Only
+// those can span processes, whose ranks exchange buffers through IPC handles.
+inline constexpr char kHostLocalCliqueIdPrefix[] = "host:";
+
+// State shared by all ranks of a communicator, defined by the backend.
+struct comm_state;
+
 struct communicator {
   communicator(int nranks, int rank, const std::string id)
       : nranks(nranks), rank(rank), id(id) {}
   int nranks;
   int rank;
   const std::string id;
+  // Whether ranks of the communicator live in other processes, which then
+  // exchange their buffers through IPC handles.
+  bool multi_process = false;
+  // Created at the first collective of the communicator.
+  std::shared_ptr<comm_state> state;
 };
 }  // namespace ccl
 
 using ncclComm_t = ccl::communicator*;
-#define MAX_RANK_SIZE 16
 
 #if !ITEX_USE_CCL
 
 namespace xla {
 namespace gpu {
 
-void sycl_allreduce(const void* send_buffer, void* recv_buffer,
-                    size_t element_count, PrimitiveType dtype,
-                    ReductionKind reduction_kind,
-                    se::gpu::GpuStreamHandle gpu_stream, ncclComm_t comm);
-
-void sycl_allgather(const void* send_buffer, void* recv_buffer,
-                    size_t element_count, PrimitiveType dtype,
-                    se::gpu::GpuStreamHandle gpu_stream, ncclComm_t comm);
-
-void sycl_alltoall(std::vector<const void*> send_buffer,
-                   std::vector<void*> recv_buffer, size_t element_count,
-                   PrimitiveType dtype, se::gpu::GpuStreamHandle gpu_stream,
-                   ncclComm_t comm);
-
-void sycl_alltoall_split(std::vector<const void*> send_buffer,
-                         std::vector<void*> recv_buffer, size_t element_count,
-                         PrimitiveType dtype,
-                         se::gpu::GpuStreamHandle gpu_stream, ncclComm_t comm);
-
-void sycl_reduce_scatter(const void* send_buffer, void* recv_buffer,
-                         size_t element_count, PrimitiveType dtype,
-                         ReductionKind reduction_kind,
-                         se::gpu::GpuStreamHandle gpu_stream, ncclComm_t comm);
-
-void sycl_collective_permute(const void* send_buffer, void* recv_buffer,
-                             size_t element_count, PrimitiveType dtype,
-                             const std::optional<int64_t>& source_id,
-                             const std::optional<int64_t>& target_id,
-                             se::gpu::GpuStreamHandle gpu_stream,
-                             ncclComm_t comm);
+// Elementwise epilogue fused into an all-reduce: `addend` is added to the
+// reduced elements before they are stored, so the output is written once. The
+// addend has the element type of the all-reduce and repeats every
+// `addend_count` elements, e.g. a residual of the same size as the output, or
+// a bias broadcast along the minor dimension.
+struct AllReduceEpilogue {
+  const void* addend = nullptr;
+  size_t addend_count = 0;
+};
+
+// Format of the partial results all-reduces exchange between ranks. kBF16
+// sends F32 sum all-reduces as BF16 and accumulates in F32, and is ignored by
+// other all-reduces.
+enum class AllReduceWireFormat { kNative, kBF16 };
+
+// Registers the allocation containing `buffer`, which must be collective
+// memory, with the clique of `comm`. Returns the base address of the
+// allocation, which identifies the registration. If ranks of the clique live
+// in other processes, registration is collective: all ranks register their
+// buffers in the same order, and each rank maps the buffers of its peers into
+// its IPC buffer cache. Collectives on registered buffers then find their
+// mappings there and don't map them again. Ranks of one process share the
+// address space and map nothing.
+absl::StatusOr<void*> sycl_register_buffer(ncclComm_t comm,
+                                           const void* buffer);
+
+absl::Status sycl_deregister_buffer(ncclComm_t comm, void* base);
+
+absl::Status sycl_allreduce(
+    const void* send_buffer, void* recv_buffer, size_t element_count,
+    PrimitiveType dtype, ReductionKind reduction_kind,
+    se::gpu::GpuStreamHandle gpu_stream, ncclComm_t comm,
+    const AllReduceEpilogue& epilogue = {},
+    AllReduceWireFormat wire_format = AllReduceWireFormat::kNative);
+
+absl::Status sycl_allgather(const void* send_buffer, void* recv_buffer,
+                            size_t element_count, PrimitiveType dtype,
+                            se::gpu::GpuStreamHandle gpu_stream,
+                            ncclComm_t comm);
+
+// Steps of collective matmuls. An all-gather matmul step computes the rows of
+// the output of the shard of the left operand of rank `source`, which it reads
+// from the memory of that rank. A matmul reduce-scatter step computes block
+// `block` of the rows of the output into `output`, adding `partial` if it is
+// not null.
+using AllGatherMatmulStep =
+    absl::FunctionRef<absl::Status(int source, const void* shard)>;
+using MatmulReduceScatterStep = absl::FunctionRef<absl::Status(
+    int block, const void* partial, void* output)>;
+
+// GEMM of a left operand gathered along its rows from the `shard` of each
+// rank. Instead of gathering the operand first, `step` runs once per rank on
+// the shard in the memory of that rank, so the GEMM loads the shards of the
+// peers over the links while it computes.
+absl::Status sycl_allgather_matmul(const void* shard,
+                                   se::gpu::GpuStreamHandle gpu_stream,
+                                   ncclComm_t comm, AllGatherMatmulStep step);
+
+// GEMM whose result is reduce-scattered along its rows into `output`, with
+// one block of rows per rank. The ranks run `step` on each block in a ring and
+// each step adds the partial result of the left neighbor, read from its
+// `workspace`, which holds two blocks of `block_bytes`. The partial results
+// are thus reduced as they are computed.
+absl::Status sycl_matmul_reduce_scatter(void* output, void* workspace,
+                                        size_t block_bytes,
+                                        se::gpu::GpuStreamHandle gpu_stream,
+                                        ncclComm_t comm,
+                                        MatmulReduceScatterStep step);
+
+absl::Status sycl_alltoall(std::vector<const void*> send_buffer,
+                           std::vector<void*> recv_buffer,
+                           size_t element_count, PrimitiveType dtype,
+                           se::gpu::GpuStreamHandle gpu_stream,
+                           ncclComm_t comm);
+
+absl::Status sycl_alltoall_split(std::vector<const void*> send_buffer,
+                                 std::vector<void*> recv_buffer,
+                                 size_t element_count, PrimitiveType dtype,
+                                 se::gpu::GpuStreamHandle gpu_stream,
+                                 ncclComm_t comm);
+
+// All-to-all of a variable number of rows of `row_bytes` per rank, e.g. the
+// tokens a MoE layer dispatches to the experts of each rank. `input_offsets`,
+// `send_sizes` and `output_offsets` are device arrays of `index_type` with an
+// entry per rank, in rows: send_sizes[i] rows at input_offsets[i] of `input`
+// are copied to output_offsets[i] of the output of rank i. They are only read
+// by the device, so they can be computed on the stream without a host sync.
+// Rows of `output` no peer sends to are left unchanged.
+absl::Status sycl_ragged_alltoall(const void* input, void* output,
+                                  size_t input_rows, size_t row_bytes,
+                                  PrimitiveType index_type,
+                                  const void* input_offsets,
+                                  const void* send_sizes,
+                                  const void* output_offsets,
+                                  se::gpu::GpuStreamHandle gpu_stream,
+                                  ncclComm_t comm);
+
+absl::Status sycl_reduce_scatter(const void* send_buffer, void* recv_buffer,
+                                 size_t element_count, PrimitiveType dtype,
+                                 ReductionKind reduction_kind,
+                                 se::gpu::GpuStreamHandle gpu_stream,
+                                 ncclComm_t comm);
+
+absl::Status sycl_collective_permute(const void* send_buffer,
+                                     void* recv_buffer, size_t element_count,
+                                     PrimitiveType dtype,
+                                     const std::optional<int64_t>& source_id,
+                                     const std::optional<int64_t>& target_id,
+                                     se::gpu::GpuStreamHandle gpu_stream,
+                                     ncclComm_t comm);
 }  // namespace gpu
 }  // namespace xla
 
@@ -0,0 +1,139 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Bus bandwidth of the SYCL collectives. Every benchmark thread is a rank
+// driving its own device, as the ranks of a single-process clique do.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+#include "tsl/platform/status.h"
+#include "xla/service/collective_ops_utils.h"
+#include "xla/service/gpu/ccl_ops.h"
+#include "xla/stream_executor/sycl/sycl_benchmark_util.h"
+#include "xla/stream_executor/sycl/sycl_gpu_runtime.h"
+
+namespace xla {
+namespace gpu {
+namespace {
+
+enum class Collective { kAllReduce, kAllGather, kAllToAll };
+
+const char* CollectiveName(Collective collective) {
+  switch (collective) {
+    case Collective::kAllReduce:
+      return "allreduce";
+    case Collective::kAllGather:
+      return "allgather";
+    case Collective::kAllToAll:
+      return "alltoall";
+  }
+  return "";
+}
+
+// Ratio of the bytes crossing the links of a rank to the size of the
+// collective, as defined by nccl-tests.
+double BusBandwidthFactor(Collective collective, int nranks) {
+  double factor = static_cast<double>(nranks - 1) / nranks;
+  return collective == Collective::kAllReduce ? 2 * factor : factor;
+}
+
+// range(0) is the size of the output of a rank in bytes.
+void BM_Collective(benchmark::State& state, Collective collective) {
+  const int nranks = state.threads();
+  const int rank = state.thread_index();
+  const size_t bytes = state.range(0);
+
+  int device_count = 0;
+  if (SYCLGetDeviceCount(&device_count) != SYCL_SUCCESS ||
+      device_count < nranks) {
+    state.SkipWithError("Not enough devices for the ranks");
+    return;
+  }
+  sycl::device* device = nullptr;
+  sycl::queue* stream = nullptr;
+  if (SYCLGetDevice(&device, rank) != SYCL_SUCCESS ||
+      SYCLCreateStream(device, &stream) != SYCL_SUCCESS) {
+    state.SkipWithError("Failed to create the stream of the rank");
+    return;
+  }
+
+  const size_t count = bytes / sizeof(float);
+  const size_t send_count =
+      collective == Collective::kAllGather ? count / nranks : count;
+  void* send = sycl::malloc_device(send_count * sizeof(float), *stream);
+  void* recv = sycl::malloc_device(count * sizeof(float), *stream);
+  stream->memset(send, 0, send_count * sizeof(float));
+  stream->memset(recv, 0, count * sizeof(float)).wait();
+
+  // Communicators with the same id share their state, every run gets its own.
+  ccl::communicator comm(nranks, rank,
+                         absl::StrCat("ccl_ops_benchmark/",
+                                      CollectiveName(collective), "/", nranks,
+                                      "/", bytes));
+  auto run = [&] {
+    switch (collective) {
+      case Collective::kAllReduce:
+        TF_CHECK_OK(sycl_allreduce(send, recv, count, F32, ReductionKind::SUM,
+                                   stream, &comm));
+        break;
+      case Collective::kAllGather:
+        TF_CHECK_OK(sycl_allgather(send, recv, send_count, F32, stream, &comm));
+        break;
+      case Collective::kAllToAll:
+        TF_CHECK_OK(
+            sycl_alltoall_split({send}, {recv}, count, F32, stream, &comm));
+        break;
+    }
+  };
+
+  // The first collective of a communicator sets up its shared state.
+  run();
+  stream->wait();
+  for (auto _ : state) {
+    state.SetIterationTime(stream_executor::gpu::TimeOnStream(stream, run));
+  }
+
+  state.counters["busbw"] = benchmark::Counter(
+      bytes * BusBandwidthFactor(collective, nranks),
+      benchmark::Counter::kIsIterationInvariantRate |
+          benchmark::Counter::kAvgThreads);
+
+  stream->wait();
+  sycl::free(send, *stream);
+  sycl::free(recv, *stream);
+  SYCLDestroyStream(device, stream);
+}
+
+void CollectiveArgs(benchmark::internal::Benchmark* b) {
+  for (int64_t bytes = 8 << 10; bytes <= int64_t{256} << 20; bytes *= 8) {
+    b->Arg(bytes);
+  }
+  b->ThreadRange(2, 8)->UseManualTime();
+}
+
+BENCHMARK_CAPTURE(BM_Collective, allreduce, Collective::kAllReduce)
+    ->Apply(CollectiveArgs);
+BENCHMARK_CAPTURE(BM_Collective, allgather, Collective::kAllGather)
+    ->Apply(CollectiveArgs);
+BENCHMARK_CAPTURE(BM_Collective, alltoall, Collective::kAllToAll)
+    ->Apply(CollectiveArgs);
+
+}  // namespace
+}  // namespace gpu
+}  // namespace xla
@@ -0,0 +1,218 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/gpu/collective_matmul_rewriter.h"
+
+#include <cstdint>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "xla/hlo/ir/hlo_casting_utils.h"
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instructions.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/layout_util.h"
+#include "xla/service/collective_ops_utils.h"
+#include "xla/service/gpu/backend_configs.pb.h"
+#include "xla/service/gpu/ir_emission_utils.h"
+#include "xla/shape_util.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/statusor.h"
+
+namespace xla {
+namespace gpu {
+
+namespace {
+
+bool IsRowMajorMatrix(const Shape& shape) {
+  return shape.IsArray() && shape.rank() == 2 && shape.has_layout() &&
+         LayoutUtil::IsMonotonicWithDim0Major(shape.layout());
+}
+
+// Returns the GEMM computing `value` if the XeTLA kernels of collective
+// matmuls can run it, `value` is the GEMM or the result element of a GEMM
+// returning a workspace.
+HloInstruction* GetGemm(HloInstruction* value) {
+  HloInstruction* gemm = value;
+  if (value->opcode() == HloOpcode::kGetTupleElement) {
+    gemm = value->mutable_operand(0);
+    if (value->tuple_index() != 0 || gemm->user_count() != 1) return nullptr;
+  } else if (value->shape().IsTuple()) {
+    return nullptr;
+  }
+  if (!IsLegacyCublasMatmul(*gemm) || gemm->HasControlDependencies() ||
+      gemm->operand_count() != 2) {
+    return nullptr;
+  }
+  auto gpu_config = gemm->backend_config<GpuBackendConfig>();
+  if (!gpu_config.ok()) return nullptr;
+  const GemmBackendConfig& config = gpu_config->gemm_backend_config();
+  const DotDimensionNumbers& dnums = config.dot_dimension_numbers();
+  if (config.epilogue() != GemmBackendConfig::DEFAULT ||
+      config.alpha_real() != 1.0 || config.alpha_imag() != 0.0 ||
+      config.beta() != 0.0 || dnums.lhs_batch_dimensions_size() != 0 ||
+      dnums.rhs_batch_dimensions_size() != 0 ||
+      dnums.lhs_contracting_dimensions_size() != 1 ||
+      dnums.lhs_contracting_dimensions(0) != 1 ||
+      dnums.rhs_contracting_dimensions_size() != 1 ||
+      dnums.rhs_contracting_dimensions(0) != 0) {
+    return nullptr;
+  }
+  const Shape& lhs = gemm->operand(0)->shape();
+  const Shape& rhs = gemm->operand(1)->shape();
+  if (!IsRowMajorMatrix(lhs) || !IsRowMajorMatrix(rhs) ||
+      !IsRowMajorMatrix(value->shape())) {
+    return nullptr;
+  }
+  PrimitiveType type = value->shape().element_type();
+  if ((type != F16 && type != BF16) || lhs.element_type() != type ||
+      rhs.element_type() != type) {
+    return nullptr;
+  }
+  // The kernels load rows with 8 byte aligned block loads, which also keeps
+  // the blocks of rows of the steps aligned.
+  if (rhs.dimensions(0) % 4 != 0 || rhs.dimensions(1) % 4 != 0) {
+    return nullptr;
+  }
+  return gemm;
+}
+
+bool IsFusibleCollective(const HloInstruction* instr) {
+  return instr->operand_count() == 1 && !instr->HasControlDependencies() &&
+         IsRowMajorMatrix(instr->shape()) &&
+         IsRowMajorMatrix(instr->operand(0)->shape());
+}
+
+// Moves the parameters of `collective` to the frontend attributes of `fused`.
+void SetCollectiveAttributes(const HloCollectiveInstruction* collective,
+                             bool use_global_device_ids,
+                             HloInstruction* fused) {
+  FrontendAttributes attributes = collective->frontend_attributes();
+  auto& map = *attributes.mutable_map();
+  map[std::string(kCollectiveMatmulReplicaGroupsAttr)] =
+      ReplicaGroupsToString(collective->replica_groups());
+  if (collective->channel_id().has_value()) {
+    map[std::string(kCollectiveMatmulChannelIdAttr)] =
+        absl::StrCat(*collective->channel_id());
+  }
+  map[std::string(kCollectiveMatmulUseGlobalDeviceIdsAttr)] =
+      use_global_device_ids ? "true" : "false";
+  fused->set_frontend_attributes(attributes);
+  fused->set_custom_call_has_side_effect(collective->HasSideEffect());
+  fused->set_metadata(collective->metadata());
+}
+
+// Removes `value` and the GEMM computing it, which have no users left.
+absl::Status RemoveGemm(HloComputation* computation, HloInstruction* value,
+                        HloInstruction* gemm) {
+  TF_RETURN_IF_ERROR(computation->RemoveInstruction(value));
+  if (gemm == value) return absl::OkStatus();
+  return computation->RemoveInstruction(gemm);
+}
+
+// Rewrites `value` if it is a GEMM of an all-gathered left matrix.
+StatusOr<bool> TryFuseAllGather(HloComputation* computation,
+                                HloInstruction* value) {
+  HloInstruction* gemm = GetGemm(value);
+  if (gemm == nullptr) return false;
+  auto* all_gather =
+      DynCast<HloAllGatherInstruction>(gemm->mutable_operand(0));
+  if (all_gather == nullptr || all_gather->user_count() != 1 ||
+      all_gather->all_gather_dimension() != 0 ||
+      !IsFusibleCollective(all_gather)) {
+    return false;
+  }
+
+  HloInstruction* fused =
+      computation->AddInstruction(HloInstruction::CreateCustomCall(
+          value->shape(),
+          {all_gather->mutable_operand(0), gemm->mutable_operand(1)},
+          kAllGatherMatmulCallTarget));
+  SetCollectiveAttributes(all_gather, all_gather->use_global_device_ids(),
+                          fused);
+  computation->parent()->SetAndUniquifyInstrName(fused, "all_gather_matmul");
+  // A side effecting all-gather isn't removed with its last user.
+  TF_RETURN_IF_ERROR(value->ReplaceAllUsesWith(fused));
+  TF_RETURN_IF_ERROR(RemoveGemm(computation, value, gemm));
+  TF_RETURN_IF_ERROR(computation->RemoveInstruction(all_gather));
+  return true;
+}
+
+// Rewrites `instr` if it is a sum reduce-scatter of the rows of a GEMM.
+StatusOr<bool> TryFuseReduceScatter(HloComputation* computation,
+                                    HloInstruction* instr) {
+  auto* reduce_scatter = DynCast<HloReduceScatterInstruction>(instr);
+  if (reduce_scatter == nullptr || reduce_scatter->scatter_dimension() != 0 ||
+      !IsFusibleCollective(reduce_scatter) ||
+      MatchReductionComputation(reduce_scatter->to_apply()) !=
+          ReductionKind::SUM) {
+    return false;
+  }
+  HloInstruction* value = reduce_scatter->mutable_operand(0);
+  if (value->user_count() != 1) return false;
+  HloInstruction* gemm = GetGemm(value);
+  if (gemm == nullptr) return false;
+
+  const Shape& shape = reduce_scatter->shape();
+  Shape workspace = ShapeUtil::MakeShapeWithDescendingLayout(
+      shape.element_type(), {2, shape.dimensions(0), shape.dimensions(1)});
+  HloInstruction* fused =
+      computation->AddInstruction(HloInstruction::CreateCustomCall(
+          ShapeUtil::MakeTupleShape({shape, workspace}),
+          {gemm->mutable_operand(0), gemm->mutable_operand(1)},
+          kMatmulReduceScatterCallTarget));
+  SetCollectiveAttributes(reduce_scatter,
+                          reduce_scatter->use_global_device_ids(), fused);
+  computation->parent()->SetAndUniquifyInstrName(fused,
+                                                 "matmul_reduce_scatter");
+  HloInstruction* result = computation->AddInstruction(
+      HloInstruction::CreateGetTupleElement(shape, fused, 0));
+  TF_RETURN_IF_ERROR(reduce_scatter->ReplaceAllUsesWith(result));
+  TF_RETURN_IF_ERROR(computation->RemoveInstruction(reduce_scatter));
+  TF_RETURN_IF_ERROR(RemoveGemm(computation, value, gemm));
+  return true;
+}
+
+}  // namespace
+
+bool IsCustomCallToCollectiveMatmul(const HloInstruction& hlo) {
+  return hlo.opcode() == HloOpcode::kCustomCall &&
+         (hlo.custom_call_target() == kAllGatherMatmulCallTarget ||
+          hlo.custom_call_target() == kMatmulReduceScatterCallTarget);
+}
+
+StatusOr<bool> CollectiveMatmulRewriter::Run(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  bool any_changed = false;
+  for (HloComputation* computation :
+       module->MakeNonfusionComputations(execution_threads)) {
+    // The instructions removed by a rewrite precede the visited one in post
+    // order, so they were visited already.
+    for (HloInstruction* instr : computation->MakeInstructionPostOrder()) {
+      bool changed = false;
+      TF_ASSIGN_OR_RETURN(changed, TryFuseReduceScatter(computation, instr));
+      if (!changed) {
+        TF_ASSIGN_OR_RETURN(changed, TryFuseAllGather(computation, instr));
+      }
+      any_changed |= changed;
+    }
+  }
+  return any_changed;
+}
+
+}  // namespace gpu
+}  // namespace xla
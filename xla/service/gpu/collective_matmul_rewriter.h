@@ -0,0 +1,74 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_GPU_COLLECTIVE_MATMUL_REWRITER_H_
+#define XLA_SERVICE_GPU_COLLECTIVE_MATMUL_REWRITER_H_
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/string_view.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/hlo_pass_interface.h"
+
+namespace xla {
+namespace gpu {
+
+// Custom calls of GEMMs fused with the collective of an operand or of the
+// result. Operand 0 is the left and operand 1 the right matrix, both row
+// major. The parameters of the collective are kept in frontend attributes.
+//
+// An all-gather matmul multiplies the rows of the left matrix gathered from
+// all ranks, its operand 0 is the shard of this rank. A matmul reduce-scatter
+// returns the block of the rows of the reduced result of this rank and a
+// workspace of two blocks.
+inline constexpr absl::string_view kAllGatherMatmulCallTarget =
+    "__xpu$AllGatherMatmul";
+inline constexpr absl::string_view kMatmulReduceScatterCallTarget =
+    "__xpu$MatmulReduceScatter";
+inline constexpr absl::string_view kCollectiveMatmulReplicaGroupsAttr =
+    "collective_matmul_replica_groups";
+inline constexpr absl::string_view kCollectiveMatmulChannelIdAttr =
+    "collective_matmul_channel_id";
+inline constexpr absl::string_view kCollectiveMatmulUseGlobalDeviceIdsAttr =
+    "collective_matmul_use_global_device_ids";
+
+bool IsCustomCallToCollectiveMatmul(const HloInstruction& hlo);
+
+// Fuses the collectives of tensor parallel layers with their GEMMs:
+//
+//   gemm(all-gather(x), w) -> custom-call(x, w)
+//   reduce-scatter(gemm(x, w)) -> get-tuple-element(custom-call(x, w), 0)
+//
+// The GEMM is split along the rows, and each part reads its rows from the
+// peer holding them, or adds the partial result of a peer, while it computes,
+// which hides the collective behind the GEMM. Only F16 and BF16 GEMMs of row
+// major matrices without batch dimensions or epilogues, gathered and scattered
+// along the rows of the left matrix, are fused.
+class CollectiveMatmulRewriter : public HloModulePass {
+ public:
+  CollectiveMatmulRewriter() = default;
+
+  absl::string_view name() const override {
+    return "collective-matmul-rewriter";
+  }
+  StatusOr<bool> Run(
+      HloModule* module,
+      const absl::flat_hash_set<absl::string_view>& execution_threads) override;
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_GPU_COLLECTIVE_MATMUL_REWRITER_H_
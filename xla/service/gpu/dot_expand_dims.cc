@@ -21,6 +21,8 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/algorithm/container.h"
+#include "absl/types/span.h"
 #include "tsl/platform/logging.h"
 #include "tsl/platform/status.h"
 #include "xla/hlo/ir/dfs_hlo_visitor_with_default.h"
@@ -28,6 +30,7 @@ limitations under the License.
 #include "xla/hlo/ir/hlo_instruction.h"
 #include "xla/hlo/ir/hlo_opcode.h"
 #include "xla/service/gpu/ir_emission_utils.h"
+#include "xla/shape_util.h"
 #include "xla/util.h"
 #include "xla/xla_data.pb.h"
 
@@ -36,142 +39,112 @@ namespace gpu {
 
 namespace {
 
+// A dot operand with its batch and contracting dimensions.
+struct DotOperand {
+  HloInstruction* instr;
+  std::vector<int64_t> batch_dims;
+  std::vector<int64_t> contracting_dims;
+};
+
+// Gives `operand` exactly one non-contracting dimension if all of its
+// non-contracting dimensions are degenerate, e.g. for matrix-vector products.
+// Only dimensions of size 1 are added or removed, so the reshape is a bitcast.
+// The new dimension goes before the first contracting dimension of the lhs
+// and after the last contracting dimension of the rhs:
+//
+//   lhs: (b1, b2, c) -> (b1, b2, n, c)    (c, b1, b2) -> (n, c, b1, b2)
+//   rhs: (b1, b2, c) -> (b1, b2, c, n)    (c, b1, b2) -> (c, n, b1, b2)
+DotOperand ExpandOperand(HloInstruction* operand,
+                         absl::Span<const int64_t> batch_dims,
+                         absl::Span<const int64_t> contracting_dims,
+                         bool is_lhs) {
+  DotOperand result{operand,
+                    std::vector<int64_t>(batch_dims.begin(), batch_dims.end()),
+                    std::vector<int64_t>(contracting_dims.begin(),
+                                         contracting_dims.end())};
+  const Shape& shape = operand->shape();
+  const int64_t rank = shape.rank();
+  std::vector<int64_t> non_contracting_dims;
+  int64_t non_contracting_size = 1;
+  for (int64_t i = 0; i < rank; ++i) {
+    if (!absl::c_linear_search(batch_dims, i) &&
+        !absl::c_linear_search(contracting_dims, i)) {
+      non_contracting_dims.push_back(i);
+      non_contracting_size *= shape.dimensions(i);
+    }
+  }
+  if (non_contracting_size != 1 || non_contracting_dims.size() == 1) {
+    return result;
+  }
+
+  int64_t position = rank;
+  if (!contracting_dims.empty()) {
+    position = is_lhs ? *absl::c_min_element(contracting_dims)
+                      : *absl::c_max_element(contracting_dims) + 1;
+  }
+  std::vector<int64_t> new_dims;
+  std::vector<int64_t> new_index(rank, -1);
+  for (int64_t i = 0; i <= rank; ++i) {
+    if (i == position) new_dims.push_back(1);
+    if (i == rank || absl::c_linear_search(non_contracting_dims, i)) continue;
+    new_index[i] = new_dims.size();
+    new_dims.push_back(shape.dimensions(i));
+  }
+  for (int64_t& dim : result.batch_dims) dim = new_index[dim];
+  for (int64_t& dim : result.contracting_dims) dim = new_index[dim];
+  result.instr = operand->parent()->AddInstruction(
+      HloInstruction::CreateReshape(
+          ShapeUtil::MakeShape(shape.element_type(), new_dims), operand),
+      &operand->metadata());
+  return result;
+}
+
 StatusOr<bool> ExpandDotDims(HloInstruction* original_dot) {
   if (original_dot->opcode() != HloOpcode::kDot) {
     return false;
   }
   auto computation = original_dot->parent();
   const auto& original_dnums = original_dot->dot_dimension_numbers();
-  const int64_t num_batch_dims = original_dnums.lhs_batch_dimensions_size();
-  const int64_t num_contracting_dims =
-      original_dnums.lhs_contracting_dimensions_size();
-
-  const auto& lhs_shape = original_dot->operand(0)->shape();
-  const int64_t lhs_rank = lhs_shape.rank();
-  const int64_t num_lhs_non_contracting_dims =
-      lhs_rank - num_batch_dims - num_contracting_dims;
-
-  std::vector<int64_t> lhs_non_contracting_dims;
-  lhs_non_contracting_dims.reserve(num_lhs_non_contracting_dims);
-  int64_t lhs_contracting_size = 1;
-  int64_t lhs_non_contracting_size = 1;
-  std::vector<int64_t> batch_dim_sizes;
-  batch_dim_sizes.reserve(num_batch_dims);
-  for (int64_t i = 0; i < lhs_rank; ++i) {
-    if (absl::c_linear_search(original_dnums.lhs_contracting_dimensions(), i)) {
-      lhs_contracting_size *= lhs_shape.dimensions(i);
-    } else if (absl::c_linear_search(original_dnums.lhs_batch_dimensions(),
-                                     i)) {
-      batch_dim_sizes.push_back(lhs_shape.dimensions(i));
-    } else {
-      lhs_non_contracting_dims.push_back(i);
-      lhs_non_contracting_size *= lhs_shape.dimensions(i);
-    }
+  DotOperand lhs = ExpandOperand(original_dot->mutable_operand(0),
+                                 original_dnums.lhs_batch_dimensions(),
+                                 original_dnums.lhs_contracting_dimensions(),
+                                 /*is_lhs=*/true);
+  DotOperand rhs = ExpandOperand(original_dot->mutable_operand(1),
+                                 original_dnums.rhs_batch_dimensions(),
+                                 original_dnums.rhs_contracting_dimensions(),
+                                 /*is_lhs=*/false);
+  if (lhs.instr == original_dot->operand(0) &&
+      rhs.instr == original_dot->operand(1)) {
+    return false;
   }
 
   DotDimensionNumbers dot_dnums;
-  HloInstruction* lhs_operand = original_dot->mutable_operand(0);
-  HloInstruction* reshaped_lhs = lhs_operand;
-  if (lhs_non_contracting_size == 1) {
-    CHECK_EQ(original_dnums.lhs_contracting_dimensions().size(), 1);
-    auto batch_dimensions = original_dnums.lhs_batch_dimensions();
-    int c_dim = original_dnums.lhs_contracting_dimensions()[0];
-    std::vector<int64_t> lhs_reshape_dims = batch_dim_sizes;
-    if (c_dim == batch_dimensions.size()) {
-      // (b1, b2, c) -> (b1, b2, n, c)
-      lhs_reshape_dims.push_back(lhs_non_contracting_size);
-      lhs_reshape_dims.push_back(lhs_contracting_size);
-      *dot_dnums.mutable_lhs_batch_dimensions() =
-          original_dnums.lhs_batch_dimensions();
-      dot_dnums.add_lhs_contracting_dimensions(c_dim + 1);
-    } else if (c_dim == 0) {
-      // (c, b1, b2) -> (n, c, b1, b2)
-      lhs_reshape_dims.insert(lhs_reshape_dims.begin(),
-                              lhs_non_contracting_size);
-      lhs_reshape_dims.insert(lhs_reshape_dims.begin() + 1,
-                              lhs_contracting_size);
-      *dot_dnums.mutable_lhs_batch_dimensions() =
-          original_dnums.lhs_batch_dimensions();
-      for (int64_t i = 0; i < num_batch_dims; ++i)
-        dot_dnums.mutable_lhs_batch_dimensions()->at(i)++;
-      dot_dnums.add_lhs_contracting_dimensions(1);
-    } else
-      return Internal("Unsupported Dot dims in DotExpandDims");
-    reshaped_lhs = computation->AddInstruction(
-        HloInstruction::CreateReshape(
-            ShapeUtil::MakeShape(lhs_shape.element_type(), lhs_reshape_dims),
-            lhs_operand),
-        &lhs_operand->metadata());
-  } else {
-    *dot_dnums.mutable_lhs_batch_dimensions() =
-        original_dnums.lhs_batch_dimensions();
-    *dot_dnums.mutable_lhs_contracting_dimensions() =
-        original_dnums.lhs_contracting_dimensions();
+  for (int64_t dim : lhs.batch_dims) dot_dnums.add_lhs_batch_dimensions(dim);
+  for (int64_t dim : lhs.contracting_dims) {
+    dot_dnums.add_lhs_contracting_dimensions(dim);
   }
-
-  const auto& rhs_shape = original_dot->operand(1)->shape();
-  const int64_t rhs_rank = rhs_shape.rank();
-  const int64_t num_rhs_non_contracting_dims =
-      rhs_rank - num_batch_dims - num_contracting_dims;
-  std::vector<int64_t> rhs_non_contracting_dims;
-  rhs_non_contracting_dims.reserve(num_rhs_non_contracting_dims);
-  int64_t rhs_non_contracting_size = 1;
-  int64_t rhs_contracting_size = 1;
-  for (int64_t i = 0; i < rhs_rank; ++i) {
-    if (absl::c_linear_search(original_dnums.rhs_contracting_dimensions(), i)) {
-      rhs_contracting_size *= rhs_shape.dimensions(i);
-    } else if (!absl::c_linear_search(original_dnums.rhs_batch_dimensions(),
-                                      i)) {
-      rhs_non_contracting_dims.push_back(i);
-      rhs_non_contracting_size *= rhs_shape.dimensions(i);
-    }
+  for (int64_t dim : rhs.batch_dims) dot_dnums.add_rhs_batch_dimensions(dim);
+  for (int64_t dim : rhs.contracting_dims) {
+    dot_dnums.add_rhs_contracting_dimensions(dim);
   }
 
-  HloInstruction* rhs_operand = original_dot->mutable_operand(1);
-  HloInstruction* reshaped_rhs = rhs_operand;
-  if (rhs_non_contracting_size == 1) {
-    CHECK_EQ(original_dnums.rhs_contracting_dimensions().size(), 1);
-    auto batch_dimensions = original_dnums.rhs_batch_dimensions();
-    int c_dim = original_dnums.rhs_contracting_dimensions()[0];
-    std::vector<int64_t> rhs_reshape_dims = batch_dim_sizes;
-    if (c_dim == batch_dimensions.size()) {
-      // (b1, b2, c) -> (b1, b2, c, n)
-      rhs_reshape_dims.push_back(rhs_contracting_size);
-      rhs_reshape_dims.push_back(rhs_non_contracting_size);
-      *dot_dnums.mutable_rhs_batch_dimensions() =
-          original_dnums.rhs_batch_dimensions();
-      dot_dnums.add_rhs_contracting_dimensions(c_dim);
-    } else if (c_dim == 0) {
-      // (c, b1, b2) -> (c, n, b1, b2)
-      rhs_reshape_dims.insert(rhs_reshape_dims.begin(), rhs_contracting_size);
-      rhs_reshape_dims.insert(rhs_reshape_dims.begin() + 1,
-                              rhs_non_contracting_size);
-      *dot_dnums.mutable_rhs_batch_dimensions() =
-          original_dnums.rhs_batch_dimensions();
-      for (int64_t i = 0; i < num_batch_dims; ++i)
-        dot_dnums.mutable_rhs_batch_dimensions()->at(i)++;
-      dot_dnums.add_rhs_contracting_dimensions(0);
-    } else
-      return Internal("Unsupported Dot dims in DotExpandDims");
-    reshaped_rhs = computation->AddInstruction(
-        HloInstruction::CreateReshape(
-            ShapeUtil::MakeShape(rhs_shape.element_type(), rhs_reshape_dims),
-            rhs_operand),
-        &rhs_operand->metadata());
-  } else {
-    *dot_dnums.mutable_rhs_batch_dimensions() =
-        original_dnums.rhs_batch_dimensions();
-    *dot_dnums.mutable_rhs_contracting_dimensions() =
-        original_dnums.rhs_contracting_dimensions();
+  // Batch dimensions, then the lhs and the rhs non-contracting dimensions.
+  std::vector<int64_t> dot_dims;
+  for (int64_t dim : lhs.batch_dims) {
+    dot_dims.push_back(lhs.instr->shape().dimensions(dim));
+  }
+  for (const DotOperand* operand : {&lhs, &rhs}) {
+    for (int64_t i = 0; i < operand->instr->shape().rank(); ++i) {
+      if (!absl::c_linear_search(operand->batch_dims, i) &&
+          !absl::c_linear_search(operand->contracting_dims, i)) {
+        dot_dims.push_back(operand->instr->shape().dimensions(i));
+      }
+    }
   }
-
-  std::vector<int64_t> dot_dims = batch_dim_sizes;
-  dot_dims.push_back(lhs_non_contracting_size);
-  dot_dims.push_back(rhs_non_contracting_size);
 
   HloInstruction* dot = computation->AddInstruction(HloInstruction::CreateDot(
       ShapeUtil::MakeShape(original_dot->shape().element_type(), dot_dims),
-      reshaped_lhs, reshaped_rhs, dot_dnums, original_dot->precision_config()));
+      lhs.instr, rhs.instr, dot_dnums, original_dot->precision_config()));
   original_dot->SetupDerivedInstruction(dot);
 
   std::unique_ptr<HloInstruction> replacement =
@@ -23,7 +23,9 @@ limitations under the License.
 namespace xla {
 namespace gpu {
 
-// Expand dot dims for dimension 1 so that it can call onednn.
+// Expand dot dims for dimension 1 so that it can call onednn: an operand whose
+// non-contracting dimensions are all degenerate, or missing as in
+// matrix-vector products, gets exactly one non-contracting dimension of size 1.
 class DotExpandDims : public HloModulePass {
  public:
   explicit DotExpandDims();
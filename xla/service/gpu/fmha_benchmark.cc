@@ -0,0 +1,137 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// BF16 XeTLA flash attention, forward and backward, over sequence lengths
+// and head sizes. Self-attention with as many keys as queries.
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "benchmark/benchmark.h"
+#include "xla/service/gpu/xetla/sdp/sdp.h"
+#include "xla/stream_executor/sycl/sycl_benchmark_util.h"
+#include "xla/stream_executor/sycl/sycl_gpu_runtime.h"
+
+namespace xla {
+namespace gpu {
+namespace {
+
+constexpr uint32_t kNumBatches = 1;
+constexpr uint32_t kNumHeads = 16;
+
+struct Buffers {
+  Buffers(sycl::queue* stream, size_t size, size_t rows)
+      : stream(stream) {
+    for (void*& buffer : bf16) {
+      buffer = sycl::malloc_device(size * sizeof(uint16_t), *stream);
+      stream->memset(buffer, 0, size * sizeof(uint16_t));
+    }
+    grad_query_accum = sycl::malloc_device(size * sizeof(float), *stream);
+    activation = sycl::malloc_device(rows * sizeof(float), *stream);
+    dp_sum = sycl::malloc_device(rows * sizeof(float), *stream);
+    stream->memset(activation, 0, rows * sizeof(float)).wait();
+  }
+  ~Buffers() {
+    stream->wait();
+    for (void* buffer : bf16) sycl::free(buffer, *stream);
+    sycl::free(grad_query_accum, *stream);
+    sycl::free(activation, *stream);
+    sycl::free(dp_sum, *stream);
+  }
+
+  sycl::queue* stream;
+  // query, key, value, out, grad_out, grad_query, grad_key, grad_value.
+  void* bf16[8];
+  void* grad_query_accum;
+  void* activation;
+  void* dp_sum;
+};
+
+// Returns the stream of device 0 all benchmarks run on, or null.
+sycl::queue* GetStream() {
+  static sycl::queue* stream = [] {
+    sycl::device* device = nullptr;
+    sycl::queue* stream = nullptr;
+    if (SYCLGetDevice(&device, 0) != SYCL_SUCCESS ||
+        SYCLCreateStream(device, &stream) != SYCL_SUCCESS) {
+      return static_cast<sycl::queue*>(nullptr);
+    }
+    return stream;
+  }();
+  return stream;
+}
+
+// range(0) is the sequence length, range(1) the head size.
+void BM_Fmha(benchmark::State& state, bool backward) {
+  const uint32_t seq_len = state.range(0);
+  const uint32_t head_size = state.range(1);
+
+  sycl::queue* stream = GetStream();
+  if (stream == nullptr) {
+    state.SkipWithError("Failed to create a stream");
+    return;
+  }
+  const size_t rows = size_t{kNumBatches} * kNumHeads * seq_len;
+  Buffers buffers(stream, rows * head_size, rows);
+  auto [query, key, value, out, grad_out, grad_query, grad_key, grad_value] =
+      buffers.bf16;
+  const float head_scale = 1.f / std::sqrt(static_cast<float>(head_size));
+
+  auto forward = [&] {
+    ::gpu::xetla::fmha_forward_kernel_bf16(
+        *stream, query, key, value, /*bias=*/nullptr, /*seed=*/0,
+        /*dropout_prob=*/0.f, out, buffers.activation, kNumBatches, kNumHeads,
+        kNumHeads, head_size, seq_len, seq_len, head_scale,
+        /*is_training=*/backward);
+  };
+  auto run = [&] {
+    if (!backward) return forward();
+    ::gpu::xetla::fmha_backward_kernel_bf16(
+        *stream, query, key, value, out, /*bias=*/nullptr, grad_out,
+        buffers.dp_sum, buffers.activation, grad_query,
+        buffers.grad_query_accum, grad_key, grad_value, /*seed=*/0,
+        /*dropout_prob=*/0.f, kNumBatches, kNumHeads, kNumHeads, head_size,
+        seq_len, seq_len, head_scale);
+  };
+
+  // The backward reads the logsumexp the training forward writes.
+  forward();
+  run();
+  stream->wait();
+  for (auto _ : state) {
+    state.SetIterationTime(stream_executor::gpu::TimeOnStream(stream, run));
+  }
+
+  // The forward computes Q*K and P*V, the backward two and a half times the
+  // matmuls of the forward.
+  double flops = 4.0 * rows * seq_len * head_size;
+  if (backward) flops *= 2.5;
+  state.counters["FLOPS"] =
+      benchmark::Counter(flops, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void FmhaArgs(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"seq_len", "head_size"});
+  b->ArgsProduct({{512, 1024, 2048, 4096, 8192}, {64, 128, 256}});
+  b->UseManualTime();
+}
+
+BENCHMARK_CAPTURE(BM_Fmha, forward, false)->Apply(FmhaArgs);
+BENCHMARK_CAPTURE(BM_Fmha, backward, true)->Apply(FmhaArgs);
+
+}  // namespace
+}  // namespace gpu
+}  // namespace xla
@@ -0,0 +1,153 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/gpu/fp8_gemm_rewriter.h"
+
+#include <cstdint>
+#include <optional>
+
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/layout_util.h"
+#include "xla/literal_util.h"
+#include "xla/service/gpu/backend_configs.pb.h"
+#include "xla/service/pattern_matcher.h"
+#include "xla/shape_util.h"
+#include "tsl/platform/errors.h"
+
+namespace xla {
+namespace gpu {
+
+namespace {
+namespace m = match;
+
+struct ScaledFp8Operand {
+  HloInstruction* fp8 = nullptr;
+  // Scalar in the type of the dot, nullptr if the operand isn't scaled.
+  HloInstruction* scale = nullptr;
+};
+
+bool IsRowMajorMatrix(const Shape& shape) {
+  return shape.IsArray() && shape.rank() == 2 && shape.has_layout() &&
+         LayoutUtil::IsMonotonicWithDim0Major(shape.layout());
+}
+
+bool MatchFp8Convert(HloInstruction* instr, PrimitiveType type,
+                     HloInstruction** fp8) {
+  if (!Match(instr, m::Convert(m::Op(fp8))) ||
+      instr->shape().element_type() != type) {
+    return false;
+  }
+  PrimitiveType fp8_type = (*fp8)->shape().element_type();
+  return (fp8_type == F8E4M3FN || fp8_type == F8E5M2) &&
+         IsRowMajorMatrix((*fp8)->shape());
+}
+
+// Matches convert(fp8) or convert(fp8) * broadcast(scale) to `type`.
+std::optional<ScaledFp8Operand> MatchScaledFp8Operand(HloInstruction* instr,
+                                                      PrimitiveType type) {
+  ScaledFp8Operand result;
+  if (MatchFp8Convert(instr, type, &result.fp8)) return result;
+  HloInstruction *convert, *scale;
+  if (!Match(instr, m::MultiplyAnyOrder(m::Convert(&convert),
+                                        m::Broadcast(m::Op(&scale)))) ||
+      !MatchFp8Convert(convert, type, &result.fp8) ||
+      !ShapeUtil::IsEffectiveScalar(scale->shape())) {
+    return std::nullopt;
+  }
+  result.scale = scale;
+  return result;
+}
+
+// Returns the scale of an operand as an F32 scalar, 1 if it isn't scaled.
+HloInstruction* GetF32Scale(HloComputation* computation,
+                            const ScaledFp8Operand& operand) {
+  if (operand.scale == nullptr) {
+    return computation->AddInstruction(
+        HloInstruction::CreateConstant(LiteralUtil::One(F32)));
+  }
+  HloInstruction* scale = operand.scale;
+  if (scale->shape().rank() != 0) {
+    scale = computation->AddInstruction(HloInstruction::CreateReshape(
+        ShapeUtil::MakeShape(scale->shape().element_type(), {}), scale));
+  }
+  if (scale->shape().element_type() != F32) {
+    scale = computation->AddInstruction(HloInstruction::CreateConvert(
+        ShapeUtil::MakeShape(F32, {}), scale));
+  }
+  return scale;
+}
+
+StatusOr<bool> RewriteFp8Dot(HloInstruction* dot) {
+  if (dot->opcode() != HloOpcode::kDot || dot->HasControlDependencies()) {
+    return false;
+  }
+  const DotDimensionNumbers& dnums = dot->dot_dimension_numbers();
+  PrimitiveType type = dot->shape().element_type();
+  if ((type != F16 && type != BF16 && type != F32) ||
+      !IsRowMajorMatrix(dot->shape()) ||
+      dnums.lhs_batch_dimensions_size() != 0 ||
+      dnums.lhs_contracting_dimensions_size() != 1 ||
+      dnums.lhs_contracting_dimensions(0) != 1 ||
+      dnums.rhs_contracting_dimensions_size() != 1) {
+    return false;
+  }
+  std::optional<ScaledFp8Operand> a =
+      MatchScaledFp8Operand(dot->mutable_operand(0), type);
+  std::optional<ScaledFp8Operand> b =
+      MatchScaledFp8Operand(dot->mutable_operand(1), type);
+  if (!a.has_value() || !b.has_value()) return false;
+
+  HloComputation* computation = dot->parent();
+  HloInstruction* gemm =
+      computation->AddInstruction(HloInstruction::CreateCustomCall(
+          dot->shape(),
+          {a->fp8, b->fp8, GetF32Scale(computation, *a),
+           GetF32Scale(computation, *b)},
+          kFp8GemmCallTarget));
+  GpuBackendConfig gpu_config;
+  GemmBackendConfig& gemm_config = *gpu_config.mutable_gemm_backend_config();
+  *gemm_config.mutable_dot_dimension_numbers() = dnums;
+  gemm_config.set_alpha_real(1.0);
+  TF_RETURN_IF_ERROR(gemm->set_backend_config(gpu_config));
+  gemm->set_metadata(dot->metadata());
+  TF_RETURN_IF_ERROR(computation->ReplaceInstruction(dot, gemm));
+  return true;
+}
+
+}  // namespace
+
+bool IsCustomCallToFp8Gemm(const HloInstruction& hlo) {
+  return hlo.opcode() == HloOpcode::kCustomCall &&
+         hlo.custom_call_target() == kFp8GemmCallTarget;
+}
+
+StatusOr<bool> Fp8GemmRewriter::Run(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  bool any_changed = false;
+  for (HloComputation* computation :
+       module->MakeNonfusionComputations(execution_threads)) {
+    for (HloInstruction* instr : computation->MakeInstructionPostOrder()) {
+      bool changed = false;
+      TF_ASSIGN_OR_RETURN(changed, RewriteFp8Dot(instr));
+      any_changed |= changed;
+    }
+  }
+  return any_changed;
+}
+
+}  // namespace gpu
+}  // namespace xla
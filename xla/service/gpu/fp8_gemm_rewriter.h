@@ -0,0 +1,56 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_GPU_FP8_GEMM_REWRITER_H_
+#define XLA_SERVICE_GPU_FP8_GEMM_REWRITER_H_
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/string_view.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/hlo_pass_interface.h"
+
+namespace xla {
+namespace gpu {
+
+// Custom call of a GEMM with FP8 operands. Operands are a [m, k], b [k, n] (or
+// [n, k], see the dot dimension numbers in the GemmBackendConfig) and the F32
+// scalar scales of a and b. The selected algorithm is picked by
+// GemmAlgorithmPicker, see RunFp8Gemm.
+inline constexpr absl::string_view kFp8GemmCallTarget = "__onednn$f8_gemm";
+
+bool IsCustomCallToFp8Gemm(const HloInstruction& hlo);
+
+// Rewrites dots of per-tensor scaled FP8 operands into FP8 GEMMs:
+//
+//   dot(convert(a) * broadcast(a_scale), convert(b) * broadcast(b_scale))
+//
+// a and b are F8E4M3FN or F8E5M2 and the dot is F16, BF16 or F32. Without the
+// rewrite the operands are converted to the type of the dot in memory before
+// a GEMM in that type. Either scale may be missing.
+class Fp8GemmRewriter : public HloModulePass {
+ public:
+  Fp8GemmRewriter() = default;
+
+  absl::string_view name() const override { return "fp8-gemm-rewriter"; }
+  StatusOr<bool> Run(
+      HloModule* module,
+      const absl::flat_hash_set<absl::string_view>& execution_threads) override;
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_GPU_FP8_GEMM_REWRITER_H_
@@ -0,0 +1,51 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/gpu/fp8_gemm_thunk.h"
+
+#include "xla/service/gpu/buffer_allocations.h"
+#include "xla/stream_executor/scratch_allocator.h"
+
+namespace xla {
+namespace gpu {
+
+Fp8GemmThunk::Fp8GemmThunk(ThunkInfo thunk_info, Fp8GemmConfig config,
+                           BufferAllocation::Slice a,
+                           BufferAllocation::Slice b,
+                           BufferAllocation::Slice a_scale,
+                           BufferAllocation::Slice b_scale,
+                           BufferAllocation::Slice output)
+    : Thunk(Kind::kGemm, thunk_info),
+      config_(config),
+      a_(a),
+      b_(b),
+      a_scale_(a_scale),
+      b_scale_(b_scale),
+      output_(output) {}
+
+absl::Status Fp8GemmThunk::ExecuteOnStream(const ExecuteParams& params) {
+  const BufferAllocations& allocs = *params.buffer_allocations;
+  se::OwningScratchAllocator<> scratch_allocator(allocs.device_ordinal(),
+                                                 allocs.memory_allocator());
+  return RunFp8Gemm(config_, allocs.GetDeviceAddress(a_),
+                    allocs.GetDeviceAddress(b_),
+                    allocs.GetDeviceAddress(a_scale_),
+                    allocs.GetDeviceAddress(b_scale_),
+                    allocs.GetDeviceAddress(output_), params.stream,
+                    &scratch_allocator);
+}
+
+}  // namespace gpu
+}  // namespace xla
@@ -0,0 +1,50 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_GPU_FP8_GEMM_THUNK_H_
+#define XLA_SERVICE_GPU_FP8_GEMM_THUNK_H_
+
+#include "absl/status/status.h"
+#include "xla/service/buffer_assignment.h"
+#include "xla/service/gpu/onednn_matmul_utils.h"
+#include "xla/service/gpu/thunk.h"
+
+namespace xla {
+namespace gpu {
+
+// Thunk of the custom calls built by Fp8GemmRewriter.
+class Fp8GemmThunk : public Thunk {
+ public:
+  Fp8GemmThunk(ThunkInfo thunk_info, Fp8GemmConfig config,
+               BufferAllocation::Slice a, BufferAllocation::Slice b,
+               BufferAllocation::Slice a_scale,
+               BufferAllocation::Slice b_scale,
+               BufferAllocation::Slice output);
+
+  absl::Status ExecuteOnStream(const ExecuteParams& params) override;
+
+ private:
+  const Fp8GemmConfig config_;
+  const BufferAllocation::Slice a_;
+  const BufferAllocation::Slice b_;
+  const BufferAllocation::Slice a_scale_;
+  const BufferAllocation::Slice b_scale_;
+  const BufferAllocation::Slice output_;
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_GPU_FP8_GEMM_THUNK_H_
@@ -0,0 +1,164 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/gpu/gemm_autotune_database.h"
+
+#include <string>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/logging.h"
+#include "tsl/platform/protobuf.h"
+#include "tsl/util/env_var.h"
+
+namespace xla {
+namespace gpu {
+namespace {
+
+// Version of the AutotuneResults format written by AutotunerUtil.
+constexpr int kAutotuneResultsVersion = 3;
+
+AutotuneResults::Entry MakeEntry(uint32_t device_id,
+                                 const AutotuneCacheKey& key) {
+  AutotuneResults::Entry entry;
+  entry.set_device(absl::StrFormat("0x%04x/%s", device_id, key.GetModelStr()));
+  entry.set_hlo(std::string(key.GetHlo()));
+  return entry;
+}
+
+}  // namespace
+
+GemmAutotuneDatabase::GemmAutotuneDatabase(std::string path,
+                                           std::string pretuned_path)
+    : path_(std::move(path)) {
+  absl::MutexLock lock(&mu_);
+  if (!path_.empty()) {
+    absl::Status status = LoadFile(path_, &entries_);
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to load GEMM autotune database " << path_
+                   << ": " << status;
+    }
+  }
+  if (!pretuned_path.empty()) {
+    absl::Status status = LoadFile(pretuned_path, &pretuned_);
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to load pre-tuned GEMM autotune results "
+                   << pretuned_path << ": " << status;
+    }
+  }
+  VLOG(1) << "Loaded " << entries_.size() << " GEMM autotune results and "
+          << pretuned_.size() << " pre-tuned ones";
+}
+
+/* static */ GemmAutotuneDatabase* GemmAutotuneDatabase::Get() {
+  static GemmAutotuneDatabase* database = []() -> GemmAutotuneDatabase* {
+    std::string path, pretuned_path;
+    TF_CHECK_OK(
+        tsl::ReadStringFromEnvVar("XLA_SYCL_GEMM_AUTOTUNE_DB", "", &path));
+    TF_CHECK_OK(tsl::ReadStringFromEnvVar("XLA_SYCL_GEMM_AUTOTUNE_PRETUNED",
+                                          "", &pretuned_path));
+    if (path.empty() && pretuned_path.empty()) return nullptr;
+    return new GemmAutotuneDatabase(std::move(path), std::move(pretuned_path));
+  }();
+  return database;
+}
+
+/* static */ std::string GemmAutotuneDatabase::EntryKey(
+    const AutotuneResults::Entry& entry) {
+  return absl::StrCat(entry.device(), "\n", entry.hlo());
+}
+
+/* static */ absl::Status GemmAutotuneDatabase::LoadFile(
+    const std::string& path, EntryMap* entries) {
+  tsl::Env* env = tsl::Env::Default();
+  if (!env->FileExists(path).ok()) return absl::OkStatus();
+
+  std::string contents;
+  TF_RETURN_IF_ERROR(tsl::ReadFileToString(env, path, &contents));
+  AutotuneResults results;
+  if (!tsl::protobuf::TextFormat::ParseFromString(contents, &results)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Failed to parse AutotuneResults text proto ", path));
+  }
+  for (const AutotuneResults::Entry& entry : results.results()) {
+    entries->try_emplace(EntryKey(entry), entry);
+  }
+  return absl::OkStatus();
+}
+
+std::optional<AutotuneResult> GemmAutotuneDatabase::Lookup(
+    uint32_t device_id, const AutotuneCacheKey& key) {
+  std::string entry_key = EntryKey(MakeEntry(device_id, key));
+  absl::MutexLock lock(&mu_);
+  for (const EntryMap* entries : {&entries_, &pretuned_}) {
+    auto it = entries->find(entry_key);
+    if (it != entries->end()) return it->second.result();
+  }
+  return std::nullopt;
+}
+
+void GemmAutotuneDatabase::Insert(uint32_t device_id,
+                                  const AutotuneCacheKey& key,
+                                  const AutotuneResult& result) {
+  if (path_.empty()) return;
+  AutotuneResults::Entry entry = MakeEntry(device_id, key);
+  *entry.mutable_result() = result;
+  std::string entry_key = EntryKey(entry);
+  absl::MutexLock lock(&mu_);
+  entries_[entry_key] = entry;
+  pending_[entry_key] = std::move(entry);
+}
+
+absl::Status GemmAutotuneDatabase::Flush() {
+  absl::MutexLock lock(&mu_);
+  if (pending_.empty()) return absl::OkStatus();
+
+  // Results of the processes that flushed since this one loaded the file are
+  // merged in, results of this process win on conflicts. Two processes that
+  // flush at the same time may still drop each other's new entries, which
+  // only costs timing those GEMMs again.
+  EntryMap merged = pending_;
+  TF_RETURN_IF_ERROR(LoadFile(path_, &merged));
+  AutotuneResults results;
+  results.set_version(kAutotuneResultsVersion);
+  for (const auto& [entry_key, entry] : merged) {
+    *results.add_results() = entry;
+    entries_.try_emplace(entry_key, entry);
+  }
+  std::string contents;
+  if (!tsl::protobuf::TextFormat::PrintToString(results, &contents)) {
+    return absl::InternalError("Failed to print AutotuneResults text proto");
+  }
+
+  tsl::Env* env = tsl::Env::Default();
+  std::string tmp_path = absl::StrCat(path_, ".tmp.", env->NowMicros(), ".",
+                                      env->GetCurrentThreadId());
+  absl::Status status = tsl::WriteStringToFile(env, tmp_path, contents);
+  if (status.ok()) status = env->RenameFile(tmp_path, path_);
+  if (!status.ok()) {
+    env->DeleteFile(tmp_path).IgnoreError();
+    return status;
+  }
+  VLOG(1) << "Wrote " << pending_.size() << " new GEMM autotune results to "
+          << path_;
+  pending_.clear();
+  return absl::OkStatus();
+}
+
+}  // namespace gpu
+}  // namespace xla
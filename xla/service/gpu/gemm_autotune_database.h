@@ -0,0 +1,81 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_GPU_GEMM_AUTOTUNE_DATABASE_H_
+#define XLA_SERVICE_GPU_GEMM_AUTOTUNE_DATABASE_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+#include "xla/autotune_results.pb.h"
+#include "xla/service/gpu/autotuner_util.h"
+
+namespace xla {
+namespace gpu {
+
+// Persistent database of GEMM autotune results shared by all processes on a
+// machine. AutotunerUtil only caches results for the lifetime of a process,
+// so every process start used to time the same GEMMs again.
+//
+// The database is the AutotuneResults text proto at XLA_SYCL_GEMM_AUTOTUNE_DB.
+// Entries are keyed by the PCI device id and the AutotuneCacheKey, the model
+// string alone does not tell apart SKUs that share a marketing name. Entries
+// of the read-only file at XLA_SYCL_GEMM_AUTOTUNE_PRETUNED, e.g. pre-tuned
+// results installed with the plugin, are used when the database has no result
+// of its own. The database is disabled if neither variable is set.
+class GemmAutotuneDatabase {
+ public:
+  // Returns the process wide database, loading it on first use, or nullptr if
+  // it is disabled.
+  static GemmAutotuneDatabase* Get();
+
+  std::optional<AutotuneResult> Lookup(uint32_t device_id,
+                                       const AutotuneCacheKey& key);
+
+  void Insert(uint32_t device_id, const AutotuneCacheKey& key,
+              const AutotuneResult& result);
+
+  // Writes the entries inserted since the last flush to the database file.
+  // The file is re-read and merged first so that results of other processes
+  // are kept, and is replaced by a rename so that readers never observe a
+  // partially written file.
+  absl::Status Flush();
+
+ private:
+  using EntryMap = absl::flat_hash_map<std::string, AutotuneResults::Entry>;
+
+  GemmAutotuneDatabase(std::string path, std::string pretuned_path);
+
+  static std::string EntryKey(const AutotuneResults::Entry& entry);
+
+  // Adds the entries of the file at `path` to `entries`, keeping the existing
+  // ones on conflict. A missing file is not an error.
+  static absl::Status LoadFile(const std::string& path, EntryMap* entries);
+
+  const std::string path_;
+  absl::Mutex mu_;
+  EntryMap entries_ ABSL_GUARDED_BY(mu_);
+  EntryMap pretuned_ ABSL_GUARDED_BY(mu_);
+  EntryMap pending_ ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_GPU_GEMM_AUTOTUNE_DATABASE_H_
@@ -0,0 +1,145 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// XeTLA against oneDNN GEMMs over a grid of BF16 shapes. Both run through
+// RunGemm, the path of the GEMM thunks, so the times include the primitive
+// cache lookups and policy selection of a real execution.
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "benchmark/benchmark.h"
+#include "tsl/platform/status.h"
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/gpu/autotuner_util.h"
+#include "xla/service/gpu/backend_configs.pb.h"
+#include "xla/service/gpu/cublas_cudnn.h"
+#include "xla/service/gpu/matmul_utils.h"
+#include "xla/service/gpu/onednn_matmul_utils.h"
+#include "xla/service/hlo_module_config.h"
+#include "xla/shape_util.h"
+#include "xla/stream_executor/blas.h"
+#include "xla/stream_executor/device_memory_allocator.h"
+#include "xla/stream_executor/gpu/gpu_stream.h"
+#include "xla/stream_executor/platform_manager.h"
+#include "xla/stream_executor/scratch_allocator.h"
+#include "xla/stream_executor/sycl/sycl_benchmark_util.h"
+#include "xla/xla.pb.h"
+#include "xla/xla_data.pb.h"
+
+namespace xla {
+namespace gpu {
+namespace {
+
+// Returns a module whose root is an m x n x k BF16 GEMM custom call run with
+// `algorithm`.
+std::unique_ptr<HloModule> MakeGemmModule(int64_t m, int64_t n, int64_t k,
+                                          se::blas::AlgorithmType algorithm) {
+  HloComputation::Builder builder("gemm");
+  HloInstruction* lhs = builder.AddInstruction(HloInstruction::CreateParameter(
+      0, ShapeUtil::MakeShape(BF16, {m, k}), "lhs"));
+  HloInstruction* rhs = builder.AddInstruction(HloInstruction::CreateParameter(
+      1, ShapeUtil::MakeShape(BF16, {k, n}), "rhs"));
+  HloInstruction* gemm =
+      builder.AddInstruction(HloInstruction::CreateCustomCall(
+          ShapeUtil::MakeShape(BF16, {m, n}), {lhs, rhs}, kGemmCallTarget));
+
+  GpuBackendConfig gpu_config;
+  GemmBackendConfig& config = *gpu_config.mutable_gemm_backend_config();
+  config.set_alpha_real(1);
+  config.set_beta(0);
+  config.mutable_dot_dimension_numbers()->add_lhs_contracting_dimensions(1);
+  config.mutable_dot_dimension_numbers()->add_rhs_contracting_dimensions(0);
+  config.mutable_precision_config()->add_operand_precision(
+      PrecisionConfig::DEFAULT);
+  config.mutable_precision_config()->add_operand_precision(
+      PrecisionConfig::DEFAULT);
+  config.set_epilogue(GemmBackendConfig::DEFAULT);
+  config.set_selected_algorithm(algorithm);
+  TF_CHECK_OK(gemm->set_backend_config(gpu_config));
+
+  auto module = std::make_unique<HloModule>("gemm", HloModuleConfig());
+  module->AddEntryComputation(builder.Build());
+  return module;
+}
+
+// range(0), range(1) and range(2) are m, n and k.
+void BM_Gemm(benchmark::State& state, se::blas::AlgorithmType algorithm) {
+  const int64_t m = state.range(0);
+  const int64_t n = state.range(1);
+  const int64_t k = state.range(2);
+
+  absl::StatusOr<se::Platform*> platform =
+      se::PlatformManager::PlatformWithName("SYCL");
+  if (!platform.ok()) {
+    state.SkipWithError(platform.status().ToString().c_str());
+    return;
+  }
+  se::StreamExecutor* executor = (*platform)->ExecutorForDevice(0).value();
+  AutotuneConfig autotune_config(DeviceConfig{executor, nullptr},
+                                 DebugOptions());
+  se::Stream* stream = autotune_config.GetStream().value();
+  se::DeviceMemoryAllocator* allocator = autotune_config.GetAllocator();
+
+  std::unique_ptr<HloModule> module = MakeGemmModule(m, n, k, algorithm);
+  GemmConfig config =
+      GemmConfig::For(module->entry_computation()->root_instruction())
+          .value();
+  constexpr int64_t kBf16Bytes = 2;
+  se::OwningDeviceMemory lhs =
+      allocator->Allocate(0, m * k * kBf16Bytes).value();
+  se::OwningDeviceMemory rhs =
+      allocator->Allocate(0, k * n * kBf16Bytes).value();
+  se::OwningDeviceMemory output =
+      allocator->Allocate(0, m * n * kBf16Bytes).value();
+  se::OwningScratchAllocator<> scratch_allocator(0, allocator);
+
+  auto run = [&] {
+    return RunGemm(config, *lhs, *rhs, *output, *output,
+                   se::DeviceMemoryBase(), stream,
+                   se::gpu::BlasLt::Epilogue::kDefault, &scratch_allocator);
+  };
+  // Creates the primitives and kernels outside of the timed iterations.
+  absl::Status status = run();
+  if (!status.ok()) {
+    state.SkipWithError(status.ToString().c_str());
+    return;
+  }
+  for (auto _ : state) {
+    state.SetIterationTime(stream_executor::gpu::TimeOnStream(
+        se::gpu::AsGpuStreamValue(stream), [&] { TF_CHECK_OK(run()); }));
+  }
+  state.counters["FLOPS"] = benchmark::Counter(
+      2.0 * m * n * k, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+// Decode, prefill and training shapes of the projections of LLMs.
+void GemmArgs(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"m", "n", "k"});
+  b->ArgsProduct({{1, 16, 128, 1024, 4096}, {4096, 11008}, {4096}});
+  b->ArgsProduct({{1, 16, 128, 1024, 4096}, {4096}, {11008}});
+  b->UseManualTime();
+}
+
+BENCHMARK_CAPTURE(BM_Gemm, xetla, se::blas::kXetlaGemm)->Apply(GemmArgs);
+BENCHMARK_CAPTURE(BM_Gemm, onednn, se::blas::kDefaultAlgorithm)
+    ->Apply(GemmArgs);
+
+}  // namespace
+}  // namespace gpu
+}  // namespace xla
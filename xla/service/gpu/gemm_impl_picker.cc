@@ -17,18 +17,30 @@ limitations under the License.
 
 #include "xla/service/gpu/gemm_impl_picker.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
+#include "tsl/platform/env.h"
 #include "tsl/platform/errors.h"
 #include "tsl/platform/logging.h"
 #include "tsl/platform/statusor.h"
+#include "tsl/platform/threadpool.h"
 #include "tsl/util/env_var.h"
 #include "tsl/util/proto/proto_utils.h"
 #include "xla/service/gpu/cublas_cudnn.h"
+#include "xla/service/gpu/fp8_gemm_rewriter.h"
+#include "xla/service/gpu/gemm_autotune_database.h"
 #include "xla/service/gpu/ir_emission_utils.h"
 #include "xla/service/gpu/onednn_matmul_utils.h"
 #include "xla/stream_executor/gpu/gpu_stream.h"
 #include "xla/stream_executor/gpu/gpu_timer.h"
+#include "xla/stream_executor/platform_manager.h"
 #include "xla/stream_executor/sycl/hw_info.h"
 
 namespace xla {
@@ -47,9 +59,9 @@ bool IsXetlaSupport(const GemmConfig& config) {
   auto lhs_layout = MatrixLayout{config.lhs_layout};
   auto rhs_layout = MatrixLayout{config.rhs_layout};
   auto output_layout = MatrixLayout{config.output_layout};
-  int64_t batch_size = output_layout.batch_size;
-  bool xetla_support = flag && IsXetlaHardwareSupport() && (batch_size == 1) &&
-                       (fabs(config.alpha.real() - 1.0f) < 1e-6) &&
+  // XeTLA kernels scale the accumulators by a real alpha in the epilogue.
+  bool xetla_support = flag && IsXetlaHardwareSupport() &&
+                       config.alpha.imag() == 0 &&
                        output_layout.dtype != F32 &&
                        lhs_layout.dtype == output_layout.dtype;
   return xetla_support;
@@ -162,8 +174,11 @@ absl::StatusOr<AutotuneResult> DoGemmAutotuneNoCache(
   HloInstruction* gemm_update = const_cast<HloInstruction*>(gemm);
 
   std::vector<AutotuneResult> results;
-  std::vector<se::blas::AlgorithmType> algorithms;
-  algorithms.emplace_back(se::blas::kXetlaGemm);
+  // Every XeTLA tile policy is a candidate of its own, so the autotune cache
+  // records the best tile for the shape rather than just the best library.
+  // Policies the kernel can't run or the cost model rules out aren't timed.
+  std::vector<se::blas::AlgorithmType> algorithms =
+      GetXetlaGemmAlgorithms(config);
   algorithms.emplace_back(se::blas::kOneDnnGemm);
   for (const se::blas::AlgorithmType& algorithm : algorithms) {
     updated_config.set_selected_algorithm(algorithm);
@@ -171,7 +186,11 @@ absl::StatusOr<AutotuneResult> DoGemmAutotuneNoCache(
     TF_RETURN_IF_ERROR(gemm_update->set_backend_config(gpu_config));
     absl::StatusOr<absl::Duration> run_time =
         GetExecuteTime(gemm_update, autotune_config);
-    if (!run_time.ok()) continue;
+    if (!run_time.ok()) {
+      VLOG(3) << "Skipping GEMM algorithm " << algorithm << ": "
+              << run_time.status();
+      continue;
+    }
 
     results.emplace_back();
     AutotuneResult& result = results.back();
@@ -191,45 +210,170 @@ absl::StatusOr<AutotuneResult> DoGemmAutotuneNoCache(
   return *best;
 }
 
-absl::StatusOr<bool> RunOnInstruction(HloInstruction* gemm,
-                                      const AutotuneConfig& config) {
-  LOG(INFO) << "Loading the autotune result of GemmThunk " << gemm->ToString();
+// FP8 GEMMs run as native FP8 oneDNN matmuls or with the operands upcast to
+// F16, native FP8 matmuls aren't implemented on every device. XeTLA has no FP8
+// kernels.
+absl::StatusOr<AutotuneResult> DoFp8GemmAutotuneNoCache(
+    const HloInstruction* gemm, const AutotuneConfig& autotune_config) {
+  // The upcast matmul runs everywhere.
+  AutotuneResult default_algorithm;
+  default_algorithm.mutable_gemm()->set_algorithm(se::blas::kDefaultAlgorithm);
+  if (autotune_config.IsDeviceless()) return default_algorithm;
+  VLOG(3) << "Starting autotune of FP8 GEMM " << gemm->ToString();
 
-  GpuBackendConfig gpu_config =
-      gemm->backend_config<GpuBackendConfig>().value();
-  GemmBackendConfig gemm_config = gpu_config.gemm_backend_config();
+  TF_ASSIGN_OR_RETURN(se::Stream* const stream, autotune_config.GetStream());
+  TF_ASSIGN_OR_RETURN(Fp8GemmConfig config, GetFp8GemmConfig(gemm));
+  const DebugOptions& debug_options =
+      gemm->GetModule()->config().debug_options();
+  absl::MutexLock gpu_lock(&GetGpuMutex(stream->parent()));
+  TF_ASSIGN_OR_RETURN(
+      se::RedzoneAllocator buffer_allocator,
+      AutotunerUtil::CreateRedzoneAllocator(autotune_config, debug_options));
+  int64_t rng_state = 0;
+  std::vector<se::DeviceMemoryBase> buffers;
+  for (const HloInstruction* operand : gemm->operands()) {
+    TF_ASSIGN_OR_RETURN(
+        se::DeviceMemoryBase buffer,
+        AutotunerUtil::CreateBuffer(buffer_allocator, operand->shape(),
+                                    autotune_config, rng_state));
+    buffers.push_back(buffer);
+  }
+  TF_ASSIGN_OR_RETURN(
+      se::DeviceMemoryBase output_buffer,
+      AutotunerUtil::CreateBuffer(buffer_allocator, gemm->shape(),
+                                  autotune_config, rng_state));
+  se::OwningScratchAllocator<> scratch_allocator(
+      stream->parent()->device_ordinal(), autotune_config.GetAllocator());
 
-  // Degenerate gemms replaced with memzero operation, no need to auto tune it.
-  if (gemm_config.alpha_real() == 0.0 && gemm_config.alpha_imag() == 0.0 &&
-      gemm_config.beta() == 0.0) {
-    VLOG(3) << "Skip degenerate gemm instruction auto tuning";
-    return false;
+  std::vector<AutotuneResult> results;
+  for (se::blas::AlgorithmType algorithm :
+       {se::blas::kOneDnnGemm, se::blas::kDefaultAlgorithm}) {
+    config.algorithm = algorithm;
+    auto run = [&] {
+      return RunFp8Gemm(config, buffers[0], buffers[1], buffers[2],
+                        buffers[3], output_buffer, stream, &scratch_allocator);
+    };
+    // The warmup iteration also reports devices without FP8 matmuls.
+    absl::Status status = run();
+    if (!status.ok()) {
+      VLOG(3) << "Skipping FP8 GEMM algorithm " << algorithm << ": "
+              << status;
+      continue;
+    }
+    TF_ASSIGN_OR_RETURN(
+        auto timer, se::gpu::GpuTimer::Create(se::gpu::AsGpuStream(stream)));
+    TF_RETURN_IF_ERROR(run());
+    TF_ASSIGN_OR_RETURN(absl::Duration run_time, timer.GetElapsedDuration());
+
+    results.emplace_back();
+    AutotuneResult& result = results.back();
+    result.mutable_gemm()->set_algorithm(algorithm);
+    *result.mutable_run_time() = tsl::proto_utils::ToDurationProto(run_time);
   }
+  if (results.empty()) return default_algorithm;
+  return *absl::c_min_element(
+      results, [](const AutotuneResult& lhs, const AutotuneResult& rhs) {
+        return tsl::proto_utils::FromDurationProto(lhs.run_time()) <
+               tsl::proto_utils::FromDurationProto(rhs.run_time());
+      });
+}
 
-  AutotuneCacheKey key(config.GetModelStr(), *gemm);
-  GemmBackendConfig updated_config = gemm_config;
+// PCI device id of the device that autotuning runs on, or that deviceless
+// compilation targets.
+uint32_t AutotuneDeviceId(const AutotuneConfig& config) {
+  if (config.IsDeviceless()) return GetDeviceId();
+  sycl::device* device = nullptr;
+  if (SYCLGetDevice(&device, config.GetExecutor()->device_ordinal()) !=
+      SYCL_SUCCESS) {
+    return GetDeviceId();
+  }
+  return GetDeviceId(device);
+}
+
+bool IsParallelAutotuneEnabled() {
+  static bool flag = [] {
+    bool flag = false;
+    TF_CHECK_OK(tsl::ReadBoolFromEnvVar("XLA_SYCL_PARALLEL_GEMM_AUTOTUNE",
+                                        false, &flag));
+    return flag;
+  }();
+  return flag;
+}
+
+// Returns `config` followed by the configs of the other visible devices of
+// the same kind, which GEMMs can be timed on in parallel. Timings are only
+// comparable between identical devices.
+std::vector<AutotuneConfig> GetAutotuneConfigs(
+    const AutotuneConfig& config, const DebugOptions& debug_options) {
+  std::vector<AutotuneConfig> configs = {config};
+  if (config.IsDeviceless() || !IsParallelAutotuneEnabled()) return configs;
+
+  se::StreamExecutor* executor = config.GetExecutor();
+  absl::StatusOr<se::Platform*> platform =
+      se::PlatformManager::PlatformWithId(executor->platform()->id());
+  if (!platform.ok()) return configs;
+  uint32_t device_id = AutotuneDeviceId(config);
+  for (int i = 0; i < (*platform)->VisibleDeviceCount(); ++i) {
+    if (i == executor->device_ordinal()) continue;
+    absl::StatusOr<se::StreamExecutor*> other =
+        (*platform)->ExecutorForDevice(i);
+    if (!other.ok()) continue;
+    // The allocator of `config` may only serve its own device, the others
+    // allocate their autotuning buffers directly.
+    AutotuneConfig other_config(DeviceConfig{*other, nullptr}, debug_options);
+    if (AutotuneDeviceId(other_config) != device_id) continue;
+    configs.push_back(std::move(other_config));
+  }
+  return configs;
+}
+
+// Degenerate gemms replaced with memzero operation, no need to auto tune it.
+bool IsDegenerateGemm(const HloInstruction* gemm) {
+  const GemmBackendConfig& gemm_config =
+      gemm->backend_config<GpuBackendConfig>()->gemm_backend_config();
+  return gemm_config.alpha_real() == 0.0 && gemm_config.alpha_imag() == 0.0 &&
+         gemm_config.beta() == 0.0;
+}
+
+absl::StatusOr<AutotuneResult> AutotuneGemm(HloInstruction* gemm,
+                                            const AutotuneCacheKey& key,
+                                            const AutotuneConfig& config) {
+  GemmAutotuneDatabase* database = GemmAutotuneDatabase::Get();
+  uint32_t device_id = database != nullptr ? AutotuneDeviceId(config) : 0;
+  std::optional<AutotuneResult> stored =
+      database != nullptr ? database->Lookup(device_id, key) : std::nullopt;
+  if (stored.has_value()) {
+    VLOG(3) << "Using stored autotune result of " << gemm->name();
+    return *std::move(stored);
+  }
+  bool timed = false;
   TF_ASSIGN_OR_RETURN(AutotuneResult algorithm,
                       AutotunerUtil::Autotune(gemm, config, [&] {
+                        timed = true;
+                        if (IsCustomCallToFp8Gemm(*gemm)) {
+                          return DoFp8GemmAutotuneNoCache(gemm, config);
+                        }
                         return DoGemmAutotuneNoCache(gemm, key, config);
                       }));
+  if (database != nullptr && timed) {
+    database->Insert(device_id, key, algorithm);
+  }
+  return algorithm;
+}
+
+absl::StatusOr<bool> ApplyAutotuneResult(HloInstruction* gemm,
+                                         const GemmBackendConfig& gemm_config,
+                                         const AutotuneResult& algorithm) {
+  LOG(INFO) << "Loading the autotune result of GemmThunk " << gemm->ToString();
+  GpuBackendConfig gpu_config =
+      gemm->backend_config<GpuBackendConfig>().value();
+  GemmBackendConfig updated_config = gemm_config;
   updated_config.set_selected_algorithm(algorithm.gemm().algorithm());
   *gpu_config.mutable_gemm_backend_config() = updated_config;
   TF_RETURN_IF_ERROR(gemm->set_backend_config(gpu_config));
   return updated_config.SerializeAsString() != gemm_config.SerializeAsString();
 }
 
-absl::StatusOr<bool> RunOnComputation(HloComputation* computation,
-                                      AutotuneConfig config) {
-  bool changed = false;
-  for (HloInstruction* instr : computation->instructions()) {
-    if (IsCublasGemm(*instr)) {
-      TF_ASSIGN_OR_RETURN(bool result, RunOnInstruction(instr, config));
-      changed |= result;
-    }
-  }
-  return changed;
-}
-
 }  // namespace
 
 absl::StatusOr<bool> GemmAlgorithmPicker::Run(
@@ -242,11 +386,78 @@ absl::StatusOr<bool> GemmAlgorithmPicker::Run(
         << "GEMM auto-tuning disabled, GemmAlgorithmPicker returning early";
     return false;
   }
-  bool changed = false;
+
+  // GEMMs of the same shape and configuration are only tuned once. Keys are
+  // computed before tuning starts, which rewrites the backend configs of the
+  // tuned instructions while it runs.
+  struct Gemm {
+    HloInstruction* instr;
+    GemmBackendConfig config;
+    size_t unique_index;
+  };
+  std::vector<Gemm> gemms;
+  std::vector<HloInstruction*> unique_gemms;
+  std::vector<AutotuneCacheKey> unique_keys;
+  absl::flat_hash_map<AutotuneCacheKey, size_t> unique_index;
   for (HloComputation* computation :
        module->MakeNonfusionComputations(execution_threads)) {
-    TF_ASSIGN_OR_RETURN(bool result, RunOnComputation(computation, config_));
-    changed |= result;
+    for (HloInstruction* instr : computation->instructions()) {
+      if (!IsCublasGemm(*instr) && !IsCustomCallToFp8Gemm(*instr)) continue;
+      if (IsDegenerateGemm(instr)) {
+        VLOG(3) << "Skip degenerate gemm instruction auto tuning";
+        continue;
+      }
+      AutotuneCacheKey key(config_.GetModelStr(), *instr);
+      auto [it, inserted] = unique_index.try_emplace(key, unique_gemms.size());
+      if (inserted) {
+        unique_gemms.push_back(instr);
+        unique_keys.push_back(std::move(key));
+      }
+      gemms.push_back(
+          {instr,
+           instr->backend_config<GpuBackendConfig>()->gemm_backend_config(),
+           it->second});
+    }
+  }
+
+  // Autotuning holds the GPU mutex of its device, so the unique GEMMs are
+  // spread over one worker per device.
+  std::vector<AutotuneConfig> configs =
+      GetAutotuneConfigs(config_, module->config().debug_options());
+  std::vector<absl::StatusOr<AutotuneResult>> results(unique_gemms.size());
+  auto run_worker = [&](std::atomic<size_t>* next,
+                        const AutotuneConfig& config) {
+    for (size_t i = (*next)++; i < unique_gemms.size(); i = (*next)++) {
+      results[i] = AutotuneGemm(unique_gemms[i], unique_keys[i], config);
+    }
+  };
+  std::atomic<size_t> next = 0;
+  size_t num_workers = std::min(configs.size(), unique_gemms.size());
+  if (num_workers > 1) {
+    VLOG(1) << "Autotuning " << unique_gemms.size() << " GEMMs on "
+            << num_workers << " devices";
+    tsl::thread::ThreadPool pool(tsl::Env::Default(), "xla_sycl_gemm_autotune",
+                                 num_workers);
+    for (size_t w = 0; w < num_workers; ++w) {
+      pool.Schedule([&, w] { run_worker(&next, configs[w]); });
+    }
+  } else {
+    run_worker(&next, configs.front());
+  }
+
+  bool changed = false;
+  for (const Gemm& gemm : gemms) {
+    const absl::StatusOr<AutotuneResult>& result = results[gemm.unique_index];
+    TF_RETURN_IF_ERROR(result.status());
+    TF_ASSIGN_OR_RETURN(bool result_changed,
+                        ApplyAutotuneResult(gemm.instr, gemm.config, *result));
+    changed |= result_changed;
+  }
+  if (GemmAutotuneDatabase* database = GemmAutotuneDatabase::Get()) {
+    absl::Status status = database->Flush();
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to update GEMM autotune database: " << status;
+    }
   }
   return changed;
 }
@@ -0,0 +1,270 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/gpu/grouped_gemm_rewriter.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/hlo/ir/hlo_reachability.h"
+#include "xla/layout_util.h"
+#include "xla/service/gpu/backend_configs.pb.h"
+#include "xla/service/gpu/ir_emission_utils.h"
+#include "xla/shape_util.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/statusor.h"
+
+namespace xla {
+namespace gpu {
+
+namespace {
+
+// The N and K of a GEMM with the element type, GEMMs of the same key can be
+// grouped.
+using GroupKey = std::tuple<PrimitiveType, int64_t, int64_t>;
+
+bool IsRowMajorMatrix(const Shape& shape) {
+  return shape.IsArray() && shape.rank() == 2 && shape.has_layout() &&
+         LayoutUtil::IsMonotonicWithDim0Major(shape.layout());
+}
+
+const Shape& GemmResultShape(const HloInstruction* gemm) {
+  return gemm->shape().IsTuple() ? gemm->shape().tuple_shapes(0)
+                                 : gemm->shape();
+}
+
+// Returns the key of `instr` if it is a GEMM the grouped kernel can run.
+std::optional<GroupKey> GetGroupKey(const HloInstruction* instr) {
+  if (!IsLegacyCublasMatmul(*instr) || instr->HasControlDependencies() ||
+      instr->operand_count() != 2) {
+    return std::nullopt;
+  }
+  auto gpu_config = instr->backend_config<GpuBackendConfig>();
+  if (!gpu_config.ok()) return std::nullopt;
+  const GemmBackendConfig& config = gpu_config->gemm_backend_config();
+  const DotDimensionNumbers& dnums = config.dot_dimension_numbers();
+  if (config.epilogue() != GemmBackendConfig::DEFAULT ||
+      config.alpha_real() != 1.0 || config.alpha_imag() != 0.0 ||
+      config.beta() != 0.0 || dnums.lhs_batch_dimensions_size() != 0 ||
+      dnums.rhs_batch_dimensions_size() != 0 ||
+      dnums.lhs_contracting_dimensions_size() != 1 ||
+      dnums.lhs_contracting_dimensions(0) != 1 ||
+      dnums.rhs_contracting_dimensions_size() != 1 ||
+      dnums.rhs_contracting_dimensions(0) != 0) {
+    return std::nullopt;
+  }
+  const Shape& lhs = instr->operand(0)->shape();
+  const Shape& rhs = instr->operand(1)->shape();
+  const Shape& out = GemmResultShape(instr);
+  if (!IsRowMajorMatrix(lhs) || !IsRowMajorMatrix(rhs) ||
+      !IsRowMajorMatrix(out)) {
+    return std::nullopt;
+  }
+  PrimitiveType type = out.element_type();
+  if ((type != F16 && type != BF16) || lhs.element_type() != type ||
+      rhs.element_type() != type) {
+    return std::nullopt;
+  }
+  int64_t n = rhs.dimensions(1);
+  int64_t k = rhs.dimensions(0);
+  // The kernels load rows with 8 byte aligned block loads.
+  if (n % 4 != 0 || k % 4 != 0) return std::nullopt;
+  // Only the result of a GEMM returning a workspace can be forwarded.
+  if (instr->shape().IsTuple()) {
+    for (const HloInstruction* user : instr->users()) {
+      if (user->opcode() != HloOpcode::kGetTupleElement ||
+          user->tuple_index() != 0) {
+        return std::nullopt;
+      }
+    }
+  }
+  return GroupKey{type, n, k};
+}
+
+// Returns the tensor the tokens of `lhs` come from. Expert GEMMs either
+// share their token operand or take per-expert slices of the dispatched
+// tokens.
+const HloInstruction* TokenSource(const HloInstruction* lhs) {
+  auto skip_layout_ops = [](const HloInstruction* instr) {
+    while (instr->opcode() == HloOpcode::kBitcast ||
+           instr->opcode() == HloOpcode::kReshape ||
+           instr->opcode() == HloOpcode::kCopy) {
+      instr = instr->operand(0);
+    }
+    return instr;
+  };
+  lhs = skip_layout_ops(lhs);
+  if (lhs->opcode() == HloOpcode::kSlice ||
+      lhs->opcode() == HloOpcode::kDynamicSlice ||
+      lhs->opcode() == HloOpcode::kGather) {
+    return skip_layout_ops(lhs->operand(0));
+  }
+  return lhs;
+}
+
+// Returns true if merging each group of `groups` into one instruction keeps
+// the computation acyclic. The GEMMs of a group are mutually unreachable, so a
+// cycle can only go through several groups: it needs a path from a member of
+// one group to a member of the next one, all the way around.
+bool GroupsAreAcyclic(const std::vector<std::vector<HloInstruction*>>& groups,
+                      const HloReachabilityMap& reachability) {
+  size_t n = groups.size();
+  std::vector<std::vector<size_t>> successors(n);
+  for (size_t from = 0; from < n; ++from) {
+    for (size_t to = 0; to < n; ++to) {
+      if (from == to) continue;
+      bool reaches = false;
+      for (const HloInstruction* a : groups[from]) {
+        for (const HloInstruction* b : groups[to]) {
+          if (reachability.IsReachable(a, b)) {
+            reaches = true;
+            break;
+          }
+        }
+        if (reaches) break;
+      }
+      if (reaches) successors[from].push_back(to);
+    }
+  }
+
+  // Depth first search for a back edge.
+  enum class Visit { kNew, kActive, kDone };
+  std::vector<Visit> visits(n, Visit::kNew);
+  std::function<bool(size_t)> has_cycle = [&](size_t group) {
+    visits[group] = Visit::kActive;
+    for (size_t next : successors[group]) {
+      if (visits[next] == Visit::kActive) return true;
+      if (visits[next] == Visit::kNew && has_cycle(next)) return true;
+    }
+    visits[group] = Visit::kDone;
+    return false;
+  };
+  for (size_t group = 0; group < n; ++group) {
+    if (visits[group] == Visit::kNew && has_cycle(group)) return false;
+  }
+  return true;
+}
+
+// Returns the groups of at least two mutually independent GEMMs of the same
+// key and token source in `computation`. The groups are disjoint and can all
+// be rewritten without introducing a cycle.
+std::vector<std::vector<HloInstruction*>> FindGroups(
+    HloComputation* computation) {
+  using CandidateKey = std::tuple<GroupKey, const HloInstruction*>;
+  absl::flat_hash_map<CandidateKey, std::vector<HloInstruction*>> candidates;
+  std::vector<CandidateKey> keys;
+  for (HloInstruction* instr : computation->MakeInstructionPostOrder()) {
+    std::optional<GroupKey> key = GetGroupKey(instr);
+    if (!key.has_value()) continue;
+    CandidateKey candidate_key{*key, TokenSource(instr->operand(0))};
+    auto& gemms = candidates[candidate_key];
+    if (gemms.empty()) keys.push_back(candidate_key);
+    gemms.push_back(instr);
+  }
+
+  std::vector<std::vector<HloInstruction*>> groups;
+  std::unique_ptr<HloReachabilityMap> reachability;
+  for (const CandidateKey& key : keys) {
+    std::vector<HloInstruction*> gemms = std::move(candidates[key]);
+    while (gemms.size() >= 2) {
+      if (reachability == nullptr) {
+        reachability = HloReachabilityMap::Build(computation);
+      }
+      std::vector<HloInstruction*> group;
+      std::vector<HloInstruction*> rest;
+      for (HloInstruction* gemm : gemms) {
+        bool independent = true;
+        for (HloInstruction* member : group) {
+          if (reachability->IsConnected(gemm, member)) {
+            independent = false;
+            break;
+          }
+        }
+        (independent ? group : rest).push_back(gemm);
+      }
+      if (group.size() < 2) break;
+      groups.push_back(std::move(group));
+      if (!GroupsAreAcyclic(groups, *reachability)) groups.pop_back();
+      gemms = std::move(rest);
+    }
+  }
+  return groups;
+}
+
+absl::Status RewriteGroup(HloComputation* computation,
+                          const std::vector<HloInstruction*>& group) {
+  std::vector<HloInstruction*> operands;
+  std::vector<Shape> shapes;
+  for (HloInstruction* gemm : group) {
+    operands.push_back(gemm->mutable_operand(0));
+    operands.push_back(gemm->mutable_operand(1));
+    shapes.push_back(GemmResultShape(gemm));
+  }
+  HloInstruction* grouped =
+      computation->AddInstruction(HloInstruction::CreateCustomCall(
+          ShapeUtil::MakeTupleShape(shapes), operands,
+          kXetlaGroupedGemmCallTarget));
+  grouped->set_metadata(group.front()->metadata());
+  computation->parent()->SetAndUniquifyInstrName(grouped, "grouped_gemm");
+
+  for (size_t i = 0; i < group.size(); ++i) {
+    HloInstruction* gemm = group[i];
+    HloInstruction* result = computation->AddInstruction(
+        HloInstruction::CreateGetTupleElement(grouped, i));
+    if (gemm->shape().IsTuple()) {
+      std::vector<HloInstruction*> users = gemm->users();
+      for (HloInstruction* user : users) {
+        TF_RETURN_IF_ERROR(user->ReplaceAllUsesWith(result));
+        TF_RETURN_IF_ERROR(computation->RemoveInstruction(user));
+      }
+    } else {
+      TF_RETURN_IF_ERROR(gemm->ReplaceAllUsesWith(result));
+    }
+    TF_RETURN_IF_ERROR(computation->RemoveInstruction(gemm));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+bool IsCustomCallToGroupedGemm(const HloInstruction& hlo) {
+  return hlo.opcode() == HloOpcode::kCustomCall &&
+         hlo.custom_call_target() == kXetlaGroupedGemmCallTarget;
+}
+
+StatusOr<bool> GroupedGemmRewriter::Run(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  bool any_changed = false;
+  for (HloComputation* computation :
+       module->MakeNonfusionComputations(execution_threads)) {
+    for (const std::vector<HloInstruction*>& group : FindGroups(computation)) {
+      TF_RETURN_IF_ERROR(RewriteGroup(computation, group));
+      any_changed = true;
+    }
+  }
+  return any_changed;
+}
+
+}  // namespace gpu
+}  // namespace xla
@@ -0,0 +1,61 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_GPU_GROUPED_GEMM_REWRITER_H_
+#define XLA_SERVICE_GPU_GROUPED_GEMM_REWRITER_H_
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/string_view.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/hlo_pass_interface.h"
+
+namespace xla {
+namespace gpu {
+
+// Custom call running a group of GEMMs in one launch. Operands are the pairs
+// (lhs_0, rhs_0, lhs_1, rhs_1, ...) and element i of the result tuple is
+// lhs_i x rhs_i. All GEMMs share N, K and the element type.
+inline constexpr absl::string_view kXetlaGroupedGemmCallTarget =
+    "__xetla$grouped_gemm";
+
+bool IsCustomCallToGroupedGemm(const HloInstruction& hlo);
+
+// Combines independent GEMMs of the same N and K that read the same tokens,
+// like the per-expert projections of a mixture-of-experts layer, into a
+// grouped GEMM:
+//
+//   gemm(x_0, w_0), ..., gemm(x_n, w_n) -> grouped-gemm(x_0, w_0, ..., w_n)
+//
+// Expert GEMMs are usually too small to fill the device one at a time, the
+// grouped kernel runs the tiles of all of them together. GEMMs are grouped if
+// their token operands are the same instruction or slices of the same
+// dispatched tensor, unrelated GEMMs of the same shape are left alone. Only
+// row-major F16 and BF16 GEMMs without an epilogue, batch dimensions or
+// scaling are grouped.
+class GroupedGemmRewriter : public HloModulePass {
+ public:
+  GroupedGemmRewriter() = default;
+
+  absl::string_view name() const override { return "grouped-gemm-rewriter"; }
+  StatusOr<bool> Run(
+      HloModule* module,
+      const absl::flat_hash_set<absl::string_view>& execution_threads) override;
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_GPU_GROUPED_GEMM_REWRITER_H_
@@ -0,0 +1,83 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/gpu/grouped_gemm_thunk.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <xetla.hpp>
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "xla/primitive_util.h"
+#include "xla/service/gpu/buffer_allocations.h"
+#include "xla/service/gpu/xetla/gemm/gemm.h"
+#include "xla/stream_executor/gpu/gpu_stream.h"
+
+namespace xla {
+namespace gpu {
+
+namespace {
+
+template <typename T>
+absl::Status RunGroupedGemm(
+    se::gpu::GpuStreamHandle handle, int64_t n, int64_t k,
+    absl::Span<const GroupedGemmThunk::Problem> problems,
+    const BufferAllocations& allocations) {
+  ::gpu::xetla::XetlaGroupedGemmKernel<T> kernel(n, k);
+  for (const GroupedGemmThunk::Problem& problem : problems) {
+    kernel.add_problem(allocations.GetDeviceAddress(problem.lhs).opaque(),
+                       allocations.GetDeviceAddress(problem.rhs).opaque(),
+                       allocations.GetDeviceAddress(problem.output).opaque(),
+                       problem.m);
+  }
+  kernel.build();
+  if (kernel.fallback() || !kernel.run(handle)) {
+    return absl::InternalError(
+        absl::StrCat("Unsupported grouped GEMM with N=", n, " and K=", k));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+GroupedGemmThunk::GroupedGemmThunk(ThunkInfo thunk_info, PrimitiveType type,
+                                   int64_t n, int64_t k,
+                                   std::vector<Problem> problems)
+    : Thunk(Kind::kGemm, thunk_info),
+      type_(type),
+      n_(n),
+      k_(k),
+      problems_(std::move(problems)) {}
+
+absl::Status GroupedGemmThunk::ExecuteOnStream(const ExecuteParams& params) {
+  se::gpu::GpuStreamHandle handle = se::gpu::AsGpuStreamValue(params.stream);
+  switch (type_) {
+    case F16:
+      return RunGroupedGemm<sycl::half>(handle, n_, k_, problems_,
+                                        *params.buffer_allocations);
+    case BF16:
+      return RunGroupedGemm<::gpu::xetla::bf16>(handle, n_, k_, problems_,
+                                                *params.buffer_allocations);
+    default:
+      return absl::InternalError(
+          absl::StrCat("Unsupported grouped GEMM type ",
+                       primitive_util::LowercasePrimitiveTypeName(type_)));
+  }
+}
+
+}  // namespace gpu
+}  // namespace xla
@@ -0,0 +1,56 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_GPU_GROUPED_GEMM_THUNK_H_
+#define XLA_SERVICE_GPU_GROUPED_GEMM_THUNK_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "xla/service/buffer_assignment.h"
+#include "xla/service/gpu/thunk.h"
+#include "xla/xla_data.pb.h"
+
+namespace xla {
+namespace gpu {
+
+// Thunk of the custom calls built by GroupedGemmRewriter, runs all GEMMs of
+// the group with a single XeTLA kernel.
+class GroupedGemmThunk : public Thunk {
+ public:
+  struct Problem {
+    BufferAllocation::Slice lhs;
+    BufferAllocation::Slice rhs;
+    BufferAllocation::Slice output;
+    int64_t m;
+  };
+
+  GroupedGemmThunk(ThunkInfo thunk_info, PrimitiveType type, int64_t n,
+                   int64_t k, std::vector<Problem> problems);
+
+  absl::Status ExecuteOnStream(const ExecuteParams& params) override;
+
+ private:
+  const PrimitiveType type_;
+  const int64_t n_;
+  const int64_t k_;
+  const std::vector<Problem> problems_;
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_GPU_GROUPED_GEMM_THUNK_H_
@@ -15,9 +15,14 @@ limitations under the License.
 
 #include "xla/service/gpu/onednn_gpu_conv_runner.h"
 
+#include <atomic>
+#include <memory>
 #include <string>
+#include <utility>
 
+#include "absl/strings/str_cat.h"
 #include "xla/service/gpu/scratch_allocator.h"
+#include "xla/service/onednn_primitive_cache.h"
 #include "xla/service/gpu/stream_executor_util.h"
 #include "xla/stream_executor/gpu/gpu_stream.h"
 
@@ -64,6 +69,18 @@ int64_t GetVectCSize(FilterLayout layout) {
   }
 }
 
+// ONEDNN_PLAIN_WEIGHT keeps filters in their plain layout instead of the
+// layout oneDNN prefers, which saves the reorder at the cost of a slower
+// convolution. Read once, it is part of every primitive cache key.
+bool UsePlainWeight() {
+  static const bool plain_weight = [] {
+    bool flag = false;
+    TF_CHECK_OK(tsl::ReadBoolFromEnvVar("ONEDNN_PLAIN_WEIGHT", false, &flag));
+    return flag;
+  }();
+  return plain_weight;
+}
+
 absl::Status CreateOneDnnPrimitive(
     OneDnnConvPrimitive* onednn_primitive,  // NOLINT
     const GpuConvDescriptor& conv_descriptor,
@@ -425,11 +442,9 @@ absl::Status CreateOneDnnPrimitive(
     dnnl::memory::desc dst_md =
         dnnl::memory::desc({dst_dims}, data_type, dst_fmt);
 
-    bool flag = false;
-    tsl::ReadBoolFromEnvVar("ONEDNN_PLAIN_WEIGHT", false, &flag);
     dnnl::memory::desc filter_md_prefer = dnnl::memory::desc(
         {filter_dims}, data_type, dnnl::memory::format_tag::any);
-    if (flag)
+    if (UsePlainWeight())
       filter_md_prefer =
           dnnl::memory::desc({filter_dims}, data_type, weight_fmt);
 
@@ -450,12 +465,29 @@ absl::Status CreateOneDnnPrimitive(
     //   po.append_sum(beta)
     //   po.append_binary(1, bias);
     //   po.append_eltwise(dnnl::algorithm::activation, 1, 0);
+    //
+    // The sum post-op adds what the output buffer holds, which is the side
+    // input when it aliases the output (see CudnnFusedConvRewriter). Otherwise
+    // an unscaled side input is added with a binary post-op, and a scaled one
+    // is copied into the output before the convolution.
     dnnl::post_ops po;
     dnnl::primitive_attr post_ops_attr;
     if (!conv_result_scale_one)
       po.append_eltwise(dnnl::algorithm::eltwise_linear, conv_result_scale, 0);
-    if (side_input_data && !side_input_scale_zero)
-      po.append_sum(side_input_scale);
+    if (side_input_data && !side_input_scale_zero) {
+      bool side_input_scale_one = (fabs(side_input_scale - 1.0f) < 1e-6);
+      if (side_input_data != output_data && side_input_scale_one) {
+        po.append_binary(dnnl::algorithm::binary_add, dst_md);
+        onednn_primitive->side_input_memory = dnnl::sycl_interop::make_memory(
+            dst_md, onednn_primitive->engine, kind, side_input_data);
+        onednn_primitive->fwd_primitives_args.insert(
+            {DNNL_ARG_ATTR_MULTIPLE_POST_OP(po.len() - 1) | DNNL_ARG_SRC_1,
+             onednn_primitive->side_input_memory});
+      } else {
+        po.append_sum(side_input_scale);
+        onednn_primitive->copy_side_input = side_input_data != output_data;
+      }
+    }
     if (!conv_result_scale_one && bias_data) {
       auto bias_post_md =
           dnnl::memory::desc(bias_dims, data_type, dnnl::memory::format_tag::x);
@@ -688,6 +720,158 @@ absl::Status CreateOneDnnPrimitive(
   }
   return absl::OkStatus();
 }  // NOLINT
+
+OneDnnPrimitiveCache<OneDnnConvPrimitive>& ConvPrimitiveCache() {
+  static auto* cache = new OneDnnPrimitiveCache<OneDnnConvPrimitive>(
+      GetOneDnnPrimitiveCacheCapacity("XLA_ONEDNN_CONV_CACHE_CAPACITY",
+                                      /*default_capacity=*/1024));
+  return *cache;
+}
+
+// Filter reordered into the layout preferred by a forward convolution. The
+// buffer is owned by the cache entry, unlike the per-execution scratch memory
+// used when the reordered filter is not cached.
+struct OneDnnReorderedWeights {
+  OneDnnReorderedWeights(sycl::queue* queue, size_t size)
+      : queue(*queue), data(sycl::aligned_alloc_device(64, size, *queue)) {}
+  ~OneDnnReorderedWeights() {
+    if (data == nullptr) return;
+    // Convolutions using the weights only run on `queue`, which is in order,
+    // and may still be pending: free the buffer once the queue reaches here.
+    void* ptr = data;
+    sycl::context context = queue.get_context();
+    queue.submit([&](sycl::handler& cgh) {
+      cgh.host_task([ptr, context]() { sycl::free(ptr, context); });
+    });
+  }
+
+  sycl::queue queue;
+  void* data;
+  dnnl::memory memory;
+};
+
+OneDnnPrimitiveCache<OneDnnReorderedWeights>& ReorderedWeightsCache() {
+  static auto* cache = new OneDnnPrimitiveCache<OneDnnReorderedWeights>(
+      GetOneDnnPrimitiveCacheCapacity("XLA_ONEDNN_CONV_WEIGHTS_CACHE_CAPACITY",
+                                      /*default_capacity=*/0));
+  return *cache;
+}
+
+std::atomic<int64_t> reordered_weights_generation{0};
+
+// Primitives are cached per engine, and engines are created per stream (see
+// FindOrCreateEngine), so the stream is part of the key.
+std::string ConvPrimitiveKey(sycl::queue* stream,
+                             const GpuConvDescriptor& descriptor,
+                             size_t num_operands, bool side_input_in_place) {
+  return absl::StrCat(
+      absl::Hex(reinterpret_cast<uintptr_t>(stream)), "|",
+      static_cast<int>(descriptor.kind), "|",
+      ShapeUtil::HumanStringWithLayout(descriptor.operand0_shape), "|",
+      ShapeUtil::HumanStringWithLayout(descriptor.operand1_shape), "|",
+      ShapeUtil::HumanStringWithLayout(descriptor.result_shape), "|",
+      descriptor.window.ShortDebugString(), "|",
+      descriptor.dnums.ShortDebugString(), "|",
+      descriptor.backend_config.ShortDebugString(), "|", num_operands, "|",
+      side_input_in_place, "|", UsePlainWeight(), "|",
+      static_cast<int>(GetFP32MathMode()));
+}
+
+// Cached primitives are shared between executions, give `primitive` its own
+// memory objects so that binding data handles in RunGpuConv doesn't race with
+// other users of the cache entry. Scratch memory comes from the per-execution
+// scratch allocator and is allocated again.
+absl::Status RebindOneDnnConvPrimitive(OneDnnConvPrimitive* primitive,
+                                       se::ScratchAllocator* scratch_allocator) {
+  std::vector<std::pair<dnnl_memory_t, dnnl::memory>> remap;
+  auto rebind = [&](dnnl::memory& memory, void* data) {
+    if (!memory) return;
+    dnnl::memory rebound = dnnl::sycl_interop::make_memory(
+        memory.get_desc(), primitive->engine,
+        dnnl::sycl_interop::memory_kind::usm, data);
+    remap.emplace_back(memory.get(), rebound);
+    memory = rebound;
+  };
+
+  void* workspace;
+  TF_RETURN_IF_ERROR(AllocateWorkspace(
+      &workspace, scratch_allocator,
+      primitive->scratchpad_memory.get_desc().get_size()));
+  rebind(primitive->scratchpad_memory, workspace);
+  if (primitive->has_reorder) {
+    void* reorder_filter;
+    TF_RETURN_IF_ERROR(AllocateWorkspace(
+        &reorder_filter, scratch_allocator,
+        primitive->internal_filter_memory.get_desc().get_size()));
+    rebind(primitive->internal_filter_memory, reorder_filter);
+  }
+  // Operand handles are bound by RunGpuConv.
+  rebind(primitive->src_memory, DNNL_MEMORY_NONE);
+  rebind(primitive->filter_memory, DNNL_MEMORY_NONE);
+  rebind(primitive->dst_memory, DNNL_MEMORY_NONE);
+  rebind(primitive->bias_memory, DNNL_MEMORY_NONE);
+  rebind(primitive->side_input_memory, DNNL_MEMORY_NONE);
+
+  for (auto* args : {&primitive->fwd_primitives_args,
+                     &primitive->bwd_input_primitive_args,
+                     &primitive->bwd_filter_primitive_args,
+                     &primitive->reorder_args}) {
+    for (auto& [arg, memory] : *args) {
+      for (const auto& [old_memory, new_memory] : remap) {
+        if (memory.get() == old_memory) {
+          memory = new_memory;
+          break;
+        }
+      }
+    }
+  }
+  return absl::OkStatus();
+}
+
+// Replaces the per-execution filter reorder of a forward convolution with a
+// filter reordered once and kept in the cache. Only used when the reordered
+// weights cache is enabled, because the cache can't tell if a filter buffer
+// was overwritten: it relies on the filter address and on the generation
+// bumped by InvalidateOneDnnConvWeightsCache.
+void UseCachedReorderedWeights(OneDnnConvPrimitive* primitive,
+                               const std::string& primitive_key,
+                               const GpuConvDescriptor& descriptor,
+                               sycl::queue* stream, void* filter_data) {
+  if (!primitive->has_reorder ||
+      (descriptor.kind != CudnnConvKind::kForward &&
+       descriptor.kind != CudnnConvKind::kForwardActivation) ||
+      ReorderedWeightsCache().capacity() == 0) {
+    return;
+  }
+
+  std::string key = absl::StrCat(
+      primitive_key, "|", absl::Hex(reinterpret_cast<uintptr_t>(filter_data)),
+      "|", reordered_weights_generation.load());
+  std::shared_ptr<OneDnnReorderedWeights> weights =
+      ReorderedWeightsCache().Find(key);
+  bool reorder_now = false;
+  if (weights == nullptr) {
+    auto desc = primitive->internal_filter_memory.get_desc();
+    weights = std::make_shared<OneDnnReorderedWeights>(stream, desc.get_size());
+    if (weights->data == nullptr) return;
+    weights->memory = CreateDnnlMemory(desc, primitive->engine, weights->data);
+    weights = ReorderedWeightsCache().Insert(key, std::move(weights));
+    reorder_now = true;
+  }
+
+  dnnl_memory_t old_memory = primitive->internal_filter_memory.get();
+  primitive->internal_filter_memory = weights->memory;
+  primitive->cached_weights = weights;
+  for (auto* args : {&primitive->fwd_primitives_args, &primitive->reorder_args}) {
+    for (auto& [arg, memory] : *args) {
+      if (memory.get() == old_memory) memory = weights->memory;
+    }
+  }
+  // The reorder into the cached buffer runs once, on the stream that created
+  // it. Later executions on this stream are ordered after it.
+  primitive->has_reorder = reorder_now;
+}
+
 }  // namespace
 
 absl::StatusOr<OneDnnConvPrimitive> GetOrCreateOneDnnConvPrimitive(
@@ -696,16 +880,53 @@ absl::StatusOr<OneDnnConvPrimitive> GetOrCreateOneDnnConvPrimitive(
     const se::DeviceMemoryBase& result_buffer,
     const Thunk::ExecuteParams& params,
     se::ScratchAllocator* scratch_allocator) {
+  sycl::queue* dpcpp_stream = se::gpu::AsGpuStreamValue(stream);
+  bool side_input_in_place =
+      descriptor.kind == CudnnConvKind::kForwardActivation &&
+      operand_se_buffers.size() >= 4 &&
+      operand_se_buffers[3].opaque() == result_buffer.opaque();
+  std::string key = ConvPrimitiveKey(dpcpp_stream, descriptor,
+                                     operand_se_buffers.size(),
+                                     side_input_in_place);
+
   OneDnnConvPrimitive primitive;
-  auto status = CreateOneDnnPrimitive(&primitive, descriptor,
-                                      absl::MakeSpan(operand_se_buffers),
-                                      result_buffer, params, scratch_allocator);
-  if (TF_PREDICT_FALSE(!status.ok())) {
-    return status;
+  if (auto cached = ConvPrimitiveCache().Find(key)) {
+    primitive = *cached;
+    TF_RETURN_IF_ERROR(RebindOneDnnConvPrimitive(&primitive, scratch_allocator));
+  } else {
+    auto status = CreateOneDnnPrimitive(&primitive, descriptor,
+                                        absl::MakeSpan(operand_se_buffers),
+                                        result_buffer, params,
+                                        scratch_allocator);
+    if (TF_PREDICT_FALSE(!status.ok())) {
+      return status;
+    }
+    ConvPrimitiveCache().Insert(
+        key, std::make_shared<OneDnnConvPrimitive>(primitive));
   }
+
+  void* filter_data =
+      descriptor.kind == CudnnConvKind::kBackwardFilter
+          ? const_cast<void*>(result_buffer.opaque())
+          : const_cast<void*>(operand_se_buffers[1].opaque());
+  UseCachedReorderedWeights(&primitive, key, descriptor, dpcpp_stream,
+                            filter_data);
   return primitive;
 }
 
+OneDnnPrimitiveCacheStats GetOneDnnConvPrimitiveCacheStats() {
+  return ConvPrimitiveCache().stats();
+}
+
+OneDnnPrimitiveCacheStats GetOneDnnConvWeightsCacheStats() {
+  return ReorderedWeightsCache().stats();
+}
+
+void InvalidateOneDnnConvWeightsCache() {
+  reordered_weights_generation.fetch_add(1);
+  ReorderedWeightsCache().Clear();
+}
+
 absl::Status RunGpuConv(const OneDnnConvPrimitive& onednn_primitive,
                   const GpuConvDescriptor& conv_descriptor,
                   absl::Span<const se::DeviceMemoryBase> operand_buffers,
@@ -751,9 +972,17 @@ absl::Status RunGpuConv(const OneDnnConvPrimitive& onednn_primitive,
   if (bias_data != nullptr) {
     onednn_primitive.bias_memory.set_data_handle(bias_data);
   }
+  if (onednn_primitive.side_input_memory) {
+    onednn_primitive.side_input_memory.set_data_handle(side_input_data);
+  }
   try {
     if (conv_descriptor.kind == CudnnConvKind::kForward ||
         conv_descriptor.kind == CudnnConvKind::kForwardActivation) {
+      if (onednn_primitive.copy_side_input) {
+        dnnl::sycl_interop::get_queue(onednn_primitive.stream)
+            .memcpy(output_data, side_input_data,
+                    onednn_primitive.dst_memory.get_desc().get_size());
+      }
       if (onednn_primitive.has_reorder) {
         onednn_primitive.filter_reorder_primitive.execute(
             onednn_primitive.stream, onednn_primitive.reorder_args);
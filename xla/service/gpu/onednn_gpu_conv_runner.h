@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef XLA_SERVICE_GPU_ONEDNN_GPU_CONV_RUNNER_H_
 #define XLA_SERVICE_GPU_ONEDNN_GPU_CONV_RUNNER_H_
 
+#include <memory>
 #include <optional>
 
 #include "xla/hlo/ir/hlo_instruction.h"
@@ -24,6 +25,7 @@ limitations under the License.
 #include "xla/service/gpu/cublas_cudnn.h"
 #include "xla/service/gpu/gpu_conv_runner.h"
 #include "xla/service/gpu/thunk.h"
+#include "xla/service/onednn_primitive_cache.h"
 #include "xla/service/onednn_util.h"
 #include "xla/status.h"
 #include "xla/statusor.h"
@@ -42,6 +44,8 @@ typedef struct OneDnnConvPrimitive {
   dnnl::memory internal_filter_memory;
   dnnl::memory scratchpad_memory;
   dnnl::memory bias_memory;
+  // Side input of a fused convolution that doesn't alias the output.
+  dnnl::memory side_input_memory;
   dnnl::convolution_forward fwd_primitive;
   dnnl::convolution_backward_data bwd_input_primitive;
   dnnl::convolution_backward_weights bwd_filter_primitive;
@@ -55,7 +59,12 @@ typedef struct OneDnnConvPrimitive {
 
   dnnl::engine engine;
   dnnl::stream stream;
+  // Cached reordered filter `internal_filter_memory` points to, kept alive
+  // until the convolution is submitted even if the cache evicts it.
+  std::shared_ptr<const void> cached_weights;
   bool has_reorder = false;
+  // The sum post-op needs the side input in the output buffer.
+  bool copy_side_input = false;
 } OneDnnConvPrimitive;
 
 absl::StatusOr<OneDnnConvPrimitive> GetOrCreateOneDnnConvPrimitive(
@@ -71,6 +80,17 @@ absl::Status RunGpuConv(const OneDnnConvPrimitive& onednn_primitive,
                   se::DeviceMemoryBase result_buffer,
                   const Thunk::ExecuteParams& params);
 
+// Primitives returned by GetOrCreateOneDnnConvPrimitive are cached by
+// descriptor and stream (capacity: XLA_ONEDNN_CONV_CACHE_CAPACITY).
+OneDnnPrimitiveCacheStats GetOneDnnConvPrimitiveCacheStats();
+
+// Forward convolution filters reordered into the oneDNN preferred layout are
+// cached by filter address when XLA_ONEDNN_CONV_WEIGHTS_CACHE_CAPACITY > 0.
+// This is only valid for weights that don't change between executions, call
+// InvalidateOneDnnConvWeightsCache after overwriting filter buffers.
+OneDnnPrimitiveCacheStats GetOneDnnConvWeightsCacheStats();
+void InvalidateOneDnnConvWeightsCache();
+
 }  // namespace gpu
 }  // namespace xla
 
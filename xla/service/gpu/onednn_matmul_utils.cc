@@ -19,7 +19,9 @@ limitations under the License.
 
 #include <algorithm>
 #include <cstdint>
+#include <memory>
 #include <optional>
+#include <string>
 #include <tuple>
 #include <type_traits>
 #include <utility>
@@ -27,6 +29,10 @@ limitations under the License.
 #include <xetla.hpp>
 
 #include "absl/algorithm/container.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/types/span.h"
 #include "dnnl.hpp"       // NOLINT(build/include_subdir)
 #include "dnnl_sycl.hpp"  // NOLINT(build/include_subdir)
@@ -39,6 +45,7 @@ limitations under the License.
 #include "xla/mlir_hlo/lhlo_gpu/IR/lhlo_gpu_ops.h"
 #include "xla/service/gpu/matrix_descriptor.h"
 #include "xla/service/gpu/xetla/gemm/gemm.h"
+#include "xla/service/onednn_primitive_cache.h"
 #include "xla/service/onednn_util.h"
 #include "xla/shape.h"
 #include "xla/shape_util.h"
@@ -160,6 +167,8 @@ struct OneDnnMatMulParams {
         bias_strides(std::move(bias_strides)) {}
 };
 
+// Runs alpha * lhs x rhs + beta * c followed by the epilogue in one XeTLA
+// kernel, returns true if the GEMM has to fall back to oneDNN.
 template <typename InputT>
 std::enable_if_t<std::is_same_v<InputT, ::gpu::xetla::bf16> ||
                      std::is_same_v<InputT, sycl::half>,
@@ -167,94 +176,60 @@ std::enable_if_t<std::is_same_v<InputT, ::gpu::xetla::bf16> ||
 RunXetlaGemm(se::gpu::GpuStreamHandle handle, const MatrixDescriptor& lhs,
              const MatrixDescriptor& rhs, const MatrixDescriptor& c,
              const MatrixDescriptor& out, se::DeviceMemoryBase bias,
-             se::gpu::BlasLt::Epilogue epilogue, float beta) {
+             se::gpu::BlasLt::Epilogue epilogue, float alpha, float beta,
+             int64_t batch_size,
+             std::optional<std::tuple<int, int, int, int, int, int>> policy) {
+  using Kernel = ::gpu::xetla::XetlaGemmKernel<InputT>;
   void* bias_data = const_cast<void*>(bias.opaque());
   void* c_data = const_cast<void*>(c.data.opaque());
+  bool has_bias = false;
+  std::optional<typename Kernel::EpilogueType> activation;
   switch (epilogue) {
-    case se::gpu::BlasLt::Epilogue::kDefault: {
-      auto policy = ::gpu::xetla::XetlaGemmKernel<InputT>()
-                        .add_matrix_c(out)
-                        .add_matrix_a(lhs)
-                        .add_matrix_b(rhs)
-                        .build();
-      if (fabs(beta) - 0.0f > 1e-6) {
-        if (fabs(beta) - 1.0f < 1e-6) {
-          policy
-              .add_epilogue(
-                  c_data,
-                  ::gpu::xetla::XetlaGemmKernel<InputT>::EpilogueType::RES_ADD)
-              .build();
-        } else {
-          return true;
-        }
-      }
-      if (policy.fallback() == false) {
-        return !policy.run(handle);
-      }
-      return policy.fallback();
-    }
-    case se::gpu::BlasLt::Epilogue::kBias: {
-      auto policy =
-          ::gpu::xetla::XetlaGemmKernel<InputT>()
-              .add_matrix_c(out)
-              .add_matrix_a(lhs)
-              .add_matrix_b(rhs)
-              .add_epilogue(
-                  bias_data,
-                  ::gpu::xetla::XetlaGemmKernel<InputT>::EpilogueType::BIAS)
-              .build();
-      if (fabs(beta) - 0.0f > 1e-6) {
-        policy
-            .add_epilogue(
-                c_data,
-                ::gpu::xetla::XetlaGemmKernel<InputT>::EpilogueType::RES_ADD,
-                beta)
-            .build();
-      }
-      if (policy.fallback() == false) {
-        return !policy.run(handle);
-      }
-      return policy.fallback();
-    }
-    case se::gpu::BlasLt::Epilogue::kGELU: {
-      auto policy =
-          ::gpu::xetla::XetlaGemmKernel<InputT>()
-              .add_matrix_c(out)
-              .add_matrix_a(lhs)
-              .add_matrix_b(rhs)
-              .add_epilogue(
-                  nullptr,
-                  ::gpu::xetla::XetlaGemmKernel<InputT>::EpilogueType::GELU)
-              .build();
-      if (policy.fallback() == false) {
-        return !policy.run(handle);
-      }
-      return policy.fallback();
-    }
-    case se::gpu::BlasLt::Epilogue::kBiasThenGELU: {
-      auto policy =
-          ::gpu::xetla::XetlaGemmKernel<InputT>()
-              .add_matrix_c(out)
-              .add_matrix_a(lhs)
-              .add_matrix_b(rhs)
-              .add_epilogue(
-                  bias_data,
-                  ::gpu::xetla::XetlaGemmKernel<InputT>::EpilogueType::BIAS)
-              .add_epilogue(
-                  nullptr,
-                  ::gpu::xetla::XetlaGemmKernel<InputT>::EpilogueType::GELU)
-              .build();
-      if (policy.fallback() == false) {
-        return !policy.run(handle);
-      }
-      return policy.fallback();
-    }
+    case se::gpu::BlasLt::Epilogue::kDefault:
+      break;
+    case se::gpu::BlasLt::Epilogue::kBias:
+      has_bias = true;
+      break;
+    case se::gpu::BlasLt::Epilogue::kGELU:
+      activation = Kernel::EpilogueType::GELU;
+      break;
+    case se::gpu::BlasLt::Epilogue::kBiasThenGELU:
+      has_bias = true;
+      activation = Kernel::EpilogueType::GELU;
+      break;
     case se::gpu::BlasLt::Epilogue::kReLU:
+      activation = Kernel::EpilogueType::RELU;
+      break;
     case se::gpu::BlasLt::Epilogue::kBiasThenReLU:
-      return true;
+      has_bias = true;
+      activation = Kernel::EpilogueType::RELU;
+      break;
     default:
       return Internal("Unsupported Activation mode");
   }
+
+  // The activation applies to the sum of the product, the bias and beta * c.
+  Kernel kernel;
+  kernel.add_matrix_c(out)
+      .add_matrix_a(lhs)
+      .add_matrix_b(rhs)
+      .add_alpha(alpha)
+      .add_batch_size(batch_size)
+      .add_policy(policy);
+  if (has_bias) {
+    kernel.add_epilogue(bias_data, Kernel::EpilogueType::BIAS);
+  }
+  if (fabs(beta) > 1e-6) {
+    kernel.add_epilogue(c_data, Kernel::EpilogueType::RES_ADD, beta);
+  }
+  if (activation.has_value()) {
+    kernel.add_epilogue(nullptr, *activation);
+  }
+  kernel.build();
+  if (kernel.fallback() == false) {
+    return !kernel.run(handle);
+  }
+  return kernel.fallback();
 }
 
 template <typename InputT>
@@ -264,7 +239,9 @@ std::enable_if_t<!std::is_same_v<InputT, ::gpu::xetla::bf16> &&
 RunXetlaGemm(se::gpu::GpuStreamHandle handle, const MatrixDescriptor& lhs,
              const MatrixDescriptor& rhs, const MatrixDescriptor& c,
              const MatrixDescriptor& out, se::DeviceMemoryBase bias,
-             se::gpu::BlasLt::Epilogue epilogue, float beta) {
+             se::gpu::BlasLt::Epilogue epilogue, float alpha, float beta,
+             int64_t batch_size,
+             std::optional<std::tuple<int, int, int, int, int, int>> policy) {
   return Internal("Unsupported Datatype in XeTLA");
 }
 
@@ -307,6 +284,89 @@ std::unique_ptr<OneDnnMatMulParams> CreateMatMulParams(
       out_strides, bias_strides);
 }
 
+}  // namespace
+
+// oneDNN matmul primitive with the memory objects bound to its arguments.
+// `mu` serializes executions that rebind the data handles.
+struct OneDnnMatMulPrimitive {
+  absl::Mutex mu;
+  dnnl::matmul primitive;
+  dnnl::stream stream;
+  dnnl::memory src_memory;
+  dnnl::memory weights_memory;
+  dnnl::memory dst_memory;
+  dnnl::memory bias_memory;
+  dnnl::memory scales_memory;
+  dnnl::memory scratchpad_memory;
+  size_t scratchpad_size = 0;
+  std::unordered_map<int, dnnl::memory> args;
+};
+
+namespace {
+
+// Primitive remembered by a GemmPlan between executions on one stream.
+using PrimitiveSlot = std::shared_ptr<OneDnnMatMulPrimitive>;
+
+OneDnnPrimitiveCache<OneDnnMatMulPrimitive>& MatMulPrimitiveCache() {
+  static auto* cache = new OneDnnPrimitiveCache<OneDnnMatMulPrimitive>(
+      GetOneDnnPrimitiveCacheCapacity("XLA_ONEDNN_MATMUL_CACHE_CAPACITY",
+                                      /*default_capacity=*/1024));
+  return *cache;
+}
+
+// FP8 matmul primitive, with the reorders converting the operands to F16
+// before the matmul if the FP8 operands are upcast.
+struct OneDnnFp8MatMulPrimitive {
+  absl::Mutex mu;
+  dnnl::matmul primitive;
+  dnnl::stream stream;
+  std::optional<dnnl::reorder> a_reorder;
+  std::optional<dnnl::reorder> b_reorder;
+  dnnl::memory a_memory;
+  dnnl::memory b_memory;
+  dnnl::memory a_upcast_memory;
+  dnnl::memory b_upcast_memory;
+  dnnl::memory a_scale_memory;
+  dnnl::memory b_scale_memory;
+  dnnl::memory dst_memory;
+  dnnl::memory scratchpad_memory;
+  // Offsets of the upcast operands and of the scratchpad in the workspace.
+  size_t b_upcast_offset = 0;
+  size_t scratchpad_offset = 0;
+  size_t workspace_size = 0;
+  std::unordered_map<int, dnnl::memory> args;
+};
+
+OneDnnPrimitiveCache<OneDnnFp8MatMulPrimitive>& Fp8MatMulPrimitiveCache() {
+  static auto* cache = new OneDnnPrimitiveCache<OneDnnFp8MatMulPrimitive>(
+      GetOneDnnPrimitiveCacheCapacity("XLA_ONEDNN_MATMUL_CACHE_CAPACITY",
+                                      /*default_capacity=*/1024));
+  return *cache;
+}
+
+// Primitives are cached per engine, and engines are created per stream (see
+// FindOrCreateEngine), so the stream is part of the key.
+std::string MatMulPrimitiveKey(se::gpu::GpuStreamHandle stream,
+                               const OneDnnMatMulParams& params,
+                               dnnl::memory::data_type input_type,
+                               dnnl::memory::data_type output_type,
+                               bool has_bias, float sum_scale,
+                               se::gpu::BlasLt::Epilogue epilogue,
+                               dnnl::fpmath_mode fpmath_mode) {
+  return absl::StrCat(
+      absl::Hex(reinterpret_cast<uintptr_t>(stream)), "|",
+      absl::StrJoin(params.a_dims, ","), ";",
+      absl::StrJoin(params.a_strides, ","), "|",
+      absl::StrJoin(params.b_dims, ","), ";",
+      absl::StrJoin(params.b_strides, ","), "|",
+      absl::StrJoin(params.c_dims, ","), ";",
+      absl::StrJoin(params.c_strides, ","), "|",
+      has_bias ? absl::StrJoin(params.bias_dims, ",") : "nobias", "|",
+      static_cast<int>(input_type), ",", static_cast<int>(output_type), "|",
+      sum_scale, "|", static_cast<int>(epilogue), "|",
+      static_cast<int>(fpmath_mode));
+}
+
 template <typename InputT>
 absl::Status DoXetlaGemm(int64_t batch_size, int64_t m, int64_t n, int64_t k,
                          const MatrixDescriptor& lhs,
@@ -314,7 +374,8 @@ absl::Status DoXetlaGemm(int64_t batch_size, int64_t m, int64_t n, int64_t k,
                          const MatrixDescriptor& output,
                          se::DeviceMemoryBase bias, float alpha, float beta,
                          se::gpu::BlasLt::Epilogue epilogue, se::Stream* stream,
-                         std::optional<se::blas::AlgorithmType> algorithm,
+                         std::optional<std::tuple<int, int, int, int, int, int>>
+                             policy,
                          se::ScratchAllocator* scratch_allocator,
                          se::blas::ComputePrecision compute_precision) {
   CHECK(output.transpose == se::blas::Transpose::kNoTranspose);
@@ -322,7 +383,8 @@ absl::Status DoXetlaGemm(int64_t batch_size, int64_t m, int64_t n, int64_t k,
       stream_executor::gpu::AsGpuStreamValue(stream);
   TF_ASSIGN_OR_RETURN(bool fallback,
                       RunXetlaGemm<InputT>(stream_handle, lhs, rhs, c, output,
-                                           bias, epilogue, beta));
+                                           bias, epilogue, alpha, beta,
+                                           batch_size, policy));
   if (!fallback) return OkStatus();
   VLOG(2) << "lhs: " << batch_size << " " << lhs.num_rows << " "
           << lhs.num_cols;
@@ -344,7 +406,8 @@ absl::Status DoOnednnGemm(int64_t batch_size, int64_t m, int64_t n, int64_t k,
                           se::Stream* stream,
                           std::optional<se::blas::AlgorithmType> algorithm,
                           se::ScratchAllocator* scratch_allocator,
-                          se::blas::ComputePrecision compute_precision) {
+                          se::blas::ComputePrecision compute_precision,
+                          PrimitiveSlot* slot) {
   CHECK(output.transpose == se::blas::Transpose::kNoTranspose);
   se::gpu::GpuStreamHandle stream_handle =
       stream_executor::gpu::AsGpuStreamValue(stream);
@@ -371,83 +434,122 @@ absl::Status DoOnednnGemm(int64_t batch_size, int64_t m, int64_t n, int64_t k,
 
   auto params = CreateMatMulParams(batch_size, lhs, rhs, output);
 
-  auto src_md = dnnl::memory::desc(params->a_dims, OneDnnType<InputT>(),
-                                   params->a_strides);
-  auto weights_md = dnnl::memory::desc(params->b_dims, OneDnnType<InputT>(),
-                                       params->b_strides);
-  auto dst_md = dnnl::memory::desc(params->c_dims, OneDnnType<OutputT>(),
-                                   params->c_strides);
-  auto bias_md =
-      bias_data ? dnnl::memory::desc(params->bias_dims, OneDnnType<InputT>(),
-                                     params->bias_strides)
-                : dnnl::memory::desc();
-
-  auto dnnl_engine = FindOrCreateEngine(stream_handle);
-  dnnl::primitive_attr post_ops_attr;
-  post_ops_attr.set_scratchpad_mode(dnnl::scratchpad_mode::user);
-
-  // Set fp32 mode.
-  dnnl::fpmath_mode fp32_math_mode = GetFP32MathMode();
-  if (std::is_same<InputT, float>::value) {
-    post_ops_attr.set_fpmath_mode(fp32_math_mode);
-  }
-
-  dnnl::post_ops post_ops = dnnl::post_ops();
+  bool has_bias = bias_data != nullptr;
   // C = activation(MatMul(x, w, bias) + beta * C)
   //   po.append_sum(beta)
   //   po.append_eltwise(dnnl::algorithm::activation, 1, 0);
   CHECK(fabs(alpha - 1.0f) < 1e-6);
-  if (c_data && fabs(beta - 0.0f) > 1e-6) post_ops.append_sum(beta);
+  bool has_sum = c_data && fabs(beta - 0.0f) > 1e-6;
   switch (epilogue) {
     case se::gpu::BlasLt::Epilogue::kReLU:
     case se::gpu::BlasLt::Epilogue::kBiasThenReLU:
-      post_ops.append_eltwise(dnnl::algorithm::eltwise_relu, 0, 0);
-      break;
     case se::gpu::BlasLt::Epilogue::kGELU:
     case se::gpu::BlasLt::Epilogue::kBiasThenGELU:
-      post_ops.append_eltwise(dnnl::algorithm::eltwise_gelu_tanh, 0, 0);
-      break;
     case se::gpu::BlasLt::Epilogue::kDefault:
     case se::gpu::BlasLt::Epilogue::kBias:
       break;
     default:
       return Internal("Unsupported Activation mode");
   }
-  post_ops_attr.set_post_ops(post_ops);
+  dnnl::fpmath_mode fp32_math_mode = std::is_same<InputT, float>::value
+                                         ? GetFP32MathMode()
+                                         : dnnl::fpmath_mode::strict;
 
-  auto matmul_pd =
-      bias_data
-          ? std::make_shared<dnnl::matmul::primitive_desc>(
-                dnnl_engine, src_md, weights_md, bias_md, dst_md, post_ops_attr)
-          : std::make_shared<dnnl::matmul::primitive_desc>(
-                dnnl_engine, src_md, weights_md, dst_md, post_ops_attr);
-  std::unordered_map<int, dnnl::memory> fwd_primitive_args;
+  // A primitive already found for this plan skips building the key.
+  std::shared_ptr<OneDnnMatMulPrimitive> primitive =
+      slot != nullptr ? *slot : nullptr;
+  std::string key;
+  if (primitive == nullptr) {
+    key = MatMulPrimitiveKey(stream_handle, *params, OneDnnType<InputT>(),
+                             OneDnnType<OutputT>(), has_bias,
+                             has_sum ? beta : 0.0f, epilogue, fp32_math_mode);
+    primitive = MatMulPrimitiveCache().Find(key);
+  }
+  if (primitive == nullptr) {
+    VLOG(2) << "Create oneDNN matmul primitive: " << key;
+    auto src_md = dnnl::memory::desc(params->a_dims, OneDnnType<InputT>(),
+                                     params->a_strides);
+    auto weights_md = dnnl::memory::desc(params->b_dims, OneDnnType<InputT>(),
+                                         params->b_strides);
+    auto dst_md = dnnl::memory::desc(params->c_dims, OneDnnType<OutputT>(),
+                                     params->c_strides);
+    auto bias_md =
+        has_bias ? dnnl::memory::desc(params->bias_dims, OneDnnType<InputT>(),
+                                      params->bias_strides)
+                 : dnnl::memory::desc();
 
-  size_t scratchpad_size = matmul_pd->scratchpad_desc().get_size();
-  void* workspace;
-  TF_RETURN_IF_ERROR(
-      AllocateWorkspace(&workspace, scratch_allocator, scratchpad_size));
-
-  auto scratchpad_mem =
-      dnnl::memory(matmul_pd->scratchpad_desc(), dnnl_engine, workspace);
-
-  auto matmul_primitive = dnnl::matmul(*matmul_pd);
-
-  auto dnnl_stream = dnnl::sycl_interop::make_stream(
-      dnnl_engine, *(stream_executor::gpu::AsGpuStreamValue(stream)));
-  auto src_mem = CreateDnnlMemory(src_md, dnnl_engine, lhs_data);
-
-  auto wei_mem = CreateDnnlMemory(weights_md, dnnl_engine, rhs_data);
-  auto dst_mem = CreateDnnlMemory(dst_md, dnnl_engine, out_data);
-  fwd_primitive_args.emplace(DNNL_ARG_SRC, src_mem);
-  fwd_primitive_args.emplace(DNNL_ARG_WEIGHTS, wei_mem);
-  fwd_primitive_args.emplace(DNNL_ARG_DST, dst_mem);
-  fwd_primitive_args.emplace(DNNL_ARG_SCRATCHPAD, scratchpad_mem);
-  if (bias_data) {
-    auto bias_mem = CreateDnnlMemory(bias_md, dnnl_engine, bias_data);
-    fwd_primitive_args.emplace(DNNL_ARG_BIAS, bias_mem);
+    auto& dnnl_engine = FindOrCreateEngine(stream_handle);
+    dnnl::primitive_attr post_ops_attr;
+    post_ops_attr.set_scratchpad_mode(dnnl::scratchpad_mode::user);
+
+    // Set fp32 mode.
+    if (std::is_same<InputT, float>::value) {
+      post_ops_attr.set_fpmath_mode(fp32_math_mode);
+    }
+
+    dnnl::post_ops post_ops = dnnl::post_ops();
+    if (has_sum) post_ops.append_sum(beta);
+    switch (epilogue) {
+      case se::gpu::BlasLt::Epilogue::kReLU:
+      case se::gpu::BlasLt::Epilogue::kBiasThenReLU:
+        post_ops.append_eltwise(dnnl::algorithm::eltwise_relu, 0, 0);
+        break;
+      case se::gpu::BlasLt::Epilogue::kGELU:
+      case se::gpu::BlasLt::Epilogue::kBiasThenGELU:
+        post_ops.append_eltwise(dnnl::algorithm::eltwise_gelu_tanh, 0, 0);
+        break;
+      default:
+        break;
+    }
+    post_ops_attr.set_post_ops(post_ops);
+
+    auto matmul_pd =
+        has_bias ? dnnl::matmul::primitive_desc(dnnl_engine, src_md,
+                                                weights_md, bias_md, dst_md,
+                                                post_ops_attr)
+                 : dnnl::matmul::primitive_desc(dnnl_engine, src_md,
+                                                weights_md, dst_md,
+                                                post_ops_attr);
+
+    auto new_primitive = std::make_shared<OneDnnMatMulPrimitive>();
+    new_primitive->primitive = dnnl::matmul(matmul_pd);
+    new_primitive->stream =
+        dnnl::sycl_interop::make_stream(dnnl_engine, *stream_handle);
+    new_primitive->scratchpad_size = matmul_pd.scratchpad_desc().get_size();
+    new_primitive->src_memory = CreateDnnlMemory(src_md, dnnl_engine, lhs_data);
+    new_primitive->weights_memory =
+        CreateDnnlMemory(weights_md, dnnl_engine, rhs_data);
+    new_primitive->dst_memory = CreateDnnlMemory(dst_md, dnnl_engine, out_data);
+    new_primitive->scratchpad_memory = dnnl::sycl_interop::make_memory(
+        matmul_pd.scratchpad_desc(), dnnl_engine,
+        dnnl::sycl_interop::memory_kind::usm, DNNL_MEMORY_NONE);
+    new_primitive->args = {
+        {DNNL_ARG_SRC, new_primitive->src_memory},
+        {DNNL_ARG_WEIGHTS, new_primitive->weights_memory},
+        {DNNL_ARG_DST, new_primitive->dst_memory},
+        {DNNL_ARG_SCRATCHPAD, new_primitive->scratchpad_memory}};
+    if (has_bias) {
+      new_primitive->bias_memory =
+          CreateDnnlMemory(bias_md, dnnl_engine, bias_data);
+      new_primitive->args.emplace(DNNL_ARG_BIAS, new_primitive->bias_memory);
+    }
+    primitive = MatMulPrimitiveCache().Insert(key, std::move(new_primitive));
   }
-  matmul_primitive.execute(dnnl_stream, fwd_primitive_args);
+  if (slot != nullptr) *slot = primitive;
+
+  void* workspace;
+  TF_RETURN_IF_ERROR(AllocateWorkspace(&workspace, scratch_allocator,
+                                       primitive->scratchpad_size));
+
+  // Cached primitives are shared, only the data handles are rebound for this
+  // execution.
+  absl::MutexLock lock(&primitive->mu);
+  primitive->src_memory.set_data_handle(lhs_data);
+  primitive->weights_memory.set_data_handle(rhs_data);
+  primitive->dst_memory.set_data_handle(out_data);
+  primitive->scratchpad_memory.set_data_handle(workspace);
+  if (has_bias) primitive->bias_memory.set_data_handle(bias_data);
+  primitive->primitive.execute(primitive->stream, primitive->args);
   return absl::OkStatus();
 }
 
@@ -459,17 +561,23 @@ absl::Status DoGemm(int64_t batch_size, int64_t m, int64_t n, int64_t k,
                     se::gpu::BlasLt::Epilogue epilogue, se::Stream* stream,
                     std::optional<se::blas::AlgorithmType> algorithm,
                     se::ScratchAllocator* scratch_allocator,
-                    se::blas::ComputePrecision compute_precision) {
-  if (algorithm == se::blas::kXetlaGemm) {
+                    se::blas::ComputePrecision compute_precision,
+                    PrimitiveSlot* slot) {
+  // Non-negative algorithms are XeTLA tile policies picked by the autotuner.
+  std::optional<std::tuple<int, int, int, int, int, int>> policy;
+  if (algorithm.has_value() && *algorithm >= 0) {
+    policy = ::gpu::xetla::decodeXetlaGemmPolicy(*algorithm);
+  }
+  if (algorithm == se::blas::kXetlaGemm || policy.has_value()) {
     VLOG(1) << "Run Xetla gemm kernel";
     return DoXetlaGemm<InputT>(batch_size, m, n, k, lhs, rhs, c, output, bias,
-                               alpha, beta, epilogue, stream, algorithm,
+                               alpha, beta, epilogue, stream, policy,
                                scratch_allocator, compute_precision);
   } else {
     VLOG(1) << "Run OneDnn gemm kernel";
     return DoOnednnGemm<InputT, OutputT>(
         batch_size, m, n, k, lhs, rhs, c, output, bias, alpha, beta, epilogue,
-        stream, algorithm, scratch_allocator, compute_precision);
+        stream, algorithm, scratch_allocator, compute_precision, slot);
   }
 }
 
@@ -504,15 +612,111 @@ void MakeBlasGemmCompatible(MatrixDescriptor& lhs, MatrixDescriptor& rhs,
     TransposeMatrixDesc(c);
   }
 }
+
+absl::StatusOr<dnnl::memory::data_type> OneDnnFloatType(PrimitiveType type) {
+  switch (type) {
+    case F16:
+      return dnnl::memory::data_type::f16;
+    case BF16:
+      return dnnl::memory::data_type::bf16;
+    default:
+      return Internal("Unsupported weight-only quantized GEMM type %s",
+                      primitive_util::LowercasePrimitiveTypeName(type));
+  }
+}
+
+absl::StatusOr<dnnl::memory::data_type> OneDnnF8Type(PrimitiveType type) {
+  switch (type) {
+    case F8E4M3FN:
+      return dnnl::memory::data_type::f8_e4m3;
+    case F8E5M2:
+      return dnnl::memory::data_type::f8_e5m2;
+    default:
+      return Internal("Unsupported FP8 GEMM operand type %s",
+                      primitive_util::LowercasePrimitiveTypeName(type));
+  }
+}
+
+// Workspace buffers are aligned like the buffers XLA allocates.
+size_t AlignWorkspaceOffset(size_t offset) {
+  constexpr size_t kAlignment = 256;
+  return (offset + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+// Unpacked 4-bit weights hold one sign or zero extended value per byte, which
+// is the same as 8-bit weights.
+absl::StatusOr<dnnl::memory::data_type> OneDnnWeightType(PrimitiveType type,
+                                                         bool packed) {
+  switch (type) {
+    case S8:
+      return dnnl::memory::data_type::s8;
+    case U8:
+      return dnnl::memory::data_type::u8;
+    case S4:
+      return packed ? dnnl::memory::data_type::s4
+                    : dnnl::memory::data_type::s8;
+    case U4:
+      return packed ? dnnl::memory::data_type::u4
+                    : dnnl::memory::data_type::u8;
+    default:
+      return Internal("Unsupported quantized weight type %s",
+                      primitive_util::LowercasePrimitiveTypeName(type));
+  }
+}
 }  // namespace
 
-absl::Status RunGemm(const GemmConfig& config, se::DeviceMemoryBase lhs_buffer,
-                     se::DeviceMemoryBase rhs_buffer,
-                     se::DeviceMemoryBase c_buffer,
-                     se::DeviceMemoryBase output_buffer,
-                     se::DeviceMemoryBase bias_buffer, se::Stream* stream,
-                     se::gpu::BlasLt::Epilogue epilogue,
-                     se::ScratchAllocator* scratch_allocator) {
+OneDnnPrimitiveCacheStats GetOneDnnMatMulPrimitiveCacheStats() {
+  return MatMulPrimitiveCache().stats();
+}
+
+std::vector<se::blas::AlgorithmType> GetXetlaGemmAlgorithms(
+    const GemmConfig& config) {
+  // Timing candidates much slower than the cheapest one by the cost model
+  // would mostly prolong autotuning.
+  constexpr double kMaxSlowdown = 2.0;
+
+  MatrixDescriptor lhs =
+      GetMatrixDesc(MatrixLayout{config.lhs_layout}, se::DeviceMemoryBase());
+  MatrixDescriptor rhs =
+      GetMatrixDesc(MatrixLayout{config.rhs_layout}, se::DeviceMemoryBase());
+  MatrixDescriptor c =
+      GetMatrixDesc(MatrixLayout{config.c_layout}, se::DeviceMemoryBase());
+  MatrixDescriptor output =
+      GetMatrixDesc(MatrixLayout{config.output_layout}, se::DeviceMemoryBase());
+  MakeBlasGemmCompatible(lhs, rhs, c, output);
+
+  // The shape checks of the kernel don't depend on the element type or the
+  // policy, a GEMM the kernel falls back on has no XeTLA candidate.
+  ::gpu::xetla::XetlaGemmKernel<sycl::half> kernel;
+  kernel.add_matrix_c(output)
+      .add_matrix_a(lhs)
+      .add_matrix_b(rhs)
+      .add_batch_size(config.output_layout.batch_size);
+  if (kernel.build().fallback()) return {};
+
+  // The kernel only runs row-major A.
+  int64_t m = output.num_rows;
+  int64_t n = output.num_cols;
+  int64_t k = lhs.num_cols;
+  std::vector<se::blas::AlgorithmType> algorithms;
+  for (const auto& policy : ::gpu::xetla::rankXetlaGemmPolicies(
+           m, n, k, config.output_layout.batch_size, kMaxSlowdown)) {
+    algorithms.push_back(::gpu::xetla::encodeXetlaGemmPolicy(policy));
+  }
+  return algorithms;
+}
+
+namespace {
+absl::Status RunGemmWithSlot(const GemmConfig& config,
+                             se::DeviceMemoryBase lhs_buffer,
+                             se::DeviceMemoryBase rhs_buffer,
+                             se::DeviceMemoryBase c_buffer,
+                             se::DeviceMemoryBase output_buffer,
+                             se::DeviceMemoryBase bias_buffer,
+                             se::Stream* stream,
+                             se::gpu::BlasLt::Epilogue epilogue,
+                             se::ScratchAllocator* scratch_allocator,
+                             PrimitiveSlot* slot) {
   VLOG(2) << "Executing a GemmThunk";
 
   auto lhs_layout = MatrixLayout{config.lhs_layout},
@@ -539,7 +743,7 @@ absl::Status RunGemm(const GemmConfig& config, se::DeviceMemoryBase lhs_buffer,
     return DoGemm<NativeAType, NativeCType>(                                  \
         batch_size, m, n, k, lhs, rhs, c, output, bias_buffer,                \
         config.alpha.real(), config.beta, epilogue, stream, config.algorithm, \
-        scratch_allocator, config.compute_precision);                         \
+        scratch_allocator, config.compute_precision, slot);                   \
   }
 
   TYPED_GEMM(BF16, BF16, BF16)
@@ -556,6 +760,317 @@ absl::Status RunGemm(const GemmConfig& config, se::DeviceMemoryBase lhs_buffer,
       primitive_util::LowercasePrimitiveTypeName(rhs_layout.dtype),
       primitive_util::LowercasePrimitiveTypeName(output_layout.dtype));
 }
+}  // namespace
+
+absl::Status RunGemm(const GemmConfig& config, se::DeviceMemoryBase lhs_buffer,
+                     se::DeviceMemoryBase rhs_buffer,
+                     se::DeviceMemoryBase c_buffer,
+                     se::DeviceMemoryBase output_buffer,
+                     se::DeviceMemoryBase bias_buffer, se::Stream* stream,
+                     se::gpu::BlasLt::Epilogue epilogue,
+                     se::ScratchAllocator* scratch_allocator) {
+  return RunGemmWithSlot(config, lhs_buffer, rhs_buffer, c_buffer,
+                         output_buffer, bias_buffer, stream, epilogue,
+                         scratch_allocator, /*slot=*/nullptr);
+}
+
+absl::StatusOr<std::unique_ptr<GemmPlan>> GemmPlan::Create(
+    const GemmConfig& config, se::gpu::BlasLt::Epilogue epilogue) {
+  switch (epilogue) {
+    case se::gpu::BlasLt::Epilogue::kReLU:
+    case se::gpu::BlasLt::Epilogue::kBiasThenReLU:
+    case se::gpu::BlasLt::Epilogue::kGELU:
+    case se::gpu::BlasLt::Epilogue::kBiasThenGELU:
+    case se::gpu::BlasLt::Epilogue::kDefault:
+    case se::gpu::BlasLt::Epilogue::kBias:
+      break;
+    default:
+      return Internal("Unsupported GEMM epilogue %d",
+                      static_cast<int>(epilogue));
+  }
+  return absl::WrapUnique(new GemmPlan(config, epilogue));
+}
+
+absl::Status GemmPlan::ExecuteOnStream(
+    se::Stream* stream, se::DeviceMemoryBase lhs_buffer,
+    se::DeviceMemoryBase rhs_buffer, se::DeviceMemoryBase c_buffer,
+    se::DeviceMemoryBase output_buffer, se::DeviceMemoryBase bias_buffer,
+    se::ScratchAllocator* scratch_allocator) {
+  // The primitive depends on which of the optional operands are present.
+  PrimitiveKey key{se::gpu::AsGpuStreamValue(stream), !c_buffer.is_null(),
+                   !bias_buffer.is_null()};
+  std::shared_ptr<OneDnnMatMulPrimitive> primitive;
+  {
+    absl::MutexLock lock(&mu_);
+    auto it = primitives_.find(key);
+    if (it != primitives_.end()) primitive = it->second;
+  }
+  bool found = primitive != nullptr;
+  TF_RETURN_IF_ERROR(RunGemmWithSlot(config_, lhs_buffer, rhs_buffer, c_buffer,
+                                     output_buffer, bias_buffer, stream,
+                                     epilogue_, scratch_allocator, &primitive));
+  // XeTLA kernels leave the slot empty, there is nothing to remember.
+  if (!found && primitive != nullptr) {
+    absl::MutexLock lock(&mu_);
+    primitives_.emplace(key, std::move(primitive));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status RunWeightOnlyQuantizedGemm(
+    const WeightOnlyQuantizedGemmConfig& config, se::DeviceMemoryBase lhs,
+    se::DeviceMemoryBase weights, se::DeviceMemoryBase scales,
+    se::DeviceMemoryBase output, se::Stream* stream,
+    se::ScratchAllocator* scratch_allocator) {
+  TF_ASSIGN_OR_RETURN(dnnl::memory::data_type type,
+                      OneDnnFloatType(config.type));
+  TF_ASSIGN_OR_RETURN(
+      dnnl::memory::data_type weight_type,
+      OneDnnWeightType(config.weight_type, config.packed_weights));
+  const int64_t m = config.m, n = config.n, k = config.k;
+  const bool has_scales = config.group_size > 0;
+  if (has_scales && (k % config.group_size != 0 ||
+                     (config.transpose_weights && config.group_size != k))) {
+    return Internal("Unsupported weight quantization group size %d for K=%d",
+                    config.group_size, k);
+  }
+  se::gpu::GpuStreamHandle stream_handle =
+      stream_executor::gpu::AsGpuStreamValue(stream);
+  void* lhs_data = const_cast<void*>(lhs.opaque());
+  void* weights_data = const_cast<void*>(weights.opaque());
+  void* scales_data = const_cast<void*>(scales.opaque());
+  void* out_data = const_cast<void*>(output.opaque());
+
+  std::string key = absl::StrCat(
+      "woq|", absl::Hex(reinterpret_cast<uintptr_t>(stream_handle)), "|", m,
+      ",", n, ",", k, "|", static_cast<int>(type), ",",
+      static_cast<int>(weight_type), "|", config.transpose_weights, "|",
+      config.group_size);
+  std::shared_ptr<OneDnnMatMulPrimitive> primitive =
+      MatMulPrimitiveCache().Find(key);
+  if (primitive == nullptr) {
+    VLOG(2) << "Create oneDNN weight-only quantized matmul primitive: " << key;
+    auto src_md = dnnl::memory::desc({m, k}, type, {k, 1});
+    auto weights_md = dnnl::memory::desc(
+        {k, n}, weight_type,
+        config.transpose_weights ? dnnl::memory::dims{1, k}
+                                 : dnnl::memory::dims{n, 1});
+    auto dst_md = dnnl::memory::desc({m, n}, type, {n, 1});
+    const int64_t num_groups = has_scales ? k / config.group_size : 1;
+    auto scales_md = dnnl::memory::desc({num_groups, n}, type, {n, 1});
+
+    auto& dnnl_engine = FindOrCreateEngine(stream_handle);
+    dnnl::primitive_attr attr;
+    attr.set_scratchpad_mode(dnnl::scratchpad_mode::user);
+    // Integer weights are converted to the type of the activations, the
+    // multiplications run on the floating point units.
+    attr.set_fpmath_mode(type == dnnl::memory::data_type::f16
+                             ? dnnl::fpmath_mode::f16
+                             : dnnl::fpmath_mode::bf16,
+                         /*apply_to_int=*/true);
+    if (has_scales) {
+      // One scale per group of K and per column of the weights.
+      attr.set_scales(DNNL_ARG_WEIGHTS, (1 << 0) | (1 << 1),
+                      {config.group_size, 1}, type);
+    }
+    auto matmul_pd = dnnl::matmul::primitive_desc(dnnl_engine, src_md,
+                                                  weights_md, dst_md, attr);
+
+    auto new_primitive = std::make_shared<OneDnnMatMulPrimitive>();
+    new_primitive->primitive = dnnl::matmul(matmul_pd);
+    new_primitive->stream =
+        dnnl::sycl_interop::make_stream(dnnl_engine, *stream_handle);
+    new_primitive->scratchpad_size = matmul_pd.scratchpad_desc().get_size();
+    new_primitive->src_memory = CreateDnnlMemory(src_md, dnnl_engine, lhs_data);
+    new_primitive->weights_memory =
+        CreateDnnlMemory(weights_md, dnnl_engine, weights_data);
+    new_primitive->dst_memory = CreateDnnlMemory(dst_md, dnnl_engine, out_data);
+    new_primitive->scratchpad_memory = dnnl::sycl_interop::make_memory(
+        matmul_pd.scratchpad_desc(), dnnl_engine,
+        dnnl::sycl_interop::memory_kind::usm, DNNL_MEMORY_NONE);
+    new_primitive->args = {
+        {DNNL_ARG_SRC, new_primitive->src_memory},
+        {DNNL_ARG_WEIGHTS, new_primitive->weights_memory},
+        {DNNL_ARG_DST, new_primitive->dst_memory},
+        {DNNL_ARG_SCRATCHPAD, new_primitive->scratchpad_memory}};
+    if (has_scales) {
+      new_primitive->scales_memory =
+          CreateDnnlMemory(scales_md, dnnl_engine, scales_data);
+      new_primitive->args.emplace(DNNL_ARG_ATTR_SCALES | DNNL_ARG_WEIGHTS,
+                                  new_primitive->scales_memory);
+    }
+    primitive = MatMulPrimitiveCache().Insert(key, std::move(new_primitive));
+  }
+
+  void* workspace;
+  TF_RETURN_IF_ERROR(AllocateWorkspace(&workspace, scratch_allocator,
+                                       primitive->scratchpad_size));
+
+  absl::MutexLock lock(&primitive->mu);
+  primitive->src_memory.set_data_handle(lhs_data);
+  primitive->weights_memory.set_data_handle(weights_data);
+  primitive->dst_memory.set_data_handle(out_data);
+  primitive->scratchpad_memory.set_data_handle(workspace);
+  if (has_scales) primitive->scales_memory.set_data_handle(scales_data);
+  primitive->primitive.execute(primitive->stream, primitive->args);
+  return absl::OkStatus();
+}
+
+absl::StatusOr<Fp8GemmConfig> GetFp8GemmConfig(const HloInstruction* gemm) {
+  TF_RET_CHECK(gemm->operand_count() == 4);
+  TF_ASSIGN_OR_RETURN(auto gpu_config,
+                      gemm->backend_config<GpuBackendConfig>());
+  const GemmBackendConfig& gemm_config = gpu_config.gemm_backend_config();
+  const DotDimensionNumbers& dnums = gemm_config.dot_dimension_numbers();
+  TF_RET_CHECK(dnums.rhs_contracting_dimensions_size() == 1);
+  const Shape& a_shape = gemm->operand(0)->shape();
+  Fp8GemmConfig config;
+  config.a_type = a_shape.element_type();
+  config.b_type = gemm->operand(1)->shape().element_type();
+  config.output_type = gemm->shape().element_type();
+  config.transpose_b = dnums.rhs_contracting_dimensions(0) == 1;
+  config.m = gemm->shape().dimensions(0);
+  config.n = gemm->shape().dimensions(1);
+  config.k = a_shape.dimensions(1);
+  if (gemm_config.has_selected_algorithm()) {
+    config.algorithm = gemm_config.selected_algorithm();
+  }
+  return config;
+}
+
+absl::Status RunFp8Gemm(const Fp8GemmConfig& config, se::DeviceMemoryBase a,
+                        se::DeviceMemoryBase b, se::DeviceMemoryBase a_scale,
+                        se::DeviceMemoryBase b_scale,
+                        se::DeviceMemoryBase output, se::Stream* stream,
+                        se::ScratchAllocator* scratch_allocator) {
+  TF_ASSIGN_OR_RETURN(dnnl::memory::data_type a_type,
+                      OneDnnF8Type(config.a_type));
+  TF_ASSIGN_OR_RETURN(dnnl::memory::data_type b_type,
+                      OneDnnF8Type(config.b_type));
+  dnnl::memory::data_type output_type = dnnl::memory::data_type::f32;
+  if (config.output_type != F32) {
+    TF_ASSIGN_OR_RETURN(output_type, OneDnnFloatType(config.output_type));
+  }
+  const int64_t m = config.m, n = config.n, k = config.k;
+  const bool upcast = config.algorithm != se::blas::kOneDnnGemm;
+  se::gpu::GpuStreamHandle stream_handle =
+      stream_executor::gpu::AsGpuStreamValue(stream);
+  void* a_data = const_cast<void*>(a.opaque());
+  void* b_data = const_cast<void*>(b.opaque());
+  void* a_scale_data = const_cast<void*>(a_scale.opaque());
+  void* b_scale_data = const_cast<void*>(b_scale.opaque());
+  void* out_data = const_cast<void*>(output.opaque());
+
+  std::string key = absl::StrCat(
+      "f8|", absl::Hex(reinterpret_cast<uintptr_t>(stream_handle)), "|", m,
+      ",", n, ",", k, "|", static_cast<int>(a_type), ",",
+      static_cast<int>(b_type), ",", static_cast<int>(output_type), "|",
+      config.transpose_b, "|", upcast);
+  std::shared_ptr<OneDnnFp8MatMulPrimitive> primitive =
+      Fp8MatMulPrimitiveCache().Find(key);
+  if (primitive == nullptr) {
+    VLOG(2) << "Create oneDNN FP8 matmul primitive: " << key;
+    // Native FP8 matmuls aren't implemented on every device.
+    try {
+      dnnl::memory::dims b_strides = config.transpose_b
+                                         ? dnnl::memory::dims{1, k}
+                                         : dnnl::memory::dims{n, 1};
+      auto a_md = dnnl::memory::desc({m, k}, a_type, {k, 1});
+      auto b_md = dnnl::memory::desc({k, n}, b_type, b_strides);
+      auto a_upcast_md =
+          dnnl::memory::desc({m, k}, dnnl::memory::data_type::f16, {k, 1});
+      auto b_upcast_md =
+          dnnl::memory::desc({k, n}, dnnl::memory::data_type::f16, b_strides);
+      auto dst_md = dnnl::memory::desc({m, n}, output_type, {n, 1});
+      auto scale_md = dnnl::memory::desc({1}, dnnl::memory::data_type::f32,
+                                         dnnl::memory::format_tag::x);
+
+      auto& dnnl_engine = FindOrCreateEngine(stream_handle);
+      dnnl::primitive_attr attr;
+      attr.set_scratchpad_mode(dnnl::scratchpad_mode::user);
+      // The per-tensor scales are applied to the accumulators.
+      attr.set_scales_mask(DNNL_ARG_SRC, 0);
+      attr.set_scales_mask(DNNL_ARG_WEIGHTS, 0);
+      auto matmul_pd = dnnl::matmul::primitive_desc(
+          dnnl_engine, upcast ? a_upcast_md : a_md, upcast ? b_upcast_md : b_md,
+          dst_md, attr);
+
+      auto new_primitive = std::make_shared<OneDnnFp8MatMulPrimitive>();
+      new_primitive->primitive = dnnl::matmul(matmul_pd);
+      new_primitive->stream =
+          dnnl::sycl_interop::make_stream(dnnl_engine, *stream_handle);
+      new_primitive->a_memory = CreateDnnlMemory(a_md, dnnl_engine, a_data);
+      new_primitive->b_memory = CreateDnnlMemory(b_md, dnnl_engine, b_data);
+      new_primitive->a_scale_memory =
+          CreateDnnlMemory(scale_md, dnnl_engine, a_scale_data);
+      new_primitive->b_scale_memory =
+          CreateDnnlMemory(scale_md, dnnl_engine, b_scale_data);
+      new_primitive->dst_memory =
+          CreateDnnlMemory(dst_md, dnnl_engine, out_data);
+      new_primitive->scratchpad_memory = dnnl::sycl_interop::make_memory(
+          matmul_pd.scratchpad_desc(), dnnl_engine,
+          dnnl::sycl_interop::memory_kind::usm, DNNL_MEMORY_NONE);
+      size_t offset = 0;
+      if (upcast) {
+        new_primitive->a_upcast_memory = dnnl::sycl_interop::make_memory(
+            a_upcast_md, dnnl_engine, dnnl::sycl_interop::memory_kind::usm,
+            DNNL_MEMORY_NONE);
+        new_primitive->b_upcast_memory = dnnl::sycl_interop::make_memory(
+            b_upcast_md, dnnl_engine, dnnl::sycl_interop::memory_kind::usm,
+            DNNL_MEMORY_NONE);
+        new_primitive->a_reorder = dnnl::reorder(
+            new_primitive->a_memory, new_primitive->a_upcast_memory);
+        new_primitive->b_reorder = dnnl::reorder(
+            new_primitive->b_memory, new_primitive->b_upcast_memory);
+        offset = AlignWorkspaceOffset(a_upcast_md.get_size());
+        new_primitive->b_upcast_offset = offset;
+        offset = AlignWorkspaceOffset(offset + b_upcast_md.get_size());
+      }
+      new_primitive->scratchpad_offset = offset;
+      new_primitive->workspace_size =
+          offset + matmul_pd.scratchpad_desc().get_size();
+      new_primitive->args = {
+          {DNNL_ARG_SRC,
+           upcast ? new_primitive->a_upcast_memory : new_primitive->a_memory},
+          {DNNL_ARG_WEIGHTS,
+           upcast ? new_primitive->b_upcast_memory : new_primitive->b_memory},
+          {DNNL_ARG_DST, new_primitive->dst_memory},
+          {DNNL_ARG_ATTR_SCALES | DNNL_ARG_SRC, new_primitive->a_scale_memory},
+          {DNNL_ARG_ATTR_SCALES | DNNL_ARG_WEIGHTS,
+           new_primitive->b_scale_memory},
+          {DNNL_ARG_SCRATCHPAD, new_primitive->scratchpad_memory}};
+      primitive =
+          Fp8MatMulPrimitiveCache().Insert(key, std::move(new_primitive));
+    } catch (dnnl::error& e) {
+      return Internal("OneDNN FP8 matmul error: %s", e.message);
+    }
+  }
+
+  void* workspace;
+  TF_RETURN_IF_ERROR(AllocateWorkspace(&workspace, scratch_allocator,
+                                       primitive->workspace_size));
+  char* workspace_bytes = static_cast<char*>(workspace);
+
+  absl::MutexLock lock(&primitive->mu);
+  primitive->a_memory.set_data_handle(a_data);
+  primitive->b_memory.set_data_handle(b_data);
+  primitive->a_scale_memory.set_data_handle(a_scale_data);
+  primitive->b_scale_memory.set_data_handle(b_scale_data);
+  primitive->dst_memory.set_data_handle(out_data);
+  primitive->scratchpad_memory.set_data_handle(workspace_bytes +
+                                               primitive->scratchpad_offset);
+  if (primitive->a_reorder.has_value()) {
+    primitive->a_upcast_memory.set_data_handle(workspace_bytes);
+    primitive->b_upcast_memory.set_data_handle(workspace_bytes +
+                                               primitive->b_upcast_offset);
+    primitive->a_reorder->execute(primitive->stream, primitive->a_memory,
+                                  primitive->a_upcast_memory);
+    primitive->b_reorder->execute(primitive->stream, primitive->b_memory,
+                                  primitive->b_upcast_memory);
+  }
+  primitive->primitive.execute(primitive->stream, primitive->args);
+  return absl::OkStatus();
+}
 
 }  // namespace gpu
 }  // namespace xla
@@ -19,19 +19,26 @@ limitations under the License.
 #define XLA_SERVICE_GPU_ONEDNN_MATMUL_UTILS_H_
 
 #include <cstdint>
+#include <memory>
 #include <optional>
+#include <tuple>
 #include <utility>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/types/span.h"
 #include "xla/hlo/ir/hlo_instruction.h"
 #include "xla/service/gpu/backend_configs.pb.h"
 #include "xla/service/gpu/ir_emission_utils.h"
 #include "xla/service/gpu/matmul_utils.h"
 #include "xla/service/gpu/scratch_allocator.h"
+#include "xla/service/onednn_primitive_cache.h"
 #include "xla/shape.h"
 #include "xla/statusor.h"
 #include "xla/stream_executor/blas.h"
+#include "xla/stream_executor/gpu/gpu_types.h"
 #include "xla/types.h"
 #include "xla/xla_data.pb.h"
 
@@ -45,6 +52,111 @@ absl::Status RunGemm(const GemmConfig& config, se::DeviceMemoryBase lhs_buffer,
                se::gpu::BlasLt::Epilogue epilogue,
                se::ScratchAllocator* scratch_allocator = nullptr);
 
+struct OneDnnMatMulPrimitive;
+
+// A GEMM of a fixed configuration, cached by the cuBLASLt matmul thunk. The
+// first execution on a stream finds or creates the oneDNN primitive like
+// RunGemm; later ones reuse it directly and only rebind the buffers. The
+// algorithm of the config still selects between oneDNN and XeTLA. This is not
+// a se::gpu::BlasLt implementation, SYCLBlas has none.
+class GemmPlan {
+ public:
+  static absl::StatusOr<std::unique_ptr<GemmPlan>> Create(
+      const GemmConfig& config, se::gpu::BlasLt::Epilogue epilogue);
+
+  absl::Status ExecuteOnStream(se::Stream* stream,
+                               se::DeviceMemoryBase lhs_buffer,
+                               se::DeviceMemoryBase rhs_buffer,
+                               se::DeviceMemoryBase c_buffer,
+                               se::DeviceMemoryBase output_buffer,
+                               se::DeviceMemoryBase bias_buffer,
+                               se::ScratchAllocator* scratch_allocator);
+
+  const GemmConfig& config() const { return config_; }
+
+ private:
+  GemmPlan(const GemmConfig& config, se::gpu::BlasLt::Epilogue epilogue)
+      : config_(config), epilogue_(epilogue) {}
+
+  // Stream, and whether the C and bias operands are present.
+  using PrimitiveKey = std::tuple<se::gpu::GpuStreamHandle, bool, bool>;
+
+  const GemmConfig config_;
+  const se::gpu::BlasLt::Epilogue epilogue_;
+  absl::Mutex mu_;
+  absl::flat_hash_map<PrimitiveKey, std::shared_ptr<OneDnnMatMulPrimitive>>
+      primitives_ ABSL_GUARDED_BY(mu_);
+};
+
+// Hit/miss counters of the oneDNN matmul primitive cache used by RunGemm. The
+// cache capacity is set with XLA_ONEDNN_MATMUL_CACHE_CAPACITY, 0 disables it.
+OneDnnPrimitiveCacheStats GetOneDnnMatMulPrimitiveCacheStats();
+
+// Weight-only quantized GEMM:
+//
+//   output[m, n] = lhs[m, k] x (weights[k, n] * scales[k / group_size, n])
+//
+// lhs, scales and output are F16 or BF16 and the weights are S8, U8, S4 or U4.
+// The weights are dequantized while they are loaded, so only the integer
+// weights are read from memory. Without scales (group_size 0) the weights are
+// only converted. All matrices are row-major, the weights are stored as
+// [n, k] if `transpose_weights` is set, in which case only per-channel scales
+// (group_size == k) are supported.
+struct WeightOnlyQuantizedGemmConfig {
+  PrimitiveType type;
+  PrimitiveType weight_type;
+  // 4-bit weights are stored two per byte, otherwise one per byte.
+  bool packed_weights = false;
+  bool transpose_weights = false;
+  int64_t m = 0;
+  int64_t n = 0;
+  int64_t k = 0;
+  int64_t group_size = 0;
+};
+
+absl::Status RunWeightOnlyQuantizedGemm(
+    const WeightOnlyQuantizedGemmConfig& config, se::DeviceMemoryBase lhs,
+    se::DeviceMemoryBase weights, se::DeviceMemoryBase scales,
+    se::DeviceMemoryBase output, se::Stream* stream,
+    se::ScratchAllocator* scratch_allocator);
+
+// GEMM of FP8 operands with per-tensor scales:
+//
+//   output[m, n] = (a_scale * b_scale) * (a[m, k] x b[k, n])
+//
+// a and b are F8E4M3FN or F8E5M2, the scales are F32 scalars in device memory
+// and the output is F16, BF16 or F32. b is stored as [n, k] if `transpose_b`
+// is set. se::blas::kOneDnnGemm runs a native FP8 oneDNN matmul, any other
+// algorithm converts the operands to F16 in the workspace first, which works
+// on devices without FP8 matmul support.
+struct Fp8GemmConfig {
+  PrimitiveType a_type;
+  PrimitiveType b_type;
+  PrimitiveType output_type;
+  bool transpose_b = false;
+  int64_t m = 0;
+  int64_t n = 0;
+  int64_t k = 0;
+  se::blas::AlgorithmType algorithm = se::blas::kDefaultAlgorithm;
+};
+
+// Returns the configuration of a custom call built by Fp8GemmRewriter.
+absl::StatusOr<Fp8GemmConfig> GetFp8GemmConfig(const HloInstruction* gemm);
+
+absl::Status RunFp8Gemm(const Fp8GemmConfig& config, se::DeviceMemoryBase a,
+                        se::DeviceMemoryBase b, se::DeviceMemoryBase a_scale,
+                        se::DeviceMemoryBase b_scale,
+                        se::DeviceMemoryBase output, se::Stream* stream,
+                        se::ScratchAllocator* scratch_allocator);
+
+// Algorithms that make RunGemm use one specific XeTLA tile policy, for the
+// policies worth timing for the GEMM of `config`: none if the XeTLA kernel
+// falls back on its shape, otherwise the policies the cost model does not
+// rule out, cheapest first. se::blas::kXetlaGemm picks a policy from the GEMM
+// shape instead.
+std::vector<se::blas::AlgorithmType> GetXetlaGemmAlgorithms(
+    const GemmConfig& config);
+
 }  // namespace gpu
 }  // namespace xla
 
@@ -0,0 +1,160 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/gpu/paged_attention_thunk.h"
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/primitive_util.h"
+#include "xla/service/gpu/buffer_allocations.h"
+#include "xla/service/gpu/xetla/sdp/sdp.h"
+#include "xla/stream_executor/gpu/gpu_stream.h"
+
+namespace xla {
+namespace gpu {
+
+bool IsCustomCallToPagedAttention(const HloInstruction& hlo) {
+  return hlo.opcode() == HloOpcode::kCustomCall &&
+         hlo.custom_call_target() == kXetlaPagedAttentionCallTarget;
+}
+
+absl::StatusOr<float> GetPagedAttentionScale(const HloInstruction& hlo) {
+  const std::string& config = hlo.raw_backend_config_string();
+  if (config.empty()) {
+    const int64_t head_size = hlo.operand(0)->shape().dimensions(2);
+    return 1.0f / std::sqrt(static_cast<float>(head_size));
+  }
+  float scale;
+  if (!absl::SimpleAtof(config, &scale)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid paged attention scale: ", config));
+  }
+  return scale;
+}
+
+PagedAttentionThunk::PagedAttentionThunk(
+    ThunkInfo thunk_info, PrimitiveType type, PrimitiveType cache_type,
+    int64_t num_seqs, int64_t num_heads, int64_t num_kv_heads,
+    int64_t head_size, int64_t block_size, int64_t max_blocks_per_seq,
+    float scale, BufferAllocation::Slice query,
+    BufferAllocation::Slice key_cache, BufferAllocation::Slice value_cache,
+    BufferAllocation::Slice block_tables, BufferAllocation::Slice context_lens,
+    BufferAllocation::Slice k_scales, BufferAllocation::Slice v_scales,
+    BufferAllocation::Slice output)
+    : Thunk(Kind::kCustomCall, thunk_info),
+      type_(type),
+      cache_type_(cache_type),
+      num_seqs_(num_seqs),
+      num_heads_(num_heads),
+      num_kv_heads_(num_kv_heads),
+      head_size_(head_size),
+      block_size_(block_size),
+      max_blocks_per_seq_(max_blocks_per_seq),
+      scale_(scale),
+      query_(query),
+      key_cache_(key_cache),
+      value_cache_(value_cache),
+      block_tables_(block_tables),
+      context_lens_(context_lens),
+      k_scales_(k_scales),
+      v_scales_(v_scales),
+      output_(output) {}
+
+absl::Status PagedAttentionThunk::ExecuteOnStream(
+    const ExecuteParams& params) {
+  if (head_size_ != 64 && head_size_ != 128 && head_size_ != 256) {
+    return absl::UnimplementedError(absl::StrCat(
+        "Unsupported paged attention head size ", head_size_));
+  }
+  if (num_kv_heads_ <= 0 || num_heads_ % num_kv_heads_ != 0) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Paged attention with ", num_heads_, " query heads needs a divisor "
+        "as number of key/value heads, got ", num_kv_heads_));
+  }
+
+  se::gpu::GpuStreamHandle stream = se::gpu::AsGpuStreamValue(params.stream);
+  const BufferAllocations& allocs = *params.buffer_allocations;
+  void* query = allocs.GetDeviceAddress(query_).opaque();
+  void* key_cache = allocs.GetDeviceAddress(key_cache_).opaque();
+  void* value_cache = allocs.GetDeviceAddress(value_cache_).opaque();
+  auto* block_tables =
+      static_cast<int32_t*>(allocs.GetDeviceAddress(block_tables_).opaque());
+  auto* context_lens =
+      static_cast<int32_t*>(allocs.GetDeviceAddress(context_lens_).opaque());
+  void* output = allocs.GetDeviceAddress(output_).opaque();
+  if (cache_type_ == F8E4M3FN || cache_type_ == F8E5M2) {
+    if (k_scales_.allocation() == nullptr ||
+        v_scales_.allocation() == nullptr) {
+      return absl::InvalidArgumentError(
+          "Paged attention with an FP8 cache needs key and value scales");
+    }
+    bool is_e5m2 = cache_type_ == F8E5M2;
+    auto* k_scales =
+        static_cast<float*>(allocs.GetDeviceAddress(k_scales_).opaque());
+    auto* v_scales =
+        static_cast<float*>(allocs.GetDeviceAddress(v_scales_).opaque());
+    switch (type_) {
+      case F16:
+        ::gpu::xetla::paged_attention_decode_fp8_kernel_fp16(
+            *stream, query, key_cache, value_cache, is_e5m2, k_scales,
+            v_scales, block_tables, context_lens, output, num_seqs_,
+            num_heads_, num_kv_heads_, head_size_, block_size_,
+            max_blocks_per_seq_, scale_);
+        return absl::OkStatus();
+      case BF16:
+        ::gpu::xetla::paged_attention_decode_fp8_kernel_bf16(
+            *stream, query, key_cache, value_cache, is_e5m2, k_scales,
+            v_scales, block_tables, context_lens, output, num_seqs_,
+            num_heads_, num_kv_heads_, head_size_, block_size_,
+            max_blocks_per_seq_, scale_);
+        return absl::OkStatus();
+      default:
+        return absl::InternalError(
+            absl::StrCat("Unsupported paged attention type ",
+                         primitive_util::LowercasePrimitiveTypeName(type_)));
+    }
+  }
+  if (cache_type_ != type_) {
+    return absl::InternalError(absl::StrCat(
+        "Unsupported paged attention cache type ",
+        primitive_util::LowercasePrimitiveTypeName(cache_type_)));
+  }
+  switch (type_) {
+    case F16:
+      ::gpu::xetla::paged_attention_decode_kernel_fp16(
+          *stream, query, key_cache, value_cache, block_tables, context_lens,
+          output, num_seqs_, num_heads_, num_kv_heads_, head_size_,
+          block_size_, max_blocks_per_seq_, scale_);
+      return absl::OkStatus();
+    case BF16:
+      ::gpu::xetla::paged_attention_decode_kernel_bf16(
+          *stream, query, key_cache, value_cache, block_tables, context_lens,
+          output, num_seqs_, num_heads_, num_kv_heads_, head_size_,
+          block_size_, max_blocks_per_seq_, scale_);
+      return absl::OkStatus();
+    default:
+      return absl::InternalError(
+          absl::StrCat("Unsupported paged attention type ",
+                       primitive_util::LowercasePrimitiveTypeName(type_)));
+  }
+}
+
+}  // namespace gpu
+}  // namespace xla
@@ -0,0 +1,99 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_GPU_PAGED_ATTENTION_THUNK_H_
+#define XLA_SERVICE_GPU_PAGED_ATTENTION_THUNK_H_
+
+#include <cstdint>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/service/buffer_assignment.h"
+#include "xla/service/gpu/thunk.h"
+#include "xla/xla_data.pb.h"
+
+namespace xla {
+namespace gpu {
+
+// Custom call attending one query token per sequence over a paged key/value
+// cache. Its operands are
+//
+//   query          [B, N, H]
+//   key_cache      [num_blocks, block_size, N_kv, H]
+//   value_cache    [num_blocks, block_size, N_kv, H]
+//   block_tables   s32[B, max_blocks_per_seq]
+//   context_lens   s32[B]
+//
+// and its result is [B, N, H]. The cache may be f8e4m3fn or f8e5m2, followed
+// by the f32[N_kv] key and value scales it was quantized with as operands 5
+// and 6. The backend config is the softmax scale as a decimal number,
+// 1/sqrt(H) if empty.
+inline constexpr absl::string_view kXetlaPagedAttentionCallTarget =
+    "__xetla$paged_attention";
+
+bool IsCustomCallToPagedAttention(const HloInstruction& hlo);
+
+// Returns the softmax scale in the backend config of a paged attention custom
+// call.
+absl::StatusOr<float> GetPagedAttentionScale(const HloInstruction& hlo);
+
+// Thunk of the paged attention custom call, which reads the cache blocks of
+// every sequence through its block table instead of requiring the cache to be
+// gathered into contiguous buffers before each decoding step.
+class PagedAttentionThunk : public Thunk {
+ public:
+  // k_scales and v_scales are only used if cache_type is FP8.
+  PagedAttentionThunk(ThunkInfo thunk_info, PrimitiveType type,
+                      PrimitiveType cache_type, int64_t num_seqs,
+                      int64_t num_heads, int64_t num_kv_heads,
+                      int64_t head_size, int64_t block_size,
+                      int64_t max_blocks_per_seq, float scale,
+                      BufferAllocation::Slice query,
+                      BufferAllocation::Slice key_cache,
+                      BufferAllocation::Slice value_cache,
+                      BufferAllocation::Slice block_tables,
+                      BufferAllocation::Slice context_lens,
+                      BufferAllocation::Slice k_scales,
+                      BufferAllocation::Slice v_scales,
+                      BufferAllocation::Slice output);
+
+  absl::Status ExecuteOnStream(const ExecuteParams& params) override;
+
+ private:
+  const PrimitiveType type_;
+  const PrimitiveType cache_type_;
+  const int64_t num_seqs_;
+  const int64_t num_heads_;
+  const int64_t num_kv_heads_;
+  const int64_t head_size_;
+  const int64_t block_size_;
+  const int64_t max_blocks_per_seq_;
+  const float scale_;
+  const BufferAllocation::Slice query_;
+  const BufferAllocation::Slice key_cache_;
+  const BufferAllocation::Slice value_cache_;
+  const BufferAllocation::Slice block_tables_;
+  const BufferAllocation::Slice context_lens_;
+  const BufferAllocation::Slice k_scales_;
+  const BufferAllocation::Slice v_scales_;
+  const BufferAllocation::Slice output_;
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_GPU_PAGED_ATTENTION_THUNK_H_
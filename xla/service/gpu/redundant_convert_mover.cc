@@ -19,6 +19,8 @@ limitations under the License.
 #include "xla/primitive_util.h"
 #include "xla/service/hlo_creation_utils.h"
 #include "xla/service/pattern_matcher.h"
+#include "xla/shape_util.h"
+#include "xla/xla_data.pb.h"
 
 namespace xla {
 namespace gpu {
@@ -78,6 +80,64 @@ StatusOr<bool> RemoveRedundantConversion(HloInstruction* instr) {
   return false;
 }
 
+// dot(convert(a), convert(b)) -> dot(a, b)
+//
+// where a and b are F16 or BF16 widened to the F32 type of the dot. The GEMM
+// kernels read the narrow operands and accumulate in F32, which computes the
+// same products without materializing the widened operands.
+StatusOr<bool> FoldOperandConvertsIntoDot(HloInstruction* instr) {
+  if (instr->opcode() != HloOpcode::kDot ||
+      instr->shape().element_type() != F32) {
+    return false;
+  }
+  HloInstruction* lhs = instr->mutable_operand(0);
+  HloInstruction* rhs = instr->mutable_operand(1);
+  if (!IsConvert(lhs) || !IsConvert(rhs) || !IsConvertNoLoss(lhs) ||
+      !IsConvertNoLoss(rhs)) {
+    return false;
+  }
+  PrimitiveType type = lhs->operand(0)->shape().element_type();
+  if ((type != F16 && type != BF16) ||
+      rhs->operand(0)->shape().element_type() != type) {
+    return false;
+  }
+  TF_RETURN_IF_ERROR(instr->ReplaceOperandWith(0, lhs->mutable_operand(0)));
+  TF_RETURN_IF_ERROR(instr->ReplaceOperandWith(1, rhs->mutable_operand(0)));
+  return true;
+}
+
+// collective(convert(x)) -> convert(collective(x))
+//
+// for collectives that only move data and converts that widen x. The
+// collective then moves the narrow type, and the convert runs once on the
+// result instead of on every operand shard.
+StatusOr<bool> MoveWideningConvertAfterCollective(HloInstruction* instr) {
+  if (instr->opcode() != HloOpcode::kAllGather &&
+      instr->opcode() != HloOpcode::kAllToAll &&
+      instr->opcode() != HloOpcode::kCollectivePermute) {
+    return false;
+  }
+  if (instr->shape().IsTuple() || instr->operand_count() != 1) return false;
+  HloInstruction* convert = instr->mutable_operand(0);
+  if (!IsConvert(convert) || !IsConvertNoLoss(convert) ||
+      convert->user_count() != 1) {
+    return false;
+  }
+  HloInstruction* input = convert->mutable_operand(0);
+  if (primitive_util::BitWidth(input->shape().element_type()) >=
+      primitive_util::BitWidth(convert->shape().element_type())) {
+    return false;
+  }
+  HloInstruction* collective =
+      instr->parent()->AddInstruction(instr->CloneWithNewOperands(
+          ShapeUtil::ChangeElementType(instr->shape(),
+                                       input->shape().element_type()),
+          {input}));
+  TF_RETURN_IF_ERROR(instr->parent()->ReplaceWithNewInstruction(
+      instr, HloInstruction::CreateConvert(instr->shape(), collective)));
+  return true;
+}
+
 }  // namespace
 
 StatusOr<bool> RedundantConvertMover::Run(
@@ -89,6 +149,13 @@ StatusOr<bool> RedundantConvertMover::Run(
     for (HloInstruction* instr : computation->MakeInstructionPostOrder()) {
       bool changed = false;
       TF_ASSIGN_OR_RETURN(changed, RemoveRedundantConversion(instr));
+      if (!changed) {
+        TF_ASSIGN_OR_RETURN(changed, FoldOperandConvertsIntoDot(instr));
+      }
+      if (!changed) {
+        TF_ASSIGN_OR_RETURN(changed,
+                            MoveWideningConvertAfterCollective(instr));
+      }
       any_changed |= changed;
     }
   }
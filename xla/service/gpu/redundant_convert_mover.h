@@ -24,6 +24,11 @@ limitations under the License.
 namespace xla {
 namespace gpu {
 
+// Removes converts that GEMM kernels and collectives don't need:
+//  - convert(bitcast(convert(bitcast(x)))) round trips that restore x,
+//  - F16/BF16 operands widened to F32 for a dot, which the GEMM reads as is,
+//  - widening converts before all-gather, all-to-all and collective-permute,
+//    which are moved after the collective so that it moves fewer bytes.
 class RedundantConvertMover : public HloModulePass {
  public:
   RedundantConvertMover() = default;
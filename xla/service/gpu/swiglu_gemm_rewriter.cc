@@ -0,0 +1,157 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/gpu/swiglu_gemm_rewriter.h"
+
+#include <cstdint>
+
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/layout_util.h"
+#include "xla/service/gpu/backend_configs.pb.h"
+#include "xla/service/gpu/ir_emission_utils.h"
+#include "xla/shape_util.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/statusor.h"
+
+namespace xla {
+namespace gpu {
+
+namespace {
+
+bool IsRowMajorMatrix(const Shape& shape) {
+  return shape.IsArray() && shape.rank() == 2 && shape.has_layout() &&
+         LayoutUtil::IsMonotonicWithDim0Major(shape.layout());
+}
+
+// Returns the GEMM computing `value` if the SwiGLU kernel can run it, `value`
+// is the GEMM or the result element of a GEMM returning a workspace.
+HloInstruction* GetGemm(HloInstruction* value) {
+  HloInstruction* gemm = value;
+  if (value->opcode() == HloOpcode::kGetTupleElement) {
+    gemm = value->mutable_operand(0);
+    if (value->tuple_index() != 0 || gemm->user_count() != 1) return nullptr;
+  } else if (value->shape().IsTuple()) {
+    return nullptr;
+  }
+  if (!IsLegacyCublasMatmul(*gemm) || gemm->HasControlDependencies() ||
+      gemm->operand_count() != 2) {
+    return nullptr;
+  }
+  auto gpu_config = gemm->backend_config<GpuBackendConfig>();
+  if (!gpu_config.ok()) return nullptr;
+  const GemmBackendConfig& config = gpu_config->gemm_backend_config();
+  const DotDimensionNumbers& dnums = config.dot_dimension_numbers();
+  if (config.epilogue() != GemmBackendConfig::DEFAULT ||
+      config.alpha_real() != 1.0 || config.alpha_imag() != 0.0 ||
+      config.beta() != 0.0 || dnums.lhs_batch_dimensions_size() != 0 ||
+      dnums.rhs_batch_dimensions_size() != 0 ||
+      dnums.lhs_contracting_dimensions_size() != 1 ||
+      dnums.lhs_contracting_dimensions(0) != 1 ||
+      dnums.rhs_contracting_dimensions_size() != 1 ||
+      dnums.rhs_contracting_dimensions(0) != 0) {
+    return nullptr;
+  }
+  const Shape& lhs = gemm->operand(0)->shape();
+  const Shape& rhs = gemm->operand(1)->shape();
+  if (!IsRowMajorMatrix(lhs) || !IsRowMajorMatrix(rhs) ||
+      !IsRowMajorMatrix(value->shape())) {
+    return nullptr;
+  }
+  PrimitiveType type = value->shape().element_type();
+  if ((type != F16 && type != BF16) || lhs.element_type() != type ||
+      rhs.element_type() != type) {
+    return nullptr;
+  }
+  // The kernels load rows with 8 byte aligned block loads.
+  if (rhs.dimensions(0) % 4 != 0 || rhs.dimensions(1) % 4 != 0) {
+    return nullptr;
+  }
+  return gemm;
+}
+
+// Returns x if `instr` is silu(x) = x * logistic(x) and nothing else uses
+// logistic(x).
+HloInstruction* GetSiluOperand(HloInstruction* instr) {
+  if (instr->opcode() != HloOpcode::kMultiply) return nullptr;
+  for (int64_t i = 0; i < 2; ++i) {
+    HloInstruction* x = instr->mutable_operand(i);
+    HloInstruction* logistic = instr->mutable_operand(1 - i);
+    if (logistic->opcode() == HloOpcode::kLogistic &&
+        logistic->operand(0) == x && logistic->user_count() == 1) {
+      return x;
+    }
+  }
+  return nullptr;
+}
+
+// Rewrites `instr` if it is the product of a SwiGLU block.
+StatusOr<bool> TryRewrite(HloComputation* computation, HloInstruction* instr) {
+  if (instr->opcode() != HloOpcode::kMultiply) return false;
+  for (int64_t i = 0; i < 2; ++i) {
+    HloInstruction* silu = instr->mutable_operand(i);
+    HloInstruction* up_value = instr->mutable_operand(1 - i);
+    if (silu->user_count() != 1 || up_value->user_count() != 1) continue;
+    HloInstruction* gate_value = GetSiluOperand(silu);
+    // The gate result is used by the multiply and the logistic of silu.
+    if (gate_value == nullptr || gate_value->user_count() != 2) continue;
+    HloInstruction* gate = GetGemm(gate_value);
+    HloInstruction* up = GetGemm(up_value);
+    if (gate == nullptr || up == nullptr || gate == up ||
+        gate->operand(0) != up->operand(0) ||
+        !ShapeUtil::Equal(gate->operand(1)->shape(),
+                          up->operand(1)->shape()) ||
+        !ShapeUtil::Equal(instr->shape(), gate_value->shape())) {
+      continue;
+    }
+    HloInstruction* fused =
+        computation->AddInstruction(HloInstruction::CreateCustomCall(
+            instr->shape(),
+            {gate->mutable_operand(0), gate->mutable_operand(1),
+             up->mutable_operand(1)},
+            kXetlaSwiGluGemmCallTarget));
+    fused->set_metadata(gate->metadata());
+    computation->parent()->SetAndUniquifyInstrName(fused, "swiglu_gemm");
+    TF_RETURN_IF_ERROR(computation->ReplaceInstruction(instr, fused));
+    return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+bool IsCustomCallToSwiGluGemm(const HloInstruction& hlo) {
+  return hlo.opcode() == HloOpcode::kCustomCall &&
+         hlo.custom_call_target() == kXetlaSwiGluGemmCallTarget;
+}
+
+StatusOr<bool> SwiGluGemmRewriter::Run(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  bool any_changed = false;
+  for (HloComputation* computation :
+       module->MakeNonfusionComputations(execution_threads)) {
+    // The GEMMs and the activation of a rewritten block precede it in post
+    // order, so the instructions removed by a rewrite were visited already.
+    for (HloInstruction* instr : computation->MakeInstructionPostOrder()) {
+      TF_ASSIGN_OR_RETURN(bool changed, TryRewrite(computation, instr));
+      any_changed |= changed;
+    }
+  }
+  return any_changed;
+}
+
+}  // namespace gpu
+}  // namespace xla
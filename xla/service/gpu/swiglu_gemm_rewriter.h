@@ -0,0 +1,57 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_GPU_SWIGLU_GEMM_REWRITER_H_
+#define XLA_SERVICE_GPU_SWIGLU_GEMM_REWRITER_H_
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/string_view.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/hlo_pass_interface.h"
+
+namespace xla {
+namespace gpu {
+
+// Custom call computing silu(x x w_gate) * (x x w_up) of its operands
+// (x, w_gate, w_up), the gated projection of a SwiGLU MLP block.
+inline constexpr absl::string_view kXetlaSwiGluGemmCallTarget =
+    "__xetla$swiglu_gemm";
+
+bool IsCustomCallToSwiGluGemm(const HloInstruction& hlo);
+
+// Fuses the gate and up projections of a SwiGLU block with the activation:
+//
+//   multiply(multiply(gemm(x, w_gate), logistic(gemm(x, w_gate))),
+//            gemm(x, w_up)) -> swiglu-gemm(x, w_gate, w_up)
+//
+// The up projection runs first and the gate projection multiplies it in its
+// epilogue, so neither GEMM result is read again by an elementwise fusion.
+// Only row-major F16 and BF16 GEMMs without an epilogue, batch dimensions or
+// scaling are fused.
+class SwiGluGemmRewriter : public HloModulePass {
+ public:
+  SwiGluGemmRewriter() = default;
+
+  absl::string_view name() const override { return "swiglu-gemm-rewriter"; }
+  StatusOr<bool> Run(
+      HloModule* module,
+      const absl::flat_hash_set<absl::string_view>& execution_threads) override;
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_GPU_SWIGLU_GEMM_REWRITER_H_
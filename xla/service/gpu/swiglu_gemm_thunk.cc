@@ -0,0 +1,112 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/gpu/swiglu_gemm_thunk.h"
+
+#include <cstdint>
+
+#include <xetla.hpp>
+#include "absl/strings/str_cat.h"
+#include "xla/primitive_util.h"
+#include "xla/service/gpu/buffer_allocations.h"
+#include "xla/service/gpu/matrix_descriptor.h"
+#include "xla/service/gpu/xetla/gemm/gemm.h"
+#include "xla/stream_executor/blas.h"
+#include "xla/stream_executor/gpu/gpu_stream.h"
+
+namespace xla {
+namespace gpu {
+
+namespace {
+
+MatrixDescriptor RowMajorMatrix(se::DeviceMemoryBase data, int64_t rows,
+                                int64_t cols) {
+  return MatrixDescriptor{data, se::blas::Transpose::kNoTranspose, rows, cols,
+                          /*batch_stride=*/0, /*leading_dim_stride=*/cols};
+}
+
+template <typename T>
+absl::Status RunSwiGluGemm(se::gpu::GpuStreamHandle handle, int64_t m,
+                           int64_t n, int64_t k, se::DeviceMemoryBase lhs_data,
+                           se::DeviceMemoryBase gate_data,
+                           se::DeviceMemoryBase up_data,
+                           se::DeviceMemoryBase output_data) {
+  using Kernel = ::gpu::xetla::XetlaGemmKernel<T>;
+  MatrixDescriptor lhs = RowMajorMatrix(lhs_data, m, k);
+  MatrixDescriptor gate = RowMajorMatrix(gate_data, k, n);
+  MatrixDescriptor up = RowMajorMatrix(up_data, k, n);
+  MatrixDescriptor output = RowMajorMatrix(output_data, m, n);
+
+  // Each output tile is read by the epilogue of the work group storing it, so
+  // the gate projection can multiply the up projection in place.
+  auto up_kernel =
+      Kernel().add_matrix_c(output).add_matrix_a(lhs).add_matrix_b(up).build();
+  auto gate_kernel = Kernel()
+                         .add_matrix_c(output)
+                         .add_matrix_a(lhs)
+                         .add_matrix_b(gate)
+                         .add_epilogue(nullptr, Kernel::EpilogueType::SILU)
+                         .add_epilogue(output_data.opaque(),
+                                       Kernel::EpilogueType::RES_MUL)
+                         .build();
+  if (up_kernel.fallback() || gate_kernel.fallback() ||
+      !up_kernel.run(handle) || !gate_kernel.run(handle)) {
+    return absl::InternalError(absl::StrCat(
+        "Unsupported SwiGLU GEMM with M=", m, ", N=", n, " and K=", k));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+SwiGluGemmThunk::SwiGluGemmThunk(ThunkInfo thunk_info, PrimitiveType type,
+                                 int64_t m, int64_t n, int64_t k,
+                                 BufferAllocation::Slice lhs,
+                                 BufferAllocation::Slice gate,
+                                 BufferAllocation::Slice up,
+                                 BufferAllocation::Slice output)
+    : Thunk(Kind::kGemm, thunk_info),
+      type_(type),
+      m_(m),
+      n_(n),
+      k_(k),
+      lhs_(lhs),
+      gate_(gate),
+      up_(up),
+      output_(output) {}
+
+absl::Status SwiGluGemmThunk::ExecuteOnStream(const ExecuteParams& params) {
+  se::gpu::GpuStreamHandle handle = se::gpu::AsGpuStreamValue(params.stream);
+  const BufferAllocations& allocs = *params.buffer_allocations;
+  se::DeviceMemoryBase lhs = allocs.GetDeviceAddress(lhs_);
+  se::DeviceMemoryBase gate = allocs.GetDeviceAddress(gate_);
+  se::DeviceMemoryBase up = allocs.GetDeviceAddress(up_);
+  se::DeviceMemoryBase output = allocs.GetDeviceAddress(output_);
+  switch (type_) {
+    case F16:
+      return RunSwiGluGemm<sycl::half>(handle, m_, n_, k_, lhs, gate, up,
+                                       output);
+    case BF16:
+      return RunSwiGluGemm<::gpu::xetla::bf16>(handle, m_, n_, k_, lhs, gate,
+                                               up, output);
+    default:
+      return absl::InternalError(
+          absl::StrCat("Unsupported SwiGLU GEMM type ",
+                       primitive_util::LowercasePrimitiveTypeName(type_)));
+  }
+}
+
+}  // namespace gpu
+}  // namespace xla
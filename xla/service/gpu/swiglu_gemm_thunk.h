@@ -0,0 +1,55 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_GPU_SWIGLU_GEMM_THUNK_H_
+#define XLA_SERVICE_GPU_SWIGLU_GEMM_THUNK_H_
+
+#include <cstdint>
+
+#include "absl/status/status.h"
+#include "xla/service/buffer_assignment.h"
+#include "xla/service/gpu/thunk.h"
+#include "xla/xla_data.pb.h"
+
+namespace xla {
+namespace gpu {
+
+// Thunk of the custom calls built by SwiGluGemmRewriter. The up projection is
+// written to the output, which the gate projection then multiplies with its
+// SiLU activation in the XeTLA epilogue.
+class SwiGluGemmThunk : public Thunk {
+ public:
+  SwiGluGemmThunk(ThunkInfo thunk_info, PrimitiveType type, int64_t m,
+                  int64_t n, int64_t k, BufferAllocation::Slice lhs,
+                  BufferAllocation::Slice gate, BufferAllocation::Slice up,
+                  BufferAllocation::Slice output);
+
+  absl::Status ExecuteOnStream(const ExecuteParams& params) override;
+
+ private:
+  const PrimitiveType type_;
+  const int64_t m_;
+  const int64_t n_;
+  const int64_t k_;
+  const BufferAllocation::Slice lhs_;
+  const BufferAllocation::Slice gate_;
+  const BufferAllocation::Slice up_;
+  const BufferAllocation::Slice output_;
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_GPU_SWIGLU_GEMM_THUNK_H_
@@ -0,0 +1,67 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_GPU_SYCL_FFI_H_
+#define XLA_SERVICE_GPU_SYCL_FFI_H_
+
+#include <optional>
+
+#include "xla/ffi/api/c_api.h"
+#include "xla/ffi/ffi.h"
+#include "xla/service/service_executable_run_options.h"
+#include "xla/stream_executor/gpu/gpu_stream.h"
+#include "xla/stream_executor/sycl/sycl_gpu_runtime.h"
+
+namespace xla::ffi {
+
+// Execution context of typed XLA FFI custom calls on XPU giving the handler
+// the in-order SYCL queue the custom call runs on, to which it submits its
+// kernels directly:
+//
+//   XLA_FFI_DEFINE_HANDLER(kMyKernel, MyKernel,
+//                          Ffi::Bind()
+//                              .Ctx<SyclQueue>()
+//                              .Arg<BufferBase>()
+//                              .Ret<BufferBase>()
+//                              .Attr<float>("alpha"));
+//
+// Unlike the legacy custom calls, which get opaque buffer pointers and parse
+// their backend config string on every call, the attributes of typed
+// handlers are decoded from the backend config once when the custom call is
+// compiled. Handlers are registered from Python with api_version=1, see
+// xla/python/xpu_plugin_extension.cc.
+struct SyclQueue {};
+
+template <>
+struct CtxDecoding<SyclQueue> {
+  using Type = sycl::queue*;
+
+  static std::optional<Type> Decode(const XLA_FFI_Api* api,
+                                    XLA_FFI_ExecutionContext* ctx,
+                                    DiagnosticEngine& diagnostic) {
+    std::optional<const ServiceExecutableRunOptions*> run_options =
+        CtxDecoding<ServiceExecutableRunOptions>::Decode(api, ctx, diagnostic);
+    if (!run_options.has_value() || *run_options == nullptr ||
+        (*run_options)->stream() == nullptr) {
+      diagnostic.Emit("Custom call is not running on a SYCL queue");
+      return std::nullopt;
+    }
+    return stream_executor::gpu::AsGpuStreamValue((*run_options)->stream());
+  }
+};
+
+}  // namespace xla::ffi
+
+#endif  // XLA_SERVICE_GPU_SYCL_FFI_H_
@@ -0,0 +1,192 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/gpu/weight_only_quantized_dot_rewriter.h"
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/layout_util.h"
+#include "xla/service/gpu/backend_configs.pb.h"
+#include "xla/service/pattern_matcher.h"
+#include "xla/shape_util.h"
+#include "tsl/platform/errors.h"
+
+namespace xla {
+namespace gpu {
+
+namespace {
+namespace m = match;
+
+struct QuantizedWeights {
+  HloInstruction* weights = nullptr;
+  // Scales of the columns [n], or of the groups of K [k / group_size, n].
+  HloInstruction* scales = nullptr;
+};
+
+bool IsRowMajor(const Shape& shape) {
+  return shape.IsArray() && shape.has_layout() &&
+         LayoutUtil::IsMonotonicWithDim0Major(shape.layout());
+}
+
+bool IsQuantizedWeightType(PrimitiveType type) {
+  return type == S8 || type == U8 || type == S4 || type == U4;
+}
+
+// Matches convert(weights) to `type`.
+bool MatchConvertedWeights(HloInstruction* instr, PrimitiveType type,
+                           HloInstruction** weights) {
+  return Match(instr, m::Convert(m::Op(weights))) &&
+         instr->shape().element_type() == type &&
+         IsQuantizedWeightType((*weights)->shape().element_type()) &&
+         IsRowMajor((*weights)->shape());
+}
+
+// Matches multiply(convert(weights), broadcast(scales)) in either order, where
+// the scales are broadcast along `scale_dims`.
+bool MatchScaledWeights(HloInstruction* instr, PrimitiveType type,
+                        const std::vector<int64_t>& scale_dims,
+                        QuantizedWeights* result) {
+  if (instr->opcode() != HloOpcode::kMultiply) return false;
+  for (int64_t i = 0; i < 2; ++i) {
+    HloInstruction* broadcast = instr->mutable_operand(1 - i);
+    if (!MatchConvertedWeights(instr->mutable_operand(i), type,
+                               &result->weights) ||
+        broadcast->opcode() != HloOpcode::kBroadcast ||
+        broadcast->dimensions() != scale_dims) {
+      continue;
+    }
+    result->scales = broadcast->mutable_operand(0);
+    if (result->scales->shape().element_type() == type &&
+        IsRowMajor(result->scales->shape())) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns the integer weights and scales that `rhs` of a dot dequantizes.
+std::optional<QuantizedWeights> MatchQuantizedWeights(
+    HloInstruction* rhs, int64_t contracting_dim, PrimitiveType type) {
+  QuantizedWeights result;
+  if (MatchConvertedWeights(rhs, type, &result.weights)) return result;
+  // The scales of the columns are broadcast along N.
+  if (MatchScaledWeights(rhs, type, {1 - contracting_dim}, &result)) {
+    return result;
+  }
+  // The scales of groups are broadcast along the first and last dimension of
+  // the weights [k / group_size, group_size, n], which are reshaped to [k, n].
+  if (contracting_dim != 0 ||
+      (rhs->opcode() != HloOpcode::kReshape &&
+       rhs->opcode() != HloOpcode::kBitcast) ||
+      !MatchScaledWeights(rhs->mutable_operand(0), type, {0, 2}, &result)) {
+    return std::nullopt;
+  }
+  const Shape& weights = result.weights->shape();
+  if (weights.rank() != 3 ||
+      weights.dimensions(2) != rhs->shape().dimensions(1)) {
+    return std::nullopt;
+  }
+  return result;
+}
+
+// Returns `instr` reshaped to `dimensions` by a bitcast, keeping the element
+// size of the layout of packed 4-bit types.
+HloInstruction* BitcastToRowMajor(HloInstruction* instr,
+                                  absl::Span<const int64_t> dimensions) {
+  if (instr->shape().dimensions() == dimensions) return instr;
+  Shape shape =
+      ShapeUtil::MakeShapeWithDenseLayout(instr->shape().element_type(),
+                                          dimensions, {1, 0});
+  shape.mutable_layout()->set_element_size_in_bits(
+      instr->shape().layout().element_size_in_bits());
+  return instr->parent()->AddInstruction(
+      HloInstruction::CreateBitcast(shape, instr));
+}
+
+StatusOr<bool> RewriteQuantizedDot(HloInstruction* dot) {
+  if (dot->opcode() != HloOpcode::kDot || dot->HasControlDependencies()) {
+    return false;
+  }
+  const DotDimensionNumbers& dnums = dot->dot_dimension_numbers();
+  HloInstruction* lhs = dot->mutable_operand(0);
+  HloInstruction* rhs = dot->mutable_operand(1);
+  PrimitiveType type = dot->shape().element_type();
+  if ((type != F16 && type != BF16) || lhs->shape().element_type() != type ||
+      lhs->shape().rank() != 2 || rhs->shape().rank() != 2 ||
+      !IsRowMajor(lhs->shape()) || !IsRowMajor(dot->shape()) ||
+      dnums.lhs_batch_dimensions_size() != 0 ||
+      dnums.lhs_contracting_dimensions_size() != 1 ||
+      dnums.lhs_contracting_dimensions(0) != 1 ||
+      dnums.rhs_contracting_dimensions_size() != 1) {
+    return false;
+  }
+  int64_t contracting_dim = dnums.rhs_contracting_dimensions(0);
+  std::optional<QuantizedWeights> quantized =
+      MatchQuantizedWeights(rhs, contracting_dim, type);
+  if (!quantized.has_value()) return false;
+
+  int64_t k = lhs->shape().dimensions(1);
+  int64_t n = dot->shape().dimensions(1);
+  std::vector<HloInstruction*> operands = {
+      lhs, BitcastToRowMajor(quantized->weights, rhs->shape().dimensions())};
+  if (quantized->scales != nullptr) {
+    const Shape& scales = quantized->scales->shape();
+    int64_t num_groups = scales.rank() == 1 ? 1 : scales.dimensions(0);
+    if (k % num_groups != 0) return false;
+    operands.push_back(BitcastToRowMajor(quantized->scales, {num_groups, n}));
+  }
+
+  HloComputation* computation = dot->parent();
+  HloInstruction* gemm =
+      computation->AddInstruction(HloInstruction::CreateCustomCall(
+          dot->shape(), operands, kWeightOnlyQuantizedGemmCallTarget));
+  GpuBackendConfig gpu_config;
+  *gpu_config.mutable_gemm_backend_config()->mutable_dot_dimension_numbers() =
+      dnums;
+  TF_RETURN_IF_ERROR(gemm->set_backend_config(gpu_config));
+  gemm->set_metadata(dot->metadata());
+  TF_RETURN_IF_ERROR(computation->ReplaceInstruction(dot, gemm));
+  return true;
+}
+
+}  // namespace
+
+bool IsCustomCallToWeightOnlyQuantizedGemm(const HloInstruction& hlo) {
+  return hlo.opcode() == HloOpcode::kCustomCall &&
+         hlo.custom_call_target() == kWeightOnlyQuantizedGemmCallTarget;
+}
+
+StatusOr<bool> WeightOnlyQuantizedDotRewriter::Run(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  bool any_changed = false;
+  for (HloComputation* computation :
+       module->MakeNonfusionComputations(execution_threads)) {
+    for (HloInstruction* instr : computation->MakeInstructionPostOrder()) {
+      bool changed = false;
+      TF_ASSIGN_OR_RETURN(changed, RewriteQuantizedDot(instr));
+      any_changed |= changed;
+    }
+  }
+  return any_changed;
+}
+
+}  // namespace gpu
+}  // namespace xla
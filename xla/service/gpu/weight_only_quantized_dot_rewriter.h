@@ -0,0 +1,62 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_GPU_WEIGHT_ONLY_QUANTIZED_DOT_REWRITER_H_
+#define XLA_SERVICE_GPU_WEIGHT_ONLY_QUANTIZED_DOT_REWRITER_H_
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/string_view.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/hlo_pass_interface.h"
+
+namespace xla {
+namespace gpu {
+
+// Custom call of a GEMM with integer weights. Operands are the activations
+// [m, k], the integer weights [k, n] (or [n, k], see the dot dimension numbers
+// in the GemmBackendConfig) and optionally the scales [k / group_size, n] in
+// the element type of the activations.
+inline constexpr absl::string_view kWeightOnlyQuantizedGemmCallTarget =
+    "__onednn$weight_only_quantized_gemm";
+
+bool IsCustomCallToWeightOnlyQuantizedGemm(const HloInstruction& hlo);
+
+// Rewrites dots with dequantized integer weights into weight-only quantized
+// GEMMs, which only read the integer weights from memory:
+//
+//   dot(x, convert(w))
+//   dot(x, multiply(convert(w), broadcast(scales)))
+//   dot(x, reshape(multiply(convert(w), broadcast(scales))))
+//
+// w is S8, U8, S4 or U4 and x is F16 or BF16. The scales are per column of the
+// weights, or per group of K in the last form, where w is [k / group_size,
+// group_size, n] and the scales [k / group_size, n].
+class WeightOnlyQuantizedDotRewriter : public HloModulePass {
+ public:
+  WeightOnlyQuantizedDotRewriter() = default;
+
+  absl::string_view name() const override {
+    return "weight-only-quantized-dot-rewriter";
+  }
+  StatusOr<bool> Run(
+      HloModule* module,
+      const absl::flat_hash_set<absl::string_view>& execution_threads) override;
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_GPU_WEIGHT_ONLY_QUANTIZED_DOT_REWRITER_H_
@@ -0,0 +1,88 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/gpu/weight_only_quantized_gemm_thunk.h"
+
+#include <cstdint>
+#include <memory>
+
+#include "xla/service/gpu/backend_configs.pb.h"
+#include "xla/service/gpu/buffer_allocations.h"
+#include "xla/stream_executor/scratch_allocator.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/statusor.h"
+
+namespace xla {
+namespace gpu {
+
+WeightOnlyQuantizedGemmThunk::WeightOnlyQuantizedGemmThunk(
+    ThunkInfo thunk_info, WeightOnlyQuantizedGemmConfig config,
+    BufferAllocation::Slice lhs, BufferAllocation::Slice weights,
+    BufferAllocation::Slice scales, BufferAllocation::Slice output)
+    : Thunk(Kind::kGemm, thunk_info),
+      config_(config),
+      lhs_(lhs),
+      weights_(weights),
+      scales_(scales),
+      output_(output) {}
+
+absl::StatusOr<std::unique_ptr<WeightOnlyQuantizedGemmThunk>>
+WeightOnlyQuantizedGemmThunk::Create(ThunkInfo thunk_info,
+                                     const HloCustomCallInstruction* instr,
+                                     BufferAllocation::Slice lhs,
+                                     BufferAllocation::Slice weights,
+                                     BufferAllocation::Slice scales,
+                                     BufferAllocation::Slice output) {
+  TF_RET_CHECK(instr->operand_count() == 2 || instr->operand_count() == 3);
+  TF_ASSIGN_OR_RETURN(auto gpu_config,
+                      instr->backend_config<GpuBackendConfig>());
+  const DotDimensionNumbers& dnums =
+      gpu_config.gemm_backend_config().dot_dimension_numbers();
+  TF_RET_CHECK(dnums.rhs_contracting_dimensions_size() == 1);
+  const Shape& lhs_shape = instr->operand(0)->shape();
+  const Shape& weights_shape = instr->operand(1)->shape();
+
+  WeightOnlyQuantizedGemmConfig config;
+  config.type = lhs_shape.element_type();
+  config.weight_type = weights_shape.element_type();
+  config.packed_weights = weights_shape.layout().element_size_in_bits() == 4;
+  config.transpose_weights = dnums.rhs_contracting_dimensions(0) == 1;
+  config.m = instr->shape().dimensions(0);
+  config.n = instr->shape().dimensions(1);
+  config.k = lhs_shape.dimensions(1);
+  if (instr->operand_count() == 3) {
+    config.group_size = config.k / instr->operand(2)->shape().dimensions(0);
+  }
+  return std::make_unique<WeightOnlyQuantizedGemmThunk>(
+      thunk_info, config, lhs, weights, scales, output);
+}
+
+absl::Status WeightOnlyQuantizedGemmThunk::ExecuteOnStream(
+    const ExecuteParams& params) {
+  const BufferAllocations& allocs = *params.buffer_allocations;
+  se::DeviceMemoryBase scales;
+  if (scales_.allocation() != nullptr) {
+    scales = allocs.GetDeviceAddress(scales_);
+  }
+  se::OwningScratchAllocator<> scratch_allocator(allocs.device_ordinal(),
+                                                 allocs.memory_allocator());
+  return RunWeightOnlyQuantizedGemm(
+      config_, allocs.GetDeviceAddress(lhs_), allocs.GetDeviceAddress(weights_),
+      scales, allocs.GetDeviceAddress(output_), params.stream,
+      &scratch_allocator);
+}
+
+}  // namespace gpu
+}  // namespace xla
@@ -0,0 +1,61 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_GPU_WEIGHT_ONLY_QUANTIZED_GEMM_THUNK_H_
+#define XLA_SERVICE_GPU_WEIGHT_ONLY_QUANTIZED_GEMM_THUNK_H_
+
+#include <memory>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "xla/hlo/ir/hlo_instructions.h"
+#include "xla/service/buffer_assignment.h"
+#include "xla/service/gpu/onednn_matmul_utils.h"
+#include "xla/service/gpu/thunk.h"
+
+namespace xla {
+namespace gpu {
+
+// Thunk of the custom calls built by WeightOnlyQuantizedDotRewriter, runs a
+// oneDNN matmul that dequantizes the integer weights while it loads them.
+class WeightOnlyQuantizedGemmThunk : public Thunk {
+ public:
+  WeightOnlyQuantizedGemmThunk(ThunkInfo thunk_info,
+                               WeightOnlyQuantizedGemmConfig config,
+                               BufferAllocation::Slice lhs,
+                               BufferAllocation::Slice weights,
+                               BufferAllocation::Slice scales,
+                               BufferAllocation::Slice output);
+
+  // `scales` is an empty slice if the weights are not scaled.
+  static absl::StatusOr<std::unique_ptr<WeightOnlyQuantizedGemmThunk>> Create(
+      ThunkInfo thunk_info, const HloCustomCallInstruction* instr,
+      BufferAllocation::Slice lhs, BufferAllocation::Slice weights,
+      BufferAllocation::Slice scales, BufferAllocation::Slice output);
+
+  absl::Status ExecuteOnStream(const ExecuteParams& params) override;
+
+ private:
+  const WeightOnlyQuantizedGemmConfig config_;
+  const BufferAllocation::Slice lhs_;
+  const BufferAllocation::Slice weights_;
+  const BufferAllocation::Slice scales_;
+  const BufferAllocation::Slice output_;
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_GPU_WEIGHT_ONLY_QUANTIZED_GEMM_THUNK_H_
@@ -179,6 +179,86 @@ struct res_op_t {
   }
 };
 
+// Multiplies the accumulators with an input of the shape of the output, like
+// the up projection gating a SiLU activation in a SwiGLU block.
+template <typename dtype_in_>
+struct mul_op_t {
+  using dtype_in = dtype_in_;
+  using mem_desc_in_t =
+      mem_desc_t<dtype_in, mem_layout::row_major, mem_space::global>;
+  using shape_t = typename mem_desc_in_t::shape_t;
+  using coord_t = typename mem_desc_in_t::coord_t;
+  using base_t = typename mem_desc_in_t::base_t;
+
+  struct arguments_t {
+    shape_t shape;
+    base_t base;
+    float x;
+    inline arguments_t() = default;
+    inline arguments_t(base_t base_, shape_t shape_, float x_)
+        : base(base_), shape(shape_), x(x_) {}
+  };
+  template <typename matAcc_t>
+  __XETLA_API KERNEL_FUNC void operator()(matAcc_t& matAcc,
+                                          const coord_t& coord,
+                                          const arguments_t& args,
+                                          uint32_t slm_base = 0,
+                                          uint32_t nbarrier_base = 0) {
+    using dtype_acc = typename matAcc_t::dtype;
+    static constexpr uint32_t tile_size_x = matAcc_t::tile_size_x;
+    static constexpr uint32_t tile_size_y = matAcc_t::tile_size_y;
+    static constexpr uint32_t block_size_x = matAcc_t::block_size_x;
+    static constexpr uint32_t block_size_y = matAcc_t::block_size_y;
+    static constexpr int32_t num_block_x = matAcc_t::num_block_x;
+    static constexpr int32_t num_block_y = matAcc_t::num_block_y;
+    static constexpr uint32_t tile_elems = matAcc_t::tile_elems;
+    static constexpr uint32_t block_elems = matAcc_t::block_elems;
+
+    using mat_in_tile_desc_t =
+        subgroup::tile_desc_t<tile_size_x, tile_size_y, block_size_x,
+                              block_size_y, reg_layout::tiled>;
+    using mat_in_tile_t = subgroup::tile_t<dtype_in, mat_in_tile_desc_t>;
+    using mat_in_payload_t = subgroup::mem_payload_t<
+        mem_desc_in_t, mat_in_tile_desc_t,
+        subgroup::msg_type_v<mat_in_tile_desc_t, mem_desc_in_t::space>,
+        gpu_arch::Xe>;
+    using mat_in_tile_acc_t = subgroup::tile_t<dtype_acc, mat_in_tile_desc_t>;
+    mem_desc_in_t mem_desc_in(args.base, args.shape, coord);
+    mat_in_tile_t mat_in;
+    mat_in_payload_t mat_in_payload(mem_desc_in);
+    tile_load<cache_hint::cached, cache_hint::cached>(mat_in, mat_in_payload);
+    mat_in_tile_acc_t mat_in_acc;
+    elemwise_cvt(mat_in_acc, mat_in);
+
+#pragma unroll
+    for (int i = 0; i < tile_size_y / block_size_y; i++) {
+#pragma unroll
+      for (int j = 0; j < num_block_x; j++) {
+        auto dst_reg = matAcc.reg.xetla_select<block_elems, 1>(
+            (i * num_block_x + j) * block_elems);
+        auto src_reg = mat_in_acc.reg.xetla_select<block_elems, 1>(
+            (i * num_block_x + j) * block_elems);
+        dst_reg = dst_reg * (args.x * src_reg);
+      }
+    }
+    // process the tail
+    if constexpr ((tile_size_y % block_size_y) != 0) {
+      constexpr uint32_t tail_start_y =
+          tile_size_y / block_size_y * block_size_y;
+      constexpr int32_t tail_size_y = tile_size_y % block_size_y;
+      constexpr int32_t tail_block_elems = tail_size_y * block_size_x;
+#pragma unroll
+      for (int j = 0; j < num_block_x; j++) {
+        auto dst_reg = matAcc.reg.xetla_select<tail_block_elems, 1>(
+            tail_start_y * tile_size_x + j * tail_block_elems);
+        auto src_reg = mat_in_acc.reg.xetla_select<tail_block_elems, 1>(
+            tail_start_y * tile_size_x + j * tail_block_elems);
+        dst_reg = dst_reg * (args.x * src_reg);
+      }
+    }
+  }
+};
+
 template <typename dtype_bias_>
 struct bias_op_t {
   using dtype_bias = dtype_bias_;
@@ -274,6 +354,109 @@ struct bias_op_t {
   }
 };
 
+// Applies rotary position embeddings to the accumulators, which hold heads of
+// `head_size` columns side by side. Rotated pairs are adjacent columns (the
+// interleaved layout of GPT-J) so that a pair never leaves a register block.
+// cos and sin are [m, head_size] tables gathered for the position of every
+// row, with the angle of a pair repeated for both of its columns. Columns past
+// the rotary dimension of a partial rotation have cos 1 and sin 0. The tile
+// width of the GEMM must divide `head_size`.
+template <typename dtype_in_>
+struct rotary_op_t {
+  using dtype_in = dtype_in_;
+  using mem_desc_in_t =
+      mem_desc_t<dtype_in, mem_layout::row_major, mem_space::global>;
+  using shape_t = typename mem_desc_in_t::shape_t;
+  using coord_t = typename mem_desc_in_t::coord_t;
+  using base_t = typename mem_desc_in_t::base_t;
+
+  struct arguments_t {
+    shape_t shape;
+    base_t cos_base;
+    base_t sin_base;
+    uint32_t head_size;
+    // Outputs that are not rotated, like V of a QKV GEMM, leave this unset.
+    bool enabled = false;
+    inline arguments_t() = default;
+    inline arguments_t(base_t cos_base_, base_t sin_base_, shape_t shape_,
+                       uint32_t head_size_, bool enabled_)
+        : cos_base(cos_base_),
+          sin_base(sin_base_),
+          shape(shape_),
+          head_size(head_size_),
+          enabled(enabled_) {}
+  };
+  template <typename matAcc_t>
+  __XETLA_API KERNEL_FUNC void operator()(matAcc_t& matAcc,
+                                          const coord_t& coord,
+                                          const arguments_t& args,
+                                          uint32_t slm_base = 0,
+                                          uint32_t nbarrier_base = 0) {
+    if (!args.enabled) return;
+    using dtype_acc = typename matAcc_t::dtype;
+    static constexpr uint32_t tile_size_x = matAcc_t::tile_size_x;
+    static constexpr uint32_t tile_size_y = matAcc_t::tile_size_y;
+    static constexpr uint32_t block_size_x = matAcc_t::block_size_x;
+    static constexpr uint32_t block_size_y = matAcc_t::block_size_y;
+    static constexpr uint32_t tile_elems = matAcc_t::tile_elems;
+    static_assert(block_size_x % 2 == 0,
+                  "rotated pairs must not straddle register blocks");
+
+    using mat_in_tile_desc_t =
+        subgroup::tile_desc_t<tile_size_x, tile_size_y, block_size_x,
+                              block_size_y, reg_layout::tiled>;
+    using mat_in_tile_t = subgroup::tile_t<dtype_in, mat_in_tile_desc_t>;
+    using mat_in_payload_t = subgroup::mem_payload_t<
+        mem_desc_in_t, mat_in_tile_desc_t,
+        subgroup::msg_type_v<mat_in_tile_desc_t, mem_desc_in_t::space>,
+        gpu_arch::Xe>;
+    using mat_in_tile_acc_t = subgroup::tile_t<dtype_acc, mat_in_tile_desc_t>;
+    // The tile lies within one head, so it reads the tables at its offset in
+    // the head.
+    coord_t table_coord(coord.x % args.head_size, coord.y);
+    mem_desc_in_t mem_desc_cos(args.cos_base, args.shape, table_coord);
+    mem_desc_in_t mem_desc_sin(args.sin_base, args.shape, table_coord);
+    mat_in_tile_t mat_in;
+    mat_in_payload_t cos_payload(mem_desc_cos);
+    tile_load<cache_hint::cached, cache_hint::cached>(mat_in, cos_payload);
+    mat_in_tile_acc_t cos_acc;
+    elemwise_cvt(cos_acc, mat_in);
+    mat_in_payload_t sin_payload(mem_desc_sin);
+    tile_load<cache_hint::cached, cache_hint::cached>(mat_in, sin_payload);
+    mat_in_tile_acc_t sin_acc;
+    elemwise_cvt(sin_acc, mat_in);
+
+    // Blocks are stored row by row with an even width, so the pairs are the
+    // even and odd elements of the whole tile, tail included.
+    constexpr uint32_t half_elems = tile_elems / 2;
+    xetla_vector<dtype_acc, half_elems> even =
+        matAcc.reg.xetla_select<half_elems, 2>(0);
+    xetla_vector<dtype_acc, half_elems> odd =
+        matAcc.reg.xetla_select<half_elems, 2>(1);
+    auto cos = cos_acc.reg.xetla_select<half_elems, 2>(0);
+    auto sin = sin_acc.reg.xetla_select<half_elems, 2>(0);
+    matAcc.reg.xetla_select<half_elems, 2>(0) = even * cos - odd * sin;
+    matAcc.reg.xetla_select<half_elems, 2>(1) = odd * cos + even * sin;
+  }
+};
+
+// Scales the accumulators by alpha.
+struct scale_op_t {
+  struct arguments_t {
+    float x;
+    inline arguments_t() = default;
+    inline arguments_t(float x_) : x(x_) {}
+  };
+  template <typename matAcc_t, typename coord_t>
+  __XETLA_API KERNEL_FUNC void operator()(matAcc_t& matAcc,
+                                          const coord_t& coord,
+                                          const arguments_t& args,
+                                          uint32_t slm_base = 0,
+                                          uint32_t nbarrier_base = 0) {
+    matAcc.reg = matAcc.reg * args.x;
+  }
+};
+
 struct silu_op_t {
   struct arguments_t {};
   template <typename matAcc_t, typename coord_t>
@@ -287,6 +470,36 @@ struct silu_op_t {
   }
 };
 
+// Returns the arguments of `op_t` for batch `batch_id` of a strided batched
+// GEMM. Inputs of the shape of the output are `stride` elements apart, the
+// other inputs are shared by all the batches.
+template <typename op_t>
+struct batch_args_t {
+  static inline typename op_t::arguments_t get(
+      const typename op_t::arguments_t& args, uint64_t batch_id,
+      int64_t stride) {
+    return args;
+  }
+};
+
+template <typename dtype_in>
+struct batch_args_t<res_op_t<dtype_in>> {
+  static inline typename res_op_t<dtype_in>::arguments_t get(
+      const typename res_op_t<dtype_in>::arguments_t& args, uint64_t batch_id,
+      int64_t stride) {
+    return {args.base.base + batch_id * stride, args.shape, args.x};
+  }
+};
+
+template <typename dtype_in>
+struct batch_args_t<mul_op_t<dtype_in>> {
+  static inline typename mul_op_t<dtype_in>::arguments_t get(
+      const typename mul_op_t<dtype_in>::arguments_t& args, uint64_t batch_id,
+      int64_t stride) {
+    return {args.base.base + batch_id * stride, args.shape, args.x};
+  }
+};
+
 }  // namespace epilogue_impl
 
 }  // namespace xetla
@@ -15,250 +15,592 @@ limitations under the License.
 
 #include "xla/service/gpu/xetla/gemm/gemm.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/base/const_init.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/logging.h"
+#include "tsl/util/env_var.h"
 #include "xla/service/gpu/matrix_descriptor.h"
 #include "xla/service/gpu/xetla/gemm/hgemm_impl.h"
 #include "xla/stream_executor/blas.h"
 #include "xla/stream_executor/gpu/gpu_types.h"
+#include "xla/stream_executor/sycl/hw_info.h"
 #include "xla/stream_executor/sycl/sycl_stream.h"
+#include "xla/stream_executor/sycl/sycl_stream_local.h"
 
 namespace se = ::stream_executor;
 
 namespace gpu {
 namespace xetla {
 
-std::unordered_map<std::string, std::tuple<int, int, int, int, int, int>>
-    configMap = {{"1_4096_16384", std::make_tuple(128, 64, 16, 16, 64, 1)},
-                 {"1_16384_4096", std::make_tuple(8, 512, 8, 16, 16, 1)},
-                 {"1_4096_4096", std::make_tuple(128, 64, 16, 16, 64, 1)},
-                 {"4_16384_4096", std::make_tuple(8, 512, 8, 16, 16, 1)},
-                 {"4_4096_4096", std::make_tuple(128, 64, 16, 16, 64, 1)},
-                 {"4_4096_16384", std::make_tuple(128, 64, 16, 16, 64, 1)},
-                 {"4096_16384_4096", std::make_tuple(256, 256, 32, 64, 32, 1)},
-                 {"4096_4096_4096", std::make_tuple(256, 256, 32, 64, 32, 1)},
-                 {"4096_4096_16384", std::make_tuple(256, 256, 32, 64, 32, 1)},
-                 {"4_50400_4096", std::make_tuple(128, 512, 64, 32, 16, 1)},
-                 {"32_4096_16384", std::make_tuple(32, 64, 8, 16, 16, 2)},
-                 {"32_16384_4096", std::make_tuple(32, 512, 32, 16, 16, 1)},
-                 {"32_4096_4096", std::make_tuple(128, 64, 16, 16, 64, 1)},
-                 {"33_4096_16384", std::make_tuple(128, 64, 16, 16, 64, 1)},
-                 {"33_16384_4096", std::make_tuple(128, 512, 64, 32, 16, 1)},
-                 {"33_4096_4096", std::make_tuple(128, 64, 16, 16, 64, 1)},
-                 {"64_4096_16384", std::make_tuple(128, 64, 16, 16, 64, 1)},
-                 {"64_16384_4096", std::make_tuple(128, 256, 64, 16, 16, 1)},
-                 {"64_4096_4096", std::make_tuple(128, 64, 16, 16, 64, 1)},
-                 {"65_4096_16384", std::make_tuple(128, 64, 16, 16, 64, 1)},
-                 {"65_16384_4096", std::make_tuple(128, 256, 64, 16, 16, 1)},
-                 {"65_4096_4096", std::make_tuple(128, 64, 16, 16, 64, 1)},
-                 {"128_4096_16384", std::make_tuple(128, 128, 32, 32, 32, 2)},
-                 {"128_16384_4096", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"128_4096_4096", std::make_tuple(128, 128, 32, 32, 32, 2)},
-                 {"130_4096_16384", std::make_tuple(128, 128, 32, 32, 32, 2)},
-                 {"130_16384_4096", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"130_4096_4096", std::make_tuple(128, 128, 16, 32, 64, 1)},
-                 {"256_4096_16384", std::make_tuple(128, 128, 16, 32, 64, 1)},
-                 {"256_16384_4096", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"256_4096_4096", std::make_tuple(128, 128, 32, 32, 32, 2)},
-                 {"512_4096_16384", std::make_tuple(128, 256, 32, 32, 16, 1)},
-                 {"512_16384_4096", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"512_4096_4096", std::make_tuple(128, 128, 32, 32, 32, 2)},
-                 {"513_4096_16384", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"513_4096_4096", std::make_tuple(128, 512, 64, 32, 16, 1)},
-                 {"1024_4096_16384", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"1024_16384_4096", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"1024_4096_4096", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"1028_4096_16384", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"1028_16384_4096", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"1028_4096_4096", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"2016_4096_16384", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"2016_16384_4096", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"2016_4096_4096", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"1_50400_4096", std::make_tuple(128, 512, 64, 32, 16, 1)},
-                 {"1_50272_4096", std::make_tuple(128, 512, 64, 32, 16, 1)},
-                 {"4_50400_4096", std::make_tuple(128, 512, 64, 32, 16, 1)},
-                 {"4_50272_4096", std::make_tuple(128, 512, 64, 32, 16, 1)},
-                 {"1_250880_4096", std::make_tuple(32, 64, 8, 16, 16, 2)},
-                 {"4_250880_4096", std::make_tuple(32, 64, 8, 16, 16, 2)},
-                 {"1_11008_4096", std::make_tuple(16, 256, 8, 16, 16, 1)},
-                 {"4_11008_4096", std::make_tuple(16, 256, 8, 16, 16, 1)},
-                 {"32_11008_4096", std::make_tuple(64, 256, 64, 16, 16, 2)},
-                 {"64_11008_4096", std::make_tuple(64, 256, 64, 16, 16, 2)},
-                 {"128_11008_4096", std::make_tuple(128, 256, 32, 32, 16, 1)},
-                 {"256_11008_4096", std::make_tuple(256, 256, 32, 64, 32, 1)},
-                 {"512_11008_4096", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"1024_11008_4096", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"2016_11008_4096", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"1_32000_4096", std::make_tuple(256, 256, 32, 64, 16, 1)},
-                 {"4_32000_4096", std::make_tuple(256, 256, 32, 64, 16, 1)},
-                 {"1_13824_5120", std::make_tuple(256, 256, 32, 64, 16, 1)},
-                 {"1_5120_5120", std::make_tuple(8, 128, 8, 16, 16, 2)},
-                 {"4_13824_5120", std::make_tuple(128, 256, 64, 16, 16, 1)},
-                 {"4_5120_5120", std::make_tuple(8, 128, 8, 16, 16, 2)},
-                 {"32_13824_5120", std::make_tuple(128, 256, 64, 16, 16, 1)},
-                 {"32_5120_5120", std::make_tuple(32, 128, 32, 16, 16, 4)},
-                 {"64_13824_5120", std::make_tuple(128, 256, 32, 32, 16, 1)},
-                 {"64_5120_5120", std::make_tuple(128, 128, 16, 32, 64, 1)},
-                 {"128_13824_5120", std::make_tuple(128, 256, 32, 32, 16, 1)},
-                 {"128_5120_5120", std::make_tuple(128, 128, 16, 32, 64, 1)},
-                 {"256_13824_5120", std::make_tuple(256, 256, 32, 64, 32, 1)},
-                 {"256_5120_5120", std::make_tuple(128, 256, 32, 32, 16, 1)},
-                 {"512_13824_5120", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"512_5120_5120", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"1024_13824_5120", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"1024_5120_5120", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"2016_13824_5120", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"2016_5120_5120", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"1_32000_5120", std::make_tuple(256, 256, 32, 64, 16, 1)},
-                 {"4_32000_5120", std::make_tuple(256, 256, 32, 64, 16, 1)},
-                 {"1_7168_14336", std::make_tuple(8, 256, 8, 16, 16, 2)},
-                 {"1_1792_14336", std::make_tuple(16, 64, 16, 16, 16, 8)},
-                 {"4_7168_14336", std::make_tuple(8, 256, 8, 16, 16, 2)},
-                 {"4_1792_14336", std::make_tuple(16, 64, 16, 16, 16, 8)},
-                 {"32_7168_14336", std::make_tuple(32, 256, 32, 16, 16, 2)},
-                 {"32_1792_14336", std::make_tuple(16, 64, 16, 16, 16, 8)},
-                 {"1_14336_7168", std::make_tuple(128, 512, 64, 32, 16, 1)},
-                 {"1_14336_1792", std::make_tuple(16, 256, 8, 16, 16, 1)},
-                 {"4_14336_7168", std::make_tuple(128, 256, 64, 16, 16, 1)},
-                 {"4_14336_1792", std::make_tuple(128, 256, 32, 32, 16, 1)},
-                 {"32_14336_7168", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"32_14336_1792", std::make_tuple(128, 256, 32, 32, 16, 1)},
-                 {"1_250880_1792", std::make_tuple(16, 256, 8, 16, 16, 1)},
-                 {"1_2048_8192", std::make_tuple(8, 64, 8, 16, 32, 8)},
-                 {"1_3584_7168", std::make_tuple(32, 64, 8, 16, 16, 2)},
-                 {"1_7168_3584", std::make_tuple(128, 128, 16, 32, 64, 1)},
-                 {"1_7168_8192", std::make_tuple(128, 128, 16, 32, 64, 1)},
-                 {"1_8192_2048", std::make_tuple(128, 64, 16, 16, 64, 1)},
-                 {"1_8192_7168", std::make_tuple(8, 256, 8, 16, 16, 2)},
-                 {"1_256_8192", std::make_tuple(16, 64, 16, 16, 16, 8)},
-                 {"1_32000_2048", std::make_tuple(16, 256, 8, 16, 16, 1)},
-                 {"4_2048_8192", std::make_tuple(8, 64, 8, 16, 32, 8)},
-                 {"4_3584_7168", std::make_tuple(32, 64, 8, 16, 16, 2)},
-                 {"4_7168_3584", std::make_tuple(128, 128, 16, 32, 64, 1)},
-                 {"4_7168_8192", std::make_tuple(8, 256, 8, 16, 16, 2)},
-                 {"4_8192_2048", std::make_tuple(8, 256, 8, 16, 16, 2)},
-                 {"4_8192_7168", std::make_tuple(128, 256, 32, 32, 16, 1)},
-                 {"4_256_8192", std::make_tuple(16, 64, 16, 16, 16, 8)},
-                 {"4_32000_2048", std::make_tuple(256, 256, 32, 64, 16, 1)},
-                 {"1024_2048_8192", std::make_tuple(128, 256, 32, 32, 16, 1)},
-                 {"1024_7168_8192", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"1024_8192_2048", std::make_tuple(256, 256, 64, 32, 16, 1)},
-                 {"1024_8192_7168", std::make_tuple(256, 256, 32, 64, 32, 1)},
-                 {"1024_256_8192", std::make_tuple(32, 128, 32, 16, 16, 4)},
-                 // T5 model shape
-                 {"1_5120_2048", std::make_tuple(128, 128, 16, 32, 64, 1)},
-                 {"1_2048_2048", std::make_tuple(16, 64, 16, 16, 16, 8)},
-                 {"1_2048_5120", std::make_tuple(16, 64, 16, 16, 16, 8)},
-                 {"1_6144_2048", std::make_tuple(128, 128, 16, 32, 64, 1)},
-                 {"1_2048_2048", std::make_tuple(32, 64, 32, 16, 16, 8)},
-                 {"32_98304_2048", std::make_tuple(256, 256, 32, 64, 16, 1)},
-                 {"64_1_32", std::make_tuple(8, 256, 8, 16, 16, 2)},
-                 {"1_32_64", std::make_tuple(8, 256, 8, 16, 16, 2)},
-                 {"1_32128_2048", std::make_tuple(128, 256, 64, 16, 16, 1)},
-                 {"32_5120_2048", std::make_tuple(128, 128, 16, 32, 64, 1)},
-                 {"32_24576_32", std::make_tuple(32, 512, 32, 16, 16, 1)},
-                 {"32_6144_2048", std::make_tuple(128, 128, 16, 32, 64, 1)},
-                 {"32_2048_5120", std::make_tuple(16, 64, 16, 16, 16, 8)},
-                 {"32_2048_2048", std::make_tuple(16, 64, 16, 16, 16, 8)}};
+namespace {
+
+struct GemmPolicyDesc {
+  int wg_m, wg_n, sg_m, sg_n, sg_k, slm_ks;
+};
+
+// Tile policies (WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS) the GEMM kernels are
+// instantiated for. Any policy selected at runtime must be one of these.
+constexpr GemmPolicyDesc kGemmPolicies[] = {
+    {8, 64, 8, 16, 32, 8},      {8, 128, 8, 16, 16, 2},
+    {8, 128, 8, 16, 32, 4},     {8, 256, 8, 16, 16, 2},
+    {8, 512, 8, 16, 16, 1},     {16, 64, 16, 16, 16, 8},
+    {16, 256, 8, 16, 16, 1},    {16, 256, 16, 16, 16, 2},
+    {16, 512, 16, 16, 16, 1},   {32, 64, 32, 16, 16, 8},
+    {32, 64, 8, 16, 16, 2},     {32, 128, 32, 16, 16, 4},
+    {32, 256, 32, 16, 16, 2},   {32, 512, 32, 16, 16, 1},
+    {64, 128, 64, 16, 16, 4},   {64, 256, 64, 16, 16, 2},
+    {64, 512, 64, 16, 16, 1},   {128, 128, 32, 32, 32, 2},
+    {128, 256, 64, 16, 16, 1},  {128, 512, 64, 32, 16, 1},
+    {256, 256, 64, 32, 16, 1},  {256, 256, 32, 64, 16, 1},
+    {256, 256, 32, 64, 32, 1},  {128, 64, 16, 16, 64, 1},
+    {128, 128, 16, 32, 64, 1},  {128, 256, 32, 32, 16, 1},
+};
+
+constexpr GemmPolicyDesc kDefaultGemmPolicy = {256, 256, 32, 64, 16, 1};
+
+// Rough machine balance of an XMX engine: multiply-accumulates a hardware
+// thread retires in the time it takes to load one element from L1.
+constexpr double kMacsPerLoad = 8.0;
+
+// Fixed cost of a wave of work groups (launch, prefetch and epilogue), in
+// the same unit as the per-thread work below.
+constexpr double kWaveOverhead = 4096.0;
+
+// Cost of an atomic add or load of an element in global memory, relative to
+// a load from L1.
+constexpr double kSplitKLoadCost = 4.0 * kMacsPerLoad;
+
+// Numbers of K slices split-K GEMMs are instantiated for, and the largest M
+// they run for. Larger M have enough output tiles to fill the device.
+constexpr int kSplitKFactors[] = {2, 4, 8};
+constexpr int kMaxSplitKM = 32;
+
+enum class GemmKind { kGemm, kQKV };
+
+// (kind, bucket of M, N, K) of tuned configs and (kind, bucket of M, N, K,
+// batch size) of selected policies.
+using GemmKey = std::tuple<GemmKind, int, int, int>;
+using SelectionKey = std::tuple<GemmKind, int, int, int, int>;
+
+int64_t CeilOfRatio(int64_t a, int64_t b) { return (a + b - 1) / b; }
+
+// Sequence lengths of a workload vary from call to call, so M is rounded up
+// to a power of two (and to a multiple of 1024 beyond that) and all shapes of
+// a bucket share a policy.
+int BucketM(int m) {
+  if (m > 1024) return CeilOfRatio(m, 1024) * 1024;
+  int bucket = 1;
+  while (bucket < m) bucket <<= 1;
+  return bucket;
+}
+
+bool IsInstantiated(const GemmPolicyDesc& policy) {
+  for (const GemmPolicyDesc& p : kGemmPolicies) {
+    if (p.wg_m == policy.wg_m && p.wg_n == policy.wg_n &&
+        p.sg_m == policy.sg_m && p.sg_n == policy.sg_n &&
+        p.sg_k == policy.sg_k && p.slm_ks == policy.slm_ks) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::tuple<int, int, int, int, int, int> ToTuple(const GemmPolicyDesc& p) {
+  return std::make_tuple(p.wg_m, p.wg_n, p.sg_m, p.sg_n, p.sg_k, p.slm_ks);
+}
+
+// Estimated execution time of `policy` for `batch` products of shape m x n x
+// k, with K split between `splits` work groups. Work groups run in waves of
+// as many groups as the hardware threads of the device can hold, and every
+// thread of a wave computes an SG_M x SG_N tile over its slice of K, bound
+// either by XMX throughput or by the loads of its A rows and B columns.
+double EstimateGemmCost(const GemmPolicyDesc& policy, int64_t m, int64_t n,
+                        int64_t k, int64_t batch, int64_t hw_threads,
+                        int64_t splits = 1) {
+  int64_t groups = CeilOfRatio(m, policy.wg_m) *
+                   CeilOfRatio(n, policy.wg_n) * batch * splits;
+  int64_t threads_per_group = (policy.wg_m / policy.sg_m) *
+                              (policy.wg_n / policy.sg_n) * policy.slm_ks;
+  int64_t groups_per_wave =
+      std::max<int64_t>(1, hw_threads / threads_per_group);
+  int64_t waves = CeilOfRatio(groups, groups_per_wave);
+
+  int64_t k_per_thread =
+      CeilOfRatio(CeilOfRatio(k, policy.slm_ks * splits), policy.sg_k) *
+      policy.sg_k;
+  // Rows beyond M are masked out and never loaded.
+  int64_t rows = std::min<int64_t>(policy.sg_m, m);
+  double compute = static_cast<double>(policy.sg_m) * policy.sg_n;
+  double loads = kMacsPerLoad * static_cast<double>(rows + policy.sg_n);
+  double thread_cost = std::max(compute, loads) * k_per_thread;
+  if (policy.slm_ks > 1) {
+    // Partial sums of the K slices are reduced through SLM.
+    thread_cost += kMacsPerLoad * policy.sg_m * policy.sg_n;
+  }
+  if (splits > 1) {
+    // Partial sums are added atomically in global memory and read back by
+    // the last slice of the tile.
+    thread_cost += 2 * kSplitKLoadCost * policy.sg_m * policy.sg_n;
+  }
+  return waves * (thread_cost + kWaveOverhead);
+}
+
+// Tuned policies read from the file named by XETLA_GEMM_CONFIG_FILE. Every
+// non-empty line that is not a '#' comment has the form
+//   <gemm|qkv> M N K WG_M WG_N SG_M SG_N SG_K SLM_KS
+// and overrides the heuristic for all shapes in the bucket of M, whatever
+// their batch size.
+absl::flat_hash_map<GemmKey, GemmPolicyDesc> LoadTunedGemmConfigs() {
+  absl::flat_hash_map<GemmKey, GemmPolicyDesc> configs;
+  std::string path;
+  TF_CHECK_OK(tsl::ReadStringFromEnvVar("XETLA_GEMM_CONFIG_FILE", "", &path));
+  if (path.empty()) return configs;
+
+  std::string contents;
+  absl::Status status =
+      tsl::ReadFileToString(tsl::Env::Default(), path, &contents);
+  if (!status.ok()) {
+    LOG(WARNING) << "Failed to read XeTLA GEMM configs from " << path << ": "
+                 << status;
+    return configs;
+  }
+  for (absl::string_view line : absl::StrSplit(contents, '\n')) {
+    line = absl::StripAsciiWhitespace(line);
+    if (line.empty() || absl::StartsWith(line, "#")) continue;
+    std::vector<absl::string_view> fields =
+        absl::StrSplit(line, absl::ByAnyChar(" \t"), absl::SkipEmpty());
+    int values[9] = {};
+    bool valid = fields.size() == 10 &&
+                 (fields[0] == "gemm" || fields[0] == "qkv");
+    for (int i = 0; valid && i < 9; ++i) {
+      valid = absl::SimpleAtoi(fields[i + 1], &values[i]) && values[i] > 0;
+    }
+    GemmPolicyDesc policy = {values[3], values[4], values[5],
+                             values[6], values[7], values[8]};
+    if (!valid || !IsInstantiated(policy)) {
+      LOG(WARNING) << "Ignoring XeTLA GEMM config \"" << line << "\" in "
+                   << path;
+      continue;
+    }
+    GemmKind kind = fields[0] == "gemm" ? GemmKind::kGemm : GemmKind::kQKV;
+    configs[{kind, BucketM(values[0]), values[1], values[2]}] = policy;
+  }
+  VLOG(1) << "Loaded " << configs.size() << " XeTLA GEMM configs from "
+          << path;
+  return configs;
+}
+
+std::tuple<int, int, int, int, int, int> SelectGemmPolicy(GemmKind kind,
+                                                          int m, int n, int k,
+                                                          int batch) {
+  static absl::Mutex mu(absl::kConstInit);
+  static const auto* tuned =
+      new absl::flat_hash_map<GemmKey, GemmPolicyDesc>(LoadTunedGemmConfigs());
+  static auto* selected =
+      new absl::flat_hash_map<SelectionKey, GemmPolicyDesc>();
+  static const int64_t hw_threads =
+      static_cast<int64_t>(GetEUCount()) * GetHardwareThreadsPerEU();
+
+  int bucket = BucketM(m);
+  auto tuned_it = tuned->find(GemmKey{kind, bucket, n, k});
+  if (tuned_it != tuned->end()) return ToTuple(tuned_it->second);
+
+  SelectionKey key = {kind, bucket, n, k, batch};
+  absl::MutexLock lock(&mu);
+  auto it = selected->find(key);
+  if (it != selected->end()) return ToTuple(it->second);
+
+  GemmPolicyDesc best = kDefaultGemmPolicy;
+  if (hw_threads > 0) {
+    double best_cost = std::numeric_limits<double>::infinity();
+    for (const GemmPolicyDesc& policy : kGemmPolicies) {
+      double cost = EstimateGemmCost(policy, bucket, n, k, batch, hw_threads);
+      if (cost < best_cost) {
+        best_cost = cost;
+        best = policy;
+      }
+    }
+  }
+  VLOG(2) << "Selected XeTLA GEMM policy (" << best.wg_m << ", " << best.wg_n
+          << ", " << best.sg_m << ", " << best.sg_n << ", " << best.sg_k
+          << ", " << best.slm_ks << ") for " << batch << "x" << m << "x" << n
+          << "x" << k;
+  selected->emplace(key, best);
+  return ToTuple(best);
+}
+
+// Device copies of the problem tables of grouped GEMMs, per stream. Tables are
+// reused round robin once the copy into them has completed, the kernels
+// reading a table run in stream order before the next copy into it.
+class ProblemTablePool {
+ public:
+  static ProblemTablePool& Get(se::gpu::GpuStreamHandle stream) {
+    static auto* pools = new se::gpu::SYCLStreamLocal<ProblemTablePool>();
+    return pools->Get(stream);
+  }
+
+  explicit ProblemTablePool(se::gpu::GpuStreamHandle stream)
+      : stream_(stream) {}
+
+  ~ProblemTablePool() {
+    stream_->wait();
+    for (Table& table : tables_) {
+      if (table.device == nullptr) continue;
+      sycl::free(table.host, *stream_);
+      sycl::free(table.device, *stream_);
+    }
+  }
+
+  const void* Upload(const void* values, size_t bytes) {
+    absl::MutexLock lock(&mu_);
+    Table& table = tables_[next_];
+    next_ = (next_ + 1) % kNumTables;
+    if (table.copy.has_value()) table.copy->wait();
+    if (table.bytes < bytes) {
+      if (table.device != nullptr) {
+        // Kernels submitted before may still read the table.
+        stream_->wait();
+        sycl::free(table.host, *stream_);
+        sycl::free(table.device, *stream_);
+      }
+      table.host = sycl::malloc_host(bytes, *stream_);
+      table.device = sycl::malloc_device(bytes, *stream_);
+      table.bytes = bytes;
+    }
+    std::memcpy(table.host, values, bytes);
+    table.copy = stream_->memcpy(table.device, table.host, bytes);
+    return table.device;
+  }
+
+ private:
+  struct Table {
+    void* host = nullptr;
+    void* device = nullptr;
+    size_t bytes = 0;
+    std::optional<sycl::event> copy;
+  };
+  static constexpr int kNumTables = 8;
+
+  se::gpu::GpuStreamHandle stream_;
+  absl::Mutex mu_;
+  Table tables_[kNumTables] ABSL_GUARDED_BY(mu_);
+  int next_ ABSL_GUARDED_BY(mu_) = 0;
+};
+
+// Zeroed accumulation and counter buffers of split-K GEMMs, per stream. The
+// kernels clear the parts they use before they complete, so GEMMs running in
+// stream order share a buffer.
+class SplitKWorkspacePool {
+ public:
+  static SplitKWorkspacePool& Get(se::gpu::GpuStreamHandle stream) {
+    static auto* pools = new se::gpu::SYCLStreamLocal<SplitKWorkspacePool>();
+    return pools->Get(stream);
+  }
+
+  explicit SplitKWorkspacePool(se::gpu::GpuStreamHandle stream)
+      : stream_(stream) {}
+
+  ~SplitKWorkspacePool() {
+    if (buffer_ == nullptr) return;
+    stream_->wait();
+    sycl::free(buffer_, *stream_);
+  }
+
+  // Returns a zeroed buffer of at least `bytes` bytes on the stream.
+  void* Acquire(size_t bytes) {
+    absl::MutexLock lock(&mu_);
+    if (bytes_ < bytes) {
+      if (buffer_ != nullptr) {
+        // Kernels submitted before may still use the buffer.
+        stream_->wait();
+        sycl::free(buffer_, *stream_);
+      }
+      // Grow geometrically so that shapes of increasing size don't allocate
+      // every time.
+      bytes_ = std::max(bytes, 2 * bytes_);
+      buffer_ = sycl::malloc_device(bytes_, *stream_);
+      stream_->memset(buffer_, 0, bytes_);
+    }
+    return buffer_;
+  }
+
+ private:
+  se::gpu::GpuStreamHandle stream_;
+  absl::Mutex mu_;
+  void* buffer_ ABSL_GUARDED_BY(mu_) = nullptr;
+  size_t bytes_ ABSL_GUARDED_BY(mu_) = 0;
+};
+
+bool IsSplitKEnabled() {
+  static bool enabled = [] {
+    bool enabled = false;
+    TF_CHECK_OK(
+        tsl::ReadBoolFromEnvVar("XETLA_GEMM_SPLIT_K", false, &enabled));
+    return enabled;
+  }();
+  return enabled;
+}
+
+// Alignment of the counter buffer after the accumulators in the workspace.
+size_t AlignSplitKOffset(size_t offset) { return (offset + 255) / 256 * 256; }
+
+}  // namespace
 
 std::tuple<int, int, int, int, int, int> selectXetlaGemmConfig(int m, int n,
-                                                               int k) {
-  std::string mnk =
-      std::to_string(m) + "_" + std::to_string(n) + "_" + std::to_string(k);
-  if (configMap.find(mnk) != configMap.end()) {
-    return configMap[mnk];
+                                                               int k,
+                                                               int batch) {
+  return SelectGemmPolicy(GemmKind::kGemm, m, n, k, batch);
+}
+
+int selectXetlaGemmSplitK(
+    const std::tuple<int, int, int, int, int, int>& policy, int m, int n,
+    int k) {
+  static const int64_t hw_threads =
+      static_cast<int64_t>(GetEUCount()) * GetHardwareThreadsPerEU();
+  auto [wg_m, wg_n, sg_m, sg_n, sg_k, slm_ks] = policy;
+  if (!IsSplitKEnabled() || m > kMaxSplitKM || wg_m > kMaxSplitKM ||
+      hw_threads <= 0) {
+    return 1;
   }
-  // TODO: optimize auto-tuning algorithm
-  if (n == 4096 && m <= 128) {
-    return std::make_tuple(128, 64, 16, 16, 64, 1);
-  } else if (m >= 64) {
-    if (m <= 512 && n <= 5120) {
-      return std::make_tuple(128, 128, 32, 32, 32, 2);
-    } else {
-      return std::make_tuple(256, 256, 32, 64, 16, 1);
+  GemmPolicyDesc desc = {wg_m, wg_n, sg_m, sg_n, sg_k, slm_ks};
+  int best = 1;
+  double best_cost = EstimateGemmCost(desc, m, n, k, 1, hw_threads);
+  for (int splits : kSplitKFactors) {
+    // Every slice has to cover at least one SG_K step per K slice of the
+    // work group.
+    if (k < static_cast<int64_t>(splits) * slm_ks * sg_k) break;
+    double cost = EstimateGemmCost(desc, m, n, k, 1, hw_threads, splits);
+    if (cost < best_cost) {
+      best_cost = cost;
+      best = splits;
     }
   }
-  // default config
-  return std::make_tuple(256, 256, 32, 64, 16, 1);
+  VLOG(2) << "Selected " << best << " K slices for " << m << "x" << n << "x"
+          << k;
+  return best;
 }
 
+// The Q, K and V products run as a batch of three.
 std::tuple<int, int, int, int, int, int> selectXetlaQKVGemmConfig(int m, int n,
                                                                   int k) {
-  return std::make_tuple(256, 256, 32, 64, 16, 1);
+  return SelectGemmPolicy(GemmKind::kQKV, m, n, k, 3);
+}
+
+std::vector<std::tuple<int, int, int, int, int, int>> getXetlaGemmPolicies() {
+  std::vector<std::tuple<int, int, int, int, int, int>> policies;
+  for (const GemmPolicyDesc& policy : kGemmPolicies) {
+    policies.push_back(ToTuple(policy));
+  }
+  return policies;
+}
+
+std::vector<std::tuple<int, int, int, int, int, int>> rankXetlaGemmPolicies(
+    int m, int n, int k, int batch, double max_slowdown) {
+  static const int64_t hw_threads =
+      static_cast<int64_t>(GetEUCount()) * GetHardwareThreadsPerEU();
+  if (hw_threads <= 0) return getXetlaGemmPolicies();
+  std::vector<std::pair<double, GemmPolicyDesc>> costs;
+  for (const GemmPolicyDesc& policy : kGemmPolicies) {
+    costs.emplace_back(EstimateGemmCost(policy, m, n, k, batch, hw_threads),
+                       policy);
+  }
+  std::stable_sort(costs.begin(), costs.end(),
+                   [](const auto& lhs, const auto& rhs) {
+                     return lhs.first < rhs.first;
+                   });
+  std::vector<std::tuple<int, int, int, int, int, int>> policies;
+  for (const auto& [cost, policy] : costs) {
+    if (cost > costs.front().first * max_slowdown) break;
+    policies.push_back(ToTuple(policy));
+  }
+  return policies;
+}
+
+// Fields are packed in 10 bits for work group and 7 bits for subgroup tile
+// sizes, which holds every instantiated policy.
+int64_t encodeXetlaGemmPolicy(
+    const std::tuple<int, int, int, int, int, int>& policy) {
+  auto [wg_m, wg_n, sg_m, sg_n, sg_k, slm_ks] = policy;
+  int64_t id = wg_m;
+  id = (id << 10) | wg_n;
+  id = (id << 7) | sg_m;
+  id = (id << 7) | sg_n;
+  id = (id << 7) | sg_k;
+  id = (id << 4) | slm_ks;
+  return id;
+}
+
+std::optional<std::tuple<int, int, int, int, int, int>> decodeXetlaGemmPolicy(
+    int64_t id) {
+  if (id < 0) return std::nullopt;
+  GemmPolicyDesc policy;
+  policy.slm_ks = id & 0xf;
+  policy.sg_k = (id >> 4) & 0x7f;
+  policy.sg_n = (id >> 11) & 0x7f;
+  policy.sg_m = (id >> 18) & 0x7f;
+  policy.wg_n = (id >> 25) & 0x3ff;
+  policy.wg_m = id >> 35;
+  if (!IsInstantiated(policy)) return std::nullopt;
+  return ToTuple(policy);
 }
 
 template <typename ComputeType>
 template <int WG_M, int WG_N, int SG_M, int SG_N, int SG_K, int SLM_KS>
 bool XetlaGemmKernel<ComputeType>::dispatch(se::gpu::GpuStreamHandle handle) {
   sycl::queue q = *handle;
-  if (num_epilogues_ == 0) {
-    hgemm_common<ComputeType, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS, 1, 1, 3,
-                 true>(q, reinterpret_cast<ComputeType*>(c_->data.opaque()),
-                       reinterpret_cast<ComputeType*>(a_->data.opaque()),
-                       reinterpret_cast<ComputeType*>(b_->data.opaque()), m_,
-                       n_, k_);
-  } else if (num_epilogues_ == 1 && epilogue_types_[0] == RES_ADD) {
-    if (alpha_ == 1.0f) {
-      hgemm_res<ComputeType, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS, 1, 1, 3,
-                true>(q, reinterpret_cast<ComputeType*>(c_->data.opaque()),
-                      reinterpret_cast<ComputeType*>(a_->data.opaque()),
-                      reinterpret_cast<ComputeType*>(b_->data.opaque()),
-                      reinterpret_cast<ComputeType*>(epilogue_tensors_[0]), m_,
-                      n_, k_, epilogue_params_[0]);
-    } else {
-      hgemm_addmm<ComputeType, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS, 1, 1, 3,
-                  true>(q, reinterpret_cast<ComputeType*>(c_->data.opaque()),
-                        reinterpret_cast<ComputeType*>(epilogue_tensors_[0]),
-                        reinterpret_cast<ComputeType*>(a_->data.opaque()),
-                        reinterpret_cast<ComputeType*>(b_->data.opaque()), m_,
-                        n_, k_, alpha_, epilogue_params_[0]);
+  GemmBatch batch;
+  batch.size = batch_size_;
+  batch.stride_a = a_->batch_stride;
+  batch.stride_b = b_->batch_stride;
+  batch.stride_out = c_->batch_stride;
+  // Residual inputs have the layout of the output.
+  batch.stride_res = c_->batch_stride;
+  auto* out = reinterpret_cast<ComputeType*>(c_->data.opaque());
+  auto* a = reinterpret_cast<ComputeType*>(a_->data.opaque());
+  auto* b = reinterpret_cast<ComputeType*>(b_->data.opaque());
+  if (num_epilogues_ == 0 && alpha_ == 1.0f) {
+    if constexpr (WG_M <= kMaxSplitKM) {
+      if (split_k_ > 1 && batch_size_ == 1) {
+        return dispatch_split_k<WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS>(handle);
+      }
     }
-  } else if (num_epilogues_ == 1 && epilogue_types_[0] == GELU) {
-    CHECK(alpha_ == 1.0f);
-    hgemm_gelu<ComputeType, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS, 1, 1, 3,
-               true>(q, reinterpret_cast<ComputeType*>(c_->data.opaque()),
-                     reinterpret_cast<ComputeType*>(a_->data.opaque()),
-                     reinterpret_cast<ComputeType*>(b_->data.opaque()), m_, n_,
-                     k_);
-  } else if (num_epilogues_ == 1 && epilogue_types_[0] == BIAS) {
-    CHECK(alpha_ == 1.0f);
-    hgemm_bias<ComputeType, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS, 1, 1, 3,
-               true>(q, reinterpret_cast<ComputeType*>(c_->data.opaque()),
-                     reinterpret_cast<ComputeType*>(a_->data.opaque()),
-                     reinterpret_cast<ComputeType*>(b_->data.opaque()),
-                     reinterpret_cast<ComputeType*>(epilogue_tensors_[0]), m_,
-                     n_, k_, epilogue_params_[0]);
-  } else if (num_epilogues_ == 2 && epilogue_types_[0] == BIAS &&
-             epilogue_types_[1] == RES_ADD) {
-    CHECK(alpha_ == 1.0f);
-    hgemm_bias_res<ComputeType, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS, 1, 1, 3,
-                   true>(q, reinterpret_cast<ComputeType*>(c_->data.opaque()),
-                         reinterpret_cast<ComputeType*>(a_->data.opaque()),
-                         reinterpret_cast<ComputeType*>(b_->data.opaque()),
-                         reinterpret_cast<ComputeType*>(epilogue_tensors_[0]),
-                         reinterpret_cast<ComputeType*>(epilogue_tensors_[1]),
-                         m_, n_, k_, epilogue_params_[0], epilogue_params_[1]);
-  } else if (num_epilogues_ == 2 && epilogue_types_[0] == BIAS &&
-             epilogue_types_[1] == GELU) {
-    CHECK(alpha_ == 1.0f);
-    hgemm_bias_gelu<ComputeType, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS, 1, 1, 3,
-                    true>(q, reinterpret_cast<ComputeType*>(c_->data.opaque()),
-                          reinterpret_cast<ComputeType*>(a_->data.opaque()),
-                          reinterpret_cast<ComputeType*>(b_->data.opaque()),
-                          reinterpret_cast<ComputeType*>(epilogue_tensors_[0]),
-                          m_, n_, k_, epilogue_params_[0]);
+    hgemm_common<ComputeType, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS, 1, 1, 3,
+                 true>(q, out, a, b, m_, n_, k_, batch);
+    return true;
+  }
+
+  auto is_chain = [&](std::initializer_list<EpilogueType> types) {
+    return std::equal(types.begin(), types.end(), epilogue_types_,
+                      epilogue_types_ + num_epilogues_);
+  };
+  auto tensor = [&](int i) {
+    return reinterpret_cast<ComputeType*>(epilogue_tensors_[i]);
+  };
+  // Shapes of the bias and of the inputs with the shape of the output.
+  typename mem_desc_t<ComputeType, mem_layout::row_major,
+                      mem_space::global>::shape_t bias_shape(n_, 1, n_),
+      out_shape(n_, m_, n_);
+  using epilogue_impl::bias_op_t;
+  using epilogue_impl::mul_op_t;
+  using epilogue_impl::res_op_t;
+  using epilogue_impl::silu_op_t;
+  using subgroup::gelu_fwd_op_t;
+  using subgroup::relu_op_t;
 
+  // Every chain scales the accumulators by alpha before the epilogues run.
+#define HGEMM_EPILOGUE(...)                                                  \
+  hgemm_epilogue<ComputeType, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS, 1, 1, 3, \
+                 true, epilogue_impl::scale_op_t, ##__VA_ARGS__>
+  if (is_chain({})) {
+    HGEMM_EPILOGUE()(q, out, a, b, m_, n_, k_, batch, {alpha_});
+  } else if (is_chain({RES_ADD})) {
+    HGEMM_EPILOGUE(res_op_t<ComputeType>)
+    (q, out, a, b, m_, n_, k_, batch, {alpha_},
+     {tensor(0), out_shape, epilogue_params_[0]});
+  } else if (is_chain({RES_MUL})) {
+    HGEMM_EPILOGUE(mul_op_t<ComputeType>)
+    (q, out, a, b, m_, n_, k_, batch, {alpha_},
+     {tensor(0), out_shape, epilogue_params_[0]});
+  } else if (is_chain({BIAS})) {
+    HGEMM_EPILOGUE(bias_op_t<ComputeType>)
+    (q, out, a, b, m_, n_, k_, batch, {alpha_},
+     {tensor(0), bias_shape, epilogue_params_[0]});
+  } else if (is_chain({GELU})) {
+    HGEMM_EPILOGUE(gelu_fwd_op_t)
+    (q, out, a, b, m_, n_, k_, batch, {alpha_}, {});
+  } else if (is_chain({SILU})) {
+    HGEMM_EPILOGUE(silu_op_t)(q, out, a, b, m_, n_, k_, batch, {alpha_}, {});
+  } else if (is_chain({RELU})) {
+    HGEMM_EPILOGUE(relu_op_t)(q, out, a, b, m_, n_, k_, batch, {alpha_}, {});
+  } else if (is_chain({BIAS, RES_ADD})) {
+    HGEMM_EPILOGUE(bias_op_t<ComputeType>, res_op_t<ComputeType>)
+    (q, out, a, b, m_, n_, k_, batch, {alpha_},
+     {tensor(0), bias_shape, epilogue_params_[0]},
+     {tensor(1), out_shape, epilogue_params_[1]});
+  } else if (is_chain({BIAS, GELU})) {
+    HGEMM_EPILOGUE(bias_op_t<ComputeType>, gelu_fwd_op_t)
+    (q, out, a, b, m_, n_, k_, batch, {alpha_},
+     {tensor(0), bias_shape, epilogue_params_[0]}, {});
+  } else if (is_chain({BIAS, SILU})) {
+    HGEMM_EPILOGUE(bias_op_t<ComputeType>, silu_op_t)
+    (q, out, a, b, m_, n_, k_, batch, {alpha_},
+     {tensor(0), bias_shape, epilogue_params_[0]}, {});
+  } else if (is_chain({BIAS, RELU})) {
+    HGEMM_EPILOGUE(bias_op_t<ComputeType>, relu_op_t)
+    (q, out, a, b, m_, n_, k_, batch, {alpha_},
+     {tensor(0), bias_shape, epilogue_params_[0]}, {});
+  } else if (is_chain({SILU, RES_MUL})) {
+    HGEMM_EPILOGUE(silu_op_t, mul_op_t<ComputeType>)
+    (q, out, a, b, m_, n_, k_, batch, {alpha_}, {},
+     {tensor(1), out_shape, epilogue_params_[1]});
   } else {
     LOG(ERROR) << "No mateched policy, will fallback to oneDNN kernel";
     return false;
   }
+#undef HGEMM_EPILOGUE
   return true;
 }
 
-template <typename ComputeType, int WG_M, int WG_N, int SG_M, int SG_N,
-          int SG_K, int SLM_KS>
+template <typename ComputeType>
+template <int WG_M, int WG_N, int SG_M, int SG_N, int SG_K, int SLM_KS>
+bool XetlaGemmKernel<ComputeType>::dispatch_split_k(
+    se::gpu::GpuStreamHandle handle) {
+  sycl::queue q = *handle;
+  auto* out = reinterpret_cast<ComputeType*>(c_->data.opaque());
+  auto* a = reinterpret_cast<ComputeType*>(a_->data.opaque());
+  auto* b = reinterpret_cast<ComputeType*>(b_->data.opaque());
+  auto run = [&](auto splitk) {
+    using splitk_t = decltype(splitk);
+    size_t cnt_offset = AlignSplitKOffset(splitk_t::acc_bytes(m_, n_));
+    char* workspace =
+        static_cast<char*>(SplitKWorkspacePool::Get(handle).Acquire(
+            cnt_offset + splitk_t::cnt_bytes(m_, n_)));
+    splitk_t::run(q, out, a, b, m_, n_, k_,
+                  reinterpret_cast<float*>(workspace),
+                  reinterpret_cast<uint32_t*>(workspace + cnt_offset));
+    return true;
+  };
+  switch (split_k_) {
+    case 2:
+      return run(hgemm_splitk_t<ComputeType, WG_M, WG_N, SG_M, SG_N, SG_K,
+                                SLM_KS, 2>());
+    case 4:
+      return run(hgemm_splitk_t<ComputeType, WG_M, WG_N, SG_M, SG_N, SG_K,
+                                SLM_KS, 4>());
+    case 8:
+      return run(hgemm_splitk_t<ComputeType, WG_M, WG_N, SG_M, SG_N, SG_K,
+                                SLM_KS, 8>());
+    default:
+      LOG(ERROR) << "No split-K GEMM with " << split_k_ << " K slices";
+      return false;
+  }
+}
+
+template <typename Kernel, int WG_M, int WG_N, int SG_M, int SG_N, int SG_K,
+          int SLM_KS>
 struct GemmPolicy {
   static bool match_or_call(int wg_m, int wg_n, int sg_m, int sg_n, int sg_k,
-                            int slm_ks,
-                            XetlaGemmKernel<ComputeType>* gemm_kernel,
+                            int slm_ks, Kernel* gemm_kernel,
                             se::gpu::GpuStreamHandle handle) {
     if (WG_M == wg_m && WG_N == wg_n && SG_M == sg_m && SG_N == sg_n &&
         SG_K == sg_k && SLM_KS == slm_ks) {
@@ -269,25 +611,23 @@ struct GemmPolicy {
   }
 };
 
-template <typename ComputeType, typename MATCHER, typename... TArgs>
+template <typename Kernel, typename MATCHER, typename... TArgs>
 struct PolicyDispatcher {
   static bool call(int wg_m, int wg_n, int sg_m, int sg_n, int sg_k, int slm_ks,
-                   XetlaGemmKernel<ComputeType>* gemm_kernel,
-                   se::gpu::GpuStreamHandle handle) {
+                   Kernel* gemm_kernel, se::gpu::GpuStreamHandle handle) {
     if (MATCHER::match_or_call(wg_m, wg_n, sg_m, sg_n, sg_k, slm_ks,
                                gemm_kernel, handle)) {
       return true;
     }
-    return PolicyDispatcher<ComputeType, TArgs...>::call(
+    return PolicyDispatcher<Kernel, TArgs...>::call(
         wg_m, wg_n, sg_m, sg_n, sg_k, slm_ks, gemm_kernel, handle);
   }
 };
 
-template <typename ComputeType, typename MATCHER>
-struct PolicyDispatcher<ComputeType, MATCHER> {
+template <typename Kernel, typename MATCHER>
+struct PolicyDispatcher<Kernel, MATCHER> {
   static bool call(int wg_m, int wg_n, int sg_m, int sg_n, int sg_k, int slm_ks,
-                   XetlaGemmKernel<ComputeType>* gemm_kernel,
-                   se::gpu::GpuStreamHandle handle) {
+                   Kernel* gemm_kernel, se::gpu::GpuStreamHandle handle) {
     if (MATCHER::match_or_call(wg_m, wg_n, sg_m, sg_n, sg_k, slm_ks,
                                gemm_kernel, handle)) {
       return true;
@@ -296,43 +636,32 @@ struct PolicyDispatcher<ComputeType, MATCHER> {
   }
 };
 
+// Instantiates `Kernel::dispatch` for every policy of kGemmPolicies.
+template <typename Kernel, typename Indices>
+struct GemmPolicies;
+
+template <typename Kernel, size_t... I>
+struct GemmPolicies<Kernel, std::index_sequence<I...>> {
+  using dispatcher = PolicyDispatcher<
+      Kernel, GemmPolicy<Kernel, kGemmPolicies[I].wg_m, kGemmPolicies[I].wg_n,
+                         kGemmPolicies[I].sg_m, kGemmPolicies[I].sg_n,
+                         kGemmPolicies[I].sg_k, kGemmPolicies[I].slm_ks>...>;
+};
+
+template <typename Kernel>
+using GemmPolicyDispatcher = typename GemmPolicies<
+    Kernel, std::make_index_sequence<std::size(kGemmPolicies)>>::dispatcher;
+
 template <typename ComputeType>
 bool XetlaGemmKernel<ComputeType>::run(se::gpu::GpuStreamHandle handle) {
-  using gemm_policy =
-      PolicyDispatcher<ComputeType,
-                       GemmPolicy<ComputeType, 8, 64, 8, 16, 32, 8>,
-                       GemmPolicy<ComputeType, 8, 128, 8, 16, 16, 2>,
-                       GemmPolicy<ComputeType, 8, 128, 8, 16, 32, 4>,
-                       GemmPolicy<ComputeType, 8, 256, 8, 16, 16, 2>,
-                       GemmPolicy<ComputeType, 8, 512, 8, 16, 16, 1>,
-                       GemmPolicy<ComputeType, 16, 64, 16, 16, 16, 8>,
-                       GemmPolicy<ComputeType, 16, 256, 8, 16, 16, 1>,
-                       GemmPolicy<ComputeType, 16, 256, 16, 16, 16, 2>,
-                       GemmPolicy<ComputeType, 16, 512, 16, 16, 16, 1>,
-                       GemmPolicy<ComputeType, 32, 64, 32, 16, 16, 8>,
-                       GemmPolicy<ComputeType, 32, 64, 8, 16, 16, 2>,
-                       GemmPolicy<ComputeType, 32, 128, 32, 16, 16, 4>,
-                       GemmPolicy<ComputeType, 32, 256, 32, 16, 16, 2>,
-                       GemmPolicy<ComputeType, 32, 512, 32, 16, 16, 1>,
-                       GemmPolicy<ComputeType, 64, 128, 64, 16, 16, 4>,
-                       GemmPolicy<ComputeType, 64, 256, 64, 16, 16, 2>,
-                       GemmPolicy<ComputeType, 64, 512, 64, 16, 16, 1>,
-                       GemmPolicy<ComputeType, 128, 128, 32, 32, 32, 2>,
-                       GemmPolicy<ComputeType, 128, 256, 64, 16, 16, 1>,
-                       GemmPolicy<ComputeType, 128, 512, 64, 32, 16, 1>,
-                       GemmPolicy<ComputeType, 256, 256, 64, 32, 16, 1>,
-                       GemmPolicy<ComputeType, 256, 256, 32, 64, 16, 1>,
-                       GemmPolicy<ComputeType, 256, 256, 32, 64, 32, 1>,
-                       GemmPolicy<ComputeType, 128, 64, 16, 16, 64, 1>,
-                       GemmPolicy<ComputeType, 128, 128, 16, 32, 64, 1>,
-                       GemmPolicy<ComputeType, 128, 256, 32, 32, 16, 1>>;
   int WG_M = std::get<0>(selected_policy_id_);
   int WG_N = std::get<1>(selected_policy_id_);
   int SG_M = std::get<2>(selected_policy_id_);
   int SG_N = std::get<3>(selected_policy_id_);
   int SG_K = std::get<4>(selected_policy_id_);
   int SLM_KS = std::get<5>(selected_policy_id_);
-  return gemm_policy::call(WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS, this, handle);
+  return GemmPolicyDispatcher<XetlaGemmKernel>::call(
+      WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS, this, handle);
 }
 
 template class XetlaGemmKernel<sycl::half>;
@@ -343,7 +672,22 @@ template <int WG_M, int WG_N, int SG_M, int SG_N, int SG_K, int SLM_KS>
 bool XetlaQKVGemmKernel<ComputeType>::dispatch(
     se::gpu::GpuStreamHandle handle) {
   sycl::queue q = *handle;
-  if (q_out_ != nullptr && k_out_ != nullptr && v_out_ != nullptr) {
+  if (q_out_ != nullptr && k_out_ != nullptr && v_out_ != nullptr &&
+      rotary_cos_ != nullptr) {
+    CHECK(alpha_ == 1.0f);
+    CHECK(rotary_head_size_ % SG_N == 0);
+    hgemm_qkv_rope<ComputeType, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS, 1, 1, 3,
+                   true>(
+        q, reinterpret_cast<ComputeType*>(q_out_->data.opaque()),
+        reinterpret_cast<ComputeType*>(k_out_->data.opaque()),
+        reinterpret_cast<ComputeType*>(v_out_->data.opaque()),
+        reinterpret_cast<ComputeType*>(a_->data.opaque()),
+        reinterpret_cast<ComputeType*>(b_->data.opaque()),
+        reinterpret_cast<const ComputeType*>(rotary_cos_),
+        reinterpret_cast<const ComputeType*>(rotary_sin_), m_, n_, k_,
+        rotary_head_size_);
+    return true;
+  } else if (q_out_ != nullptr && k_out_ != nullptr && v_out_ != nullptr) {
     CHECK(alpha_ == 1.0f);
     hgemm_qkv<ComputeType, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS, 1, 1, 3, true>(
         q, reinterpret_cast<ComputeType*>(q_out_->data.opaque()),
@@ -360,45 +704,56 @@ bool XetlaQKVGemmKernel<ComputeType>::dispatch(
 
 template <typename ComputeType>
 bool XetlaQKVGemmKernel<ComputeType>::run(se::gpu::GpuStreamHandle handle) {
-  using gemm_policy =
-      PolicyDispatcher<ComputeType,
-                       GemmPolicy<ComputeType, 8, 64, 8, 16, 32, 8>,
-                       GemmPolicy<ComputeType, 8, 128, 8, 16, 16, 2>,
-                       GemmPolicy<ComputeType, 8, 128, 8, 16, 32, 4>,
-                       GemmPolicy<ComputeType, 8, 256, 8, 16, 16, 2>,
-                       GemmPolicy<ComputeType, 8, 512, 8, 16, 16, 1>,
-                       GemmPolicy<ComputeType, 16, 64, 16, 16, 16, 8>,
-                       GemmPolicy<ComputeType, 16, 256, 8, 16, 16, 1>,
-                       GemmPolicy<ComputeType, 16, 256, 16, 16, 16, 2>,
-                       GemmPolicy<ComputeType, 16, 512, 16, 16, 16, 1>,
-                       GemmPolicy<ComputeType, 32, 64, 32, 16, 16, 8>,
-                       GemmPolicy<ComputeType, 32, 64, 8, 16, 16, 2>,
-                       GemmPolicy<ComputeType, 32, 128, 32, 16, 16, 4>,
-                       GemmPolicy<ComputeType, 32, 256, 32, 16, 16, 2>,
-                       GemmPolicy<ComputeType, 32, 512, 32, 16, 16, 1>,
-                       GemmPolicy<ComputeType, 64, 128, 64, 16, 16, 4>,
-                       GemmPolicy<ComputeType, 64, 256, 64, 16, 16, 2>,
-                       GemmPolicy<ComputeType, 64, 512, 64, 16, 16, 1>,
-                       GemmPolicy<ComputeType, 128, 128, 32, 32, 32, 2>,
-                       GemmPolicy<ComputeType, 128, 256, 64, 16, 16, 1>,
-                       GemmPolicy<ComputeType, 128, 512, 64, 32, 16, 1>,
-                       GemmPolicy<ComputeType, 256, 256, 64, 32, 16, 1>,
-                       GemmPolicy<ComputeType, 256, 256, 32, 64, 16, 1>,
-                       GemmPolicy<ComputeType, 256, 256, 32, 64, 32, 1>,
-                       GemmPolicy<ComputeType, 128, 64, 16, 16, 64, 1>,
-                       GemmPolicy<ComputeType, 128, 128, 16, 32, 64, 1>,
-                       GemmPolicy<ComputeType, 128, 256, 32, 32, 16, 1>>;
   int WG_M = std::get<0>(selected_policy_id_);
   int WG_N = std::get<1>(selected_policy_id_);
   int SG_M = std::get<2>(selected_policy_id_);
   int SG_N = std::get<3>(selected_policy_id_);
   int SG_K = std::get<4>(selected_policy_id_);
   int SLM_KS = std::get<5>(selected_policy_id_);
-  return gemm_policy::call(WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS, this, handle);
+  return GemmPolicyDispatcher<XetlaQKVGemmKernel>::call(
+      WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS, this, handle);
 }
 
 template class XetlaQKVGemmKernel<sycl::half>;
 template class XetlaQKVGemmKernel<gpu::xetla::bf16>;
 
+template <typename ComputeType>
+template <int WG_M, int WG_N, int SG_M, int SG_N, int SG_K, int SLM_KS>
+bool XetlaGroupedGemmKernel<ComputeType>::dispatch(
+    se::gpu::GpuStreamHandle handle) {
+  sycl::queue q = *handle;
+  hgemm_grouped<ComputeType, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS, 1, 1, 3,
+                true>(
+      q, static_cast<const GroupedGemmProblem*>(device_problems_),
+      problems_.size(), max_m_, n_, k_);
+  return true;
+}
+
+template <typename ComputeType>
+bool XetlaGroupedGemmKernel<ComputeType>::run(
+    se::gpu::GpuStreamHandle handle) {
+  std::vector<GroupedGemmProblem> problems;
+  problems.reserve(problems_.size());
+  for (const Problem& problem : problems_) {
+    problems.push_back({reinterpret_cast<uint64_t>(problem.a),
+                        reinterpret_cast<uint64_t>(problem.b),
+                        reinterpret_cast<uint64_t>(problem.out),
+                        static_cast<uint64_t>(problem.m)});
+  }
+  device_problems_ = ProblemTablePool::Get(handle).Upload(
+      problems.data(), problems.size() * sizeof(GroupedGemmProblem));
+  int WG_M = std::get<0>(selected_policy_id_);
+  int WG_N = std::get<1>(selected_policy_id_);
+  int SG_M = std::get<2>(selected_policy_id_);
+  int SG_N = std::get<3>(selected_policy_id_);
+  int SG_K = std::get<4>(selected_policy_id_);
+  int SLM_KS = std::get<5>(selected_policy_id_);
+  return GemmPolicyDispatcher<XetlaGroupedGemmKernel>::call(
+      WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS, this, handle);
+}
+
+template class XetlaGroupedGemmKernel<sycl::half>;
+template class XetlaGroupedGemmKernel<gpu::xetla::bf16>;
+
 }  // namespace xetla
 }  // namespace gpu
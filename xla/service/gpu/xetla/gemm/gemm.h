@@ -16,6 +16,12 @@ limitations under the License.
 #define XLA_SERVICE_GPU_XETLA_GEMM_H_
 #include <sycl/sycl.hpp>
 
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <tuple>
+#include <vector>
+
 #include "absl/strings/str_cat.h"
 #include "xla/service/gpu/matrix_descriptor.h"
 #include "xla/stream_executor/blas.h"
@@ -27,14 +33,39 @@ namespace se = ::stream_executor;
 namespace gpu {
 namespace xetla {
 
-extern std::tuple<int, int, int, int, int, int> selectXetlaGemmConfig(int m,
-                                                                      int n,
-                                                                      int k);
+extern std::tuple<int, int, int, int, int, int> selectXetlaGemmConfig(
+    int m, int n, int k, int batch = 1);
 
 extern std::tuple<int, int, int, int, int, int> selectXetlaQKVGemmConfig(int m,
                                                                          int n,
                                                                          int k);
 
+// Returns the (WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS) policies the kernels are
+// instantiated for.
+std::vector<std::tuple<int, int, int, int, int, int>> getXetlaGemmPolicies();
+
+// Returns the instantiated policies for `batch` m x n x k GEMMs, cheapest
+// first by the cost model that selects policies, leaving out those estimated
+// to be more than `max_slowdown` times slower than the cheapest one. Returns
+// all of them, unranked, if the device is unknown.
+std::vector<std::tuple<int, int, int, int, int, int>> rankXetlaGemmPolicies(
+    int m, int n, int k, int batch, double max_slowdown);
+
+// Returns the number of work groups K is split between for an m x n x k GEMM
+// run with `policy`, split-K GEMMs fill the device with small M and large K.
+// Returns 1 if K is not split.
+int selectXetlaGemmSplitK(
+    const std::tuple<int, int, int, int, int, int>& policy, int m, int n,
+    int k);
+
+// A policy is encoded as a non-negative integer so that it can be recorded as
+// a GEMM algorithm by the autotuner. Decoding fails for ids that are not an
+// instantiated policy.
+int64_t encodeXetlaGemmPolicy(
+    const std::tuple<int, int, int, int, int, int>& policy);
+std::optional<std::tuple<int, int, int, int, int, int>> decodeXetlaGemmPolicy(
+    int64_t id);
+
 template <typename ComputeType>
 class XetlaGemmKernel {
  public:
@@ -44,6 +75,7 @@ class XetlaGemmKernel {
     GELU,
     RES_MUL,
     SILU,
+    RELU,
   };
 
  private:
@@ -61,9 +93,15 @@ class XetlaGemmKernel {
   bool is_b_col_major_;
   bool fallback_;
   int m_, n_, k_;
+  int batch_size_ = 1;
+  int split_k_ = 1;
   std::tuple<int, int, int, int, int, int> selected_policy_id_;
+  std::optional<std::tuple<int, int, int, int, int, int>> forced_policy_id_;
   float alpha_ = 1.0f;
 
+  template <int WG_M, int WG_N, int SG_M, int SG_N, int SG_K, int SLM_KS>
+  bool dispatch_split_k(se::gpu::GpuStreamHandle handle);
+
  public:
   XetlaGemmKernel() = default;
   bool fallback() const { return fallback_; }
@@ -83,6 +121,21 @@ class XetlaGemmKernel {
     b_ = const_cast<xla::gpu::MatrixDescriptor*>(&b);
     return *this;
   }
+  // Runs `batch_size` GEMMs whose operands are `batch_stride` elements apart,
+  // as given by the matrix descriptors.
+  XetlaGemmKernel& add_batch_size(const int batch_size) {
+    batch_size_ = batch_size;
+    return *this;
+  }
+  // Uses `policy`, if set, instead of the one selected for the GEMM shape.
+  XetlaGemmKernel& add_policy(
+      const std::optional<std::tuple<int, int, int, int, int, int>>& policy) {
+    forced_policy_id_ = policy;
+    return *this;
+  }
+  // Appends an epilogue to the chain applied to alpha * A x B. `t` is the
+  // bias or the input with the shape of the output the epilogue reads, if any,
+  // and `x` scales that input.
   XetlaGemmKernel& add_epilogue(const void* t, EpilogueType eptype,
                                 const float x = 1.0) {
     epilogue_tensors_[num_epilogues_] = const_cast<void*>(t);
@@ -107,8 +160,14 @@ class XetlaGemmKernel {
     n_ = is_b_row_major_ ? b_->num_cols : b_->num_rows;
     __CHECK(k_ % 4 == 0 && n_ % 4 == 0);
     __CHECK(is_a_row_major_);
+    __CHECK(batch_size_ >= 1);
     fallback_ = false;
-    selected_policy_id_ = selectXetlaGemmConfig(m_, n_, k_);
+    selected_policy_id_ = forced_policy_id_.has_value()
+                              ? *forced_policy_id_
+                              : selectXetlaGemmConfig(m_, n_, k_, batch_size_);
+    split_k_ = batch_size_ == 1
+                   ? selectXetlaGemmSplitK(selected_policy_id_, m_, n_, k_)
+                   : 1;
     return *this;
   }
 
@@ -133,9 +192,13 @@ class XetlaQKVGemmKernel : public XetlaGemmKernel<ComputeType> {
   int m_, n_, k_;
   std::tuple<int, int, int, int, int, int> selected_policy_id_;
   float alpha_ = 1.0f;
+  const void* rotary_cos_ = nullptr;
+  const void* rotary_sin_ = nullptr;
+  int rotary_head_size_ = 0;
 
  public:
   XetlaQKVGemmKernel() = default;
+  bool fallback() const { return fallback_; }
   XetlaQKVGemmKernel& add_matrix_q_out(
       const xla::gpu::MatrixDescriptor& q_out) {
     q_out_ = const_cast<xla::gpu::MatrixDescriptor*>(&q_out);
@@ -159,6 +222,16 @@ class XetlaQKVGemmKernel : public XetlaGemmKernel<ComputeType> {
     b_ = const_cast<xla::gpu::MatrixDescriptor*>(&b);
     return *this;
   }
+  // Applies rotary position embeddings to Q and K in the epilogue. `cos` and
+  // `sin` are [m, head_size] tables for the position of every row of A, with
+  // the angle of each pair of adjacent columns repeated for both of them.
+  XetlaQKVGemmKernel& add_rotary(const void* cos, const void* sin,
+                                 int head_size) {
+    rotary_cos_ = cos;
+    rotary_sin_ = sin;
+    rotary_head_size_ = head_size;
+    return *this;
+  }
   XetlaQKVGemmKernel& build() {
     fallback_ = true;
     is_a_row_major_ = (a_->transpose == se::blas::Transpose::kNoTranspose);
@@ -169,6 +242,12 @@ class XetlaQKVGemmKernel : public XetlaGemmKernel<ComputeType> {
     k_ = is_a_row_major_ ? a_->num_cols : a_->num_rows;
     n_ = is_b_row_major_ ? b_->num_cols : b_->num_rows;
     if (is_a_col_major_) return *this;
+    if (rotary_cos_ != nullptr) {
+      if (rotary_head_size_ <= 0 || n_ % rotary_head_size_ != 0) return *this;
+      // A sub-group tile has to lie within one head.
+      int sg_n = std::get<3>(selectXetlaQKVGemmConfig(m_, n_, k_));
+      if (rotary_head_size_ % sg_n != 0) return *this;
+    }
     fallback_ = false;
     selected_policy_id_ = selectXetlaQKVGemmConfig(m_, n_, k_);
     return *this;
@@ -180,6 +259,56 @@ class XetlaQKVGemmKernel : public XetlaGemmKernel<ComputeType> {
   bool run(se::gpu::GpuStreamHandle handle);
 };
 
+// Runs a group of row-major GEMMs that share N and K but differ in M, such as
+// the experts of a mixture-of-experts layer, in a single launch. The problem
+// descriptors are uploaded to device memory on the stream they run on.
+template <typename ComputeType>
+class XetlaGroupedGemmKernel {
+ private:
+  struct Problem {
+    const void* a;
+    const void* b;
+    void* out;
+    int m;
+  };
+  std::vector<Problem> problems_;
+  const void* device_problems_ = nullptr;
+  bool fallback_ = true;
+  int max_m_ = 0;
+  int n_ = 0, k_ = 0;
+  std::tuple<int, int, int, int, int, int> selected_policy_id_;
+
+ public:
+  XetlaGroupedGemmKernel(int n, int k) : n_(n), k_(k) {}
+  bool fallback() const { return fallback_; }
+  XetlaGroupedGemmKernel& add_problem(const void* a, const void* b, void* out,
+                                      int m) {
+    problems_.push_back({a, b, out, m});
+    return *this;
+  }
+  XetlaGroupedGemmKernel& build() {
+    fallback_ = true;
+    if (problems_.empty() || k_ % 4 != 0 || n_ % 4 != 0) return *this;
+    for (const Problem& problem : problems_) {
+      if (reinterpret_cast<uint64_t>(problem.a) % 8 != 0 ||
+          reinterpret_cast<uint64_t>(problem.b) % 8 != 0 ||
+          reinterpret_cast<uint64_t>(problem.out) % 8 != 0) {
+        return *this;
+      }
+      max_m_ = std::max(max_m_, problem.m);
+    }
+    fallback_ = false;
+    selected_policy_id_ =
+        selectXetlaGemmConfig(max_m_, n_, k_, problems_.size());
+    return *this;
+  }
+
+  template <int WG_M, int WG_N, int SG_M, int SG_N, int SG_K, int SLM_KS>
+  bool dispatch(se::gpu::GpuStreamHandle handle);
+
+  bool run(se::gpu::GpuStreamHandle handle);
+};
+
 }  // namespace xetla
 }  // namespace gpu
 
@@ -29,26 +29,10 @@ limitations under the License.
 namespace gpu {
 namespace xetla {
 
-template <typename scalar_t, int WG_M = 8, int WG_N = 32, int SG_M = 8,
-          int SG_N = 16, int SG_K = 64, int SLM_KS = 8, int L3_KS = 1,
-          int SYNC_FREQ = 1, int STAGES = 3, bool B_ROW_MAJOR = true>
-class HGEMM_ADDMM_KERNEL;
 template <typename scalar_t, int WG_M = 8, int WG_N = 32, int SG_M = 8,
           int SG_N = 16, int SG_K = 64, int SLM_KS = 8, int L3_KS = 1,
           int SYNC_FREQ = 1, int STAGES = 3, bool B_ROW_MAJOR = true>
 class HGEMM_COMMON_KERNEL;
-template <typename scalar_t, int WG_M = 8, int WG_N = 32, int SG_M = 8,
-          int SG_N = 16, int SG_K = 64, int SLM_KS = 8, int L3_KS = 1,
-          int SYNC_FREQ = 1, int STAGES = 3, bool B_ROW_MAJOR = true>
-class HGEMM_BIAS_KERNEL;
-template <typename scalar_t, int WG_M = 8, int WG_N = 32, int SG_M = 8,
-          int SG_N = 16, int SG_K = 64, int SLM_KS = 8, int L3_KS = 1,
-          int SYNC_FREQ = 1, int STAGES = 3, bool B_ROW_MAJOR = true>
-class HGEMM_GELU_KERNEL;
-template <typename scalar_t, int WG_M = 8, int WG_N = 32, int SG_M = 8,
-          int SG_N = 16, int SG_K = 64, int SLM_KS = 8, int L3_KS = 1,
-          int SYNC_FREQ = 1, int STAGES = 3, bool B_ROW_MAJOR = true>
-class HGEMM_BIAS_GELU_KERNEL;
 template <typename scalar_t, int WG_M = 8, int WG_N = 32, int SG_M = 8,
           int SG_N = 16, int SG_K = 64, int SLM_KS = 8, int L3_KS = 1,
           int SYNC_FREQ = 1, int STAGES = 3, bool B_ROW_MAJOR = true>
@@ -56,15 +40,15 @@ class HGEMM_BIAS_RES_RES_KERNEL;
 template <typename scalar_t, int WG_M = 8, int WG_N = 32, int SG_M = 8,
           int SG_N = 16, int SG_K = 64, int SLM_KS = 8, int L3_KS = 1,
           int SYNC_FREQ = 1, int STAGES = 3, bool B_ROW_MAJOR = true>
-class HGEMM_BIAS_RES_KERNEL;
+class HGEMM_QKV_KERNEL;
 template <typename scalar_t, int WG_M = 8, int WG_N = 32, int SG_M = 8,
           int SG_N = 16, int SG_K = 64, int SLM_KS = 8, int L3_KS = 1,
           int SYNC_FREQ = 1, int STAGES = 3, bool B_ROW_MAJOR = true>
-class HGEMM_QKV_KERNEL;
+class HGEMM_QKV_BIAS_KERNEL;
 template <typename scalar_t, int WG_M = 8, int WG_N = 32, int SG_M = 8,
           int SG_N = 16, int SG_K = 64, int SLM_KS = 8, int L3_KS = 1,
           int SYNC_FREQ = 1, int STAGES = 3, bool B_ROW_MAJOR = true>
-class HGEMM_QKV_BIAS_KERNEL;
+class HGEMM_QKV_ROPE_KERNEL;
 template <typename scalar_t, int WG_M = 8, int WG_N = 32, int SG_M = 8,
           int SG_N = 16, int SG_K = 64, int SLM_KS = 8, int L3_KS = 1,
           int SYNC_FREQ = 1, int STAGES = 3, bool B_ROW_MAJOR = true>
@@ -76,86 +60,59 @@ class HGEMM_SILU_KERNEL;
 template <typename scalar_t, int WG_M = 8, int WG_N = 32, int SG_M = 8,
           int SG_N = 16, int SG_K = 64, int SLM_KS = 8, int L3_KS = 1,
           int SYNC_FREQ = 1, int STAGES = 3, bool B_ROW_MAJOR = true>
-class HGEMM_RES_KERNEL;
+class HGEMM_RES_RES_KERNEL;
 template <typename scalar_t, int WG_M = 8, int WG_N = 32, int SG_M = 8,
           int SG_N = 16, int SG_K = 64, int SLM_KS = 8, int L3_KS = 1,
           int SYNC_FREQ = 1, int STAGES = 3, bool B_ROW_MAJOR = true>
-class HGEMM_RES_RES_KERNEL;
-
-#define HGEMM_DEFINITIONS                                                \
-  static_assert(L3_KS == 1, "currently, L3_KS should be 1");             \
-  constexpr mem_layout layout_a = mem_layout::row_major;                 \
-  constexpr mem_layout layout_b =                                        \
-      B_ROW_MAJOR ? mem_layout::row_major : mem_layout::col_major;       \
-  uint32_t group_range_m = (m + WG_M - 1) / WG_M;                        \
-  uint32_t group_range_n = (n + WG_N - 1) / WG_N;                        \
-  uint32_t thread_range_m = WG_M / SG_M;                                 \
-  uint32_t thread_range_n = WG_N / SG_N;                                 \
-  uint32_t lda = k;                                                      \
-  uint32_t ldb = B_ROW_MAJOR ? n : k;                                    \
-  uint32_t ldc = n;                                                      \
-  cl::sycl::range<3> GroupRange{L3_KS, group_range_m, group_range_n};    \
-  cl::sycl::range<3> LocalRange{SLM_KS, thread_range_m, thread_range_n}; \
+class HGEMM_GROUPED_KERNEL;
+template <typename scalar_t, int WG_M = 8, int WG_N = 32, int SG_M = 8,
+          int SG_N = 16, int SG_K = 64, int SLM_KS = 8, int L3_KS = 1,
+          int SYNC_FREQ = 1, int STAGES = 3, bool B_ROW_MAJOR = true>
+class HGEMM_SPLITK_KERNEL;
+template <typename scalar_t, int WG_M, int WG_N, int SG_M, int SG_N, int SG_K,
+          int SLM_KS, int L3_KS, int SYNC_FREQ, int STAGES, bool B_ROW_MAJOR,
+          typename... tile_op_t>
+class HGEMM_EPILOGUE_KERNEL;
+
+// Strided batch of GEMMs. Work groups of a batch share the group id in
+// dimension 0, and operands are offset by their stride in elements for each
+// batch. A stride of 0 shares the operand between all the batches.
+struct GemmBatch {
+  uint32_t size = 1;
+  int64_t stride_a = 0;
+  int64_t stride_b = 0;
+  int64_t stride_out = 0;
+  int64_t stride_res = 0;
+};
+
+#define HGEMM_DEFINITIONS                                                  \
+  static_assert(L3_KS == 1, "currently, L3_KS should be 1");               \
+  constexpr mem_layout layout_a = mem_layout::row_major;                   \
+  constexpr mem_layout layout_b =                                          \
+      B_ROW_MAJOR ? mem_layout::row_major : mem_layout::col_major;         \
+  uint32_t group_range_m = (m + WG_M - 1) / WG_M;                          \
+  uint32_t group_range_n = (n + WG_N - 1) / WG_N;                          \
+  uint32_t thread_range_m = WG_M / SG_M;                                   \
+  uint32_t thread_range_n = WG_N / SG_N;                                   \
+  uint32_t lda = k;                                                        \
+  uint32_t ldb = B_ROW_MAJOR ? n : k;                                      \
+  uint32_t ldc = n;                                                        \
+  cl::sycl::range<3> GroupRange{batch.size, group_range_m, group_range_n}; \
+  cl::sycl::range<3> LocalRange{SLM_KS, thread_range_m, thread_range_n};   \
   cl::sycl::nd_range<3> NDRange(GroupRange* LocalRange, LocalRange);
 
-template <typename scalar_t, int WG_M, int WG_N, int SG_M, int SG_N, int SG_K,
-          int SLM_KS, int L3_KS = 1, int SYNC_FREQ = 1, int STAGES = 3,
-          bool B_ROW_MAJOR = true>
-inline void hgemm_addmm(sycl::queue& queue, scalar_t* out, const scalar_t* res,
-                        const scalar_t* a, const scalar_t* b, const int m,
-                        const int n, const int k, const float alpha,
-                        const float beta) {
-  HGEMM_DEFINITIONS
-  auto cgf = DPCPP_Q_CGF(cgh) {
-    cgh.parallel_for<
-        HGEMM_ADDMM_KERNEL<scalar_t, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS,
-                           L3_KS, SYNC_FREQ, STAGES, B_ROW_MAJOR>>(
-        NDRange, [=](sycl::nd_item<3> item) SYCL_ESIMD_KERNEL {
-          sycl::nd_item<3> ei(item);
-          using data_type_b = scalar_t;
-          using data_type_a = scalar_t;
-          using data_type_c = scalar_t;
-          using data_type_acc = float;
-          static constexpr uint32_t periodic_sync_interval = SYNC_FREQ;
-          static constexpr uint32_t prefetch_distance = STAGES;
-          using tile_shape = group::tile_shape_t<WG_N, WG_M, SG_N, SG_M>;
-          using brgemm_t = typename group::gemm_selector_t<
-              data_type_a, data_type_b, layout_a, layout_b, mem_space::global,
-              mem_space::global, 8, 8, data_type_acc, tile_shape, SG_K,
-              mma_engine::xmx, gpu_arch::Xe, prefetch_distance,
-              periodic_sync_interval>::gemm;
-          using epilogue_t = group::epilogue_t<
-              xetla::group::epilogue_policy_tile_op<
-                  xetla::subgroup::chained_tile_op_t<
-                      epilogue_impl::alpha_beta_op_t<data_type_c>>,
-                  gpu_arch::Xe>,
-              tile_shape,
-              mem_desc_t<scalar_t, mem_layout::row_major, mem_space::global>>;
-
-          using group_swizzle =
-              gpu::xetla::kernel::group_swizzle_default<gpu_arch::Xe>;
-          using gemm_op_t = gpu::xetla::kernel::gemm_universal_t<
-              gpu::xetla::kernel::dispatch_policy_kslicing<group_swizzle, L3_KS,
-                                                           SLM_KS>,
-              brgemm_t, epilogue_t>;
-          typename gemm_op_t::arguments_t arg(
-              m, k, n, const_cast<scalar_t*>(a), lda, const_cast<scalar_t*>(b),
-              ldb, out, ldc, {}, {},
-              {{{const_cast<scalar_t*>(res), {n, m, n}, alpha, beta}}});
-          slm_barrier_init<gemm_op_t>();
-          gemm_op_t gemm_op;
-          gemm_op(ei, arg);
-        });
-  };
-  DPCPP_Q_SUBMIT(queue, cgf);
-}
+#define HGEMM_BATCH_OFFSETS                                                 \
+  uint64_t batch_id = ei.get_group(0);                                      \
+  scalar_t* batch_a = const_cast<scalar_t*>(a) + batch_id * batch.stride_a; \
+  scalar_t* batch_b = const_cast<scalar_t*>(b) + batch_id * batch.stride_b; \
+  scalar_t* batch_out = out + batch_id * batch.stride_out;
 
 template <typename scalar_t, int WG_M, int WG_N, int SG_M, int SG_N, int SG_K,
           int SLM_KS, int L3_KS = 1, int SYNC_FREQ = 1, int STAGES = 3,
           bool B_ROW_MAJOR = true>
 inline void hgemm_common(sycl::queue& queue, scalar_t* out, const scalar_t* a,
                          const scalar_t* b, const int m, const int n,
-                         const int k) {
+                         const int k, const GemmBatch& batch = {}) {
   HGEMM_DEFINITIONS
   auto cgf = DPCPP_Q_CGF(cgh) {
     cgh.parallel_for<
@@ -163,6 +120,7 @@ inline void hgemm_common(sycl::queue& queue, scalar_t* out, const scalar_t* a,
                             L3_KS, SYNC_FREQ, STAGES, B_ROW_MAJOR>>(
         NDRange, [=](sycl::nd_item<3> item) SYCL_ESIMD_KERNEL {
           sycl::nd_item<3> ei(item);
+          HGEMM_BATCH_OFFSETS
           using data_type_b = scalar_t;
           using data_type_a = scalar_t;
           using data_type_c = scalar_t;
@@ -186,9 +144,8 @@ inline void hgemm_common(sycl::queue& queue, scalar_t* out, const scalar_t* a,
               gpu::xetla::kernel::dispatch_policy_kslicing<group_swizzle, L3_KS,
                                                            SLM_KS>,
               brgemm_t, epilogue_t>;
-          typename gemm_op_t::arguments_t arg(m, k, n, const_cast<scalar_t*>(a),
-                                              lda, const_cast<scalar_t*>(b),
-                                              ldb, out, ldc);
+          typename gemm_op_t::arguments_t arg(m, k, n, batch_a, lda, batch_b,
+                                              ldb, batch_out, ldc);
           slm_barrier_init<gemm_op_t>();
           gemm_op_t gemm_op;
           gemm_op(ei, arg);
@@ -197,24 +154,99 @@ inline void hgemm_common(sycl::queue& queue, scalar_t* out, const scalar_t* a,
   DPCPP_Q_SUBMIT(queue, cgf);
 }
 
+// GEMM with K split between L3_KS work groups per output tile, for shapes
+// with too few tiles to fill the device. Dimension 0 of the nd_range selects
+// the slice of K. The partial sums of the slices are added up atomically in
+// the `acc` buffer and `cnt` counts the slices reduced per tile, so that the
+// last one stores the output. Both buffers have to be zero before the first
+// launch and the kernel clears them again after use.
 template <typename scalar_t, int WG_M, int WG_N, int SG_M, int SG_N, int SG_K,
-          int SLM_KS, int L3_KS = 1, int SYNC_FREQ = 1, int STAGES = 3,
+          int SLM_KS, int L3_KS, int SYNC_FREQ = 1, int STAGES = 3,
           bool B_ROW_MAJOR = true>
-inline void hgemm_res(sycl::queue& queue, scalar_t* out, const scalar_t* a,
-                      const scalar_t* b, const scalar_t* res, const int m,
-                      const int n, const int k, const float res_factor) {
+struct hgemm_splitk_t {
+  static_assert(L3_KS > 1, "split-K GEMMs need more than one slice of K");
+  static constexpr mem_layout layout_a = mem_layout::row_major;
+  static constexpr mem_layout layout_b =
+      B_ROW_MAJOR ? mem_layout::row_major : mem_layout::col_major;
+  using data_type_b = scalar_t;
+  using data_type_a = scalar_t;
+  using data_type_c = scalar_t;
+  using data_type_acc = float;
+  using tile_shape = group::tile_shape_t<WG_N, WG_M, SG_N, SG_M>;
+  using brgemm_t = typename group::gemm_selector_t<
+      data_type_a, data_type_b, layout_a, layout_b, mem_space::global,
+      mem_space::global, 8, 8, data_type_acc, tile_shape, SG_K,
+      mma_engine::xmx, gpu_arch::Xe, STAGES, SYNC_FREQ>::gemm;
+  using epilogue_t = group::epilogue_t<
+      xetla::group::epilogue_policy_tile_op<
+          xetla::subgroup::chained_tile_op_t<>, gpu_arch::Xe>,
+      tile_shape,
+      mem_desc_t<scalar_t, mem_layout::row_major, mem_space::global>>;
+  using group_swizzle = gpu::xetla::kernel::group_swizzle_default<gpu_arch::Xe>;
+  using gemm_op_t = gpu::xetla::kernel::gemm_universal_t<
+      gpu::xetla::kernel::dispatch_policy_kslicing<group_swizzle, L3_KS,
+                                                   SLM_KS>,
+      brgemm_t, epilogue_t>;
+
+  static size_t acc_bytes(const int m, const int n) {
+    return gemm_op_t::get_acc_buf_size(m, n) * sizeof(data_type_acc);
+  }
+  static size_t cnt_bytes(const int m, const int n) {
+    return gemm_op_t::get_cnt_buf_size(m, n) * sizeof(uint32_t);
+  }
+
+  static void run(sycl::queue& queue, scalar_t* out, const scalar_t* a,
+                  const scalar_t* b, const int m, const int n, const int k,
+                  float* acc, uint32_t* cnt) {
+    uint32_t group_range_m = (m + WG_M - 1) / WG_M;
+    uint32_t group_range_n = (n + WG_N - 1) / WG_N;
+    uint32_t thread_range_m = WG_M / SG_M;
+    uint32_t thread_range_n = WG_N / SG_N;
+    uint32_t lda = k;
+    uint32_t ldb = B_ROW_MAJOR ? n : k;
+    uint32_t ldc = n;
+    cl::sycl::range<3> GroupRange{L3_KS, group_range_m, group_range_n};
+    cl::sycl::range<3> LocalRange{SLM_KS, thread_range_m, thread_range_n};
+    cl::sycl::nd_range<3> NDRange(GroupRange * LocalRange, LocalRange);
+
+    auto cgf = DPCPP_Q_CGF(cgh) {
+      cgh.parallel_for<
+          HGEMM_SPLITK_KERNEL<scalar_t, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS,
+                              L3_KS, SYNC_FREQ, STAGES, B_ROW_MAJOR>>(
+          NDRange, [=](sycl::nd_item<3> item) SYCL_ESIMD_KERNEL {
+            sycl::nd_item<3> ei(item);
+            typename gemm_op_t::arguments_t arg(
+                m, k, n, const_cast<scalar_t*>(a), lda,
+                const_cast<scalar_t*>(b), ldb, out, ldc, acc, cnt);
+            slm_barrier_init<gemm_op_t>();
+            gemm_op_t gemm_op;
+            gemm_op(ei, arg);
+          });
+    };
+    DPCPP_Q_SUBMIT(queue, cgf);
+  }
+};
+
+// Runs a GEMM whose accumulators go through the chain of epilogue ops
+// `tile_op_t...`, with the arguments `op_args`, before they are stored.
+template <typename scalar_t, int WG_M, int WG_N, int SG_M, int SG_N, int SG_K,
+          int SLM_KS, int L3_KS, int SYNC_FREQ, int STAGES, bool B_ROW_MAJOR,
+          typename... tile_op_t>
+inline void hgemm_epilogue(sycl::queue& queue, scalar_t* out, const scalar_t* a,
+                           const scalar_t* b, const int m, const int n,
+                           const int k, const GemmBatch& batch,
+                           const typename tile_op_t::arguments_t&... op_args) {
   HGEMM_DEFINITIONS
   auto cgf = DPCPP_Q_CGF(cgh) {
-    cgh.parallel_for<
-        HGEMM_RES_KERNEL<scalar_t, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS, L3_KS,
-                         SYNC_FREQ, STAGES, B_ROW_MAJOR>>(
+    cgh.parallel_for<HGEMM_EPILOGUE_KERNEL<
+        scalar_t, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS, L3_KS, SYNC_FREQ,
+        STAGES, B_ROW_MAJOR, tile_op_t...>>(
         NDRange, [=](sycl::nd_item<3> item) SYCL_ESIMD_KERNEL {
           sycl::nd_item<3> ei(item);
-
+          HGEMM_BATCH_OFFSETS
           using data_type_b = scalar_t;
           using data_type_a = scalar_t;
           using data_type_c = scalar_t;
-          using data_type_res = scalar_t;
           using data_type_acc = float;
           static constexpr uint32_t periodic_sync_interval = SYNC_FREQ;
           static constexpr uint32_t prefetch_distance = STAGES;
@@ -226,8 +258,7 @@ inline void hgemm_res(sycl::queue& queue, scalar_t* out, const scalar_t* a,
               periodic_sync_interval>::gemm;
           using epilogue_t = group::epilogue_t<
               xetla::group::epilogue_policy_tile_op<
-                  xetla::subgroup::chained_tile_op_t<
-                      epilogue_impl::res_op_t<data_type_res>>,
+                  xetla::subgroup::chained_tile_op_t<tile_op_t...>,
                   gpu_arch::Xe>,
               tile_shape,
               mem_desc_t<scalar_t, mem_layout::row_major, mem_space::global>>;
@@ -238,9 +269,9 @@ inline void hgemm_res(sycl::queue& queue, scalar_t* out, const scalar_t* a,
                                                            SLM_KS>,
               brgemm_t, epilogue_t>;
           typename gemm_op_t::arguments_t arg(
-              m, k, n, const_cast<scalar_t*>(a), lda, const_cast<scalar_t*>(b),
-              ldb, out, ldc, {}, {},
-              {{{const_cast<scalar_t*>(res), {n, m, n}, res_factor}}});
+              m, k, n, batch_a, lda, batch_b, ldb, batch_out, ldc, {}, {},
+              {{epilogue_impl::batch_args_t<tile_op_t>::get(
+                  op_args, batch_id, batch.stride_res)...}});
           slm_barrier_init<gemm_op_t>();
           gemm_op_t gemm_op;
           gemm_op(ei, arg);
@@ -249,23 +280,61 @@ inline void hgemm_res(sycl::queue& queue, scalar_t* out, const scalar_t* a,
   DPCPP_Q_SUBMIT(queue, cgf);
 }
 
+// Problem of a grouped GEMM in device memory: row-major A (m x k), B (k x n)
+// and out (m x n) addresses and m, as 64 bit words so that a work group loads
+// it with a single block read.
+struct GroupedGemmProblem {
+  uint64_t a;
+  uint64_t b;
+  uint64_t out;
+  uint64_t m;
+};
+static_assert(sizeof(GroupedGemmProblem) == 4 * sizeof(uint64_t));
+
+// Runs `num_problems` GEMMs sharing n and k, with M of at most `max_m`, in a
+// single launch. Dimension 0 of the nd_range selects the problem, and work
+// groups past the M of their problem exit right away.
 template <typename scalar_t, int WG_M, int WG_N, int SG_M, int SG_N, int SG_K,
           int SLM_KS, int L3_KS = 1, int SYNC_FREQ = 1, int STAGES = 3,
           bool B_ROW_MAJOR = true>
-inline void hgemm_bias(sycl::queue& queue, scalar_t* out, const scalar_t* a,
-                       const scalar_t* b, const scalar_t* bias, const int m,
-                       const int n, const int k, const float bias_factor) {
-  HGEMM_DEFINITIONS
+inline void hgemm_grouped(sycl::queue& queue,
+                          const GroupedGemmProblem* problems,
+                          const int num_problems, const int max_m,
+                          const int n, const int k) {
+  static_assert(L3_KS == 1, "for grouped gemm, L3_KS should be 1");
+  constexpr mem_layout layout_a = mem_layout::row_major;
+  constexpr mem_layout layout_b =
+      B_ROW_MAJOR ? mem_layout::row_major : mem_layout::col_major;
+  uint32_t group_range_m = (max_m + WG_M - 1) / WG_M;
+  uint32_t group_range_n = (n + WG_N - 1) / WG_N;
+  uint32_t thread_range_m = WG_M / SG_M;
+  uint32_t thread_range_n = WG_N / SG_N;
+  uint32_t lda = k;
+  uint32_t ldb = B_ROW_MAJOR ? n : k;
+  uint32_t ldc = n;
+  cl::sycl::range<3> GroupRange{static_cast<size_t>(num_problems),
+                                group_range_m, group_range_n};
+  cl::sycl::range<3> LocalRange{SLM_KS, thread_range_m, thread_range_n};
+  cl::sycl::nd_range<3> NDRange(GroupRange * LocalRange, LocalRange);
+
   auto cgf = DPCPP_Q_CGF(cgh) {
     cgh.parallel_for<
-        HGEMM_BIAS_KERNEL<scalar_t, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS, L3_KS,
-                          SYNC_FREQ, STAGES, B_ROW_MAJOR>>(
+        HGEMM_GROUPED_KERNEL<scalar_t, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS,
+                             L3_KS, SYNC_FREQ, STAGES, B_ROW_MAJOR>>(
         NDRange, [=](sycl::nd_item<3> item) SYCL_ESIMD_KERNEL {
           sycl::nd_item<3> ei(item);
+
+          uint32_t problem_id = ei.get_group(0);
+          xetla_vector<uint64_t, 4> problem = xetla_load_global<uint64_t, 4>(
+              reinterpret_cast<uint64_t*>(
+                  const_cast<GroupedGemmProblem*>(problems)),
+              problem_id * sizeof(GroupedGemmProblem));
+          uint32_t m = problem[3];
+          if (ei.get_group(1) * WG_M >= m) return;
+
           using data_type_b = scalar_t;
           using data_type_a = scalar_t;
           using data_type_c = scalar_t;
-          using data_type_bias = scalar_t;
           using data_type_acc = float;
           static constexpr uint32_t periodic_sync_interval = SYNC_FREQ;
           static constexpr uint32_t prefetch_distance = STAGES;
@@ -277,9 +346,7 @@ inline void hgemm_bias(sycl::queue& queue, scalar_t* out, const scalar_t* a,
               periodic_sync_interval>::gemm;
           using epilogue_t = group::epilogue_t<
               xetla::group::epilogue_policy_tile_op<
-                  xetla::subgroup::chained_tile_op_t<
-                      epilogue_impl::bias_op_t<data_type_bias>>,
-                  gpu_arch::Xe>,
+                  xetla::subgroup::chained_tile_op_t<>, gpu_arch::Xe>,
               tile_shape,
               mem_desc_t<scalar_t, mem_layout::row_major, mem_space::global>>;
           using group_swizzle =
@@ -289,9 +356,9 @@ inline void hgemm_bias(sycl::queue& queue, scalar_t* out, const scalar_t* a,
                                                            SLM_KS>,
               brgemm_t, epilogue_t>;
           typename gemm_op_t::arguments_t arg(
-              m, k, n, const_cast<scalar_t*>(a), lda, const_cast<scalar_t*>(b),
-              ldb, out, ldc, {}, {},
-              {{{const_cast<scalar_t*>(bias), {n, 1, n}, bias_factor}}});
+              m, k, n, reinterpret_cast<scalar_t*>(problem[0]), lda,
+              reinterpret_cast<scalar_t*>(problem[1]), ldb,
+              reinterpret_cast<scalar_t*>(problem[2]), ldc);
           slm_barrier_init<gemm_op_t>();
           gemm_op_t gemm_op;
           gemm_op(ei, arg);
@@ -303,77 +370,39 @@ inline void hgemm_bias(sycl::queue& queue, scalar_t* out, const scalar_t* a,
 template <typename scalar_t, int WG_M, int WG_N, int SG_M, int SG_N, int SG_K,
           int SLM_KS, int L3_KS = 1, int SYNC_FREQ = 1, int STAGES = 3,
           bool B_ROW_MAJOR = true>
-inline void hgemm_gelu(sycl::queue& queue, scalar_t* out, const scalar_t* a,
-                       const scalar_t* b, const int m, const int n,
-                       const int k) {
-  HGEMM_DEFINITIONS
-  auto cgf = DPCPP_Q_CGF(cgh) {
-    cgh.parallel_for<
-        HGEMM_GELU_KERNEL<scalar_t, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS, L3_KS,
-                          SYNC_FREQ, STAGES, B_ROW_MAJOR>>(
-        NDRange, [=](sycl::nd_item<3> item) SYCL_ESIMD_KERNEL {
-          sycl::nd_item<3> ei(item);
-          using data_type_b = scalar_t;
-          using data_type_a = scalar_t;
-          using data_type_c = scalar_t;
-          using data_type_bias = scalar_t;
-          using data_type_acc = float;
-          static constexpr uint32_t periodic_sync_interval = SYNC_FREQ;
-          static constexpr uint32_t prefetch_distance = STAGES;
-          using tile_shape = group::tile_shape_t<WG_N, WG_M, SG_N, SG_M>;
-          using brgemm_t = typename group::gemm_selector_t<
-              data_type_a, data_type_b, layout_a, layout_b, mem_space::global,
-              mem_space::global, 8, 8, data_type_acc, tile_shape, SG_K,
-              mma_engine::xmx, gpu_arch::Xe, prefetch_distance,
-              periodic_sync_interval>::gemm;
-          using epilogue_t = group::epilogue_t<
-              xetla::group::epilogue_policy_tile_op<
-                  xetla::subgroup::chained_tile_op_t<
-                      epilogue_impl::bias_op_t<data_type_bias>>,
-                  gpu_arch::Xe>,
-              tile_shape,
-              mem_desc_t<scalar_t, mem_layout::row_major, mem_space::global>>;
-          using group_swizzle =
-              gpu::xetla::kernel::group_swizzle_default<gpu_arch::Xe>;
-          using gemm_op_t = gpu::xetla::kernel::gemm_universal_t<
-              gpu::xetla::kernel::dispatch_policy_kslicing<group_swizzle, L3_KS,
-                                                           SLM_KS>,
-              brgemm_t, epilogue_t>;
-          typename gemm_op_t::arguments_t arg(m, k, n, const_cast<scalar_t*>(a),
-                                              lda, const_cast<scalar_t*>(b),
-                                              ldb, out, ldc, {}, {}, {{{}}});
-          slm_barrier_init<gemm_op_t>();
-          gemm_op_t gemm_op;
-          gemm_op(ei, arg);
-        });
-  };
-  DPCPP_Q_SUBMIT(queue, cgf);
-}
+inline void hgemm_qkv(sycl::queue& queue, scalar_t* out0, scalar_t* out1,
+                      scalar_t* out2, const scalar_t* a, const scalar_t* b,
+                      const int m, const int n, const int k) {
+  static_assert(L3_KS == 1, "for qkv fusion, L3_KS should be 1");
+  constexpr mem_layout layout_a = mem_layout::row_major;
+  constexpr mem_layout layout_b =
+      B_ROW_MAJOR ? mem_layout::row_major : mem_layout::col_major;
+  uint32_t group_range_m = (m + WG_M - 1) / WG_M;
+  uint32_t group_range_n = (n + WG_N - 1) / WG_N;
+  uint32_t thread_range_m = WG_M / SG_M;
+  uint32_t thread_range_n = WG_N / SG_N;
+  uint32_t lda = k;
+  uint32_t ldb = B_ROW_MAJOR ? n : k;
+  uint32_t ldc = n;
+  cl::sycl::range<3> GroupRange{3, group_range_m, group_range_n};
+  cl::sycl::range<3> LocalRange{SLM_KS, thread_range_m, thread_range_n};
+  cl::sycl::nd_range<3> NDRange(GroupRange * LocalRange, LocalRange);
 
-template <typename scalar_t, int WG_M, int WG_N, int SG_M, int SG_N, int SG_K,
-          int SLM_KS, int L3_KS = 1, int SYNC_FREQ = 1, int STAGES = 3,
-          bool B_ROW_MAJOR = true>
-inline void hgemm_bias_res(sycl::queue& queue, scalar_t* out, const scalar_t* a,
-                           const scalar_t* b, const scalar_t* bias,
-                           const scalar_t* res, const int m, const int n,
-                           const int k, const float bias_factor,
-                           const float res_factor) {
-  HGEMM_DEFINITIONS
   auto cgf = DPCPP_Q_CGF(cgh) {
     cgh.parallel_for<
-        HGEMM_BIAS_RES_KERNEL<scalar_t, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS,
-                              L3_KS, SYNC_FREQ, STAGES, B_ROW_MAJOR>>(
+        HGEMM_QKV_KERNEL<scalar_t, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS, L3_KS,
+                         SYNC_FREQ, STAGES, B_ROW_MAJOR>>(
         NDRange, [=](sycl::nd_item<3> item) SYCL_ESIMD_KERNEL {
           sycl::nd_item<3> ei(item);
+
           using data_type_b = scalar_t;
           using data_type_a = scalar_t;
           using data_type_c = scalar_t;
-          using data_type_bias = scalar_t;
-          using data_type_res = scalar_t;
           using data_type_acc = float;
           static constexpr uint32_t periodic_sync_interval = SYNC_FREQ;
           static constexpr uint32_t prefetch_distance = STAGES;
           using tile_shape = group::tile_shape_t<WG_N, WG_M, SG_N, SG_M>;
+
           using brgemm_t = typename group::gemm_selector_t<
               data_type_a, data_type_b, layout_a, layout_b, mem_space::global,
               mem_space::global, 8, 8, data_type_acc, tile_shape, SG_K,
@@ -381,10 +410,7 @@ inline void hgemm_bias_res(sycl::queue& queue, scalar_t* out, const scalar_t* a,
               periodic_sync_interval>::gemm;
           using epilogue_t = group::epilogue_t<
               xetla::group::epilogue_policy_tile_op<
-                  xetla::subgroup::chained_tile_op_t<
-                      epilogue_impl::bias_op_t<data_type_bias>,
-                      epilogue_impl::res_op_t<data_type_res>>,
-                  gpu_arch::Xe>,
+                  xetla::subgroup::chained_tile_op_t<>, gpu_arch::Xe>,
               tile_shape,
               mem_desc_t<scalar_t, mem_layout::row_major, mem_space::global>>;
           using group_swizzle =
@@ -393,65 +419,17 @@ inline void hgemm_bias_res(sycl::queue& queue, scalar_t* out, const scalar_t* a,
               gpu::xetla::kernel::dispatch_policy_kslicing<group_swizzle, L3_KS,
                                                            SLM_KS>,
               brgemm_t, epilogue_t>;
-          typename gemm_op_t::arguments_t arg(
-              m, k, n, const_cast<scalar_t*>(a), lda, const_cast<scalar_t*>(b),
-              ldb, out, ldc, {}, {},
-              {{{const_cast<scalar_t*>(bias), {n, 1, n}, bias_factor},
-                {const_cast<scalar_t*>(res), {n, m, n}, res_factor}}});
+
+          uint32_t batch_id = ei.get_group(0);
           slm_barrier_init<gemm_op_t>();
-          gemm_op_t gemm_op;
-          gemm_op(ei, arg);
-        });
-  };
-  DPCPP_Q_SUBMIT(queue, cgf);
-}
+          scalar_t* out =
+              (batch_id == 0) ? out0 : ((batch_id == 1) ? out1 : out2);
+
+          uint32_t size_b = k * n;
 
-template <typename scalar_t, int WG_M, int WG_N, int SG_M, int SG_N, int SG_K,
-          int SLM_KS, int L3_KS = 1, int SYNC_FREQ = 1, int STAGES = 3,
-          bool B_ROW_MAJOR = true>
-inline void hgemm_bias_gelu(sycl::queue& queue, scalar_t* out,
-                            const scalar_t* a, const scalar_t* b,
-                            const scalar_t* bias, const int m, const int n,
-                            const int k, const float bias_factor) {
-  HGEMM_DEFINITIONS
-  auto cgf = DPCPP_Q_CGF(cgh) {
-    cgh.parallel_for<
-        HGEMM_BIAS_GELU_KERNEL<scalar_t, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS,
-                               L3_KS, SYNC_FREQ, STAGES, B_ROW_MAJOR>>(
-        NDRange, [=](sycl::nd_item<3> item) SYCL_ESIMD_KERNEL {
-          sycl::nd_item<3> ei(item);
-          using data_type_b = scalar_t;
-          using data_type_a = scalar_t;
-          using data_type_c = scalar_t;
-          using data_type_bias = scalar_t;
-          using data_type_acc = float;
-          static constexpr uint32_t periodic_sync_interval = SYNC_FREQ;
-          static constexpr uint32_t prefetch_distance = STAGES;
-          using tile_shape = group::tile_shape_t<WG_N, WG_M, SG_N, SG_M>;
-          using brgemm_t = typename group::gemm_selector_t<
-              data_type_a, data_type_b, layout_a, layout_b, mem_space::global,
-              mem_space::global, 8, 8, data_type_acc, tile_shape, SG_K,
-              mma_engine::xmx, gpu_arch::Xe, prefetch_distance,
-              periodic_sync_interval>::gemm;
-          using epilogue_t = group::epilogue_t<
-              xetla::group::epilogue_policy_tile_op<
-                  xetla::subgroup::chained_tile_op_t<
-                      epilogue_impl::bias_op_t<data_type_bias>,
-                      subgroup::gelu_fwd_op_t>,
-                  gpu_arch::Xe>,
-              tile_shape,
-              mem_desc_t<scalar_t, mem_layout::row_major, mem_space::global>>;
-          using group_swizzle =
-              gpu::xetla::kernel::group_swizzle_default<gpu_arch::Xe>;
-          using gemm_op_t = gpu::xetla::kernel::gemm_universal_t<
-              gpu::xetla::kernel::dispatch_policy_kslicing<group_swizzle, L3_KS,
-                                                           SLM_KS>,
-              brgemm_t, epilogue_t>;
           typename gemm_op_t::arguments_t arg(
-              m, k, n, const_cast<scalar_t*>(a), lda, const_cast<scalar_t*>(b),
-              ldb, out, ldc, {}, {},
-              {{{const_cast<scalar_t*>(bias), {n, 1, n}, bias_factor}, {}}});
-          slm_barrier_init<gemm_op_t>();
+              m, k, n, const_cast<scalar_t*>(a), lda,
+              const_cast<scalar_t*>(b) + size_b * batch_id, ldb, out, ldc);
           gemm_op_t gemm_op;
           gemm_op(ei, arg);
         });
@@ -462,9 +440,10 @@ inline void hgemm_bias_gelu(sycl::queue& queue, scalar_t* out,
 template <typename scalar_t, int WG_M, int WG_N, int SG_M, int SG_N, int SG_K,
           int SLM_KS, int L3_KS = 1, int SYNC_FREQ = 1, int STAGES = 3,
           bool B_ROW_MAJOR = true>
-inline void hgemm_qkv(sycl::queue& queue, scalar_t* out0, scalar_t* out1,
-                      scalar_t* out2, const scalar_t* a, const scalar_t* b,
-                      const int m, const int n, const int k) {
+inline void hgemm_qkv_bias(sycl::queue& queue, scalar_t* out0, scalar_t* out1,
+                           scalar_t* out2, const scalar_t* a, const scalar_t* b,
+                           const scalar_t* bias, const int m, const int n,
+                           const int k) {
   static_assert(L3_KS == 1, "for qkv fusion, L3_KS should be 1");
   constexpr mem_layout layout_a = mem_layout::row_major;
   constexpr mem_layout layout_b =
@@ -482,14 +461,15 @@ inline void hgemm_qkv(sycl::queue& queue, scalar_t* out0, scalar_t* out1,
 
   auto cgf = DPCPP_Q_CGF(cgh) {
     cgh.parallel_for<
-        HGEMM_QKV_KERNEL<scalar_t, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS, L3_KS,
-                         SYNC_FREQ, STAGES, B_ROW_MAJOR>>(
+        HGEMM_QKV_BIAS_KERNEL<scalar_t, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS,
+                              L3_KS, SYNC_FREQ, STAGES, B_ROW_MAJOR>>(
         NDRange, [=](sycl::nd_item<3> item) SYCL_ESIMD_KERNEL {
           sycl::nd_item<3> ei(item);
 
           using data_type_b = scalar_t;
           using data_type_a = scalar_t;
           using data_type_c = scalar_t;
+          using data_type_bias = scalar_t;
           using data_type_acc = float;
           static constexpr uint32_t periodic_sync_interval = SYNC_FREQ;
           static constexpr uint32_t prefetch_distance = STAGES;
@@ -502,7 +482,9 @@ inline void hgemm_qkv(sycl::queue& queue, scalar_t* out0, scalar_t* out1,
               periodic_sync_interval>::gemm;
           using epilogue_t = group::epilogue_t<
               xetla::group::epilogue_policy_tile_op<
-                  xetla::subgroup::chained_tile_op_t<>, gpu_arch::Xe>,
+                  xetla::subgroup::chained_tile_op_t<
+                      epilogue_impl::bias_op_t<data_type_bias>>,
+                  gpu_arch::Xe>,
               tile_shape,
               mem_desc_t<scalar_t, mem_layout::row_major, mem_space::global>>;
           using group_swizzle =
@@ -518,10 +500,15 @@ inline void hgemm_qkv(sycl::queue& queue, scalar_t* out0, scalar_t* out1,
               (batch_id == 0) ? out0 : ((batch_id == 1) ? out1 : out2);
 
           uint32_t size_b = k * n;
+          uint32_t size_bias = n;
 
           typename gemm_op_t::arguments_t arg(
               m, k, n, const_cast<scalar_t*>(a), lda,
-              const_cast<scalar_t*>(b) + size_b * batch_id, ldb, out, ldc);
+              const_cast<scalar_t*>(b) + size_b * batch_id, ldb, out, ldc, {},
+              {},
+              {{{const_cast<scalar_t*>(bias) + size_bias * batch_id,
+                 {n, 1, n},
+                 {1}}}});
           gemm_op_t gemm_op;
           gemm_op(ei, arg);
         });
@@ -529,13 +516,17 @@ inline void hgemm_qkv(sycl::queue& queue, scalar_t* out0, scalar_t* out1,
   DPCPP_Q_SUBMIT(queue, cgf);
 }
 
+// Like hgemm_qkv, but rotates Q and K with the [m, head_size] cos and sin
+// tables of epilogue_impl::rotary_op_t before they are written, so that RoPE
+// does not read and write them again.
 template <typename scalar_t, int WG_M, int WG_N, int SG_M, int SG_N, int SG_K,
           int SLM_KS, int L3_KS = 1, int SYNC_FREQ = 1, int STAGES = 3,
           bool B_ROW_MAJOR = true>
-inline void hgemm_qkv_bias(sycl::queue& queue, scalar_t* out0, scalar_t* out1,
+inline void hgemm_qkv_rope(sycl::queue& queue, scalar_t* out0, scalar_t* out1,
                            scalar_t* out2, const scalar_t* a, const scalar_t* b,
-                           const scalar_t* bias, const int m, const int n,
-                           const int k) {
+                           const scalar_t* cos, const scalar_t* sin,
+                           const int m, const int n, const int k,
+                           const int head_size) {
   static_assert(L3_KS == 1, "for qkv fusion, L3_KS should be 1");
   constexpr mem_layout layout_a = mem_layout::row_major;
   constexpr mem_layout layout_b =
@@ -553,7 +544,7 @@ inline void hgemm_qkv_bias(sycl::queue& queue, scalar_t* out0, scalar_t* out1,
 
   auto cgf = DPCPP_Q_CGF(cgh) {
     cgh.parallel_for<
-        HGEMM_QKV_BIAS_KERNEL<scalar_t, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS,
+        HGEMM_QKV_ROPE_KERNEL<scalar_t, WG_M, WG_N, SG_M, SG_N, SG_K, SLM_KS,
                               L3_KS, SYNC_FREQ, STAGES, B_ROW_MAJOR>>(
         NDRange, [=](sycl::nd_item<3> item) SYCL_ESIMD_KERNEL {
           sycl::nd_item<3> ei(item);
@@ -561,7 +552,6 @@ inline void hgemm_qkv_bias(sycl::queue& queue, scalar_t* out0, scalar_t* out1,
           using data_type_b = scalar_t;
           using data_type_a = scalar_t;
           using data_type_c = scalar_t;
-          using data_type_bias = scalar_t;
           using data_type_acc = float;
           static constexpr uint32_t periodic_sync_interval = SYNC_FREQ;
           static constexpr uint32_t prefetch_distance = STAGES;
@@ -575,7 +565,7 @@ inline void hgemm_qkv_bias(sycl::queue& queue, scalar_t* out0, scalar_t* out1,
           using epilogue_t = group::epilogue_t<
               xetla::group::epilogue_policy_tile_op<
                   xetla::subgroup::chained_tile_op_t<
-                      epilogue_impl::bias_op_t<data_type_bias>>,
+                      epilogue_impl::rotary_op_t<scalar_t>>,
                   gpu_arch::Xe>,
               tile_shape,
               mem_desc_t<scalar_t, mem_layout::row_major, mem_space::global>>;
@@ -592,15 +582,17 @@ inline void hgemm_qkv_bias(sycl::queue& queue, scalar_t* out0, scalar_t* out1,
               (batch_id == 0) ? out0 : ((batch_id == 1) ? out1 : out2);
 
           uint32_t size_b = k * n;
-          uint32_t size_bias = n;
+          uint32_t table_width = head_size;
+          uint32_t table_height = m;
 
           typename gemm_op_t::arguments_t arg(
               m, k, n, const_cast<scalar_t*>(a), lda,
               const_cast<scalar_t*>(b) + size_b * batch_id, ldb, out, ldc, {},
               {},
-              {{{const_cast<scalar_t*>(bias) + size_bias * batch_id,
-                 {n, 1, n},
-                 {1}}}});
+              {{{const_cast<scalar_t*>(cos), const_cast<scalar_t*>(sin),
+                 {table_width, table_height, table_width},
+                 table_width,
+                 batch_id != 2}}});
           gemm_op_t gemm_op;
           gemm_op(ei, arg);
         });
@@ -0,0 +1,318 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*
+Layer Norm and RMS Norm
+
+Row-wise normalization over the hidden dimension (Ba et al.,
+https://arxiv.org/abs/1607.06450 and Zhang and Sennrich,
+https://arxiv.org/abs/1910.07467). Every row is normalized by one work group,
+so a row is read once and written once: each work item keeps its strided
+elements of the row in registers while the group reduces the mean and the
+variance through SLM. Rows longer than kMaxElems * kWgSize elements are read
+again for every pass instead.
+
+The statistics are computed in float, first the mean and then the mean of
+the squared deviations from the registers, which avoids the cancellation of
+E[x^2] - E[x]^2.
+
+The backward computes dx row by row the same way. The weight gradients are
+sums over the rows: num_partials work groups per column block each sum a
+contiguous range of rows into a workspace, which a second kernel reduces, so
+the result doesn't depend on the order work groups run in.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include <sycl/sycl.hpp>
+
+#include "norm_utils.h"
+
+namespace gpu::xetla {
+
+namespace norm {
+
+template <typename T, typename W, uint32_t kElems, bool kRms>
+class NormForwardKernel;
+
+template <typename T, typename W, uint32_t kElems, bool kRms>
+class NormBackwardDxKernel;
+
+template <typename T, typename W, bool kRms>
+class NormBackwardPartialKernel;
+
+template <typename W, bool kRms>
+class NormBackwardReduceKernel;
+
+// x, y:         [rows, cols]
+// gamma, beta:  [cols], beta is unused for the RMS norm
+// mean, rstd:   [rows], may be null
+template <typename T, typename W, uint32_t kElems, bool kRms>
+void norm_forward_impl(sycl::queue& q, const T* x, const W* gamma,
+                       const W* beta, T* y, float* mean, float* rstd,
+                       uint32_t rows, uint32_t cols, float epsilon) {
+  q.submit([&](sycl::handler& cgh) {
+    sycl::local_accessor<float, 1> slm(sycl::range<1>(kNumSg), cgh);
+    cgh.parallel_for<NormForwardKernel<T, W, kElems, kRms>>(
+        sycl::nd_range<1>(static_cast<size_t>(rows) * kWgSize, kWgSize),
+        [=](sycl::nd_item<1> item) [[sycl::reqd_sub_group_size(kSgSize)]] {
+          const size_t row = item.get_group(0);
+          const uint32_t lid = item.get_local_linear_id();
+          const T* x_row = x + row * cols;
+          T* y_row = y + row * cols;
+          float* slm_ptr =
+              slm.template get_multi_ptr<sycl::access::decorated::no>().get();
+
+          // Each work item holds every kWgSize-th element of the row so that
+          // the loads of a sub-group are contiguous.
+          float reg[kElems > 0 ? kElems : 1];
+          if constexpr (kElems > 0) {
+#pragma unroll
+            for (uint32_t i = 0; i < kElems; ++i) {
+              const uint32_t c = i * kWgSize + lid;
+              reg[i] = c < cols ? static_cast<float>(x_row[c]) : 0.f;
+            }
+          }
+
+          float row_mean = 0.f;
+          if constexpr (!kRms) {
+            float sum = 0.f;
+            if constexpr (kElems > 0) {
+#pragma unroll
+              for (uint32_t i = 0; i < kElems; ++i) sum += reg[i];
+            } else {
+              for (uint32_t c = lid; c < cols; c += kWgSize) {
+                sum += static_cast<float>(x_row[c]);
+              }
+            }
+            row_mean = group_sum(item, slm_ptr, sum) / cols;
+          }
+
+          float sum_sq = 0.f;
+          if constexpr (kElems > 0) {
+#pragma unroll
+            for (uint32_t i = 0; i < kElems; ++i) {
+              const float d =
+                  i * kWgSize + lid < cols ? reg[i] - row_mean : 0.f;
+              sum_sq += d * d;
+            }
+          } else {
+            for (uint32_t c = lid; c < cols; c += kWgSize) {
+              const float d = static_cast<float>(x_row[c]) - row_mean;
+              sum_sq += d * d;
+            }
+          }
+          const float row_rstd =
+              sycl::rsqrt(group_sum(item, slm_ptr, sum_sq) / cols + epsilon);
+          if (lid == 0) {
+            if (!kRms && mean != nullptr) mean[row] = row_mean;
+            if (rstd != nullptr) rstd[row] = row_rstd;
+          }
+
+          auto normalize = [&](uint32_t c, float v) {
+            float out =
+                (v - row_mean) * row_rstd * static_cast<float>(gamma[c]);
+            if constexpr (!kRms) out += static_cast<float>(beta[c]);
+            y_row[c] = static_cast<T>(out);
+          };
+          if constexpr (kElems > 0) {
+#pragma unroll
+            for (uint32_t i = 0; i < kElems; ++i) {
+              const uint32_t c = i * kWgSize + lid;
+              if (c < cols) normalize(c, reg[i]);
+            }
+          } else {
+            for (uint32_t c = lid; c < cols; c += kWgSize) {
+              normalize(c, static_cast<float>(x_row[c]));
+            }
+          }
+        });
+  });
+}
+
+// dy, x, dx:  [rows, cols]
+// gamma:      [cols]
+// mean, rstd: [rows], mean is unused for the RMS norm
+template <typename T, typename W, uint32_t kElems, bool kRms>
+void norm_backward_dx_impl(sycl::queue& q, const T* dy, const T* x,
+                           const W* gamma, const float* mean,
+                           const float* rstd, T* dx, uint32_t rows,
+                           uint32_t cols) {
+  q.submit([&](sycl::handler& cgh) {
+    sycl::local_accessor<float, 1> slm(sycl::range<1>(kNumSg), cgh);
+    cgh.parallel_for<NormBackwardDxKernel<T, W, kElems, kRms>>(
+        sycl::nd_range<1>(static_cast<size_t>(rows) * kWgSize, kWgSize),
+        [=](sycl::nd_item<1> item) [[sycl::reqd_sub_group_size(kSgSize)]] {
+          const size_t row = item.get_group(0);
+          const uint32_t lid = item.get_local_linear_id();
+          const T* dy_row = dy + row * cols;
+          const T* x_row = x + row * cols;
+          T* dx_row = dx + row * cols;
+          float* slm_ptr =
+              slm.template get_multi_ptr<sycl::access::decorated::no>().get();
+          const float row_mean = kRms ? 0.f : mean[row];
+          const float row_rstd = rstd[row];
+
+          // With g = dy * gamma and xhat the normalized x:
+          //   dx = rstd * (g - mean(g) - xhat * mean(g * xhat))
+          // where mean(g) is 0 for the RMS norm.
+          auto load = [&](uint32_t c, float& g, float& xhat) {
+            g = static_cast<float>(dy_row[c]) * static_cast<float>(gamma[c]);
+            xhat = (static_cast<float>(x_row[c]) - row_mean) * row_rstd;
+          };
+          float g_reg[kElems > 0 ? kElems : 1];
+          float xhat_reg[kElems > 0 ? kElems : 1];
+          float sum_g = 0.f;
+          float sum_gx = 0.f;
+          if constexpr (kElems > 0) {
+#pragma unroll
+            for (uint32_t i = 0; i < kElems; ++i) {
+              const uint32_t c = i * kWgSize + lid;
+              g_reg[i] = 0.f;
+              xhat_reg[i] = 0.f;
+              if (c < cols) load(c, g_reg[i], xhat_reg[i]);
+              sum_g += g_reg[i];
+              sum_gx += g_reg[i] * xhat_reg[i];
+            }
+          } else {
+            for (uint32_t c = lid; c < cols; c += kWgSize) {
+              float g, xhat;
+              load(c, g, xhat);
+              sum_g += g;
+              sum_gx += g * xhat;
+            }
+          }
+          const float mean_g =
+              kRms ? 0.f : group_sum(item, slm_ptr, sum_g) / cols;
+          const float mean_gx = group_sum(item, slm_ptr, sum_gx) / cols;
+
+          if constexpr (kElems > 0) {
+#pragma unroll
+            for (uint32_t i = 0; i < kElems; ++i) {
+              const uint32_t c = i * kWgSize + lid;
+              if (c < cols) {
+                dx_row[c] = static_cast<T>(
+                    row_rstd * (g_reg[i] - mean_g - xhat_reg[i] * mean_gx));
+              }
+            }
+          } else {
+            for (uint32_t c = lid; c < cols; c += kWgSize) {
+              float g, xhat;
+              load(c, g, xhat);
+              dx_row[c] =
+                  static_cast<T>(row_rstd * (g - mean_g - xhat * mean_gx));
+            }
+          }
+        });
+  });
+}
+
+// Sums dy * xhat (and dy) over the rows of every column into workspace
+// [1 or 2, num_partials, cols], then over the partials into dgamma (and
+// dbeta).
+template <typename T, typename W, bool kRms>
+void norm_backward_weights_impl(sycl::queue& q, const T* dy, const T* x,
+                                const float* mean, const float* rstd,
+                                W* dgamma, W* dbeta, float* workspace,
+                                uint32_t num_partials, uint32_t rows,
+                                uint32_t cols) {
+  const uint32_t col_blocks = (cols + kWgSize - 1) / kWgSize;
+  const uint32_t rows_per_partial = (rows + num_partials - 1) / num_partials;
+  q.submit([&](sycl::handler& cgh) {
+    cgh.parallel_for<NormBackwardPartialKernel<T, W, kRms>>(
+        sycl::nd_range<2>(sycl::range<2>(num_partials, col_blocks * kWgSize),
+                          sycl::range<2>(1, kWgSize)),
+        [=](sycl::nd_item<2> item) {
+          const uint32_t partial = item.get_group(0);
+          const uint32_t c = item.get_global_id(1);
+          if (c >= cols) return;
+          const uint32_t begin = partial * rows_per_partial;
+          const uint32_t end = sycl::min(begin + rows_per_partial, rows);
+          float dg = 0.f;
+          float db = 0.f;
+          for (uint32_t r = begin; r < end; ++r) {
+            const size_t idx = static_cast<size_t>(r) * cols + c;
+            const float d = static_cast<float>(dy[idx]);
+            const float row_mean = kRms ? 0.f : mean[r];
+            dg += d * (static_cast<float>(x[idx]) - row_mean) * rstd[r];
+            db += d;
+          }
+          workspace[static_cast<size_t>(partial) * cols + c] = dg;
+          if constexpr (!kRms) {
+            workspace[(static_cast<size_t>(num_partials) + partial) * cols +
+                      c] = db;
+          }
+        });
+  });
+  q.submit([&](sycl::handler& cgh) {
+    cgh.parallel_for<NormBackwardReduceKernel<W, kRms>>(
+        sycl::nd_range<1>(col_blocks * kWgSize, kWgSize),
+        [=](sycl::nd_item<1> item) {
+          const uint32_t c = item.get_global_id(0);
+          if (c >= cols) return;
+          float dg = 0.f;
+          float db = 0.f;
+          for (uint32_t p = 0; p < num_partials; ++p) {
+            dg += workspace[static_cast<size_t>(p) * cols + c];
+            if constexpr (!kRms) {
+              db += workspace[(static_cast<size_t>(num_partials) + p) * cols +
+                              c];
+            }
+          }
+          dgamma[c] = static_cast<W>(dg);
+          if constexpr (!kRms) dbeta[c] = static_cast<W>(db);
+        });
+  });
+}
+
+}  // namespace norm
+
+/// @brief Main execution function for the layer norm (kRms = false) and RMS
+/// norm (kRms = true) forward.
+template <typename T, typename W, bool kRms>
+void norm_forward(sycl::queue& q, const T* x, const W* gamma, const W* beta,
+                  T* y, float* mean, float* rstd, uint32_t rows, uint32_t cols,
+                  float epsilon) {
+  if (rows == 0 || cols == 0) return;
+  NORM_ELEMS_SWITCH(cols, [&] {
+    norm::norm_forward_impl<T, W, kElems, kRms>(q, x, gamma, beta, y, mean,
+                                                rstd, rows, cols, epsilon);
+  });
+}
+
+/// @brief Main execution function for the layer norm (kRms = false) and RMS
+/// norm (kRms = true) backward.
+template <typename T, typename W, bool kRms>
+void norm_backward(sycl::queue& q, const T* dy, const T* x, const W* gamma,
+                   const float* mean, const float* rstd, T* dx, W* dgamma,
+                   W* dbeta, float* workspace, uint32_t num_partials,
+                   uint32_t rows, uint32_t cols) {
+  if (cols == 0) return;
+  if (rows > 0) {
+    NORM_ELEMS_SWITCH(cols, [&] {
+      norm::norm_backward_dx_impl<T, W, kElems, kRms>(q, dy, x, gamma, mean,
+                                                      rstd, dx, rows, cols);
+    });
+  }
+  num_partials = std::max(1u, std::min(num_partials, rows));
+  norm::norm_backward_weights_impl<T, W, kRms>(q, dy, x, mean, rstd, dgamma,
+                                               dbeta, workspace, num_partials,
+                                               rows, cols);
+}
+
+}  // namespace gpu::xetla
@@ -0,0 +1,122 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "norm.h"
+
+#include "layer_norm.h"
+#include "softmax.h"
+#include "xetla.hpp"
+
+namespace gpu::xetla {
+
+namespace {
+
+// Calls `func` with values of the element types of the rows and the weights.
+// The weights are either in the type of the rows or in F32.
+template <typename Func>
+bool dispatch_norm_types(NormDataType x_type, NormDataType w_type,
+                         Func&& func) {
+  if (w_type != x_type && w_type != NormDataType::kF32) return false;
+  const bool f32_weights = w_type == NormDataType::kF32;
+  switch (x_type) {
+    case NormDataType::kF32:
+      func(float(), float());
+      return true;
+    case NormDataType::kF16:
+      f32_weights ? func(fp16(), float()) : func(fp16(), fp16());
+      return true;
+    case NormDataType::kBF16:
+      f32_weights ? func(bf16(), float()) : func(bf16(), bf16());
+      return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+bool layer_norm_forward_kernel(sycl::queue& q, NormDataType x_type,
+                               NormDataType w_type, const void* x,
+                               const void* gamma, const void* beta, void* y,
+                               float* mean, float* rstd, uint32_t rows,
+                               uint32_t cols, float epsilon) {
+  return dispatch_norm_types(x_type, w_type, [&](auto t, auto w) {
+    using T = decltype(t);
+    using W = decltype(w);
+    norm_forward<T, W, false>(
+        q, static_cast<const T*>(x), static_cast<const W*>(gamma),
+        static_cast<const W*>(beta), static_cast<T*>(y), mean, rstd, rows,
+        cols, epsilon);
+  });
+}
+
+bool rms_norm_forward_kernel(sycl::queue& q, NormDataType x_type,
+                             NormDataType w_type, const void* x,
+                             const void* gamma, void* y, float* rstd,
+                             uint32_t rows, uint32_t cols, float epsilon) {
+  return dispatch_norm_types(x_type, w_type, [&](auto t, auto w) {
+    using T = decltype(t);
+    using W = decltype(w);
+    norm_forward<T, W, true>(q, static_cast<const T*>(x),
+                             static_cast<const W*>(gamma), nullptr,
+                             static_cast<T*>(y), nullptr, rstd, rows, cols,
+                             epsilon);
+  });
+}
+
+bool layer_norm_backward_kernel(sycl::queue& q, NormDataType x_type,
+                                NormDataType w_type, const void* dy,
+                                const void* x, const void* gamma,
+                                const float* mean, const float* rstd, void* dx,
+                                void* dgamma, void* dbeta, float* workspace,
+                                uint32_t num_partials, uint32_t rows,
+                                uint32_t cols) {
+  return dispatch_norm_types(x_type, w_type, [&](auto t, auto w) {
+    using T = decltype(t);
+    using W = decltype(w);
+    norm_backward<T, W, false>(
+        q, static_cast<const T*>(dy), static_cast<const T*>(x),
+        static_cast<const W*>(gamma), mean, rstd, static_cast<T*>(dx),
+        static_cast<W*>(dgamma), static_cast<W*>(dbeta), workspace,
+        num_partials, rows, cols);
+  });
+}
+
+bool rms_norm_backward_kernel(sycl::queue& q, NormDataType x_type,
+                              NormDataType w_type, const void* dy,
+                              const void* x, const void* gamma,
+                              const float* rstd, void* dx, void* dgamma,
+                              float* workspace, uint32_t num_partials,
+                              uint32_t rows, uint32_t cols) {
+  return dispatch_norm_types(x_type, w_type, [&](auto t, auto w) {
+    using T = decltype(t);
+    using W = decltype(w);
+    norm_backward<T, W, true>(
+        q, static_cast<const T*>(dy), static_cast<const T*>(x),
+        static_cast<const W*>(gamma), nullptr, rstd, static_cast<T*>(dx),
+        static_cast<W*>(dgamma), nullptr, workspace, num_partials, rows,
+        cols);
+  });
+}
+
+bool softmax_forward_kernel(sycl::queue& q, NormDataType type, const void* x,
+                            void* y, uint32_t rows, uint32_t cols) {
+  return dispatch_norm_types(type, type, [&](auto t, auto) {
+    using T = decltype(t);
+    softmax_forward<T>(q, static_cast<const T*>(x), static_cast<T*>(y), rows,
+                       cols);
+  });
+}
+
+}  // namespace gpu::xetla
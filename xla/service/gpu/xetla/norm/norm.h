@@ -0,0 +1,78 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#pragma once
+
+#include <cstdint>
+
+#include <sycl/sycl.hpp>
+
+namespace gpu::xetla {
+
+// Element types of the row-wise kernels. The rows and the weights (gamma and
+// beta) may have different types, e.g. BF16 activations with F32 weights.
+enum class NormDataType { kF32, kF16, kBF16 };
+
+// Normalizes every row of x [rows, cols] over its cols elements:
+//
+//   layer norm: y = (x - mean) * rstd * gamma + beta
+//   RMS norm:   y = x * rstd * gamma
+//
+// with rstd = 1 / sqrt(var + epsilon), where var is the mean of the squares
+// for the RMS norm. gamma and beta are [cols]. mean (layer norm only) and rstd
+// are f32[rows] and receive the statistics of every row if not null, for the
+// backward. Returns false if the types are not supported.
+bool layer_norm_forward_kernel(sycl::queue& q, NormDataType x_type,
+                               NormDataType w_type, const void* x,
+                               const void* gamma, const void* beta, void* y,
+                               float* mean, float* rstd, uint32_t rows,
+                               uint32_t cols, float epsilon);
+
+bool rms_norm_forward_kernel(sycl::queue& q, NormDataType x_type,
+                             NormDataType w_type, const void* x,
+                             const void* gamma, void* y, float* rstd,
+                             uint32_t rows, uint32_t cols, float epsilon);
+
+// Returns the number of f32 elements of the workspace the backward kernels
+// reduce dgamma (and dbeta) in, with `num_partials` partial sums per column.
+inline size_t norm_backward_workspace_size(uint32_t num_partials,
+                                           uint32_t cols, bool has_beta) {
+  return static_cast<size_t>(num_partials) * cols * (has_beta ? 2 : 1);
+}
+
+// Computes dx [rows, cols] and dgamma, dbeta [cols] of the forward above from
+// dy, x, gamma and the saved mean (layer norm only) and rstd. The weight
+// gradients are reduced through `workspace` with room for `num_partials`
+// partial sums per column, see norm_backward_workspace_size.
+bool layer_norm_backward_kernel(sycl::queue& q, NormDataType x_type,
+                                NormDataType w_type, const void* dy,
+                                const void* x, const void* gamma,
+                                const float* mean, const float* rstd, void* dx,
+                                void* dgamma, void* dbeta, float* workspace,
+                                uint32_t num_partials, uint32_t rows,
+                                uint32_t cols);
+
+bool rms_norm_backward_kernel(sycl::queue& q, NormDataType x_type,
+                              NormDataType w_type, const void* dy,
+                              const void* x, const void* gamma,
+                              const float* rstd, void* dx, void* dgamma,
+                              float* workspace, uint32_t num_partials,
+                              uint32_t rows, uint32_t cols);
+
+// y = exp(x - max(x)) / sum(exp(x - max(x))) over every row of x [rows, cols].
+bool softmax_forward_kernel(sycl::queue& q, NormDataType type, const void* x,
+                            void* y, uint32_t rows, uint32_t cols);
+
+}  // namespace gpu::xetla
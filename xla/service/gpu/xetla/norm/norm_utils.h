@@ -0,0 +1,104 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#pragma once
+
+#include <cstdint>
+
+#include <sycl/sycl.hpp>
+
+namespace gpu::xetla::norm {
+
+constexpr uint32_t kSgSize = 16;
+constexpr uint32_t kNumSg = 16;
+// Every row is handled by one work group of kWgSize work items.
+constexpr uint32_t kWgSize = kSgSize * kNumSg;
+
+// Largest number of elements of a row every work item keeps in registers.
+// Longer rows are read from memory again for every pass.
+constexpr uint32_t kMaxElems = 32;
+
+// Returns the number of elements of a row every work item keeps in registers,
+// a power of two, or 0 if the row doesn't fit and is streamed instead.
+inline uint32_t elems_per_item(uint32_t cols) {
+  for (uint32_t elems = 1; elems <= kMaxElems; elems *= 2) {
+    if (cols <= elems * kWgSize) return elems;
+  }
+  return 0;
+}
+
+// Reduces `value` over the work group of `item` with `op`: the sub-groups
+// reduce in registers, then every work item combines the kNumSg partial
+// results from SLM. `slm` has room for kNumSg floats and may be reused by the
+// next reduction right away.
+template <typename Op>
+inline float group_reduce(sycl::nd_item<1> item, float* slm, float value,
+                          Op op, float identity) {
+  sycl::sub_group sg = item.get_sub_group();
+  value = sycl::reduce_over_group(sg, value, op);
+  if (sg.get_local_linear_id() == 0) slm[sg.get_group_linear_id()] = value;
+  sycl::group_barrier(item.get_group());
+  float result = identity;
+#pragma unroll
+  for (uint32_t i = 0; i < kNumSg; ++i) result = op(result, slm[i]);
+  sycl::group_barrier(item.get_group());
+  return result;
+}
+
+inline float group_sum(sycl::nd_item<1> item, float* slm, float value) {
+  return group_reduce(item, slm, value, sycl::plus<float>(), 0.f);
+}
+
+inline float group_max(sycl::nd_item<1> item, float* slm, float value) {
+  return group_reduce(item, slm, value, sycl::maximum<float>(), -INFINITY);
+}
+
+}  // namespace gpu::xetla::norm
+
+// Runs the lambda in the varargs with the constant kElems set to the number of
+// elements per work item for rows of `cols` elements.
+#define NORM_ELEMS_SWITCH(cols, ...)                          \
+  [&] {                                                       \
+    switch (::gpu::xetla::norm::elems_per_item(cols)) {       \
+      case 1: {                                               \
+        constexpr static uint32_t kElems = 1;                 \
+        return __VA_ARGS__();                                 \
+      }                                                       \
+      case 2: {                                               \
+        constexpr static uint32_t kElems = 2;                 \
+        return __VA_ARGS__();                                 \
+      }                                                       \
+      case 4: {                                               \
+        constexpr static uint32_t kElems = 4;                 \
+        return __VA_ARGS__();                                 \
+      }                                                       \
+      case 8: {                                               \
+        constexpr static uint32_t kElems = 8;                 \
+        return __VA_ARGS__();                                 \
+      }                                                       \
+      case 16: {                                              \
+        constexpr static uint32_t kElems = 16;                \
+        return __VA_ARGS__();                                 \
+      }                                                       \
+      case 32: {                                              \
+        constexpr static uint32_t kElems = 32;                \
+        return __VA_ARGS__();                                 \
+      }                                                       \
+      default: {                                              \
+        constexpr static uint32_t kElems = 0;                 \
+        return __VA_ARGS__();                                 \
+      }                                                       \
+    }                                                         \
+  }()
@@ -0,0 +1,116 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*
+Softmax
+
+Row-wise softmax over the last dimension. Like the norms, every row is handled
+by one work group whose work items keep their elements in registers: the row
+maximum and the sum of the exponentials are reduced through SLM, and every
+exponential is computed once.
+*/
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include <sycl/sycl.hpp>
+
+#include "norm_utils.h"
+
+namespace gpu::xetla {
+
+namespace norm {
+
+template <typename T, uint32_t kElems>
+class SoftmaxForwardKernel;
+
+// x, y: [rows, cols]
+template <typename T, uint32_t kElems>
+void softmax_forward_impl(sycl::queue& q, const T* x, T* y, uint32_t rows,
+                          uint32_t cols) {
+  q.submit([&](sycl::handler& cgh) {
+    sycl::local_accessor<float, 1> slm(sycl::range<1>(kNumSg), cgh);
+    cgh.parallel_for<SoftmaxForwardKernel<T, kElems>>(
+        sycl::nd_range<1>(static_cast<size_t>(rows) * kWgSize, kWgSize),
+        [=](sycl::nd_item<1> item) [[sycl::reqd_sub_group_size(kSgSize)]] {
+          const size_t row = item.get_group(0);
+          const uint32_t lid = item.get_local_linear_id();
+          const T* x_row = x + row * cols;
+          T* y_row = y + row * cols;
+          float* slm_ptr =
+              slm.template get_multi_ptr<sycl::access::decorated::no>().get();
+
+          float reg[kElems > 0 ? kElems : 1];
+          float row_max = -INFINITY;
+          if constexpr (kElems > 0) {
+#pragma unroll
+            for (uint32_t i = 0; i < kElems; ++i) {
+              const uint32_t c = i * kWgSize + lid;
+              reg[i] = c < cols ? static_cast<float>(x_row[c]) : -INFINITY;
+              row_max = sycl::fmax(row_max, reg[i]);
+            }
+          } else {
+            for (uint32_t c = lid; c < cols; c += kWgSize) {
+              row_max = sycl::fmax(row_max, static_cast<float>(x_row[c]));
+            }
+          }
+          row_max = group_max(item, slm_ptr, row_max);
+          // Rows of -inf produce NaN, as exp(x - max(x)) / sum would.
+          float sum = 0.f;
+          if constexpr (kElems > 0) {
+#pragma unroll
+            for (uint32_t i = 0; i < kElems; ++i) {
+              reg[i] = i * kWgSize + lid < cols ? sycl::exp(reg[i] - row_max)
+                                                : 0.f;
+              sum += reg[i];
+            }
+          } else {
+            for (uint32_t c = lid; c < cols; c += kWgSize) {
+              sum += sycl::exp(static_cast<float>(x_row[c]) - row_max);
+            }
+          }
+          const float inv_sum = 1.f / group_sum(item, slm_ptr, sum);
+
+          if constexpr (kElems > 0) {
+#pragma unroll
+            for (uint32_t i = 0; i < kElems; ++i) {
+              const uint32_t c = i * kWgSize + lid;
+              if (c < cols) y_row[c] = static_cast<T>(reg[i] * inv_sum);
+            }
+          } else {
+            for (uint32_t c = lid; c < cols; c += kWgSize) {
+              y_row[c] = static_cast<T>(
+                  sycl::exp(static_cast<float>(x_row[c]) - row_max) * inv_sum);
+            }
+          }
+        });
+  });
+}
+
+}  // namespace norm
+
+/// @brief Main execution function for the softmax forward.
+template <typename T>
+void softmax_forward(sycl::queue& q, const T* x, T* y, uint32_t rows,
+                     uint32_t cols) {
+  if (rows == 0 || cols == 0) return;
+  NORM_ELEMS_SWITCH(cols, [&] {
+    norm::softmax_forward_impl<T, kElems>(q, x, y, rows, cols);
+  });
+}
+
+}  // namespace gpu::xetla
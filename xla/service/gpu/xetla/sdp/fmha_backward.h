@@ -18,11 +18,19 @@ Fused Multi-Head Attention Backward
 
 This is an implementation of the Flash Attention algorithm
 (see: Dao et al., https://arxiv.org/pdf/2205.14135v2.pdf)
+
+The forward only saves the logsumexp of every query row, so the memory of
+training grows linearly with the sequence length. The probabilities are
+recomputed here tile by tile from Q, K and the logsumexp, with the masks, the
+ALiBi biases and the dropout mask of the forward. Query blocks that see none of
+the keys of a block are skipped.
 */
 
 #pragma once
 
+#include <algorithm>
 #include <limits>
+#include <type_traits>
 
 #include "fmha_policy.h"
 #include "fmha_utils.h"
@@ -40,21 +48,37 @@ template <typename scalar_t, typename accum_t>
 struct arguments_t {
   // Input tensors
   scalar_t* Q_ptr;            // [B, N, F, H] - query
-  scalar_t* K_ptr;            // [B, N, T, H] - key
-  scalar_t* V_ptr;            // [B, N, T, H] - value
+  scalar_t* K_ptr;            // [B, N_kv, T, H] - key
+  scalar_t* V_ptr;            // [B, N_kv, T, H] - value
   scalar_t* O_ptr;            // [B, F, N, H] - out
   scalar_t* B_ptr = nullptr;  // [B, 1, F, T] - bias
   scalar_t* dO_ptr;           // [B, F, N, H] - grad_out
+  // Cumulative sequence lengths [B + 1] of packed [total_F, N, H] queries,
+  // outputs and their gradients and [total_T, N_kv, H] keys, values and their
+  // gradients, F and T are then the maximum lengths. Bias isn't supported with
+  // packed sequences.
+  int32_t* cu_seqlens_q = nullptr;
+  int32_t* cu_seqlens_k = nullptr;
+  // Masks and biases of the forward, see fmha_forward_t::arguments_t
+  bool is_causal = false;
+  uint32_t window_size = 0;
+  accum_t* alibi_slopes = nullptr;
   accum_t* dp_sum;            // [B, N, F]
   accum_t* L_ptr;             // [B, N, F]
   // Output tensors
   scalar_t* dQ_ptr;      // [B, N, F, H] - grad_query
   accum_t* dQaccum_ptr;  // [B, N, F, H] - grad_query accumulates
-  scalar_t* dK_ptr;      // [B, N, T, H] - grad_key
-  scalar_t* dV_ptr;      // [B, N, T, H] - grad_value
+  scalar_t* dK_ptr;      // [B, N_kv, T, H] - grad_key
+  scalar_t* dV_ptr;      // [B, N_kv, T, H] - grad_value
+  // Dropout mask is regenerated from the seed of the forward kernel
+  uint64_t dp_seed;
+  accum_t dp_prob;
+  accum_t dp_scale;
   // Dimension size
   uint32_t uB;
   uint32_t uN;
+  // Query heads [n * N / N_kv, (n + 1) * N / N_kv) share the KV head n
+  uint32_t uNkv;
   uint32_t uH;
   uint32_t uF;
   uint32_t uT;
@@ -66,23 +90,36 @@ struct arguments_t {
                      scalar_t* out, scalar_t* bias, scalar_t* grad_out,
                      accum_t* dp_sum, accum_t* L_ptr, scalar_t* grad_query,
                      accum_t* grad_query_accum, scalar_t* grad_key,
-                     scalar_t* grad_value, uint32_t num_batches,
-                     uint32_t num_heads, uint32_t head_size,
-                     uint32_t num_queries, uint32_t num_keys, accum_t scale)
+                     scalar_t* grad_value, uint64_t seed,
+                     accum_t dropout_prob, uint32_t num_batches,
+                     uint32_t num_heads, uint32_t num_kv_heads,
+                     uint32_t head_size, uint32_t num_queries,
+                     uint32_t num_keys, accum_t scale, int32_t* cu_seqlens_q,
+                     int32_t* cu_seqlens_k, bool is_causal,
+                     uint32_t window_size, accum_t* alibi_slopes)
       : Q_ptr(query),
         K_ptr(key),
         V_ptr(value),
         O_ptr(out),
         B_ptr(bias),
         dO_ptr(grad_out),
+        cu_seqlens_q(cu_seqlens_q),
+        cu_seqlens_k(cu_seqlens_k),
+        is_causal(is_causal),
+        window_size(window_size),
+        alibi_slopes(alibi_slopes),
         dp_sum(dp_sum),
         L_ptr(L_ptr),
         dQ_ptr(grad_query),
         dQaccum_ptr(grad_query_accum),
         dK_ptr(grad_key),
         dV_ptr(grad_value),
+        dp_seed(seed),
+        dp_prob(dropout_prob),
+        dp_scale(1.f / (1.f - dropout_prob)),
         uB(num_batches),
         uN(num_heads),
+        uNkv(num_kv_heads),
         uH(head_size),
         uF(num_queries),
         uT(num_keys),
@@ -138,6 +175,8 @@ class fmha_backward_dot_do_o_t {
     work_group_t g;
     uint32_t sg_idx;
     uint32_t sg_idy;
+    // rows of the batch-head in O/dO
+    seq_rows_t q_rows;
     // nbarrier
     xetla_nbarrier_t<wg_size_x, wg_size_x> nbarrier;
     // mem desc variables
@@ -159,15 +198,18 @@ class fmha_backward_dot_do_o_t {
       sg_idy = sg_id / wg_size_x;
       nbarrier.init_nbarrier(sg_idy, nbarrier_role::producer_consumer);
 
-      int32_t start_y = gid * args.uF + ei.get_group(1) * kBr;
+      q_rows.init(args.cu_seqlens_q, gid, args.uN, args.uH, args.uF);
+      int32_t start_y = q_rows.start + ei.get_group(1) * kBr;
       uint32_t end_y = start_y + kBr;
-      uint32_t boundary_y = (gid + 1) * args.uF;
+      uint32_t boundary_y = q_rows.end();
       end_y = end_y > boundary_y ? boundary_y : end_y;
 
-      mem_desc_dQaccum.init(args.dQaccum_ptr, {args.uH, end_y, args.uH},
-                            {0, start_y});
-      mem_desc_O.init(args.O_ptr, {args.uH, end_y, args.uH}, {0, start_y});
-      mem_desc_dO.init(args.dO_ptr, {args.uH, end_y, args.uH}, {0, start_y});
+      mem_desc_dQaccum.init(args.dQaccum_ptr + q_rows.offset,
+                            {args.uH, end_y, q_rows.pitch}, {0, start_y});
+      mem_desc_O.init(args.O_ptr + q_rows.offset,
+                      {args.uH, end_y, q_rows.pitch}, {0, start_y});
+      mem_desc_dO.init(args.dO_ptr + q_rows.offset,
+                       {args.uH, end_y, q_rows.pitch}, {0, start_y});
 
       int32_t start_x_dPsum = ei.get_group(1) * kBr + sg_idy * kSgBr;
       int32_t start_y_dPsum = gid;
@@ -262,11 +304,13 @@ class fmha_backward_dot_do_o_t {
 
     // initialize context
     ctx.init_context(ei, args);
+    if (ei.get_group(1) * kBr >= ctx.q_rows.len) return;
     sum_dot_dO_O(args);
   }
 };
 
-template <typename mha_policy, typename scalar_t, bool kUseBias>
+template <typename mha_policy, typename scalar_t, bool kUseBias,
+          bool kIsDropout>
 class fmha_backward_t {
  public:
   using accum_t = float;
@@ -373,6 +417,11 @@ class fmha_backward_t {
     uint32_t sg_idy;
     uint32_t startT;
     uint32_t startF;
+    // batch-head id
+    uint32_t gid;
+    // rows of the query batch-head in Q/dO/dQ and of K/V/dK/dV
+    seq_rows_t q_rows;
+    seq_rows_t kv_rows;
     work_group_BrBc_t g_brbc;
     work_group_BrHm_t g_brhm;
     work_group_BcHm_t g_bchm;
@@ -401,7 +450,7 @@ class fmha_backward_t {
     /// @brief Initialize variables used in the mha backward
     inline void init_context(const sycl::nd_item<3>& ei, const args_t& args) {
       uint32_t sg_id = ei.get_local_linear_id();
-      uint32_t gid = ei.get_group(0);
+      uint32_t kv_gid = ei.get_group(0);
       startT = ei.get_group(1) * kBc;
 
       // thread id and nbarrier
@@ -411,18 +460,26 @@ class fmha_backward_t {
       g_bchm.init(sg_id);
       nbarrier.init_nbarrier(0, nbarrier_role::producer_consumer);
 
-      // for shape [B,N,T,H]
-      int32_t start_x = gid * args.uT + ei.get_group(1) * kBc;
+      // for shape [B,N_kv,T,H]
+      kv_rows.init(args.cu_seqlens_k, kv_gid, args.uNkv, args.uH, args.uT);
+      int32_t start_x = kv_rows.start + ei.get_group(1) * kBc;
       uint32_t end_x = start_x + kBc;
-      uint32_t boundary_x = (gid + 1) * args.uT;
+      uint32_t boundary_x = kv_rows.end();
       end_x = end_x > boundary_x ? boundary_x : end_x;
 
-      mem_desc_K.init(args.K_ptr, {args.uH, end_x, args.uH}, {0, start_x});
-      mem_desc_K_T.init(args.K_ptr, {end_x, args.uH, args.uH}, {start_x, 0});
-      mem_desc_V_T.init(args.V_ptr, {end_x, args.uH, args.uH}, {start_x, 0});
-      mem_desc_V.init(args.V_ptr, {args.uH, end_x, args.uH}, {0, start_x});
-      mem_desc_dK.init(args.dK_ptr, {args.uH, end_x, args.uH}, {0, start_x});
-      mem_desc_dV.init(args.dV_ptr, {args.uH, end_x, args.uH}, {0, start_x});
+      uint32_t pitch = kv_rows.pitch;
+      mem_desc_K.init(args.K_ptr + kv_rows.offset, {args.uH, end_x, pitch},
+                      {0, start_x});
+      mem_desc_K_T.init(args.K_ptr + kv_rows.offset, {end_x, args.uH, pitch},
+                        {start_x, 0});
+      mem_desc_V_T.init(args.V_ptr + kv_rows.offset, {end_x, args.uH, pitch},
+                        {start_x, 0});
+      mem_desc_V.init(args.V_ptr + kv_rows.offset, {args.uH, end_x, pitch},
+                      {0, start_x});
+      mem_desc_dK.init(args.dK_ptr + kv_rows.offset, {args.uH, end_x, pitch},
+                       {0, start_x});
+      mem_desc_dV.init(args.dV_ptr + kv_rows.offset, {args.uH, end_x, pitch},
+                       {0, start_x});
 
       // local memory
       mem_desc_P_LT.init(P_slm, {kBr, kBc, kBr}, {0, 0});
@@ -430,27 +487,33 @@ class fmha_backward_t {
       mem_desc_dS_LT.init(dS_slm, {kBr, kBc, kBr}, {0, 0});
     }
 
-    /// @brief Update variables for each flash mha loop
+    /// @brief Update variables for each flash mha loop over the queries of
+    /// batch-head `q_gid`
     inline void update_context(const sycl::nd_item<3>& ei, const args_t& args,
-                               uint32_t fstart) {
+                               uint32_t q_gid, uint32_t fstart) {
       uint32_t sg_id = ei.get_local_linear_id();
-      uint32_t gid = ei.get_group(0);
+      gid = q_gid;
       startF = fstart;
 
       sg_idx = sg_id % wg_size_x;
       sg_idy = sg_id / wg_size_x;
       // mem desc variables
       // for shape [B,N,F,T] and [B,N,F,H]
-      int32_t start_y = gid * args.uF + startF;
+      q_rows.init(args.cu_seqlens_q, gid, args.uN, args.uH, args.uF);
+      int32_t start_y = q_rows.start + startF;
       uint32_t end_y = start_y + kBr;
-      uint32_t boundary_y = (gid + 1) * args.uF;
+      uint32_t boundary_y = q_rows.end();
       end_y = end_y > boundary_y ? boundary_y : end_y;
 
-      mem_desc_Q.init(args.Q_ptr, {args.uH, end_y, args.uH}, {0, start_y});
-      mem_desc_dQ.init(args.dQ_ptr, {args.uH, end_y, args.uH}, {0, start_y});
-      mem_desc_dQaccum.init(args.dQaccum_ptr, {args.uH, end_y, args.uH},
-                            {0, start_y});
-      mem_desc_dO.init(args.dO_ptr, {args.uH, end_y, args.uH}, {0, start_y});
+      uint32_t pitch = q_rows.pitch;
+      mem_desc_Q.init(args.Q_ptr + q_rows.offset, {args.uH, end_y, pitch},
+                      {0, start_y});
+      mem_desc_dQ.init(args.dQ_ptr + q_rows.offset, {args.uH, end_y, pitch},
+                       {0, start_y});
+      mem_desc_dQaccum.init(args.dQaccum_ptr + q_rows.offset,
+                            {args.uH, end_y, pitch}, {0, start_y});
+      mem_desc_dO.init(args.dO_ptr + q_rows.offset, {args.uH, end_y, pitch},
+                       {0, start_y});
 
       int32_t start_x_ml = startF + sg_idy * kSgBr;
       int32_t start_y_ml = gid;
@@ -518,12 +581,35 @@ class fmha_backward_t {
       bias_op(*rP, ctx.mem_desc_Bij.coord, bias_args);
     }
 
+    // Same masks as the forward, masked scores become exp(-inf - L) = 0
+    using tile_mask = tile_mask_t<tile_P_t>;
+    uint32_t sg_startT = ctx.startT + tile_offset_x;
+    uint32_t sg_startF = ctx.startF + tile_offset_y;
+    if (args.is_causal && sg_startT + kSgBc > sg_startF) {
+      tile_mask::causal_mask(*rP, sg_startT, sg_startF);
+    }
+    if (args.window_size > 0) {
+      tile_mask::sliding_window_mask(*rP, sg_startT, sg_startF,
+                                     args.window_size, !args.is_causal);
+    }
+    if (args.alibi_slopes != nullptr) {
+      tile_mask::alibi_bias(*rP, sg_startT, sg_startF,
+                            args.alibi_slopes[ctx.gid % args.uN]);
+    }
+
     subgroup::tile_broadcast_op<subgroup::tile_minus, tile_P_t>(*rP,
                                                                 l_load.reg);
     rP->reg = xetla_exp<accum_t>(rP->reg);
-    // apply dropout mask
+    // apply dropout mask, dV is computed from the dropped probabilities
     tile_P_t rp_drop;
     rp_drop.reg = rP->reg;
+    if constexpr (kIsDropout) {
+      using tile_dropout = tile_dropout_t<tile_P_t>;
+      tile_dropout::generate(mask_in->reg, args.dp_seed, args.dp_prob, ctx.gid,
+                             ctx.startT + tile_offset_x,
+                             ctx.startF + tile_offset_y);
+      tile_dropout::apply(rp_drop, mask_in->reg, args.dp_scale);
+    }
     // store Pij to local memory, transpose it while saving
     using epilogue_p_t = group::epilogue_transp_t<
         group::epilogue_policy_tile_op<subgroup::chained_tile_op_t<>,
@@ -558,6 +644,11 @@ class fmha_backward_t {
     brgemm_args_t brgemm_args(ctx.mem_desc_dO, ctx.mem_desc_V_T, loop_count);
     brgemm(ctx.g_brbc, rdP, brgemm_args, 0, /* nbarrier_base */ nbarrier_cnt);
 
+    // The gradient of the dropped probabilities is dP masked and scaled as
+    // in the forward kernel.
+    if constexpr (kIsDropout) {
+      tile_dropout_t<tile_dP_t>::apply(rdP, mask_in->reg, args.dp_scale);
+    }
     subgroup::tile_broadcast_op<subgroup::tile_minus, tile_dP_t>(rdP,
                                                                  sum_load.reg);
     rdS->reg = rP->reg * rdP.reg;
@@ -582,7 +673,7 @@ class fmha_backward_t {
   /// # [F,T] x [T,H] = [F,H]
   inline void compute_dQ(const args_t& args) {
     using brgemm_args_t = typename brgemm_dQ_t::arguments_t;
-    uint32_t remainT = args.uT - ctx.startT;
+    uint32_t remainT = ctx.kv_rows.len - ctx.startT;
     uint32_t boundary_k = remainT > kBc ? kBc : remainT;
     uint32_t loop_count = (boundary_k + accum_step - 1) / accum_step;
 
@@ -614,7 +705,7 @@ class fmha_backward_t {
   inline void compute_dV(tile_dV_t* rdV, const args_t& args) {
     using brgemm_args_t = typename brgemm_dV_t::arguments_t;
 
-    uint32_t remainF = args.uF - ctx.startF;
+    uint32_t remainF = ctx.q_rows.len - ctx.startF;
     uint32_t boundary_k = remainF > kBr ? kBr : remainF;
     uint32_t loop_count = (boundary_k + accum_step - 1) / accum_step;
 
@@ -645,7 +736,7 @@ class fmha_backward_t {
 
     using brgemm_args_t = typename brgemm_dK_t::arguments_t;
 
-    uint32_t remainF = args.uF - ctx.startF;
+    uint32_t remainF = ctx.q_rows.len - ctx.startF;
     uint32_t boundary_k = remainF > kBr ? kBr : remainF;
     uint32_t loop_count = (boundary_k + accum_step - 1) / accum_step;
 
@@ -719,20 +810,45 @@ class fmha_backward_t {
 
     // initialize context
     ctx.init_context(ei, args);
+    if (ctx.startT >= ctx.kv_rows.len) return;
 
     tile_dV_t rdV(0);
     tile_dK_t rdK(0);
 
-    for (uint32_t startF = 0; startF < args.uF; startF += kBr) {
-      ctx.update_context(ei, args, startF);
-      tile_P_t rP(0);
-      dp_mask_tile_t mask_in;
-      compute_Pij(&rP, &mask_in, args);
-      tile_dS_t rdS(0);
-      compute_dSij(&rP, &rdS, &mask_in, args);
-      compute_dV(&rdV, args);
-      compute_dQ(args);
-      compute_dK(&rdK, &rdS, args);
+    // dK and dV accumulate over all query heads sharing the KV head, so they
+    // are written once without atomics.
+    uint32_t kv_gid = ei.get_group(0);
+    uint32_t queries_per_kv = args.uN / args.uNkv;
+    uint32_t start_q_gid =
+        kv_gid / args.uNkv * args.uN + kv_gid % args.uNkv * queries_per_kv;
+    // all heads of a sequence have the same number of queries
+    seq_rows_t q_rows;
+    q_rows.init(args.cu_seqlens_q, start_q_gid, args.uN, args.uH, args.uF);
+    // skip the query blocks that see none of the keys of the block
+    uint32_t beginF = 0;
+    uint32_t endF = q_rows.len;
+    if (args.is_causal) {
+      beginF = ctx.startT / kBr * kBr;
+    }
+    if (args.window_size > 0) {
+      endF = std::min(endF, ctx.startT + kBc + args.window_size - 1);
+      if (!args.is_causal && ctx.startT + 1 > args.window_size) {
+        beginF = (ctx.startT + 1 - args.window_size) / kBr * kBr;
+      }
+    }
+    for (uint32_t q_gid = start_q_gid; q_gid < start_q_gid + queries_per_kv;
+         ++q_gid) {
+      for (uint32_t startF = beginF; startF < endF; startF += kBr) {
+        ctx.update_context(ei, args, q_gid, startF);
+        tile_P_t rP(0);
+        dp_mask_tile_t mask_in;
+        compute_Pij(&rP, &mask_in, args);
+        tile_dS_t rdS(0);
+        compute_dSij(&rP, &rdS, &mask_in, args);
+        compute_dV(&rdV, args);
+        compute_dQ(args);
+        compute_dK(&rdK, &rdS, args);
+      }
     }
     store_dKdV(&rdK, &rdV, args);
   }
@@ -772,6 +888,8 @@ class fmha_backward_convert_dq_t {
     work_group_t g;
     uint32_t sg_idx;
     uint32_t sg_idy;
+    // rows of the batch-head in dQ
+    seq_rows_t q_rows;
     // mem desc variables
     mem_desc_dQaccum_t mem_desc_dQaccum;
     mem_desc_dQ_t mem_desc_dQ;
@@ -786,14 +904,16 @@ class fmha_backward_convert_dq_t {
 
       sg_idx = sg_id % wg_size_x;
       sg_idy = sg_id / wg_size_x;
-      int32_t start_y = gid * args.uF + ei.get_group(1) * kBr;
+      q_rows.init(args.cu_seqlens_q, gid, args.uN, args.uH, args.uF);
+      int32_t start_y = q_rows.start + ei.get_group(1) * kBr;
       uint32_t end_y = start_y + kBr;
-      uint32_t boundary_y = (gid + 1) * args.uF;
+      uint32_t boundary_y = q_rows.end();
       end_y = end_y > boundary_y ? boundary_y : end_y;
 
-      mem_desc_dQaccum.init(args.dQaccum_ptr, {args.uH, end_y, args.uH},
-                            {0, start_y});
-      mem_desc_dQ.init(args.dQ_ptr, {args.uH, end_y, args.uH}, {0, start_y});
+      mem_desc_dQaccum.init(args.dQaccum_ptr + q_rows.offset,
+                            {args.uH, end_y, q_rows.pitch}, {0, start_y});
+      mem_desc_dQ.init(args.dQ_ptr + q_rows.offset,
+                       {args.uH, end_y, q_rows.pitch}, {0, start_y});
     }
   };
 
@@ -817,6 +937,7 @@ class fmha_backward_convert_dq_t {
                                      const args_t& args) {
     // initialize context
     ctx.init_context(ei, args);
+    if (ei.get_group(1) * kBr >= ctx.q_rows.len) return;
 
     using dQ_tile_desc_t =
         subgroup::tile_desc_t<kSgHm, kSgBr, block_size_x, block_size_y,
@@ -852,13 +973,18 @@ template <typename fmha_policy, typename T, bool kUseBias, bool kIsDropout>
 void fmha_backward_impl(sycl::queue& q, T* query, T* key, T* value, T* out,
                         T* bias, T* grad_out, float* dp_sum, float* L_ptr,
                         T* grad_query, float* grad_query_accum, T* grad_key,
-                        T* grad_value, uint32_t num_batches, uint32_t num_heads,
-                        uint32_t head_size, uint32_t num_queries,
-                        uint32_t num_keys, float head_scale) {
-  arguments_t<T, float> args(query, key, value, out, bias, grad_out, dp_sum,
-                             L_ptr, grad_query, grad_query_accum, grad_key,
-                             grad_value, num_batches, num_heads, head_size,
-                             num_queries, num_keys, head_scale);
+                        T* grad_value, uint64_t seed, float dropout_prob,
+                        uint32_t num_batches, uint32_t num_heads,
+                        uint32_t num_kv_heads, uint32_t head_size,
+                        uint32_t num_queries, uint32_t num_keys,
+                        float head_scale, int32_t* cu_seqlens_q,
+                        int32_t* cu_seqlens_k, bool is_causal,
+                        uint32_t window_size, float* alibi_slopes) {
+  arguments_t<T, float> args(
+      query, key, value, out, bias, grad_out, dp_sum, L_ptr, grad_query,
+      grad_query_accum, grad_key, grad_value, seed, dropout_prob, num_batches,
+      num_heads, num_kv_heads, head_size, num_queries, num_keys, head_scale,
+      cu_seqlens_q, cu_seqlens_k, is_causal, window_size, alibi_slopes);
 
   using fmha_bwd_dot_do_op_t = fmha_backward_dot_do_o_t<fmha_policy, T>;
   sycl::nd_range<3> NdRange0 =
@@ -874,9 +1000,10 @@ void fmha_backward_impl(sycl::queue& q, T* query, T* key, T* value, T* out,
         });
   });
 
-  using fmha_backward_op_t = fmha_backward_t<fmha_policy, T, kUseBias>;
+  using fmha_backward_op_t =
+      fmha_backward_t<fmha_policy, T, kUseBias, kIsDropout>;
   sycl::nd_range<3> NdRange1 =
-      fmha_backward_op_t::get_nd_range(num_batches * num_heads, num_keys);
+      fmha_backward_op_t::get_nd_range(num_batches * num_kv_heads, num_keys);
 
   q.submit([&](sycl::handler& cgh) {
     cgh.parallel_for<
@@ -908,21 +1035,44 @@ void fmha_backward_impl(sycl::queue& q, T* query, T* key, T* value, T* out,
 #define CALL_IMPL_FUNC(P)                                                \
   fmha::fmha_backward_impl<P, T, kUseBias, kIsDropout>(                  \
       q, query, key, value, out, bias, grad_out, dp_sum, activation_ptr, \
-      grad_query, grad_query_accum, grad_key, grad_value, num_batches,   \
-      num_heads, head_size, num_queries, num_keys, head_scale)
-
-/// @brief Main execution function for flash mha forward.
+      grad_query, grad_query_accum, grad_key, grad_value, seed,          \
+      dropout_prob, num_batches, num_heads, num_kv_heads, head_size,     \
+      num_queries, num_keys, head_scale, cu_seqlens_q, cu_seqlens_k,     \
+      is_causal, window_size, alibi_slopes)
+
+/// @brief Main execution function for flash mha backward. Given cumulative
+/// sequence lengths, the sequences are packed and num_queries and num_keys are
+/// their maximum lengths. activation_ptr is the logsumexp [B, N, F] saved by
+/// the forward, which must have been run with the same is_causal, window_size
+/// and alibi_slopes.
 template <typename T, bool kUseBias = false, bool kIsDropout = false>
 void fmha_backward(sycl::queue& q, T* query, T* key, T* value, T* out, T* bias,
                    T* grad_out, float* dp_sum, float* activation_ptr,
                    T* grad_query, float* grad_query_accum, T* grad_key,
-                   T* grad_value, uint32_t num_batches, uint32_t num_heads,
-                   uint32_t head_size, uint32_t num_queries, uint32_t num_keys,
-                   float head_scale) {
+                   T* grad_value, uint64_t seed, float dropout_prob,
+                   uint32_t num_batches, uint32_t num_heads,
+                   uint32_t num_kv_heads, uint32_t head_size,
+                   uint32_t num_queries, uint32_t num_keys, float head_scale,
+                   int32_t* cu_seqlens_q = nullptr,
+                   int32_t* cu_seqlens_k = nullptr, bool is_causal = false,
+                   uint32_t window_size = 0, float* alibi_slopes = nullptr) {
+  if constexpr (std::is_same_v<T, tf32>) {
+    if (head_size <= 128) {
+      CALL_IMPL_FUNC(fmha_tf32_bwd_policy_64x128x128);
+    } else {
+      CHECK(false) << "MHA backward No TF32 policy available for current "
+                   << "head_size " << head_size << "\n";
+    }
+    return;
+  }
   if (head_size <= 64) {
     CALL_IMPL_FUNC(fmha_bwd_policy_128x128x64);
+  } else if (head_size <= 96) {
+    CALL_IMPL_FUNC(fmha_bwd_policy_128x128x96);
   } else if (head_size <= 128) {
     CALL_IMPL_FUNC(fmha_bwd_policy_128x128x128);
+  } else if (head_size <= 192) {
+    CALL_IMPL_FUNC(fmha_bwd_policy_64x128x192);
   } else if (head_size <= 256) {
     CALL_IMPL_FUNC(fmha_bwd_policy_64x128x256);
   } else {
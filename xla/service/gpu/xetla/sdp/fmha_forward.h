@@ -23,8 +23,10 @@ This is an implementation of the Flash Attention algorithm
 #pragma once
 
 #include <limits>
+#include <type_traits>
 
 #include "fmha_policy.h"
+#include "fmha_split_kv.h"
 #include "fmha_utils.h"
 #include "xetla.hpp"
 
@@ -36,7 +38,7 @@ namespace gpu::xetla {
 namespace fmha {
 
 template <typename fmha_policy, typename scalar_t, bool kUseBias,
-          bool kIsCausal, bool kIsTraining>
+          bool kIsCausal, bool kIsDropout, bool kIsTraining>
 class fmha_forward_t {
  public:
   using accum_t = float;
@@ -45,19 +47,32 @@ class fmha_forward_t {
   struct arguments_t {
     // Input tensors
     scalar_t* Q_ptr;            // [B, N, F, H] - query
-    scalar_t* K_ptr;            // [B, N, T, H] - key
-    scalar_t* V_ptr;            // [B, N, T, H] - value
+    scalar_t* K_ptr;            // [B, N_kv, T, H] - key
+    scalar_t* V_ptr;            // [B, N_kv, T, H] - value
     scalar_t* B_ptr = nullptr;  // [B, 1, F, T] - bias
-    uint8_t* Dp_ptr = nullptr;  // [B, N, F, T] - dropout mask
+    // Cumulative sequence lengths [B + 1] of packed [total_F, N, H] queries
+    // and outputs and [total_T, N_kv, H] keys and values, F and T are then
+    // the maximum lengths. Bias isn't supported with packed sequences.
+    int32_t* cu_seqlens_q = nullptr;
+    int32_t* cu_seqlens_k = nullptr;
+    // Keys at least window_size positions before a query are masked, and also
+    // those as far after it if not causal. 0 disables the sliding window.
+    uint32_t window_size = 0;
+    // ALiBi slopes [N] of the query heads, nullptr disables ALiBi.
+    accum_t* alibi_slopes = nullptr;
+    // Dropout mask is generated from the seed, see tile_dropout_t
+    uint64_t dp_seed;
     // Dropout scale is computed from dropout prob
     accum_t dp_prob;
     accum_t dp_scale;
     // Output tensor
     scalar_t* O_ptr;  // raw: [B, N, F, H]; permute: [B, F, N, H] - output
-    accum_t* activation_ptr;
+    accum_t* activation_ptr;  // [B, N, F]
     // Dimension size
     uint32_t uB;
     uint32_t uN;
+    // Query heads [n * N / N_kv, (n + 1) * N / N_kv) share the KV head n
+    uint32_t uNkv;
     uint32_t uH;
     uint32_t uF;
     uint32_t uT;
@@ -66,26 +81,40 @@ class fmha_forward_t {
 
     inline arguments_t() = default;
     inline arguments_t(scalar_t* query, scalar_t* key, scalar_t* value,
-                       scalar_t* bias, uint8_t* dropout, accum_t dropout_prob,
+                       scalar_t* bias, uint64_t seed, accum_t dropout_prob,
                        scalar_t* out, accum_t* activation_ptr,
                        uint32_t num_batches, uint32_t num_heads,
-                       uint32_t head_size, uint32_t num_queries,
-                       uint32_t num_keys, accum_t sm_scale)
+                       uint32_t num_kv_heads, uint32_t head_size,
+                       uint32_t num_queries, uint32_t num_keys,
+                       accum_t sm_scale, int32_t* cu_seqlens_q,
+                       int32_t* cu_seqlens_k, uint32_t window_size,
+                       accum_t* alibi_slopes)
         : Q_ptr(query),
           K_ptr(key),
           V_ptr(value),
           B_ptr(bias),
-          Dp_ptr(dropout),
+          cu_seqlens_q(cu_seqlens_q),
+          cu_seqlens_k(cu_seqlens_k),
+          window_size(window_size),
+          alibi_slopes(alibi_slopes),
+          dp_seed(seed),
           dp_prob(dropout_prob),
           dp_scale(1.f / (1.f - dropout_prob)),
           O_ptr(out),
           activation_ptr(activation_ptr),
           uB(num_batches),
           uN(num_heads),
+          uNkv(num_kv_heads),
           uH(head_size),
           uF(num_queries),
           uT(num_keys),
           sm_scale(sm_scale) {}
+
+    /// @brief Returns the batch-head of the keys and values attended by the
+    /// queries of batch-head `gid`.
+    inline uint32_t kv_gid(uint32_t gid) const {
+      return gid / uN * uNkv + gid % uN / (uN / uNkv);
+    }
   };
 
  private:
@@ -160,11 +189,18 @@ class fmha_forward_t {
     work_group_t g;
     uint32_t sg_idx;
     uint32_t sg_idy;
+    // batch-head id
+    uint32_t gid;
+    // rows of the batch-head in Q/O and K/V
+    seq_rows_t q_rows;
+    seq_rows_t kv_rows;
     // nbarrier
     xetla_nbarrier_t<wg_size_x, wg_size_x> nbarrier;
     // softmax statistics
     xetla_vector<accum_t, kSgBr> softmax_m;
     xetla_vector<accum_t, kSgBr> softmax_l;
+    // ALiBi slope of the query head
+    accum_t alibi_slope;
     // mem desc variables
     mem_desc_Qi_t mem_desc_Qi;
     mem_desc_Qi_L_t mem_desc_Qi_L;
@@ -191,14 +227,21 @@ class fmha_forward_t {
       softmax_l = 0.f;
 
       // mem desc variables
-      uint32_t gid = ei.get_group(0);
-      int32_t start_y = gid * args.uF + ei.get_group(1) * kBr;
+      gid = ei.get_group(0);
+      q_rows.init(args.cu_seqlens_q, gid, args.uN, args.uH, args.uF);
+      kv_rows.init(args.cu_seqlens_k, args.kv_gid(gid), args.uNkv, args.uH,
+                   args.uT);
+      alibi_slope =
+          args.alibi_slopes == nullptr ? 0.f : args.alibi_slopes[gid % args.uN];
+      int32_t start_y = q_rows.start + ei.get_group(1) * kBr;
       uint32_t end_y = start_y + kBr;
-      uint32_t boundary_y = (gid + 1) * args.uF;
+      uint32_t boundary_y = q_rows.end();
       end_y = end_y > boundary_y ? boundary_y : end_y;
 
-      mem_desc_Qi.init(args.Q_ptr, {args.uH, end_y, args.uH}, {0, start_y});
-      mem_desc_Oi.init(args.O_ptr, {args.uH, end_y, args.uH}, {0, start_y});
+      mem_desc_Qi.init(args.Q_ptr + q_rows.offset,
+                       {args.uH, end_y, q_rows.pitch}, {0, start_y});
+      mem_desc_Oi.init(args.O_ptr + q_rows.offset,
+                       {args.uH, end_y, q_rows.pitch}, {0, start_y});
 
       if constexpr (kIsTraining) {
         int32_t start_x_ml = ei.get_group(1) * kBr + sg_idy * kSgBr;
@@ -215,16 +258,18 @@ class fmha_forward_t {
     /// @brief Update variables for each flash mha loop
     inline void update_context(const sycl::nd_item<3>& ei, arguments_t& args,
                                uint32_t startT) {
-      uint32_t gid = ei.get_group(0);
-      int32_t start_x = gid * args.uT + startT;
+      int32_t start_x = kv_rows.start + startT;
       uint32_t end_x = start_x + kBc;
-      uint32_t boundary_x = (gid + 1) * args.uT;
+      uint32_t boundary_x = kv_rows.end();
       end_x = end_x > boundary_x ? boundary_x : end_x;
 
-      mem_desc_Kj_T.init(args.K_ptr, {end_x, args.uH, args.uH}, {start_x, 0});
-      mem_desc_Vj.init(args.V_ptr, {args.uH, end_x, args.uH}, {0, start_x});
+      mem_desc_Kj_T.init(args.K_ptr + kv_rows.offset,
+                         {end_x, args.uH, kv_rows.pitch}, {start_x, 0});
+      mem_desc_Vj.init(args.V_ptr + kv_rows.offset,
+                       {args.uH, end_x, kv_rows.pitch}, {0, start_x});
 
       if constexpr (kUseBias) {
+        uint32_t gid = ei.get_group(0);
         start_x = startT;
         end_x = start_x + kBc;
         boundary_x = args.uT;
@@ -291,7 +336,7 @@ class fmha_forward_t {
                       uint32_t startT) {
     using brgemm_args_t = typename brgemm_Oi_t::arguments_t;
 
-    uint32_t remainT = args.uT - startT;
+    uint32_t remainT = ctx.kv_rows.len - startT;
     uint32_t boundary_k = remainT > kBc ? kBc : remainT;
     uint32_t loop_count = (boundary_k + accum_step - 1) / accum_step;
 
@@ -309,25 +354,35 @@ class fmha_forward_t {
     using tile_mask = tile_mask_t<matAccSij_t>;
 
     uint32_t sg_startT = startT + ctx.sg_idx * kSgBc;
-    uint32_t remainT =
-        std::max(static_cast<int>(args.uT) - static_cast<int>(sg_startT), 0);
+    int32_t remainT_signed = static_cast<int32_t>(ctx.kv_rows.len) -
+                             static_cast<int32_t>(sg_startT);
+    uint32_t remainT = std::max(remainT_signed, 0);
     if (remainT < kSgBc) {
       tile_mask::padding_mask(matAccSij, remainT);
     }
 
+    uint32_t sg_startF = startF + ctx.sg_idy * kSgBr;
     if constexpr (kIsCausal) {
-      uint32_t sg_startF = startF + ctx.sg_idy * kSgBr;
       if (sg_startT + kSgBc > sg_startF) {
         tile_mask::causal_mask(matAccSij, sg_startT, sg_startF);
       }
     }
+
+    if (args.window_size > 0) {
+      tile_mask::sliding_window_mask(matAccSij, sg_startT, sg_startF,
+                                     args.window_size, !kIsCausal);
+    }
+    if (args.alibi_slopes != nullptr) {
+      tile_mask::alibi_bias(matAccSij, sg_startT, sg_startF, ctx.alibi_slope);
+    }
   }
 
   // ====================== // softmax_fwd // ===================== //
 
   /// @brief softmax_fwd is used to do softmax.
   inline void softmax_fwd(matAccSij_t& matAccSij, matAccOi_t& matAccOi,
-                          arguments_t& args) {
+                          arguments_t& args, uint32_t startF,
+                          uint32_t startT) {
     using wg_row_max_t =
         group_row_reduce_t<matAccSij_t, wg_size_x, reduce_op::max>;
     using wg_row_sum_t =
@@ -341,6 +396,9 @@ class fmha_forward_t {
     wg_row_max_t wg_row_max(ctx.sg_idx, ctx.sg_idy, reducer_slm);
     xetla_vector<accum_t, kSgBr> m_new = wg_row_max(&matAccSij);
     m_new = xetla_max<accum_t, kSgBr>(m_new, ctx.softmax_m);
+    // rows without an unmasked key so far, e.g. before their sliding window,
+    // use a zero max so that the exponentials below stay finite
+    m_new.xetla_merge(0.f, m_new == kNegInfinity);
 
     if constexpr (wg_size_x > 1) ctx.nbarrier.arrive();
 
@@ -357,19 +415,29 @@ class fmha_forward_t {
     wg_row_sum_t wg_row_sum(ctx.sg_idx, ctx.sg_idy, reducer_slm);
     xetla_vector<accum_t, kSgBr> l_new = wg_row_sum(&matAccSij);
     l_new += ctx.softmax_l;
+    // and a unit divisor while their sum is still zero
+    xetla_vector<accum_t, kSgBr> l_div = l_new;
+    l_div.xetla_merge(1.f, l_new == 0.f);
 
     // rescale operands of matmuls
     subgroup::tile_broadcast_op<subgroup::tile_div, matAccSij_t>(matAccSij,
-                                                                 l_new);
-    xetla_vector<accum_t, kSgBr> o_scale = l_new / ctx.softmax_l;
+                                                                 l_div);
+    xetla_vector<accum_t, kSgBr> o_scale = l_div / ctx.softmax_l;
     subgroup::tile_broadcast_op<subgroup::tile_div, matAccOi_t>(matAccOi,
                                                                 o_scale);
     // update m and l for the next step
     ctx.softmax_m = m_new;
     ctx.softmax_l = l_new;
 
-    if constexpr (kIsTraining) {
-      // TODO: save m and l to global
+    // Dropout only applies to the Pij multiplied with Vj, the softmax
+    // statistics are those of the full row.
+    if constexpr (kIsDropout) {
+      using tile_dropout = tile_dropout_t<matAccSij_t>;
+      typename tile_dropout::keep_t keep;
+      tile_dropout::generate(keep, args.dp_seed, args.dp_prob, ctx.gid,
+                             startT + ctx.sg_idx * kSgBc,
+                             startF + ctx.sg_idy * kSgBr);
+      tile_dropout::apply(matAccSij, keep, args.dp_scale);
     }
 
     // save Pij to local memory
@@ -529,16 +597,29 @@ class fmha_forward_t {
 
     // initialize context for flash mha loops
     ctx.init_context(ei, args);
+    uint32_t startF = ei.get_group(1) * kBr;
+    // packed sequences shorter than the longest have fewer query blocks
+    if (startF >= ctx.q_rows.len) return;
+    uint32_t endF = std::min(startF + kBr, ctx.q_rows.len);
+
     // preload Qi to local memory
     preload_Qi(args);
     // initialize matAccOi for accumulate the output
     matAccOi_t matAccOi(0);
 
-    uint32_t startF = ei.get_group(1) * kBr;
-    uint32_t endF = std::min(startF + kBr, args.uF);
-
-    // iterate through the keys
-    for (uint32_t startT = 0; startT < args.uT; startT += kBc) {
+    // iterate through the keys, skipping those outside the sliding window of
+    // every query of the block
+    uint32_t beginT = 0;
+    uint32_t endT = ctx.kv_rows.len;
+    if (args.window_size > 0) {
+      if (startF + 1 > args.window_size) {
+        beginT = (startF + 1 - args.window_size) / kBc * kBc;
+      }
+      if constexpr (!kIsCausal) {
+        endT = std::min(endT, endF + args.window_size - 1);
+      }
+    }
+    for (uint32_t startT = beginT; startT < endT; startT += kBc) {
       if constexpr (kIsCausal) {
         if (startT >= endF) break;
       }
@@ -550,7 +631,7 @@ class fmha_forward_t {
       // apply mask
       apply_mask(matAccSij, args, startF, startT);
       // softmax
-      softmax_fwd(matAccSij, matAccOi, args);
+      softmax_fwd(matAccSij, matAccOi, args, startF, startT);
       // compute Oi
       gemm_Oi(matAccOi, args, startT);
     }
@@ -574,14 +655,16 @@ class FmhaForwardKernel;
 template <typename fmha_policy, typename T, bool kUseBias, bool kIsCausal,
           bool kIsDropout, bool kIsTraining>
 void fmha_forward_impl(sycl::queue& q, T* query, T* key, T* value, T* bias,
-                       uint8_t* dropout, float dropout_prob, T* out,
+                       uint64_t seed, float dropout_prob, T* out,
                        float* activation_ptr, uint32_t num_batches,
-                       uint32_t num_heads, uint32_t head_size,
-                       uint32_t num_queries, uint32_t num_keys,
-                       float head_scale) {
+                       uint32_t num_heads, uint32_t num_kv_heads,
+                       uint32_t head_size, uint32_t num_queries,
+                       uint32_t num_keys, float head_scale,
+                       int32_t* cu_seqlens_q, int32_t* cu_seqlens_k,
+                       uint32_t window_size, float* alibi_slopes) {
   // fmha forward kernel
-  using fmha_forward_op_t =
-      fmha_forward_t<fmha_policy, T, kUseBias, kIsCausal, kIsTraining>;
+  using fmha_forward_op_t = fmha_forward_t<fmha_policy, T, kUseBias, kIsCausal,
+                                           kIsDropout, kIsTraining>;
 
   sycl::nd_range<3> NdRange =
       fmha_forward_op_t::get_nd_range(num_batches * num_heads, num_queries);
@@ -596,9 +679,10 @@ void fmha_forward_impl(sycl::queue& q, T* query, T* key, T* value, T* bias,
           // init fmha forward op and arguments
           fmha_forward_op_t fmha_fwd_op;
           typename fmha_forward_op_t::arguments_t args(
-              query, key, value, bias, dropout, dropout_prob, out,
-              activation_ptr, num_batches, num_heads, head_size, num_queries,
-              num_keys, head_scale);
+              query, key, value, bias, seed, dropout_prob, out,
+              activation_ptr, num_batches, num_heads, num_kv_heads,
+              head_size, num_queries, num_keys, head_scale, cu_seqlens_q,
+              cu_seqlens_k, window_size, alibi_slopes);
 
           // call the functor
           fmha_fwd_op(ei, args);
@@ -610,21 +694,72 @@ void fmha_forward_impl(sycl::queue& q, T* query, T* key, T* value, T* bias,
 
 #define CALL_IMPL_FUNC(P)                                                      \
   fmha::fmha_forward_impl<P, T, kUseBias, kIsCausal, kIsDropout, kIsTraining>( \
-      q, query, key, value, bias, dropout, dropout_prob, out, activation_ptr,  \
-      num_batches, num_heads, head_size, num_queries, num_keys, head_scale)
-
-/// @brief Main execution function for flash mha forward.
+      q, query, key, value, bias, seed, dropout_prob, out, activation_ptr,     \
+      num_batches, num_heads, num_kv_heads, head_size, num_queries, num_keys,  \
+      head_scale, cu_seqlens_q, cu_seqlens_k, window_size, alibi_slopes)
+
+/// @brief Main execution function for flash mha forward. Given cumulative
+/// sequence lengths, the sequences are packed and num_queries and num_keys are
+/// their maximum lengths. A non-zero window_size restricts every query to a
+/// sliding window of keys and alibi_slopes [N] adds ALiBi biases, both
+/// computed in the kernel instead of read from a bias tensor.
 template <typename T, bool kUseBias = false, bool kIsCausal = false,
           bool kIsDropout = false, bool kIsTraining = false>
 void fmha_forward(sycl::queue& q, T* query, T* key, T* value, T* bias,
-                  uint8_t* dropout, float dropout_prob, T* out,
+                  uint64_t seed, float dropout_prob, T* out,
                   float* activation_ptr, uint32_t num_batches,
-                  uint32_t num_heads, uint32_t head_size, uint32_t num_queries,
-                  uint32_t num_keys, float head_scale) {
+                  uint32_t num_heads, uint32_t num_kv_heads,
+                  uint32_t head_size, uint32_t num_queries, uint32_t num_keys,
+                  float head_scale, int32_t* cu_seqlens_q = nullptr,
+                  int32_t* cu_seqlens_k = nullptr, uint32_t window_size = 0,
+                  float* alibi_slopes = nullptr) {
+  // Decoding long sequences with few batch-heads splits the keys across work
+  // groups instead, which needs exact head sizes and no per-query state.
+  if constexpr (!kIsCausal && !kIsDropout && !kIsTraining &&
+                !std::is_same_v<T, tf32>) {
+    uint32_t num_splits = fmha::get_split_kv_count(
+        q, num_batches * num_heads, num_queries, num_keys);
+    if (num_splits > 1 && cu_seqlens_q == nullptr && window_size == 0 &&
+        alibi_slopes == nullptr &&
+        (head_size == 64 || head_size == 128 || head_size == 256)) {
+      auto split_kv = [&](auto head_size_t) {
+        fmha::fmha_split_kv_impl<T, decltype(head_size_t)::value, kUseBias>(
+            q, query, key, value, bias, out, num_batches, num_heads,
+            num_kv_heads, num_keys, head_scale, num_splits);
+      };
+      if (head_size == 64) {
+        split_kv(std::integral_constant<uint32_t, 64>());
+      } else if (head_size == 128) {
+        split_kv(std::integral_constant<uint32_t, 128>());
+      } else {
+        split_kv(std::integral_constant<uint32_t, 256>());
+      }
+      return;
+    }
+  }
+  if constexpr (std::is_same_v<T, tf32>) {
+    if (head_size <= 64) {
+      CALL_IMPL_FUNC(fmha_policy_64x128x64);
+    } else if (head_size <= 128) {
+      CALL_IMPL_FUNC(fmha_policy_64x128x128);
+    } else {
+      CHECK(false) << "No TF32 policy available for current head_size "
+                   << head_size << "\n";
+    }
+    return;
+  }
   if (head_size <= 64) {
     CALL_IMPL_FUNC(fmha_policy_64x128x64);
+  } else if (head_size <= 80) {
+    CALL_IMPL_FUNC(fmha_policy_64x160x80);
+  } else if (head_size <= 96) {
+    CALL_IMPL_FUNC(fmha_policy_64x128x96);
   } else if (head_size <= 128) {
     CALL_IMPL_FUNC(fmha_policy_64x128x128);
+  } else if (head_size <= 160) {
+    CALL_IMPL_FUNC(fmha_policy_64x160x160);
+  } else if (head_size <= 192) {
+    CALL_IMPL_FUNC(fmha_policy_64x128x192);
   } else if (head_size <= 256) {
     if (num_keys < 64) {
       CALL_IMPL_FUNC(fmha_policy_8x256x256);
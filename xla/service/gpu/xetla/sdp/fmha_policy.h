@@ -82,6 +82,58 @@ struct fmha_policy_64x128x256 : fmha_policy_base {
   static constexpr uint32_t thread_num = (kBr / kSgBr) * (kBc / kSgBc);
 };
 
+struct fmha_policy_64x160x80 : fmha_policy_base {
+  static constexpr uint32_t kBr = 64;
+  static constexpr uint32_t kSgBr = 16;
+  static constexpr uint32_t kBc = 160;
+  static constexpr uint32_t kSgBc = 32;
+  static constexpr uint32_t kHm = 80;
+  static constexpr uint32_t kSgHm = 16;
+  static constexpr uint32_t thread_num = (kBr / kSgBr) * (kBc / kSgBc);
+};
+
+struct fmha_policy_64x128x96 : fmha_policy_base {
+  static constexpr uint32_t kBr = 64;
+  static constexpr uint32_t kSgBr = 16;
+  static constexpr uint32_t kBc = 128;
+  static constexpr uint32_t kSgBc = 64;
+  static constexpr uint32_t kHm = 96;
+  static constexpr uint32_t kSgHm = 48;
+  static constexpr uint32_t thread_num = (kBr / kSgBr) * (kBc / kSgBc);
+};
+
+struct fmha_policy_64x160x160 : fmha_policy_base {
+  static constexpr uint32_t kBr = 64;
+  static constexpr uint32_t kSgBr = 16;
+  static constexpr uint32_t kBc = 160;
+  static constexpr uint32_t kSgBc = 32;
+  static constexpr uint32_t kHm = 160;
+  static constexpr uint32_t kSgHm = 32;
+  static constexpr uint32_t thread_num = (kBr / kSgBr) * (kBc / kSgBc);
+};
+
+struct fmha_policy_64x128x192 : fmha_policy_base {
+  static constexpr uint32_t kBr = 64;
+  static constexpr uint32_t kSgBr = 16;
+  static constexpr uint32_t kBc = 128;
+  static constexpr uint32_t kSgBc = 32;
+  static constexpr uint32_t kHm = 192;
+  static constexpr uint32_t kSgHm = 48;
+  static constexpr uint32_t thread_num = (kBr / kSgBr) * (kBc / kSgBc);
+};
+
+/*
+Split-KV decoding: every work group of sg_num sub-groups processes at least
+min_keys_per_split keys of one batch-head, see fmha_split_kv.h.
+*/
+
+struct fmha_split_kv_policy {
+  static constexpr uint32_t sg_size = 16;
+  static constexpr uint32_t sg_num = 8;
+  static constexpr uint32_t min_keys_per_split = 256;
+  static constexpr uint32_t max_splits = 64;
+};
+
 struct fmha_bwd_policy_128x128x64 : fmha_policy_base {
   static constexpr uint32_t kBr = 128;
   static constexpr uint32_t kSgBr = 16;
@@ -104,6 +156,17 @@ struct fmha_bwd_policy_128x128x128 : fmha_policy_base {
   static constexpr uint32_t thread_num = (kBr / kSgBr) * (kBc / kSgBc);
 };
 
+struct fmha_bwd_policy_128x128x96 : fmha_policy_base {
+  static constexpr uint32_t kBr = 128;
+  static constexpr uint32_t kSgBr = 16;
+  static constexpr uint32_t kBc = 128;
+  static constexpr uint32_t kSgBc = 64;
+  static constexpr uint32_t kSgBc_M = 16;
+  static constexpr uint32_t kHm = 96;
+  static constexpr uint32_t kSgHm = 48;
+  static constexpr uint32_t thread_num = (kBr / kSgBr) * (kBc / kSgBc);
+};
+
 struct fmha_bwd_policy_64x128x256 : fmha_policy_base {
   static constexpr uint32_t kBr = 64;
   static constexpr uint32_t kSgBr = 8;
@@ -115,4 +178,32 @@ struct fmha_bwd_policy_64x128x256 : fmha_policy_base {
   static constexpr uint32_t thread_num = (kBr / kSgBr) * (kBc / kSgBc);
 };
 
+struct fmha_bwd_policy_64x128x192 : fmha_policy_base {
+  static constexpr uint32_t kBr = 64;
+  static constexpr uint32_t kSgBr = 8;
+  static constexpr uint32_t kBc = 128;
+  static constexpr uint32_t kSgBc = 32;
+  static constexpr uint32_t kSgBc_M = 16;
+  static constexpr uint32_t kHm = 192;
+  static constexpr uint32_t kSgHm = 48;
+  static constexpr uint32_t thread_num = (kBr / kSgBr) * (kBc / kSgBc);
+};
+
+/*
+TF32: fp32 inputs run on XMX with float accumulation. The tiles take twice the
+shared local memory of the 16-bit ones, the forward kernel reuses the 64 and
+128 policies and the backward kernel halves kBr.
+*/
+
+struct fmha_tf32_bwd_policy_64x128x128 : fmha_policy_base {
+  static constexpr uint32_t kBr = 64;
+  static constexpr uint32_t kSgBr = 16;
+  static constexpr uint32_t kBc = 128;
+  static constexpr uint32_t kSgBc = 32;
+  static constexpr uint32_t kSgBc_M = 32;
+  static constexpr uint32_t kHm = 128;
+  static constexpr uint32_t kSgHm = 32;
+  static constexpr uint32_t thread_num = (kBr / kSgBr) * (kBc / kSgBc);
+};
+
 }  // namespace gpu::xetla
\ No newline at end of file
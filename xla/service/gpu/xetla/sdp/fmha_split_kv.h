@@ -0,0 +1,248 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*
+Split-KV Flash Decoding
+
+With a single query token (F == 1) the forward kernel only has B * N work
+groups, which leaves most Xe cores idle for small batches. Here the keys of
+every batch-head are partitioned across work groups (see: Dao et al.,
+https://crfm.stanford.edu/2023/10/12/flashdecoding.html). Each split writes
+its unnormalized output with the softmax max and sum of its keys, and a
+second kernel rescales and merges the splits.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include <sycl/sycl.hpp>
+
+#include "fmha_policy.h"
+
+namespace gpu::xetla {
+
+namespace fmha {
+
+/// @brief Returns the number of splits of the keys to use for decoding, or 1
+/// if the regular forward kernel already fills the device.
+inline uint32_t get_split_kv_count(sycl::queue& q, uint32_t total_batches,
+                                   uint32_t num_queries, uint32_t num_keys) {
+  using policy = fmha_split_kv_policy;
+  if (num_queries != 1) return 1;
+  // A work group of sg_num sub-groups occupies one EU thread per sub-group,
+  // so the device runs about one such work group per EU at a time.
+  const uint32_t num_eus =
+      q.get_device().get_info<sycl::info::device::max_compute_units>();
+  if (total_batches * 2 > num_eus) return 1;
+  const uint32_t max_splits_by_keys = num_keys / policy::min_keys_per_split;
+  const uint32_t splits_to_fill = (num_eus + total_batches - 1) / total_batches;
+  return std::min({max_splits_by_keys, splits_to_fill, policy::max_splits});
+}
+
+/// @brief Returns a device buffer of at least `size` floats for the partial
+/// results of the splits. Kernels on a queue run in order, so one buffer per
+/// queue is enough; it grows on demand and is kept for the process lifetime.
+inline float* get_split_kv_workspace(sycl::queue& q, size_t size) {
+  static std::mutex mu;
+  static auto* workspaces =
+      new std::unordered_map<sycl::queue, std::pair<float*, size_t>>();
+  std::lock_guard<std::mutex> lock(mu);
+  auto& [ptr, capacity] = (*workspaces)[q];
+  if (capacity < size) {
+    if (ptr != nullptr) {
+      q.wait();
+      sycl::free(ptr, q);
+    }
+    ptr = sycl::malloc_device<float>(size, q);
+    capacity = size;
+  }
+  return ptr;
+}
+
+template <typename T, uint32_t kHeadSize, bool kUseBias>
+class FmhaSplitKvKernel;
+
+template <typename T, uint32_t kHeadSize>
+class FmhaSplitKvReduceKernel;
+
+// query:     [B, N, 1, H]
+// key:       [B, N_kv, T, H]
+// value:     [B, N_kv, T, H]
+// bias:      [B, 1, 1, T]
+// out:       [B, N, 1, H]
+// workspace: [B * N, num_splits, H + 2]
+template <typename T, uint32_t kHeadSize, bool kUseBias>
+void fmha_split_kv_impl(sycl::queue& q, const T* query, const T* key,
+                        const T* value, const T* bias, T* out,
+                        uint32_t num_batches, uint32_t num_heads,
+                        uint32_t num_kv_heads, uint32_t num_keys,
+                        float head_scale, uint32_t num_splits) {
+  using policy = fmha_split_kv_policy;
+  constexpr uint32_t kSgSize = policy::sg_size;
+  constexpr uint32_t kNumSg = policy::sg_num;
+  static_assert(kHeadSize % kSgSize == 0,
+                "head size must be a multiple of the sub-group size");
+  constexpr uint32_t kElems = kHeadSize / kSgSize;
+  // Partial output followed by the max and sum of a split or sub-group.
+  constexpr uint32_t kStride = kHeadSize + 2;
+
+  const uint32_t total_batches = num_batches * num_heads;
+  const uint32_t queries_per_kv = num_heads / num_kv_heads;
+  const uint32_t keys_per_split = (num_keys + num_splits - 1) / num_splits;
+  float* workspace = get_split_kv_workspace(
+      q, static_cast<size_t>(total_batches) * num_splits * kStride);
+
+  q.submit([&](sycl::handler& cgh) {
+    sycl::local_accessor<float, 1> slm(sycl::range<1>(kNumSg * kStride), cgh);
+    cgh.parallel_for<FmhaSplitKvKernel<T, kHeadSize, kUseBias>>(
+        sycl::nd_range<2>({total_batches, num_splits * kNumSg * kSgSize},
+                          {1, kNumSg * kSgSize}),
+        [=](sycl::nd_item<2> item) [[sycl::reqd_sub_group_size(kSgSize)]] {
+          const uint32_t gid = item.get_group(0);
+          const uint32_t split = item.get_group(1);
+          sycl::sub_group sg = item.get_sub_group();
+          const uint32_t sg_id = sg.get_group_linear_id();
+          const uint32_t lane = sg.get_local_linear_id();
+
+          const T* q_ptr = query + static_cast<size_t>(gid) * kHeadSize;
+          float q_reg[kElems];
+#pragma unroll
+          for (uint32_t i = 0; i < kElems; ++i) {
+            q_reg[i] =
+                static_cast<float>(q_ptr[i * kSgSize + lane]) * head_scale;
+          }
+
+          float m = -INFINITY;
+          float l = 0.f;
+          float acc[kElems];
+#pragma unroll
+          for (uint32_t i = 0; i < kElems; ++i) acc[i] = 0.f;
+
+          const uint32_t kv_gid = gid / num_heads * num_kv_heads +
+                                  gid % num_heads / queries_per_kv;
+          const size_t kv_base = static_cast<size_t>(kv_gid) * num_keys;
+          const T* bias_ptr =
+              kUseBias ? bias + static_cast<size_t>(gid / num_heads) * num_keys
+                       : nullptr;
+          const uint32_t start_t = split * keys_per_split;
+          const uint32_t end_t = std::min(start_t + keys_per_split, num_keys);
+          for (uint32_t t = start_t + sg_id; t < end_t; t += kNumSg) {
+            const size_t base = (kv_base + t) * kHeadSize;
+            float s = 0.f;
+#pragma unroll
+            for (uint32_t i = 0; i < kElems; ++i) {
+              s += q_reg[i] *
+                   static_cast<float>(key[base + i * kSgSize + lane]);
+            }
+            s = sycl::reduce_over_group(sg, s, sycl::plus<float>());
+            if constexpr (kUseBias) s += static_cast<float>(bias_ptr[t]);
+
+            const float m_new = sycl::fmax(m, s);
+            const float correction = sycl::exp(m - m_new);
+            const float p = sycl::exp(s - m_new);
+            l = l * correction + p;
+#pragma unroll
+            for (uint32_t i = 0; i < kElems; ++i) {
+              acc[i] = acc[i] * correction +
+                       p * static_cast<float>(value[base + i * kSgSize + lane]);
+            }
+            m = m_new;
+          }
+
+          // Merge the sub-groups into the partial result of the split.
+          float* sg_slm = &slm[sg_id * kStride];
+#pragma unroll
+          for (uint32_t i = 0; i < kElems; ++i) {
+            sg_slm[i * kSgSize + lane] = acc[i];
+          }
+          if (lane == 0) {
+            sg_slm[kHeadSize] = m;
+            sg_slm[kHeadSize + 1] = l;
+          }
+          sycl::group_barrier(item.get_group());
+          if (sg_id != 0) return;
+
+          float m_split = -INFINITY;
+          for (uint32_t s = 0; s < kNumSg; ++s) {
+            m_split = sycl::fmax(m_split, slm[s * kStride + kHeadSize]);
+          }
+          float l_split = 0.f;
+          float out_reg[kElems];
+#pragma unroll
+          for (uint32_t i = 0; i < kElems; ++i) out_reg[i] = 0.f;
+          for (uint32_t s = 0; s < kNumSg; ++s) {
+            const float m_s = slm[s * kStride + kHeadSize];
+            if (m_s == -INFINITY) continue;
+            const float correction = sycl::exp(m_s - m_split);
+            l_split += slm[s * kStride + kHeadSize + 1] * correction;
+#pragma unroll
+            for (uint32_t i = 0; i < kElems; ++i) {
+              out_reg[i] += slm[s * kStride + i * kSgSize + lane] * correction;
+            }
+          }
+
+          float* ws_ptr =
+              workspace +
+              (static_cast<size_t>(gid) * num_splits + split) * kStride;
+#pragma unroll
+          for (uint32_t i = 0; i < kElems; ++i) {
+            ws_ptr[i * kSgSize + lane] = out_reg[i];
+          }
+          if (lane == 0) {
+            ws_ptr[kHeadSize] = m_split;
+            ws_ptr[kHeadSize + 1] = l_split;
+          }
+        });
+  });
+
+  // Rescale the splits to their common max and normalize by the total sum.
+  q.submit([&](sycl::handler& cgh) {
+    cgh.parallel_for<FmhaSplitKvReduceKernel<T, kHeadSize>>(
+        sycl::nd_range<2>({total_batches, kHeadSize}, {1, kHeadSize}),
+        [=](sycl::nd_item<2> item) {
+          const uint32_t gid = item.get_group(0);
+          const uint32_t h = item.get_local_id(1);
+          const float* ws_ptr =
+              workspace + static_cast<size_t>(gid) * num_splits * kStride;
+
+          float m_all = -INFINITY;
+          for (uint32_t s = 0; s < num_splits; ++s) {
+            m_all = sycl::fmax(m_all, ws_ptr[s * kStride + kHeadSize]);
+          }
+          float l_all = 0.f;
+          float o = 0.f;
+          for (uint32_t s = 0; s < num_splits; ++s) {
+            const float m_s = ws_ptr[s * kStride + kHeadSize];
+            if (m_s == -INFINITY) continue;
+            const float correction = sycl::exp(m_s - m_all);
+            l_all += ws_ptr[s * kStride + kHeadSize + 1] * correction;
+            o += ws_ptr[s * kStride + h] * correction;
+          }
+          const float inv_l = l_all > 0.f ? 1.f / l_all : 0.f;
+          out[static_cast<size_t>(gid) * kHeadSize + h] =
+              static_cast<T>(o * inv_l);
+        });
+  });
+}
+
+}  // namespace fmha
+
+}  // namespace gpu::xetla
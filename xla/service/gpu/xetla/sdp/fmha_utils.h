@@ -15,6 +15,10 @@ limitations under the License.
 
 #pragma once
 
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+
 #include "xetla.hpp"
 
 namespace gpu::xetla {
@@ -139,6 +143,291 @@ struct tile_mask_t {
       }
     }
   }
+
+  // ------------------- // sliding_window_mask // ------------------ //
+
+  /// @brief Masks the keys at least `window` positions before the query, and
+  /// if `two_sided` also those at least `window` positions after it. As for
+  /// the causal mask, query i and key i are at the same position.
+  inline static void sliding_window_mask(mat_t& src, uint32_t start_x,
+                                         uint32_t start_y, uint32_t window,
+                                         bool two_sided) {
+    auto mask_row = [&](auto&& row, uint32_t blk_start_x, uint32_t y) {
+      xetla_vector<uint32_t, block_size_x> blk_seq_x =
+          xetla_vector_gen<uint32_t, block_size_x>(blk_start_x, 1);
+      xetla_mask<block_size_x> mask = blk_seq_x + window <= y;
+      if (two_sided) mask |= blk_seq_x >= y + window;
+      row.xetla_merge(kNegInfinity, mask);
+    };
+    for_each_row(src, start_x, start_y, mask_row);
+  }
+
+  // ----------------------- // alibi_bias // ----------------------- //
+
+  /// @brief Adds the ALiBi bias -slope * |key - query| (see: Press et al.,
+  /// https://arxiv.org/abs/2108.12409) to the scores.
+  inline static void alibi_bias(mat_t& src, uint32_t start_x, uint32_t start_y,
+                                accum_t slope) {
+    auto bias_row = [&](auto&& row, uint32_t blk_start_x, uint32_t y) {
+      xetla_vector<accum_t, block_size_x> dist =
+          xetla_vector_gen<accum_t, block_size_x>(
+              static_cast<accum_t>(blk_start_x) - static_cast<accum_t>(y), 1);
+      row -= slope * xetla_abs<accum_t, block_size_x>(dist);
+    };
+    for_each_row(src, start_x, start_y, bias_row);
+  }
+
+ private:
+  /// @brief Calls op(row, key, query) for every block row of the tile at key
+  /// `start_x` and query `start_y`, with the key of the first element.
+  template <typename op_t>
+  inline static void for_each_row(mat_t& src, uint32_t start_x,
+                                  uint32_t start_y, op_t op) {
+#pragma unroll
+    for (int i = 0; i < tile_size_y / block_size_y; i++) {
+#pragma unroll
+      for (int j = 0; j < num_block_x; j++) {
+        auto src_sub =
+            src.reg
+                .xetla_select<block_elems, 1>((i * num_block_x + j) *
+                                              block_elems)
+                .xetla_format<accum_t, block_size_y, block_size_x>();
+#pragma unroll
+        for (int k = 0; k < block_size_y; k++) {
+          op(src_sub.row(k), start_x + j * block_size_x,
+             start_y + i * block_size_y + k);
+        }
+      }
+    }
+
+    if constexpr ((tile_size_y % block_size_y) != 0) {
+      constexpr uint32_t tail_start_y =
+          tile_size_y / block_size_y * block_size_y;
+      constexpr uint32_t tail_size_y = tile_size_y % block_size_y;
+      constexpr uint32_t tail_block_elems = tail_size_y * block_size_x;
+#pragma unroll
+      for (int j = 0; j < num_block_x; j++) {
+        auto src_sub =
+            src.reg
+                .xetla_select<tail_block_elems, 1>(
+                    tail_start_y * tile_size_x + j * tail_block_elems)
+                .xetla_format<accum_t, tail_size_y, block_size_x>();
+#pragma unroll
+        for (int k = 0; k < tail_size_y; k++) {
+          op(src_sub.row(k), start_x + j * block_size_x,
+             start_y + tail_start_y + k);
+        }
+      }
+    }
+  }
+};
+
+// ========================= // fp8 // =========================== //
+
+/// @brief FP8 storage types (see: Micikevicius et al.,
+/// https://arxiv.org/abs/2209.05433). Their bytes are only converted to float
+/// in registers, multiplied by the scale they were quantized with.
+struct fp8_e4m3_t {
+  uint8_t bits;
+};
+
+struct fp8_e5m2_t {
+  uint8_t bits;
+};
+
+template <typename T>
+inline constexpr bool is_fp8_v =
+    std::is_same_v<T, fp8_e4m3_t> || std::is_same_v<T, fp8_e5m2_t>;
+
+/// @brief E4M3 as in the OCP FP8 spec: bias 7, no infinities, S.1111.111 is
+/// NaN.
+inline float fp8_to_float(fp8_e4m3_t x) {
+  uint32_t sign = static_cast<uint32_t>(x.bits & 0x80) << 24;
+  uint32_t exp = (x.bits >> 3) & 0xf;
+  uint32_t man = x.bits & 0x7;
+  if (exp == 0) {
+    float v = static_cast<float>(man) * 0x1p-9f;
+    return sign ? -v : v;
+  }
+  if (exp == 0xf && man == 0x7) return NAN;
+  return sycl::bit_cast<float>(sign | (exp + 120) << 23 | man << 20);
+}
+
+/// @brief E5M2 is the upper byte of an IEEE half.
+inline float fp8_to_float(fp8_e5m2_t x) {
+  return static_cast<float>(
+      sycl::bit_cast<sycl::half>(static_cast<uint16_t>(x.bits << 8)));
+}
+
+/// @brief Converts an element of a 16-bit or FP8 buffer to float.
+template <typename T>
+inline float load_as_float(const T* ptr, size_t idx) {
+  if constexpr (is_fp8_v<T>) {
+    return fp8_to_float(ptr[idx]);
+  } else {
+    return static_cast<float>(ptr[idx]);
+  }
+}
+
+// ==================== // philox4x32_t // ======================= //
+
+/// @brief Philox4x32-10 counter based random number generator (Salmon et al.,
+/// "Parallel Random Numbers: As Easy as 1, 2, 3"), computed for N counters at
+/// once. The output is a pure function of the counter and the key.
+template <uint32_t N>
+struct philox4x32_t {
+  using vec_t = xetla_vector<uint32_t, N>;
+  static constexpr uint32_t kM0 = 0xD2511F53;
+  static constexpr uint32_t kM1 = 0xCD9E8D57;
+  static constexpr uint32_t kW0 = 0x9E3779B9;
+  static constexpr uint32_t kW1 = 0xBB67AE85;
+  static constexpr int kRounds = 10;
+
+  /// @brief Replaces the counter `c` by the random numbers of `c` and the key.
+  inline static void run(vec_t* c, uint32_t k0, uint32_t k1) {
+#pragma unroll
+    for (int r = 0; r < kRounds; ++r) {
+      xetla_vector<uint64_t, N> p0 = xetla_vector<uint64_t, N>(c[0]) * kM0;
+      xetla_vector<uint64_t, N> p1 = xetla_vector<uint64_t, N>(c[2]) * kM1;
+      vec_t hi0 = xetla_vector<uint32_t, N>(p0 >> 32);
+      vec_t hi1 = xetla_vector<uint32_t, N>(p1 >> 32);
+      vec_t c1 = c[1];
+      vec_t c3 = c[3];
+      c[0] = hi1 ^ c1 ^ k0;
+      c[1] = xetla_vector<uint32_t, N>(p1);
+      c[2] = hi0 ^ c3 ^ k1;
+      c[3] = xetla_vector<uint32_t, N>(p0);
+      k0 += kW0;
+      k1 += kW1;
+    }
+  }
+};
+
+// ==================== // tile_dropout_t // ====================== //
+
+/// @brief Dropout of the attention probabilities. Whether an element is kept
+/// only depends on the seed, its batch-head and its (query, key) position, so
+/// the backward kernels regenerate the mask of the forward kernel in registers
+/// whatever their tiling is, and no [B, N, F, T] mask is ever stored.
+template <typename mat_t>
+struct tile_dropout_t {
+  using accum_t = typename mat_t::dtype;
+  static constexpr uint32_t tile_size_x = mat_t::tile_size_x;
+  static constexpr uint32_t tile_size_y = mat_t::tile_size_y;
+  static constexpr uint32_t block_size_x = mat_t::block_size_x;
+  static constexpr uint32_t block_size_y = mat_t::block_size_y;
+  static constexpr int32_t num_block_x = mat_t::num_block_x;
+  static constexpr uint32_t block_elems = mat_t::block_elems;
+  // Every Philox call yields 4 numbers, for 4 neighbouring keys.
+  static constexpr uint32_t kLanes = block_size_x / 4;
+  static_assert(block_size_x % 4 == 0, "block_size_x must be a multiple of 4");
+
+  using keep_t = xetla_vector<uint8_t, mat_t::tile_elems>;
+
+  /// @brief Fills `keep` with 1 for the elements of the tile at key `start_x`
+  /// and query `start_y` that are kept with probability 1 - `prob`, and with
+  /// 0 for the dropped ones.
+  inline static void generate(keep_t& keep, uint64_t seed, accum_t prob,
+                              uint32_t batch_head, uint32_t start_x,
+                              uint32_t start_y) {
+    uint32_t threshold =
+        prob >= 1.f ? 0xffffffff : static_cast<uint32_t>(prob * 4294967296.f);
+    uint32_t k0 = static_cast<uint32_t>(seed);
+    uint32_t k1 = static_cast<uint32_t>(seed >> 32);
+#pragma unroll
+    for (int i = 0; i < tile_size_y / block_size_y; i++) {
+#pragma unroll
+      for (int j = 0; j < num_block_x; j++) {
+        uint32_t offset = (i * num_block_x + j) * block_elems;
+#pragma unroll
+        for (int k = 0; k < block_size_y; k++) {
+          keep.xetla_select<block_size_x, 1>(offset + k * block_size_x) =
+              keep_row(k0, k1, threshold, batch_head,
+                       start_x + j * block_size_x,
+                       start_y + i * block_size_y + k);
+        }
+      }
+    }
+
+    if constexpr ((tile_size_y % block_size_y) != 0) {
+      constexpr uint32_t tail_start_y =
+          tile_size_y / block_size_y * block_size_y;
+      constexpr uint32_t tail_size_y = tile_size_y % block_size_y;
+      constexpr uint32_t tail_block_elems = tail_size_y * block_size_x;
+#pragma unroll
+      for (int j = 0; j < num_block_x; j++) {
+        uint32_t offset = tail_start_y * tile_size_x + j * tail_block_elems;
+#pragma unroll
+        for (int k = 0; k < tail_size_y; k++) {
+          keep.xetla_select<block_size_x, 1>(offset + k * block_size_x) =
+              keep_row(k0, k1, threshold, batch_head,
+                       start_x + j * block_size_x, start_y + tail_start_y + k);
+        }
+      }
+    }
+  }
+
+  /// @brief Zeroes the dropped elements of `src` and scales the kept ones by
+  /// `scale`, i.e. 1 / (1 - prob).
+  inline static void apply(mat_t& src, const keep_t& keep, accum_t scale) {
+    src.reg *= scale;
+    src.reg.xetla_merge(0, keep == 0);
+  }
+
+ private:
+  inline static xetla_vector<uint8_t, block_size_x> keep_row(
+      uint32_t k0, uint32_t k1, uint32_t threshold, uint32_t batch_head,
+      uint32_t col, uint32_t row) {
+    using philox_t = philox4x32_t<kLanes>;
+    typename philox_t::vec_t c[4];
+    c[0] = xetla_vector_gen<uint32_t, kLanes>(col / 4, 1);
+    c[1] = row;
+    c[2] = batch_head;
+    c[3] = 0;
+    philox_t::run(c, k0, k1);
+
+    xetla_vector<uint32_t, block_size_x> rand;
+#pragma unroll
+    for (int w = 0; w < 4; w++) {
+      rand.xetla_select<kLanes, 4>(w) = c[w];
+    }
+    xetla_vector<uint8_t, block_size_x> keep = 0;
+    keep.xetla_merge(1, rand >= threshold);
+    return keep;
+  }
+};
+
+// ======================= // seq_rows_t // ======================= //
+
+/// @brief Rows of the sequence of one batch-head, either in a padded
+/// [B, N, S, H] tensor or, given cumulative sequence offsets `cu_seqlens` of
+/// size B + 1, in a packed [total_S, N, H] tensor.
+struct seq_rows_t {
+  // Offset of the head in a row and distance between two rows, in elements
+  uint32_t offset;
+  uint32_t pitch;
+  // First row and number of rows of the sequence
+  uint32_t start;
+  uint32_t len;
+
+  inline void init(const int32_t* cu_seqlens, uint32_t batch_head,
+                   uint32_t num_heads, uint32_t head_size, uint32_t max_len) {
+    if (cu_seqlens == nullptr) {
+      offset = 0;
+      pitch = head_size;
+      start = batch_head * max_len;
+      len = max_len;
+    } else {
+      uint32_t b = batch_head / num_heads;
+      offset = batch_head % num_heads * head_size;
+      pitch = num_heads * head_size;
+      start = cu_seqlens[b];
+      len = cu_seqlens[b + 1] - start;
+    }
+  }
+
+  /// @brief Returns one past the last row of the sequence.
+  inline uint32_t end() const { return start + len; }
 };
 
 // ==================== // group_row_reduce_t // ================== //
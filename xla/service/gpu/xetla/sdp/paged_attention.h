@@ -0,0 +1,229 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*
+Paged Attention Decode
+
+Attention of a single query token per sequence over a key/value cache stored
+in fixed-size blocks, as done by LLM serving with continuous batching (see:
+Kwon et al., https://arxiv.org/abs/2309.06180). The blocks of a sequence are
+found through its row of the block table, so the cache never has to be
+gathered into contiguous [B, N, T, H] tensors.
+
+With a single query row there is nothing for XMX to multiply, decoding is
+bound by reading the cache. Every work group computes one (sequence, head)
+pair, its sub-groups stream interleaved tokens with an online softmax and are
+merged through shared local memory at the end.
+
+The cache may also be stored in FP8 with a scale per key/value head, which
+halves the memory of long contexts. Its bytes are converted to float in
+registers; the key scale is applied once to every dot product and the value
+scale once to the output.
+*/
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include <sycl/sycl.hpp>
+
+#include "fmha_utils.h"
+#include "tsl/platform/logging.h"
+
+namespace gpu::xetla {
+
+namespace paged_attention {
+
+constexpr uint32_t kSgSize = 16;
+constexpr uint32_t kNumSg = 8;
+
+template <typename T, typename CacheT, uint32_t kHeadSize>
+class PagedAttentionDecodeKernel;
+
+// query:         [B, N, H]
+// key_cache:     [num_blocks, block_size, N_kv, H]
+// value_cache:   [num_blocks, block_size, N_kv, H]
+// k_scales:      [N_kv], for FP8 caches only
+// v_scales:      [N_kv], for FP8 caches only
+// block_tables:  [B, max_blocks_per_seq]
+// context_lens:  [B]
+// out:           [B, N, H]
+template <typename T, typename CacheT, uint32_t kHeadSize>
+void paged_attention_decode_impl(
+    sycl::queue& q, const T* query, const CacheT* key_cache,
+    const CacheT* value_cache, const float* k_scales, const float* v_scales,
+    const int32_t* block_tables, const int32_t* context_lens, T* out,
+    uint32_t num_seqs, uint32_t num_heads, uint32_t num_kv_heads,
+    uint32_t block_size, uint32_t max_blocks_per_seq, float scale) {
+  static_assert(kHeadSize % kSgSize == 0,
+                "head size must be a multiple of the sub-group size");
+  // Each lane holds every kSgSize-th element of the head so that the loads of
+  // a sub-group are contiguous.
+  constexpr uint32_t kElems = kHeadSize / kSgSize;
+  // Partial accumulator, max and sum of every sub-group.
+  constexpr uint32_t kSlmStride = kHeadSize + 2;
+
+  const uint32_t queries_per_kv = num_heads / num_kv_heads;
+  const size_t token_stride = static_cast<size_t>(num_kv_heads) * kHeadSize;
+  const size_t block_stride = block_size * token_stride;
+
+  sycl::range<2> local_range{1, kNumSg * kSgSize};
+  sycl::range<2> global_range{num_seqs * num_heads, kNumSg * kSgSize};
+
+  q.submit([&](sycl::handler& cgh) {
+    sycl::local_accessor<float, 1> slm(sycl::range<1>(kNumSg * kSlmStride),
+                                       cgh);
+    cgh.parallel_for<PagedAttentionDecodeKernel<T, CacheT, kHeadSize>>(
+        sycl::nd_range<2>(global_range, local_range),
+        [=](sycl::nd_item<2> item) [[sycl::reqd_sub_group_size(kSgSize)]] {
+          const uint32_t seq = item.get_group(0) / num_heads;
+          const uint32_t head = item.get_group(0) % num_heads;
+          const uint32_t kv_head = head / queries_per_kv;
+          sycl::sub_group sg = item.get_sub_group();
+          const uint32_t sg_id = sg.get_group_linear_id();
+          const uint32_t lane = sg.get_local_linear_id();
+
+          float k_scale = 1.f;
+          float v_scale = 1.f;
+          if constexpr (fmha::is_fp8_v<CacheT>) {
+            k_scale = k_scales[kv_head];
+            v_scale = v_scales[kv_head];
+          }
+
+          const T* q_ptr =
+              query + (static_cast<size_t>(seq) * num_heads + head) * kHeadSize;
+          float q_reg[kElems];
+#pragma unroll
+          for (uint32_t i = 0; i < kElems; ++i) {
+            q_reg[i] = static_cast<float>(q_ptr[i * kSgSize + lane]) * scale *
+                       k_scale;
+          }
+
+          float m = -INFINITY;
+          float l = 0.f;
+          float acc[kElems];
+#pragma unroll
+          for (uint32_t i = 0; i < kElems; ++i) acc[i] = 0.f;
+
+          const int32_t context_len = context_lens[seq];
+          const int32_t* block_table =
+              block_tables + static_cast<size_t>(seq) * max_blocks_per_seq;
+          for (int32_t t = sg_id; t < context_len; t += kNumSg) {
+            const size_t base =
+                block_table[t / block_size] * block_stride +
+                (t % block_size) * token_stride +
+                static_cast<size_t>(kv_head) * kHeadSize;
+            float s = 0.f;
+#pragma unroll
+            for (uint32_t i = 0; i < kElems; ++i) {
+              s += q_reg[i] *
+                   fmha::load_as_float(key_cache, base + i * kSgSize + lane);
+            }
+            s = sycl::reduce_over_group(sg, s, sycl::plus<float>());
+
+            const float m_new = sycl::fmax(m, s);
+            const float correction = sycl::exp(m - m_new);
+            const float p = sycl::exp(s - m_new);
+            l = l * correction + p;
+#pragma unroll
+            for (uint32_t i = 0; i < kElems; ++i) {
+              acc[i] = acc[i] * correction +
+                       p * fmha::load_as_float(value_cache,
+                                               base + i * kSgSize + lane);
+            }
+            m = m_new;
+          }
+
+          // Merge the partial results of the sub-groups.
+          float* sg_slm = &slm[sg_id * kSlmStride];
+#pragma unroll
+          for (uint32_t i = 0; i < kElems; ++i) {
+            sg_slm[i * kSgSize + lane] = acc[i];
+          }
+          if (lane == 0) {
+            sg_slm[kHeadSize] = m;
+            sg_slm[kHeadSize + 1] = l;
+          }
+          sycl::group_barrier(item.get_group());
+          if (sg_id != 0) return;
+
+          float m_all = -INFINITY;
+          for (uint32_t s = 0; s < kNumSg; ++s) {
+            m_all = sycl::fmax(m_all, slm[s * kSlmStride + kHeadSize]);
+          }
+          float l_all = 0.f;
+          float out_reg[kElems];
+#pragma unroll
+          for (uint32_t i = 0; i < kElems; ++i) out_reg[i] = 0.f;
+          for (uint32_t s = 0; s < kNumSg; ++s) {
+            const float m_s = slm[s * kSlmStride + kHeadSize];
+            // Sub-groups that saw no token have nothing to contribute.
+            if (m_s == -INFINITY) continue;
+            const float correction = sycl::exp(m_s - m_all);
+            l_all += slm[s * kSlmStride + kHeadSize + 1] * correction;
+#pragma unroll
+            for (uint32_t i = 0; i < kElems; ++i) {
+              out_reg[i] +=
+                  slm[s * kSlmStride + i * kSgSize + lane] * correction;
+            }
+          }
+
+          const float inv_l = l_all > 0.f ? v_scale / l_all : 0.f;
+          T* o_ptr =
+              out + (static_cast<size_t>(seq) * num_heads + head) * kHeadSize;
+#pragma unroll
+          for (uint32_t i = 0; i < kElems; ++i) {
+            o_ptr[i * kSgSize + lane] = static_cast<T>(out_reg[i] * inv_l);
+          }
+        });
+  });
+}
+
+}  // namespace paged_attention
+
+#define CALL_IMPL_FUNC(H)                                                 \
+  paged_attention::paged_attention_decode_impl<T, CacheT, H>(             \
+      q, query, key_cache, value_cache, k_scales, v_scales, block_tables, \
+      context_lens, out, num_seqs, num_heads, num_kv_heads, block_size,   \
+      max_blocks_per_seq, scale)
+
+/// @brief Main execution function for paged attention decoding. CacheT is T,
+/// or fmha::fp8_e4m3_t / fmha::fp8_e5m2_t with k_scales and v_scales.
+template <typename T, typename CacheT = T>
+void paged_attention_decode(sycl::queue& q, const T* query,
+                            const CacheT* key_cache, const CacheT* value_cache,
+                            const float* k_scales, const float* v_scales,
+                            const int32_t* block_tables,
+                            const int32_t* context_lens, T* out,
+                            uint32_t num_seqs, uint32_t num_heads,
+                            uint32_t num_kv_heads, uint32_t head_size,
+                            uint32_t block_size, uint32_t max_blocks_per_seq,
+                            float scale) {
+  if (head_size == 64) {
+    CALL_IMPL_FUNC(64);
+  } else if (head_size == 128) {
+    CALL_IMPL_FUNC(128);
+  } else if (head_size == 256) {
+    CALL_IMPL_FUNC(256);
+  } else {
+    CHECK(false) << "No paged attention kernel for head_size " << head_size
+                 << "\n";
+  }
+}
+
+#undef CALL_IMPL_FUNC
+
+}  // namespace gpu::xetla
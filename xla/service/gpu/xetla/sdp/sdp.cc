@@ -15,8 +15,11 @@ limitations under the License.
 
 #include "sdp.h"
 
+#include <type_traits>
+
 #include "fmha_backward.h"
 #include "fmha_forward.h"
+#include "paged_attention.h"
 #include "xetla.hpp"
 
 namespace gpu::xetla {
@@ -32,101 +35,296 @@ namespace gpu::xetla {
     }                                           \
   }()
 
-void fmha_forward_kernel_fp16(sycl::queue& q, void* query, void* key,
-                              void* value, void* bias, uint8_t* dropout,
-                              float dropout_prob, void* out,
-                              void* activation_ptr, uint32_t num_batches,
-                              uint32_t num_heads, uint32_t head_size,
-                              uint32_t num_queries, uint32_t num_keys,
-                              float head_scale, bool is_training) {
-  const bool use_causal = false;
-  const bool use_dropout = false;
+namespace {
+
+template <typename T>
+void fmha_forward_kernel(sycl::queue& q, void* query, void* key, void* value,
+                         void* bias, int32_t* cu_seqlens_q,
+                         int32_t* cu_seqlens_k, uint64_t seed,
+                         float dropout_prob, void* out, void* activation_ptr,
+                         uint32_t num_batches, uint32_t num_heads,
+                         uint32_t num_kv_heads, uint32_t head_size,
+                         uint32_t num_queries, uint32_t num_keys,
+                         float head_scale, bool is_training, bool is_causal,
+                         uint32_t window_size, float* alibi_slopes) {
+  bool use_dropout = dropout_prob > 0.f;
   bool use_bias = bias == nullptr ? false : true;
-  BOOL_SWITCH(use_causal, kIsCausal, [&] {
+  BOOL_SWITCH(is_causal, kIsCausal, [&] {
     BOOL_SWITCH(use_bias, kUseBias, [&] {
       BOOL_SWITCH(use_dropout, kIsDropout, [&] {
         BOOL_SWITCH(is_training, kIsTraining, [&] {
-          fmha_forward<fp16, kUseBias, kIsCausal, kIsDropout, kIsTraining>(
-              q, static_cast<fp16*>(query), static_cast<fp16*>(key),
-              static_cast<fp16*>(value), static_cast<fp16*>(bias), dropout,
-              dropout_prob, static_cast<fp16*>(out),
+          fmha_forward<T, kUseBias, kIsCausal, kIsDropout, kIsTraining>(
+              q, static_cast<T*>(query), static_cast<T*>(key),
+              static_cast<T*>(value), static_cast<T*>(bias), seed,
+              dropout_prob, static_cast<T*>(out),
               static_cast<float*>(activation_ptr), num_batches, num_heads,
-              head_size, num_queries, num_keys, head_scale);
+              num_kv_heads, head_size, num_queries, num_keys, head_scale,
+              cu_seqlens_q, cu_seqlens_k, window_size, alibi_slopes);
         });
       });
     });
   });
 }
 
-void fmha_forward_kernel_bf16(sycl::queue& q, void* query, void* key,
-                              void* value, void* bias, uint8_t* dropout,
-                              float dropout_prob, void* out,
-                              void* activation_ptr, uint32_t num_batches,
-                              uint32_t num_heads, uint32_t head_size,
-                              uint32_t num_queries, uint32_t num_keys,
-                              float head_scale, bool is_training) {
-  const bool use_causal = false;
-  const bool use_dropout = false;
+template <typename T>
+void fmha_backward_kernel(
+    sycl::queue& q, void* query, void* key, void* value, void* out, void* bias,
+    int32_t* cu_seqlens_q, int32_t* cu_seqlens_k, void* grad_out,
+    void* dp_sum, void* activation_ptr, void* grad_query,
+    void* grad_query_accum, void* grad_key, void* grad_value, uint64_t seed,
+    float dropout_prob, uint32_t num_batches, uint32_t num_heads,
+    uint32_t num_kv_heads, uint32_t head_size, uint32_t num_queries,
+    uint32_t num_keys, float head_scale, bool is_causal, uint32_t window_size,
+    float* alibi_slopes) {
+  bool use_dropout = dropout_prob > 0.f;
   bool use_bias = bias == nullptr ? false : true;
-  BOOL_SWITCH(use_causal, kIsCausal, [&] {
-    BOOL_SWITCH(use_bias, kUseBias, [&] {
-      BOOL_SWITCH(use_dropout, kIsDropout, [&] {
-        BOOL_SWITCH(is_training, kIsTraining, [&] {
-          fmha_forward<bf16, kUseBias, kIsCausal, kIsDropout, kIsTraining>(
-              q, static_cast<bf16*>(query), static_cast<bf16*>(key),
-              static_cast<bf16*>(value), static_cast<bf16*>(bias), dropout,
-              dropout_prob, static_cast<bf16*>(out),
-              static_cast<float*>(activation_ptr), num_batches, num_heads,
-              head_size, num_queries, num_keys, head_scale);
-        });
-      });
+  BOOL_SWITCH(use_bias, kUseBias, [&] {
+    BOOL_SWITCH(use_dropout, kIsDropout, [&] {
+      fmha_backward<T, kUseBias, kIsDropout>(
+          q, static_cast<T*>(query), static_cast<T*>(key),
+          static_cast<T*>(value), static_cast<T*>(out), static_cast<T*>(bias),
+          static_cast<T*>(grad_out), static_cast<float*>(dp_sum),
+          static_cast<float*>(activation_ptr), static_cast<T*>(grad_query),
+          static_cast<float*>(grad_query_accum), static_cast<T*>(grad_key),
+          static_cast<T*>(grad_value), seed, dropout_prob, num_batches,
+          num_heads, num_kv_heads, head_size, num_queries, num_keys,
+          head_scale, cu_seqlens_q, cu_seqlens_k, is_causal, window_size,
+          alibi_slopes);
     });
   });
 }
 
+template <typename T>
+void paged_attention_decode_fp8(
+    sycl::queue& q, void* query, void* key_cache, void* value_cache,
+    bool is_e5m2, float* k_scales, float* v_scales, int32_t* block_tables,
+    int32_t* context_lens, void* out, uint32_t num_seqs, uint32_t num_heads,
+    uint32_t num_kv_heads, uint32_t head_size, uint32_t block_size,
+    uint32_t max_blocks_per_seq, float scale) {
+  auto decode = [&](auto* cache_type) {
+    using CacheT = std::remove_pointer_t<decltype(cache_type)>;
+    paged_attention_decode<T, CacheT>(
+        q, static_cast<T*>(query), static_cast<CacheT*>(key_cache),
+        static_cast<CacheT*>(value_cache), k_scales, v_scales, block_tables,
+        context_lens, static_cast<T*>(out), num_seqs, num_heads, num_kv_heads,
+        head_size, block_size, max_blocks_per_seq, scale);
+  };
+  if (is_e5m2) {
+    decode(static_cast<fmha::fp8_e5m2_t*>(nullptr));
+  } else {
+    decode(static_cast<fmha::fp8_e4m3_t*>(nullptr));
+  }
+}
+
+}  // namespace
+
+void fmha_forward_kernel_fp16(sycl::queue& q, void* query, void* key,
+                              void* value, void* bias, uint64_t seed,
+                              float dropout_prob, void* out,
+                              void* activation_ptr, uint32_t num_batches,
+                              uint32_t num_heads, uint32_t num_kv_heads,
+                              uint32_t head_size, uint32_t num_queries,
+                              uint32_t num_keys, float head_scale,
+                              bool is_training, bool is_causal,
+                              uint32_t window_size, float* alibi_slopes) {
+  fmha_forward_kernel<fp16>(q, query, key, value, bias, nullptr, nullptr, seed,
+                            dropout_prob, out, activation_ptr, num_batches,
+                            num_heads, num_kv_heads, head_size, num_queries,
+                            num_keys, head_scale, is_training, is_causal,
+                            window_size, alibi_slopes);
+}
+
+void fmha_forward_kernel_bf16(sycl::queue& q, void* query, void* key,
+                              void* value, void* bias, uint64_t seed,
+                              float dropout_prob, void* out,
+                              void* activation_ptr, uint32_t num_batches,
+                              uint32_t num_heads, uint32_t num_kv_heads,
+                              uint32_t head_size, uint32_t num_queries,
+                              uint32_t num_keys, float head_scale,
+                              bool is_training, bool is_causal,
+                              uint32_t window_size, float* alibi_slopes) {
+  fmha_forward_kernel<bf16>(q, query, key, value, bias, nullptr, nullptr, seed,
+                            dropout_prob, out, activation_ptr, num_batches,
+                            num_heads, num_kv_heads, head_size, num_queries,
+                            num_keys, head_scale, is_training, is_causal,
+                            window_size, alibi_slopes);
+}
+
+void fmha_forward_kernel_fp32(sycl::queue& q, void* query, void* key,
+                              void* value, void* bias, uint64_t seed,
+                              float dropout_prob, void* out,
+                              void* activation_ptr, uint32_t num_batches,
+                              uint32_t num_heads, uint32_t num_kv_heads,
+                              uint32_t head_size, uint32_t num_queries,
+                              uint32_t num_keys, float head_scale,
+                              bool is_training, bool is_causal,
+                              uint32_t window_size, float* alibi_slopes) {
+  fmha_forward_kernel<tf32>(q, query, key, value, bias, nullptr, nullptr, seed,
+                            dropout_prob, out, activation_ptr, num_batches,
+                            num_heads, num_kv_heads, head_size, num_queries,
+                            num_keys, head_scale, is_training, is_causal,
+                            window_size, alibi_slopes);
+}
+
+void fmha_forward_varlen_kernel_fp16(
+    sycl::queue& q, void* query, void* key, void* value,
+    int32_t* cu_seqlens_q, int32_t* cu_seqlens_k, uint64_t seed,
+    float dropout_prob, void* out, void* activation_ptr, uint32_t num_batches,
+    uint32_t num_heads, uint32_t num_kv_heads, uint32_t head_size,
+    uint32_t max_seqlen_q, uint32_t max_seqlen_k, float head_scale,
+    bool is_training, bool is_causal, uint32_t window_size,
+    float* alibi_slopes) {
+  fmha_forward_kernel<fp16>(q, query, key, value, nullptr, cu_seqlens_q,
+                            cu_seqlens_k, seed, dropout_prob, out,
+                            activation_ptr, num_batches, num_heads,
+                            num_kv_heads, head_size, max_seqlen_q,
+                            max_seqlen_k, head_scale, is_training, is_causal,
+                            window_size, alibi_slopes);
+}
+
+void fmha_forward_varlen_kernel_bf16(
+    sycl::queue& q, void* query, void* key, void* value,
+    int32_t* cu_seqlens_q, int32_t* cu_seqlens_k, uint64_t seed,
+    float dropout_prob, void* out, void* activation_ptr, uint32_t num_batches,
+    uint32_t num_heads, uint32_t num_kv_heads, uint32_t head_size,
+    uint32_t max_seqlen_q, uint32_t max_seqlen_k, float head_scale,
+    bool is_training, bool is_causal, uint32_t window_size,
+    float* alibi_slopes) {
+  fmha_forward_kernel<bf16>(q, query, key, value, nullptr, cu_seqlens_q,
+                            cu_seqlens_k, seed, dropout_prob, out,
+                            activation_ptr, num_batches, num_heads,
+                            num_kv_heads, head_size, max_seqlen_q,
+                            max_seqlen_k, head_scale, is_training, is_causal,
+                            window_size, alibi_slopes);
+}
+
 void fmha_backward_kernel_fp16(
     sycl::queue& q, void* query, void* key, void* value, void* out, void* bias,
     void* grad_out, void* dp_sum, void* activation_ptr, void* grad_query,
-    void* grad_query_accum, void* grad_key, void* grad_value,
-    uint32_t num_batches, uint32_t num_heads, uint32_t head_size,
-    uint32_t num_queries, uint32_t num_keys, float head_scale) {
-  const bool use_dropout = false;
-  bool use_bias = bias == nullptr ? false : true;
-  BOOL_SWITCH(use_bias, kUseBias, [&] {
-    BOOL_SWITCH(use_dropout, kIsDropout, [&] {
-      fmha_backward<fp16, kUseBias, kIsDropout>(
-          q, static_cast<fp16*>(query), static_cast<fp16*>(key),
-          static_cast<fp16*>(value), static_cast<fp16*>(out),
-          static_cast<fp16*>(bias), static_cast<fp16*>(grad_out),
-          static_cast<float*>(dp_sum), static_cast<float*>(activation_ptr),
-          static_cast<fp16*>(grad_query), static_cast<float*>(grad_query_accum),
-          static_cast<fp16*>(grad_key), static_cast<fp16*>(grad_value),
-          num_batches, num_heads, head_size, num_queries, num_keys, head_scale);
-    });
-  });
+    void* grad_query_accum, void* grad_key, void* grad_value, uint64_t seed,
+    float dropout_prob, uint32_t num_batches, uint32_t num_heads,
+    uint32_t num_kv_heads, uint32_t head_size, uint32_t num_queries,
+    uint32_t num_keys, float head_scale, bool is_causal, uint32_t window_size,
+    float* alibi_slopes) {
+  fmha_backward_kernel<fp16>(
+      q, query, key, value, out, bias, nullptr, nullptr, grad_out, dp_sum,
+      activation_ptr, grad_query, grad_query_accum, grad_key, grad_value, seed,
+      dropout_prob, num_batches, num_heads, num_kv_heads, head_size,
+      num_queries, num_keys, head_scale, is_causal, window_size, alibi_slopes);
 }
 
 void fmha_backward_kernel_bf16(
     sycl::queue& q, void* query, void* key, void* value, void* out, void* bias,
     void* grad_out, void* dp_sum, void* activation_ptr, void* grad_query,
-    void* grad_query_accum, void* grad_key, void* grad_value,
-    uint32_t num_batches, uint32_t num_heads, uint32_t head_size,
-    uint32_t num_queries, uint32_t num_keys, float head_scale) {
-  const bool use_dropout = false;
-  bool use_bias = bias == nullptr ? false : true;
-  BOOL_SWITCH(use_bias, kUseBias, [&] {
-    BOOL_SWITCH(use_dropout, kIsDropout, [&] {
-      fmha_backward<bf16, kUseBias, kIsDropout>(
-          q, static_cast<bf16*>(query), static_cast<bf16*>(key),
-          static_cast<bf16*>(value), static_cast<bf16*>(out),
-          static_cast<bf16*>(bias), static_cast<bf16*>(grad_out),
-          static_cast<float*>(dp_sum), static_cast<float*>(activation_ptr),
-          static_cast<bf16*>(grad_query), static_cast<float*>(grad_query_accum),
-          static_cast<bf16*>(grad_key), static_cast<bf16*>(grad_value),
-          num_batches, num_heads, head_size, num_queries, num_keys, head_scale);
-    });
-  });
+    void* grad_query_accum, void* grad_key, void* grad_value, uint64_t seed,
+    float dropout_prob, uint32_t num_batches, uint32_t num_heads,
+    uint32_t num_kv_heads, uint32_t head_size, uint32_t num_queries,
+    uint32_t num_keys, float head_scale, bool is_causal, uint32_t window_size,
+    float* alibi_slopes) {
+  fmha_backward_kernel<bf16>(
+      q, query, key, value, out, bias, nullptr, nullptr, grad_out, dp_sum,
+      activation_ptr, grad_query, grad_query_accum, grad_key, grad_value, seed,
+      dropout_prob, num_batches, num_heads, num_kv_heads, head_size,
+      num_queries, num_keys, head_scale, is_causal, window_size, alibi_slopes);
+}
+
+void fmha_backward_kernel_fp32(
+    sycl::queue& q, void* query, void* key, void* value, void* out, void* bias,
+    void* grad_out, void* dp_sum, void* activation_ptr, void* grad_query,
+    void* grad_query_accum, void* grad_key, void* grad_value, uint64_t seed,
+    float dropout_prob, uint32_t num_batches, uint32_t num_heads,
+    uint32_t num_kv_heads, uint32_t head_size, uint32_t num_queries,
+    uint32_t num_keys, float head_scale, bool is_causal, uint32_t window_size,
+    float* alibi_slopes) {
+  fmha_backward_kernel<tf32>(
+      q, query, key, value, out, bias, nullptr, nullptr, grad_out, dp_sum,
+      activation_ptr, grad_query, grad_query_accum, grad_key, grad_value, seed,
+      dropout_prob, num_batches, num_heads, num_kv_heads, head_size,
+      num_queries, num_keys, head_scale, is_causal, window_size, alibi_slopes);
+}
+
+void fmha_backward_varlen_kernel_fp16(
+    sycl::queue& q, void* query, void* key, void* value, void* out,
+    int32_t* cu_seqlens_q, int32_t* cu_seqlens_k, void* grad_out,
+    void* dp_sum, void* activation_ptr, void* grad_query,
+    void* grad_query_accum, void* grad_key, void* grad_value, uint64_t seed,
+    float dropout_prob, uint32_t num_batches, uint32_t num_heads,
+    uint32_t num_kv_heads, uint32_t head_size, uint32_t max_seqlen_q,
+    uint32_t max_seqlen_k, float head_scale, bool is_causal,
+    uint32_t window_size, float* alibi_slopes) {
+  fmha_backward_kernel<fp16>(
+      q, query, key, value, out, nullptr, cu_seqlens_q, cu_seqlens_k,
+      grad_out, dp_sum, activation_ptr, grad_query, grad_query_accum,
+      grad_key, grad_value, seed, dropout_prob, num_batches, num_heads,
+      num_kv_heads, head_size, max_seqlen_q, max_seqlen_k, head_scale,
+      is_causal, window_size, alibi_slopes);
+}
+
+void fmha_backward_varlen_kernel_bf16(
+    sycl::queue& q, void* query, void* key, void* value, void* out,
+    int32_t* cu_seqlens_q, int32_t* cu_seqlens_k, void* grad_out,
+    void* dp_sum, void* activation_ptr, void* grad_query,
+    void* grad_query_accum, void* grad_key, void* grad_value, uint64_t seed,
+    float dropout_prob, uint32_t num_batches, uint32_t num_heads,
+    uint32_t num_kv_heads, uint32_t head_size, uint32_t max_seqlen_q,
+    uint32_t max_seqlen_k, float head_scale, bool is_causal,
+    uint32_t window_size, float* alibi_slopes) {
+  fmha_backward_kernel<bf16>(
+      q, query, key, value, out, nullptr, cu_seqlens_q, cu_seqlens_k,
+      grad_out, dp_sum, activation_ptr, grad_query, grad_query_accum,
+      grad_key, grad_value, seed, dropout_prob, num_batches, num_heads,
+      num_kv_heads, head_size, max_seqlen_q, max_seqlen_k, head_scale,
+      is_causal, window_size, alibi_slopes);
 }
 
 #undef BOOL_SWITCH
+
+void paged_attention_decode_kernel_fp16(
+    sycl::queue& q, void* query, void* key_cache, void* value_cache,
+    int32_t* block_tables, int32_t* context_lens, void* out, uint32_t num_seqs,
+    uint32_t num_heads, uint32_t num_kv_heads, uint32_t head_size,
+    uint32_t block_size, uint32_t max_blocks_per_seq, float scale) {
+  paged_attention_decode<fp16>(
+      q, static_cast<fp16*>(query), static_cast<fp16*>(key_cache),
+      static_cast<fp16*>(value_cache), nullptr, nullptr, block_tables,
+      context_lens, static_cast<fp16*>(out), num_seqs, num_heads, num_kv_heads,
+      head_size, block_size, max_blocks_per_seq, scale);
+}
+
+void paged_attention_decode_kernel_bf16(
+    sycl::queue& q, void* query, void* key_cache, void* value_cache,
+    int32_t* block_tables, int32_t* context_lens, void* out, uint32_t num_seqs,
+    uint32_t num_heads, uint32_t num_kv_heads, uint32_t head_size,
+    uint32_t block_size, uint32_t max_blocks_per_seq, float scale) {
+  paged_attention_decode<bf16>(
+      q, static_cast<bf16*>(query), static_cast<bf16*>(key_cache),
+      static_cast<bf16*>(value_cache), nullptr, nullptr, block_tables,
+      context_lens, static_cast<bf16*>(out), num_seqs, num_heads, num_kv_heads,
+      head_size, block_size, max_blocks_per_seq, scale);
+}
+
+void paged_attention_decode_fp8_kernel_fp16(
+    sycl::queue& q, void* query, void* key_cache, void* value_cache,
+    bool is_e5m2, float* k_scales, float* v_scales, int32_t* block_tables,
+    int32_t* context_lens, void* out, uint32_t num_seqs, uint32_t num_heads,
+    uint32_t num_kv_heads, uint32_t head_size, uint32_t block_size,
+    uint32_t max_blocks_per_seq, float scale) {
+  paged_attention_decode_fp8<fp16>(
+      q, query, key_cache, value_cache, is_e5m2, k_scales, v_scales,
+      block_tables, context_lens, out, num_seqs, num_heads, num_kv_heads,
+      head_size, block_size, max_blocks_per_seq, scale);
+}
+
+void paged_attention_decode_fp8_kernel_bf16(
+    sycl::queue& q, void* query, void* key_cache, void* value_cache,
+    bool is_e5m2, float* k_scales, float* v_scales, int32_t* block_tables,
+    int32_t* context_lens, void* out, uint32_t num_seqs, uint32_t num_heads,
+    uint32_t num_kv_heads, uint32_t head_size, uint32_t block_size,
+    uint32_t max_blocks_per_seq, float scale) {
+  paged_attention_decode_fp8<bf16>(
+      q, query, key_cache, value_cache, is_e5m2, k_scales, v_scales,
+      block_tables, context_lens, out, num_seqs, num_heads, num_kv_heads,
+      head_size, block_size, max_blocks_per_seq, scale);
+}
+
 }  // namespace gpu::xetla
\ No newline at end of file
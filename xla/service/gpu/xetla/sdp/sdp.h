@@ -19,34 +19,151 @@ limitations under the License.
 
 namespace gpu::xetla {
 
+// Masks are computed in the kernels: is_causal masks the keys after every
+// query, a non-zero window_size the keys at least window_size positions before
+// it, and after it as well if not causal. alibi_slopes [N] adds
+// -slope * |key - query| to the scores of every head. When training,
+// activation_ptr [B, N, F] receives the logsumexp of every query row.
+//
+// The backward kernels recompute the probabilities from that logsumexp, they
+// must be given the is_causal, window_size and alibi_slopes of the forward.
 void fmha_forward_kernel_fp16(sycl::queue& q, void* query, void* key,
-                              void* value, void* bias, uint8_t* dropout,
+                              void* value, void* bias, uint64_t seed,
                               float dropout_prob, void* out,
                               void* activation_ptr, uint32_t num_batches,
-                              uint32_t num_heads, uint32_t head_size,
-                              uint32_t num_queries, uint32_t num_keys,
-                              float head_scale, bool is_training);
+                              uint32_t num_heads, uint32_t num_kv_heads,
+                              uint32_t head_size, uint32_t num_queries,
+                              uint32_t num_keys, float head_scale,
+                              bool is_training, bool is_causal = false,
+                              uint32_t window_size = 0,
+                              float* alibi_slopes = nullptr);
 
 void fmha_forward_kernel_bf16(sycl::queue& q, void* query, void* key,
-                              void* value, void* bias, uint8_t* dropout,
+                              void* value, void* bias, uint64_t seed,
                               float dropout_prob, void* out,
                               void* activation_ptr, uint32_t num_batches,
-                              uint32_t num_heads, uint32_t head_size,
-                              uint32_t num_queries, uint32_t num_keys,
-                              float head_scale, bool is_training);
+                              uint32_t num_heads, uint32_t num_kv_heads,
+                              uint32_t head_size, uint32_t num_queries,
+                              uint32_t num_keys, float head_scale,
+                              bool is_training, bool is_causal = false,
+                              uint32_t window_size = 0,
+                              float* alibi_slopes = nullptr);
+
+// fp32 inputs computed as TF32 on XMX with float accumulation, head_size must
+// be at most 128.
+void fmha_forward_kernel_fp32(sycl::queue& q, void* query, void* key,
+                              void* value, void* bias, uint64_t seed,
+                              float dropout_prob, void* out,
+                              void* activation_ptr, uint32_t num_batches,
+                              uint32_t num_heads, uint32_t num_kv_heads,
+                              uint32_t head_size, uint32_t num_queries,
+                              uint32_t num_keys, float head_scale,
+                              bool is_training, bool is_causal = false,
+                              uint32_t window_size = 0,
+                              float* alibi_slopes = nullptr);
+
+// Variable-length forward over packed sequences: query/out are
+// [total_q, N, H], key/value are [total_k, N_kv, H] and sequence b spans rows
+// [cu_seqlens[b], cu_seqlens[b + 1]). activation_ptr is [B, N, max_seqlen_q].
+void fmha_forward_varlen_kernel_fp16(
+    sycl::queue& q, void* query, void* key, void* value,
+    int32_t* cu_seqlens_q, int32_t* cu_seqlens_k, uint64_t seed,
+    float dropout_prob, void* out, void* activation_ptr, uint32_t num_batches,
+    uint32_t num_heads, uint32_t num_kv_heads, uint32_t head_size,
+    uint32_t max_seqlen_q, uint32_t max_seqlen_k, float head_scale,
+    bool is_training, bool is_causal = false, uint32_t window_size = 0,
+    float* alibi_slopes = nullptr);
+
+void fmha_forward_varlen_kernel_bf16(
+    sycl::queue& q, void* query, void* key, void* value,
+    int32_t* cu_seqlens_q, int32_t* cu_seqlens_k, uint64_t seed,
+    float dropout_prob, void* out, void* activation_ptr, uint32_t num_batches,
+    uint32_t num_heads, uint32_t num_kv_heads, uint32_t head_size,
+    uint32_t max_seqlen_q, uint32_t max_seqlen_k, float head_scale,
+    bool is_training, bool is_causal = false, uint32_t window_size = 0,
+    float* alibi_slopes = nullptr);
 
 void fmha_backward_kernel_fp16(
     sycl::queue& q, void* query, void* key, void* value, void* out, void* bias,
     void* grad_out, void* dp_sum, void* activation_ptr, void* grad_query,
-    void* grad_query_accum, void* grad_key, void* grad_value,
-    uint32_t num_batches, uint32_t num_heads, uint32_t head_size,
-    uint32_t num_queries, uint32_t num_keys, float head_scale);
+    void* grad_query_accum, void* grad_key, void* grad_value, uint64_t seed,
+    float dropout_prob, uint32_t num_batches, uint32_t num_heads,
+    uint32_t num_kv_heads, uint32_t head_size, uint32_t num_queries,
+    uint32_t num_keys, float head_scale, bool is_causal = false,
+    uint32_t window_size = 0, float* alibi_slopes = nullptr);
 
 void fmha_backward_kernel_bf16(
     sycl::queue& q, void* query, void* key, void* value, void* out, void* bias,
     void* grad_out, void* dp_sum, void* activation_ptr, void* grad_query,
-    void* grad_query_accum, void* grad_key, void* grad_value,
-    uint32_t num_batches, uint32_t num_heads, uint32_t head_size,
-    uint32_t num_queries, uint32_t num_keys, float head_scale);
+    void* grad_query_accum, void* grad_key, void* grad_value, uint64_t seed,
+    float dropout_prob, uint32_t num_batches, uint32_t num_heads,
+    uint32_t num_kv_heads, uint32_t head_size, uint32_t num_queries,
+    uint32_t num_keys, float head_scale, bool is_causal = false,
+    uint32_t window_size = 0, float* alibi_slopes = nullptr);
+
+// TF32 backward of fmha_forward_kernel_fp32, head_size must be at most 128.
+void fmha_backward_kernel_fp32(
+    sycl::queue& q, void* query, void* key, void* value, void* out, void* bias,
+    void* grad_out, void* dp_sum, void* activation_ptr, void* grad_query,
+    void* grad_query_accum, void* grad_key, void* grad_value, uint64_t seed,
+    float dropout_prob, uint32_t num_batches, uint32_t num_heads,
+    uint32_t num_kv_heads, uint32_t head_size, uint32_t num_queries,
+    uint32_t num_keys, float head_scale, bool is_causal = false,
+    uint32_t window_size = 0, float* alibi_slopes = nullptr);
+
+// Variable-length backward over packed sequences laid out as in
+// fmha_forward_varlen_kernel_*, grad_query_accum is [total_q, N, H] and
+// dp_sum is [B, N, max_seqlen_q].
+void fmha_backward_varlen_kernel_fp16(
+    sycl::queue& q, void* query, void* key, void* value, void* out,
+    int32_t* cu_seqlens_q, int32_t* cu_seqlens_k, void* grad_out,
+    void* dp_sum, void* activation_ptr, void* grad_query,
+    void* grad_query_accum, void* grad_key, void* grad_value, uint64_t seed,
+    float dropout_prob, uint32_t num_batches, uint32_t num_heads,
+    uint32_t num_kv_heads, uint32_t head_size, uint32_t max_seqlen_q,
+    uint32_t max_seqlen_k, float head_scale, bool is_causal = false,
+    uint32_t window_size = 0, float* alibi_slopes = nullptr);
+
+void fmha_backward_varlen_kernel_bf16(
+    sycl::queue& q, void* query, void* key, void* value, void* out,
+    int32_t* cu_seqlens_q, int32_t* cu_seqlens_k, void* grad_out,
+    void* dp_sum, void* activation_ptr, void* grad_query,
+    void* grad_query_accum, void* grad_key, void* grad_value, uint64_t seed,
+    float dropout_prob, uint32_t num_batches, uint32_t num_heads,
+    uint32_t num_kv_heads, uint32_t head_size, uint32_t max_seqlen_q,
+    uint32_t max_seqlen_k, float head_scale, bool is_causal = false,
+    uint32_t window_size = 0, float* alibi_slopes = nullptr);
+
+// Decodes one query token per sequence against a paged key/value cache.
+// query/out are [B, N, H], key_cache/value_cache are
+// [num_blocks, block_size, N_kv, H] and block_tables is
+// [B, max_blocks_per_seq].
+void paged_attention_decode_kernel_fp16(
+    sycl::queue& q, void* query, void* key_cache, void* value_cache,
+    int32_t* block_tables, int32_t* context_lens, void* out, uint32_t num_seqs,
+    uint32_t num_heads, uint32_t num_kv_heads, uint32_t head_size,
+    uint32_t block_size, uint32_t max_blocks_per_seq, float scale);
+
+void paged_attention_decode_kernel_bf16(
+    sycl::queue& q, void* query, void* key_cache, void* value_cache,
+    int32_t* block_tables, int32_t* context_lens, void* out, uint32_t num_seqs,
+    uint32_t num_heads, uint32_t num_kv_heads, uint32_t head_size,
+    uint32_t block_size, uint32_t max_blocks_per_seq, float scale);
+
+// Same with an E4M3 or E5M2 cache, k_scales and v_scales are the [N_kv] scales
+// it was quantized with.
+void paged_attention_decode_fp8_kernel_fp16(
+    sycl::queue& q, void* query, void* key_cache, void* value_cache,
+    bool is_e5m2, float* k_scales, float* v_scales, int32_t* block_tables,
+    int32_t* context_lens, void* out, uint32_t num_seqs, uint32_t num_heads,
+    uint32_t num_kv_heads, uint32_t head_size, uint32_t block_size,
+    uint32_t max_blocks_per_seq, float scale);
+
+void paged_attention_decode_fp8_kernel_bf16(
+    sycl::queue& q, void* query, void* key_cache, void* value_cache,
+    bool is_e5m2, float* k_scales, float* v_scales, int32_t* block_tables,
+    int32_t* context_lens, void* out, uint32_t num_seqs, uint32_t num_heads,
+    uint32_t num_kv_heads, uint32_t head_size, uint32_t block_size,
+    uint32_t max_blocks_per_seq, float scale);
 
 }  // namespace gpu::xetla
\ No newline at end of file
@@ -17,15 +17,19 @@ limitations under the License.
 
 #include "xla/service/gpu/xetla_gpu_fused_mha_runner.h"
 
+#include <string>
+
 #include <sycl/ext/oneapi/bfloat16.hpp>
 #include <sycl/half_type.hpp>
 
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "tsl/lib/monitoring/counter.h"
 #include "xla/layout_util.h"
 #include "xla/service/gpu/backend_configs.pb.h"
 #include "xla/service/gpu/stream_executor_util.h"
 #include "xla/service/gpu/xetla/sdp/sdp.h"
+#include "xla/service/onednn_util.h"
 #include "xla/shape_util.h"
 #include "xla/status_macros.h"
 #include "xla/stream_executor/sycl/sycl_stream.h"
@@ -41,6 +45,35 @@ namespace {
 using se::DeviceMemory;
 using se::DeviceMemoryBase;
 
+auto* xetla_fmha_unsupported_counter = tsl::monitoring::Counter<1>::New(
+    "/xla/service/gpu/xetla_fmha_unsupported",
+    "Number of fused MHA calls the XeTLA kernels could not run.", "reason");
+
+absl::Status FmhaUnsupported(absl::string_view reason,
+                             absl::string_view message) {
+  xetla_fmha_unsupported_counter->GetCell(std::string(reason))->IncrementBy(1);
+  return absl::UnimplementedError(message);
+}
+
+// fp32 runs as TF32 on XMX, which is only allowed when the user opted in as
+// for oneDNN convolutions. TF32 tiles need twice the shared local memory, so
+// they cover fewer head sizes.
+template <typename ElementType>
+absl::Status CheckFmhaSupported(int head_size) {
+  bool is_fp32 = std::is_same_v<ElementType, float>;
+  if (is_fp32 && GetFP32MathMode() != dnnl::fpmath_mode::tf32) {
+    return FmhaUnsupported(
+        "fp32", "Fused MHA with fp32 needs XLA_FP32_MATH_MODE=TF32");
+  }
+  int max_head_size = is_fp32 ? 128 : 256;
+  if (head_size > max_head_size) {
+    return FmhaUnsupported(
+        "head_size", absl::StrFormat("Fused MHA with head size %d exceeds %d",
+                                     head_size, max_head_size));
+  }
+  return absl::OkStatus();
+}
+
 template <typename ElementType, typename BiasType, typename OutputType>
 absl::Status RunFusedMHA(GpufMHAParams params, se::Stream* stream,
                          DeviceMemory<ElementType> lhs_bmm1_buffer,
@@ -52,12 +85,14 @@ absl::Status RunFusedMHA(GpufMHAParams params, se::Stream* stream,
                          DeviceMemoryBase scratch_memory,
                          DeviceMemoryBase activation_output, bool is_training) {
   sycl::queue* dpcpp_stream = se::gpu::AsGpuStreamValue(stream);
-  std::optional<double> dropout_rate;
+  // Dropout masks are generated in the kernels from the seed, the backward
+  // kernels regenerate the mask of the forward kernel from the same seed.
+  float dropout_rate = 0.0f;
   if (params.config->dropout_rate) {
-    dropout_rate = *params.config->dropout_rate;
-    VLOG(1) << "dropout_rate: " << *dropout_rate;
-    if (dropout_rate != 0) {
-      return Unimplemented("Unimplemented dropout");
+    dropout_rate = static_cast<float>(*params.config->dropout_rate);
+    VLOG(1) << "dropout_rate: " << dropout_rate;
+    if (dropout_rate < 0.0f || dropout_rate >= 1.0f) {
+      return InvalidArgument("Invalid dropout rate %f", dropout_rate);
     }
   }
 
@@ -67,10 +102,10 @@ absl::Status RunFusedMHA(GpufMHAParams params, se::Stream* stream,
     VLOG(1) << "scale: " << scale;
   }
 
-  std::optional<int64_t> seed;
+  uint64_t seed = 0;
   if (params.config->seed) {
-    seed = *params.config->seed;
-    VLOG(1) << "seed: " << *seed;
+    seed = static_cast<uint64_t>(*params.config->seed);
+    VLOG(1) << "seed: " << seed;
   }
 
   auto lhs_bmm1_desc = params.config->lhs_bmm1;
@@ -121,6 +156,13 @@ absl::Status RunFusedMHA(GpufMHAParams params, se::Stream* stream,
   int F = lhs_bmm1_dims[rank - 2];
   int H = lhs_bmm1_dims[rank - 1];
   int T = rhs_bmm1_dims[rank - 1];
+  // Grouped-query attention shares every K/V head between N / N_kv queries.
+  int N_kv = rhs_bmm1_dims[rank - 3];
+  if (N_kv <= 0 || N % N_kv != 0) {
+    return InvalidArgument("%d query heads can't share %d key/value heads", N,
+                           N_kv);
+  }
+  TF_RETURN_IF_ERROR(CheckFmhaSupported<ElementType>(H));
 
   auto lhs_bmm1_ptr = reinterpret_cast<void*>(lhs_bmm1_buffer.opaque());
   auto rhs_bmm1_ptr = reinterpret_cast<void*>(rhs_bmm1_buffer.opaque());
@@ -134,13 +176,18 @@ absl::Status RunFusedMHA(GpufMHAParams params, se::Stream* stream,
   if (std::is_same_v<ElementType, bfloat16>) {
     ::gpu::xetla::fmha_forward_kernel_bf16(
         *dpcpp_stream, lhs_bmm1_ptr, rhs_bmm1_ptr, rhs_bmm2_ptr, bias_ptr,
-        nullptr, 1.0f, output_ptr, activation_ptr, B, N, H, F, T, scale,
-        is_training);
+        seed, dropout_rate, output_ptr, activation_ptr, B, N, N_kv, H, F, T,
+        scale, is_training);
   } else if (std::is_same_v<ElementType, half>) {
     ::gpu::xetla::fmha_forward_kernel_fp16(
         *dpcpp_stream, lhs_bmm1_ptr, rhs_bmm1_ptr, rhs_bmm2_ptr, bias_ptr,
-        nullptr, 1.0f, output_ptr, activation_ptr, B, N, H, F, T, scale,
-        is_training);
+        seed, dropout_rate, output_ptr, activation_ptr, B, N, N_kv, H, F, T,
+        scale, is_training);
+  } else if (std::is_same_v<ElementType, float>) {
+    ::gpu::xetla::fmha_forward_kernel_fp32(
+        *dpcpp_stream, lhs_bmm1_ptr, rhs_bmm1_ptr, rhs_bmm2_ptr, bias_ptr,
+        seed, dropout_rate, output_ptr, activation_ptr, B, N, N_kv, H, F, T,
+        scale, is_training);
   } else {
     return Internal("Invalid MHA datatype");
   }
@@ -214,9 +261,13 @@ absl::Status RunXetlaGpuFMHA(
     case BF16:
       return RunGpuFMHAImpl<bfloat16, bfloat16, bfloat16>(params, stream,
                                                           scratch_buffer);
+    case F32:
+      return RunGpuFMHAImpl<float, float, float>(params, stream,
+                                                 scratch_buffer);
     default:
-      return absl::UnimplementedError(absl::StrFormat(
-          "Unimplemented fused MHA with %s", ToString(fmha_config)));
+      return FmhaUnsupported(
+          "dtype", absl::StrFormat("Unimplemented fused MHA with %s",
+                                   ToString(fmha_config)));
   }
   return absl::OkStatus();
 }
@@ -241,12 +292,14 @@ absl::Status RunFusedMHABackward(
     DeviceMemoryBase fwd_output_buffer, DeviceMemoryBase bias_buffer,
     DeviceMemoryBase scratch_memory) {
   sycl::queue* dpcpp_stream = se::gpu::AsGpuStreamValue(stream);
-  std::optional<double> dropout_rate;
+  // Dropout masks are generated in the kernels from the seed, the backward
+  // kernels regenerate the mask of the forward kernel from the same seed.
+  float dropout_rate = 0.0f;
   if (params.config->dropout_rate) {
-    dropout_rate = *params.config->dropout_rate;
-    VLOG(1) << "dropout_rate: " << *dropout_rate;
-    if (dropout_rate != 0) {
-      return Unimplemented("Unimplemented dropout");
+    dropout_rate = static_cast<float>(*params.config->dropout_rate);
+    VLOG(1) << "dropout_rate: " << dropout_rate;
+    if (dropout_rate < 0.0f || dropout_rate >= 1.0f) {
+      return InvalidArgument("Invalid dropout rate %f", dropout_rate);
     }
   }
 
@@ -256,10 +309,10 @@ absl::Status RunFusedMHABackward(
     VLOG(1) << "scale: " << scale;
   }
 
-  std::optional<int64_t> seed;
+  uint64_t seed = 0;
   if (params.config->seed) {
-    seed = *params.config->seed;
-    VLOG(1) << "seed: " << *seed;
+    seed = static_cast<uint64_t>(*params.config->seed);
+    VLOG(1) << "seed: " << seed;
   }
 
   auto bmm1_grad_gemm1_rhs_desc = params.config->bmm1_grad_gemm1_rhs;  // q
@@ -321,6 +374,12 @@ absl::Status RunFusedMHABackward(
   int F = bmm1_grad_gemm1_rhs_dims[2];
   int H = bmm1_grad_gemm1_rhs_dims[3];
   int T = bmm1_grad_gemm2_rhs_dims[2];
+  int N_kv = bmm1_grad_gemm2_rhs_dims[1];
+  if (N_kv <= 0 || N % N_kv != 0) {
+    return InvalidArgument("%d query heads can't share %d key/value heads", N,
+                           N_kv);
+  }
+  TF_RETURN_IF_ERROR(CheckFmhaSupported<ElementType>(H));
 
   auto q_ptr = reinterpret_cast<void*>(bmm1_grad_gemm1_rhs_buffer.opaque());
   auto k_ptr = reinterpret_cast<void*>(bmm1_grad_gemm2_rhs_buffer.opaque());
@@ -344,11 +403,18 @@ absl::Status RunFusedMHABackward(
   if (std::is_same_v<ElementType, bfloat16>) {
     ::gpu::xetla::fmha_backward_kernel_bf16(
         *dpcpp_stream, q_ptr, k_ptr, v_ptr, o_ptr, bias_ptr, do_ptr, dp_sum,
-        L_ptr, dq_ptr, dq_accum_ptr, dk_ptr, dv_ptr, B, N, H, F, T, scale);
+        L_ptr, dq_ptr, dq_accum_ptr, dk_ptr, dv_ptr, seed, dropout_rate, B, N,
+        N_kv, H, F, T, scale);
   } else if (std::is_same_v<ElementType, half>) {
     ::gpu::xetla::fmha_backward_kernel_fp16(
         *dpcpp_stream, q_ptr, k_ptr, v_ptr, o_ptr, bias_ptr, do_ptr, dp_sum,
-        L_ptr, dq_ptr, dq_accum_ptr, dk_ptr, dv_ptr, B, N, H, F, T, scale);
+        L_ptr, dq_ptr, dq_accum_ptr, dk_ptr, dv_ptr, seed, dropout_rate, B, N,
+        N_kv, H, F, T, scale);
+  } else if (std::is_same_v<ElementType, float>) {
+    ::gpu::xetla::fmha_backward_kernel_fp32(
+        *dpcpp_stream, q_ptr, k_ptr, v_ptr, o_ptr, bias_ptr, do_ptr, dp_sum,
+        L_ptr, dq_ptr, dq_accum_ptr, dk_ptr, dv_ptr, seed, dropout_rate, B, N,
+        N_kv, H, F, T, scale);
   } else {
     return Internal("Invalid MHA datatype");
   }
@@ -469,8 +535,11 @@ absl::Status RunXetlaGpuFMHABackward(
     case BF16:
       return RunGpuFMHABackwardImpl<bfloat16, bfloat16, bfloat16>(
           params, stream, scratch_buffer);
+    case F32:
+      return RunGpuFMHABackwardImpl<float, float, float>(params, stream,
+                                                         scratch_buffer);
     default:
-      return Unimplemented("Unimplemented fused MHA backward");
+      return FmhaUnsupported("dtype", "Unimplemented fused MHA backward");
   }
   return absl::OkStatus();
 }
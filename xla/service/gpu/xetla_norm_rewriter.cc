@@ -0,0 +1,436 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/gpu/xetla_norm_rewriter.h"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/layout_util.h"
+#include "xla/service/pattern_matcher.h"
+#include "xla/shape_util.h"
+#include "tsl/platform/errors.h"
+
+namespace xla {
+namespace gpu {
+
+namespace {
+namespace m = match;
+
+constexpr float kDefaultEpsilon = 1e-5f;
+
+bool IsRowMajorArray(const Shape& shape) {
+  return shape.IsArray() && shape.rank() >= 1 && shape.has_layout() &&
+         LayoutUtil::IsMonotonicWithDim0Major(shape.layout());
+}
+
+int64_t NumCols(const Shape& shape) {
+  return shape.dimensions(shape.rank() - 1);
+}
+
+// Returns the value of a scalar constant or of a broadcast of one.
+std::optional<double> GetScalarConstant(const HloInstruction* instr) {
+  if (instr->opcode() == HloOpcode::kBroadcast) instr = instr->operand(0);
+  if (instr->opcode() != HloOpcode::kConstant ||
+      !ShapeUtil::IsEffectiveScalar(instr->shape())) {
+    return std::nullopt;
+  }
+  return instr->literal().GetAsDouble(
+      std::vector<int64_t>(instr->shape().rank(), 0));
+}
+
+// Returns the operand of the reshapes and bitcasts adding or removing
+// dimensions of size 1 to `instr`, as left by statistics kept with a
+// dimension of size 1 like jnp.mean(x, keepdims=True).
+HloInstruction* SkipDegenerateReshapes(HloInstruction* instr) {
+  while ((instr->opcode() == HloOpcode::kReshape ||
+          instr->opcode() == HloOpcode::kBitcast) &&
+         ShapeUtil::InsertedOrDeleted1SizedDimensions(
+             instr->operand(0)->shape(), instr->shape())
+             .has_value()) {
+    instr = instr->mutable_operand(0);
+  }
+  return instr;
+}
+
+// Returns x if `instr` reduces x over its last dimension with `opcode`,
+// starting from `init`.
+HloInstruction* GetRowReduceOperand(HloInstruction* instr, HloOpcode opcode,
+                                    double init) {
+  if (instr->opcode() != HloOpcode::kReduce || instr->operand_count() != 2) {
+    return nullptr;
+  }
+  HloInstruction* x = instr->mutable_operand(0);
+  if (!IsRowMajorArray(x->shape()) || instr->dimensions().size() != 1 ||
+      instr->dimensions(0) != x->shape().rank() - 1) {
+    return nullptr;
+  }
+  std::optional<double> init_value = GetScalarConstant(instr->operand(1));
+  const HloInstruction* root = instr->to_apply()->root_instruction();
+  if (!init_value.has_value() || *init_value != init ||
+      root->opcode() != opcode ||
+      root->operand(0)->opcode() != HloOpcode::kParameter ||
+      root->operand(1)->opcode() != HloOpcode::kParameter) {
+    return nullptr;
+  }
+  return x;
+}
+
+// Returns s if `instr` broadcasts the row statistics s to `shape`.
+HloInstruction* GetRowBroadcastOperand(HloInstruction* instr,
+                                       const Shape& shape) {
+  if (instr->opcode() != HloOpcode::kBroadcast ||
+      !ShapeUtil::SameDimensions(instr->shape(), shape) ||
+      instr->dimensions().size() != shape.rank() - 1) {
+    return nullptr;
+  }
+  for (int64_t i = 0; i < shape.rank() - 1; ++i) {
+    if (instr->dimensions(i) != i) return nullptr;
+  }
+  return SkipDegenerateReshapes(instr->mutable_operand(0));
+}
+
+// Returns w if `instr` broadcasts the weights w along the last dimension of
+// `shape`.
+HloInstruction* GetColumnBroadcastOperand(HloInstruction* instr,
+                                          const Shape& shape) {
+  if (instr->opcode() != HloOpcode::kBroadcast ||
+      !ShapeUtil::SameDimensions(instr->shape(), shape) ||
+      instr->dimensions().size() != 1 ||
+      instr->dimensions(0) != shape.rank() - 1) {
+    return nullptr;
+  }
+  return instr->mutable_operand(0);
+}
+
+// Returns x if `instr` is the mean of x over its last dimension, the sum
+// multiplied by 1/n or divided by n.
+HloInstruction* GetRowMeanOperand(HloInstruction* instr) {
+  instr = SkipDegenerateReshapes(instr);
+  const bool is_divide = instr->opcode() == HloOpcode::kDivide;
+  if (!is_divide && instr->opcode() != HloOpcode::kMultiply) return nullptr;
+  for (int64_t i = 0; i < (is_divide ? 1 : 2); ++i) {
+    HloInstruction* x = GetRowReduceOperand(
+        SkipDegenerateReshapes(instr->mutable_operand(i)), HloOpcode::kAdd,
+        0.0);
+    std::optional<double> value = GetScalarConstant(instr->operand(1 - i));
+    if (x == nullptr || !value.has_value()) continue;
+    const double cols = NumCols(x->shape());
+    const double expected = is_divide ? cols : 1.0 / cols;
+    // 1/n is rounded to the type of the reduction.
+    const double tolerance =
+        instr->shape().element_type() == F32 ? 1e-6 : 1e-2;
+    if (std::abs(*value - expected) <= tolerance * expected) return x;
+  }
+  return nullptr;
+}
+
+// Returns a if `instr` is a * a.
+HloInstruction* GetSquareOperand(HloInstruction* instr) {
+  HloInstruction *a, *b;
+  if (!Match(instr, m::Multiply(m::Op(&a), m::Op(&b))) || a != b) {
+    return nullptr;
+  }
+  return a;
+}
+
+// Returns true if `instr` is x - broadcast(mean).
+bool IsCentered(HloInstruction* instr, const HloInstruction* x,
+                const HloInstruction* mean) {
+  HloInstruction *lhs, *broadcast;
+  return Match(instr, m::Subtract(m::Op(&lhs), m::Op(&broadcast))) &&
+         lhs == x && GetRowBroadcastOperand(broadcast, x->shape()) == mean;
+}
+
+// Returns true if `instr` is the variance of the rows of x with the given row
+// means, mean((x - mean)^2) or max(mean(x * x) - mean^2, 0).
+bool IsRowVariance(HloInstruction* instr, const HloInstruction* x,
+                   const HloInstruction* mean) {
+  if (HloInstruction* squared = GetRowMeanOperand(instr)) {
+    HloInstruction* centered = GetSquareOperand(squared);
+    if (centered != nullptr && IsCentered(centered, x, mean)) return true;
+  }
+  instr = SkipDegenerateReshapes(instr);
+  HloInstruction *diff, *zero;
+  if (Match(instr, m::MaximumAnyOrder(m::Op(&diff), m::Op(&zero))) &&
+      GetScalarConstant(zero) == 0.0) {
+    instr = SkipDegenerateReshapes(diff);
+  }
+  HloInstruction *mean_of_squares, *square_of_mean;
+  if (!Match(instr, m::Subtract(m::Op(&mean_of_squares),
+                                m::Op(&square_of_mean)))) {
+    return false;
+  }
+  HloInstruction* mean_operand =
+      GetSquareOperand(SkipDegenerateReshapes(square_of_mean));
+  if (mean_operand == nullptr ||
+      SkipDegenerateReshapes(mean_operand) != mean) {
+    return false;
+  }
+  HloInstruction* squared = GetRowMeanOperand(mean_of_squares);
+  return squared != nullptr && GetSquareOperand(squared) == x;
+}
+
+// Returns the variance v and sets `epsilon` if `instr` is rsqrt(v + epsilon).
+HloInstruction* GetRsqrtOperand(HloInstruction* instr, double* epsilon) {
+  HloInstruction *var, *eps;
+  if (!Match(instr, m::Rsqrt(m::AddAnyOrder(m::Op(&var), m::Op(&eps))))) {
+    return nullptr;
+  }
+  std::optional<double> value = GetScalarConstant(eps);
+  if (!value.has_value() || *value < 0) return nullptr;
+  *epsilon = *value;
+  return SkipDegenerateReshapes(var);
+}
+
+// Appends the factors of the product `instr`, looking through the multiplies
+// that are used only by it.
+void CollectFactors(HloInstruction* instr, bool is_root,
+                    std::vector<HloInstruction*>& factors) {
+  if (instr->opcode() == HloOpcode::kMultiply &&
+      (is_root || instr->user_count() == 1) && factors.size() < 3) {
+    CollectFactors(instr->mutable_operand(0), false, factors);
+    CollectFactors(instr->mutable_operand(1), false, factors);
+    return;
+  }
+  factors.push_back(instr);
+}
+
+struct NormMatch {
+  absl::string_view target;
+  // The rows and the weights: gamma and beta for the layer norm, gamma for
+  // the RMS norm and nothing for the softmax.
+  HloInstruction* x = nullptr;
+  std::vector<HloInstruction*> weights;
+  double epsilon = kDefaultEpsilon;
+};
+
+// Matches the norms, normalized * broadcast(gamma) (+ broadcast(beta)), where
+// normalized is x * broadcast(rstd) or (x - broadcast(mean)) * broadcast(rstd)
+// in any order of the factors.
+std::optional<NormMatch> MatchNorm(HloInstruction* instr) {
+  const Shape& shape = instr->shape();
+  NormMatch match;
+  HloInstruction* product = instr;
+  HloInstruction *lhs, *rhs;
+  if (Match(instr, m::Add(m::Op(&lhs), m::Op(&rhs)))) {
+    for (HloInstruction* bias : {lhs, rhs}) {
+      if (HloInstruction* beta = GetColumnBroadcastOperand(bias, shape)) {
+        match.target = kXetlaLayerNormCallTarget;
+        match.weights = {nullptr, beta};
+        product = bias == lhs ? rhs : lhs;
+        break;
+      }
+    }
+    if (match.target.empty() || product->user_count() != 1) {
+      return std::nullopt;
+    }
+  } else {
+    match.target = kXetlaRmsNormCallTarget;
+    match.weights = {nullptr};
+  }
+
+  std::vector<HloInstruction*> factors;
+  CollectFactors(product, /*is_root=*/true, factors);
+  if (factors.size() != 3) return std::nullopt;
+  HloInstruction* var = nullptr;
+  HloInstruction* normalized = nullptr;
+  for (HloInstruction* factor : factors) {
+    HloInstruction* operand;
+    if (var == nullptr &&
+        (operand = GetRowBroadcastOperand(factor, shape)) != nullptr &&
+        (var = GetRsqrtOperand(operand, &match.epsilon)) != nullptr) {
+      continue;
+    }
+    if (match.weights[0] == nullptr &&
+        (operand = GetColumnBroadcastOperand(factor, shape)) != nullptr) {
+      match.weights[0] = operand;
+      continue;
+    }
+    if (normalized != nullptr) return std::nullopt;
+    normalized = factor;
+  }
+  if (var == nullptr || match.weights[0] == nullptr || normalized == nullptr) {
+    return std::nullopt;
+  }
+
+  if (match.target == kXetlaRmsNormCallTarget) {
+    HloInstruction* squared = GetRowMeanOperand(var);
+    if (squared == nullptr || GetSquareOperand(squared) != normalized) {
+      return std::nullopt;
+    }
+    match.x = normalized;
+    return match;
+  }
+  HloInstruction *x, *broadcast;
+  if (!Match(normalized, m::Subtract(m::Op(&x), m::Op(&broadcast)))) {
+    return std::nullopt;
+  }
+  HloInstruction* mean = GetRowBroadcastOperand(broadcast, shape);
+  if (mean == nullptr || GetRowMeanOperand(mean) != x ||
+      !IsRowVariance(var, x, mean)) {
+    return std::nullopt;
+  }
+  match.x = x;
+  return match;
+}
+
+// Matches e / broadcast(sum(e)) with e = exp(x - broadcast(max(x))).
+std::optional<NormMatch> MatchSoftmax(HloInstruction* instr) {
+  HloInstruction *exp, *sum_broadcast, *x, *max_broadcast;
+  if (!Match(instr, m::Divide(m::Exp(&exp, m::Subtract(m::Op(&x),
+                                                       m::Op(&max_broadcast))),
+                              m::Op(&sum_broadcast)))) {
+    return std::nullopt;
+  }
+  HloInstruction* sum = GetRowBroadcastOperand(sum_broadcast, instr->shape());
+  HloInstruction* max = GetRowBroadcastOperand(max_broadcast, instr->shape());
+  if (sum == nullptr || max == nullptr ||
+      GetRowReduceOperand(sum, HloOpcode::kAdd, 0.0) != exp ||
+      GetRowReduceOperand(max, HloOpcode::kMaximum,
+                          -std::numeric_limits<double>::infinity()) != x) {
+    return std::nullopt;
+  }
+  NormMatch match;
+  match.target = kXetlaSoftmaxCallTarget;
+  match.x = x;
+  return match;
+}
+
+bool IsSupportedType(PrimitiveType type) {
+  return type == F32 || type == F16 || type == BF16;
+}
+
+bool IsConvertFromF32(const HloInstruction* instr) {
+  return instr->opcode() == HloOpcode::kConvert &&
+         (instr->shape().element_type() == F16 ||
+          instr->shape().element_type() == BF16) &&
+         instr->operand(0)->shape().element_type() == F32;
+}
+
+// Rewrites `instr` if it is the result of a norm or softmax.
+StatusOr<bool> TryRewrite(HloComputation* computation, HloInstruction* instr) {
+  // A pattern computed in F32 and converted to 16 bits is rewritten at the
+  // convert, which may then be fused as well.
+  if (instr->user_count() == 1 && IsConvertFromF32(instr->users()[0])) {
+    return false;
+  }
+  HloInstruction* root = instr;
+  if (IsConvertFromF32(instr)) {
+    if (instr->operand(0)->user_count() != 1) return false;
+    instr = instr->mutable_operand(0);
+  }
+  const Shape& shape = instr->shape();
+  if (!IsRowMajorArray(shape) || !IsSupportedType(shape.element_type()) ||
+      instr->HasControlDependencies() ||
+      ShapeUtil::ElementsIn(shape) > std::numeric_limits<int32_t>::max()) {
+    return false;
+  }
+  std::optional<NormMatch> match = MatchSoftmax(instr);
+  if (!match.has_value()) match = MatchNorm(instr);
+  if (!match.has_value()) return false;
+
+  // The converts of the rows to F32 and of the result back are fused only if
+  // they are in the same type, otherwise the F32 pattern is rewritten.
+  HloInstruction* x = match->x;
+  if (root != instr) {
+    if (x->opcode() == HloOpcode::kConvert &&
+        x->operand(0)->shape().element_type() ==
+            root->shape().element_type()) {
+      x = x->mutable_operand(0);
+    } else {
+      root = instr;
+    }
+  }
+  PrimitiveType type = root->shape().element_type();
+  if (!IsRowMajorArray(x->shape()) || x->shape().element_type() != type) {
+    return false;
+  }
+  for (const HloInstruction* weight : match->weights) {
+    PrimitiveType weight_type = weight->shape().element_type();
+    if (weight_type != match->weights[0]->shape().element_type() ||
+        (weight_type != type && weight_type != F32)) {
+      return false;
+    }
+  }
+
+  std::vector<HloInstruction*> operands = {x};
+  operands.insert(operands.end(), match->weights.begin(),
+                  match->weights.end());
+  HloInstruction* call =
+      computation->AddInstruction(HloInstruction::CreateCustomCall(
+          root->shape(), operands, match->target));
+  if (match->target != kXetlaSoftmaxCallTarget) {
+    call->set_raw_backend_config_string(absl::StrCat(match->epsilon));
+  }
+  call->set_metadata(root->metadata());
+  computation->parent()->SetAndUniquifyInstrName(
+      call, match->target == kXetlaLayerNormCallTarget ? "layer_norm"
+            : match->target == kXetlaRmsNormCallTarget ? "rms_norm"
+                                                       : "softmax");
+  TF_RETURN_IF_ERROR(computation->ReplaceInstruction(root, call));
+  return true;
+}
+
+}  // namespace
+
+bool IsCustomCallToXetlaNorm(const HloInstruction& hlo) {
+  if (hlo.opcode() != HloOpcode::kCustomCall) return false;
+  const std::string& target = hlo.custom_call_target();
+  return target == kXetlaLayerNormCallTarget ||
+         target == kXetlaRmsNormCallTarget ||
+         target == kXetlaLayerNormBackwardCallTarget ||
+         target == kXetlaRmsNormBackwardCallTarget ||
+         target == kXetlaSoftmaxCallTarget;
+}
+
+absl::StatusOr<float> GetXetlaNormEpsilon(const HloInstruction& hlo) {
+  const std::string& config = hlo.raw_backend_config_string();
+  if (config.empty()) return kDefaultEpsilon;
+  float epsilon;
+  if (!absl::SimpleAtof(config, &epsilon)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid norm epsilon: ", config));
+  }
+  return epsilon;
+}
+
+StatusOr<bool> XetlaNormRewriter::Run(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  bool any_changed = false;
+  for (HloComputation* computation :
+       module->MakeNonfusionComputations(execution_threads)) {
+    // The reductions and broadcasts of a rewritten pattern precede its result
+    // in post order, so the instructions removed by a rewrite were visited
+    // already.
+    for (HloInstruction* instr : computation->MakeInstructionPostOrder()) {
+      TF_ASSIGN_OR_RETURN(bool changed, TryRewrite(computation, instr));
+      any_changed |= changed;
+    }
+  }
+  return any_changed;
+}
+
+}  // namespace gpu
+}  // namespace xla
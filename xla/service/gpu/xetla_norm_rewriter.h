@@ -0,0 +1,88 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_GPU_XETLA_NORM_REWRITER_H_
+#define XLA_SERVICE_GPU_XETLA_NORM_REWRITER_H_
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/hlo_pass_interface.h"
+
+namespace xla {
+namespace gpu {
+
+// Custom calls normalizing the rows of x over its last dimension, see
+// xetla/norm/norm.h. The operands are
+//
+//   layer norm:          (x, gamma, beta)
+//   RMS norm:            (x, gamma)
+//   layer norm backward: (dy, x, gamma, mean, rstd)
+//   RMS norm backward:   (dy, x, gamma, rstd)
+//
+// where gamma and beta have the size of the last dimension and the type of x
+// or F32. The forward results are y, or the tuple (y, mean, rstd) of the layer
+// norm and (y, rstd) of the RMS norm, with f32 statistics of the shape of x
+// without its last dimension. The backward results are (dx, dgamma, dbeta,
+// workspace) and (dx, dgamma, workspace). The weight gradients are reduced in
+// the workspace, which needs 4 bytes per column and partial sum (2 partial
+// sums with dbeta); more partial sums spread the reduction over more work
+// groups. The backend config is epsilon as a decimal number, 1e-5 if empty.
+inline constexpr absl::string_view kXetlaLayerNormCallTarget =
+    "__xetla$layer_norm";
+inline constexpr absl::string_view kXetlaRmsNormCallTarget = "__xetla$rms_norm";
+inline constexpr absl::string_view kXetlaLayerNormBackwardCallTarget =
+    "__xetla$layer_norm_backward";
+inline constexpr absl::string_view kXetlaRmsNormBackwardCallTarget =
+    "__xetla$rms_norm_backward";
+
+// Custom call computing the softmax of its operand over the last dimension.
+inline constexpr absl::string_view kXetlaSoftmaxCallTarget = "__xetla$softmax";
+
+// Returns true for all the custom calls above.
+bool IsCustomCallToXetlaNorm(const HloInstruction& hlo);
+
+// Returns the epsilon in the backend config of a norm custom call.
+absl::StatusOr<float> GetXetlaNormEpsilon(const HloInstruction& hlo);
+
+// Replaces the layer norms, RMS norms and softmaxes over the last dimension of
+// row-major arrays by the row-wise kernels:
+//
+//   (x - mean(x)) * rsqrt(var(x) + eps) * gamma + beta -> layer-norm(x, ...)
+//   x * rsqrt(mean(x * x) + eps) * gamma               -> rms-norm(x, gamma)
+//   exp(x - max(x)) / sum(exp(x - max(x)))             -> softmax(x)
+//
+// where the reductions are over the last dimension and the row statistics are
+// broadcast back to x. The variance is matched as mean((x - mean(x))^2) or
+// max(mean(x * x) - mean(x)^2, 0). When the pattern converts F16 or BF16 rows
+// to F32 and its result back, the custom call reads and writes the 16-bit
+// rows directly. The backward custom calls are not matched, they are meant
+// for frameworks defining the gradients of these calls themselves.
+class XetlaNormRewriter : public HloModulePass {
+ public:
+  XetlaNormRewriter() = default;
+
+  absl::string_view name() const override { return "xetla-norm-rewriter"; }
+  StatusOr<bool> Run(
+      HloModule* module,
+      const absl::flat_hash_set<absl::string_view>& execution_threads) override;
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_GPU_XETLA_NORM_REWRITER_H_
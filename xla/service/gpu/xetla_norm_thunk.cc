@@ -0,0 +1,161 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/gpu/xetla_norm_thunk.h"
+
+#include <cstdint>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "xla/primitive_util.h"
+#include "xla/service/gpu/buffer_allocations.h"
+#include "xla/service/gpu/xetla/norm/norm.h"
+#include "xla/service/gpu/xetla_norm_rewriter.h"
+#include "xla/stream_executor/gpu/gpu_stream.h"
+
+namespace xla {
+namespace gpu {
+
+namespace {
+
+using ::gpu::xetla::NormDataType;
+
+absl::StatusOr<NormDataType> GetNormDataType(PrimitiveType type) {
+  switch (type) {
+    case F32:
+      return NormDataType::kF32;
+    case F16:
+      return NormDataType::kF16;
+    case BF16:
+      return NormDataType::kBF16;
+    default:
+      return absl::UnimplementedError(
+          absl::StrCat("Unsupported norm type ",
+                       primitive_util::LowercasePrimitiveTypeName(type)));
+  }
+}
+
+}  // namespace
+
+absl::StatusOr<XetlaNormThunk::NormKind> XetlaNormThunk::GetNormKind(
+    absl::string_view target) {
+  if (target == kXetlaLayerNormCallTarget) return NormKind::kLayerNorm;
+  if (target == kXetlaRmsNormCallTarget) return NormKind::kRmsNorm;
+  if (target == kXetlaLayerNormBackwardCallTarget) {
+    return NormKind::kLayerNormBackward;
+  }
+  if (target == kXetlaRmsNormBackwardCallTarget) {
+    return NormKind::kRmsNormBackward;
+  }
+  if (target == kXetlaSoftmaxCallTarget) return NormKind::kSoftmax;
+  return absl::InvalidArgumentError(
+      absl::StrCat("Not a norm custom call: ", target));
+}
+
+XetlaNormThunk::XetlaNormThunk(ThunkInfo thunk_info, NormKind kind,
+                               PrimitiveType type, PrimitiveType weight_type,
+                               int64_t rows, int64_t cols, float epsilon,
+                               std::vector<BufferAllocation::Slice> operands,
+                               std::vector<BufferAllocation::Slice> results)
+    : Thunk(Kind::kCustomCall, thunk_info),
+      kind_(kind),
+      type_(type),
+      weight_type_(weight_type),
+      rows_(rows),
+      cols_(cols),
+      epsilon_(epsilon),
+      operands_(std::move(operands)),
+      results_(std::move(results)) {}
+
+absl::Status XetlaNormThunk::ExecuteOnStream(const ExecuteParams& params) {
+  se::gpu::GpuStreamHandle stream = se::gpu::AsGpuStreamValue(params.stream);
+  const BufferAllocations& allocs = *params.buffer_allocations;
+  auto operand = [&](int i) {
+    return allocs.GetDeviceAddress(operands_[i]).opaque();
+  };
+  auto result = [&](int i) {
+    return allocs.GetDeviceAddress(results_[i]).opaque();
+  };
+  TF_ASSIGN_OR_RETURN(NormDataType type, GetNormDataType(type_));
+  NormDataType weight_type = type;
+  if (kind_ != NormKind::kSoftmax) {
+    TF_ASSIGN_OR_RETURN(weight_type, GetNormDataType(weight_type_));
+  }
+
+  bool supported = false;
+  switch (kind_) {
+    case NormKind::kLayerNorm: {
+      const bool has_stats = results_.size() == 3;
+      supported = ::gpu::xetla::layer_norm_forward_kernel(
+          *stream, type, weight_type, operand(0), operand(1), operand(2),
+          result(0), has_stats ? static_cast<float*>(result(1)) : nullptr,
+          has_stats ? static_cast<float*>(result(2)) : nullptr, rows_, cols_,
+          epsilon_);
+      break;
+    }
+    case NormKind::kRmsNorm: {
+      const bool has_stats = results_.size() == 2;
+      supported = ::gpu::xetla::rms_norm_forward_kernel(
+          *stream, type, weight_type, operand(0), operand(1), result(0),
+          has_stats ? static_cast<float*>(result(1)) : nullptr, rows_, cols_,
+          epsilon_);
+      break;
+    }
+    case NormKind::kLayerNormBackward:
+    case NormKind::kRmsNormBackward: {
+      const bool is_layer_norm = kind_ == NormKind::kLayerNormBackward;
+      const BufferAllocation::Slice& workspace = results_.back();
+      const size_t bytes_per_partial =
+          ::gpu::xetla::norm_backward_workspace_size(1, cols_, is_layer_norm) *
+          sizeof(float);
+      const int64_t num_partials = workspace.size() / bytes_per_partial;
+      if (num_partials < 1) {
+        return absl::InvalidArgumentError(absl::StrCat(
+            "Norm backward workspace of ", workspace.size(),
+            " bytes is smaller than one partial sum of ", bytes_per_partial,
+            " bytes"));
+      }
+      auto* workspace_ptr =
+          static_cast<float*>(allocs.GetDeviceAddress(workspace).opaque());
+      if (is_layer_norm) {
+        supported = ::gpu::xetla::layer_norm_backward_kernel(
+            *stream, type, weight_type, operand(0), operand(1), operand(2),
+            static_cast<const float*>(operand(3)),
+            static_cast<const float*>(operand(4)), result(0), result(1),
+            result(2), workspace_ptr, num_partials, rows_, cols_);
+      } else {
+        supported = ::gpu::xetla::rms_norm_backward_kernel(
+            *stream, type, weight_type, operand(0), operand(1), operand(2),
+            static_cast<const float*>(operand(3)), result(0), result(1),
+            workspace_ptr, num_partials, rows_, cols_);
+      }
+      break;
+    }
+    case NormKind::kSoftmax:
+      supported = ::gpu::xetla::softmax_forward_kernel(
+          *stream, type, operand(0), result(0), rows_, cols_);
+      break;
+  }
+  if (!supported) {
+    return absl::UnimplementedError(absl::StrCat(
+        "Unsupported norm weight type ",
+        primitive_util::LowercasePrimitiveTypeName(weight_type_), " for ",
+        primitive_util::LowercasePrimitiveTypeName(type_), " rows"));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace gpu
+}  // namespace xla
@@ -0,0 +1,71 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_GPU_XETLA_NORM_THUNK_H_
+#define XLA_SERVICE_GPU_XETLA_NORM_THUNK_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "xla/service/buffer_assignment.h"
+#include "xla/service/gpu/thunk.h"
+#include "xla/xla_data.pb.h"
+
+namespace xla {
+namespace gpu {
+
+// Thunk of the row-wise norm and softmax custom calls, see
+// xetla_norm_rewriter.h for their operands and results. Every row is
+// normalized by one work group of the kernels in xetla/norm.
+class XetlaNormThunk : public Thunk {
+ public:
+  enum class NormKind {
+    kLayerNorm,
+    kRmsNorm,
+    kLayerNormBackward,
+    kRmsNormBackward,
+    kSoftmax,
+  };
+
+  static absl::StatusOr<NormKind> GetNormKind(absl::string_view target);
+
+  // `operands` and `results` are the slices of the operands and of the
+  // elements of the result of the custom call. weight_type is the type of
+  // gamma and beta, ignored by the softmax.
+  XetlaNormThunk(ThunkInfo thunk_info, NormKind kind, PrimitiveType type,
+                 PrimitiveType weight_type, int64_t rows, int64_t cols,
+                 float epsilon, std::vector<BufferAllocation::Slice> operands,
+                 std::vector<BufferAllocation::Slice> results);
+
+  absl::Status ExecuteOnStream(const ExecuteParams& params) override;
+
+ private:
+  const NormKind kind_;
+  const PrimitiveType type_;
+  const PrimitiveType weight_type_;
+  const int64_t rows_;
+  const int64_t cols_;
+  const float epsilon_;
+  const std::vector<BufferAllocation::Slice> operands_;
+  const std::vector<BufferAllocation::Slice> results_;
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_GPU_XETLA_NORM_THUNK_H_
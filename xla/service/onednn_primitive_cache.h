@@ -0,0 +1,123 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_ONEDNN_PRIMITIVE_CACHE_H_
+#define XLA_SERVICE_ONEDNN_PRIMITIVE_CACHE_H_
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "tsl/platform/logging.h"
+#include "tsl/util/env_var.h"
+
+namespace xla {
+
+struct OneDnnPrimitiveCacheStats {
+  int64_t hits = 0;
+  int64_t misses = 0;
+  int64_t evictions = 0;
+  int64_t size = 0;
+  int64_t capacity = 0;
+};
+
+// Reads the capacity of oneDNN primitive caches from `env_var`, a capacity of
+// 0 disables caching.
+inline int64_t GetOneDnnPrimitiveCacheCapacity(const char* env_var,
+                                               int64_t default_capacity) {
+  int64_t capacity = default_capacity;
+  TF_CHECK_OK(tsl::ReadInt64FromEnvVar(env_var, default_capacity, &capacity));
+  return capacity < 0 ? 0 : capacity;
+}
+
+// Thread-safe bounded LRU cache of oneDNN primitives. Building a primitive
+// descriptor and a primitive costs tens of microseconds on the host, which is
+// paid again for every thunk execution without caching. Entries are shared so
+// that an entry evicted by one thread stays valid for the thread using it.
+template <typename T>
+class OneDnnPrimitiveCache {
+ public:
+  explicit OneDnnPrimitiveCache(int64_t capacity) : capacity_(capacity) {}
+
+  // Returns the cached entry for `key` and marks it as most recently used, or
+  // nullptr if there is no such entry.
+  std::shared_ptr<T> Find(const std::string& key) {
+    absl::MutexLock lock(&mu_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+      ++stats_.misses;
+      return nullptr;
+    }
+    ++stats_.hits;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->second;
+  }
+
+  // Inserts `value` for `key`, evicting the least recently used entries if
+  // the cache is full. Returns the entry that is cached for `key`.
+  std::shared_ptr<T> Insert(const std::string& key, std::shared_ptr<T> value) {
+    absl::MutexLock lock(&mu_);
+    if (capacity_ == 0) return value;
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      // Another thread created the same primitive concurrently.
+      lru_.splice(lru_.begin(), lru_, it->second);
+      return it->second->second;
+    }
+    while (static_cast<int64_t>(lru_.size()) >= capacity_) {
+      index_.erase(lru_.back().first);
+      lru_.pop_back();
+      ++stats_.evictions;
+    }
+    lru_.emplace_front(key, std::move(value));
+    index_[key] = lru_.begin();
+    return lru_.front().second;
+  }
+
+  // Fixed at construction, so unlike stats() it doesn't take the lock.
+  int64_t capacity() const { return capacity_; }
+
+  OneDnnPrimitiveCacheStats stats() const {
+    absl::MutexLock lock(&mu_);
+    OneDnnPrimitiveCacheStats stats = stats_;
+    stats.size = lru_.size();
+    stats.capacity = capacity_;
+    return stats;
+  }
+
+  void Clear() {
+    absl::MutexLock lock(&mu_);
+    index_.clear();
+    lru_.clear();
+  }
+
+ private:
+  using Entry = std::pair<std::string, std::shared_ptr<T>>;
+
+  const int64_t capacity_;
+  mutable absl::Mutex mu_;
+  std::list<Entry> lru_ ABSL_GUARDED_BY(mu_);
+  absl::flat_hash_map<std::string, typename std::list<Entry>::iterator> index_
+      ABSL_GUARDED_BY(mu_);
+  OneDnnPrimitiveCacheStats stats_ ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace xla
+
+#endif  // XLA_SERVICE_ONEDNN_PRIMITIVE_CACHE_H_
@@ -17,6 +17,7 @@ limitations under the License.
 #define XLA_SERVICE_ONEDNN_UTIL_H_
 
 #include <map>
+#include <mutex>  // NOLINT
 #include <string>
 #include <utility>
 #include <vector>
@@ -27,6 +28,9 @@ limitations under the License.
 #include "xla/stream_executor/gpu/gpu_types.h"
 
 namespace xla {
+
+namespace se = ::stream_executor;
+
 inline dnnl::memory::dims CalculateTFStrides(
     const dnnl::memory::dims& dims_tf_order) {
   CHECK_GT(dims_tf_order.size(), 0);
@@ -39,6 +43,8 @@ inline dnnl::memory::dims CalculateTFStrides(
 
 static dnnl::engine& FindOrCreateEngine(se::gpu::GpuStreamHandle stream) {
   static std::map<se::gpu::GpuStreamHandle, dnnl::engine> stream_engine_map;
+  static std::mutex mu;
+  std::lock_guard<std::mutex> lock(mu);
   auto iter = stream_engine_map.find(stream);
   if (iter != stream_engine_map.end()) return iter->second;
 
@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "xla/stream_executor/sycl/hw_info.h"
 
+#include <algorithm>
+#include <limits>
 #include <string>
 
 #define XE_MASK 0xff0
@@ -29,62 +31,81 @@ const int32_t XeHPC_no_xmx_id = 0xbd4;
 
 const int32_t ARC_id = 0x5600;
 
-bool IsXeHPC(const sycl::device* device_ptr) {
-  if (device_ptr == nullptr) {
-    auto platform_list = sycl::platform::get_platforms();
-    for (const auto& platform : platform_list) {
-      auto device_list = platform.get_devices();
-      for (const auto& device : device_list) {
-        if (device.is_gpu()) {
-          auto id =
-              device.get_info<sycl::ext::intel::info::device::device_id>();
-          if ((id & XE_MASK) == XeHPC_id || (id & XE_MASK) == XeHPC_id_2) {
-            return true;
-          }
+namespace {
+
+bool IsXeHPCId(uint32_t id) {
+  return (id & XE_MASK) == XeHPC_id || (id & XE_MASK) == XeHPC_id_2;
+}
+
+bool HasXMXId(uint32_t id) { return IsXeHPCId(id) && id != XeHPC_no_xmx_id; }
+
+bool IsARCId(uint32_t id) { return (id & ARC_MASK) == ARC_id; }
+
+uint32_t DeviceId(const sycl::device& device) {
+  return device.get_info<sycl::ext::intel::info::device::device_id>();
+}
+
+// Capabilities of the GPUs of the system. Walking the platforms and their
+// devices is slow, so it is done once and queries without a device are
+// answered from this table.
+struct HardwareInfo {
+  bool any_xehpc = false;
+  // Whether the first XeHPC GPU has XMX engines.
+  bool has_xmx = false;
+  bool any_arc = false;
+  uint64_t max_allocate_limit = std::numeric_limits<uint64_t>::max();
+  // Attributes of the first GPU.
+  uint32_t device_id = 0;
+  int eu_count = 0;
+  int hardware_threads_per_eu = 0;
+};
+
+const HardwareInfo& GetHardwareInfo() {
+  static const HardwareInfo* info = [] {
+    auto* info = new HardwareInfo;
+    bool first_gpu = true;
+    bool first_xehpc = true;
+    for (const auto& platform : sycl::platform::get_platforms()) {
+      for (const auto& device : platform.get_devices()) {
+        if (!device.is_gpu()) continue;
+        uint32_t id = DeviceId(device);
+        if (IsXeHPCId(id)) {
+          info->any_xehpc = true;
+          if (first_xehpc) info->has_xmx = HasXMXId(id);
+          first_xehpc = false;
         }
+        info->any_arc |= IsARCId(id);
+        info->max_allocate_limit = std::min(
+            info->max_allocate_limit,
+            device.get_info<sycl::info::device::max_mem_alloc_size>());
+        if (first_gpu) {
+          info->device_id = id;
+          info->eu_count = GetEUCount(&device);
+          info->hardware_threads_per_eu = device.get_info<
+              sycl::ext::intel::info::device::gpu_hw_threads_per_eu>();
+        }
+        first_gpu = false;
       }
     }
-  } else {
-    auto id = device_ptr->get_info<sycl::ext::intel::info::device::device_id>();
-    if ((id & XE_MASK) == XeHPC_id || (id & XE_MASK) == XeHPC_id_2) {
-      return true;
-    }
-  }
-  return false;
+    return info;
+  }();
+  return *info;
+}
+
+}  // namespace
+
+void InitHardwareInfo() { GetHardwareInfo(); }
+
+bool IsXeHPC(const sycl::device* device_ptr) {
+  if (device_ptr == nullptr) return GetHardwareInfo().any_xehpc;
+  return IsXeHPCId(DeviceId(*device_ptr));
 }
 
 // TODO(intel): use sycl api like `devices.has(sycl::aspect::ext_intel_matrix)`
 // instead of device id once compiler supports XMX query interface.
 bool HasXMX(const sycl::device* device_ptr) {
-  if (device_ptr == nullptr) {
-    auto platform_list = sycl::platform::get_platforms();
-    for (const auto& platform : platform_list) {
-      auto device_list = platform.get_devices();
-      for (const auto& device : device_list) {
-        if (device.is_gpu()) {
-          auto id =
-              device.get_info<sycl::ext::intel::info::device::device_id>();
-          if (IsXeHPC(&device)) {
-            if (id == XeHPC_no_xmx_id) {
-              return false;
-            } else {
-              return true;
-            }
-          }
-        }
-      }
-    }
-  } else {
-    auto id = device_ptr->get_info<sycl::ext::intel::info::device::device_id>();
-    if (IsXeHPC(device_ptr)) {
-      if (id == XeHPC_no_xmx_id) {
-        return false;
-      } else {
-        return true;
-      }
-    }
-  }
-  return false;
+  if (device_ptr == nullptr) return GetHardwareInfo().has_xmx;
+  return HasXMXId(DeviceId(*device_ptr));
 }
 
 bool IsXetlaHardwareSupport() {
@@ -95,44 +116,29 @@ bool IsXetlaHardwareSupport() {
 bool IsXeHPG(const sycl::device* device_ptr) { return IsARC(device_ptr); }
 
 bool IsARC(const sycl::device* device_ptr) {
-  if (device_ptr == nullptr) {
-    auto platform_list = sycl::platform::get_platforms();
-    for (const auto& platform : platform_list) {
-      auto device_list = platform.get_devices();
-      for (const auto& device : device_list) {
-        if (device.is_gpu()) {
-          auto id =
-              device.get_info<sycl::ext::intel::info::device::device_id>();
-          if ((id & ARC_MASK) == ARC_id) {
-            return true;
-          }
-        }
-      }
-    }
-  } else {
-    auto id = device_ptr->get_info<sycl::ext::intel::info::device::device_id>();
-    if ((id & ARC_MASK) == ARC_id) {
-      return true;
-    }
-  }
-  return false;
+  if (device_ptr == nullptr) return GetHardwareInfo().any_arc;
+  return IsARCId(DeviceId(*device_ptr));
 }
 
 uint64_t GetMaxAllocateLimitByte(sycl::device* device_ptr) {
-  uint64_t limit = std::numeric_limits<uint64_t>::max();
-  if (device_ptr == nullptr) {
-    auto platform_list = sycl::platform::get_platforms();
-    for (const auto& platform : platform_list) {
-      auto device_list = platform.get_devices();
-      for (const auto& device : device_list) {
-        if (device.is_gpu()) {
-          limit = std::min(
-              limit, device.get_info<sycl::info::device::max_mem_alloc_size>());
-        }
-      }
-    }
-  } else {
-    limit = device_ptr->get_info<sycl::info::device::max_mem_alloc_size>();
-  }
-  return limit;
+  if (device_ptr == nullptr) return GetHardwareInfo().max_allocate_limit;
+  return device_ptr->get_info<sycl::info::device::max_mem_alloc_size>();
+}
+
+int GetEUCount(const sycl::device* device_ptr) {
+  if (device_ptr == nullptr) return GetHardwareInfo().eu_count;
+  SYCLComputeResources resources;
+  SYCLGetComputeResources(*device_ptr, &resources);
+  return resources.eu_count;
+}
+
+int GetHardwareThreadsPerEU(const sycl::device* device_ptr) {
+  if (device_ptr == nullptr) return GetHardwareInfo().hardware_threads_per_eu;
+  return device_ptr
+      ->get_info<sycl::ext::intel::info::device::gpu_hw_threads_per_eu>();
+}
+
+uint32_t GetDeviceId(const sycl::device* device_ptr) {
+  if (device_ptr == nullptr) return GetHardwareInfo().device_id;
+  return DeviceId(*device_ptr);
 }
@@ -18,6 +18,11 @@ limitations under the License.
 
 #include "xla/stream_executor/sycl/sycl_gpu_runtime.h"
 
+// Enumerates the GPUs of the system once, so that the queries below answer
+// from a cached table when `device_ptr` is null. Called at platform init, it
+// is otherwise done by the first query.
+void InitHardwareInfo();
+
 bool IsXeHPC(const sycl::device* device_ptr = nullptr);
 
 bool IsXeHPG(const sycl::device* device_ptr = nullptr);
@@ -29,4 +34,16 @@ bool IsXetlaHardwareSupport();
 bool IsARC(const sycl::device* device_ptr = nullptr);
 
 uint64_t GetMaxAllocateLimitByte(sycl::device* device_ptr = nullptr);
+
+// Number of execution units (Xe vector engines) of the device, or of the first
+// GPU if `device_ptr` is null. Root devices in implicit scaling mode count the
+// execution units of all their tiles.
+int GetEUCount(const sycl::device* device_ptr = nullptr);
+
+// Number of hardware threads each execution unit can keep resident.
+int GetHardwareThreadsPerEU(const sycl::device* device_ptr = nullptr);
+
+// PCI device id of the device, or of the first GPU if `device_ptr` is null.
+// Returns 0 if there is no GPU.
+uint32_t GetDeviceId(const sycl::device* device_ptr = nullptr);
 #endif  // XLA_STREAM_EXECUTOR_SYCL_HW_INFO_H_
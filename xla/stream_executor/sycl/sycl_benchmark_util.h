@@ -0,0 +1,45 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_STREAM_EXECUTOR_SYCL_SYCL_BENCHMARK_UTIL_H_
+#define XLA_STREAM_EXECUTOR_SYCL_SYCL_BENCHMARK_UTIL_H_
+
+#include <cstdint>
+#include <utility>
+
+#include "xla/stream_executor/sycl/sycl_gpu_runtime.h"
+
+namespace stream_executor {
+namespace gpu {
+
+// Runs `enqueue`, which submits work to `stream`, waits for that work and
+// returns its device time in seconds, for benchmarks reporting manual times.
+template <typename F>
+double TimeOnStream(::sycl::queue* stream, F&& enqueue) {
+  ::sycl::event begin = SYCLGetTimedEventFromStream(stream);
+  std::forward<F>(enqueue)();
+  ::sycl::event end = SYCLGetTimedEventFromStream(stream);
+  end.wait();
+  uint64_t begin_ns =
+      begin.get_profiling_info<::sycl::info::event_profiling::command_end>();
+  uint64_t end_ns =
+      end.get_profiling_info<::sycl::info::event_profiling::command_end>();
+  return (end_ns - begin_ns) * 1e-9;
+}
+
+}  // namespace gpu
+}  // namespace stream_executor
+
+#endif  // XLA_STREAM_EXECUTOR_SYCL_SYCL_BENCHMARK_UTIL_H_
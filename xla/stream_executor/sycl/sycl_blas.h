@@ -56,6 +56,10 @@ class SYCLBlas : public blas::BlasSupport {
 
   TENSORFLOW_STREAM_EXECUTOR_GPU_BLAS_SUPPORT_OVERRIDES
 
+  // There is no BlasLt on SYCL. The patched cuBLASLt matmul thunk runs its
+  // GEMMs through xla::gpu::GemmPlan instead, the GEMM autotuner enumerates
+  // the oneDNN and XeTLA algorithms (xla::gpu::GetXetlaGemmAlgorithms) and
+  // oneDNN scratchpads are allocated from the scratch allocator of the thunk.
   gpu::BlasLt *GetBlasLt() override { return nullptr; }
 
  private:
@@ -19,21 +19,42 @@ limitations under the License.
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
-#include "xla/stream_executor/gpu/gpu_driver.h"
+#include "absl/strings/str_cat.h"
 #include "xla/stream_executor/gpu/gpu_collectives.h"
+#include "xla/stream_executor/gpu/gpu_driver.h"
+#include "xla/stream_executor/sycl/sycl_driver.h"
+#include "xla/stream_executor/sycl/sycl_gpu_runtime.h"
+#include "tsl/platform/logging.h"
 
 namespace stream_executor::gpu {
 
+// Collective memory is exportable with Level-Zero IPC handles, so that peers
+// can map it once when it is registered with a communicator.
 absl::StatusOr<void*> GpuCollectives::CollectiveMemoryAllocate(
     GpuContext* context, uint64_t bytes) {
-  return absl::UnimplementedError(
-      "Feature not supported on SYCL platform (CollectiveMemoryAllocate)");
+  if (bytes == 0) return nullptr;
+
+  void* ptr = nullptr;
+  SYCLError_t res = SYCLMallocIpc(context->device(), bytes, &ptr);
+  if (res != SYCL_SUCCESS) {
+    return absl::InternalError(
+        absl::StrCat("Failed to allocate ", bytes,
+                     " bytes of collective memory: ", ToString(res)));
+  }
+  VLOG(2) << "allocated " << ptr << " of " << bytes
+          << " bytes of collective memory";
+  return ptr;
 }
 
 absl::Status GpuCollectives::CollectiveMemoryDeallocate(GpuContext* context,
                                                         void* location) {
-  return absl::UnimplementedError(
-      "Feature not supported on SYCL platform (CollectiveMemoryDeallocate)");
+  SYCLError_t res = SYCLFreeIpc(location);
+  if (res != SYCL_SUCCESS) {
+    return absl::InternalError(absl::StrCat(
+        "Failed to deallocate collective memory: ", ToString(res)));
+  }
+  VLOG(2) << "deallocated collective memory at " << location;
+  return absl::OkStatus();
 }
 
 }  // namespace stream_executor::gpu
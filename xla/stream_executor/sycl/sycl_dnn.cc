@@ -27,6 +27,7 @@ limitations under the License.
 #include <optional>
 #include <string>
 #include <tuple>
+#include <unordered_map>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -39,9 +40,17 @@ limitations under the License.
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
+#include "absl/synchronization/mutex.h"
+#include "dnnl.hpp"       // NOLINT(build/include_subdir)
+#include "dnnl_sycl.hpp"  // NOLINT(build/include_subdir)
+#include "tsl/platform/statusor.h"
+#include "xla/service/onednn_primitive_cache.h"
+#include "xla/service/onednn_util.h"
 #include "xla/stream_executor/sycl/sycl_platform_id.h"
 #include "xla/stream_executor/dnn.h"
 #include "xla/stream_executor/gpu/gpu_executor.h"
+#include "xla/stream_executor/gpu/gpu_stream.h"
 #include "xla/stream_executor/gpu/gpu_timer.h"
 #include "xla/stream_executor/numeric_options.h"
 #include "xla/stream_executor/platform/initialize.h"
@@ -56,6 +65,217 @@ limitations under the License.
 namespace stream_executor {
 namespace gpu {
 
+namespace {
+
+absl::StatusOr<dnnl::memory::data_type> OneDnnDataType(
+    dnn::DataType element_type) {
+  switch (element_type) {
+    case dnn::DataType::kFloat:
+      return dnnl::memory::data_type::f32;
+    case dnn::DataType::kHalf:
+      return dnnl::memory::data_type::f16;
+    case dnn::DataType::kBF16:
+      return dnnl::memory::data_type::bf16;
+    case dnn::DataType::kInt8:
+      return dnnl::memory::data_type::s8;
+    default:
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Unsupported oneDNN data type ", static_cast<int>(element_type)));
+  }
+}
+
+// Dimensions in NC<spatial> order with the strides of the actual layout, so
+// that no reorder is needed whatever the layout of the batch is.
+dnnl::memory::desc OneDnnMemoryDesc(const dnn::BatchDescriptor& desc,
+                                    dnnl::memory::data_type type) {
+  return dnnl::memory::desc(desc.full_dims(dnn::DataLayout::kBatchDepthYX),
+                            type,
+                            desc.full_strides(dnn::DataLayout::kBatchDepthYX));
+}
+
+struct OneDnnPoolingParams {
+  dnnl::algorithm algorithm;
+  dnnl::memory::desc src_md;
+  dnnl::memory::desc dst_md;
+  dnnl::memory::dims strides;
+  dnnl::memory::dims kernel;
+  dnnl::memory::dims dilation;
+  dnnl::memory::dims padding_l;
+  dnnl::memory::dims padding_r;
+};
+
+absl::StatusOr<OneDnnPoolingParams> GetPoolingParams(
+    dnn::DataType element_type, const dnn::PoolingDescriptor& pooling,
+    const dnn::BatchDescriptor& input, const dnn::BatchDescriptor& output) {
+  OneDnnPoolingParams params;
+  switch (pooling.mode()) {
+    case dnn::PoolingMode::kMaximum:
+      params.algorithm = dnnl::algorithm::pooling_max;
+      break;
+    case dnn::PoolingMode::kAverage:
+      // Like cuDNN, padded elements are not counted in the average.
+      params.algorithm = dnnl::algorithm::pooling_avg_exclude_padding;
+      break;
+    default:
+      return absl::InvalidArgumentError("Unsupported pooling mode");
+  }
+  TF_ASSIGN_OR_RETURN(dnnl::memory::data_type type,
+                      OneDnnDataType(element_type));
+  params.src_md = OneDnnMemoryDesc(input, type);
+  params.dst_md = OneDnnMemoryDesc(output, type);
+
+  std::vector<int64_t> input_dims =
+      input.full_dims(dnn::DataLayout::kBatchDepthYX);
+  std::vector<int64_t> output_dims =
+      output.full_dims(dnn::DataLayout::kBatchDepthYX);
+  for (int i = 0; i < pooling.ndims(); ++i) {
+    int64_t kernel = pooling.window()[i];
+    int64_t stride = pooling.strides()[i];
+    int64_t padding = pooling.padding()[i];
+    params.kernel.push_back(kernel);
+    params.strides.push_back(stride);
+    params.dilation.push_back(0);
+    params.padding_l.push_back(padding);
+    // The padding is symmetric, except for the elements the last window
+    // leaves out, which oneDNN expects as a smaller right padding.
+    params.padding_r.push_back(std::max<int64_t>(
+        0, (output_dims[i + 2] - 1) * stride + kernel - input_dims[i + 2] -
+               padding));
+  }
+  return params;
+}
+
+// The data handles are set before every execution.
+dnnl::memory UnboundMemory(const dnnl::memory::desc& md,
+                           const dnnl::engine& engine) {
+  return dnnl::sycl_interop::make_memory(
+      md, engine, dnnl::sycl_interop::memory_kind::usm, DNNL_MEMORY_NONE);
+}
+
+std::string PoolingPrimitiveKey(GpuStreamHandle stream, bool backward,
+                                const OneDnnPoolingParams& params,
+                                const dnn::BatchDescriptor& input,
+                                const dnn::BatchDescriptor& output) {
+  const dnn::DataLayout layout = dnn::DataLayout::kBatchDepthYX;
+  return absl::StrCat(
+      absl::Hex(reinterpret_cast<uintptr_t>(stream)), "|",
+      backward ? "bwd" : "fwd", "|", static_cast<int>(params.algorithm), "|",
+      static_cast<int>(params.src_md.get_data_type()), "|",
+      absl::StrJoin(input.full_dims(layout), ","), ";",
+      absl::StrJoin(input.full_strides(layout), ","), "|",
+      absl::StrJoin(output.full_dims(layout), ","), ";",
+      absl::StrJoin(output.full_strides(layout), ","), "|",
+      absl::StrJoin(params.kernel, ","), ";",
+      absl::StrJoin(params.strides, ","), ";",
+      absl::StrJoin(params.padding_l, ","), ";",
+      absl::StrJoin(params.padding_r, ","));
+}
+
+// oneDNN pooling primitives with the memory objects bound to their arguments.
+// The backward pass of max pooling needs the positions of the maxima, which
+// the forward pass records in a workspace, so it runs the forward pass in
+// training mode first. `mu` serializes executions that rebind the data
+// handles.
+struct OneDnnPoolingPrimitive {
+  absl::Mutex mu;
+  dnnl::stream stream;
+  std::optional<dnnl::pooling_forward> forward;
+  std::optional<dnnl::pooling_backward> backward;
+  dnnl::memory src_memory;
+  dnnl::memory dst_memory;
+  dnnl::memory diff_src_memory;
+  dnnl::memory diff_dst_memory;
+  dnnl::memory workspace_memory;
+  std::unordered_map<int, dnnl::memory> forward_args;
+  std::unordered_map<int, dnnl::memory> backward_args;
+  // Scratch bytes for the recomputed forward output and the workspace.
+  size_t dst_size = 0;
+  size_t workspace_size = 0;
+};
+
+xla::OneDnnPrimitiveCache<OneDnnPoolingPrimitive>& PoolingPrimitiveCache() {
+  static auto* cache = new xla::OneDnnPrimitiveCache<OneDnnPoolingPrimitive>(
+      xla::GetOneDnnPrimitiveCacheCapacity("XLA_ONEDNN_POOLING_CACHE_CAPACITY",
+                                           /*default_capacity=*/256));
+  return *cache;
+}
+
+std::shared_ptr<OneDnnPoolingPrimitive> CreatePoolingPrimitive(
+    GpuStreamHandle stream_handle, bool backward,
+    const OneDnnPoolingParams& params) {
+  dnnl::engine& engine = xla::FindOrCreateEngine(stream_handle);
+  auto primitive = std::make_shared<OneDnnPoolingPrimitive>();
+  primitive->stream = dnnl::sycl_interop::make_stream(engine, *stream_handle);
+  auto forward_pd = dnnl::pooling_forward::primitive_desc(
+      engine,
+      backward ? dnnl::prop_kind::forward_training
+               : dnnl::prop_kind::forward_inference,
+      params.algorithm, params.src_md, params.dst_md, params.strides,
+      params.kernel, params.dilation, params.padding_l, params.padding_r);
+  primitive->src_memory = UnboundMemory(params.src_md, engine);
+  primitive->dst_memory = UnboundMemory(params.dst_md, engine);
+  if (!backward) {
+    primitive->forward.emplace(forward_pd);
+    primitive->forward_args = {{DNNL_ARG_SRC, primitive->src_memory},
+                               {DNNL_ARG_DST, primitive->dst_memory}};
+    return primitive;
+  }
+
+  auto backward_pd = dnnl::pooling_backward::primitive_desc(
+      engine, params.algorithm, params.src_md, params.dst_md, params.strides,
+      params.kernel, params.dilation, params.padding_l, params.padding_r,
+      forward_pd);
+  primitive->backward.emplace(backward_pd);
+  primitive->diff_src_memory =
+      UnboundMemory(backward_pd.diff_src_desc(), engine);
+  primitive->diff_dst_memory =
+      UnboundMemory(backward_pd.diff_dst_desc(), engine);
+  primitive->backward_args = {
+      {DNNL_ARG_DIFF_DST, primitive->diff_dst_memory},
+      {DNNL_ARG_DIFF_SRC, primitive->diff_src_memory}};
+  if (params.algorithm == dnnl::algorithm::pooling_max) {
+    primitive->forward.emplace(forward_pd);
+    primitive->workspace_memory =
+        UnboundMemory(forward_pd.workspace_desc(), engine);
+    primitive->forward_args = {
+        {DNNL_ARG_SRC, primitive->src_memory},
+        {DNNL_ARG_DST, primitive->dst_memory},
+        {DNNL_ARG_WORKSPACE, primitive->workspace_memory}};
+    primitive->backward_args.emplace(DNNL_ARG_WORKSPACE,
+                                     primitive->workspace_memory);
+    primitive->dst_size = params.dst_md.get_size();
+    primitive->workspace_size = forward_pd.workspace_desc().get_size();
+  }
+  return primitive;
+}
+
+absl::StatusOr<std::shared_ptr<OneDnnPoolingPrimitive>> FindOrCreatePooling(
+    Stream* stream, bool backward, dnn::DataType element_type,
+    const dnn::PoolingDescriptor& pooling, const dnn::BatchDescriptor& input,
+    const dnn::BatchDescriptor& output) {
+  TF_ASSIGN_OR_RETURN(OneDnnPoolingParams params,
+                      GetPoolingParams(element_type, pooling, input, output));
+  GpuStreamHandle stream_handle = AsGpuStreamValue(stream);
+  std::string key =
+      PoolingPrimitiveKey(stream_handle, backward, params, input, output);
+  std::shared_ptr<OneDnnPoolingPrimitive> primitive =
+      PoolingPrimitiveCache().Find(key);
+  if (primitive == nullptr) {
+    VLOG(2) << "Create oneDNN pooling primitive: " << key;
+    primitive = PoolingPrimitiveCache().Insert(
+        key, CreatePoolingPrimitive(stream_handle, backward, params));
+  }
+  return primitive;
+}
+
+// oneDNN buffers are aligned like the buffers XLA allocates.
+size_t AlignScratchOffset(size_t offset) {
+  constexpr size_t kAlignment = 256;
+  return (offset + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+}  // namespace
+
 OnednnSupport::OnednnSupport(GpuExecutor* parent) : parent_(parent) {}
 
 absl::Status OnednnSupport::Init() {
@@ -66,6 +286,66 @@ absl::StatusOr<stream_executor::dnn::VersionInfo> OnednnSupport::GetVersion() {
   return dnn::VersionInfo(0, 0, 0);
 }
 
+absl::Status OnednnSupport::DoPoolForward(
+    dnn::DataType element_type, Stream* stream,
+    const dnn::PoolingDescriptor& pooling_dimensions,
+    const dnn::BatchDescriptor& input_dimensions, DeviceMemoryBase input_data,
+    const dnn::BatchDescriptor& output_dimensions, DeviceMemoryBase output_data,
+    ScratchAllocator* workspace_allocator) {
+  TF_ASSIGN_OR_RETURN(
+      std::shared_ptr<OneDnnPoolingPrimitive> primitive,
+      FindOrCreatePooling(stream, /*backward=*/false, element_type,
+                          pooling_dimensions, input_dimensions,
+                          output_dimensions));
+  absl::MutexLock lock(&primitive->mu);
+  primitive->src_memory.set_data_handle(input_data.opaque());
+  primitive->dst_memory.set_data_handle(output_data.opaque());
+  primitive->forward->execute(primitive->stream, primitive->forward_args);
+  return absl::OkStatus();
+}
+
+absl::Status OnednnSupport::DoPoolBackward(
+    dnn::DataType element_type, Stream* stream,
+    const dnn::PoolingDescriptor& pooling_dimensions,
+    const dnn::BatchDescriptor& input_dimensions, DeviceMemoryBase input_data,
+    const dnn::BatchDescriptor& output_dimensions, DeviceMemoryBase output_data,
+    DeviceMemoryBase input_diff_data, DeviceMemoryBase output_diff_data,
+    ScratchAllocator* workspace_allocator) {
+  TF_ASSIGN_OR_RETURN(
+      std::shared_ptr<OneDnnPoolingPrimitive> primitive,
+      FindOrCreatePooling(stream, /*backward=*/true, element_type,
+                          pooling_dimensions, input_dimensions,
+                          output_dimensions));
+
+  // The recomputed forward output is only needed to produce the workspace,
+  // the output passed in is left untouched.
+  uint8_t* scratch = nullptr;
+  size_t workspace_offset = AlignScratchOffset(primitive->dst_size);
+  if (primitive->forward.has_value()) {
+    if (workspace_allocator == nullptr) {
+      return absl::InvalidArgumentError(
+          "Max pooling backward needs a workspace allocator");
+    }
+    TF_ASSIGN_OR_RETURN(
+        DeviceMemory<uint8_t> scratch_memory,
+        workspace_allocator->AllocateBytes(workspace_offset +
+                                           primitive->workspace_size));
+    scratch = static_cast<uint8_t*>(scratch_memory.opaque());
+  }
+
+  absl::MutexLock lock(&primitive->mu);
+  if (primitive->forward.has_value()) {
+    primitive->src_memory.set_data_handle(input_data.opaque());
+    primitive->dst_memory.set_data_handle(scratch);
+    primitive->workspace_memory.set_data_handle(scratch + workspace_offset);
+    primitive->forward->execute(primitive->stream, primitive->forward_args);
+  }
+  primitive->diff_dst_memory.set_data_handle(input_diff_data.opaque());
+  primitive->diff_src_memory.set_data_handle(output_diff_data.opaque());
+  primitive->backward->execute(primitive->stream, primitive->backward_args);
+  return absl::OkStatus();
+}
+
 }  // namespace gpu
 
 void initialize_onednn() {
@@ -66,10 +66,7 @@ class OnednnSupport : public dnn::DnnSupport {
                              DeviceMemoryBase input_data,
                              const dnn::BatchDescriptor& output_dimensions,
                              DeviceMemoryBase output_data,
-                             ScratchAllocator* workspace_allocator) override {
-    return absl::UnimplementedError(
-        "DnnSupport::DoPoolForward not implemented on this platform.");
-  }
+                             ScratchAllocator* workspace_allocator) override;
 
   absl::Status DoPoolBackward(dnn::DataType element_type, Stream* stream,
                               const dnn::PoolingDescriptor& pooling_dimensions,
@@ -79,10 +76,7 @@ class OnednnSupport : public dnn::DnnSupport {
                               DeviceMemoryBase output_data,
                               DeviceMemoryBase input_diff_data,
                               DeviceMemoryBase output_diff_data,
-                              ScratchAllocator* workspace_allocator) override {
-    return absl::UnimplementedError(
-        "DnnSupport::DoPoolBackward not implemented on this platform.");
-  }
+                              ScratchAllocator* workspace_allocator) override;
 
  private:
   GpuExecutor* parent_;  // Parent executor object. Not owned.
@@ -18,12 +18,16 @@ limitations under the License.
 #include <stdint.h>
 #include <stdlib.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 #include <map>
+#include <optional>
 #include <set>
 #include <string>
 #include <utility>
+#include <variant>
+#include <vector>
 
 #include "absl/base/casts.h"
 #include "absl/base/const_init.h"
@@ -35,16 +39,23 @@ limitations under the License.
 #include "absl/strings/str_format.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/synchronization/notification.h"
+#include "absl/types/span.h"
 #include "level_zero/ze_api.h"
 #include "tsl/platform/env.h"
 #include "tsl/platform/errors.h"
 #include "tsl/platform/logging.h"
 #include "tsl/platform/stacktrace.h"
 #include "tsl/platform/status.h"
+#include "tsl/platform/statusor.h"
 #include "tsl/platform/threadpool.h"
 #include "xla/stream_executor/gpu/gpu_driver.h"
 #include "xla/stream_executor/platform/port.h"
+#include "xla/stream_executor/sycl/sycl_driver.h"
 #include "xla/stream_executor/sycl/sycl_gpu_runtime.h"
+#include "xla/stream_executor/sycl/sycl_graph.h"
+#include "xla/stream_executor/sycl/sycl_kernel_args.h"
+#include "xla/stream_executor/sycl/sycl_module_loader.h"
+#include "xla/stream_executor/sycl/sycl_tracer.h"
 
 #define RETURN_IF_SYCL_RES_ERROR(expr, ...)                            \
   do {                                                                 \
@@ -60,27 +71,85 @@ namespace gpu {
 
 #define MSEC_IN_SEC 1000
 
-class GpuContext {
+namespace {
+
+// Creates the device pool and the default queues up front, so that the first
+// streams and allocations do not pay for them.
+static absl::Status InternalInit() {
+  SYCLError_t res = SYCLInitStreamPool();
+  if (res != SYCL_SUCCESS) {
+    return absl::InternalError(
+        absl::StrCat("failed to initialize the SYCL streams: ", ToString(res)));
+  }
+  return absl::OkStatus();
+}
+
+// PJRT creates and destroys events for every buffer definition and transfer,
+// so destroyed event wrappers are kept on a free list of their context and
+// reused by the next InitEvent.
+class EventPool {
  public:
-  GpuContext(sycl::device* d, sycl::context* c) : device_(d), context_(c) {}
+  static EventWrapper* Acquire(GpuContext* context) {
+    {
+      absl::MutexLock lock(&mu_);
+      auto it = pools().find(context);
+      if (it != pools().end() && !it->second.empty()) {
+        EventWrapper* event = it->second.back();
+        it->second.pop_back();
+        return event;
+      }
+    }
+    EventWrapper* event = new EventWrapper();
+    event->event = new sycl::event;
+    return event;
+  }
 
-  sycl::device* device() const { return device_; }
-  sycl::context* context() const { return context_; }
+  static void Release(GpuContext* context, EventWrapper* event) {
+    // Drops the reference to the runtime event so that it can be recycled.
+    *event->event = sycl::event();
+    event->queue = nullptr;
+    {
+      absl::MutexLock lock(&mu_);
+      auto& pool = pools()[context];
+      if (pool.size() < kMaxPooledEvents) {
+        pool.push_back(event);
+        return;
+      }
+    }
+    Delete(event);
+  }
 
-  // Disallow copying and moving.
-  GpuContext(GpuContext&&) = delete;
-  GpuContext(const GpuContext&) = delete;
-  GpuContext& operator=(GpuContext&&) = delete;
-  GpuContext& operator=(const GpuContext&) = delete;
+  static void Clear(GpuContext* context) {
+    std::vector<EventWrapper*> pool;
+    {
+      absl::MutexLock lock(&mu_);
+      auto it = pools().find(context);
+      if (it == pools().end()) return;
+      pool = std::move(it->second);
+      pools().erase(it);
+    }
+    for (EventWrapper* event : pool) Delete(event);
+  }
 
  private:
-  sycl::device* device_;
-  sycl::context* context_;
-};
+  static constexpr size_t kMaxPooledEvents = 1024;
 
-namespace {
+  static void Delete(EventWrapper* event) {
+    delete event->event;
+    delete event;
+  }
+
+  static std::map<GpuContext*, std::vector<EventWrapper*>>& pools()
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    static auto* per_context =
+        new std::map<GpuContext*, std::vector<EventWrapper*>>();
+    return *per_context;
+  }
+
+  static absl::Mutex mu_;
+};
 
-static absl::Status InternalInit() { return absl::OkStatus(); }
+/* static */ absl::Mutex EventPool::mu_{absl::kConstInit};
 
 }  // namespace
 /* static */ absl::Status GpuDriver::Init() {
@@ -122,88 +191,179 @@ static absl::Status InternalInit() { return absl::OkStatus(); }
   if (context == nullptr) {
     return;
   }
+  EventPool::Clear(context);
   delete context;
 }
 
+namespace {
+
+SYCLGraph* AsSYCLGraph(GpuGraphHandle graph) {
+  return const_cast<SYCLGraph*>(static_cast<const SYCLGraph*>(graph));
+}
+
+SYCLGraphExec* AsSYCLGraphExec(GpuGraphExecHandle exec) {
+  return const_cast<SYCLGraphExec*>(static_cast<const SYCLGraphExec*>(exec));
+}
+
+SYCLGraphNode* AsSYCLGraphNode(GpuGraphNodeHandle node) {
+  return const_cast<SYCLGraphNode*>(static_cast<const SYCLGraphNode*>(node));
+}
+
+std::vector<const SYCLGraphNode*> AsSYCLGraphNodes(
+    absl::Span<const GpuGraphNodeHandle> deps) {
+  std::vector<const SYCLGraphNode*> nodes;
+  nodes.reserve(deps.size());
+  for (GpuGraphNodeHandle dep : deps) {
+    nodes.push_back(static_cast<const SYCLGraphNode*>(dep));
+  }
+  return nodes;
+}
+
+// Kernel arguments are either passed packed in `extra` as {args, &num_args}
+// device pointers (see GpuExecutor::Launch), or as an array of pointers to
+// argument values in `kernel_params` (see GpuCommandBuffer::Launch), which are
+// sized from the arguments recorded when the kernel was loaded.
+absl::StatusOr<std::vector<SYCLKernelArg>> UnpackKernelArgs(
+    sycl::kernel* function, void** kernel_params, void** extra) {
+  if (extra != nullptr) {
+    return PackPointerKernelArgs(
+        absl::MakeConstSpan(static_cast<void* const*>(extra[0]),
+                            static_cast<size_t*>(extra[1])[0]));
+  }
+  return PackKernelArgs(function, kernel_params);
+}
+
+absl::Status SetKernelNodeParams(
+    SYCLGraphNode* node, sycl::kernel* function, unsigned int grid_dim_x,
+    unsigned int grid_dim_y, unsigned int grid_dim_z, unsigned int block_dim_x,
+    unsigned int block_dim_y, unsigned int block_dim_z, void** kernel_params,
+    void** extra) {
+  TF_ASSIGN_OR_RETURN(node->args,
+                      UnpackKernelArgs(function, kernel_params, extra));
+  node->function = function;
+  node->global_range =
+      sycl::range<3>(block_dim_z * grid_dim_z, block_dim_y * grid_dim_y,
+                     block_dim_x * grid_dim_x);
+  node->local_range = sycl::range<3>(block_dim_z, block_dim_y, block_dim_x);
+  return absl::OkStatus();
+}
+
+}  // namespace
+
 /* static */ absl::Status GpuDriver::CreateGraph(GpuGraphHandle* graph) {
-  return absl::UnimplementedError(
-      "CreateGraph is not implemented");
+  *graph = new SYCLGraph();
+  VLOG(2) << "Created SYCL graph " << *graph;
+  return absl::OkStatus();
 }
 
 /* static */ absl::Status GpuDriver::DestroyGraph(GpuGraphHandle graph) {
-  return absl::UnimplementedError(
-      "DestroyGraph is not implemented");
+  VLOG(2) << "Destroy SYCL graph " << graph;
+  delete AsSYCLGraph(graph);
+  return absl::OkStatus();
 }
 
 /* static */ absl::Status GpuDriver::StreamBeginCapture(
     GpuStreamHandle stream, StreamCaptureMode mode) {
   return absl::UnimplementedError(
-      "StreamBeginCapture is not implemented");
+      "StreamBeginCapture without a target graph is not supported by SYCL, "
+      "use StreamBeginCaptureToGraph");
 }
 
 /* static */ absl::Status GpuDriver::StreamBeginCaptureToGraph(
     GpuStreamHandle stream, GpuGraphHandle graph, StreamCaptureMode mode) {
-  return absl::UnimplementedError(
-      "StreamBeginCaptureToGraph is not implemented");
+  VLOG(2) << "Beginning stream " << stream << " capture to SYCL graph "
+          << graph;
+  return AsSYCLGraph(graph)->BeginRecording(stream);
 }
 
 /* static */ absl::Status GpuDriver::StreamEndCapture(GpuStreamHandle stream,
                                                       GpuGraphHandle* graph) {
-  return absl::UnimplementedError(
-      "StreamEndCapture is not implemented");
+  VLOG(2) << "End stream " << stream << " capture to SYCL graph " << *graph;
+  if (*graph == nullptr) {
+    return absl::InternalError("SYCL stream capture has no target graph");
+  }
+  return AsSYCLGraph(*graph)->EndRecording(stream);
 }
 
 /* static */ absl::Status GpuDriver::GraphInstantiate(
     GpuGraphExecHandle* exec, GpuGraphHandle graph, const GraphInstantiateFlags& flags) {
-  return absl::UnimplementedError(
-      "GraphInstantiate is not implemented");
+  VLOG(2) << "Instantiate SYCL executable graph from graph " << graph;
+  // The sycl graph is finalized lazily on the first launch, when the target
+  // queue (and so the device) is known.
+  *exec = new SYCLGraphExec(AsSYCLGraph(graph));
+  return absl::OkStatus();
 }
 
 /* static */ absl::Status GpuDriver::GraphLaunch(GpuGraphExecHandle exec,
                                                  GpuStreamHandle stream) {
-  return absl::UnimplementedError(
-      "GraphLaunch is not implemented");
+  VLOG(2) << "Launching SYCL executable graph " << exec << " on a stream "
+          << stream;
+  return AsSYCLGraphExec(exec)->Launch(stream);
 }
 
 /* static */ absl::Status GpuDriver::GraphNodeSetEnabled(GpuGraphExecHandle exec,
                                                          GpuGraphNodeHandle node,
                                                          bool enabled) {
-  return absl::UnimplementedError(
-      "GraphNodeSetEnabled is not implemented");
+  VLOG(2) << "Set SYCL graph node " << node << " in " << exec
+          << " enabled=" << enabled;
+  return AsSYCLGraphExec(exec)->UpdateNode(
+      AsSYCLGraphNode(node), [&](SYCLGraphNode& sycl_node) {
+        sycl_node.enabled = enabled;
+        return absl::OkStatus();
+      });
 }
 
 /* static */ absl::Status GpuDriver::GraphExecUpdate(
     GpuGraphExecHandle exec, GpuGraphHandle graph, GraphExecUpdateResultInfo* result) {
-  return absl::UnimplementedError(
-      "GraphExecUpdate is not implemented");
+  VLOG(2) << "Update SYCL executable graph " << exec << " with graph "
+          << graph;
+  absl::Status status = AsSYCLGraphExec(exec)->Update(AsSYCLGraph(graph));
+  result->error_node = nullptr;
+  result->result = status.ok() ? GraphExecUpdateResult::kSuccess
+                               : GraphExecUpdateResult::kTopologyChanged;
+  return status;
 }
 
 /* static */ absl::StatusOr<GpuDriver::GraphNodeType>
 GpuDriver::GraphNodeGetType(GpuGraphNodeHandle node) {
-  return absl::UnimplementedError(
-      "GraphNodeGetType is not implemented");
+  switch (AsSYCLGraphNode(node)->kind) {
+    case SYCLGraphNodeKind::kEmpty:
+      return GraphNodeType::kEmpty;
+    case SYCLGraphNodeKind::kKernel:
+      return GraphNodeType::kKernel;
+    case SYCLGraphNodeKind::kMemcpy:
+      return GraphNodeType::kMemcpy;
+    case SYCLGraphNodeKind::kMemset:
+      return GraphNodeType::kMemset;
+    case SYCLGraphNodeKind::kChildGraph:
+      return GraphNodeType::kGraph;
+  }
+  return absl::InternalError("Invalid SYCL graph node type");
 }
 
 /* static */ absl::Status GpuDriver::DestroyGraphExec(GpuGraphExecHandle exec) {
-  return absl::UnimplementedError(
-      "DestroyGraphExec is not implemented");
+  VLOG(2) << "Destroying SYCL executable graph " << exec;
+  delete AsSYCLGraphExec(exec);
+  return absl::OkStatus();
 }
 
 /* static */ absl::StatusOr<std::string> GpuDriver::GraphDebugDotPrint(
     GpuGraphHandle graph, const char* path, bool return_printed_graph) {
-  return absl::UnimplementedError(
-      "GraphDebugDotPrint is not implemented");
+  VLOG(2) << "Print SYCL graph " << graph << " debug dot file to " << path;
+  std::string dot = AsSYCLGraph(graph)->ToDot();
+  TF_RETURN_IF_ERROR(tsl::WriteStringToFile(tsl::Env::Default(), path, dot));
+  if (return_printed_graph) return dot;
+  return std::string(path);
 }
 
 /* static */ absl::Status GpuDriver::DeviceGraphMemTrim(GpuDeviceHandle device) {
-  return absl::UnimplementedError(
-      "DeviceGraphMemTrim is not implemented");
+  // SYCL graphs don't own any memory pool, nothing to trim.
+  return absl::OkStatus();
 }
 
 /* static */ absl::StatusOr<bool> GpuDriver::StreamIsCapturing(
     GpuStreamHandle stream) {
-  return absl::UnimplementedError(
-      "StreamIsCapturing is not implemented");
+  return stream->ext_oneapi_get_state() == sycl_ext::queue_state::recording;
 }
 
 /* static */ absl::Status GpuDriver::GraphConditionalHandleCreate(
@@ -223,8 +383,10 @@ GpuDriver::GraphAddNode(GpuGraphNodeHandle* node, GpuGraphHandle graph,
 
 /* static */ absl::Status GpuDriver::GraphAddEmptyNode(
     GpuGraphNodeHandle* node, GpuGraphHandle graph, absl::Span<const GpuGraphNodeHandle> deps) {
-  return absl::UnimplementedError(
-      "GraphAddEmptyNode is not implemented");
+  *node = AsSYCLGraph(graph)->AddNode(SYCLGraphNodeKind::kEmpty,
+                                      AsSYCLGraphNodes(deps));
+  VLOG(2) << "Add empty node " << *node << " to a SYCL graph " << graph;
+  return absl::OkStatus();
 }
 
 /* static */ absl::Status GpuDriver::GraphAddKernelNode(
@@ -233,8 +395,17 @@ GpuDriver::GraphAddNode(GpuGraphNodeHandle* node, GpuGraphHandle graph,
     unsigned int grid_dim_y, unsigned int grid_dim_z, unsigned int block_dim_x,
     unsigned int block_dim_y, unsigned int block_dim_z,
     unsigned int shared_mem_bytes, void** kernel_params, void** extra) {
-  return absl::UnimplementedError(
-      "GraphAddKernelNode is not implemented");
+  VLOG(2) << "Add kernel node " << kernel_name << " to a SYCL graph " << graph
+          << "; gdx: " << grid_dim_x << " gdy: " << grid_dim_y
+          << " gdz: " << grid_dim_z << " bdx: " << block_dim_x
+          << " bdy: " << block_dim_y << " bdz: " << block_dim_z;
+  SYCLGraphNode* sycl_node = AsSYCLGraph(graph)->AddNode(
+      SYCLGraphNodeKind::kKernel, AsSYCLGraphNodes(deps));
+  TF_RETURN_IF_ERROR(SetKernelNodeParams(
+      sycl_node, function, grid_dim_x, grid_dim_y, grid_dim_z, block_dim_x,
+      block_dim_y, block_dim_z, kernel_params, extra));
+  *node = sycl_node;
+  return absl::OkStatus();
 }
 
 /*static*/ absl::Status GpuDriver::GraphExecKernelNodeSetParams(
@@ -243,8 +414,18 @@ GpuDriver::GraphAddNode(GpuGraphNodeHandle* node, GpuGraphHandle graph,
     unsigned int grid_dim_z, unsigned int block_dim_x, unsigned int block_dim_y,
     unsigned int block_dim_z, unsigned int shared_mem_bytes,
     void** kernel_params, void** extra) {
-  return absl::UnimplementedError(
-      "GraphExecKernelNodeSetParams is not implemented");
+  VLOG(2) << "Set kernel node " << node << " params in " << exec << ": "
+          << kernel_name;
+  return AsSYCLGraphExec(exec)->UpdateNode(
+      AsSYCLGraphNode(node), [&](SYCLGraphNode& sycl_node) {
+        if (sycl_node.kind != SYCLGraphNodeKind::kKernel) {
+          return absl::InternalError("SYCL graph node is not a kernel node");
+        }
+        return SetKernelNodeParams(&sycl_node, function, grid_dim_x,
+                                   grid_dim_y, grid_dim_z, block_dim_x,
+                                   block_dim_y, block_dim_z, kernel_params,
+                                   extra);
+      });
 }
 
 /*static*/ absl::Status GpuDriver::GraphAddMemAllocNode(
@@ -274,15 +455,31 @@ GpuDriver::GraphGetMemAllocNodeParams(GpuGraphNodeHandle node) {
     GpuContext* context, GpuGraphNodeHandle* node, GpuGraphHandle graph,
     absl::Span<const GpuGraphNodeHandle> deps, GpuDevicePtr gpu_dst, GpuDevicePtr gpu_src,
     uint64_t size) {
-  return absl::UnimplementedError(
-      "GraphAddMemcpyD2DNode is not implemented");
+  SYCLGraphNode* sycl_node = AsSYCLGraph(graph)->AddNode(
+      SYCLGraphNodeKind::kMemcpy, AsSYCLGraphNodes(deps));
+  sycl_node->dst = gpu_dst;
+  sycl_node->src = gpu_src;
+  sycl_node->size = size;
+  *node = sycl_node;
+  VLOG(2) << "Add memcpy d2d node " << *node << " to a SYCL graph " << graph
+          << "; dst: " << gpu_dst << "; src: " << gpu_src
+          << "; size: " << size;
+  return absl::OkStatus();
 }
 
 /* static */ absl::Status GpuDriver::GraphExecMemcpyD2DNodeSetParams(
     GpuContext* context, GpuGraphExecHandle exec, GpuGraphNodeHandle node,
     GpuDevicePtr gpu_dst, GpuDevicePtr gpu_src, uint64_t size) {
-  return absl::UnimplementedError(
-      "GraphExecMemcpyD2DNodeSetParams is not implemented");
+  return AsSYCLGraphExec(exec)->UpdateNode(
+      AsSYCLGraphNode(node), [&](SYCLGraphNode& sycl_node) {
+        if (sycl_node.kind != SYCLGraphNodeKind::kMemcpy) {
+          return absl::InternalError("SYCL graph node is not a memcpy node");
+        }
+        sycl_node.dst = gpu_dst;
+        sycl_node.src = gpu_src;
+        sycl_node.size = size;
+        return absl::OkStatus();
+      });
 }
 
 /* static */ absl::Status GpuDriver::GraphAddMemsetNode(
@@ -290,30 +487,57 @@ GpuDriver::GraphGetMemAllocNodeParams(GpuGraphNodeHandle node) {
     absl::Span<const GpuGraphNodeHandle> deps, GpuDevicePtr dst,
     std::variant<uint8_t, uint16_t, uint32_t> bit_pattern,
     uint64_t num_elements) {
-  return absl::UnimplementedError(
-      "GraphAddMemsetNode is not implemented");
+  SYCLGraphNode* sycl_node = AsSYCLGraph(graph)->AddNode(
+      SYCLGraphNodeKind::kMemset, AsSYCLGraphNodes(deps));
+  sycl_node->dst = dst;
+  sycl_node->bit_pattern = bit_pattern;
+  sycl_node->size = num_elements;
+  *node = sycl_node;
+  VLOG(2) << "Add memset node " << *node << " to a SYCL graph " << graph
+          << "; dst: " << dst << "; num_elements: " << num_elements;
+  return absl::OkStatus();
 }
 
 /* static */ absl::Status GpuDriver::GraphExecMemsetNodeSetParams(
     GpuContext* context, GpuGraphExecHandle exec, GpuGraphNodeHandle node, GpuDevicePtr dst,
     std::variant<uint8_t, uint16_t, uint32_t> bit_pattern,
     uint64_t num_elements) {
-  return absl::UnimplementedError(
-      "GraphExecMemsetNodeSetParams is not implemented");
+  return AsSYCLGraphExec(exec)->UpdateNode(
+      AsSYCLGraphNode(node), [&](SYCLGraphNode& sycl_node) {
+        if (sycl_node.kind != SYCLGraphNodeKind::kMemset) {
+          return absl::InternalError("SYCL graph node is not a memset node");
+        }
+        sycl_node.dst = dst;
+        sycl_node.bit_pattern = bit_pattern;
+        sycl_node.size = num_elements;
+        return absl::OkStatus();
+      });
 }
 
 /* static */ absl::Status GpuDriver::GraphAddChildNode(
     GpuGraphNodeHandle* node, GpuGraphHandle graph, absl::Span<const GpuGraphNodeHandle> deps,
     GpuGraphHandle child) {
-  return absl::UnimplementedError(
-      "GraphAddChildNode is not implemented");
+  SYCLGraphNode* sycl_node = AsSYCLGraph(graph)->AddNode(
+      SYCLGraphNodeKind::kChildGraph, AsSYCLGraphNodes(deps));
+  sycl_node->child = AsSYCLGraph(child);
+  *node = sycl_node;
+  VLOG(2) << "Add child node " << *node << " to a SYCL graph " << graph
+          << "; child graph: " << child;
+  return absl::OkStatus();
 }
 
 /*static*/ absl::Status GpuDriver::GraphExecChildNodeSetParams(GpuGraphExecHandle exec,
                                                                GpuGraphNodeHandle node,
                                                                GpuGraphHandle child) {
-  return absl::UnimplementedError(
-      "GraphExecChildNodeSetParams is not implemented");
+  return AsSYCLGraphExec(exec)->UpdateNode(
+      AsSYCLGraphNode(node), [&](SYCLGraphNode& sycl_node) {
+        if (sycl_node.kind != SYCLGraphNodeKind::kChildGraph) {
+          return absl::InternalError(
+              "SYCL graph node is not a child graph node");
+        }
+        sycl_node.child = AsSYCLGraph(child);
+        return absl::OkStatus();
+      });
 }
 
 /* static */ absl::Status GpuDriver::LaunchKernel(
@@ -333,9 +557,28 @@ GpuDriver::GraphGetMemAllocNodeParams(GpuGraphNodeHandle node) {
   sycl::nd_range<3> sycl_nd_range(
       sycl::nd_range<3>(sycl_global_range, sycl_local_range));
 
-  stream->submit([&](auto& cgh) {
-    for (uint32_t i = 0; i < static_cast<size_t*>(extra[1])[0]; i++) {
-      cgh.set_arg(i, static_cast<void**>(extra[0])[i]);
+  // Packed arguments, which GpuExecutor::Launch passes for every fusion, are
+  // set straight from the array of the caller.
+  if (extra != nullptr) {
+    absl::Span<void* const> args =
+        absl::MakeConstSpan(static_cast<void* const*>(extra[0]),
+                            static_cast<size_t*>(extra[1])[0]);
+    SyclActivityScope activity(stream, SyclActivityKind::kKernel, kernel_name);
+    stream->submit([&](sycl::handler& cgh) {
+      for (uint32_t i = 0; i < args.size(); i++) {
+        cgh.set_arg(i, args[i]);
+      }
+      cgh.parallel_for(sycl_nd_range, *function);
+    });
+    return absl::OkStatus();
+  }
+
+  TF_ASSIGN_OR_RETURN(std::vector<SYCLKernelArg> args,
+                      PackKernelArgs(function, kernel_params));
+  SyclActivityScope activity(stream, SyclActivityKind::kKernel, kernel_name);
+  stream->submit([&](sycl::handler& cgh) {
+    for (uint32_t i = 0; i < args.size(); i++) {
+      SetKernelArg(cgh, i, args[i]);
     }
     cgh.parallel_for(sycl_nd_range, *function);
   });
@@ -377,32 +620,19 @@ GpuDriver::GraphGetMemAllocNodeParams(GpuGraphNodeHandle node) {
     ze_module_handle_t* ze_module) {
   const sycl::context* sycl_context = context->context();
   const sycl::device* sycl_device = context->device();
-  auto ze_device =
-      sycl::get_native<sycl::backend::ext_oneapi_level_zero>(*sycl_device);
-  auto ze_context =
-      sycl::get_native<sycl::backend::ext_oneapi_level_zero>(*sycl_context);
-
-  ze_module_desc_t moduleDesc = {ZE_STRUCTURE_TYPE_MODULE_DESC,
-                                 nullptr,
-                                 ZE_MODULE_FORMAT_IL_SPIRV,
-                                 size,
-                                 (const uint8_t*)spir_contents,
-                                 nullptr,
-                                 nullptr};
-
-  ze_module_build_log_handle_t buildlog;
-  ze_result_t status =
-      zeModuleCreate(ze_context, ze_device, &moduleDesc, ze_module, &buildlog);
-  if (status != 0) {
-    size_t szLog = 0;
-    zeModuleBuildLogGetString(buildlog, &szLog, nullptr);
 
-    std::unique_ptr<char> PLogs(new char[szLog]);
-    zeModuleBuildLogGetString(buildlog, &szLog, PLogs.get());
-    std::string PLog(PLogs.get());
-    LOG(FATAL) << "L0 error " << status << ": " << PLog;
+  if (std::optional<ze_module_handle_t> module =
+          TakePrecompiledModule(*sycl_device, spir_contents, size)) {
+    *ze_module = *module;
+    return absl::OkStatus();
   }
 
+  absl::StatusOr<ze_module_handle_t> module =
+      CompileLevelzeroModule(*sycl_context, *sycl_device, spir_contents, size);
+  if (!module.ok()) {
+    LOG(FATAL) << module.status().message();
+  }
+  *ze_module = *module;
   return absl::OkStatus();
 }
 
@@ -489,6 +719,8 @@ GpuDriver::GraphGetMemAllocNodeParams(GpuGraphNodeHandle node) {
 /* static */ absl::Status GpuDriver::AsynchronousMemsetUint8(
     GpuContext* context, void* location, uint8_t value, size_t uint32_count,
     sycl::queue* stream) {
+  SyclActivityScope activity(stream, SyclActivityKind::kMemset, "Memset",
+                             uint32_count);
   RETURN_IF_SYCL_RES_ERROR(
       SYCLMemsetD8Async(location, value, uint32_count, stream),
       "Failed to enqueue async memset operation");
@@ -498,6 +730,8 @@ GpuDriver::GraphGetMemAllocNodeParams(GpuGraphNodeHandle node) {
 /* static */ absl::Status GpuDriver::AsynchronousMemsetUint32(
     GpuContext* context, void* location, uint32_t value, size_t uint32_count,
     sycl::queue* stream) {
+  SyclActivityScope activity(stream, SyclActivityKind::kMemset, "Memset",
+                             uint32_count * sizeof(uint32_t));
   RETURN_IF_SYCL_RES_ERROR(
       SYCLMemsetD32Async(location, value, uint32_count, stream),
       "Failed to enqueue async memset operation");
@@ -506,14 +740,7 @@ GpuDriver::GraphGetMemAllocNodeParams(GpuGraphNodeHandle node) {
 
 /* static */ bool GpuDriver::CreateStream(GpuContext* context,
                                           sycl::queue** stream, int priority) {
-  SYCLError_t res;
-  if (priority == 0) {
-    res = SYCLCreateStream(context->device(), stream);
-  } else {
-    LOG(ERROR)
-        << "CreateStream with priority is not supported on SYCL platform";
-  }
-
+  SYCLError_t res = SYCLCreateStream(context->device(), stream, priority);
   if (res != SYCL_SUCCESS) {
     LOG(ERROR) << "could not allocate SYCL stream for context "
                << context->context() << ": " << ToString(res);
@@ -599,12 +826,42 @@ GpuDriver::GraphGetMemAllocNodeParams(GpuGraphNodeHandle node) {
           << context->context();
 }
 
+/* static */ absl::StatusOr<MemorySpace> GpuDriver::GetPointerMemorySpace(
+    GpuDevicePtr pointer) {
+  sycl::context* context;
+  RETURN_IF_SYCL_RES_ERROR(SYCLGetContext(&context),
+                           "Failed to get the SYCL context");
+  switch (sycl::get_pointer_type(pointer, *context)) {
+    case sycl::usm::alloc::device:
+    case sycl::usm::alloc::shared:
+      return MemorySpace::kDevice;
+    case sycl::usm::alloc::host:
+      return MemorySpace::kHost;
+    default:
+      return absl::InternalError(
+          absl::StrCat("Pointer ", absl::Hex(pointer),
+                       " is not a USM allocation of the SYCL context"));
+  }
+}
+
+/* static */ absl::Status GpuDriver::GetPointerAddressRange(GpuDevicePtr dptr,
+                                                          GpuDevicePtr* base,
+                                                          size_t* size) {
+  RETURN_IF_SYCL_RES_ERROR(SYCLGetPointerAddressRange(dptr, base, size),
+                           "Failed to get the address range of a pointer");
+  return absl::OkStatus();
+}
+
 /* static */ int GpuDriver::GetGpuStreamPriority(
     GpuContext* context, stream_executor::StreamPriority stream_priority) {
-  if (stream_priority == stream_executor::StreamPriority::Default) {
-    return 0;
+  switch (stream_priority) {
+    case stream_executor::StreamPriority::Highest:
+      return 1;
+    case stream_executor::StreamPriority::Lowest:
+      return -1;
+    default:
+      return 0;
   }
-  LOG(FATAL) << "GetGpuStreamPriority not implemented on SYCL platform";
 }
 
 /* static */ absl::Status GpuDriver::InitEvent(GpuContext* context,
@@ -614,9 +871,9 @@ GpuDriver::GraphGetMemAllocNodeParams(GpuGraphNodeHandle node) {
     LOG(FATAL) << "Event is wrongly initialized before using";
   }
 
-  *event_handle = new EventWrapper();
-  (*event_handle)->event = new sycl::event;
+  *event_handle = EventPool::Acquire(context);
   (*event_handle)->queue = nullptr;
+  (*event_handle)->timing = flags == EventFlags::kDefault;
 
   return absl::OkStatus();
 }
@@ -628,8 +885,7 @@ GpuDriver::GraphGetMemAllocNodeParams(GpuGraphNodeHandle node) {
                        "input event cannot be null"};
   }
 
-  delete (*event_handle)->event;
-  delete (*event_handle);
+  EventPool::Release(context, *event_handle);
   *event_handle = nullptr;
 
   return absl::OkStatus();
@@ -639,7 +895,10 @@ GpuDriver::GraphGetMemAllocNodeParams(GpuGraphNodeHandle node) {
                                                 GpuEventHandle event_handle,
                                                 GpuStreamHandle stream) {
   event_handle->queue = stream;
-  *(event_handle->event) = SYCLGetEventFromStream(stream);
+  // Only timed events need a barrier with timestamps of its own.
+  *(event_handle->event) = event_handle->timing
+                               ? SYCLGetTimedEventFromStream(stream)
+                               : SYCLGetLastEventFromStream(stream);
 
   return absl::OkStatus();
 }
@@ -675,11 +934,25 @@ GpuDriver::GraphGetMemAllocNodeParams(GpuGraphNodeHandle node) {
                                                  float* elapsed_milliseconds,
                                                  GpuEventHandle start,
                                                  GpuEventHandle stop) {
+  if (!IsQueueProfilingEnabled()) {
+    // The events are profiling tags, which end when the stream reaches them.
+    uint64_t t_s = start->event->get_profiling_info<
+        sycl::info::event_profiling::command_end>();
+    uint64_t t_e = stop->event->get_profiling_info<
+        sycl::info::event_profiling::command_end>();
+    *elapsed_milliseconds =
+        static_cast<float>(static_cast<double>(t_e - t_s) / 1e6);
+    return true;
+  }
   ze_event_handle_t s_event =
       sycl::get_native<sycl::backend::ext_oneapi_level_zero>(*(start->event));
   ze_event_handle_t e_event =
       sycl::get_native<sycl::backend::ext_oneapi_level_zero>(*(stop->event));
-  zeEventHostSynchronize(e_event, UINT64_MAX);
+  // Like cuEventElapsedTime, the timestamps are only valid once the stop event
+  // completed, skip the host synchronization if it already did.
+  if (zeEventQueryStatus(e_event) == ZE_RESULT_NOT_READY) {
+    zeEventHostSynchronize(e_event, UINT64_MAX);
+  }
   ze_kernel_timestamp_result_t start_timestamp{}, end_timestamp{};
   if (zeEventQueryKernelTimestamp(s_event, &start_timestamp) !=
           ZE_RESULT_SUCCESS ||
@@ -735,7 +1008,7 @@ GpuDriver::GraphGetMemAllocNodeParams(GpuGraphNodeHandle node) {
 
 /* static */ bool GpuDriver::IsStreamIdle(GpuContext* context,
                                           GpuStreamHandle stream) {
-  return true;
+  return SYCLIsStreamIdle(stream);
 }
 
 /* static */ absl::Status GpuDriver::SynchronousMemcpyD2H(GpuContext* context,
@@ -785,6 +1058,8 @@ GpuDriver::GraphGetMemAllocNodeParams(GpuGraphNodeHandle node) {
                                                    void* host_dst,
                                                    void* gpu_src, uint64_t size,
                                                    sycl::queue* stream) {
+  SyclActivityScope activity(stream, SyclActivityKind::kMemcpyD2H,
+                             "MemcpyD2H", size);
   SYCLError_t res = SYCLMemcpyDtoHAsync(host_dst, gpu_src, size, stream);
   if (res != SYCL_SUCCESS) {
     LOG(ERROR) << absl::StrFormat(
@@ -804,6 +1079,8 @@ GpuDriver::GraphGetMemAllocNodeParams(GpuGraphNodeHandle node) {
                                                    const void* host_src,
                                                    uint64_t size,
                                                    sycl::queue* stream) {
+  SyclActivityScope activity(stream, SyclActivityKind::kMemcpyH2D,
+                             "MemcpyH2D", size);
   SYCLError_t res = SYCLMemcpyHtoDAsync(gpu_dst, host_src, size, stream);
   if (res != SYCL_SUCCESS) {
     LOG(ERROR) << absl::StrFormat(
@@ -822,6 +1099,8 @@ GpuDriver::GraphGetMemAllocNodeParams(GpuGraphNodeHandle node) {
                                                    void* gpu_dst, void* gpu_src,
                                                    uint64_t size,
                                                    sycl::queue* stream) {
+  SyclActivityScope activity(stream, SyclActivityKind::kMemcpyD2D,
+                             "MemcpyD2D", size);
   SYCLError_t res = SYCLMemcpyDtoDAsync(gpu_dst, gpu_src, size, stream);
   if (res != SYCL_SUCCESS) {
     LOG(ERROR) << absl::StrFormat(
@@ -858,10 +1137,11 @@ GpuDriver::GraphGetMemAllocNodeParams(GpuGraphNodeHandle node) {
 
 /* static */ absl::StatusOr<int> GpuDriver::GetMultiprocessorCount(
     sycl::device* device) {
-  return device->template get_info<
-             sycl::ext::intel::info::device::gpu_subslices_per_slice>() *
-         device
-             ->template get_info<sycl::ext::intel::info::device::gpu_slices>();
+  // Summed over the tiles of a root device in implicit scaling mode.
+  SYCLComputeResources resources;
+  RETURN_IF_SYCL_RES_ERROR(SYCLGetComputeResources(*device, &resources),
+                           "Failed to get the compute resources of a device");
+  return resources.core_count;
 }
 
 /* static */ absl::StatusOr<int64_t> GpuDriver::GetMaxSharedMemoryPerCore(
@@ -899,6 +1179,33 @@ GpuDriver::GraphGetMemAllocNodeParams(GpuGraphNodeHandle node) {
   return true;
 }
 
+/* static */ bool GpuDriver::CanEnablePeerAccess(GpuContext* from,
+                                                 GpuContext* to) {
+  return CanEnablePeerAccess(from->device(), to->device());
+}
+
+/* static */ bool GpuDriver::CanEnablePeerAccess(GpuDeviceHandle from,
+                                                 GpuDeviceHandle to) {
+  bool can_access = false;
+  SYCLError_t res = SYCLCanAccessPeer(from, to, &can_access);
+  if (res != SYCL_SUCCESS) {
+    LOG(ERROR) << "failed to detect peer access capability: " << ToString(res);
+    return false;
+  }
+  return can_access;
+}
+
+/* static */ absl::Status GpuDriver::EnablePeerAccess(GpuContext* from,
+                                                     GpuContext* to) {
+  // All devices share the context of the device pool, in which the device
+  // memory of a peer is accessible as soon as the driver supports it.
+  if (!CanEnablePeerAccess(from, to)) {
+    return absl::FailedPreconditionError(
+        "Level-Zero reports no peer access between the devices");
+  }
+  return absl::OkStatus();
+}
+
 /* static */ bool GpuDriver::GetDeviceTotalMemory(sycl::device* device,
                                                   uint64_t* result) {
   *result = device->get_info<sycl::info::device::global_mem_size>();
@@ -908,16 +1215,37 @@ GpuDriver::GraphGetMemAllocNodeParams(GpuGraphNodeHandle node) {
 /* static */ absl::StatusOr<int> GpuDriver::GetMaxOccupiedBlocksPerCore(
     GpuContext* context, GpuFunctionHandle kernel, int threads_per_block,
     size_t dynamic_shared_memory_bytes) {
-  int max_blocks = 0;
-
-  SYCLError_t result = SYCL_SUCCESS;
-  // TODO(SYCL) implement this feature in HIP
+  const sycl::device* device = context->device();
+  SYCLKernelProperties properties;
+  SYCLError_t result = SYCLGetKernelProperties(*kernel, *device, &properties);
   if (result != SYCL_SUCCESS) {
     return absl::Status{
         absl::StatusCode::kInternal,
         absl::StrFormat("failed to calculate occupancy of kernel %p: %s",
                         kernel, ToString(result))};
   }
+  if (properties.max_subgroup_size == 0 || threads_per_block <= 0) return 0;
+
+  // A work group takes one hardware thread per sub-group, and large GRF
+  // kernels can only use half the threads of an Xe core.
+  namespace intel_info = sycl::ext::intel::info::device;
+  int threads_per_core =
+      device->get_info<intel_info::gpu_eu_count_per_subslice>() *
+      device->get_info<intel_info::gpu_hw_threads_per_eu>();
+  if (properties.registers_per_thread > 128) threads_per_core /= 2;
+  const int subgroups_per_block =
+      (threads_per_block + properties.max_subgroup_size - 1) /
+      properties.max_subgroup_size;
+  int max_blocks = threads_per_core / subgroups_per_block;
+
+  // Work groups resident on a core also share its shared local memory.
+  const size_t slm_per_block =
+      properties.local_mem_size + dynamic_shared_memory_bytes;
+  if (slm_per_block > 0) {
+    const size_t slm_per_core =
+        device->get_info<sycl::info::device::local_mem_size>();
+    max_blocks = std::min<int64_t>(max_blocks, slm_per_core / slm_per_block);
+  }
 
   return max_blocks;
 }
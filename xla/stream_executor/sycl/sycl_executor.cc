@@ -24,6 +24,7 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/container/inlined_vector.h"
 #include "absl/functional/any_invocable.h"
 #include "absl/status/status.h"
 #include "absl/strings/ascii.h"
@@ -39,6 +40,7 @@ limitations under the License.
 #include "tsl/util/env_var.h"
 #include "tsl/platform/fingerprint.h"
 // #include "xla/stream_executor/kernel_cache_config.h"
+#include "xla/layout.h"
 #include "xla/stream_executor/platform.h"
 #include "xla/stream_executor/platform/initialize.h"
 // #include "xla/stream_executor/platform/logging.h"
@@ -49,6 +51,7 @@ limitations under the License.
 #include "xla/stream_executor/sycl/hw_info.h"
 #include "xla/stream_executor/sycl/sycl_event.h"
 #include "xla/stream_executor/sycl/sycl_gpu_runtime.h"
+#include "xla/stream_executor/sycl/sycl_kernel_args.h"
 #include "xla/stream_executor/sycl/sycl_platform_id.h"
 #include "xla/stream_executor/sycl/sycl_stream.h"
 #include "xla/stream_executor/plugin_registry.h"
@@ -145,11 +148,13 @@ absl::Status GpuExecutor::GetKernel(const MultiKernelLoaderSpec& spec,
   GpuKernel* l0_kernel = AsGpuKernel(kernel);
   ze_module_handle_t module = nullptr;
   string kernel_name;
+  const char* spirv = nullptr;
+  int size = 0;
 
   if (spec.has_cuda_cubin_in_memory()) {
     kernel_name = spec.cuda_cubin_in_memory().kernel_name();
-    const char* spirv = spec.cuda_cubin_in_memory().bytes();
-    int size = spec.cuda_cubin_in_memory().size();
+    spirv = spec.cuda_cubin_in_memory().bytes();
+    size = spec.cuda_cubin_in_memory().size();
     absl::MutexLock lock{&in_memory_modules_mu_};
     TF_RETURN_IF_ERROR(LoadModuleFromSpir(spirv, size, &module));
     kernel_to_gpu_binary_[kernel] = spirv;
@@ -163,15 +168,26 @@ absl::Status GpuExecutor::GetKernel(const MultiKernelLoaderSpec& spec,
   TF_RETURN_IF_ERROR(GpuDriver::GetModuleFunction(
       context_, module, kernel_name.c_str(), l0_kernel->gpu_function_ptr()));
 
+  // Arguments passed by address, e.g. by command buffers, are copied by value
+  // and need the signature of the kernel.
+  absl::StatusOr<std::vector<SYCLKernelArgInfo>> args =
+      GetSpirvKernelArgs(absl::MakeConstSpan(spirv, size), kernel_name);
+  if (args.ok()) {
+    RegisterKernelArgs(*l0_kernel->gpu_function_ptr(), *std::move(args));
+  } else {
+    VLOG(1) << "No arguments of kernel " << kernel_name << ": "
+            << args.status();
+  }
+
   // We have to trust the kernel loader spec arity because there doesn't
   // appear to be a way to reflect on the number of expected arguments w/the
   // SPIR API.
   l0_kernel->set_arity(spec.arity());
 
+  kernel->set_name(kernel_name);
   KernelMetadata kernel_metadata;
   TF_RETURN_IF_ERROR(GetKernelMetadata(l0_kernel, &kernel_metadata));
   kernel->set_metadata(kernel_metadata);
-  kernel->set_name(kernel_name);
   return absl::OkStatus();
 }
 
@@ -194,6 +210,7 @@ bool GpuExecutor::UnloadGpuBinary(const void* gpu_binary) {
 
 void GpuExecutor::UnloadKernel(const Kernel* kernel) {
   VLOG(3) << "Unloading kernel " << kernel << " : " << kernel->name();
+  UnregisterKernelArgs(AsGpuKernel(kernel)->AsGpuFunctionHandle());
 
   absl::MutexLock lock{&in_memory_modules_mu_};
   auto gpu_binary_it = kernel_to_gpu_binary_.find(kernel);
@@ -297,13 +314,38 @@ GpuExecutor::CreateOrShareConstant(Stream* stream,
 
 absl::Status GpuExecutor::GetKernelMetadata(GpuKernel* l0_kernel,
                                            KernelMetadata* kernel_metadata) {
-  int value = 0;
-  // TODO: implement this feature in SPIR
-  kernel_metadata->set_registers_per_thread(value);
-  kernel_metadata->set_shared_memory_bytes(value);
+  SYCLKernelProperties properties;
+  SYCLError_t result = SYCLGetKernelProperties(
+      *l0_kernel->AsGpuFunctionHandle(), *device_, &properties);
+  if (result != SYCL_SUCCESS) {
+    return absl::InternalError(
+        absl::StrFormat("failed to get properties of kernel %s: %s",
+                        l0_kernel->name(), ToString(result)));
+  }
+  VLOG(2) << "Kernel " << l0_kernel->name()
+          << ": registers_per_thread=" << properties.registers_per_thread
+          << " local_mem_size=" << properties.local_mem_size
+          << " private_mem_size=" << properties.private_mem_size
+          << " spill_mem_size=" << properties.spill_mem_size
+          << " max_subgroup_size=" << properties.max_subgroup_size
+          << " max_num_subgroups=" << properties.max_num_subgroups;
+  if (properties.spill_mem_size > 0) {
+    VLOG(1) << "Kernel " << l0_kernel->name() << " spills "
+            << properties.spill_mem_size << " bytes of registers per thread";
+  }
+  kernel_metadata->set_registers_per_thread(properties.registers_per_thread);
+  kernel_metadata->set_shared_memory_bytes(properties.local_mem_size);
   return absl::OkStatus();
 }
 
+namespace {
+
+// Kernel arguments kept inline by GpuExecutor::Launch before falling back to
+// the heap.
+constexpr int kInlinedKernelArgs = 16;
+
+}  // namespace
+
 absl::Status GpuExecutor::Launch(Stream* stream, const ThreadDim& thread_dims,
                                  const BlockDim& block_dims,
                                  const ClusterDim& cluster_dims,
@@ -336,9 +378,11 @@ absl::Status GpuExecutor::Launch(Stream* stream, const ThreadDim& thread_dims,
   if (!packed_args)
     return absl::InternalError("Unsupported kernel arguments type");
 
-  std::vector<void*> kernargs;
-  for (const void *const arg: packed_args->argument_addresses()) {
-    kernargs.push_back(reinterpret_cast<void*>(*static_cast<const uint64_t*>(arg)));
+  // XLA fusions take a handful of device pointers, keep them on the stack.
+  absl::Span<const void* const> addresses = packed_args->argument_addresses();
+  absl::InlinedVector<void*, kInlinedKernelArgs> kernargs(addresses.size());
+  for (size_t i = 0; i < addresses.size(); ++i) {
+    kernargs[i] = *static_cast<void* const*>(addresses[i]);
   }
   size_t size = kernargs.size();
   void* config[] = {kernargs.data(), &size};
@@ -351,15 +395,29 @@ absl::Status GpuExecutor::Launch(Stream* stream, const ThreadDim& thread_dims,
 
 absl::Status GpuExecutor::Submit(Stream* stream,
                                 const CommandBuffer& command_buffer) {
-  LOG(FATAL) << "Submit is not implemented in sycl_executor";
+  if (command_buffer.mode() != CommandBuffer::Mode::kPrimary) {
+    return absl::InvalidArgumentError(
+        "Can't submit non-primary command buffer for execution");
+  }
+
+  auto exec = GpuCommandBuffer::Cast(&command_buffer)->executable();
+  VLOG(3) << "Launch command buffer executable graph " << exec
+          << " on a stream: " << stream->DebugStreamString();
+  return GpuDriver::GraphLaunch(exec, AsGpuStreamValue(stream));
 }
 
 DeviceMemoryBase GpuExecutor::Allocate(uint64_t size, int64_t memory_space) {
+  // XLA places offloaded activations and host resident parameters in the host
+  // memory space.
+  if (memory_space == xla::Layout::kHostMemorySpace) {
+    return DeviceMemoryBase(GpuDriver::HostAllocate(context_, size), size);
+  }
   CHECK_EQ(memory_space, 0);
   return DeviceMemoryBase(GpuDriver::DeviceAllocate(context_, size), size);
 }
 
 void GpuExecutor::Deallocate(DeviceMemoryBase* mem) {
+  // SYCL frees host and device USM allocations alike.
   GpuDriver::DeviceDeallocate(context_, mem->opaque());
 }
 
@@ -563,7 +621,7 @@ void GpuExecutor::DeallocateStream(Stream* stream) {
 bool GpuExecutor::CreateStreamDependency(Stream* dependent, Stream* other) {
   // For thread safe, event should be thread local.
   auto* other_queue = AsGpuStreamValue(other);
-  auto event = SYCLGetEventFromStream(other_queue);
+  auto event = SYCLGetLastEventFromStream(other_queue);
 
   EventWrapper event_wrapper;
   event_wrapper.event = &event;
@@ -618,11 +676,13 @@ fft::FftSupport* GpuExecutor::CreateFft() {
 }
 
 bool GpuExecutor::CanEnablePeerAccessTo(StreamExecutorInterface* other) {
-  return false;
+  GpuExecutor* sycl_other = static_cast<GpuExecutor*>(other);
+  return GpuDriver::CanEnablePeerAccess(context_, sycl_other->context_);
 }
 
 absl::Status GpuExecutor::EnablePeerAccessTo(StreamExecutorInterface* other) {
-  LOG(FATAL) << "Peer access is not supported on SYCL platform";
+  GpuExecutor* sycl_other = static_cast<GpuExecutor*>(other);
+  return GpuDriver::EnablePeerAccess(context_, sycl_other->context_);
 }
 
 bool GpuExecutor::DeviceMemoryUsage(int64_t* free, int64_t* total) const {
@@ -686,12 +746,15 @@ absl::StatusOr<std::unique_ptr<Kernel>> GpuExecutor::CreateKernel() {
 
 absl::StatusOr<std::unique_ptr<CommandBuffer>> GpuExecutor::CreateCommandBuffer(
     CommandBuffer::Mode mode) {
-  return absl::UnimplementedError("CreateCommandBuffer is not implemented for SYCL");
+  VLOG(2) << "Create SYCL command buffer (SYCL graph)";
+  GpuGraphHandle graph = nullptr;
+  TF_RETURN_IF_ERROR(GpuDriver::CreateGraph(&graph));
+  return std::make_unique<GpuCommandBuffer>(mode, /*parent=*/this, graph);
 }
 
 std::unique_ptr<GpuCommandBuffer> GpuExecutor::CreateCommandBuffer(
     CommandBuffer::Mode mode, GpuGraphHandle graph, bool is_owned_graph) {
-  VLOG(2) << "Create HIP command buffer (HIP graph) from existing graph "
+  VLOG(2) << "Create SYCL command buffer (SYCL graph) from existing graph "
           << graph << "; is_owned_graph=" << is_owned_graph;
   return std::make_unique<GpuCommandBuffer>(mode, /*parent=*/this, graph,
                                             is_owned_graph);
@@ -702,10 +765,17 @@ void* GpuExecutor::platform_specific_context() { return context_; }
 GpuContext* GpuExecutor::gpu_context() { return context_; }
 
 int fpus_per_core(const GpuDeviceHandle& device) {
-  int eu_count_per_slice =
-      device->template get_info<sycl::ext::intel::info::device::gpu_eu_count>();
-  int core_count = GpuDriver::GetMultiprocessorCount(device).value();
-  int eu_count_per_core = eu_count_per_slice / core_count;
+  int eu_count_per_core = 0;
+  SYCLComputeResources resources;
+  if (SYCLGetComputeResources(*device, &resources) == SYCL_SUCCESS &&
+      resources.core_count > 0) {
+    eu_count_per_core = resources.eu_count / resources.core_count;
+  } else if (device->has(
+                 sycl::aspect::ext_intel_gpu_eu_count_per_subslice)) {
+    // The per-tile value of the device, which is the same for all its tiles.
+    eu_count_per_core = device->template get_info<
+        sycl::ext::intel::info::device::gpu_eu_count_per_subslice>();
+  }
 
   // operations/EU/clk
   int n = 0;
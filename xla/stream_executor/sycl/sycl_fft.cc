@@ -17,6 +17,13 @@ limitations under the License.
 
 #include "xla/stream_executor/sycl/sycl_fft.h"
 
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/base/const_init.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
 #include "xla/stream_executor/gpu/gpu_executor.h"
 #include "xla/stream_executor/gpu/gpu_helpers.h"
 #include "xla/stream_executor/gpu/gpu_stream.h"
@@ -178,352 +185,190 @@ void SYCLFft::UpdatePlanWithScratchAllocator(
   }
 }
 
-bool SYCLFft::DoFft(Stream *stream, fft::Plan *plan,
-                    const DeviceMemory<std::complex<float>> &input,
-                    DeviceMemory<std::complex<float>> *output) {
-  SYCLFftPlan *sycl_fft_plan = dynamic_cast<SYCLFftPlan *>(plan);
+namespace {
+
+// Configuration of a committed descriptor, which is tied to the queue it was
+// committed on.
+struct DescriptorKey {
+  ::sycl::queue *queue;
+  std::vector<int64_t> dims;
+  int batch_count;
+  std::vector<int64_t> istrides;
+  std::vector<int64_t> ostrides;
+  int64_t tmp_istride;
+  int64_t tmp_ostride;
+  uint64_t input_distance;
+  uint64_t output_distance;
+  bool is_forward;
+  bool is_real;
+  double scale_factor;
 
-  auto &plan_ = sycl_fft_plan->GetPlan();
-  oneapi::mkl::dft::descriptor<oneapi::mkl::dft::precision::SINGLE,
-                               oneapi::mkl::dft::domain::COMPLEX>
-      desc(plan_->get_dims_vec());
-
-  desc.set_value(oneapi::mkl::dft::config_param::PLACEMENT, DFTI_NOT_INPLACE);
-  desc.set_value(oneapi::mkl::dft::config_param::NUMBER_OF_TRANSFORMS,
-                 plan_->get_batch_count());
-
-  if (plan_->get_is_real()) {
-    desc.set_value(oneapi::mkl::dft::config_param::CONJUGATE_EVEN_STORAGE,
-                   DFTI_COMPLEX_COMPLEX);
-    desc.set_value(oneapi::mkl::dft::config_param::INPUT_STRIDES,
-                   (plan_->get_mkl_istrides()).data());
-    desc.set_value(oneapi::mkl::dft::config_param::OUTPUT_STRIDES,
-                   (plan_->get_mkl_ostrides()).data());
-    if (plan_->get_is_forward()) {
-      desc.set_value(oneapi::mkl::dft::config_param::FWD_DISTANCE,
-                     plan_->get_tmp_istride());
-      desc.set_value(oneapi::mkl::dft::config_param::BWD_DISTANCE,
-                     plan_->get_tmp_ostride());
-    } else {
-      desc.set_value(oneapi::mkl::dft::config_param::FWD_DISTANCE,
-                     plan_->get_tmp_ostride());
-      desc.set_value(oneapi::mkl::dft::config_param::BWD_DISTANCE,
-                     plan_->get_tmp_istride());
-      desc.set_value(oneapi::mkl::dft::config_param::BACKWARD_SCALE,
-                     static_cast<float>(plan_->get_scale_factor()));
-    }
-  } else {
-    desc.set_value(oneapi::mkl::dft::config_param::FWD_DISTANCE,
-                   plan_->get_input_distance());
-    desc.set_value(oneapi::mkl::dft::config_param::BWD_DISTANCE,
-                   plan_->get_output_distance());
-    desc.set_value(oneapi::mkl::dft::config_param::BACKWARD_SCALE,
-                   static_cast<float>(plan_->get_scale_factor()));
+  template <typename H>
+  friend H AbslHashValue(H h, const DescriptorKey &key) {
+    return H::combine(std::move(h), key.queue, key.dims, key.batch_count,
+                      key.istrides, key.ostrides, key.tmp_istride,
+                      key.tmp_ostride, key.input_distance, key.output_distance,
+                      key.is_forward, key.is_real, key.scale_factor);
   }
-  desc.commit(*AsGpuStreamValue(stream));
-
-  const float *in_const = reinterpret_cast<const float *>(GpuMemory(input));
-  float *in = const_cast<float *>(in_const);
-  float *out = reinterpret_cast<float *>(GpuMemoryMutable(output));
 
-  ::sycl::event fft_event;
-  if (plan_->get_is_forward()) {
-    fft_event = oneapi::mkl::dft::compute_forward(desc, in, out);
+  bool operator==(const DescriptorKey &other) const {
+    return queue == other.queue && dims == other.dims &&
+           batch_count == other.batch_count && istrides == other.istrides &&
+           ostrides == other.ostrides && tmp_istride == other.tmp_istride &&
+           tmp_ostride == other.tmp_ostride &&
+           input_distance == other.input_distance &&
+           output_distance == other.output_distance &&
+           is_forward == other.is_forward && is_real == other.is_real &&
+           scale_factor == other.scale_factor;
+  }
+};
+
+template <oneapi::mkl::dft::precision kPrecision,
+          oneapi::mkl::dft::domain kDomain>
+using Descriptor = oneapi::mkl::dft::descriptor<kPrecision, kDomain>;
+
+// Returns the descriptor of `plan` committed on `queue`. Committing compiles
+// the kernels of the transform, so committed descriptors are kept for the
+// process lifetime and shared by all the plans with the same configuration.
+template <oneapi::mkl::dft::precision kPrecision,
+          oneapi::mkl::dft::domain kDomain, typename T>
+Descriptor<kPrecision, kDomain> *GetCommittedDescriptor(
+    const SYCLPlan_Helper &plan, ::sycl::queue *queue) {
+  static absl::Mutex mu(absl::kConstInit);
+  static auto *descriptors = new absl::flat_hash_map<
+      DescriptorKey, std::unique_ptr<Descriptor<kPrecision, kDomain>>>();
+
+  DescriptorKey key{queue,
+                    plan.get_dims_vec(),
+                    plan.get_batch_count(),
+                    plan.get_mkl_istrides(),
+                    plan.get_mkl_ostrides(),
+                    plan.get_tmp_istride(),
+                    plan.get_tmp_ostride(),
+                    plan.get_input_distance(),
+                    plan.get_output_distance(),
+                    plan.get_is_forward(),
+                    plan.get_is_real(),
+                    plan.get_scale_factor()};
+  absl::MutexLock lock(&mu);
+  auto it = descriptors->find(key);
+  if (it != descriptors->end()) return it->second.get();
+
+  auto desc =
+      std::make_unique<Descriptor<kPrecision, kDomain>>(plan.get_dims_vec());
+  desc->set_value(oneapi::mkl::dft::config_param::PLACEMENT, DFTI_NOT_INPLACE);
+  desc->set_value(oneapi::mkl::dft::config_param::NUMBER_OF_TRANSFORMS,
+                  plan.get_batch_count());
+
+  if (plan.get_is_real()) {
+    desc->set_value(oneapi::mkl::dft::config_param::CONJUGATE_EVEN_STORAGE,
+                    DFTI_COMPLEX_COMPLEX);
+    desc->set_value(oneapi::mkl::dft::config_param::INPUT_STRIDES,
+                    (plan.get_mkl_istrides()).data());
+    desc->set_value(oneapi::mkl::dft::config_param::OUTPUT_STRIDES,
+                    (plan.get_mkl_ostrides()).data());
+    if (plan.get_is_forward()) {
+      desc->set_value(oneapi::mkl::dft::config_param::FWD_DISTANCE,
+                      plan.get_tmp_istride());
+      desc->set_value(oneapi::mkl::dft::config_param::BWD_DISTANCE,
+                      plan.get_tmp_ostride());
+    } else {
+      desc->set_value(oneapi::mkl::dft::config_param::FWD_DISTANCE,
+                      plan.get_tmp_ostride());
+      desc->set_value(oneapi::mkl::dft::config_param::BWD_DISTANCE,
+                      plan.get_tmp_istride());
+      desc->set_value(oneapi::mkl::dft::config_param::BACKWARD_SCALE,
+                      static_cast<T>(plan.get_scale_factor()));
+    }
   } else {
-    fft_event = oneapi::mkl::dft::compute_backward(desc, in, out);
+    desc->set_value(oneapi::mkl::dft::config_param::FWD_DISTANCE,
+                    plan.get_input_distance());
+    desc->set_value(oneapi::mkl::dft::config_param::BWD_DISTANCE,
+                    plan.get_output_distance());
+    desc->set_value(oneapi::mkl::dft::config_param::BACKWARD_SCALE,
+                    static_cast<T>(plan.get_scale_factor()));
   }
-  fft_event.wait();
-  return true;
+  desc->commit(*queue);
+  VLOG(2) << "Committed syclFFT descriptor " << descriptors->size()
+          << " on queue " << queue;
+  return descriptors->emplace(std::move(key), std::move(desc))
+      .first->second.get();
 }
 
-bool SYCLFft::DoFft(Stream *stream, fft::Plan *plan,
-                    const DeviceMemory<std::complex<double>> &input,
-                    DeviceMemory<std::complex<double>> *output) {
+// Runs the transform of `plan` from `input` to `output`, T being the real
+// type of the precision.
+template <oneapi::mkl::dft::precision kPrecision,
+          oneapi::mkl::dft::domain kDomain, typename T>
+bool DoFftImpl(Stream *stream, fft::Plan *plan, const void *input,
+               void *output) {
   SYCLFftPlan *sycl_fft_plan = dynamic_cast<SYCLFftPlan *>(plan);
 
   auto &plan_ = sycl_fft_plan->GetPlan();
-  oneapi::mkl::dft::descriptor<oneapi::mkl::dft::precision::DOUBLE,
-                               oneapi::mkl::dft::domain::COMPLEX>
-      desc(plan_->get_dims_vec());
-
-  desc.set_value(oneapi::mkl::dft::config_param::PLACEMENT, DFTI_NOT_INPLACE);
-  desc.set_value(oneapi::mkl::dft::config_param::NUMBER_OF_TRANSFORMS,
-                 plan_->get_batch_count());
-
-  if (plan_->get_is_real()) {
-    desc.set_value(oneapi::mkl::dft::config_param::CONJUGATE_EVEN_STORAGE,
-                   DFTI_COMPLEX_COMPLEX);
-    desc.set_value(oneapi::mkl::dft::config_param::INPUT_STRIDES,
-                   (plan_->get_mkl_istrides()).data());
-    desc.set_value(oneapi::mkl::dft::config_param::OUTPUT_STRIDES,
-                   (plan_->get_mkl_ostrides()).data());
-    if (plan_->get_is_forward()) {
-      desc.set_value(oneapi::mkl::dft::config_param::FWD_DISTANCE,
-                     plan_->get_tmp_istride());
-      desc.set_value(oneapi::mkl::dft::config_param::BWD_DISTANCE,
-                     plan_->get_tmp_ostride());
-    } else {
-      desc.set_value(oneapi::mkl::dft::config_param::FWD_DISTANCE,
-                     plan_->get_tmp_ostride());
-      desc.set_value(oneapi::mkl::dft::config_param::BWD_DISTANCE,
-                     plan_->get_tmp_istride());
-      desc.set_value(oneapi::mkl::dft::config_param::BACKWARD_SCALE,
-                     static_cast<double>(plan_->get_scale_factor()));
-    }
-  } else {
-    desc.set_value(oneapi::mkl::dft::config_param::FWD_DISTANCE,
-                   plan_->get_input_distance());
-    desc.set_value(oneapi::mkl::dft::config_param::BWD_DISTANCE,
-                   plan_->get_output_distance());
-    desc.set_value(oneapi::mkl::dft::config_param::BACKWARD_SCALE,
-                   static_cast<double>(plan_->get_scale_factor()));
-  }
-  desc.commit(*AsGpuStreamValue(stream));
+  Descriptor<kPrecision, kDomain> *desc =
+      GetCommittedDescriptor<kPrecision, kDomain, T>(
+          *plan_, AsGpuStreamValue(stream));
 
-  const double *in_const = reinterpret_cast<const double *>(GpuMemory(input));
-  double *in = const_cast<double *>(in_const);
-  double *out = reinterpret_cast<double *>(GpuMemoryMutable(output));
+  T *in = static_cast<T *>(const_cast<void *>(input));
+  T *out = static_cast<T *>(output);
 
   ::sycl::event fft_event;
   if (plan_->get_is_forward()) {
-    fft_event = oneapi::mkl::dft::compute_forward(desc, in, out);
+    fft_event = oneapi::mkl::dft::compute_forward(*desc, in, out);
   } else {
-    fft_event = oneapi::mkl::dft::compute_backward(desc, in, out);
+    fft_event = oneapi::mkl::dft::compute_backward(*desc, in, out);
   }
   fft_event.wait();
   return true;
 }
 
+}  // namespace
+
 bool SYCLFft::DoFft(Stream *stream, fft::Plan *plan,
-                    const DeviceMemory<float> &input,
+                    const DeviceMemory<std::complex<float>> &input,
                     DeviceMemory<std::complex<float>> *output) {
-  SYCLFftPlan *sycl_fft_plan = dynamic_cast<SYCLFftPlan *>(plan);
-
-  auto &plan_ = sycl_fft_plan->GetPlan();
-  oneapi::mkl::dft::descriptor<oneapi::mkl::dft::precision::SINGLE,
-                               oneapi::mkl::dft::domain::REAL>
-      desc(plan_->get_dims_vec());
-
-  desc.set_value(oneapi::mkl::dft::config_param::PLACEMENT, DFTI_NOT_INPLACE);
-  desc.set_value(oneapi::mkl::dft::config_param::NUMBER_OF_TRANSFORMS,
-                 plan_->get_batch_count());
-
-  if (plan_->get_is_real()) {
-    desc.set_value(oneapi::mkl::dft::config_param::CONJUGATE_EVEN_STORAGE,
-                   DFTI_COMPLEX_COMPLEX);
-    desc.set_value(oneapi::mkl::dft::config_param::INPUT_STRIDES,
-                   (plan_->get_mkl_istrides()).data());
-    desc.set_value(oneapi::mkl::dft::config_param::OUTPUT_STRIDES,
-                   (plan_->get_mkl_ostrides()).data());
-    if (plan_->get_is_forward()) {
-      desc.set_value(oneapi::mkl::dft::config_param::FWD_DISTANCE,
-                     plan_->get_tmp_istride());
-      desc.set_value(oneapi::mkl::dft::config_param::BWD_DISTANCE,
-                     plan_->get_tmp_ostride());
-    } else {
-      desc.set_value(oneapi::mkl::dft::config_param::FWD_DISTANCE,
-                     plan_->get_tmp_ostride());
-      desc.set_value(oneapi::mkl::dft::config_param::BWD_DISTANCE,
-                     plan_->get_tmp_istride());
-      desc.set_value(oneapi::mkl::dft::config_param::BACKWARD_SCALE,
-                     static_cast<float>(plan_->get_scale_factor()));
-    }
-  } else {
-    desc.set_value(oneapi::mkl::dft::config_param::FWD_DISTANCE,
-                   plan_->get_input_distance());
-    desc.set_value(oneapi::mkl::dft::config_param::BWD_DISTANCE,
-                   plan_->get_output_distance());
-    desc.set_value(oneapi::mkl::dft::config_param::BACKWARD_SCALE,
-                   static_cast<float>(plan_->get_scale_factor()));
-  }
-  desc.commit(*AsGpuStreamValue(stream));
+  return DoFftImpl<oneapi::mkl::dft::precision::SINGLE,
+                   oneapi::mkl::dft::domain::COMPLEX, float>(
+      stream, plan, input.opaque(), output->opaque());
+}
 
-  const float *in_const = reinterpret_cast<const float *>(GpuMemory(input));
-  float *in = const_cast<float *>(in_const);
-  float *out = reinterpret_cast<float *>(GpuMemoryMutable(output));
+bool SYCLFft::DoFft(Stream *stream, fft::Plan *plan,
+                    const DeviceMemory<std::complex<double>> &input,
+                    DeviceMemory<std::complex<double>> *output) {
+  return DoFftImpl<oneapi::mkl::dft::precision::DOUBLE,
+                   oneapi::mkl::dft::domain::COMPLEX, double>(
+      stream, plan, input.opaque(), output->opaque());
+}
 
-  ::sycl::event fft_event;
-  if (plan_->get_is_forward()) {
-    fft_event = oneapi::mkl::dft::compute_forward(desc, in, out);
-  } else {
-    fft_event = oneapi::mkl::dft::compute_backward(desc, in, out);
-  }
-  fft_event.wait();
-  return true;
+bool SYCLFft::DoFft(Stream *stream, fft::Plan *plan,
+                    const DeviceMemory<float> &input,
+                    DeviceMemory<std::complex<float>> *output) {
+  return DoFftImpl<oneapi::mkl::dft::precision::SINGLE,
+                   oneapi::mkl::dft::domain::REAL, float>(
+      stream, plan, input.opaque(), output->opaque());
 }
 
 bool SYCLFft::DoFft(Stream *stream, fft::Plan *plan,
                     const DeviceMemory<double> &input,
                     DeviceMemory<std::complex<double>> *output) {
-  SYCLFftPlan *sycl_fft_plan = dynamic_cast<SYCLFftPlan *>(plan);
-
-  auto &plan_ = sycl_fft_plan->GetPlan();
-  oneapi::mkl::dft::descriptor<oneapi::mkl::dft::precision::DOUBLE,
-                               oneapi::mkl::dft::domain::REAL>
-      desc(plan_->get_dims_vec());
-
-  desc.set_value(oneapi::mkl::dft::config_param::PLACEMENT, DFTI_NOT_INPLACE);
-  desc.set_value(oneapi::mkl::dft::config_param::NUMBER_OF_TRANSFORMS,
-                 plan_->get_batch_count());
-
-  if (plan_->get_is_real()) {
-    desc.set_value(oneapi::mkl::dft::config_param::CONJUGATE_EVEN_STORAGE,
-                   DFTI_COMPLEX_COMPLEX);
-    desc.set_value(oneapi::mkl::dft::config_param::INPUT_STRIDES,
-                   (plan_->get_mkl_istrides()).data());
-    desc.set_value(oneapi::mkl::dft::config_param::OUTPUT_STRIDES,
-                   (plan_->get_mkl_ostrides()).data());
-    if (plan_->get_is_forward()) {
-      desc.set_value(oneapi::mkl::dft::config_param::FWD_DISTANCE,
-                     plan_->get_tmp_istride());
-      desc.set_value(oneapi::mkl::dft::config_param::BWD_DISTANCE,
-                     plan_->get_tmp_ostride());
-    } else {
-      desc.set_value(oneapi::mkl::dft::config_param::FWD_DISTANCE,
-                     plan_->get_tmp_ostride());
-      desc.set_value(oneapi::mkl::dft::config_param::BWD_DISTANCE,
-                     plan_->get_tmp_istride());
-      desc.set_value(oneapi::mkl::dft::config_param::BACKWARD_SCALE,
-                     static_cast<double>(plan_->get_scale_factor()));
-    }
-  } else {
-    desc.set_value(oneapi::mkl::dft::config_param::FWD_DISTANCE,
-                   plan_->get_input_distance());
-    desc.set_value(oneapi::mkl::dft::config_param::BWD_DISTANCE,
-                   plan_->get_output_distance());
-    desc.set_value(oneapi::mkl::dft::config_param::BACKWARD_SCALE,
-                   static_cast<double>(plan_->get_scale_factor()));
-  }
-  desc.commit(*AsGpuStreamValue(stream));
-
-  const double *in_const = reinterpret_cast<const double *>(GpuMemory(input));
-  double *in = const_cast<double *>(in_const);
-  double *out = reinterpret_cast<double *>(GpuMemoryMutable(output));
-
-  ::sycl::event fft_event;
-  if (plan_->get_is_forward()) {
-    fft_event = oneapi::mkl::dft::compute_forward(desc, in, out);
-  } else {
-    fft_event = oneapi::mkl::dft::compute_backward(desc, in, out);
-  }
-  fft_event.wait();
-  return true;
+  return DoFftImpl<oneapi::mkl::dft::precision::DOUBLE,
+                   oneapi::mkl::dft::domain::REAL, double>(
+      stream, plan, input.opaque(), output->opaque());
 }
 
 bool SYCLFft::DoFft(Stream *stream, fft::Plan *plan,
                     const DeviceMemory<std::complex<float>> &input,
                     DeviceMemory<float> *output) {
-  SYCLFftPlan *sycl_fft_plan = dynamic_cast<SYCLFftPlan *>(plan);
-
-  auto &plan_ = sycl_fft_plan->GetPlan();
-  oneapi::mkl::dft::descriptor<oneapi::mkl::dft::precision::SINGLE,
-                               oneapi::mkl::dft::domain::REAL>
-      desc(plan_->get_dims_vec());
-
-  desc.set_value(oneapi::mkl::dft::config_param::PLACEMENT, DFTI_NOT_INPLACE);
-  desc.set_value(oneapi::mkl::dft::config_param::NUMBER_OF_TRANSFORMS,
-                 plan_->get_batch_count());
-
-  if (plan_->get_is_real()) {
-    desc.set_value(oneapi::mkl::dft::config_param::CONJUGATE_EVEN_STORAGE,
-                   DFTI_COMPLEX_COMPLEX);
-    desc.set_value(oneapi::mkl::dft::config_param::INPUT_STRIDES,
-                   (plan_->get_mkl_istrides()).data());
-    desc.set_value(oneapi::mkl::dft::config_param::OUTPUT_STRIDES,
-                   (plan_->get_mkl_ostrides()).data());
-    if (plan_->get_is_forward()) {
-      desc.set_value(oneapi::mkl::dft::config_param::FWD_DISTANCE,
-                     plan_->get_tmp_istride());
-      desc.set_value(oneapi::mkl::dft::config_param::BWD_DISTANCE,
-                     plan_->get_tmp_ostride());
-    } else {
-      desc.set_value(oneapi::mkl::dft::config_param::FWD_DISTANCE,
-                     plan_->get_tmp_ostride());
-      desc.set_value(oneapi::mkl::dft::config_param::BWD_DISTANCE,
-                     plan_->get_tmp_istride());
-      desc.set_value(oneapi::mkl::dft::config_param::BACKWARD_SCALE,
-                     static_cast<float>(plan_->get_scale_factor()));
-    }
-  } else {
-    desc.set_value(oneapi::mkl::dft::config_param::FWD_DISTANCE,
-                   plan_->get_input_distance());
-    desc.set_value(oneapi::mkl::dft::config_param::BWD_DISTANCE,
-                   plan_->get_output_distance());
-    desc.set_value(oneapi::mkl::dft::config_param::BACKWARD_SCALE,
-                   static_cast<float>(plan_->get_scale_factor()));
-  }
-  desc.commit(*AsGpuStreamValue(stream));
-
-  const float *in_const = reinterpret_cast<const float *>(GpuMemory(input));
-  float *in = const_cast<float *>(in_const);
-  float *out = reinterpret_cast<float *>(GpuMemoryMutable(output));
-
-  ::sycl::event fft_event;
-  if (plan_->get_is_forward()) {
-    fft_event = oneapi::mkl::dft::compute_forward(desc, in, out);
-  } else {
-    fft_event = oneapi::mkl::dft::compute_backward(desc, in, out);
-  }
-  fft_event.wait();
-  return true;
+  return DoFftImpl<oneapi::mkl::dft::precision::SINGLE,
+                   oneapi::mkl::dft::domain::REAL, float>(
+      stream, plan, input.opaque(), output->opaque());
 }
 
 bool SYCLFft::DoFft(Stream *stream, fft::Plan *plan,
                     const DeviceMemory<std::complex<double>> &input,
                     DeviceMemory<double> *output) {
-  SYCLFftPlan *sycl_fft_plan = dynamic_cast<SYCLFftPlan *>(plan);
-
-  auto &plan_ = sycl_fft_plan->GetPlan();
-  oneapi::mkl::dft::descriptor<oneapi::mkl::dft::precision::DOUBLE,
-                               oneapi::mkl::dft::domain::REAL>
-      desc(plan_->get_dims_vec());
-
-  desc.set_value(oneapi::mkl::dft::config_param::PLACEMENT, DFTI_NOT_INPLACE);
-  desc.set_value(oneapi::mkl::dft::config_param::NUMBER_OF_TRANSFORMS,
-                 plan_->get_batch_count());
-
-  if (plan_->get_is_real()) {
-    desc.set_value(oneapi::mkl::dft::config_param::CONJUGATE_EVEN_STORAGE,
-                   DFTI_COMPLEX_COMPLEX);
-    desc.set_value(oneapi::mkl::dft::config_param::INPUT_STRIDES,
-                   (plan_->get_mkl_istrides()).data());
-    desc.set_value(oneapi::mkl::dft::config_param::OUTPUT_STRIDES,
-                   (plan_->get_mkl_ostrides()).data());
-    if (plan_->get_is_forward()) {
-      desc.set_value(oneapi::mkl::dft::config_param::FWD_DISTANCE,
-                     plan_->get_tmp_istride());
-      desc.set_value(oneapi::mkl::dft::config_param::BWD_DISTANCE,
-                     plan_->get_tmp_ostride());
-    } else {
-      desc.set_value(oneapi::mkl::dft::config_param::FWD_DISTANCE,
-                     plan_->get_tmp_ostride());
-      desc.set_value(oneapi::mkl::dft::config_param::BWD_DISTANCE,
-                     plan_->get_tmp_istride());
-      desc.set_value(oneapi::mkl::dft::config_param::BACKWARD_SCALE,
-                     static_cast<double>(plan_->get_scale_factor()));
-    }
-  } else {
-    desc.set_value(oneapi::mkl::dft::config_param::FWD_DISTANCE,
-                   plan_->get_input_distance());
-    desc.set_value(oneapi::mkl::dft::config_param::BWD_DISTANCE,
-                   plan_->get_output_distance());
-    desc.set_value(oneapi::mkl::dft::config_param::BACKWARD_SCALE,
-                   static_cast<double>(plan_->get_scale_factor()));
-  }
-  desc.commit(*AsGpuStreamValue(stream));
-
-  const double *in_const = reinterpret_cast<const double *>(GpuMemory(input));
-  double *in = const_cast<double *>(in_const);
-  double *out = reinterpret_cast<double *>(GpuMemoryMutable(output));
-
-  ::sycl::event fft_event;
-  if (plan_->get_is_forward()) {
-    fft_event = oneapi::mkl::dft::compute_forward(desc, in, out);
-  } else {
-    fft_event = oneapi::mkl::dft::compute_backward(desc, in, out);
-  }
-  fft_event.wait();
-  return true;
+  return DoFftImpl<oneapi::mkl::dft::precision::DOUBLE,
+                   oneapi::mkl::dft::domain::REAL, double>(
+      stream, plan, input.opaque(), output->opaque());
 }
 }  // namespace gpu
 
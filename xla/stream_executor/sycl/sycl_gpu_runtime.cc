@@ -15,15 +15,35 @@ limitations under the License.
 
 #include "xla/stream_executor/sycl/sycl_gpu_runtime.h"
 
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <cassert>
+#include <chrono>  // NOLINT(build/c++11)
+#include <cstring>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "absl/base/call_once.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
 #include "level_zero/ze_api.h"
 #include "tsl/platform/status.h"
+#include "tsl/profiler/lib/traceme.h"
+#include "tsl/profiler/lib/traceme_encode.h"
 #include "tsl/util/env_var.h"
 
 namespace {
@@ -32,12 +52,35 @@ namespace {
 //   True (default behaviour): Tile as an individual device in device list
 //   False: Only root device as an individual device in device list
 inline bool TileAsDevice() {
-  bool tile_as_device;
-  TF_CHECK_OK(
-      tsl::ReadBoolFromEnvVar("SYCL_TILE_AS_DEVICE", true, &tile_as_device));
+  static const bool tile_as_device = [] {
+    bool tile_as_device;
+    TF_CHECK_OK(
+        tsl::ReadBoolFromEnvVar("SYCL_TILE_AS_DEVICE", true, &tile_as_device));
+    return tile_as_device;
+  }();
   return tile_as_device;
 }
 
+// With SYCL_TILE_AS_DEVICE=false every root device is one device spanning its
+// tiles, which needs Level-Zero to expose the root devices and to spread the
+// work groups of their kernels and their allocations over the tiles. Drivers
+// defaulting to the flat hierarchy do neither. The environment can't be
+// changed safely from here and Level-Zero may already be initialized, so the
+// user has to set ZE_FLAT_DEVICE_HIERARCHY=COMPOSITE and
+// EnableImplicitScaling=1 before starting the process.
+void CheckImplicitScaling() {
+  const char* hierarchy = getenv("ZE_FLAT_DEVICE_HIERARCHY");
+  const char* implicit_scaling = getenv("EnableImplicitScaling");
+  if (hierarchy == nullptr || absl::string_view(hierarchy) != "COMPOSITE" ||
+      implicit_scaling == nullptr ||
+      absl::string_view(implicit_scaling) != "1") {
+    LOG(WARNING) << "SYCL_TILE_AS_DEVICE=false expects "
+                    "ZE_FLAT_DEVICE_HIERARCHY=COMPOSITE and "
+                    "EnableImplicitScaling=1, the root devices may not span "
+                    "their tiles.";
+  }
+}
+
 inline bool RunOnLevelZero() {
   char* sycl_device_filter = getenv("SYCL_DEVICE_FILTER");
   // Current default backend platform is Level-Zero
@@ -120,6 +163,7 @@ class DevicePool {
     static std::vector<sycl::device> devices;
 
     std::call_once(init_device_flag, []() {
+      if (!TileAsDevice()) CheckImplicitScaling();
       std::vector<sycl::device> root_devices;
       // Get root device list from platform list.
       auto platform_list = sycl::platform::get_platforms();
@@ -220,6 +264,44 @@ bool IsMultipleStreamEnabled() {
   return is_multiple_stream_enabled;
 }
 
+bool IsImplicitScalingEnabled() { return !TileAsDevice(); }
+
+bool IsQueueProfilingEnabled() {
+#ifdef SYCL_EXT_ONEAPI_PROFILING_TAG
+  static bool is_queue_profiling_enabled = [] {
+    bool enabled = false;
+    TF_CHECK_OK(
+        tsl::ReadBoolFromEnvVar("XLA_SYCL_QUEUE_PROFILING", false, &enabled));
+    return enabled;
+  }();
+  return is_queue_profiling_enabled;
+#else
+  return true;
+#endif
+}
+
+// Priority of the default queue shared by the streams without a priority of
+// their own. Level-Zero schedules queues of all processes on a tile by their
+// priority, so XLA_SYCL_DEFAULT_QUEUE_PRIORITY=high lets an interactive
+// inference process preempt background work such as training, and =low does
+// the opposite.
+static int GetDefaultQueuePriority() {
+  static int default_queue_priority = [] {
+    std::string value;
+    TF_CHECK_OK(tsl::ReadStringFromEnvVar("XLA_SYCL_DEFAULT_QUEUE_PRIORITY",
+                                          "normal", &value));
+    value = absl::AsciiStrToLower(value);
+    if (value == "high") return 1;
+    if (value == "low") return -1;
+    if (value != "normal") {
+      LOG(WARNING) << "Unknown XLA_SYCL_DEFAULT_QUEUE_PRIORITY " << value
+                   << ", expected high, normal or low";
+    }
+    return 0;
+  }();
+  return default_queue_priority;
+}
+
 /******************* SYCL context management**************************/
 static sycl::async_handler SYCLAsyncHandler = [](sycl::exception_list eL) {
   for (auto& e : eL) {
@@ -232,42 +314,129 @@ static sycl::async_handler SYCLAsyncHandler = [](sycl::exception_list eL) {
   }
 };
 
+// In-order queues that only collect the timestamps of every command when
+// queue profiling is enabled, which costs a timestamp write per command.
+static sycl::property_list GetQueueProperties(int priority) {
+  if (IsQueueProfilingEnabled()) {
+    if (priority > 0) {
+      return {sycl::property::queue::enable_profiling(),
+              sycl::property::queue::in_order(),
+              sycl::ext::oneapi::property::queue::priority_high()};
+    } else if (priority < 0) {
+      return {sycl::property::queue::enable_profiling(),
+              sycl::property::queue::in_order(),
+              sycl::ext::oneapi::property::queue::priority_low()};
+    }
+    return {sycl::property::queue::enable_profiling(),
+            sycl::property::queue::in_order()};
+  }
+  if (priority > 0) {
+    return {sycl::property::queue::in_order(),
+            sycl::ext::oneapi::property::queue::priority_high()};
+  } else if (priority < 0) {
+    return {sycl::property::queue::in_order(),
+            sycl::ext::oneapi::property::queue::priority_low()};
+  }
+  return {sycl::property::queue::in_order()};
+}
+
+// Queues of every device. The default queues of the devices of the pool are
+// created together, once, so that the first stream of a device does not pay
+// for them and concurrent callers never race to create them. Each device has
+// a lock of its own, and the queues of destroyed streams are kept and handed
+// to the next streams of the same priority instead of being created again.
 class SYCLStreamPool {
  public:
+  static SYCLError_t init() {
+    GetPools();
+    return SYCL_SUCCESS;
+  }
+
   static SYCLError_t getDefaultStream(sycl::device* device_handle,
                                       sycl::queue** stream_p) {
-    *stream_p = SYCLStreamPool::GetStreamsPool(device_handle)[0].get();
+    *stream_p = GetDeviceStreams(device_handle)->default_stream.get();
     return SYCL_SUCCESS;
   }
 
-  static SYCLError_t createStream(sycl::device* device_handle,
+  // Streams with a priority, i.e. the async collective streams, always get a
+  // queue of their own so that collectives overlap with the compute on the
+  // default queue. Other streams share the default queue unless
+  // XLA_ENABLE_MULTIPLE_STREAM is set.
+  static SYCLError_t createStream(sycl::device* device_handle, int priority,
                                   sycl::queue** stream_p) {
-    if (IsMultipleStreamEnabled()) {
-      sycl::property_list propList{sycl::property::queue::enable_profiling(),
-                                   sycl::property::queue::in_order()};
-      SYCLStreamPool::GetStreamsPool(device_handle)
-          .push_back(std::make_shared<sycl::queue>(
-              DevicePool::getDeviceContext(), *device_handle, SYCLAsyncHandler,
-              propList));
-    }
-    *stream_p = SYCLStreamPool::GetStreamsPool(device_handle).back().get();
+    DeviceStreams* device_streams = GetDeviceStreams(device_handle);
+    if (priority == 0 && !IsMultipleStreamEnabled()) {
+      *stream_p = device_streams->default_stream.get();
+      return SYCL_SUCCESS;
+    }
+    if (priority == 0) priority = GetDefaultQueuePriority();
+    {
+      absl::MutexLock lock(&device_streams->mu);
+      auto& free_streams = device_streams->free_streams[priority];
+      if (!free_streams.empty()) {
+        // The queue is in order, so work left from its previous stream only
+        // delays the new one.
+        Stream stream = std::move(free_streams.back());
+        free_streams.pop_back();
+        *stream_p = stream.queue.get();
+        device_streams->streams.push_back(std::move(stream));
+        return SYCL_SUCCESS;
+      }
+    }
+    Stream stream{std::make_shared<sycl::queue>(
+                      DevicePool::getDeviceContext(), *device_handle,
+                      SYCLAsyncHandler, GetQueueProperties(priority)),
+                  priority};
+    *stream_p = stream.queue.get();
+    absl::MutexLock lock(&device_streams->mu);
+    device_streams->streams.push_back(std::move(stream));
     return SYCL_SUCCESS;
   }
 
   static SYCLError_t syncContext(sycl::device* device_handle) {
-    for (auto stream : SYCLStreamPool::GetStreamsPool(device_handle)) {
-      stream->wait();
+    DeviceStreams* device_streams = GetDeviceStreams(device_handle);
+    std::vector<std::shared_ptr<sycl::queue>> queues;
+    {
+      absl::MutexLock lock(&device_streams->mu);
+      for (const Stream& stream : device_streams->streams) {
+        queues.push_back(stream.queue);
+      }
+      // Destroyed streams may still have work in flight.
+      for (const auto& [priority, free_streams] :
+           device_streams->free_streams) {
+        for (const Stream& stream : free_streams) {
+          queues.push_back(stream.queue);
+        }
+      }
+    }
+    device_streams->default_stream->wait();
+    for (const auto& queue : queues) {
+      queue->wait();
     }
     return SYCL_SUCCESS;
   }
 
+  static void AddDestroyCallback(
+      std::function<void(sycl::queue*)> callback) {
+    absl::MutexLock lock(&callbacks_mu_);
+    callbacks_->push_back(std::move(callback));
+  }
+
   static SYCLError_t destroyStream(sycl::device* device_handle,
                                    sycl::queue* stream_handle) {
     if (stream_handle == nullptr) return SYCL_ERROR_INVALID_STREAM;
-    auto stream_pool = SYCLStreamPool::GetStreamsPool(device_handle);
-    for (int i = 0; i < stream_pool.size(); i++) {
-      if (stream_pool[i].get() == stream_handle) {
-        stream_pool.erase(stream_pool.begin() + i);
+    DeviceStreams* device_streams = GetDeviceStreams(device_handle);
+    // The default queue is shared by streams and stays alive.
+    if (device_streams->default_stream.get() == stream_handle) {
+      return SYCL_SUCCESS;
+    }
+    absl::MutexLock lock(&device_streams->mu);
+    auto& streams = device_streams->streams;
+    for (auto it = streams.begin(); it != streams.end(); ++it) {
+      if (it->queue.get() == stream_handle) {
+        RunDestroyCallbacks(stream_handle);
+        device_streams->free_streams[it->priority].push_back(std::move(*it));
+        streams.erase(it);
         return SYCL_SUCCESS;
       }
     }
@@ -275,26 +444,178 @@ class SYCLStreamPool {
   }
 
  private:
-  static std::vector<std::shared_ptr<sycl::queue>>& GetStreamsPool(
-      sycl::device* device_handle) {
-    static std::unordered_map<sycl::device*,
-                              std::vector<std::shared_ptr<sycl::queue>>>
-        stream_pool_map;
-    auto iter = stream_pool_map.find(device_handle);
-    if (iter != stream_pool_map.end()) return iter->second;
-    sycl::property_list propList{sycl::property::queue::enable_profiling(),
-                                 sycl::property::queue::in_order()};
-    std::vector<std::shared_ptr<sycl::queue>> stream_pool = {
-        std::make_shared<sycl::queue>(DevicePool::getDeviceContext(),
-                                      *device_handle, SYCLAsyncHandler,
-                                      propList)};
-    stream_pool_map.insert(std::make_pair(device_handle, stream_pool));
-    return stream_pool_map[device_handle];
+  struct Stream {
+    std::shared_ptr<sycl::queue> queue;
+    int priority;
+  };
+
+  static void RunDestroyCallbacks(sycl::queue* stream) {
+    absl::ReaderMutexLock lock(&callbacks_mu_);
+    for (const auto& callback : *callbacks_) callback(stream);
+  }
+
+  static absl::Mutex callbacks_mu_;
+  static std::vector<std::function<void(sycl::queue*)>>* callbacks_
+      ABSL_GUARDED_BY(callbacks_mu_);
+
+  struct DeviceStreams {
+    explicit DeviceStreams(sycl::device* device)
+        : device(device),
+          default_stream(std::make_shared<sycl::queue>(
+              DevicePool::getDeviceContext(), *device, SYCLAsyncHandler,
+              GetQueueProperties(GetDefaultQueuePriority()))) {}
+
+    sycl::device* const device;
+    const std::shared_ptr<sycl::queue> default_stream;
+    absl::Mutex mu;
+    // Queues of the streams that do not share the default queue.
+    std::vector<Stream> streams ABSL_GUARDED_BY(mu);
+    // Queues of destroyed streams by priority, ready for reuse.
+    std::map<int, std::vector<Stream>> free_streams ABSL_GUARDED_BY(mu);
+  };
+
+  using DeviceStreamsList = std::vector<std::unique_ptr<DeviceStreams>>;
+
+  static const DeviceStreamsList& GetPools() {
+    static const DeviceStreamsList* pools = [] {
+      auto* pools = new DeviceStreamsList;
+      int count = 0;
+      SYCLGetDeviceCount(&count);
+      for (int i = 0; i < count; ++i) {
+        sycl::device* device;
+        if (SYCLGetDevice(&device, i) == SYCL_SUCCESS) {
+          pools->push_back(std::make_unique<DeviceStreams>(device));
+        }
+      }
+      return pools;
+    }();
+    return *pools;
+  }
+
+  static DeviceStreams* GetDeviceStreams(sycl::device* device_handle) {
+    for (const auto& device_streams : GetPools()) {
+      if (device_streams->device == device_handle) return device_streams.get();
+    }
+    // Devices that are not from the pool get their queues on first use.
+    static absl::Mutex mu(absl::kConstInit);
+    static auto* others = new DeviceStreamsList;
+    absl::MutexLock lock(&mu);
+    for (const auto& device_streams : *others) {
+      if (device_streams->device == device_handle) return device_streams.get();
+    }
+    others->push_back(std::make_unique<DeviceStreams>(device_handle));
+    return others->back().get();
   }
 };
 
+absl::Mutex SYCLStreamPool::callbacks_mu_(absl::kConstInit);
+std::vector<std::function<void(sycl::queue*)>>* SYCLStreamPool::callbacks_ =
+    new std::vector<std::function<void(sycl::queue*)>>();
+
+// Pool of pinned host buffers used to stage copies from and to pageable host
+// memory. The driver stages pageable copies synchronously through its own
+// buffers, chunking them through pinned buffers lets the host memcpy of one
+// chunk overlap with the DMA of the previous one.
+//
+// XLA_SYCL_STAGING_MIN_SIZE: smallest copy that is staged, in bytes.
+// XLA_SYCL_STAGING_CHUNK_SIZE: size of each pinned buffer, in bytes.
+// XLA_SYCL_STAGING_POOL_SIZE: number of pinned buffers kept for reuse.
+class SYCLStagingPool {
+ public:
+  struct Buffer {
+    void* ptr = nullptr;
+    // Last copy that reads or writes the buffer.
+    std::optional<sycl::event> last_use;
+  };
+
+  static SYCLStagingPool* GetInstance() {
+    static SYCLStagingPool* pool = new SYCLStagingPool();
+    return pool;
+  }
+
+  size_t min_size() const { return min_size_; }
+  size_t chunk_size() const { return chunk_size_; }
+
+  // Acquires the two buffers of a staged copy, with no copy pending on them.
+  // Returns false if pinned memory could not be allocated, the copy then
+  // can't be staged.
+  bool Acquire(Buffer (&buffers)[2]) {
+    std::optional<Buffer> first = AcquireOne();
+    if (!first) return false;
+    std::optional<Buffer> second = AcquireOne();
+    if (!second) {
+      Release(*std::move(first));
+      return false;
+    }
+    buffers[0] = *std::move(first);
+    buffers[1] = *std::move(second);
+    return true;
+  }
+
+  void Release(Buffer buffer) {
+    {
+      absl::MutexLock lock(&mu_);
+      if (buffers_.size() < max_buffers_) {
+        buffers_.push_back(std::move(buffer));
+        return;
+      }
+    }
+    if (buffer.last_use) buffer.last_use->wait();
+    sycl::free(buffer.ptr, DevicePool::getDeviceContext());
+  }
+
+ private:
+  std::optional<Buffer> AcquireOne() {
+    std::optional<Buffer> buffer;
+    {
+      absl::MutexLock lock(&mu_);
+      if (!buffers_.empty()) {
+        buffer = std::move(buffers_.back());
+        buffers_.pop_back();
+      }
+    }
+    if (buffer) {
+      // The last user released the buffer with its copy still in flight.
+      if (buffer->last_use) buffer->last_use->wait();
+      buffer->last_use.reset();
+      return buffer;
+    }
+    // Staging buffers are allocated in the shared context of all devices, so
+    // they can be used with any device.
+    void* ptr = sycl::aligned_alloc_host(/*alignment=*/64, chunk_size_,
+                                         DevicePool::getDeviceContext());
+    if (ptr == nullptr) {
+      LOG(WARNING) << "Failed to allocate a pinned staging buffer of "
+                   << chunk_size_ << " bytes, copying without staging.";
+      return std::nullopt;
+    }
+    return Buffer{ptr, std::nullopt};
+  }
+
+  SYCLStagingPool() {
+    int64_t min_size, chunk_size, max_buffers;
+    TF_CHECK_OK(tsl::ReadInt64FromEnvVar("XLA_SYCL_STAGING_MIN_SIZE",
+                                         1 << 20, &min_size));
+    TF_CHECK_OK(tsl::ReadInt64FromEnvVar("XLA_SYCL_STAGING_CHUNK_SIZE",
+                                         4 << 20, &chunk_size));
+    TF_CHECK_OK(tsl::ReadInt64FromEnvVar("XLA_SYCL_STAGING_POOL_SIZE", 8,
+                                         &max_buffers));
+    chunk_size_ = std::max<int64_t>(chunk_size, 4096);
+    min_size_ = std::max<int64_t>(min_size, 0);
+    max_buffers_ = std::max<int64_t>(max_buffers, 0);
+  }
+
+  size_t min_size_;
+  size_t chunk_size_;
+  size_t max_buffers_;
+
+  absl::Mutex mu_;
+  std::vector<Buffer> buffers_ ABSL_GUARDED_BY(mu_);
+};
+
 SYCLError_t SYCLGetContext(sycl::context** context) {
   *context = &DevicePool::getDeviceContext();
+  return SYCL_SUCCESS;
 }
 
 SYCLError_t SYCLGetDeviceCount(int* count) {
@@ -325,9 +646,343 @@ SYCLError_t SYCLGetFrequency(sycl::device* device_handle, uint64_t* freq,
   return SYCL_SUCCESS;
 }
 
+static sycl::device getRootDevice(const sycl::device& device) {
+  sycl::device root = device;
+  while (root.get_info<sycl::info::device::partition_type_property>() !=
+         sycl::info::partition_property::no_partition) {
+    root = root.get_info<sycl::info::device::parent_device>();
+  }
+  return root;
+}
+
+SYCLError_t SYCLGetLinkClass(sycl::device* device_a, sycl::device* device_b,
+                             SYCLLinkClass_t* link_class) {
+  if (*device_a == *device_b) {
+    *link_class = SYCL_LINK_SAME_DEVICE;
+    return SYCL_SUCCESS;
+  }
+  sycl::device root_a = getRootDevice(*device_a);
+  sycl::device root_b = getRootDevice(*device_b);
+  if (root_a == root_b) {
+    *link_class = SYCL_LINK_SAME_CARD;
+    return SYCL_SUCCESS;
+  }
+
+  *link_class = SYCL_LINK_PCIE;
+  if (!RunOnLevelZero()) return SYCL_SUCCESS;
+  auto ze_a = sycl::get_native<sycl::backend::ext_oneapi_level_zero>(root_a);
+  auto ze_b = sycl::get_native<sycl::backend::ext_oneapi_level_zero>(root_b);
+  ze_fabric_vertex_handle_t vertex_a, vertex_b;
+  // Drivers without fabric support are treated as PCIe only.
+  if (zeDeviceGetFabricVertexExp(ze_a, &vertex_a) != ZE_RESULT_SUCCESS ||
+      zeDeviceGetFabricVertexExp(ze_b, &vertex_b) != ZE_RESULT_SUCCESS) {
+    return SYCL_SUCCESS;
+  }
+  uint32_t num_edges = 0;
+  ze_result_t status =
+      zeFabricEdgeGetExp(vertex_a, vertex_b, &num_edges, nullptr);
+  if (status != ZE_RESULT_SUCCESS) {
+    LOG(ERROR) << "zeFabricEdgeGetExp Failed with return code: "
+               << std::to_string(status);
+    return SYCL_ERROR_ZE_ERROR;
+  }
+  if (num_edges > 0) *link_class = SYCL_LINK_FABRIC;
+  return SYCL_SUCCESS;
+}
+
+SYCLError_t SYCLCanAccessPeer(sycl::device* device, sycl::device* peer,
+                              bool* can_access) {
+  if (*device == *peer) {
+    *can_access = true;
+    return SYCL_SUCCESS;
+  }
+  *can_access = false;
+  if (!RunOnLevelZero()) return SYCL_SUCCESS;
+  auto ze_device =
+      sycl::get_native<sycl::backend::ext_oneapi_level_zero>(*device);
+  auto ze_peer = sycl::get_native<sycl::backend::ext_oneapi_level_zero>(*peer);
+  ze_bool_t value = false;
+  ze_result_t status = zeDeviceCanAccessPeer(ze_device, ze_peer, &value);
+  if (status != ZE_RESULT_SUCCESS) {
+    LOG(ERROR) << "zeDeviceCanAccessPeer Failed with return code: "
+               << std::to_string(status);
+    return SYCL_ERROR_ZE_ERROR;
+  }
+  *can_access = value;
+  return SYCL_SUCCESS;
+}
+
+namespace {
+
+// XLA_SYCL_NUMA_AFFINITY
+//   True (default behaviour): Host threads and host allocations serving a
+//   device are placed on the NUMA node the device is attached to.
+//   False: Leave the placement to the OS.
+bool IsNumaAffinityEnabled() {
+  static bool enabled = [] {
+    bool enabled = true;
+    TF_CHECK_OK(
+        tsl::ReadBoolFromEnvVar("XLA_SYCL_NUMA_AFFINITY", true, &enabled));
+    return enabled;
+  }();
+  return enabled;
+}
+
+// Reads the NUMA node of the PCI device at `pci_address` from sysfs, which
+// reports -1 for systems without NUMA.
+int ReadNumaNode(const std::string& pci_address) {
+  std::ifstream file(absl::StrCat("/sys/bus/pci/devices/",
+                                  absl::AsciiStrToLower(pci_address),
+                                  "/numa_node"));
+  int numa_node = -1;
+  if (!(file >> numa_node)) return -1;
+  return numa_node;
+}
+
+std::vector<SYCLDeviceTopology> BuildDeviceTopologies() {
+  int count = 0;
+  SYCLGetDeviceCount(&count);
+  std::vector<sycl::device*> devices(count);
+  std::vector<sycl::device> roots;
+  std::vector<SYCLDeviceTopology> topologies(count);
+  for (int i = 0; i < count; ++i) {
+    SYCLGetDevice(&devices[i], i);
+    sycl::device root = getRootDevice(*devices[i]);
+    SYCLDeviceTopology& topology = topologies[i];
+    auto it = std::find(roots.begin(), roots.end(), root);
+    topology.root_device_index = it - roots.begin();
+    if (it == roots.end()) roots.push_back(root);
+    if (root != *devices[i]) {
+      // The tiles of a root device are next to each other in the pool.
+      topology.tile_index = 0;
+      for (int j = i - 1; j >= 0 && topologies[j].root_device_index ==
+                                        topology.root_device_index;
+           --j) {
+        ++topology.tile_index;
+      }
+    }
+    if (root.has(sycl::aspect::ext_intel_pci_address)) {
+      topology.pci_address =
+          root.get_info<sycl::ext::intel::info::device::pci_address>();
+      topology.numa_node = ReadNumaNode(topology.pci_address);
+    }
+  }
+
+  for (int i = 0; i < count; ++i) {
+    for (int j = 0; j < count; ++j) {
+      if (topologies[i].root_device_index == topologies[j].root_device_index) {
+        continue;
+      }
+      SYCLLinkClass_t link_class;
+      if (SYCLGetLinkClass(devices[i], devices[j], &link_class) ==
+              SYCL_SUCCESS &&
+          link_class == SYCL_LINK_FABRIC) {
+        topologies[i].fabric_peers.push_back(j);
+      }
+    }
+  }
+  return topologies;
+}
+
+const std::vector<SYCLDeviceTopology>& GetDeviceTopologies() {
+  static const auto* topologies =
+      new std::vector<SYCLDeviceTopology>(BuildDeviceTopologies());
+  return *topologies;
+}
+
+// Makes the calling thread allocate its pages on `numa_node` when it can, for
+// the lifetime of the object.
+class ScopedPreferredNumaNode {
+ public:
+  explicit ScopedPreferredNumaNode(int numa_node) {
+    // The kernel reads one bit less than the node count it is given.
+    if (numa_node < 0 || numa_node >= kMaxNumaNodes - 1) return;
+    if (syscall(SYS_get_mempolicy, &old_mode_, &old_nodes_, kMaxNumaNodes,
+                nullptr, 0) != 0) {
+      return;
+    }
+    unsigned long nodes = 1ul << numa_node;
+    active_ =
+        syscall(SYS_set_mempolicy, MPOL_PREFERRED, &nodes, kMaxNumaNodes) == 0;
+  }
+
+  ~ScopedPreferredNumaNode() {
+    if (active_) {
+      syscall(SYS_set_mempolicy, old_mode_, &old_nodes_, kMaxNumaNodes);
+    }
+  }
+
+  ScopedPreferredNumaNode(const ScopedPreferredNumaNode&) = delete;
+  ScopedPreferredNumaNode& operator=(const ScopedPreferredNumaNode&) = delete;
+
+ private:
+  static constexpr int kMaxNumaNodes = 8 * sizeof(unsigned long);
+
+  int old_mode_ = MPOL_DEFAULT;
+  unsigned long old_nodes_ = 0;
+  bool active_ = false;
+};
+
+int GetNumaNode(sycl::device* device) {
+  const std::vector<SYCLDeviceTopology>& topologies = GetDeviceTopologies();
+  for (int i = 0; i < topologies.size(); ++i) {
+    sycl::device* candidate;
+    if (SYCLGetDevice(&candidate, i) == SYCL_SUCCESS && *candidate == *device) {
+      return topologies[i].numa_node;
+    }
+  }
+  return -1;
+}
+
+}  // namespace
+
+SYCLError_t SYCLGetDeviceTopology(int device_ordinal,
+                                  SYCLDeviceTopology* topology) {
+  const std::vector<SYCLDeviceTopology>& topologies = GetDeviceTopologies();
+  if (device_ordinal < 0 || device_ordinal >= topologies.size()) {
+    return SYCL_ERROR_INVALID_DEVICE;
+  }
+  *topology = topologies[device_ordinal];
+  return SYCL_SUCCESS;
+}
+
+bool SYCLBindThreadToNumaNode(int numa_node) {
+  if (!IsNumaAffinityEnabled() || numa_node < 0) return false;
+  std::ifstream file(
+      absl::StrCat("/sys/devices/system/node/node", numa_node, "/cpulist"));
+  std::string cpulist;
+  if (!std::getline(file, cpulist)) return false;
+
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return false;
+  // The list looks like "0-27,56-83".
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  for (absl::string_view range :
+       absl::StrSplit(cpulist, ',', absl::SkipWhitespace())) {
+    std::pair<absl::string_view, absl::string_view> bounds =
+        absl::StrSplit(range, absl::MaxSplits('-', 1));
+    int first, last;
+    if (!absl::SimpleAtoi(bounds.first, &first)) return false;
+    if (bounds.second.empty()) {
+      last = first;
+    } else if (!absl::SimpleAtoi(bounds.second, &last)) {
+      return false;
+    }
+    for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &allowed)) CPU_SET(cpu, &cpus);
+    }
+  }
+  if (CPU_COUNT(&cpus) == 0) return false;
+  return sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+}
+
+namespace {
+
+SYCLComputeResources QueryComputeResources(const sycl::device& device) {
+  std::vector<sycl::device> tiles;
+  if (IsImplicitScalingEnabled() &&
+      device.get_info<sycl::info::device::partition_max_sub_devices>() > 0) {
+    try {
+      tiles = device.create_sub_devices<
+          sycl::info::partition_property::partition_by_affinity_domain>(
+          sycl::info::partition_affinity_domain::next_partitionable);
+    } catch (const sycl::exception& e) {
+      LOG(WARNING) << "Failed to get the tiles of a root device: " << e.what();
+    }
+  }
+  if (tiles.empty()) tiles.push_back(device);
+
+  namespace intel_info = sycl::ext::intel::info::device;
+  SYCLComputeResources resources;
+  resources.tile_count = tiles.size();
+  for (const sycl::device& tile : tiles) {
+    const int slices = tile.get_info<intel_info::gpu_slices>();
+    resources.core_count +=
+        slices * tile.get_info<intel_info::gpu_subslices_per_slice>();
+    resources.eu_count += tile.get_info<intel_info::gpu_eu_count>();
+  }
+  return resources;
+}
+
+}  // namespace
+
+SYCLError_t SYCLGetComputeResources(const sycl::device& device,
+                                    SYCLComputeResources* resources) {
+  // Launches size their grids from these and creating the sub-devices every
+  // time would be too slow, so they are queried once for all the devices of
+  // the pool and read without locking afterwards.
+  static const auto* pool_resources = [] {
+    auto* pool_resources =
+        new std::vector<std::pair<sycl::device, SYCLComputeResources>>();
+    int device_count = 0;
+    SYCLGetDeviceCount(&device_count);
+    for (int ordinal = 0; ordinal < device_count; ++ordinal) {
+      sycl::device* device;
+      if (SYCLGetDevice(&device, ordinal) != SYCL_SUCCESS) continue;
+      pool_resources->emplace_back(*device, QueryComputeResources(*device));
+    }
+    return pool_resources;
+  }();
+  for (const auto& [pool_device, device_resources] : *pool_resources) {
+    if (pool_device == device) {
+      *resources = device_resources;
+      return SYCL_SUCCESS;
+    }
+  }
+  // Not a device of the pool, e.g. a tile of a root device.
+  *resources = QueryComputeResources(device);
+  return SYCL_SUCCESS;
+}
+
+// Level-Zero does not report the GRF mode of a kernel. Large GRF kernels run
+// half the hardware threads of an Xe core, which also caps their work groups
+// at half as many sub-groups. Kernels whose work groups are short of both the
+// threads of a core and the largest work group size are taken as large GRF.
+SYCLError_t SYCLGetKernelProperties(const sycl::kernel& kernel,
+                                    const sycl::device& device,
+                                    SYCLKernelProperties* properties) {
+  constexpr uint32_t kSmallGrfRegisters = 128;
+  constexpr uint32_t kLargeGrfRegisters = 256;
+
+  *properties = SYCLKernelProperties{};
+  if (!RunOnLevelZero()) return SYCL_SUCCESS;
+  auto ze_kernel =
+      sycl::get_native<sycl::backend::ext_oneapi_level_zero>(kernel);
+  ze_kernel_properties_t props{ZE_STRUCTURE_TYPE_KERNEL_PROPERTIES};
+  ze_result_t status = zeKernelGetProperties(ze_kernel, &props);
+  if (status != ZE_RESULT_SUCCESS) {
+    LOG(ERROR) << "zeKernelGetProperties Failed with return code: "
+               << std::to_string(status);
+    return SYCL_ERROR_ZE_ERROR;
+  }
+  properties->local_mem_size = props.localMemSize;
+  properties->private_mem_size = props.privateMemSize;
+  properties->spill_mem_size = props.spillMemSize;
+  properties->max_subgroup_size = props.maxSubgroupSize;
+  properties->max_num_subgroups = props.maxNumSubgroups;
+
+  namespace intel_info = sycl::ext::intel::info::device;
+  const uint32_t threads_per_core =
+      device.get_info<intel_info::gpu_eu_count_per_subslice>() *
+      device.get_info<intel_info::gpu_hw_threads_per_eu>();
+  const size_t max_work_group_size =
+      device.get_info<sycl::info::device::max_work_group_size>();
+  const bool large_grf =
+      props.maxNumSubgroups * 2 <= threads_per_core &&
+      static_cast<size_t>(props.maxNumSubgroups) * props.maxSubgroupSize <
+          max_work_group_size;
+  properties->registers_per_thread =
+      large_grf ? kLargeGrfRegisters : kSmallGrfRegisters;
+  return SYCL_SUCCESS;
+}
+
+SYCLError_t SYCLInitStreamPool() { return SYCLStreamPool::init(); }
+
 SYCLError_t SYCLCreateStream(sycl::device* device_handle,
-                             sycl::queue** stream_p) {
-  return SYCLStreamPool::createStream(device_handle, stream_p);
+                             sycl::queue** stream_p, int priority) {
+  return SYCLStreamPool::createStream(device_handle, priority, stream_p);
 }
 
 SYCLError_t SYCLDestroyStream(sycl::device* device_handle,
@@ -335,6 +990,10 @@ SYCLError_t SYCLDestroyStream(sycl::device* device_handle,
   return SYCLStreamPool::destroyStream(device_handle, stream_handle);
 }
 
+void SYCLAddStreamDestroyCallback(std::function<void(sycl::queue*)> callback) {
+  SYCLStreamPool::AddDestroyCallback(std::move(callback));
+}
+
 SYCLError_t SYCLCtxSynchronize(sycl::device* device_handle) {
   return SYCLStreamPool::syncContext(device_handle);
 }
@@ -365,6 +1024,77 @@ static void memcpyDeviceToHost(void* dstHost, const void* srcDevice,
   }
 }
 
+static bool useStaging(const void* hostPtr, size_t ByteCount,
+                       sycl::queue* stream) {
+  return ByteCount > 0 &&
+         ByteCount >= SYCLStagingPool::GetInstance()->min_size() &&
+         get_pointer_type(hostPtr, stream->get_context()) ==
+             sycl::usm::alloc::unknown;
+}
+
+// Copies pageable `srcHost` through two pinned staging buffers. The source can
+// be reused as soon as this returns, the returned event marks the completion
+// of the last device copy. Returns nullopt without copying if no staging
+// buffers are available.
+static std::optional<sycl::event> stagedMemcpyHostToDevice(
+    void* dstDevice, const void* srcHost, size_t ByteCount,
+    sycl::queue* stream) {
+  SYCLStagingPool* pool = SYCLStagingPool::GetInstance();
+  SYCLStagingPool::Buffer buffers[2];
+  if (!pool->Acquire(buffers)) return std::nullopt;
+  sycl::event event;
+  size_t chunk = 0;
+  for (size_t offset = 0; offset < ByteCount;
+       offset += pool->chunk_size(), ++chunk) {
+    size_t n = std::min(pool->chunk_size(), ByteCount - offset);
+    SYCLStagingPool::Buffer& buffer = buffers[chunk % 2];
+    if (buffer.last_use) buffer.last_use->wait();
+    std::memcpy(buffer.ptr, static_cast<const char*>(srcHost) + offset, n);
+    event = stream->memcpy(static_cast<char*>(dstDevice) + offset, buffer.ptr,
+                           n);
+    buffer.last_use = event;
+  }
+  pool->Release(std::move(buffers[0]));
+  pool->Release(std::move(buffers[1]));
+  return event;
+}
+
+// Copies to pageable `dstHost` through two pinned staging buffers. The
+// device copy of a chunk overlaps with the host copy of the previous one,
+// `dstHost` holds the data when this returns. Returns false without copying
+// if no staging buffers are available.
+static bool stagedMemcpyDeviceToHost(void* dstHost, const void* srcDevice,
+                                     size_t ByteCount, sycl::queue* stream) {
+  SYCLStagingPool* pool = SYCLStagingPool::GetInstance();
+  SYCLStagingPool::Buffer buffers[2];
+  if (!pool->Acquire(buffers)) return false;
+  size_t chunk_size = pool->chunk_size();
+  size_t num_chunks = (ByteCount + chunk_size - 1) / chunk_size;
+  auto chunk_bytes = [&](size_t chunk) {
+    return std::min(chunk_size, ByteCount - chunk * chunk_size);
+  };
+  auto submit = [&](size_t chunk) {
+    SYCLStagingPool::Buffer& buffer = buffers[chunk % 2];
+    buffer.last_use = stream->memcpy(
+        buffer.ptr, static_cast<const char*>(srcDevice) + chunk * chunk_size,
+        chunk_bytes(chunk));
+  };
+
+  submit(0);
+  if (num_chunks > 1) submit(1);
+  for (size_t chunk = 0; chunk < num_chunks; ++chunk) {
+    SYCLStagingPool::Buffer& buffer = buffers[chunk % 2];
+    buffer.last_use->wait();
+    std::memcpy(static_cast<char*>(dstHost) + chunk * chunk_size, buffer.ptr,
+                chunk_bytes(chunk));
+    buffer.last_use.reset();
+    if (chunk + 2 < num_chunks) submit(chunk + 2);
+  }
+  pool->Release(std::move(buffers[0]));
+  pool->Release(std::move(buffers[1]));
+  return true;
+}
+
 static void memcpyDeviceToDevice(void* dstDevice, const void* srcDevice,
                                  size_t ByteCount, bool async,
                                  sycl::queue* stream) {
@@ -402,6 +1132,10 @@ SYCLError_t SYCLMemcpyDtoH(void* dstHost, const void* srcDevice,
                            size_t ByteCount, sycl::device* device) {
   sycl::queue* stream;
   auto res = SYCLStreamPool::getDefaultStream(device, &stream);
+  if (useStaging(dstHost, ByteCount, stream) &&
+      stagedMemcpyDeviceToHost(dstHost, srcDevice, ByteCount, stream)) {
+    return res;
+  }
   memcpyDeviceToHost(dstHost, srcDevice, ByteCount, false, stream);
   return res;
 }
@@ -410,6 +1144,14 @@ SYCLError_t SYCLMemcpyHtoD(void* dstDevice, const void* srcHost,
                            size_t ByteCount, sycl::device* device) {
   sycl::queue* stream;
   auto res = SYCLStreamPool::getDefaultStream(device, &stream);
+  if (useStaging(srcHost, ByteCount, stream)) {
+    std::optional<sycl::event> event =
+        stagedMemcpyHostToDevice(dstDevice, srcHost, ByteCount, stream);
+    if (event) {
+      event->wait();
+      return res;
+    }
+  }
   memcpyHostToDevice(dstDevice, srcHost, ByteCount, false, stream);
   return res;
 }
@@ -424,6 +1166,10 @@ SYCLError_t SYCLMemcpyDtoD(void* dstDevice, const void* srcDevice,
 
 SYCLError_t SYCLMemcpyDtoHAsync(void* dstHost, const void* srcDevice,
                                 size_t ByteCount, sycl::queue* stream) {
+  if (useStaging(dstHost, ByteCount, stream) &&
+      stagedMemcpyDeviceToHost(dstHost, srcDevice, ByteCount, stream)) {
+    return SYCL_SUCCESS;
+  }
   sycl::usm::alloc DstAllocType =
       get_pointer_type(dstHost, stream->get_context());
   memcpyDeviceToHost(dstHost, srcDevice, ByteCount,
@@ -433,6 +1179,12 @@ SYCLError_t SYCLMemcpyDtoHAsync(void* dstHost, const void* srcDevice,
 
 SYCLError_t SYCLMemcpyHtoDAsync(void* dstDevice, const void* srcHost,
                                 size_t ByteCount, sycl::queue* stream) {
+  // The source is already copied to staging buffers, unlike the unstaged
+  // pageable copy this doesn't have to wait for the device.
+  if (useStaging(srcHost, ByteCount, stream) &&
+      stagedMemcpyHostToDevice(dstDevice, srcHost, ByteCount, stream)) {
+    return SYCL_SUCCESS;
+  }
   sycl::usm::alloc SrcAllocType =
       get_pointer_type(srcHost, stream->get_context());
   memcpyHostToDevice(dstDevice, srcHost, ByteCount,
@@ -474,12 +1226,78 @@ SYCLError_t SYCLMemsetD32Async(void* dstDevice, unsigned int ui, size_t N,
   return SYCL_SUCCESS;
 }
 
+namespace {
+
+struct DeviceMemoryTelemetry {
+  absl::Mutex mu;
+  SYCLMemoryStats stats ABSL_GUARDED_BY(mu);
+  // Sizes of the live allocations, SYCLFree is not given them.
+  std::unordered_map<const void*, size_t> sizes ABSL_GUARDED_BY(mu);
+};
+
+DeviceMemoryTelemetry* GetMemoryTelemetry(const sycl::device& device) {
+  static absl::Mutex mu(absl::kConstInit);
+  static auto* telemetry = new std::unordered_map<
+      sycl::device, std::unique_ptr<DeviceMemoryTelemetry>>();
+  absl::MutexLock lock(&mu);
+  std::unique_ptr<DeviceMemoryTelemetry>& entry = (*telemetry)[device];
+  if (entry == nullptr) entry = std::make_unique<DeviceMemoryTelemetry>();
+  return entry.get();
+}
+
+}  // namespace
+
+SYCLError_t SYCLGetMemoryStats(sycl::device* device, SYCLMemoryStats* stats) {
+  DeviceMemoryTelemetry* telemetry = GetMemoryTelemetry(*device);
+  absl::MutexLock lock(&telemetry->mu);
+  *stats = telemetry->stats;
+  return SYCL_SUCCESS;
+}
+
+extern "C" int XpuGetDeviceMemoryStats(int device_ordinal,
+                                       SYCLMemoryStats* stats) {
+  int count = 0;
+  sycl::device* device;
+  if (SYCLGetDeviceCount(&count) != SYCL_SUCCESS || device_ordinal < 0 ||
+      device_ordinal >= count ||
+      SYCLGetDevice(&device, device_ordinal) != SYCL_SUCCESS) {
+    return -1;
+  }
+  return SYCLGetMemoryStats(device, stats) == SYCL_SUCCESS ? 0 : -1;
+}
+
 void* SYCLMalloc(sycl::device* device, size_t ByteCount) {
   sycl::queue* stream;
   SYCLStreamPool::getDefaultStream(device, &stream);
 
+  // Driver allocations are slow and can stall the host for milliseconds, so
+  // they show up on the host threads of a profile.
+  tsl::profiler::TraceMe activity(
+      [&] {
+        return tsl::profiler::TraceMeEncode("SYCLMalloc",
+                                            {{"bytes", ByteCount}});
+      },
+      tsl::profiler::TraceMeLevel::kInfo);
+  auto start = std::chrono::steady_clock::now();
   // Always use default 0 stream to allocate mem
   auto ptr = aligned_alloc_device(/*alignment=*/64, ByteCount, *stream);
+  int64_t elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  if (ptr == nullptr) return nullptr;
+
+  DeviceMemoryTelemetry* telemetry = GetMemoryTelemetry(*device);
+  absl::MutexLock lock(&telemetry->mu);
+  SYCLMemoryStats& stats = telemetry->stats;
+  telemetry->sizes[ptr] = ByteCount;
+  ++stats.num_allocs;
+  stats.bytes_in_use += ByteCount;
+  stats.peak_bytes_in_use =
+      std::max(stats.peak_bytes_in_use, stats.bytes_in_use);
+  stats.largest_alloc_size =
+      std::max<int64_t>(stats.largest_alloc_size, ByteCount);
+  stats.malloc_time_ns += elapsed_ns;
+  stats.max_malloc_time_ns = std::max(stats.max_malloc_time_ns, elapsed_ns);
   return static_cast<void*>(ptr);
 }
 
@@ -487,6 +1305,11 @@ void* SYCLMallocHost(sycl::device* device, size_t ByteCount) {
   sycl::queue* stream;
   SYCLStreamPool::getDefaultStream(device, &stream);
 
+  // The pages are pinned as they are allocated, so they stay where the policy
+  // of the allocating thread puts them.
+  ScopedPreferredNumaNode numa_policy(
+      IsNumaAffinityEnabled() ? GetNumaNode(device) : -1);
+
   // Always use default 0 stream to allocate mem
   auto ptr = aligned_alloc_host(/*alignment=*/64, ByteCount, *stream);
   return static_cast<void*>(ptr);
@@ -505,10 +1328,133 @@ void SYCLFree(sycl::device* device, void* ptr) {
   sycl::queue* stream;
   SYCLStreamPool::getDefaultStream(device, &stream);
 
+  // Host and shared allocations are freed here too, they are not counted.
+  int64_t freed_bytes = 0;
+  {
+    DeviceMemoryTelemetry* telemetry = GetMemoryTelemetry(*device);
+    absl::MutexLock lock(&telemetry->mu);
+    auto it = telemetry->sizes.find(ptr);
+    if (it != telemetry->sizes.end()) {
+      freed_bytes = it->second;
+      telemetry->stats.bytes_in_use -= freed_bytes;
+      telemetry->sizes.erase(it);
+    }
+  }
+  tsl::profiler::TraceMe activity(
+      [&] {
+        return tsl::profiler::TraceMeEncode("SYCLFree",
+                                            {{"bytes", freed_bytes}});
+      },
+      tsl::profiler::TraceMeLevel::kInfo);
   // Always use default 0 stream to free mem
   sycl::free(ptr, *stream);
 }
 
+static ze_context_handle_t GetZeContext() {
+  return sycl::get_native<sycl::backend::ext_oneapi_level_zero>(
+      DevicePool::getDeviceContext());
+}
+
+SYCLError_t SYCLMallocIpc(sycl::device* device, size_t ByteCount, void** ptr) {
+  if (!RunOnLevelZero()) return SYCL_ERROR_ZE_ERROR;
+  ze_device_mem_alloc_desc_t desc{ZE_STRUCTURE_TYPE_DEVICE_MEM_ALLOC_DESC};
+  ze_result_t status = zeMemAllocDevice(
+      GetZeContext(), &desc, ByteCount, /*alignment=*/64,
+      sycl::get_native<sycl::backend::ext_oneapi_level_zero>(*device), ptr);
+  if (status != ZE_RESULT_SUCCESS) {
+    LOG(ERROR) << "zeMemAllocDevice Failed with return code: "
+               << std::to_string(status);
+    return SYCL_ERROR_ZE_ERROR;
+  }
+  return SYCL_SUCCESS;
+}
+
+SYCLError_t SYCLFreeIpc(void* ptr) {
+  ze_result_t status = zeMemFree(GetZeContext(), ptr);
+  if (status != ZE_RESULT_SUCCESS) {
+    LOG(ERROR) << "zeMemFree Failed with return code: "
+               << std::to_string(status);
+    return SYCL_ERROR_ZE_ERROR;
+  }
+  return SYCL_SUCCESS;
+}
+
+SYCLError_t SYCLGetPointerAddressRange(const void* ptr, void** base,
+                                       size_t* size) {
+  if (!RunOnLevelZero()) return SYCL_ERROR_ZE_ERROR;
+  ze_result_t status = zeMemGetAddressRange(GetZeContext(), ptr, base, size);
+  if (status != ZE_RESULT_SUCCESS) {
+    LOG(ERROR) << "zeMemGetAddressRange Failed with return code: "
+               << std::to_string(status);
+    return SYCL_ERROR_INVALID_POINTER;
+  }
+  return SYCL_SUCCESS;
+}
+
+SYCLError_t SYCLGetAllocationId(const void* ptr, uint64_t* id) {
+  if (!RunOnLevelZero()) return SYCL_ERROR_ZE_ERROR;
+  ze_memory_allocation_properties_t properties{
+      ZE_STRUCTURE_TYPE_MEMORY_ALLOCATION_PROPERTIES};
+  ze_result_t status = zeMemGetAllocProperties(
+      GetZeContext(), ptr, &properties, /*phDevice=*/nullptr);
+  if (status != ZE_RESULT_SUCCESS) {
+    LOG(ERROR) << "zeMemGetAllocProperties Failed with return code: "
+               << std::to_string(status);
+    return SYCL_ERROR_INVALID_POINTER;
+  }
+  *id = properties.id;
+  return SYCL_SUCCESS;
+}
+
+SYCLError_t SYCLGetIpcHandle(const void* ptr, ze_ipc_mem_handle_t* handle) {
+  void* base = nullptr;
+  size_t size = 0;
+  SYCLError_t res = SYCLGetPointerAddressRange(ptr, &base, &size);
+  if (res != SYCL_SUCCESS) return res;
+  ze_result_t status = zeMemGetIpcHandle(GetZeContext(), base, handle);
+  if (status != ZE_RESULT_SUCCESS) {
+    LOG(ERROR) << "zeMemGetIpcHandle Failed with return code: "
+               << std::to_string(status);
+    return SYCL_ERROR_ZE_ERROR;
+  }
+  return SYCL_SUCCESS;
+}
+
+SYCLError_t SYCLPutIpcHandle(const ze_ipc_mem_handle_t& handle) {
+  ze_result_t status = zeMemPutIpcHandle(GetZeContext(), handle);
+  if (status != ZE_RESULT_SUCCESS) {
+    LOG(ERROR) << "zeMemPutIpcHandle Failed with return code: "
+               << std::to_string(status);
+    return SYCL_ERROR_ZE_ERROR;
+  }
+  return SYCL_SUCCESS;
+}
+
+SYCLError_t SYCLOpenIpcHandle(sycl::device* device,
+                              const ze_ipc_mem_handle_t& handle, void** ptr) {
+  if (!RunOnLevelZero()) return SYCL_ERROR_ZE_ERROR;
+  ze_result_t status = zeMemOpenIpcHandle(
+      GetZeContext(),
+      sycl::get_native<sycl::backend::ext_oneapi_level_zero>(*device), handle,
+      /*flags=*/0, ptr);
+  if (status != ZE_RESULT_SUCCESS) {
+    LOG(ERROR) << "zeMemOpenIpcHandle Failed with return code: "
+               << std::to_string(status);
+    return SYCL_ERROR_ZE_ERROR;
+  }
+  return SYCL_SUCCESS;
+}
+
+SYCLError_t SYCLCloseIpcHandle(void* ptr) {
+  ze_result_t status = zeMemCloseIpcHandle(GetZeContext(), ptr);
+  if (status != ZE_RESULT_SUCCESS) {
+    LOG(ERROR) << "zeMemCloseIpcHandle Failed with return code: "
+               << std::to_string(status);
+    return SYCL_ERROR_ZE_ERROR;
+  }
+  return SYCL_SUCCESS;
+}
+
 sycl::event SYCLGetEventFromStream(sycl::queue* stream) {
   // FIXME(intel): Below WA caused backend mismatch error in OOB test,
   // need to fix it before reenabling.
@@ -521,12 +1467,63 @@ sycl::event SYCLGetEventFromStream(sycl::queue* stream) {
   return stream->ext_oneapi_submit_barrier();
 }
 
+#ifdef SYCL_EXT_ONEAPI_IN_ORDER_QUEUE_EVENTS
+namespace {
+
+// ext_oneapi_get_last_event returns an event in older runtimes and an empty
+// optional in newer ones when nothing was submitted yet.
+bool AsLastEvent(const sycl::event& in, sycl::event* out) {
+  *out = in;
+  return true;
+}
+
+bool AsLastEvent(const std::optional<sycl::event>& in, sycl::event* out) {
+  if (!in.has_value()) return false;
+  *out = *in;
+  return true;
+}
+
+}  // namespace
+#endif  // SYCL_EXT_ONEAPI_IN_ORDER_QUEUE_EVENTS
+
+sycl::event SYCLGetLastEventFromStream(sycl::queue* stream) {
+#ifdef SYCL_EXT_ONEAPI_IN_ORDER_QUEUE_EVENTS
+  sycl::event event;
+  if (stream->is_in_order() &&
+      AsLastEvent(stream->ext_oneapi_get_last_event(), &event)) {
+    return event;
+  }
+#endif
+  return SYCLGetEventFromStream(stream);
+}
+
+sycl::event SYCLGetTimedEventFromStream(sycl::queue* stream) {
+#ifdef SYCL_EXT_ONEAPI_PROFILING_TAG
+  if (!IsQueueProfilingEnabled()) {
+    return sycl::ext::oneapi::experimental::submit_profiling_tag(*stream);
+  }
+#endif
+  return SYCLGetEventFromStream(stream);
+}
+
+bool SYCLIsEventComplete(const sycl::event& event) {
+  return event.get_info<sycl::info::event::command_execution_status>() ==
+         sycl::info::event_command_status::complete;
+}
+
+bool SYCLIsStreamIdle(sycl::queue* stream) {
+#ifdef SYCL_EXT_ONEAPI_QUEUE_EMPTY
+  return stream->ext_oneapi_empty();
+#else
+  return SYCLIsEventComplete(SYCLGetLastEventFromStream(stream));
+#endif
+}
+
+// Waits on the device, a host task would only release the stream once the
+// host thread of the runtime got scheduled.
 void SYCLStreamDependOnEvents(sycl::queue* stream,
                               const std::vector<sycl::event>& events) {
-  stream->submit([&](sycl::handler& cgh) {
-    cgh.depends_on(events);
-    cgh.host_task([=]() {});
-  });
+  stream->ext_oneapi_submit_barrier(events);
 }
 
 
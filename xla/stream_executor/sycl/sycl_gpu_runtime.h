@@ -16,10 +16,13 @@ limitations under the License.
 #ifndef XLA_STREAM_EXECUTOR_SYCL_SYCL_GPU_RUNTIME_H_
 #define XLA_STREAM_EXECUTOR_SYCL_SYCL_GPU_RUNTIME_H_
 
+#include <functional>
 #include <string>
 #include <vector>
 
 #include "absl/strings/ascii.h"
+#include "level_zero/ze_api.h"
+#include "xla/stream_executor/sycl/sycl_memory_stats.h"
 
 #if __has_include(<sycl/sycl.hpp>)
 #include <sycl/sycl.hpp>
@@ -29,6 +32,17 @@ limitations under the License.
 #error "Unsupported compiler"
 #endif
 
+// Class of the link between two devices, ordered from the fastest to the
+// slowest one.
+enum SYCLLinkClass_t {
+  SYCL_LINK_SAME_DEVICE,
+  // Tiles of the same card, connected by the on-package link.
+  SYCL_LINK_SAME_CARD,
+  // Cards connected through the Level-Zero fabric, i.e. Xe Link.
+  SYCL_LINK_FABRIC,
+  SYCL_LINK_PCIE,
+};
+
 enum SYCLError_t {
   SYCL_SUCCESS,
   SYCL_ERROR_NO_DEVICE,
@@ -42,6 +56,15 @@ enum SYCLError_t {
 
 bool IsMultipleStreamEnabled();
 
+// Returns whether SYCL_TILE_AS_DEVICE=false, in which every device is a root
+// device whose kernels and allocations Level-Zero spreads over its tiles.
+bool IsImplicitScalingEnabled();
+
+// Returns whether queues stamp every command. Timed events stamp themselves
+// with profiling tags when the runtime supports them, so the queues only do
+// if XLA_SYCL_QUEUE_PROFILING is set.
+bool IsQueueProfilingEnabled();
+
 const char* ToString(SYCLError_t error);
 
 SYCLError_t SYCLGetContext(sycl::context** context);
@@ -53,10 +76,89 @@ SYCLError_t SYCLGetDevice(sycl::device** device, int device_ordinal);
 SYCLError_t SYCLGetFrequency(sycl::device* device_handle, uint64_t* freq,
                              uint64_t* mask);
 
-SYCLError_t SYCLCreateStream(sycl::device* device_handle, sycl::queue** stream);
+SYCLError_t SYCLGetLinkClass(sycl::device* device_a, sycl::device* device_b,
+                             SYCLLinkClass_t* link_class);
+
+// Whether kernels and copies on `device` can access the device memory of
+// `peer` directly, as reported by zeDeviceCanAccessPeer. Devices of the pool
+// share one context, so accessible peers need no further setup.
+SYCLError_t SYCLCanAccessPeer(sycl::device* device, sycl::device* peer,
+                              bool* can_access);
+
+// Where a device sits in the system: the card it is a tile of, the host it is
+// attached to and the devices it reaches over Xe Link.
+struct SYCLDeviceTopology {
+  // Index of the root device (card) among the root devices of the pool.
+  int root_device_index = 0;
+  // Index of the tile within its root device, or -1 for a root device.
+  int tile_index = -1;
+  // PCI address of the root device as "domain:bus:device.function", or empty
+  // if the driver does not report it.
+  std::string pci_address;
+  // NUMA node the root device is attached to, or -1 if unknown.
+  int numa_node = -1;
+  // Ordinals of the devices of other cards connected by Xe Link.
+  std::vector<int> fabric_peers;
+};
+
+SYCLError_t SYCLGetDeviceTopology(int device_ordinal,
+                                  SYCLDeviceTopology* topology);
+
+// Restricts the calling thread to the CPUs of `numa_node` it is allowed to run
+// on. Returns false and leaves the thread as is if there are none.
+bool SYCLBindThreadToNumaNode(int numa_node);
+
+// Execution resources of a device. The counts of a root device spanning
+// several tiles in implicit scaling mode are summed over its tiles, so that
+// launches sized from them fill all the tiles.
+struct SYCLComputeResources {
+  // Tiles the work groups of a kernel are spread over.
+  int tile_count = 1;
+  // Xe cores, i.e. sub-slices.
+  int core_count = 0;
+  // Execution units (Xe vector engines).
+  int eu_count = 0;
+};
+
+SYCLError_t SYCLGetComputeResources(const sycl::device& device,
+                                    SYCLComputeResources* resources);
+
+// Resources a compiled kernel uses, as reported by Level-Zero.
+struct SYCLKernelProperties {
+  // Static shared local memory of a work group, without the dynamic part.
+  uint32_t local_mem_size = 0;
+  // Private memory of a work item, including its register spills.
+  uint32_t private_mem_size = 0;
+  // Scratch memory of a hardware thread for the registers it spills.
+  uint32_t spill_mem_size = 0;
+  // SIMD width the kernel was compiled for.
+  uint32_t max_subgroup_size = 0;
+  // Largest number of sub-groups a work group of the kernel can have.
+  uint32_t max_num_subgroups = 0;
+  // General registers of a hardware thread: 128, or 256 for kernels compiled
+  // in large GRF mode, which run half the threads per execution unit.
+  uint32_t registers_per_thread = 0;
+};
+
+SYCLError_t SYCLGetKernelProperties(const sycl::kernel& kernel,
+                                    const sycl::device& device,
+                                    SYCLKernelProperties* properties);
+
+// Creates the default streams of all devices, which are otherwise created on
+// first use.
+SYCLError_t SYCLInitStreamPool();
+
+// Creates a stream with `priority`, higher values for higher priorities.
+SYCLError_t SYCLCreateStream(sycl::device* device_handle, sycl::queue** stream,
+                             int priority = 0);
 
 SYCLError_t SYCLDestroyStream(sycl::device* device_handle, sycl::queue* stream);
 
+// Registers `callback` to run with the queue of every stream destroyed from
+// now on, before the queue is handed to another stream. Callbacks run under
+// the stream pool lock and must not create or destroy streams.
+void SYCLAddStreamDestroyCallback(std::function<void(sycl::queue*)> callback);
+
 SYCLError_t SYCLCtxSynchronize(sycl::device* device_handle);
 
 SYCLError_t SYCLMemcpyDtoH(void* dstHost, const void* srcDevice,
@@ -91,14 +193,64 @@ SYCLError_t SYCLMemsetD32Async(void* dstDevice, unsigned int ui, size_t N,
 
 void* SYCLMalloc(sycl::device* device, size_t ByteCount);
 
+// See SYCLMemoryStats.
+SYCLError_t SYCLGetMemoryStats(sycl::device* device, SYCLMemoryStats* stats);
+
+// Allocates USM host memory, preferably on the NUMA node of `device` unless
+// XLA_SYCL_NUMA_AFFINITY is false.
 void* SYCLMallocHost(sycl::device* device, size_t ByteCount);
 
 void* SYCLMallocShared(sycl::device* device, size_t ByteCount);
 
 void SYCLFree(sycl::device* device, void* ptr);
 
+// Allocates device memory that other processes can map with its IPC handle.
+// Unlike SYCLMalloc, which may sub-allocate from a pool of the SYCL runtime,
+// the allocation is a Level-Zero allocation of its own.
+SYCLError_t SYCLMallocIpc(sycl::device* device, size_t ByteCount, void** ptr);
+
+SYCLError_t SYCLFreeIpc(void* ptr);
+
+// Returns the base address and the size of the allocation containing `ptr`.
+SYCLError_t SYCLGetPointerAddressRange(const void* ptr, void** base,
+                                       size_t* size);
+
+// Returns the Level-Zero id of the allocation containing `ptr`, which tells
+// apart allocations that reuse the same address range.
+SYCLError_t SYCLGetAllocationId(const void* ptr, uint64_t* id);
+
+// Returns the IPC handle of the allocation containing `ptr`, which must be
+// allocated by SYCLMallocIpc.
+SYCLError_t SYCLGetIpcHandle(const void* ptr, ze_ipc_mem_handle_t* handle);
+
+// Releases an IPC handle returned by SYCLGetIpcHandle.
+SYCLError_t SYCLPutIpcHandle(const ze_ipc_mem_handle_t& handle);
+
+// Maps the allocation of an IPC handle of another process for `device`.
+SYCLError_t SYCLOpenIpcHandle(sycl::device* device,
+                              const ze_ipc_mem_handle_t& handle, void** ptr);
+
+SYCLError_t SYCLCloseIpcHandle(void* ptr);
+
 sycl::event SYCLGetEventFromStream(sycl::queue* stream);
 
+// Like SYCLGetEventFromStream, but returns the event of the last command of an
+// in-order stream when the runtime supports it instead of submitting a
+// barrier. The event has no timestamps of its own, so it must not be used to
+// time the stream.
+sycl::event SYCLGetLastEventFromStream(sycl::queue* stream);
+
+// Returns an event whose completion time marks the point of `stream` it was
+// taken at, for the events of GpuTimer.
+sycl::event SYCLGetTimedEventFromStream(sycl::queue* stream);
+
+// Returns whether `event` completed, without waiting for it.
+bool SYCLIsEventComplete(const sycl::event& event);
+
+// Returns whether all the work submitted to `stream` completed, without
+// waiting for it.
+bool SYCLIsStreamIdle(sycl::queue* stream);
+
 void SYCLStreamDependOnEvents(sycl::queue* stream,
                               const std::vector<sycl::event>& events);
 
@@ -0,0 +1,293 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/stream_executor/sycl/sycl_graph.h"
+
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/logging.h"
+#include "tsl/platform/statusor.h"
+
+namespace stream_executor {
+namespace gpu {
+
+namespace {
+
+const char* ToString(SYCLGraphNodeKind kind) {
+  switch (kind) {
+    case SYCLGraphNodeKind::kEmpty:
+      return "empty";
+    case SYCLGraphNodeKind::kKernel:
+      return "kernel";
+    case SYCLGraphNodeKind::kMemcpy:
+      return "memcpy";
+    case SYCLGraphNodeKind::kMemset:
+      return "memset";
+    case SYCLGraphNodeKind::kChildGraph:
+      return "graph";
+  }
+  return "unknown";
+}
+
+void AddMemsetCommand(::sycl::handler& cgh, const SYCLGraphNode& node) {
+  if (std::holds_alternative<uint8_t>(node.bit_pattern)) {
+    cgh.memset(node.dst, std::get<uint8_t>(node.bit_pattern), node.size);
+  } else if (std::holds_alternative<uint16_t>(node.bit_pattern)) {
+    cgh.fill(static_cast<uint16_t*>(node.dst),
+             std::get<uint16_t>(node.bit_pattern), node.size);
+  } else {
+    cgh.fill(static_cast<uint32_t*>(node.dst),
+             std::get<uint32_t>(node.bit_pattern), node.size);
+  }
+}
+
+}  // namespace
+
+/***************************** SYCLGraph *****************************/
+
+SYCLGraphNode* SYCLGraph::AddNode(
+    SYCLGraphNodeKind kind, const std::vector<const SYCLGraphNode*>& deps) {
+  auto node = std::make_unique<SYCLGraphNode>();
+  node->kind = kind;
+  node->index = nodes_.size();
+  node->deps.reserve(deps.size());
+  for (const SYCLGraphNode* dep : deps) {
+    DCHECK_LT(dep->index, node->index);
+    node->deps.push_back(dep->index);
+  }
+  nodes_.push_back(std::move(node));
+  return nodes_.back().get();
+}
+
+absl::Status SYCLGraph::BeginRecording(::sycl::queue* stream) {
+  if (!nodes_.empty() || recorded_ != nullptr) {
+    return absl::InternalError(
+        "SYCL graph capture requires an empty graph");
+  }
+  try {
+    recorded_ = std::make_unique<SYCLModifiableGraph>(stream->get_context(),
+                                                      stream->get_device());
+    recorded_->begin_recording(*stream);
+  } catch (const ::sycl::exception& e) {
+    recorded_.reset();
+    return absl::InternalError(
+        absl::StrCat("Failed to begin SYCL graph recording: ", e.what()));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status SYCLGraph::EndRecording(::sycl::queue* stream) {
+  if (recorded_ == nullptr) {
+    return absl::InternalError("SYCL graph is not being recorded");
+  }
+  try {
+    recorded_->end_recording(*stream);
+  } catch (const ::sycl::exception& e) {
+    return absl::InternalError(
+        absl::StrCat("Failed to end SYCL graph recording: ", e.what()));
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<std::unique_ptr<SYCLModifiableGraph>> SYCLGraph::Materialize(
+    const std::vector<std::unique_ptr<SYCLGraphNode>>& nodes,
+    const ::sycl::context& context, const ::sycl::device& device,
+    std::vector<std::unique_ptr<SYCLExecutableGraph>>* children) const {
+  if (recorded_ != nullptr) {
+    return absl::InternalError("Recorded SYCL graphs can't be materialized");
+  }
+
+  auto graph = std::make_unique<SYCLModifiableGraph>(context, device);
+  std::vector<sycl_ext::node> sycl_nodes;
+  sycl_nodes.reserve(nodes.size());
+
+  try {
+    for (const auto& node : nodes) {
+      // Disabled nodes are kept as empty nodes to preserve the dependencies.
+      SYCLGraphNodeKind kind =
+          node->enabled ? node->kind : SYCLGraphNodeKind::kEmpty;
+      switch (kind) {
+        case SYCLGraphNodeKind::kEmpty:
+          sycl_nodes.push_back(graph->add());
+          break;
+        case SYCLGraphNodeKind::kKernel: {
+          ::sycl::nd_range<3> range(node->global_range, node->local_range);
+          sycl_nodes.push_back(graph->add([&](::sycl::handler& cgh) {
+            for (uint32_t i = 0; i < node->args.size(); i++) {
+              SetKernelArg(cgh, i, node->args[i]);
+            }
+            cgh.parallel_for(range, *node->function);
+          }));
+          break;
+        }
+        case SYCLGraphNodeKind::kMemcpy:
+          sycl_nodes.push_back(graph->add([&](::sycl::handler& cgh) {
+            cgh.memcpy(node->dst, node->src, node->size);
+          }));
+          break;
+        case SYCLGraphNodeKind::kMemset:
+          sycl_nodes.push_back(graph->add(
+              [&](::sycl::handler& cgh) { AddMemsetCommand(cgh, *node); }));
+          break;
+        case SYCLGraphNodeKind::kChildGraph: {
+          std::unique_ptr<SYCLExecutableGraph> child_exec;
+          if (node->child->is_recorded()) {
+            child_exec = std::make_unique<SYCLExecutableGraph>(
+                node->child->recorded_->finalize());
+          } else {
+            TF_ASSIGN_OR_RETURN(
+                auto child_graph,
+                node->child->Materialize(node->child->nodes(), context,
+                                         device, children));
+            child_exec = std::make_unique<SYCLExecutableGraph>(
+                child_graph->finalize());
+          }
+          SYCLExecutableGraph* child_ptr = child_exec.get();
+          children->push_back(std::move(child_exec));
+          sycl_nodes.push_back(graph->add([&](::sycl::handler& cgh) {
+            cgh.ext_oneapi_graph(*child_ptr);
+          }));
+          break;
+        }
+      }
+      for (size_t dep : node->deps) {
+        graph->make_edge(sycl_nodes[dep], sycl_nodes.back());
+      }
+    }
+  } catch (const ::sycl::exception& e) {
+    return absl::InternalError(
+        absl::StrCat("Failed to build SYCL graph: ", e.what()));
+  }
+
+  return graph;
+}
+
+std::string SYCLGraph::ToDot() const {
+  std::string dot = "digraph SYCLGraph {\n";
+  if (recorded_ != nullptr) {
+    absl::StrAppend(&dot, "  recorded [label=\"recorded graph\"];\n");
+  }
+  for (const auto& node : nodes_) {
+    absl::StrAppendFormat(&dot, "  n%d [label=\"%d: %s%s\"];\n", node->index,
+                          node->index, ToString(node->kind),
+                          node->enabled ? "" : " (disabled)");
+    for (size_t dep : node->deps) {
+      absl::StrAppendFormat(&dot, "  n%d -> n%d;\n", dep, node->index);
+    }
+  }
+  absl::StrAppend(&dot, "}\n");
+  return dot;
+}
+
+/***************************** SYCLGraphExec *****************************/
+
+SYCLGraphExec::SYCLGraphExec(const SYCLGraph* graph) : graph_(graph) {
+  nodes_.reserve(graph->nodes().size());
+  for (const auto& node : graph->nodes()) {
+    nodes_.push_back(std::make_unique<SYCLGraphNode>(*node));
+  }
+}
+
+absl::Status SYCLGraphExec::Update(const SYCLGraph* graph) {
+  absl::MutexLock lock(&mu_);
+  if (graph->is_recorded() != graph_->is_recorded() ||
+      graph->nodes().size() != nodes_.size()) {
+    return absl::InternalError("SYCL graph topology changed");
+  }
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    const SYCLGraphNode& node = *graph->nodes()[i];
+    if (node.kind != nodes_[i]->kind || node.deps != nodes_[i]->deps) {
+      return absl::InternalError("SYCL graph topology changed");
+    }
+  }
+
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    *nodes_[i] = *graph->nodes()[i];
+  }
+  graph_ = graph;
+  dirty_ = true;
+  return absl::OkStatus();
+}
+
+absl::Status SYCLGraphExec::UpdateNode(
+    const SYCLGraphNode* graph_node,
+    absl::FunctionRef<absl::Status(SYCLGraphNode&)> update) {
+  absl::MutexLock lock(&mu_);
+  CHECK_LT(graph_node->index, nodes_.size());
+  // Any mutation of a node requires the executable graph to be updated.
+  dirty_ = true;
+  return update(*nodes_[graph_node->index]);
+}
+
+absl::Status SYCLGraphExec::Finalize(::sycl::queue* stream) {
+  if (graph_->is_recorded()) {
+    executable_ = std::make_unique<SYCLExecutableGraph>(
+        graph_->recorded_->finalize());
+    device_ = stream->get_device();
+    dirty_ = false;
+    return absl::OkStatus();
+  }
+
+  std::vector<std::unique_ptr<SYCLExecutableGraph>> children;
+  TF_ASSIGN_OR_RETURN(
+      auto graph, graph_->Materialize(nodes_, stream->get_context(),
+                                      stream->get_device(), &children));
+
+  try {
+    // Updating an executable graph in place is much cheaper than finalizing
+    // a new one, fall back to finalization if the update is rejected.
+    bool updated = false;
+    if (executable_ != nullptr && device_ == stream->get_device()) {
+      try {
+        executable_->update(*graph);
+        updated = true;
+      } catch (const ::sycl::exception& e) {
+        VLOG(2) << "SYCL graph update failed, finalizing again: " << e.what();
+      }
+    }
+    if (!updated) {
+      executable_ = std::make_unique<SYCLExecutableGraph>(
+          graph->finalize({sycl_ext::property::graph::updatable{}}));
+    }
+  } catch (const ::sycl::exception& e) {
+    return absl::InternalError(
+        absl::StrCat("Failed to finalize SYCL graph: ", e.what()));
+  }
+
+  children_ = std::move(children);
+  device_ = stream->get_device();
+  dirty_ = false;
+  return absl::OkStatus();
+}
+
+absl::Status SYCLGraphExec::Launch(::sycl::queue* stream) {
+  absl::MutexLock lock(&mu_);
+  if (dirty_ || executable_ == nullptr || device_ != stream->get_device()) {
+    TF_RETURN_IF_ERROR(Finalize(stream));
+  }
+  try {
+    stream->ext_oneapi_graph(*executable_);
+  } catch (const ::sycl::exception& e) {
+    return absl::InternalError(
+        absl::StrCat("Failed to launch SYCL graph: ", e.what()));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace gpu
+}  // namespace stream_executor
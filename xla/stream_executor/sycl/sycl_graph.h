@@ -0,0 +1,155 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_STREAM_EXECUTOR_SYCL_SYCL_GRAPH_H_
+#define XLA_STREAM_EXECUTOR_SYCL_SYCL_GRAPH_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "xla/stream_executor/sycl/sycl_gpu_runtime.h"
+#include "xla/stream_executor/sycl/sycl_kernel_args.h"
+
+namespace stream_executor {
+namespace gpu {
+
+namespace sycl_ext = ::sycl::ext::oneapi::experimental;
+
+using SYCLModifiableGraph =
+    sycl_ext::command_graph<sycl_ext::graph_state::modifiable>;
+using SYCLExecutableGraph =
+    sycl_ext::command_graph<sycl_ext::graph_state::executable>;
+
+class SYCLGraph;
+
+enum class SYCLGraphNodeKind {
+  kEmpty,
+  kKernel,
+  kMemcpy,
+  kMemset,
+  kChildGraph,
+};
+
+// A single node of a SYCL command buffer. Nodes only describe the work, the
+// actual sycl_ext_oneapi_graph nodes are materialized at instantiation time
+// because XLA creates graphs before it knows which queue they will run on.
+struct SYCLGraphNode {
+  SYCLGraphNodeKind kind = SYCLGraphNodeKind::kEmpty;
+  // Position of the node in the owning graph, also used to find the node in
+  // executable graphs instantiated from it.
+  size_t index = 0;
+  // Indices of the nodes this node depends on. Always smaller than `index`.
+  std::vector<size_t> deps;
+  bool enabled = true;
+
+  // kKernel
+  ::sycl::kernel* function = nullptr;
+  ::sycl::range<3> global_range{1, 1, 1};
+  ::sycl::range<3> local_range{1, 1, 1};
+  std::vector<SYCLKernelArg> args;
+
+  // kMemcpy and kMemset
+  void* dst = nullptr;
+  const void* src = nullptr;
+  uint64_t size = 0;
+  std::variant<uint8_t, uint16_t, uint32_t> bit_pattern;
+
+  // kChildGraph, not owned.
+  const SYCLGraph* child = nullptr;
+};
+
+// Recipe of a command buffer. A graph is either built node by node through
+// the explicit GpuDriver::GraphAdd* API, or recorded from a queue between
+// StreamBeginCapture and StreamEndCapture.
+class SYCLGraph {
+ public:
+  SYCLGraph() = default;
+
+  SYCLGraphNode* AddNode(SYCLGraphNodeKind kind,
+                         const std::vector<const SYCLGraphNode*>& deps);
+
+  // Starts recording of all commands submitted to `stream` into this graph.
+  absl::Status BeginRecording(::sycl::queue* stream);
+  absl::Status EndRecording(::sycl::queue* stream);
+  bool is_recorded() const { return recorded_ != nullptr; }
+
+  const std::vector<std::unique_ptr<SYCLGraphNode>>& nodes() const {
+    return nodes_;
+  }
+
+  // Builds a modifiable sycl graph for `device` from the recorded nodes.
+  // Executable child graphs are appended to `children` and must outlive the
+  // returned graph.
+  absl::StatusOr<std::unique_ptr<SYCLModifiableGraph>> Materialize(
+      const std::vector<std::unique_ptr<SYCLGraphNode>>& nodes,
+      const ::sycl::context& context, const ::sycl::device& device,
+      std::vector<std::unique_ptr<SYCLExecutableGraph>>* children) const;
+
+  std::string ToDot() const;
+
+ private:
+  friend class SYCLGraphExec;
+
+  std::vector<std::unique_ptr<SYCLGraphNode>> nodes_;
+  // Set only for graphs captured from a queue.
+  std::unique_ptr<SYCLModifiableGraph> recorded_;
+};
+
+// Instantiated command buffer. Owns a copy of the node parameters so that
+// updates to the executable graph do not change the graph it was created from.
+class SYCLGraphExec {
+ public:
+  explicit SYCLGraphExec(const SYCLGraph* graph);
+
+  // Replaces node parameters with the ones of `graph`. Fails if `graph` has a
+  // different topology.
+  absl::Status Update(const SYCLGraph* graph);
+
+  // Applies `update` to the copy of `graph_node` owned by this executable
+  // graph, which is finalized again at the next launch.
+  absl::Status UpdateNode(
+      const SYCLGraphNode* graph_node,
+      absl::FunctionRef<absl::Status(SYCLGraphNode&)> update);
+
+  // Submits the executable graph to `stream`, (re)finalizing it first if node
+  // parameters changed since the last launch.
+  absl::Status Launch(::sycl::queue* stream);
+
+ private:
+  absl::Status Finalize(::sycl::queue* stream)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  absl::Mutex mu_;
+  const SYCLGraph* graph_ ABSL_GUARDED_BY(mu_);
+  std::vector<std::unique_ptr<SYCLGraphNode>> nodes_ ABSL_GUARDED_BY(mu_);
+  bool dirty_ ABSL_GUARDED_BY(mu_) = true;
+  std::optional<::sycl::device> device_ ABSL_GUARDED_BY(mu_);
+  std::unique_ptr<SYCLExecutableGraph> executable_ ABSL_GUARDED_BY(mu_);
+  std::vector<std::unique_ptr<SYCLExecutableGraph>> children_
+      ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace gpu
+}  // namespace stream_executor
+
+#endif  // XLA_STREAM_EXECUTOR_SYCL_SYCL_GRAPH_H_
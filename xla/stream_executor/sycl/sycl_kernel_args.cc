@@ -0,0 +1,245 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/stream_executor/sycl/sycl_kernel_args.h"
+
+#include <cstring>
+#include <optional>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "tsl/platform/logging.h"
+
+namespace stream_executor {
+namespace gpu {
+
+namespace {
+
+// SPIR-V opcodes and operands of the instructions describing the signature of
+// an entry point, see the SPIR-V specification.
+constexpr uint32_t kSpirvMagic = 0x07230203;
+constexpr uint32_t kSpirvHeaderWords = 5;
+constexpr uint32_t kOpMemoryModel = 14;
+constexpr uint32_t kOpEntryPoint = 15;
+constexpr uint32_t kOpTypeInt = 21;
+constexpr uint32_t kOpTypeFloat = 22;
+constexpr uint32_t kOpTypeVector = 23;
+constexpr uint32_t kOpTypePointer = 32;
+constexpr uint32_t kOpFunction = 54;
+constexpr uint32_t kOpFunctionParameter = 55;
+constexpr uint32_t kOpFunctionEnd = 56;
+constexpr uint32_t kOpDecorate = 71;
+constexpr uint32_t kOpTypeUntypedPointerKHR = 4417;
+constexpr uint32_t kAddressingModelPhysical32 = 1;
+constexpr uint32_t kExecutionModelKernel = 6;
+constexpr uint32_t kDecorationFuncParamAttr = 38;
+constexpr uint32_t kFunctionParameterAttributeByVal = 2;
+
+struct KernelArgRegistry {
+  absl::Mutex mu;
+  absl::flat_hash_map<const ::sycl::kernel*, std::vector<SYCLKernelArgInfo>>
+      args ABSL_GUARDED_BY(mu);
+};
+
+KernelArgRegistry& GetKernelArgRegistry() {
+  static auto* registry = new KernelArgRegistry();
+  return *registry;
+}
+
+template <typename T>
+void SetKernelArgAs(::sycl::handler& cgh, uint32_t index,
+                    const SYCLKernelArg& arg) {
+  T value;
+  std::memcpy(&value, arg.value.data(), sizeof(T));
+  cgh.set_arg(index, value);
+}
+
+struct Bytes16 {
+  uint64_t words[2];
+};
+
+bool IsSupportedArgSize(uint32_t size) {
+  return size == 1 || size == 2 || size == 4 || size == 8 || size == 16;
+}
+
+}  // namespace
+
+absl::StatusOr<std::vector<SYCLKernelArgInfo>> GetSpirvKernelArgs(
+    absl::Span<const char> spirv, absl::string_view kernel_name) {
+  if (spirv.size() % sizeof(uint32_t) != 0 ||
+      spirv.size() < kSpirvHeaderWords * sizeof(uint32_t)) {
+    return absl::InvalidArgumentError("Malformed SPIR-V module");
+  }
+  std::vector<uint32_t> words(spirv.size() / sizeof(uint32_t));
+  std::memcpy(words.data(), spirv.data(), spirv.size());
+  if (words[0] != kSpirvMagic) {
+    return absl::InvalidArgumentError("Not a SPIR-V module");
+  }
+
+  uint32_t pointer_size = 8;
+  std::optional<uint32_t> entry_point;
+  absl::flat_hash_map<uint32_t, SYCLKernelArgInfo> types;
+  absl::flat_hash_set<uint32_t> by_value;
+  bool in_entry_point = false;
+  std::vector<SYCLKernelArgInfo> args;
+
+  for (size_t pos = kSpirvHeaderWords; pos < words.size();) {
+    uint32_t num_words = words[pos] >> 16;
+    uint32_t opcode = words[pos] & 0xffff;
+    if (num_words == 0 || pos + num_words > words.size()) {
+      return absl::InvalidArgumentError("Malformed SPIR-V instruction");
+    }
+    const uint32_t* ops = &words[pos + 1];
+    uint32_t num_ops = num_words - 1;
+    pos += num_words;
+
+    switch (opcode) {
+      case kOpMemoryModel:
+        if (num_ops >= 1 && ops[0] == kAddressingModelPhysical32) {
+          pointer_size = 4;
+        }
+        break;
+      case kOpEntryPoint: {
+        if (num_ops < 3 || ops[0] != kExecutionModelKernel) break;
+        const char* name = reinterpret_cast<const char*>(&ops[2]);
+        size_t max_len = (num_ops - 2) * sizeof(uint32_t);
+        if (absl::string_view(name, strnlen(name, max_len)) == kernel_name) {
+          entry_point = ops[1];
+        }
+        break;
+      }
+      case kOpDecorate:
+        if (num_ops >= 3 && ops[1] == kDecorationFuncParamAttr &&
+            ops[2] == kFunctionParameterAttributeByVal) {
+          by_value.insert(ops[0]);
+        }
+        break;
+      case kOpTypeInt:
+      case kOpTypeFloat:
+        if (num_ops >= 2) types[ops[0]] = {ops[1] / 8, false};
+        break;
+      case kOpTypeVector:
+        if (num_ops >= 3 && types.contains(ops[1])) {
+          // Three component vectors are laid out as four component ones.
+          uint32_t count = ops[2] == 3 ? 4 : ops[2];
+          types[ops[0]] = {types[ops[1]].size * count, false};
+        }
+        break;
+      case kOpTypePointer:
+      case kOpTypeUntypedPointerKHR:
+        if (num_ops >= 1) types[ops[0]] = {pointer_size, true};
+        break;
+      case kOpFunction:
+        in_entry_point = num_ops >= 2 && entry_point == ops[1];
+        break;
+      case kOpFunctionParameter: {
+        if (!in_entry_point || num_ops < 2) break;
+        auto it = types.find(ops[0]);
+        if (it == types.end() || by_value.contains(ops[1])) {
+          return absl::UnimplementedError(absl::StrCat(
+              "Argument ", args.size(), " of SPIR-V kernel ", kernel_name,
+              " is not a scalar, vector or pointer"));
+        }
+        args.push_back(it->second);
+        break;
+      }
+      case kOpFunctionEnd:
+        if (in_entry_point) return args;
+        break;
+      default:
+        break;
+    }
+  }
+  return absl::NotFoundError(
+      absl::StrCat("SPIR-V module has no kernel ", kernel_name));
+}
+
+void RegisterKernelArgs(const ::sycl::kernel* kernel,
+                        std::vector<SYCLKernelArgInfo> args) {
+  KernelArgRegistry& registry = GetKernelArgRegistry();
+  absl::MutexLock lock(&registry.mu);
+  registry.args[kernel] = std::move(args);
+}
+
+void UnregisterKernelArgs(const ::sycl::kernel* kernel) {
+  KernelArgRegistry& registry = GetKernelArgRegistry();
+  absl::MutexLock lock(&registry.mu);
+  registry.args.erase(kernel);
+}
+
+absl::StatusOr<std::vector<SYCLKernelArg>> PackKernelArgs(
+    const ::sycl::kernel* kernel, void** kernel_params) {
+  std::vector<SYCLKernelArg> args;
+  if (kernel_params == nullptr) return args;
+
+  KernelArgRegistry& registry = GetKernelArgRegistry();
+  absl::MutexLock lock(&registry.mu);
+  auto it = registry.args.find(kernel);
+  if (it == registry.args.end()) {
+    return absl::InternalError(
+        "Arguments of the SYCL kernel are unknown, it was not loaded from a "
+        "SPIR-V module");
+  }
+  args.resize(it->second.size());
+  for (size_t i = 0; i < args.size(); ++i) {
+    const SYCLKernelArgInfo& info = it->second[i];
+    if (!IsSupportedArgSize(info.size)) {
+      return absl::UnimplementedError(
+          absl::StrCat("Unsupported SYCL kernel argument size ", info.size));
+    }
+    std::memcpy(args[i].value.data(), kernel_params[i], info.size);
+    args[i].info = info;
+  }
+  return args;
+}
+
+std::vector<SYCLKernelArg> PackPointerKernelArgs(
+    absl::Span<void* const> ptrs) {
+  std::vector<SYCLKernelArg> args(ptrs.size());
+  for (size_t i = 0; i < ptrs.size(); ++i) {
+    std::memcpy(args[i].value.data(), &ptrs[i], sizeof(void*));
+    args[i].info = {sizeof(void*), true};
+  }
+  return args;
+}
+
+void SetKernelArg(::sycl::handler& cgh, uint32_t index,
+                  const SYCLKernelArg& arg) {
+  if (arg.info.is_pointer) {
+    return SetKernelArgAs<void*>(cgh, index, arg);
+  }
+  switch (arg.info.size) {
+    case 1:
+      return SetKernelArgAs<uint8_t>(cgh, index, arg);
+    case 2:
+      return SetKernelArgAs<uint16_t>(cgh, index, arg);
+    case 4:
+      return SetKernelArgAs<uint32_t>(cgh, index, arg);
+    case 8:
+      return SetKernelArgAs<uint64_t>(cgh, index, arg);
+    case 16:
+      return SetKernelArgAs<Bytes16>(cgh, index, arg);
+    default:
+      LOG(FATAL) << "Unsupported SYCL kernel argument size " << arg.info.size;
+  }
+}
+
+}  // namespace gpu
+}  // namespace stream_executor
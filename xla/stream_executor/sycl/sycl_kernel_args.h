@@ -0,0 +1,68 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_STREAM_EXECUTOR_SYCL_SYCL_KERNEL_ARGS_H_
+#define XLA_STREAM_EXECUTOR_SYCL_SYCL_KERNEL_ARGS_H_
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "xla/stream_executor/sycl/sycl_gpu_runtime.h"
+
+namespace stream_executor {
+namespace gpu {
+
+struct SYCLKernelArgInfo {
+  uint32_t size = 0;
+  // Pointers are set as USM pointers, everything else by value.
+  bool is_pointer = false;
+};
+
+// Value of a kernel argument, copied out of the storage of the caller.
+struct SYCLKernelArg {
+  alignas(16) std::array<uint8_t, 16> value;
+  SYCLKernelArgInfo info;
+};
+
+// Returns the arguments of the kernel `kernel_name` of the SPIR-V module
+// `spirv`, as declared by its entry point.
+absl::StatusOr<std::vector<SYCLKernelArgInfo>> GetSpirvKernelArgs(
+    absl::Span<const char> spirv, absl::string_view kernel_name);
+
+// SYCL can't reflect on the arguments of a kernel, they are recorded when the
+// kernel is loaded and dropped when it is unloaded.
+void RegisterKernelArgs(const ::sycl::kernel* kernel,
+                        std::vector<SYCLKernelArgInfo> args);
+void UnregisterKernelArgs(const ::sycl::kernel* kernel);
+
+// Copies the arguments of `kernel` from `kernel_params`, an array of pointers
+// to argument values as passed to cuLaunchKernel.
+absl::StatusOr<std::vector<SYCLKernelArg>> PackKernelArgs(
+    const ::sycl::kernel* kernel, void** kernel_params);
+
+// Wraps device pointers, the only arguments of kernels emitted by XLA.
+std::vector<SYCLKernelArg> PackPointerKernelArgs(absl::Span<void* const> ptrs);
+
+void SetKernelArg(::sycl::handler& cgh, uint32_t index,
+                  const SYCLKernelArg& arg);
+
+}  // namespace gpu
+}  // namespace stream_executor
+
+#endif  // XLA_STREAM_EXECUTOR_SYCL_SYCL_KERNEL_ARGS_H_
@@ -0,0 +1,145 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Host overheads of the SYCL stream executor: kernel launches through
+// GpuExecutor::Launch, as every fusion does, and event records. Times are
+// wall times of the submitting thread.
+
+#include <cstdint>
+#include <memory>
+
+#include "absl/types/span.h"
+#include "benchmark/benchmark.h"
+#include "tsl/platform/logging.h"
+#include "tsl/platform/status.h"
+#include "xla/stream_executor/device_memory.h"
+#include "xla/stream_executor/event.h"
+#include "xla/stream_executor/gpu/gpu_executor.h"
+#include "xla/stream_executor/gpu/gpu_kernel.h"
+#include "xla/stream_executor/gpu/gpu_stream.h"
+#include "xla/stream_executor/kernel.h"
+#include "xla/stream_executor/launch_dim.h"
+#include "xla/stream_executor/platform_manager.h"
+#include "xla/stream_executor/stream.h"
+#include "xla/stream_executor/stream_executor.h"
+
+namespace stream_executor {
+namespace gpu {
+namespace {
+
+class EmptyKernel;
+
+// Commands submitted without synchronization before the stream is drained,
+// which bounds the memory of the pending commands.
+constexpr int64_t kMaxPendingCommands = 4096;
+
+struct LaunchFixture {
+  StreamExecutor* executor = nullptr;
+  std::unique_ptr<Stream> stream;
+  ::sycl::kernel sycl_kernel;
+  std::unique_ptr<GpuKernel> kernel;
+};
+
+// Returns the executor of device 0 with a stream and a kernel doing nothing.
+LaunchFixture& GetFixture() {
+  static LaunchFixture* fixture = [] {
+    auto* fixture = new LaunchFixture();
+    Platform* platform = PlatformManager::PlatformWithName("SYCL").value();
+    fixture->executor = platform->ExecutorForDevice(0).value();
+    fixture->stream = fixture->executor->CreateStream().value();
+
+    // Submitting the kernel once makes it part of the kernel bundle of the
+    // binary, from which it is then launched like a loaded SPIR-V kernel.
+    ::sycl::queue* queue = AsGpuStreamValue(fixture->stream.get());
+    queue->parallel_for<EmptyKernel>(
+        ::sycl::nd_range<3>({1, 1, 1}, {1, 1, 1}),
+        [](::sycl::nd_item<3>) {});
+    queue->wait();
+    auto bundle = ::sycl::get_kernel_bundle<::sycl::bundle_state::executable>(
+        queue->get_context());
+    fixture->sycl_kernel =
+        bundle.get_kernel(::sycl::get_kernel_id<EmptyKernel>());
+
+    fixture->kernel =
+        std::make_unique<GpuKernel>(ExtractGpuExecutor(fixture->executor));
+    fixture->kernel->set_name("empty_kernel");
+    fixture->kernel->set_arity(0);
+    *fixture->kernel->gpu_function_ptr() = &fixture->sycl_kernel;
+    return fixture;
+  }();
+  return *fixture;
+}
+
+void DrainStream(benchmark::State& state, Stream* stream) {
+  state.PauseTiming();
+  TF_CHECK_OK(stream->BlockHostUntilDone());
+  state.ResumeTiming();
+}
+
+void BM_Launch(benchmark::State& state) {
+  LaunchFixture& fixture = GetFixture();
+  GpuExecutor* executor = ExtractGpuExecutor(fixture.executor);
+  auto args =
+      PackKernelArgs(absl::Span<const DeviceMemoryBase>(), /*shmem_bytes=*/0)
+          .value();
+  int64_t pending = 0;
+  for (auto _ : state) {
+    TF_CHECK_OK(executor->Launch(fixture.stream.get(), ThreadDim(1),
+                                 BlockDim(1), *fixture.kernel, *args));
+    if (++pending == kMaxPendingCommands) {
+      DrainStream(state, fixture.stream.get());
+      pending = 0;
+    }
+  }
+  TF_CHECK_OK(fixture.stream->BlockHostUntilDone());
+}
+
+// Launch followed by a wait for its completion, the latency of a dependent
+// host step.
+void BM_LaunchAndWait(benchmark::State& state) {
+  LaunchFixture& fixture = GetFixture();
+  GpuExecutor* executor = ExtractGpuExecutor(fixture.executor);
+  auto args =
+      PackKernelArgs(absl::Span<const DeviceMemoryBase>(), /*shmem_bytes=*/0)
+          .value();
+  for (auto _ : state) {
+    TF_CHECK_OK(executor->Launch(fixture.stream.get(), ThreadDim(1),
+                                 BlockDim(1), *fixture.kernel, *args));
+    TF_CHECK_OK(fixture.stream->BlockHostUntilDone());
+  }
+}
+
+void BM_RecordEvent(benchmark::State& state) {
+  LaunchFixture& fixture = GetFixture();
+  Event event(fixture.executor);
+  CHECK(event.Init());
+  int64_t pending = 0;
+  for (auto _ : state) {
+    TF_CHECK_OK(fixture.stream->RecordEvent(&event));
+    if (++pending == kMaxPendingCommands) {
+      DrainStream(state, fixture.stream.get());
+      pending = 0;
+    }
+  }
+  TF_CHECK_OK(fixture.stream->BlockHostUntilDone());
+}
+
+BENCHMARK(BM_Launch);
+BENCHMARK(BM_LaunchAndWait);
+BENCHMARK(BM_RecordEvent);
+
+}  // namespace
+}  // namespace gpu
+}  // namespace stream_executor
@@ -0,0 +1,46 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_STREAM_EXECUTOR_SYCL_SYCL_MEMORY_STATS_H_
+#define XLA_STREAM_EXECUTOR_SYCL_SYCL_MEMORY_STATS_H_
+
+#include <cstdint>
+
+// Device memory allocated by SYCLMalloc on a device and not yet freed, and
+// the time spent in the SYCL runtime allocating it. The allocators of XLA
+// allocate large blocks and sub-allocate them, so these tell how much memory
+// they hold on to and how often they go to the driver for more.
+//
+// Kept apart from sycl_gpu_runtime.h so that libraries without the SYCL
+// headers, e.g. the Python extension, can read the stats of the plugin.
+struct SYCLMemoryStats {
+  int64_t num_allocs = 0;
+  int64_t bytes_in_use = 0;
+  int64_t peak_bytes_in_use = 0;
+  int64_t largest_alloc_size = 0;
+  int64_t malloc_time_ns = 0;
+  int64_t max_malloc_time_ns = 0;
+};
+
+// Exported by pjrt_plugin_xpu.so for the libraries loaded next to it, which
+// look it up with dlsym. Fills the stats of device `device_ordinal` and
+// returns 0, or returns -1 if there is no such device.
+extern "C" int XpuGetDeviceMemoryStats(int device_ordinal,
+                                       SYCLMemoryStats* stats);
+using XpuGetDeviceMemoryStatsFn = decltype(&XpuGetDeviceMemoryStats);
+inline constexpr char kXpuGetDeviceMemoryStatsSymbol[] =
+    "XpuGetDeviceMemoryStats";
+
+#endif  // XLA_STREAM_EXECUTOR_SYCL_SYCL_MEMORY_STATS_H_
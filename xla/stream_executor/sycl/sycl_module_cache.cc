@@ -0,0 +1,178 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/stream_executor/sycl/sycl_module_cache.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/file_statistics.h"
+#include "tsl/platform/fingerprint.h"
+#include "tsl/platform/logging.h"
+#include "tsl/platform/path.h"
+#include "tsl/util/env_var.h"
+
+namespace stream_executor {
+namespace gpu {
+namespace {
+
+constexpr absl::string_view kEntrySuffix = ".zebin";
+
+}  // namespace
+
+SYCLModuleCache::SYCLModuleCache(std::string dir, int64_t max_size_bytes)
+    : dir_(std::move(dir)), max_size_bytes_(max_size_bytes) {}
+
+/* static */ SYCLModuleCache* SYCLModuleCache::Get() {
+  static SYCLModuleCache* cache = []() -> SYCLModuleCache* {
+    std::string dir;
+    int64_t max_size_mb = 1024;
+    TF_CHECK_OK(tsl::ReadStringFromEnvVar("XLA_SYCL_MODULE_CACHE_DIR", "",
+                                          &dir));
+    TF_CHECK_OK(tsl::ReadInt64FromEnvVar("XLA_SYCL_MODULE_CACHE_MAX_SIZE_MB",
+                                         1024, &max_size_mb));
+    if (dir.empty() || max_size_mb <= 0) return nullptr;
+
+    absl::Status status = tsl::Env::Default()->RecursivelyCreateDir(dir);
+    if (!status.ok()) {
+      LOG(WARNING) << "Disabling SYCL module cache, failed to create " << dir
+                   << ": " << status;
+      return nullptr;
+    }
+    VLOG(1) << "Using SYCL module cache " << dir << " of up to "
+            << max_size_mb << " MB";
+    return new SYCLModuleCache(dir, max_size_mb * 1024 * 1024);
+  }();
+  return cache;
+}
+
+/* static */ std::string SYCLModuleCache::Key(const ::sycl::device& device,
+                                              const char* spir_contents,
+                                              size_t size) {
+  std::string device_key = absl::StrCat(
+      device.get_info<::sycl::ext::intel::info::device::device_id>(), "|",
+      device.get_info<::sycl::info::device::name>(), "|",
+      device.get_info<::sycl::info::device::driver_version>());
+  tsl::Fprint128 content =
+      tsl::Fingerprint128(absl::string_view(spir_contents, size));
+  return absl::StrFormat(
+      "%016x%016x-%016x", content.high64, content.low64,
+      tsl::Fingerprint64(device_key));
+}
+
+std::string SYCLModuleCache::Path(const std::string& key) const {
+  return tsl::io::JoinPath(dir_, absl::StrCat(key, kEntrySuffix));
+}
+
+std::optional<std::string> SYCLModuleCache::Lookup(const std::string& key) {
+  tsl::Env* env = tsl::Env::Default();
+  std::string path = Path(key);
+  if (!env->FileExists(path).ok()) return std::nullopt;
+
+  std::string binary;
+  absl::Status status = tsl::ReadFileToString(env, path, &binary);
+  if (!status.ok() || binary.empty()) {
+    VLOG(1) << "Failed to read SYCL module cache entry " << path << ": "
+            << status;
+    return std::nullopt;
+  }
+  VLOG(3) << "SYCL module cache hit " << path;
+  return binary;
+}
+
+void SYCLModuleCache::Store(const std::string& key, ze_module_handle_t module) {
+  size_t size = 0;
+  if (zeModuleGetNativeBinary(module, &size, nullptr) != ZE_RESULT_SUCCESS ||
+      size == 0) {
+    VLOG(1) << "Failed to query native binary size of module " << module;
+    return;
+  }
+  std::string binary(size, '\0');
+  if (zeModuleGetNativeBinary(module, &size,
+                              reinterpret_cast<uint8_t*>(binary.data())) !=
+      ZE_RESULT_SUCCESS) {
+    VLOG(1) << "Failed to get native binary of module " << module;
+    return;
+  }
+  if (static_cast<int64_t>(size) > max_size_bytes_) return;
+
+  // Write to a temporary file first so that concurrent processes sharing the
+  // cache directory never observe partially written entries.
+  tsl::Env* env = tsl::Env::Default();
+  std::string path = Path(key);
+  std::string tmp_path = absl::StrCat(path, ".tmp.", env->NowMicros(), ".",
+                                      env->GetCurrentThreadId());
+  absl::Status status = tsl::WriteStringToFile(env, tmp_path, binary);
+  if (status.ok()) status = env->RenameFile(tmp_path, path);
+  if (!status.ok()) {
+    LOG(WARNING) << "Failed to write SYCL module cache entry " << path << ": "
+                 << status;
+    env->DeleteFile(tmp_path).IgnoreError();
+    return;
+  }
+  VLOG(3) << "Stored " << size << " bytes in SYCL module cache " << path;
+
+  absl::MutexLock lock(&mu_);
+  Trim();
+}
+
+void SYCLModuleCache::Remove(const std::string& key) {
+  tsl::Env::Default()->DeleteFile(Path(key)).IgnoreError();
+}
+
+void SYCLModuleCache::Trim() {
+  tsl::Env* env = tsl::Env::Default();
+  std::vector<std::string> children;
+  if (!env->GetChildren(dir_, &children).ok()) return;
+
+  struct Entry {
+    std::string path;
+    int64_t size;
+    int64_t mtime_nsec;
+  };
+  std::vector<Entry> entries;
+  int64_t total_size = 0;
+  for (const std::string& child : children) {
+    if (!absl::EndsWith(child, kEntrySuffix)) continue;
+    std::string path = tsl::io::JoinPath(dir_, child);
+    tsl::FileStatistics stat;
+    if (!env->Stat(path, &stat).ok()) continue;
+    entries.push_back({std::move(path), stat.length, stat.mtime_nsec});
+    total_size += stat.length;
+  }
+  if (total_size <= max_size_bytes_) return;
+
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b) {
+              return a.mtime_nsec < b.mtime_nsec;
+            });
+  for (const Entry& entry : entries) {
+    if (total_size <= max_size_bytes_) break;
+    if (env->DeleteFile(entry.path).ok()) {
+      VLOG(3) << "Evicted SYCL module cache entry " << entry.path;
+      total_size -= entry.size;
+    }
+  }
+}
+
+}  // namespace gpu
+}  // namespace stream_executor
@@ -0,0 +1,76 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_STREAM_EXECUTOR_SYCL_SYCL_MODULE_CACHE_H_
+#define XLA_STREAM_EXECUTOR_SYCL_SYCL_MODULE_CACHE_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "absl/synchronization/mutex.h"
+#include "level_zero/ze_api.h"
+#include "xla/stream_executor/sycl/sycl_gpu_runtime.h"
+
+namespace stream_executor {
+namespace gpu {
+
+// Persistent cache of native device binaries compiled from SPIR-V modules.
+// JIT compilation of SPIR-V by the Level-Zero driver is paid for every module
+// on every process start; the cache stores the output of
+// zeModuleGetNativeBinary so that later processes can load it with
+// ZE_MODULE_FORMAT_NATIVE instead.
+//
+// The cache is disabled unless XLA_SYCL_MODULE_CACHE_DIR is set. Its size on
+// disk is bounded by XLA_SYCL_MODULE_CACHE_MAX_SIZE_MB (default 1024), least
+// recently written entries are removed first.
+class SYCLModuleCache {
+ public:
+  // Returns the process wide cache, or nullptr if caching is disabled.
+  static SYCLModuleCache* Get();
+
+  // Returns the cache key of `spir_contents` compiled for `device`. The key
+  // covers the module content, the device id and the driver version, since a
+  // native binary is only valid for the device and driver it was built by.
+  static std::string Key(const ::sycl::device& device,
+                         const char* spir_contents, size_t size);
+
+  // Returns the native binary cached for `key`, if any.
+  std::optional<std::string> Lookup(const std::string& key);
+
+  // Stores the native binary of `module` for `key`. Failures are logged and
+  // otherwise ignored, the cache is only an optimization.
+  void Store(const std::string& key, ze_module_handle_t module);
+
+  // Removes an entry that the driver refused to load.
+  void Remove(const std::string& key);
+
+ private:
+  SYCLModuleCache(std::string dir, int64_t max_size_bytes);
+
+  std::string Path(const std::string& key) const;
+
+  // Deletes the oldest entries until the cache fits in `max_size_bytes_`.
+  void Trim() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const std::string dir_;
+  const int64_t max_size_bytes_;
+  absl::Mutex mu_;
+};
+
+}  // namespace gpu
+}  // namespace stream_executor
+
+#endif  // XLA_STREAM_EXECUTOR_SYCL_SYCL_MODULE_CACHE_H_
@@ -0,0 +1,262 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/stream_executor/sycl/sycl_module_loader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "tsl/platform/cpu_info.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/fingerprint.h"
+#include "tsl/platform/logging.h"
+#include "tsl/platform/threadpool.h"
+#include "xla/stream_executor/sycl/sycl_module_cache.h"
+
+namespace stream_executor {
+namespace gpu {
+namespace {
+
+// Upper bound on compiled modules nobody claimed yet. Executables that are
+// compiled but never run, or dropped before their first launch, would
+// otherwise pin their modules for the lifetime of the process.
+constexpr int kMaxPrecompiledModules = 256;
+
+// Modules compiled ahead of their first use, keyed by content and device.
+class PrecompiledModules {
+ public:
+  static PrecompiledModules* Get() {
+    static PrecompiledModules* modules = new PrecompiledModules;
+    return modules;
+  }
+
+  static std::string Key(ze_device_handle_t device,
+                         const tsl::Fprint128& content) {
+    return absl::StrFormat("%016x%016x@%p", content.high64, content.low64,
+                           device);
+  }
+
+  // Marks `key` as being compiled. Returns false if a module for `key` is
+  // already available or in flight.
+  bool Reserve(const std::string& key) {
+    absl::MutexLock lock(&mu_);
+    if (pending_.contains(key) || modules_.contains(key)) return false;
+    pending_.insert(key);
+    num_entries_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Publishes the result of a compilation started with Reserve. A null
+  // `module` only drops the reservation.
+  void Finish(const std::string& key, ze_module_handle_t module) {
+    std::vector<ze_module_handle_t> evicted;
+    {
+      absl::MutexLock lock(&mu_);
+      pending_.erase(key);
+      if (module == nullptr) {
+        num_entries_.fetch_sub(1, std::memory_order_relaxed);
+        return;
+      }
+      modules_[key] = module;
+      order_.push_back(key);
+      while (modules_.size() > kMaxPrecompiledModules) {
+        auto it = modules_.find(order_.front());
+        order_.pop_front();
+        if (it == modules_.end()) continue;
+        evicted.push_back(it->second);
+        modules_.erase(it);
+        num_entries_.fetch_sub(1, std::memory_order_relaxed);
+      }
+    }
+    for (ze_module_handle_t module : evicted) zeModuleDestroy(module);
+  }
+
+  // Claims the module for `key`, waiting for an in-flight compilation.
+  std::optional<ze_module_handle_t> Take(const std::string& key) {
+    absl::MutexLock lock(&mu_);
+    auto not_pending = [this, &key]() ABSL_SHARED_LOCKS_REQUIRED(mu_) {
+      return !pending_.contains(key);
+    };
+    mu_.Await(absl::Condition(&not_pending));
+    auto it = modules_.find(key);
+    if (it == modules_.end()) return std::nullopt;
+    ze_module_handle_t module = it->second;
+    modules_.erase(it);
+    num_entries_.fetch_sub(1, std::memory_order_relaxed);
+    // `order_` keeps the stale key, it is skipped on eviction.
+    if (modules_.empty()) order_.clear();
+    return module;
+  }
+
+  // Lets callers skip fingerprinting when nothing was precompiled.
+  bool empty() const {
+    return num_entries_.load(std::memory_order_relaxed) == 0;
+  }
+
+ private:
+  absl::Mutex mu_;
+  absl::flat_hash_map<std::string, ze_module_handle_t> modules_
+      ABSL_GUARDED_BY(mu_);
+  absl::flat_hash_set<std::string> pending_ ABSL_GUARDED_BY(mu_);
+  // Insertion order of `modules_`, oldest first.
+  std::deque<std::string> order_ ABSL_GUARDED_BY(mu_);
+  // Size of `modules_` plus `pending_`.
+  std::atomic<int64_t> num_entries_{0};
+};
+
+tsl::thread::ThreadPool* CompileThreadPool() {
+  static tsl::thread::ThreadPool* pool = new tsl::thread::ThreadPool(
+      tsl::Env::Default(), "xla_sycl_module_compile",
+      std::max(1, tsl::port::MaxParallelism()));
+  return pool;
+}
+
+}  // namespace
+
+absl::StatusOr<ze_module_handle_t> CompileLevelzeroModule(
+    const ::sycl::context& context, const ::sycl::device& device,
+    const char* spir_contents, size_t size) {
+  auto ze_device =
+      ::sycl::get_native<::sycl::backend::ext_oneapi_level_zero>(device);
+  auto ze_context =
+      ::sycl::get_native<::sycl::backend::ext_oneapi_level_zero>(context);
+  ze_module_handle_t ze_module = nullptr;
+
+  SYCLModuleCache* cache = SYCLModuleCache::Get();
+  std::string cache_key;
+  if (cache != nullptr) {
+    cache_key = SYCLModuleCache::Key(device, spir_contents, size);
+    if (std::optional<std::string> binary = cache->Lookup(cache_key)) {
+      ze_module_desc_t nativeDesc = {
+          ZE_STRUCTURE_TYPE_MODULE_DESC,
+          nullptr,
+          ZE_MODULE_FORMAT_NATIVE,
+          binary->size(),
+          reinterpret_cast<const uint8_t*>(binary->data()),
+          nullptr,
+          nullptr};
+      if (zeModuleCreate(ze_context, ze_device, &nativeDesc, &ze_module,
+                         nullptr) == ZE_RESULT_SUCCESS) {
+        return ze_module;
+      }
+      // Stale or corrupted entry, rebuild it from SPIR-V below.
+      VLOG(1) << "Failed to load cached native module " << cache_key;
+      cache->Remove(cache_key);
+    }
+  }
+
+  ze_module_desc_t moduleDesc = {ZE_STRUCTURE_TYPE_MODULE_DESC,
+                                 nullptr,
+                                 ZE_MODULE_FORMAT_IL_SPIRV,
+                                 size,
+                                 (const uint8_t*)spir_contents,
+                                 nullptr,
+                                 nullptr};
+
+  ze_module_build_log_handle_t buildlog;
+  ze_result_t status =
+      zeModuleCreate(ze_context, ze_device, &moduleDesc, &ze_module, &buildlog);
+  if (status != 0) {
+    size_t szLog = 0;
+    zeModuleBuildLogGetString(buildlog, &szLog, nullptr);
+
+    std::unique_ptr<char[]> PLogs(new char[szLog]);
+    zeModuleBuildLogGetString(buildlog, &szLog, PLogs.get());
+    std::string PLog(PLogs.get());
+    zeModuleBuildLogDestroy(buildlog);
+    return absl::InternalError(absl::StrCat("L0 error ", status, ": ", PLog));
+  }
+  zeModuleBuildLogDestroy(buildlog);
+
+  if (cache != nullptr) cache->Store(cache_key, ze_module);
+  return ze_module;
+}
+
+absl::Status PrecompileSpirModules(
+    absl::Span<const int> device_ordinals,
+    absl::Span<const absl::Span<const uint8_t>> modules) {
+  sycl::context* context;
+  if (SYCLGetContext(&context) != SYCL_SUCCESS) {
+    return absl::InternalError("Failed to get SYCL context");
+  }
+
+  // Executables of different partitions usually share one binary.
+  absl::flat_hash_map<std::pair<uint64_t, uint64_t>,
+                      std::shared_ptr<const std::string>>
+      contents;
+  for (absl::Span<const uint8_t> module : modules) {
+    if (module.empty()) continue;
+    absl::string_view bytes(reinterpret_cast<const char*>(module.data()),
+                            module.size());
+    tsl::Fprint128 fingerprint = tsl::Fingerprint128(bytes);
+    auto& content = contents[{fingerprint.low64, fingerprint.high64}];
+    // Copied, the executable may be gone before the compilation runs.
+    if (content == nullptr) content = std::make_shared<std::string>(bytes);
+  }
+
+  PrecompiledModules* precompiled = PrecompiledModules::Get();
+  int num_tasks = 0;
+  for (int ordinal : device_ordinals) {
+    sycl::device* device;
+    if (SYCLGetDevice(&device, ordinal) != SYCL_SUCCESS) {
+      return absl::InternalError(
+          absl::StrCat("Failed to get SYCL device ", ordinal));
+    }
+    auto ze_device =
+        ::sycl::get_native<::sycl::backend::ext_oneapi_level_zero>(*device);
+    for (const auto& [fingerprint, content] : contents) {
+      std::string key = PrecompiledModules::Key(
+          ze_device, tsl::Fprint128{fingerprint.first, fingerprint.second});
+      if (!precompiled->Reserve(key)) continue;
+      ++num_tasks;
+      CompileThreadPool()->Schedule([context, device, content, key] {
+        absl::StatusOr<ze_module_handle_t> module = CompileLevelzeroModule(
+            *context, *device, content->data(), content->size());
+        if (!module.ok()) {
+          // Not fatal, the module is compiled again at its first launch.
+          LOG(WARNING) << "Failed to precompile SYCL module: "
+                       << module.status();
+        }
+        precompiled->Finish(key, module.ok() ? *module : nullptr);
+      });
+    }
+  }
+  VLOG(1) << "Scheduled " << num_tasks << " SYCL module compilations";
+  return absl::OkStatus();
+}
+
+std::optional<ze_module_handle_t> TakePrecompiledModule(
+    const ::sycl::device& device, const char* spir_contents, size_t size) {
+  PrecompiledModules* modules = PrecompiledModules::Get();
+  if (modules->empty()) return std::nullopt;
+  auto ze_device =
+      ::sycl::get_native<::sycl::backend::ext_oneapi_level_zero>(device);
+  return modules->Take(PrecompiledModules::Key(
+      ze_device, tsl::Fingerprint128(absl::string_view(spir_contents, size))));
+}
+
+}  // namespace gpu
+}  // namespace stream_executor
@@ -0,0 +1,61 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_STREAM_EXECUTOR_SYCL_SYCL_MODULE_LOADER_H_
+#define XLA_STREAM_EXECUTOR_SYCL_SYCL_MODULE_LOADER_H_
+
+#include <cstdint>
+#include <optional>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "level_zero/ze_api.h"
+#include "xla/stream_executor/sycl/sycl_gpu_runtime.h"
+
+namespace stream_executor {
+namespace gpu {
+
+// Builds a Level-Zero module from `spir_contents` for `device`, loading the
+// native binary from the persistent module cache when possible.
+absl::StatusOr<ze_module_handle_t> CompileLevelzeroModule(
+    const ::sycl::context& context, const ::sycl::device& device,
+    const char* spir_contents, size_t size);
+
+// Schedules the compilation of every module in `modules` for the devices in
+// `device_ordinals` on a background thread pool and returns without waiting.
+// Module loading otherwise happens lazily and serially at the first kernel
+// launch of an executable, which puts the JIT latency of all its modules on
+// the critical path of the first step. Identical modules are compiled once per
+// device.
+//
+// Compiled modules are kept until they are claimed by
+// TakePrecompiledModule, i.e. by the first GpuDriver::LoadLevelzero call for
+// the same content and device. Unclaimed modules are destroyed oldest first
+// once too many of them accumulate.
+absl::Status PrecompileSpirModules(
+    absl::Span<const int> device_ordinals,
+    absl::Span<const absl::Span<const uint8_t>> modules);
+
+// Returns a module precompiled from `spir_contents` for `device`, if any.
+// Waits for a compilation of the same module that is still in flight.
+// Ownership of the module is transferred to the caller.
+std::optional<ze_module_handle_t> TakePrecompiledModule(
+    const ::sycl::device& device, const char* spir_contents, size_t size);
+
+}  // namespace gpu
+}  // namespace stream_executor
+
+#endif  // XLA_STREAM_EXECUTOR_SYCL_SYCL_MODULE_LOADER_H_
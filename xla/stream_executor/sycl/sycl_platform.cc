@@ -24,6 +24,7 @@ limitations under the License.
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 // #include "xla/stream_executor/sycl/sycl_driver.h"
+#include "xla/stream_executor/sycl/hw_info.h"
 #include "xla/stream_executor/sycl/sycl_platform_id.h"
 #include "xla/stream_executor/gpu/gpu_executor.h"
 #include "xla/stream_executor/platform/initialize.h"
@@ -95,6 +96,7 @@ int SyclPlatform::VisibleDeviceCount() const {
   // Initialized in a thread-safe manner the first time this is run.
   static const int num_devices = [] {
     if (!GpuDriver::Init().ok()) return -1;
+    InitHardwareInfo();
     return GpuDriver::GetDeviceCount();
   }();
   return num_devices;
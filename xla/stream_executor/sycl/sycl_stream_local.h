@@ -0,0 +1,77 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_STREAM_EXECUTOR_SYCL_SYCL_STREAM_LOCAL_H_
+#define XLA_STREAM_EXECUTOR_SYCL_SYCL_STREAM_LOCAL_H_
+
+#include <memory>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "xla/stream_executor/sycl/sycl_gpu_runtime.h"
+
+namespace stream_executor {
+namespace gpu {
+
+// A `T` per stream, like the device buffers a library keeps for the kernels it
+// submits to a stream. The `T` of a stream is constructed from its queue on
+// first use and destroyed when the stream is destroyed, so its destructor
+// should wait for the queue before it frees what the kernels may still use.
+//
+// Instances register a callback with the stream pool and must outlive it, they
+// are meant to be leaked function-local statics:
+//
+//   static auto* pools = new SYCLStreamLocal<ProblemTablePool>();
+//   pools->Get(stream).Upload(...);
+template <typename T>
+class SYCLStreamLocal {
+ public:
+  SYCLStreamLocal() {
+    SYCLAddStreamDestroyCallback([this](sycl::queue* stream) {
+      std::unique_ptr<T> value;
+      {
+        absl::MutexLock lock(&mu_);
+        auto it = values_.find(stream);
+        if (it == values_.end()) return;
+        value = std::move(it->second);
+        values_.erase(it);
+      }
+    });
+  }
+
+  SYCLStreamLocal(const SYCLStreamLocal&) = delete;
+  SYCLStreamLocal& operator=(const SYCLStreamLocal&) = delete;
+
+  // Returns the `T` of `stream`, which stays valid until the stream is
+  // destroyed.
+  T& Get(sycl::queue* stream) {
+    absl::MutexLock lock(&mu_);
+    std::unique_ptr<T>& value = values_[stream];
+    if (value == nullptr) value = std::make_unique<T>(stream);
+    return *value;
+  }
+
+ private:
+  absl::Mutex mu_;
+  absl::flat_hash_map<sycl::queue*, std::unique_ptr<T>> values_
+      ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace gpu
+}  // namespace stream_executor
+
+#endif  // XLA_STREAM_EXECUTOR_SYCL_SYCL_STREAM_LOCAL_H_
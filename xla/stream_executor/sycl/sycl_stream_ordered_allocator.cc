@@ -0,0 +1,227 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/stream_executor/sycl/sycl_stream_ordered_allocator.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/numeric/bits.h"
+#include "tsl/platform/logging.h"
+#include "tsl/profiler/lib/traceme.h"
+#include "tsl/profiler/lib/traceme_encode.h"
+
+namespace stream_executor {
+namespace gpu {
+namespace {
+
+// Smallest bin is 512 bytes, which keeps small allocations within the
+// alignment XLA expects from device allocators.
+constexpr int kMinBin = 9;
+constexpr int kNumBins = 64;
+
+}  // namespace
+
+SYCLStreamOrderedAllocator::SYCLStreamOrderedAllocator(::sycl::device* device,
+                                                       ::sycl::queue* stream,
+                                                       int64_t memory_limit,
+                                                       std::string name)
+    : device_(device),
+      stream_(stream),
+      memory_limit_(memory_limit),
+      name_(std::move(name)),
+      free_blocks_(kNumBins) {
+  stats_.bytes_limit = memory_limit;
+}
+
+SYCLStreamOrderedAllocator::~SYCLStreamOrderedAllocator() {
+  ReleaseCachedBlocks();
+  absl::MutexLock lock(&mu_);
+  if (!allocations_.empty()) {
+    LOG(WARNING) << name_ << " destroyed with " << allocations_.size()
+                 << " live allocations";
+  }
+}
+
+/* static */ int SYCLStreamOrderedAllocator::BinIndex(size_t num_bytes) {
+  if (num_bytes <= BinSize(kMinBin)) return kMinBin;
+  return absl::bit_width(num_bytes - 1);
+}
+
+void* SYCLStreamOrderedAllocator::AllocateRaw(size_t alignment,
+                                              size_t num_bytes) {
+  DCHECK_LE(alignment, tsl::Allocator::kAllocatorAlignment);
+  int bin = BinIndex(num_bytes);
+  if (bin >= kNumBins) return nullptr;
+  size_t bin_size = BinSize(bin);
+
+  absl::MutexLock lock(&mu_);
+  void* ptr = TakeCachedBlock(bin);
+  if (ptr == nullptr) {
+    if (reserved_bytes_ + static_cast<int64_t>(bin_size) > memory_limit_) {
+      ReleaseCompletedBlocks(/*wait=*/false);
+    }
+    if (reserved_bytes_ + static_cast<int64_t>(bin_size) > memory_limit_) {
+      VLOG(1) << name_ << " is out of memory allocating " << num_bytes
+              << " bytes, " << reserved_bytes_ << " of " << memory_limit_
+              << " bytes are reserved";
+      return nullptr;
+    }
+    ptr = SYCLMalloc(device_, bin_size);
+    if (ptr == nullptr) {
+      // Cached blocks of other bins may still be pending, wait for them
+      // before giving up.
+      ReleaseCompletedBlocks(/*wait=*/true);
+      ptr = SYCLMalloc(device_, bin_size);
+    }
+    if (ptr == nullptr) return nullptr;
+    reserved_bytes_ += bin_size;
+    stats_.bytes_reserved = reserved_bytes_;
+    stats_.peak_bytes_reserved =
+        std::max(stats_.peak_bytes_reserved, stats_.bytes_reserved);
+  }
+
+  allocations_[ptr] = {num_bytes, bin};
+  ++stats_.num_allocs;
+  stats_.bytes_in_use += bin_size;
+  stats_.peak_bytes_in_use =
+      std::max(stats_.peak_bytes_in_use, stats_.bytes_in_use);
+  stats_.largest_alloc_size =
+      std::max<int64_t>(stats_.largest_alloc_size, bin_size);
+  TraceMemoryEvent("MemoryAllocation", ptr, num_bytes, bin_size);
+  return ptr;
+}
+
+void SYCLStreamOrderedAllocator::DeallocateRaw(void* ptr) {
+  if (ptr == nullptr) return;
+  absl::MutexLock lock(&mu_);
+  auto it = allocations_.find(ptr);
+  CHECK(it != allocations_.end())
+      << name_ << " deallocating unknown pointer " << ptr;
+  int bin = it->second.bin;
+  size_t requested_size = it->second.requested_size;
+  allocations_.erase(it);
+  stats_.bytes_in_use -= BinSize(bin);
+  TraceMemoryEvent("MemoryDeallocation", ptr, requested_size, BinSize(bin));
+
+  // Work already submitted to the stream may still use the block, so it can
+  // only be returned to the driver once this marker completes.
+  free_blocks_[bin].push_back({ptr, SYCLGetLastEventFromStream(stream_)});
+}
+
+void SYCLStreamOrderedAllocator::TraceMemoryEvent(const char* name,
+                                                  const void* ptr,
+                                                  size_t requested_bytes,
+                                                  size_t allocation_bytes) {
+  // Same events as the BFC allocator, which the memory profile is built from.
+  tsl::profiler::TraceMe::InstantActivity(
+      [&] {
+        return tsl::profiler::TraceMeEncode(
+            name, {{"allocator_name", name_},
+                   {"bytes_reserved", stats_.bytes_reserved},
+                   {"bytes_allocated", stats_.bytes_in_use},
+                   {"peak_bytes_in_use", stats_.peak_bytes_in_use},
+                   {"requested_bytes", requested_bytes},
+                   {"allocation_bytes", allocation_bytes},
+                   {"addr", reinterpret_cast<uint64_t>(ptr)}});
+      },
+      tsl::profiler::TraceMeLevel::kInfo);
+}
+
+void* SYCLStreamOrderedAllocator::TakeCachedBlock(int bin) {
+  std::vector<FreeBlock>& blocks = free_blocks_[bin];
+  if (blocks.empty()) return nullptr;
+  // Blocks are freed and reused on the same stream, no need to wait.
+  void* ptr = blocks.back().ptr;
+  blocks.pop_back();
+  return ptr;
+}
+
+int64_t SYCLStreamOrderedAllocator::ReleaseCompletedBlocks(bool wait) {
+  if (wait) {
+    // The stream is in order, so its last event completes after the events
+    // of all cached blocks. The other threads keep allocating meanwhile.
+    ::sycl::event last = SYCLGetLastEventFromStream(stream_);
+    mu_.Unlock();
+    last.wait();
+    mu_.Lock();
+  }
+  int64_t released = 0;
+  for (int bin = 0; bin < kNumBins; ++bin) {
+    std::vector<FreeBlock>& blocks = free_blocks_[bin];
+    auto completed = std::partition(
+        blocks.begin(), blocks.end(), [](const FreeBlock& block) {
+          return !SYCLIsEventComplete(block.released);
+        });
+    for (auto it = completed; it != blocks.end(); ++it) {
+      SYCLFree(device_, it->ptr);
+      released += BinSize(bin);
+    }
+    blocks.erase(completed, blocks.end());
+  }
+  reserved_bytes_ -= released;
+  stats_.bytes_reserved = reserved_bytes_;
+  if (released > 0) {
+    VLOG(2) << name_ << " released " << released << " cached bytes";
+  }
+  return released;
+}
+
+void SYCLStreamOrderedAllocator::ReleaseCachedBlocks() {
+  absl::MutexLock lock(&mu_);
+  ReleaseCompletedBlocks(/*wait=*/true);
+}
+
+size_t SYCLStreamOrderedAllocator::RequestedSize(const void* ptr) const {
+  absl::MutexLock lock(&mu_);
+  auto it = allocations_.find(ptr);
+  CHECK(it != allocations_.end());
+  return it->second.requested_size;
+}
+
+size_t SYCLStreamOrderedAllocator::AllocatedSize(const void* ptr) const {
+  absl::MutexLock lock(&mu_);
+  auto it = allocations_.find(ptr);
+  CHECK(it != allocations_.end());
+  return BinSize(it->second.bin);
+}
+
+std::optional<tsl::AllocatorStats> SYCLStreamOrderedAllocator::GetStats() {
+  absl::MutexLock lock(&mu_);
+  tsl::AllocatorStats stats = stats_;
+  // An allocation is served by a cached block of its bin or by a new block
+  // within the limit, the largest block it can get is the larger of the two.
+  int64_t largest_free_block = std::max<int64_t>(
+      memory_limit_ - reserved_bytes_, 0);
+  for (int bin = kNumBins - 1; bin >= kMinBin; --bin) {
+    if (free_blocks_[bin].empty()) continue;
+    largest_free_block = std::max<int64_t>(largest_free_block, BinSize(bin));
+    break;
+  }
+  stats.largest_free_block_bytes = largest_free_block;
+  return stats;
+}
+
+bool SYCLStreamOrderedAllocator::ClearStats() {
+  absl::MutexLock lock(&mu_);
+  stats_.num_allocs = 0;
+  stats_.peak_bytes_in_use = stats_.bytes_in_use;
+  stats_.peak_bytes_reserved = stats_.bytes_reserved;
+  stats_.largest_alloc_size = 0;
+  return true;
+}
+
+}  // namespace gpu
+}  // namespace stream_executor
@@ -0,0 +1,116 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_STREAM_EXECUTOR_SYCL_SYCL_STREAM_ORDERED_ALLOCATOR_H_
+#define XLA_STREAM_EXECUTOR_SYCL_SYCL_STREAM_ORDERED_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "tsl/framework/allocator.h"
+#include "xla/stream_executor/sycl/sycl_gpu_runtime.h"
+
+namespace stream_executor {
+namespace gpu {
+
+// Caching device allocator with stream-ordered deallocation, the SYCL
+// counterpart of the CUDA async allocator.
+//
+// Requests are rounded up to a power of two and served from per-bin free
+// lists. A deallocated block is not released to the driver: it is put on the
+// free list together with an event marking the point in `stream` after which
+// the block is no longer accessed. Allocations are ordered on the same stream,
+// so the block can be reused right away since later work is ordered after
+// that point. Deallocation therefore never synchronizes with the device.
+//
+// Cached blocks whose events completed are returned to the driver when a new
+// allocation would exceed `memory_limit` or when the driver runs out of
+// memory.
+class SYCLStreamOrderedAllocator : public tsl::Allocator {
+ public:
+  SYCLStreamOrderedAllocator(::sycl::device* device, ::sycl::queue* stream,
+                             int64_t memory_limit, std::string name);
+  ~SYCLStreamOrderedAllocator() override;
+
+  std::string Name() override { return name_; }
+
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override;
+  void DeallocateRaw(void* ptr) override;
+
+  bool TracksAllocationSizes() const override { return true; }
+  size_t RequestedSize(const void* ptr) const override;
+  size_t AllocatedSize(const void* ptr) const override;
+
+  std::optional<tsl::AllocatorStats> GetStats() override;
+  bool ClearStats() override;
+
+  tsl::AllocatorMemoryType GetMemoryType() const override {
+    return tsl::AllocatorMemoryType::kDevice;
+  }
+
+  // Releases all cached blocks to the driver, waiting for pending ones.
+  void ReleaseCachedBlocks();
+
+ private:
+  struct FreeBlock {
+    void* ptr;
+    ::sycl::event released;
+  };
+
+  struct Allocation {
+    size_t requested_size;
+    int bin;
+  };
+
+  static int BinIndex(size_t num_bytes);
+  static size_t BinSize(int bin) { return size_t{1} << bin; }
+
+  // Returns a cached block of `bin`, or nullptr if there is none.
+  void* TakeCachedBlock(int bin) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Emits an allocator event for the memory profile of a profiling session.
+  void TraceMemoryEvent(const char* name, const void* ptr,
+                        size_t requested_bytes, size_t allocation_bytes)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Frees cached blocks whose last use completed, after waiting for the work
+  // submitted to the stream if `wait`. `mu_` is released during the wait.
+  // Returns the number of released bytes.
+  int64_t ReleaseCompletedBlocks(bool wait) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  ::sycl::device* device_;
+  ::sycl::queue* const stream_;
+  const int64_t memory_limit_;
+  const std::string name_;
+
+  mutable absl::Mutex mu_;
+  // Free lists indexed by bin.
+  std::vector<std::vector<FreeBlock>> free_blocks_ ABSL_GUARDED_BY(mu_);
+  absl::flat_hash_map<const void*, Allocation> allocations_
+      ABSL_GUARDED_BY(mu_);
+  // Bytes obtained from the driver, including cached blocks.
+  int64_t reserved_bytes_ ABSL_GUARDED_BY(mu_) = 0;
+  tsl::AllocatorStats stats_ ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace gpu
+}  // namespace stream_executor
+
+#endif  // XLA_STREAM_EXECUTOR_SYCL_SYCL_STREAM_ORDERED_ALLOCATOR_H_
@@ -0,0 +1,249 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/stream_executor/sycl/sycl_tracer.h"
+
+#include <memory>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "tsl/platform/logging.h"
+#include "tsl/profiler/backends/cpu/annotation_stack.h"
+#include "tsl/profiler/lib/profiler_factory.h"
+#include "tsl/profiler/lib/profiler_interface.h"
+#include "tsl/profiler/protobuf/profiler_options.pb.h"
+#include "tsl/profiler/utils/time_utils.h"
+#include "tsl/profiler/utils/xplane_builder.h"
+#include "tsl/profiler/utils/xplane_schema.h"
+#include "tsl/profiler/utils/xplane_utils.h"
+
+namespace stream_executor {
+namespace gpu {
+namespace {
+
+// Bounds the memory of long sessions, later activities are dropped.
+constexpr size_t kMaxActivities = size_t{1} << 20;
+
+const char* MemcpyKindName(SyclActivityKind kind) {
+  switch (kind) {
+    case SyclActivityKind::kMemcpyH2D:
+      return "HtoD";
+    case SyclActivityKind::kMemcpyD2H:
+      return "DtoH";
+    case SyclActivityKind::kMemcpyD2D:
+      return "DtoD";
+    default:
+      return nullptr;
+  }
+}
+
+// Returns the ordinal of the device `stream` runs on, or -1.
+int DeviceOrdinal(::sycl::queue* stream) {
+  int device_count = 0;
+  if (SYCLGetDeviceCount(&device_count) != SYCL_SUCCESS) return -1;
+  ::sycl::device device = stream->get_device();
+  for (int i = 0; i < device_count; ++i) {
+    ::sycl::device* candidate = nullptr;
+    if (SYCLGetDevice(&candidate, i) == SYCL_SUCCESS &&
+        *candidate == device) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+class SyclDeviceTracer : public tsl::profiler::ProfilerInterface {
+ public:
+  absl::Status Start() override {
+    SyclTracer::GetInstance()->Start();
+    return absl::OkStatus();
+  }
+
+  absl::Status Stop() override {
+    SyclTracer::GetInstance()->Stop();
+    return absl::OkStatus();
+  }
+
+  absl::Status CollectData(tensorflow::profiler::XSpace* space) override {
+    SyclTracer::GetInstance()->Export(space);
+    return absl::OkStatus();
+  }
+};
+
+std::unique_ptr<tsl::profiler::ProfilerInterface> CreateSyclDeviceTracer(
+    const tensorflow::ProfileOptions& options) {
+  if (options.device_tracer_level() == 0) return nullptr;
+  if (options.device_type() != tensorflow::ProfileOptions::GPU &&
+      options.device_type() != tensorflow::ProfileOptions::UNSPECIFIED) {
+    return nullptr;
+  }
+  return std::make_unique<SyclDeviceTracer>();
+}
+
+auto register_sycl_device_tracer_factory = [] {
+  tsl::profiler::RegisterProfilerFactory(&CreateSyclDeviceTracer);
+  return 0;
+}();
+
+}  // namespace
+
+/* static */ SyclTracer* SyclTracer::GetInstance() {
+  static auto* tracer = new SyclTracer();
+  return tracer;
+}
+
+void SyclTracer::Start() {
+  absl::MutexLock lock(&mu_);
+  activities_.clear();
+  dropped_ = 0;
+  start_ns_ = tsl::profiler::GetCurrentTimeNanos();
+  active_.store(true, std::memory_order_release);
+}
+
+void SyclTracer::Stop() { active_.store(false, std::memory_order_release); }
+
+void SyclTracer::Record(SyclActivityKind kind, std::string name, size_t bytes,
+                        ::sycl::queue* stream, uint64_t submit_ns,
+                        ::sycl::event begin, ::sycl::event end,
+                        std::string annotation) {
+  absl::MutexLock lock(&mu_);
+  if (activities_.size() >= kMaxActivities) {
+    ++dropped_;
+    return;
+  }
+  activities_.push_back({kind, std::move(name), bytes, stream, submit_ns,
+                         std::move(begin), std::move(end),
+                         std::move(annotation)});
+}
+
+void SyclTracer::Export(tensorflow::profiler::XSpace* space) {
+  namespace profiler = ::tsl::profiler;
+  std::vector<Activity> activities;
+  uint64_t start_ns;
+  {
+    absl::MutexLock lock(&mu_);
+    activities.swap(activities_);
+    start_ns = start_ns_;
+    if (dropped_ > 0) {
+      LOG(WARNING) << "SYCL tracer dropped " << dropped_
+                   << " device activities beyond the first "
+                   << kMaxActivities;
+    }
+  }
+
+  struct StreamInfo {
+    int device_ordinal;
+    int64_t line_id;
+    // Host time minus device time, taken from the first activity.
+    int64_t clock_offset_ns;
+  };
+  absl::flat_hash_map<::sycl::queue*, StreamInfo> streams;
+  absl::flat_hash_map<int, std::unique_ptr<profiler::XPlaneBuilder>> planes;
+
+  for (Activity& activity : activities) {
+    uint64_t begin_ns, end_ns, device_submit_ns;
+    try {
+      activity.end.wait();
+      device_submit_ns = activity.begin.get_profiling_info<
+          ::sycl::info::event_profiling::command_submit>();
+      begin_ns = activity.begin.get_profiling_info<
+          ::sycl::info::event_profiling::command_end>();
+      end_ns = activity.end.get_profiling_info<
+          ::sycl::info::event_profiling::command_end>();
+    } catch (const ::sycl::exception& e) {
+      LOG_FIRST_N(WARNING, 1) << "Failed to read the device timestamps of "
+                              << activity.name << ": " << e.what();
+      continue;
+    }
+
+    auto [it, inserted] = streams.try_emplace(activity.stream);
+    StreamInfo& stream = it->second;
+    if (inserted) {
+      stream.device_ordinal = DeviceOrdinal(activity.stream);
+      stream.line_id = streams.size() - 1;
+      stream.clock_offset_ns = static_cast<int64_t>(activity.submit_ns) -
+                               static_cast<int64_t>(device_submit_ns);
+    }
+    if (stream.device_ordinal < 0) continue;
+
+    std::unique_ptr<profiler::XPlaneBuilder>& plane =
+        planes[stream.device_ordinal];
+    if (plane == nullptr) {
+      plane = std::make_unique<profiler::XPlaneBuilder>(
+          profiler::FindOrAddMutablePlaneWithName(
+              space, profiler::GpuPlaneName(stream.device_ordinal)));
+    }
+    profiler::XLineBuilder line = plane->GetOrCreateLine(stream.line_id);
+    if (inserted) {
+      line.SetName(absl::StrCat("Stream #", stream.line_id));
+      line.SetTimestampNs(start_ns);
+    }
+
+    profiler::XEventBuilder event =
+        line.AddEvent(*plane->GetOrCreateEventMetadata(activity.name));
+    event.SetTimestampNs(begin_ns + stream.clock_offset_ns);
+    event.SetEndTimestampNs(end_ns + stream.clock_offset_ns);
+    if (!activity.annotation.empty()) {
+      event.AddStatValue(
+          *plane->GetOrCreateStatMetadata(profiler::GetStatTypeStr(
+              profiler::StatType::kKernelAnnotation)),
+          *plane->GetOrCreateStatMetadata(activity.annotation));
+    }
+    if (const char* kind = MemcpyKindName(activity.kind)) {
+      double seconds = (end_ns - begin_ns) * 1e-9;
+      double bandwidth = seconds > 0 ? activity.bytes / seconds * 1e-9 : 0;
+      event.AddStatValue(
+          *plane->GetOrCreateStatMetadata(
+              profiler::GetStatTypeStr(profiler::StatType::kMemcpyDetails)),
+          absl::StrFormat("kind:%s size:%d bandwidth:%.2fGB/s", kind,
+                          activity.bytes, bandwidth));
+    } else if (activity.kind == SyclActivityKind::kMemset) {
+      event.AddStatValue(
+          *plane->GetOrCreateStatMetadata(
+              profiler::GetStatTypeStr(profiler::StatType::kMemsetDetails)),
+          absl::StrFormat("size:%d", activity.bytes));
+    }
+  }
+}
+
+SyclActivityScope::SyclActivityScope(::sycl::queue* stream,
+                                     SyclActivityKind kind,
+                                     absl::string_view name, size_t bytes)
+    : kind_(kind), bytes_(bytes) {
+  if (!SyclTracer::GetInstance()->IsActive()) return;
+  // Commands recorded into a graph are timed when the graph runs, not here.
+  if (stream->ext_oneapi_get_state() ==
+      ::sycl::ext::oneapi::experimental::queue_state::recording) {
+    return;
+  }
+  stream_ = stream;
+  name_ = std::string(name);
+  submit_ns_ = tsl::profiler::GetCurrentTimeNanos();
+  begin_ = SYCLGetTimedEventFromStream(stream);
+}
+
+SyclActivityScope::~SyclActivityScope() {
+  if (stream_ == nullptr) return;
+  ::sycl::event end = SYCLGetTimedEventFromStream(stream_);
+  SyclTracer::GetInstance()->Record(
+      kind_, std::move(name_), bytes_, stream_, submit_ns_, std::move(begin_),
+      std::move(end), std::string(tsl::profiler::AnnotationStack::Get()));
+}
+
+}  // namespace gpu
+}  // namespace stream_executor
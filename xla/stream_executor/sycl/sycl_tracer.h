@@ -0,0 +1,114 @@
+/* Copyright (c) 2024 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_STREAM_EXECUTOR_SYCL_SYCL_TRACER_H_
+#define XLA_STREAM_EXECUTOR_SYCL_SYCL_TRACER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "tsl/profiler/protobuf/xplane.pb.h"
+#include "xla/stream_executor/sycl/sycl_gpu_runtime.h"
+
+namespace stream_executor {
+namespace gpu {
+
+enum class SyclActivityKind {
+  kKernel,
+  kMemcpyH2D,
+  kMemcpyD2H,
+  kMemcpyD2D,
+  kMemset,
+  kCollectiveWait,
+};
+
+// Device activities of the SYCL streams, exported to the device planes of a
+// profiling session. Every activity is bracketed by two timed events on its
+// stream, so it is timed on the device without enabling queue profiling.
+//
+// Nothing is recorded outside of a session with device tracing, the hooks on
+// the launch paths then only cost an atomic load.
+class SyclTracer {
+ public:
+  static SyclTracer* GetInstance();
+
+  bool IsActive() const { return active_.load(std::memory_order_acquire); }
+
+  void Start();
+  void Stop();
+
+  // Records an activity of `stream` that ran between the completion of the
+  // timed events `begin` and `end`. `submit_ns` is the host time `begin` was
+  // enqueued at, `annotation` the profiler annotation of the enqueuing
+  // thread, which names the thunk on the XLA execution paths.
+  void Record(SyclActivityKind kind, std::string name, size_t bytes,
+              ::sycl::queue* stream, uint64_t submit_ns, ::sycl::event begin,
+              ::sycl::event end, std::string annotation);
+
+  // Waits for the recorded activities and adds them to the plane of their
+  // device in `space`, one line per stream.
+  void Export(tensorflow::profiler::XSpace* space);
+
+ private:
+  struct Activity {
+    SyclActivityKind kind;
+    std::string name;
+    size_t bytes;
+    ::sycl::queue* stream;
+    uint64_t submit_ns;
+    ::sycl::event begin;
+    ::sycl::event end;
+    std::string annotation;
+  };
+
+  std::atomic<bool> active_{false};
+
+  absl::Mutex mu_;
+  uint64_t start_ns_ ABSL_GUARDED_BY(mu_) = 0;
+  std::vector<Activity> activities_ ABSL_GUARDED_BY(mu_);
+  size_t dropped_ ABSL_GUARDED_BY(mu_) = 0;
+};
+
+// Times the commands enqueued to `stream` while the scope is alive as one
+// activity, if the tracer is active when the scope is entered.
+class SyclActivityScope {
+ public:
+  SyclActivityScope(::sycl::queue* stream, SyclActivityKind kind,
+                    absl::string_view name, size_t bytes = 0);
+  ~SyclActivityScope();
+
+  SyclActivityScope(const SyclActivityScope&) = delete;
+  SyclActivityScope& operator=(const SyclActivityScope&) = delete;
+
+ private:
+  // Null unless the activity is recorded.
+  ::sycl::queue* stream_ = nullptr;
+  SyclActivityKind kind_;
+  std::string name_;
+  size_t bytes_;
+  uint64_t submit_ns_ = 0;
+  ::sycl::event begin_;
+};
+
+}  // namespace gpu
+}  // namespace stream_executor
+
+#endif  // XLA_STREAM_EXECUTOR_SYCL_SYCL_TRACER_H_